@@ -23,6 +23,9 @@
 
 #include "rotors_control/controller_base.h"
 #include "rotors_control/controller_factory.h"
+#include "rotors_control/rotor_mixer.h"
+
+namespace rotors_control {
 
 class AttitudeController : public ControllerBase {
  public:
@@ -34,8 +37,8 @@ class AttitudeController : public ControllerBase {
 
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
  private:
-  Eigen::Matrix4Xd allocation_matrix_;
   Eigen::MatrixX4d angular_acc_to_rotor_velocities_;
+  std::shared_ptr<const RotorMixerBase> mixer_;
   Eigen::Vector3d gain_attitude_;
   Eigen::Vector3d gain_angular_rate_;
   Eigen::Matrix3d inertia_matrix_;
@@ -47,4 +50,6 @@ class AttitudeController : public ControllerBase {
 
 };
 
+}
+
 #endif // ROTORS_CONTROL_ATTITUDE_CONTROLLER_H
@@ -23,6 +23,7 @@
 
 #include <assert.h>
 
+#include <mav_msgs/Actuators.h>
 #include <mav_msgs/conversions.h>
 #include <mav_msgs/default_topics.h>
 #include <nav_msgs/Odometry.h>
@@ -76,6 +77,22 @@ inline void eigenOdometryFromMsg(const nav_msgs::OdometryConstPtr& msg,
   odometry->angular_velocity = mav_msgs::vector3FromMsg(msg->twist.twist.angular);
 }
 
+// Fills *msg with the rotor velocities. The message is reused if nobody else
+// holds it any more, e.g. an intra-process subscriber of the last publish, so
+// that publishing at the odometry rate does not allocate.
+inline void actuatorsMsgFromRotorVelocities(const Eigen::VectorXd& rotor_velocities,
+                                            const ros::Time& stamp,
+                                            mav_msgs::ActuatorsPtr* msg) {
+  assert(msg != nullptr);
+  if (!*msg || !msg->unique()) {
+    msg->reset(new mav_msgs::Actuators);
+  }
+  (*msg)->header.stamp = stamp;
+  (*msg)->angular_velocities.resize(rotor_velocities.size());
+  Eigen::VectorXd::Map((*msg)->angular_velocities.data(), rotor_velocities.size()) =
+      rotor_velocities;
+}
+
 inline void calculateAllocationMatrix(const RotorConfiguration& rotor_configuration,
                                       Eigen::Matrix4Xd* allocation_matrix) {
   assert(allocation_matrix != nullptr);
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_CONTROL_CONTROLLER_BASE_H
+#define ROTORS_CONTROL_CONTROLLER_BASE_H
+
+#include <memory>
+
+#include <Eigen/Eigen>
+
+namespace rotors_control {
+
+// Base of the controllers that are created by name through the
+// ControllerFactory, e.g. to run them inside the Gazebo controller interface.
+// The state and the references are set from outside, before every call of
+// CalculateRotorVelocities().
+class ControllerBase {
+ public:
+  ControllerBase()
+      : initialized_params_(false),
+        amount_rotors_(0),
+        attitude_(Eigen::Quaterniond::Identity()),
+        angular_rate_(Eigen::Vector3d::Zero()),
+        control_attitude_thrust_reference_(Eigen::Vector4d::Zero()),
+        control_rate_thrust_reference_(Eigen::Vector4d::Zero()) {}
+  virtual ~ControllerBase() {}
+
+  virtual void InitializeParams() = 0;
+  // Returns a new, uninitialized controller of the same type.
+  virtual std::shared_ptr<ControllerBase> Clone() = 0;
+  virtual void CalculateRotorVelocities(Eigen::VectorXd* rotor_velocities) const = 0;
+
+  // Attitude of the body in world frame.
+  void SetAttitude(const Eigen::Quaterniond& attitude) {
+    attitude_ = attitude;
+  }
+  // Angular rate in body frame.
+  void SetAngularRate(const Eigen::Vector3d& angular_rate) {
+    angular_rate_ = angular_rate;
+  }
+  // Roll [rad], pitch [rad], yaw rate [rad/s] and thrust [N].
+  void SetAttitudeThrustReference(
+      const Eigen::Vector4d& control_attitude_thrust_reference) {
+    control_attitude_thrust_reference_ = control_attitude_thrust_reference;
+  }
+  // Body rates [rad/s] and thrust [N].
+  void SetRateThrustReference(
+      const Eigen::Vector4d& control_rate_thrust_reference) {
+    control_rate_thrust_reference_ = control_rate_thrust_reference;
+  }
+  // Rotor velocities [rad/s].
+  void SetMotorReference(const Eigen::VectorXd& motor_reference) {
+    motor_reference_ = motor_reference;
+  }
+
+  int GetNumberOfRotors() const { return amount_rotors_; }
+  bool IsInitialized() const { return initialized_params_; }
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+ protected:
+  bool initialized_params_;
+  int amount_rotors_;
+
+  Eigen::Quaterniond attitude_;
+  Eigen::Vector3d angular_rate_;
+  Eigen::Vector4d control_attitude_thrust_reference_;
+  Eigen::Vector4d control_rate_thrust_reference_;
+  Eigen::VectorXd motor_reference_;
+};
+
+}
+
+#endif // ROTORS_CONTROL_CONTROLLER_BASE_H
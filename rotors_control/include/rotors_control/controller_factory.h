@@ -0,0 +1,68 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_CONTROL_CONTROLLER_FACTORY_H
+#define ROTORS_CONTROL_CONTROLLER_FACTORY_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rotors_control/controller_base.h"
+
+namespace rotors_control {
+
+// Registry of the controllers that can be created by name. Every controller
+// registers a prototype with ROTORS_CONTROL_REGISTER_CONTROLLER when its
+// library is loaded, CreateController() returns a clone of it.
+class ControllerFactory {
+ public:
+  static ControllerFactory& Instance();
+
+  // Returns a new, uninitialized controller, or nullptr if no controller of
+  // that name is registered.
+  std::shared_ptr<ControllerBase> CreateController(const std::string& controller_name) const;
+
+  // Runs during static initialization, so it does not log. Returns false if
+  // a controller of that name is already registered.
+  bool RegisterController(const std::string& controller_name,
+                          const std::shared_ptr<ControllerBase>& prototype);
+
+  std::vector<std::string> ControllerNames() const;
+
+ private:
+  ControllerFactory() {}
+  ControllerFactory(const ControllerFactory&) = delete;
+  ControllerFactory& operator=(const ControllerFactory&) = delete;
+
+  std::map<std::string, std::shared_ptr<ControllerBase>> prototypes_;
+};
+
+}
+
+// Registers a controller class under its name, use it in the source file of
+// the controller, inside the rotors_control namespace.
+#define ROTORS_CONTROL_REGISTER_CONTROLLER(controller) \
+  static const bool controller ## _registered = \
+      ControllerFactory::Instance().RegisterController( \
+          #controller, std::shared_ptr<ControllerBase>(new controller))
+
+#endif // ROTORS_CONTROL_CONTROLLER_FACTORY_H
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_CONTROL_DOUBLE_BUFFER_H
+#define ROTORS_CONTROL_DOUBLE_BUFFER_H
+
+#include <atomic>
+
+namespace rotors_control {
+
+// Holds two copies of a value, one being read while the other is written.
+// Write() fills the back copy and then publishes it with a single atomic
+// store, so a reader never blocks and never sees a half-written value.
+// Meant for one writer that updates rarely (e.g. new gains from a tuning
+// tool): a value returned by Read() stays valid until the second Write()
+// after it, so writes must not come faster than one read-side computation.
+template <typename T>
+class DoubleBuffer {
+ public:
+  DoubleBuffer() : front_(0) {}
+  explicit DoubleBuffer(const T& value) : front_(0) {
+    buffers_[0] = value;
+  }
+  DoubleBuffer(const DoubleBuffer& other) : front_(0) {
+    buffers_[0] = other.Read();
+  }
+  DoubleBuffer& operator=(const DoubleBuffer& other) {
+    Write(other.Read());
+    return *this;
+  }
+
+  const T& Read() const {
+    return buffers_[front_.load(std::memory_order_acquire)];
+  }
+
+  void Write(const T& value) {
+    const int back = 1 - front_.load(std::memory_order_relaxed);
+    buffers_[back] = value;
+    front_.store(back, std::memory_order_release);
+  }
+
+ private:
+  T buffers_[2];
+  std::atomic<int> front_;
+};
+
+}
+
+#endif // ROTORS_CONTROL_DOUBLE_BUFFER_H
@@ -25,7 +25,9 @@
 #include <mav_msgs/eigen_mav_msgs.h>
 
 #include "rotors_control/common.h"
+#include "rotors_control/double_buffer.h"
 #include "rotors_control/parameters.h"
+#include "rotors_control/rotor_mixer.h"
 
 namespace rotors_control {
 
@@ -43,7 +45,7 @@ class LeePositionControllerParameters {
         velocity_gain_(kDefaultVelocityGain),
         attitude_gain_(kDefaultAttitudeGain),
         angular_rate_gain_(kDefaultAngularRateGain) {
-    calculateAllocationMatrix(rotor_configuration_, &allocation_matrix_);
+    allocation_matrix_ = RotorAllocation::Get(rotor_configuration_)->allocation_matrix();
   }
 
   Eigen::Matrix4Xd allocation_matrix_;
@@ -54,13 +56,40 @@ class LeePositionControllerParameters {
   RotorConfiguration rotor_configuration_;
 };
 
+// Gains used by the control loop, the attitude and angular rate gains are
+// already divided by the inertia.
+struct LeePositionControllerGains {
+  Eigen::Vector3d position_gain;
+  Eigen::Vector3d velocity_gain;
+  Eigen::Vector3d normalized_attitude_gain;
+  Eigen::Vector3d normalized_angular_rate_gain;
+};
+
 class LeePositionController {
  public:
   LeePositionController();
   ~LeePositionController();
   void InitializeParameters();
+  // Normalizes the gains of controller_parameters_ and swaps them in, without
+  // recomputing the mixer. Can be called from another thread while the
+  // controller runs, see DoubleBuffer for the limits.
+  void UpdateGains();
   void CalculateRotorVelocities(Eigen::VectorXd* rotor_velocities) const;
 
+  // Computes the desired angular acceleration (first three elements) and
+  // thrust (last element) for the given state and command, independent of the
+  // state stored in the controller. Used to evaluate many vehicles that share
+  // the parameters of this controller.
+  void CalculateAngularAccelerationThrust(
+      const EigenOdometry& odometry,
+      const mav_msgs::EigenTrajectoryPoint& command_trajectory,
+      Eigen::Vector4d* angular_acceleration_thrust) const;
+
+  // Maps the angular acceleration and thrust to squared rotor velocities.
+  const Eigen::MatrixX4d& angular_acc_to_rotor_velocities() const {
+    return angular_acc_to_rotor_velocities_;
+  }
+
   void SetOdometry(const EigenOdometry& odometry);
   void SetTrajectoryPoint(
     const mav_msgs::EigenTrajectoryPoint& command_trajectory);
@@ -73,16 +102,25 @@ class LeePositionController {
   bool initialized_params_;
   bool controller_active_;
 
-  Eigen::Vector3d normalized_attitude_gain_;
-  Eigen::Vector3d normalized_angular_rate_gain_;
+  DoubleBuffer<LeePositionControllerGains> gains_;
   Eigen::MatrixX4d angular_acc_to_rotor_velocities_;
+  // Mixer specialized for the rotor count, created from
+  // angular_acc_to_rotor_velocities_ in InitializeParameters().
+  // Shared between copies of the controller, it is never modified.
+  std::shared_ptr<const RotorMixerBase> mixer_;
 
   mav_msgs::EigenTrajectoryPoint command_trajectory_;
   EigenOdometry odometry_;
 
-  void ComputeDesiredAngularAcc(const Eigen::Vector3d& acceleration,
+  void ComputeDesiredAngularAcc(const LeePositionControllerGains& gains,
+                                const EigenOdometry& odometry,
+                                const mav_msgs::EigenTrajectoryPoint& command_trajectory,
+                                const Eigen::Vector3d& acceleration,
                                 Eigen::Vector3d* angular_acceleration) const;
-  void ComputeDesiredAcceleration(Eigen::Vector3d* acceleration) const;
+  void ComputeDesiredAcceleration(const LeePositionControllerGains& gains,
+                                  const EigenOdometry& odometry,
+                                  const mav_msgs::EigenTrajectoryPoint& command_trajectory,
+                                  Eigen::Vector3d* acceleration) const;
 };
 }
 
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_CONTROL_LEE_POSITION_CONTROLLER_BATCH_H
+#define ROTORS_CONTROL_LEE_POSITION_CONTROLLER_BATCH_H
+
+#include <vector>
+
+#include <Eigen/Eigen>
+
+#include "rotors_control/lee_position_controller.h"
+
+namespace rotors_control {
+
+// Evaluates the Lee position controller for many vehicles with the same
+// parameters in one call, e.g. for a swarm of identical MAVs or a gain sweep
+// over many seeds. The states and references are stored as structure of
+// arrays, one column per vehicle. The attitude part runs per vehicle on
+// fixed-size types, the mixing of all vehicles is a single matrix product.
+class LeePositionControllerBatch {
+ public:
+  struct Odometry {
+    void Resize(int num_vehicles);
+
+    // World frame.
+    Eigen::Matrix3Xd position;
+    // Quaternion coefficients in Eigen order (x, y, z, w).
+    Eigen::Matrix4Xd orientation;
+    // Body frame.
+    Eigen::Matrix3Xd velocity;
+    Eigen::Matrix3Xd angular_velocity;
+  };
+
+  struct Reference {
+    void Resize(int num_vehicles);
+
+    // World frame.
+    Eigen::Matrix3Xd position_W;
+    Eigen::Matrix3Xd velocity_W;
+    Eigen::Matrix3Xd acceleration_W;
+    Eigen::RowVectorXd yaw;
+    Eigen::RowVectorXd yaw_rate;
+    // Vehicles that did not get a reference yet get zero rotor velocities,
+    // like LeePositionController before the first command.
+    std::vector<bool> active;
+  };
+
+  // The controller has to be initialized, only its parameters are used.
+  explicit LeePositionControllerBatch(const LeePositionController& controller);
+
+  // Computes the rotor velocities of all vehicles, one column per vehicle.
+  // rotor_velocities is only resized if its size changed.
+  void CalculateRotorVelocities(const Odometry& odometry, const Reference& reference,
+                                Eigen::MatrixXd* rotor_velocities);
+
+  int rotor_count() const { return controller_.angular_acc_to_rotor_velocities().rows(); }
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+ private:
+  LeePositionController controller_;
+
+  // Angular acceleration and thrust of all vehicles, reused between calls.
+  Eigen::Matrix4Xd angular_acceleration_thrust_;
+};
+}
+
+#endif // ROTORS_CONTROL_LEE_POSITION_CONTROLLER_BATCH_H
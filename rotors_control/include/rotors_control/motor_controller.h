@@ -24,6 +24,8 @@
 #include "rotors_control/controller_base.h"
 #include "rotors_control/controller_factory.h"
 
+namespace rotors_control {
+
 class MotorController : public ControllerBase {
  public:
   MotorController();
@@ -34,11 +36,11 @@ class MotorController : public ControllerBase {
 
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
  private:
-  Eigen::Matrix4Xd allocation_matrix_;
-  Eigen::MatrixX4d angular_acc_to_rotor_velocities_;
   Eigen::Vector3d gain_attitude_;
   Eigen::Vector3d gain_angular_rate_;
   Eigen::Matrix3d inertia_matrix_;
 };
 
+}
+
 #endif // ROTORS_CONTROL_MOTOR_CONTROLLER_H
@@ -26,6 +26,7 @@
 
 #include "rotors_control/common.h"
 #include "rotors_control/parameters.h"
+#include "rotors_control/rotor_mixer.h"
 
 namespace rotors_control {
 
@@ -39,7 +40,7 @@ class RollPitchYawrateThrustControllerParameters {
   RollPitchYawrateThrustControllerParameters()
       : attitude_gain_(kDefaultAttitudeGain),
         angular_rate_gain_(kDefaultAngularRateGain) {
-    calculateAllocationMatrix(rotor_configuration_, &allocation_matrix_);
+    allocation_matrix_ = RotorAllocation::Get(rotor_configuration_)->allocation_matrix();
   }
 
   Eigen::Matrix4Xd allocation_matrix_;
@@ -70,6 +71,9 @@ class RollPitchYawrateThrustController {
   Eigen::Vector3d normalized_attitude_gain_;
   Eigen::Vector3d normalized_angular_rate_gain_;
   Eigen::MatrixX4d angular_acc_to_rotor_velocities_;
+  // Mixer specialized for the rotor count, created from
+  // angular_acc_to_rotor_velocities_ in InitializeParameters().
+  std::shared_ptr<const RotorMixerBase> mixer_;
 
   mav_msgs::EigenRollPitchYawrateThrust roll_pitch_yawrate_thrust_;
   EigenOdometry odometry_;
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_CONTROL_ROTOR_MIXER_H
+#define ROTORS_CONTROL_ROTOR_MIXER_H
+
+#include <cassert>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <Eigen/Eigen>
+
+#include "rotors_control/common.h"
+#include "rotors_control/parameters.h"
+
+namespace rotors_control {
+
+/// \brief  Allocation matrix A of a rotor configuration and its pseudo-inverse
+///         A^{ \dagger} = A^T*(A*A^T)^{-1}, computed once per distinct
+///         configuration and shared by all controllers through Get().
+class RotorAllocation {
+ public:
+  explicit RotorAllocation(const RotorConfiguration& rotor_configuration) {
+    calculateAllocationMatrix(rotor_configuration, &allocation_matrix_);
+    pseudo_inverse_ = allocation_matrix_.transpose()
+        * (allocation_matrix_ * allocation_matrix_.transpose()).inverse();
+  }
+
+  int rotor_count() const { return allocation_matrix_.cols(); }
+
+  /// \brief  Maps the squared rotor velocities to the moments and thrust.
+  const Eigen::Matrix4Xd& allocation_matrix() const { return allocation_matrix_; }
+
+  /// \brief  Maps the moments and thrust to squared rotor velocities.
+  const Eigen::MatrixX4d& pseudo_inverse() const { return pseudo_inverse_; }
+
+  /// \brief  Maps the angular acceleration and thrust to squared rotor
+  ///         velocities for a vehicle with the given inertia.
+  /// \details  Only scales the cached pseudo-inverse, so changing the inertia
+  ///           or the gains of a controller does not invert A again.
+  void AngularAccToRotorVelocities(
+      const Eigen::Matrix3d& inertia,
+      Eigen::MatrixX4d* angular_acc_to_rotor_velocities) const {
+    assert(angular_acc_to_rotor_velocities);
+    angular_acc_to_rotor_velocities->resize(rotor_count(), 4);
+    angular_acc_to_rotor_velocities->leftCols<3>().noalias() =
+        pseudo_inverse_.leftCols<3>() * inertia;
+    angular_acc_to_rotor_velocities->col(3) = pseudo_inverse_.col(3);
+  }
+
+  /// \brief  Returns the allocation of rotor_configuration, computing it on
+  ///         the first request for this configuration. Thread-safe.
+  static std::shared_ptr<const RotorAllocation> Get(
+      const RotorConfiguration& rotor_configuration) {
+    // The configurations are compared by value, the same vehicle loaded by
+    // several controllers or nodelets shares one entry.
+    std::vector<double> key;
+    key.reserve(5 * rotor_configuration.rotors.size());
+    for (const Rotor& rotor : rotor_configuration.rotors) {
+      key.push_back(rotor.angle);
+      key.push_back(rotor.arm_length);
+      key.push_back(rotor.rotor_force_constant);
+      key.push_back(rotor.rotor_moment_constant);
+      key.push_back(rotor.direction);
+    }
+
+    static std::mutex cache_mutex;
+    static std::map<std::vector<double>, std::shared_ptr<const RotorAllocation> >
+        cache;
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    std::shared_ptr<const RotorAllocation>& allocation = cache[key];
+    if (!allocation) {
+      allocation = std::make_shared<RotorAllocation>(rotor_configuration);
+    }
+    return allocation;
+  }
+
+ private:
+  Eigen::Matrix4Xd allocation_matrix_;
+  Eigen::MatrixX4d pseudo_inverse_;
+};
+
+/// \brief  Maps the desired angular acceleration and thrust to rotor
+///         velocities, for a vehicle with a rotor count known at runtime.
+class RotorMixerBase {
+ public:
+  virtual ~RotorMixerBase() {}
+
+  virtual int rotor_count() const = 0;
+
+  /// \brief  Computes the rotor velocities [rad/s], negative squared
+  ///         velocities are clamped to zero.
+  /// \details  rotor_velocities is only resized if it does not have rotor_count()
+  ///           elements yet, so reusing it avoids all allocations.
+  virtual void CalculateRotorVelocities(
+      const Eigen::Vector4d& angular_acceleration_thrust,
+      Eigen::VectorXd* rotor_velocities) const = 0;
+};
+
+/// \brief  Mixer for NumRotors rotors, with fixed-size matrices so that the
+///         mixing is unrolled and does not touch the heap. Eigen::Dynamic is
+///         the fallback for other rotor counts.
+template <int NumRotors>
+class RotorMixer : public RotorMixerBase {
+ public:
+  typedef Eigen::Matrix<double, NumRotors, 4> MixingMatrix;
+  typedef Eigen::Matrix<double, NumRotors, 1> RotorVector;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /// \param[in]  angular_acc_to_rotor_velocities  Maps the angular
+  ///             acceleration and thrust to squared rotor velocities.
+  explicit RotorMixer(const Eigen::MatrixX4d& angular_acc_to_rotor_velocities)
+      : angular_acc_to_rotor_velocities_(angular_acc_to_rotor_velocities) {}
+
+  int rotor_count() const { return angular_acc_to_rotor_velocities_.rows(); }
+
+  void CalculateRotorVelocities(
+      const Eigen::Vector4d& angular_acceleration_thrust,
+      Eigen::VectorXd* rotor_velocities) const {
+    assert(rotor_velocities);
+    if (rotor_velocities->size() != rotor_count()) {
+      rotor_velocities->resize(rotor_count());
+    }
+    // Fixed-size temporary, lives on the stack unless NumRotors is dynamic.
+    const RotorVector squared_rotor_velocities =
+        angular_acc_to_rotor_velocities_ * angular_acceleration_thrust;
+    *rotor_velocities = squared_rotor_velocities.cwiseMax(0.0).cwiseSqrt();
+  }
+
+ private:
+  MixingMatrix angular_acc_to_rotor_velocities_;
+};
+
+/// \brief  Creates the mixer specialized for the number of rows of
+///         angular_acc_to_rotor_velocities, falls back to the dynamic one for
+///         rotor counts other than 4, 6 and 8.
+inline std::unique_ptr<RotorMixerBase> MakeRotorMixer(
+    const Eigen::MatrixX4d& angular_acc_to_rotor_velocities) {
+  std::unique_ptr<RotorMixerBase> mixer;
+  switch (angular_acc_to_rotor_velocities.rows()) {
+    case 4:
+      mixer.reset(new RotorMixer<4>(angular_acc_to_rotor_velocities));
+      break;
+    case 6:
+      mixer.reset(new RotorMixer<6>(angular_acc_to_rotor_velocities));
+      break;
+    case 8:
+      mixer.reset(new RotorMixer<8>(angular_acc_to_rotor_velocities));
+      break;
+    default:
+      mixer.reset(new RotorMixer<Eigen::Dynamic>(angular_acc_to_rotor_velocities));
+      break;
+  }
+  return mixer;
+}
+
+}  // namespace rotors_control
+
+#endif  // ROTORS_CONTROL_ROTOR_MIXER_H
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_CONTROL_TRAJECTORY_BUFFER_H
+#define ROTORS_CONTROL_TRAJECTORY_BUFFER_H
+
+#include <stdint.h>
+
+#include <mav_msgs/eigen_mav_msgs.h>
+
+namespace rotors_control {
+
+// Stores the points of a trajectory in one contiguous array and samples the
+// reference at an arbitrary time, so that the controller can look up its
+// reference on every odometry message instead of stepping through the points
+// with a timer.
+class TrajectoryBuffer {
+ public:
+  TrajectoryBuffer();
+
+  void Clear();
+  bool empty() const { return points_.empty(); }
+  size_t size() const { return points_.size(); }
+
+  // Time [ns] at which time_from_start_ns of the points is zero.
+  void SetStartTime(int64_t start_time_ns) { start_time_ns_ = start_time_ns; }
+
+  void Reserve(size_t num_points) { points_.reserve(num_points); }
+  // Points have to be added in order of time_from_start_ns, returns false
+  // and ignores the point if it is earlier than the last one.
+  bool PushBack(const mav_msgs::EigenTrajectoryPoint& point);
+
+  // Time [ns] after which Sample() always returns the last point.
+  int64_t EndTime() const;
+
+  // Finds the points around time_ns by binary search and interpolates the
+  // position, velocity, acceleration and angular velocity linearly and the
+  // orientation spherically between them. Before the first point the first
+  // point is returned, after the last one the last point.
+  void Sample(int64_t time_ns, mav_msgs::EigenTrajectoryPoint* point) const;
+
+ private:
+  int64_t start_time_ns_;
+  mav_msgs::EigenTrajectoryPointVector points_;
+};
+
+}
+
+#endif // ROTORS_CONTROL_TRAJECTORY_BUFFER_H
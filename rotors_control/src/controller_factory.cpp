@@ -0,0 +1,53 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_control/controller_factory.h"
+
+namespace rotors_control {
+
+ControllerFactory& ControllerFactory::Instance() {
+  // Constructed on first use, so that it exists when the controllers register
+  // during static initialization.
+  static ControllerFactory instance;
+  return instance;
+}
+
+std::shared_ptr<ControllerBase> ControllerFactory::CreateController(
+    const std::string& controller_name) const {
+  auto prototype = prototypes_.find(controller_name);
+  if (prototype == prototypes_.end())
+    return nullptr;
+  return prototype->second->Clone();
+}
+
+bool ControllerFactory::RegisterController(
+    const std::string& controller_name,
+    const std::shared_ptr<ControllerBase>& prototype) {
+  return prototypes_.emplace(controller_name, prototype).second;
+}
+
+std::vector<std::string> ControllerFactory::ControllerNames() const {
+  std::vector<std::string> names;
+  for (const auto& prototype : prototypes_)
+    names.push_back(prototype.first);
+  return names;
+}
+
+}
@@ -31,54 +31,70 @@ LeePositionController::LeePositionController()
 LeePositionController::~LeePositionController() {}
 
 void LeePositionController::InitializeParameters() {
-  calculateAllocationMatrix(vehicle_parameters_.rotor_configuration_, &(controller_parameters_.allocation_matrix_));
+  std::shared_ptr<const RotorAllocation> rotor_allocation =
+      RotorAllocation::Get(vehicle_parameters_.rotor_configuration_);
+  controller_parameters_.allocation_matrix_ = rotor_allocation->allocation_matrix();
+  UpdateGains();
+
+  // The pseudo-inverse A^{ \dagger} = A^T*(A*A^T)^{-1} is cached per rotor
+  // configuration, only its multiplication by the inertia matrix is redone.
+  rotor_allocation->AngularAccToRotorVelocities(vehicle_parameters_.inertia_,
+                                                &angular_acc_to_rotor_velocities_);
+  mixer_ = MakeRotorMixer(angular_acc_to_rotor_velocities_);
+  initialized_params_ = true;
+}
+
+void LeePositionController::UpdateGains() {
+  LeePositionControllerGains gains;
+  gains.position_gain = controller_parameters_.position_gain_;
+  gains.velocity_gain = controller_parameters_.velocity_gain_;
   // To make the tuning independent of the inertia matrix we divide here.
-  normalized_attitude_gain_ = controller_parameters_.attitude_gain_.transpose()
+  gains.normalized_attitude_gain = controller_parameters_.attitude_gain_.transpose()
       * vehicle_parameters_.inertia_.inverse();
   // To make the tuning independent of the inertia matrix we divide here.
-  normalized_angular_rate_gain_ = controller_parameters_.angular_rate_gain_.transpose()
+  gains.normalized_angular_rate_gain = controller_parameters_.angular_rate_gain_.transpose()
       * vehicle_parameters_.inertia_.inverse();
-
-  Eigen::Matrix4d I;
-  I.setZero();
-  I.block<3, 3>(0, 0) = vehicle_parameters_.inertia_;
-  I(3, 3) = 1;
-  angular_acc_to_rotor_velocities_.resize(vehicle_parameters_.rotor_configuration_.rotors.size(), 4);
-  // Calculate the pseude-inverse A^{ \dagger} and then multiply by the inertia matrix I.
-  // A^{ \dagger} = A^T*(A*A^T)^{-1}
-  angular_acc_to_rotor_velocities_ = controller_parameters_.allocation_matrix_.transpose()
-      * (controller_parameters_.allocation_matrix_
-      * controller_parameters_.allocation_matrix_.transpose()).inverse() * I;
-  initialized_params_ = true;
+  gains_.Write(gains);
 }
 
 void LeePositionController::CalculateRotorVelocities(Eigen::VectorXd* rotor_velocities) const {
   assert(rotor_velocities);
   assert(initialized_params_);
 
-  rotor_velocities->resize(vehicle_parameters_.rotor_configuration_.rotors.size());
   // Return 0 velocities on all rotors, until the first command is received.
   if (!controller_active_) {
-    *rotor_velocities = Eigen::VectorXd::Zero(rotor_velocities->rows());
+    rotor_velocities->setZero(mixer_->rotor_count());
     return;
   }
 
+  Eigen::Vector4d angular_acceleration_thrust;
+  CalculateAngularAccelerationThrust(odometry_, command_trajectory_,
+                                     &angular_acceleration_thrust);
+
+  mixer_->CalculateRotorVelocities(angular_acceleration_thrust, rotor_velocities);
+}
+
+void LeePositionController::CalculateAngularAccelerationThrust(
+    const EigenOdometry& odometry,
+    const mav_msgs::EigenTrajectoryPoint& command_trajectory,
+    Eigen::Vector4d* angular_acceleration_thrust) const {
+  assert(angular_acceleration_thrust);
+
+  // Both loops use the same gain set, even if new gains are swapped in meanwhile.
+  const LeePositionControllerGains& gains = gains_.Read();
+
   Eigen::Vector3d acceleration;
-  ComputeDesiredAcceleration(&acceleration);
+  ComputeDesiredAcceleration(gains, odometry, command_trajectory, &acceleration);
 
   Eigen::Vector3d angular_acceleration;
-  ComputeDesiredAngularAcc(acceleration, &angular_acceleration);
+  ComputeDesiredAngularAcc(gains, odometry, command_trajectory, acceleration,
+                           &angular_acceleration);
 
   // Project thrust onto body z axis.
-  double thrust = -vehicle_parameters_.mass_ * acceleration.dot(odometry_.orientation.toRotationMatrix().col(2));
-
-  Eigen::Vector4d angular_acceleration_thrust;
-  angular_acceleration_thrust.block<3, 1>(0, 0) = angular_acceleration;
-  angular_acceleration_thrust(3) = thrust;
+  double thrust = -vehicle_parameters_.mass_ * acceleration.dot(odometry.orientation.toRotationMatrix().col(2));
 
-  *rotor_velocities = angular_acc_to_rotor_velocities_ * angular_acceleration_thrust;
-  *rotor_velocities = rotor_velocities->cwiseMax(Eigen::VectorXd::Zero(rotor_velocities->rows()));
-  *rotor_velocities = rotor_velocities->cwiseSqrt();
+  angular_acceleration_thrust->block<3, 1>(0, 0) = angular_acceleration;
+  (*angular_acceleration_thrust)(3) = thrust;
 }
 
 void LeePositionController::SetOdometry(const EigenOdometry& odometry) {
@@ -91,36 +107,44 @@ void LeePositionController::SetTrajectoryPoint(
   controller_active_ = true;
 }
 
-void LeePositionController::ComputeDesiredAcceleration(Eigen::Vector3d* acceleration) const {
+void LeePositionController::ComputeDesiredAcceleration(
+    const LeePositionControllerGains& gains,
+    const EigenOdometry& odometry,
+    const mav_msgs::EigenTrajectoryPoint& command_trajectory,
+    Eigen::Vector3d* acceleration) const {
   assert(acceleration);
 
   Eigen::Vector3d position_error;
-  position_error = odometry_.position - command_trajectory_.position_W;
+  position_error = odometry.position - command_trajectory.position_W;
 
   // Transform velocity to world frame.
-  const Eigen::Matrix3d R_W_I = odometry_.orientation.toRotationMatrix();
-  Eigen::Vector3d velocity_W =  R_W_I * odometry_.velocity;
+  const Eigen::Matrix3d R_W_I = odometry.orientation.toRotationMatrix();
+  Eigen::Vector3d velocity_W =  R_W_I * odometry.velocity;
   Eigen::Vector3d velocity_error;
-  velocity_error = velocity_W - command_trajectory_.velocity_W;
+  velocity_error = velocity_W - command_trajectory.velocity_W;
 
   Eigen::Vector3d e_3(Eigen::Vector3d::UnitZ());
 
-  *acceleration = (position_error.cwiseProduct(controller_parameters_.position_gain_)
-      + velocity_error.cwiseProduct(controller_parameters_.velocity_gain_)) / vehicle_parameters_.mass_
-      - vehicle_parameters_.gravity_ * e_3 - command_trajectory_.acceleration_W;
+  *acceleration = (position_error.cwiseProduct(gains.position_gain)
+      + velocity_error.cwiseProduct(gains.velocity_gain)) / vehicle_parameters_.mass_
+      - vehicle_parameters_.gravity_ * e_3 - command_trajectory.acceleration_W;
 }
 
 // Implementation from the T. Lee et al. paper
 // Control of complex maneuvers for a quadrotor UAV using geometric methods on SE(3)
-void LeePositionController::ComputeDesiredAngularAcc(const Eigen::Vector3d& acceleration,
-                                                     Eigen::Vector3d* angular_acceleration) const {
+void LeePositionController::ComputeDesiredAngularAcc(
+    const LeePositionControllerGains& gains,
+    const EigenOdometry& odometry,
+    const mav_msgs::EigenTrajectoryPoint& command_trajectory,
+    const Eigen::Vector3d& acceleration,
+    Eigen::Vector3d* angular_acceleration) const {
   assert(angular_acceleration);
 
-  Eigen::Matrix3d R = odometry_.orientation.toRotationMatrix();
+  Eigen::Matrix3d R = odometry.orientation.toRotationMatrix();
 
   // Get the desired rotation matrix.
   Eigen::Vector3d b1_des;
-  double yaw = command_trajectory_.getYaw();
+  double yaw = command_trajectory.getYaw();
   b1_des << cos(yaw), sin(yaw), 0;
 
   Eigen::Vector3d b3_des;
@@ -142,12 +166,12 @@ void LeePositionController::ComputeDesiredAngularAcc(const Eigen::Vector3d& acce
 
   // TODO(burrimi) include angular rate references at some point.
   Eigen::Vector3d angular_rate_des(Eigen::Vector3d::Zero());
-  angular_rate_des[2] = command_trajectory_.getYawRate();
+  angular_rate_des[2] = command_trajectory.getYawRate();
 
-  Eigen::Vector3d angular_rate_error = odometry_.angular_velocity - R_des.transpose() * R * angular_rate_des;
+  Eigen::Vector3d angular_rate_error = odometry.angular_velocity - R_des.transpose() * R * angular_rate_des;
 
-  *angular_acceleration = -1 * angle_error.cwiseProduct(normalized_attitude_gain_)
-                           - angular_rate_error.cwiseProduct(normalized_angular_rate_gain_)
-                           + odometry_.angular_velocity.cross(odometry_.angular_velocity); // we don't need the inertia matrix here
+  *angular_acceleration = -1 * angle_error.cwiseProduct(gains.normalized_attitude_gain)
+                           - angular_rate_error.cwiseProduct(gains.normalized_angular_rate_gain)
+                           + odometry.angular_velocity.cross(odometry.angular_velocity); // we don't need the inertia matrix here
 }
 }
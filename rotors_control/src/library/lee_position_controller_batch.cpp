@@ -0,0 +1,90 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_control/lee_position_controller_batch.h"
+
+namespace rotors_control {
+
+void LeePositionControllerBatch::Odometry::Resize(int num_vehicles) {
+  position.setZero(3, num_vehicles);
+  orientation.setZero(4, num_vehicles);
+  orientation.row(3).setOnes();
+  velocity.setZero(3, num_vehicles);
+  angular_velocity.setZero(3, num_vehicles);
+}
+
+void LeePositionControllerBatch::Reference::Resize(int num_vehicles) {
+  position_W.setZero(3, num_vehicles);
+  velocity_W.setZero(3, num_vehicles);
+  acceleration_W.setZero(3, num_vehicles);
+  yaw.setZero(num_vehicles);
+  yaw_rate.setZero(num_vehicles);
+  active.assign(num_vehicles, false);
+}
+
+LeePositionControllerBatch::LeePositionControllerBatch(const LeePositionController& controller)
+    : controller_(controller) {}
+
+void LeePositionControllerBatch::CalculateRotorVelocities(const Odometry& odometry,
+                                                          const Reference& reference,
+                                                          Eigen::MatrixXd* rotor_velocities) {
+  assert(rotor_velocities);
+  const int num_vehicles = odometry.position.cols();
+  assert(reference.position_W.cols() == num_vehicles);
+  assert(reference.active.size() == static_cast<std::size_t>(num_vehicles));
+
+  if (angular_acceleration_thrust_.cols() != num_vehicles) {
+    angular_acceleration_thrust_.resize(4, num_vehicles);
+  }
+
+  EigenOdometry vehicle_odometry;
+  mav_msgs::EigenTrajectoryPoint vehicle_reference;
+  Eigen::Vector4d angular_acceleration_thrust;
+  for (int i = 0; i < num_vehicles; ++i) {
+    if (!reference.active[i]) {
+      // Mixes to zero rotor velocities.
+      angular_acceleration_thrust_.col(i).setZero();
+      continue;
+    }
+    vehicle_odometry.position = odometry.position.col(i);
+    vehicle_odometry.orientation = Eigen::Quaterniond(Eigen::Vector4d(odometry.orientation.col(i)));
+    vehicle_odometry.velocity = odometry.velocity.col(i);
+    vehicle_odometry.angular_velocity = odometry.angular_velocity.col(i);
+
+    vehicle_reference.position_W = reference.position_W.col(i);
+    vehicle_reference.velocity_W = reference.velocity_W.col(i);
+    vehicle_reference.acceleration_W = reference.acceleration_W.col(i);
+    vehicle_reference.setFromYaw(reference.yaw[i]);
+    vehicle_reference.setFromYawRate(reference.yaw_rate[i]);
+
+    controller_.CalculateAngularAccelerationThrust(vehicle_odometry, vehicle_reference,
+                                                   &angular_acceleration_thrust);
+    angular_acceleration_thrust_.col(i) = angular_acceleration_thrust;
+  }
+
+  if (rotor_velocities->rows() != rotor_count() || rotor_velocities->cols() != num_vehicles) {
+    rotor_velocities->resize(rotor_count(), num_vehicles);
+  }
+  rotor_velocities->noalias() =
+      controller_.angular_acc_to_rotor_velocities() * angular_acceleration_thrust_;
+  *rotor_velocities = rotor_velocities->cwiseMax(0.0).cwiseSqrt();
+}
+
+}
@@ -31,7 +31,9 @@ RollPitchYawrateThrustController::RollPitchYawrateThrustController()
 RollPitchYawrateThrustController::~RollPitchYawrateThrustController() {}
 
 void RollPitchYawrateThrustController::InitializeParameters() {
-  calculateAllocationMatrix(vehicle_parameters_.rotor_configuration_, &(controller_parameters_.allocation_matrix_));
+  std::shared_ptr<const RotorAllocation> rotor_allocation =
+      RotorAllocation::Get(vehicle_parameters_.rotor_configuration_);
+  controller_parameters_.allocation_matrix_ = rotor_allocation->allocation_matrix();
   // To make the tuning independent of the inertia matrix we divide here.
   normalized_attitude_gain_ = controller_parameters_.attitude_gain_.transpose()
       * vehicle_parameters_.inertia_.inverse();
@@ -39,16 +41,11 @@ void RollPitchYawrateThrustController::InitializeParameters() {
   normalized_angular_rate_gain_ = controller_parameters_.angular_rate_gain_.transpose()
       * vehicle_parameters_.inertia_.inverse();
 
-  Eigen::Matrix4d I;
-  I.setZero();
-  I.block<3, 3>(0, 0) = vehicle_parameters_.inertia_;
-  I(3, 3) = 1;
-  angular_acc_to_rotor_velocities_.resize(vehicle_parameters_.rotor_configuration_.rotors.size(), 4);
-  // Calculate the pseude-inverse A^{ \dagger} and then multiply by the inertia matrix I.
-  // A^{ \dagger} = A^T*(A*A^T)^{-1}
-  angular_acc_to_rotor_velocities_ = controller_parameters_.allocation_matrix_.transpose()
-      * (controller_parameters_.allocation_matrix_
-      * controller_parameters_.allocation_matrix_.transpose()).inverse() * I;
+  // The pseudo-inverse A^{ \dagger} = A^T*(A*A^T)^{-1} is cached per rotor
+  // configuration, only its multiplication by the inertia matrix is redone.
+  rotor_allocation->AngularAccToRotorVelocities(vehicle_parameters_.inertia_,
+                                                &angular_acc_to_rotor_velocities_);
+  mixer_ = MakeRotorMixer(angular_acc_to_rotor_velocities_);
   initialized_params_ = true;
 }
 
@@ -56,10 +53,9 @@ void RollPitchYawrateThrustController::CalculateRotorVelocities(Eigen::VectorXd*
   assert(rotor_velocities);
   assert(initialized_params_);
 
-  rotor_velocities->resize(vehicle_parameters_.rotor_configuration_.rotors.size());
   // Return 0 velocities on all rotors, until the first command is received.
   if (!controller_active_) {
-    *rotor_velocities = Eigen::VectorXd::Zero(rotor_velocities->rows());
+    rotor_velocities->setZero(mixer_->rotor_count());
     return;
   }
 
@@ -70,9 +66,7 @@ void RollPitchYawrateThrustController::CalculateRotorVelocities(Eigen::VectorXd*
   angular_acceleration_thrust.block<3, 1>(0, 0) = angular_acceleration;
   angular_acceleration_thrust(3) = roll_pitch_yawrate_thrust_.thrust.z();
 
-  *rotor_velocities = angular_acc_to_rotor_velocities_ * angular_acceleration_thrust;
-  *rotor_velocities = rotor_velocities->cwiseMax(Eigen::VectorXd::Zero(rotor_velocities->rows()));
-  *rotor_velocities = rotor_velocities->cwiseSqrt();
+  mixer_->CalculateRotorVelocities(angular_acceleration_thrust, rotor_velocities);
 }
 
 void RollPitchYawrateThrustController::SetOdometry(const EigenOdometry& odometry) {
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_control/trajectory_buffer.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace rotors_control {
+
+namespace {
+
+bool TimeBeforePoint(int64_t time_from_start_ns,
+                     const mav_msgs::EigenTrajectoryPoint& point) {
+  return time_from_start_ns < point.time_from_start_ns;
+}
+
+}
+
+TrajectoryBuffer::TrajectoryBuffer()
+    : start_time_ns_(0) {}
+
+void TrajectoryBuffer::Clear() {
+  // Keeps the capacity, the next trajectory usually has a similar length.
+  points_.clear();
+}
+
+bool TrajectoryBuffer::PushBack(const mav_msgs::EigenTrajectoryPoint& point) {
+  if (!points_.empty() &&
+      point.time_from_start_ns < points_.back().time_from_start_ns) {
+    return false;
+  }
+  points_.push_back(point);
+  return true;
+}
+
+int64_t TrajectoryBuffer::EndTime() const {
+  assert(!points_.empty());
+  return start_time_ns_ + points_.back().time_from_start_ns;
+}
+
+void TrajectoryBuffer::Sample(int64_t time_ns,
+                              mav_msgs::EigenTrajectoryPoint* point) const {
+  assert(point);
+  assert(!points_.empty());
+
+  const int64_t time_from_start_ns = time_ns - start_time_ns_;
+  // First point that starts after the requested time.
+  mav_msgs::EigenTrajectoryPointVector::const_iterator after =
+      std::upper_bound(points_.begin(), points_.end(), time_from_start_ns,
+                       TimeBeforePoint);
+  if (after == points_.begin()) {
+    *point = points_.front();
+    return;
+  }
+  if (after == points_.end()) {
+    *point = points_.back();
+    return;
+  }
+  const mav_msgs::EigenTrajectoryPoint& before = *(after - 1);
+
+  const double alpha =
+      static_cast<double>(time_from_start_ns - before.time_from_start_ns)
+      / (after->time_from_start_ns - before.time_from_start_ns);
+  // Fields the controller does not use are held from the previous point.
+  *point = before;
+  point->time_from_start_ns = time_from_start_ns;
+  point->position_W += alpha * (after->position_W - before.position_W);
+  point->velocity_W += alpha * (after->velocity_W - before.velocity_W);
+  point->acceleration_W +=
+      alpha * (after->acceleration_W - before.acceleration_W);
+  point->orientation_W_B =
+      before.orientation_W_B.slerp(alpha, after->orientation_W_B);
+  point->angular_velocity_W +=
+      alpha * (after->angular_velocity_W - before.angular_velocity_W);
+}
+
+}
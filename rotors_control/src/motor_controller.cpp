@@ -20,6 +20,8 @@
 
 #include "rotors_control/motor_controller.h"
 
+namespace rotors_control {
+
 MotorController::MotorController() {
 }
 
@@ -46,3 +48,5 @@ void MotorController::CalculateRotorVelocities(Eigen::VectorXd* rotor_velocities
 }
 
 ROTORS_CONTROL_REGISTER_CONTROLLER(MotorController);
+
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Nodelet variants of the controller nodes. Loaded into the same manager as
+// the odometry source and the actuator consumer, the odometry and actuator
+// messages are passed as shared pointers instead of being serialized.
+
+#include <memory>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include "lee_position_controller_node.h"
+#include "roll_pitch_yawrate_thrust_controller_node.h"
+
+namespace rotors_control {
+
+class LeePositionControllerNodelet : public nodelet::Nodelet {
+ private:
+  void onInit() {
+    node_.reset(new LeePositionControllerNode(getNodeHandle(), getPrivateNodeHandle()));
+  }
+
+  std::unique_ptr<LeePositionControllerNode> node_;
+};
+
+class RollPitchYawrateThrustControllerNodelet : public nodelet::Nodelet {
+ private:
+  void onInit() {
+    node_.reset(new RollPitchYawrateThrustControllerNode(getNodeHandle(),
+                                                         getPrivateNodeHandle()));
+  }
+
+  std::unique_ptr<RollPitchYawrateThrustControllerNode> node_;
+};
+
+}
+
+PLUGINLIB_EXPORT_CLASS(rotors_control::LeePositionControllerNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(rotors_control::RollPitchYawrateThrustControllerNodelet, nodelet::Nodelet)
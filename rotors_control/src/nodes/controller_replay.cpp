@@ -0,0 +1,311 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "controller_replay.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+
+#include "rotors_control/parameters_ros.h"
+
+namespace rotors_control {
+
+namespace {
+
+void GetGain(const ros::NodeHandle& nh, const std::string& name, Eigen::Vector3d* gain) {
+  GetRosParameter(nh, name + "/x", gain->x(), &gain->x());
+  GetRosParameter(nh, name + "/y", gain->y(), &gain->y());
+  GetRosParameter(nh, name + "/z", gain->z(), &gain->z());
+}
+
+// Topic name as compared against the bag, rosbag record stores them with a
+// leading slash and the bag plugin without.
+std::string BagTopic(const std::string& name_space, const std::string& topic) {
+  std::string name = name_space.empty() ? topic : name_space + "/" + topic;
+  while (!name.empty() && name[0] == '/') {
+    name.erase(0, 1);
+  }
+  return name;
+}
+
+}  // namespace
+
+ControllerReplay::ControllerReplay(const ros::NodeHandle& private_nh)
+    : private_nh_(private_nh),
+      use_lee_position_(true),
+      tolerance_(kDefaultReplayTolerance),
+      has_command_(false) {
+  std::string controller;
+  std::string name_space;
+  std::string topic;
+  private_nh_.param<std::string>("controller", controller, kDefaultReplayController);
+  private_nh_.param("tolerance", tolerance_, kDefaultReplayTolerance);
+  private_nh_.param<std::string>("namespace", name_space, kDefaultNamespace);
+  private_nh_.param<std::string>("odometry_topic", topic, kDefaultOdometryTopic);
+  odometry_topic_ = BagTopic(name_space, topic);
+  private_nh_.param<std::string>("command_pose_topic", topic,
+                                 mav_msgs::default_topics::COMMAND_POSE);
+  command_pose_topic_ = BagTopic(name_space, topic);
+  private_nh_.param<std::string>("command_trajectory_topic", topic,
+                                 kDefaultCommandMultiDofJointTrajectoryTopic);
+  command_trajectory_topic_ = BagTopic(name_space, topic);
+  private_nh_.param<std::string>("command_roll_pitch_yawrate_thrust_topic", topic,
+                                 kDefaultCommandRollPitchYawrateThrustTopic);
+  command_roll_pitch_yawrate_thrust_topic_ = BagTopic(name_space, topic);
+  private_nh_.param<std::string>("actuators_topic", topic, kDefaultCommandMotorSpeedTopic);
+  actuators_topic_ = BagTopic(name_space, topic);
+
+  if (controller == "roll_pitch_yawrate_thrust") {
+    use_lee_position_ = false;
+  } else if (controller != "lee_position") {
+    ROS_ERROR("Unknown controller \"%s\", expected lee_position or "
+              "roll_pitch_yawrate_thrust. Replaying the lee_position controller.",
+              controller.c_str());
+  }
+
+  // Read parameters from rosparam, the same as the controller nodes.
+  if (use_lee_position_) {
+    LeePositionControllerParameters& parameters =
+        lee_position_controller_.controller_parameters_;
+    GetGain(private_nh_, "position_gain", &parameters.position_gain_);
+    GetGain(private_nh_, "velocity_gain", &parameters.velocity_gain_);
+    GetGain(private_nh_, "attitude_gain", &parameters.attitude_gain_);
+    GetGain(private_nh_, "angular_rate_gain", &parameters.angular_rate_gain_);
+    GetVehicleParameters(private_nh_, &lee_position_controller_.vehicle_parameters_);
+  } else {
+    RollPitchYawrateThrustControllerParameters& parameters =
+        roll_pitch_yawrate_thrust_controller_.controller_parameters_;
+    GetGain(private_nh_, "attitude_gain", &parameters.attitude_gain_);
+    GetGain(private_nh_, "angular_rate_gain", &parameters.angular_rate_gain_);
+    GetVehicleParameters(private_nh_,
+                         &roll_pitch_yawrate_thrust_controller_.vehicle_parameters_);
+  }
+}
+
+void ControllerReplay::Reset() {
+  // A fresh controller per bag, so that no command carries over.
+  if (use_lee_position_) {
+    LeePositionController controller;
+    controller.controller_parameters_ = lee_position_controller_.controller_parameters_;
+    controller.vehicle_parameters_ = lee_position_controller_.vehicle_parameters_;
+    controller.InitializeParameters();
+    lee_position_controller_ = controller;
+  } else {
+    RollPitchYawrateThrustController controller;
+    controller.controller_parameters_ =
+        roll_pitch_yawrate_thrust_controller_.controller_parameters_;
+    controller.vehicle_parameters_ = roll_pitch_yawrate_thrust_controller_.vehicle_parameters_;
+    controller.InitializeParameters();
+    roll_pitch_yawrate_thrust_controller_ = controller;
+  }
+  trajectory_.Clear();
+  computed_.clear();
+  has_command_ = false;
+}
+
+bool ControllerReplay::Replay(const std::string& bag_filename, ReplayResult* result) {
+  *result = ReplayResult();
+  Reset();
+
+  rosbag::Bag bag;
+  try {
+    bag.open(bag_filename, rosbag::bagmode::Read);
+  } catch (const rosbag::BagException& e) {
+    ROS_ERROR("Can't open bag %s: %s", bag_filename.c_str(), e.what());
+    return false;
+  }
+
+  // All topics in one view, in the order they were recorded.
+  rosbag::View view(bag);
+  for (const rosbag::MessageInstance& m : view) {
+    const std::string topic = BagTopic("", m.getTopic());
+    if (topic == odometry_topic_) {
+      nav_msgs::OdometryConstPtr msg = m.instantiate<nav_msgs::Odometry>();
+      if (msg) {
+        ++result->num_odometry;
+        OdometryCallback(msg);
+      }
+    } else if (topic == actuators_topic_) {
+      mav_msgs::ActuatorsConstPtr msg = m.instantiate<mav_msgs::Actuators>();
+      if (msg) ActuatorsCallback(msg, result);
+    } else if (use_lee_position_ && topic == command_pose_topic_) {
+      geometry_msgs::PoseStampedConstPtr msg = m.instantiate<geometry_msgs::PoseStamped>();
+      if (msg) CommandPoseCallback(msg);
+    } else if (use_lee_position_ && topic == command_trajectory_topic_) {
+      trajectory_msgs::MultiDOFJointTrajectoryConstPtr msg =
+          m.instantiate<trajectory_msgs::MultiDOFJointTrajectory>();
+      if (msg) MultiDofJointTrajectoryCallback(msg, m.getTime());
+    } else if (!use_lee_position_ && topic == command_roll_pitch_yawrate_thrust_topic_) {
+      mav_msgs::RollPitchYawrateThrustConstPtr msg =
+          m.instantiate<mav_msgs::RollPitchYawrateThrust>();
+      if (msg) RollPitchYawrateThrustCallback(msg);
+    }
+  }
+  bag.close();
+  return true;
+}
+
+void ControllerReplay::OdometryCallback(const nav_msgs::OdometryConstPtr& odometry_msg) {
+  EigenOdometry odometry;
+  eigenOdometryFromMsg(odometry_msg, &odometry);
+
+  ComputedCommand command;
+  command.stamp = odometry_msg->header.stamp;
+  if (use_lee_position_) {
+    lee_position_controller_.SetOdometry(odometry);
+    if (!trajectory_.empty()) {
+      const int64_t stamp_ns = odometry_msg->header.stamp.toNSec();
+      trajectory_.Sample(stamp_ns, &trajectory_reference_);
+      lee_position_controller_.SetTrajectoryPoint(trajectory_reference_);
+      if (stamp_ns >= trajectory_.EndTime()) {
+        trajectory_.Clear();
+      }
+    }
+    lee_position_controller_.CalculateRotorVelocities(&command.rotor_velocities);
+  } else {
+    roll_pitch_yawrate_thrust_controller_.SetOdometry(odometry);
+    roll_pitch_yawrate_thrust_controller_.CalculateRotorVelocities(&command.rotor_velocities);
+  }
+
+  // Before the first command of the bag, the recorded controller may still
+  // have followed one sent before the recording started.
+  if (has_command_) {
+    computed_.push_back(command);
+  }
+}
+
+void ControllerReplay::CommandPoseCallback(const geometry_msgs::PoseStampedConstPtr& pose_msg) {
+  trajectory_.Clear();
+  mav_msgs::EigenTrajectoryPoint eigen_reference;
+  mav_msgs::eigenTrajectoryPointFromPoseMsg(*pose_msg, &eigen_reference);
+  lee_position_controller_.SetTrajectoryPoint(eigen_reference);
+  has_command_ = true;
+}
+
+void ControllerReplay::MultiDofJointTrajectoryCallback(
+    const trajectory_msgs::MultiDOFJointTrajectoryConstPtr& msg, const ros::Time& receive_time) {
+  trajectory_.Clear();
+  if (msg->points.empty()) {
+    return;
+  }
+
+  trajectory_.Reserve(msg->points.size());
+  mav_msgs::EigenTrajectoryPoint eigen_reference;
+  for (size_t i = 0; i < msg->points.size(); ++i) {
+    mav_msgs::eigenTrajectoryPointFromMsg(msg->points[i], &eigen_reference);
+    if (!trajectory_.PushBack(eigen_reference)) {
+      break;
+    }
+  }
+
+  if (msg->header.stamp.isZero()) {
+    trajectory_.SetStartTime(receive_time.toNSec() -
+                             msg->points.front().time_from_start.toNSec());
+  } else {
+    trajectory_.SetStartTime(msg->header.stamp.toNSec());
+  }
+  trajectory_.Sample(receive_time.toNSec(), &trajectory_reference_);
+  lee_position_controller_.SetTrajectoryPoint(trajectory_reference_);
+  has_command_ = true;
+}
+
+void ControllerReplay::RollPitchYawrateThrustCallback(
+    const mav_msgs::RollPitchYawrateThrustConstPtr& msg) {
+  mav_msgs::EigenRollPitchYawrateThrust roll_pitch_yawrate_thrust;
+  mav_msgs::eigenRollPitchYawrateThrustFromMsg(*msg, &roll_pitch_yawrate_thrust);
+  roll_pitch_yawrate_thrust_controller_.SetRollPitchYawrateThrust(roll_pitch_yawrate_thrust);
+  has_command_ = true;
+}
+
+void ControllerReplay::ActuatorsCallback(const mav_msgs::ActuatorsConstPtr& actuators_msg,
+                                         ReplayResult* result) {
+  // Computed commands older than the recorded one were dropped by the
+  // recording, e.g. by its queue.
+  while (!computed_.empty() && computed_.front().stamp < actuators_msg->header.stamp) {
+    computed_.pop_front();
+  }
+  if (computed_.empty() || computed_.front().stamp != actuators_msg->header.stamp) {
+    return;
+  }
+  const Eigen::VectorXd& rotor_velocities = computed_.front().rotor_velocities;
+
+  bool mismatch = static_cast<size_t>(rotor_velocities.size()) !=
+                  actuators_msg->angular_velocities.size();
+  for (size_t i = 0; i < actuators_msg->angular_velocities.size() && !mismatch; ++i) {
+    const double error = std::abs(rotor_velocities[i] - actuators_msg->angular_velocities[i]);
+    result->max_error = std::max(result->max_error, error);
+    result->sum_squared_error += error * error;
+    ++result->num_rotor_values;
+    mismatch = !(error <= tolerance_);
+  }
+  if (mismatch) {
+    if (result->num_mismatches == 0) {
+      result->first_mismatch = actuators_msg->header.stamp;
+    }
+    ++result->num_mismatches;
+  }
+  ++result->num_compared;
+  computed_.pop_front();
+}
+
+}
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "controller_replay", ros::init_options::AnonymousName);
+  if (argc < 2) {
+    ROS_ERROR("Usage: controller_replay <bag> [<bag> ...], with the controller "
+              "parameters in the private namespace.");
+    return 2;
+  }
+
+  ros::NodeHandle private_nh("~");
+  rotors_control::ControllerReplay replay(private_nh);
+
+  int num_failed = 0;
+  for (int i = 1; i < argc; ++i) {
+    rotors_control::ReplayResult result;
+    if (!replay.Replay(argv[i], &result)) {
+      ++num_failed;
+      continue;
+    }
+    const double rms_error = result.num_rotor_values > 0
+        ? std::sqrt(result.sum_squared_error / result.num_rotor_values) : 0.0;
+    if (result.num_compared == 0) {
+      ROS_ERROR("%s: no recorded actuator command matches one of the %zu odometry "
+                "messages.", argv[i], result.num_odometry);
+      ++num_failed;
+    } else if (result.num_mismatches > 0) {
+      ROS_ERROR("%s: %zu of %zu commands off by more than %.3f rad/s, first at %.3f s, "
+                "max error %.3f rad/s, rms %.3f rad/s.", argv[i], result.num_mismatches,
+                result.num_compared, replay.tolerance(), result.first_mismatch.toSec(),
+                result.max_error, rms_error);
+      ++num_failed;
+    } else {
+      ROS_INFO("%s: %zu commands match, max error %.3f rad/s, rms %.3f rad/s.", argv[i],
+               result.num_compared, result.max_error, rms_error);
+    }
+  }
+
+  ROS_INFO("Replayed %d bags, %d failed.", argc - 1, num_failed);
+  return num_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_CONTROL_CONTROLLER_REPLAY_H
+#define ROTORS_CONTROL_CONTROLLER_REPLAY_H
+
+#include <deque>
+#include <string>
+
+#include <geometry_msgs/PoseStamped.h>
+#include <mav_msgs/Actuators.h>
+#include <mav_msgs/RollPitchYawrateThrust.h>
+#include <nav_msgs/Odometry.h>
+#include <ros/ros.h>
+#include <trajectory_msgs/MultiDOFJointTrajectory.h>
+
+#include "rotors_control/common.h"
+#include "rotors_control/lee_position_controller.h"
+#include "rotors_control/roll_pitch_yawrate_thrust_controller.h"
+#include "rotors_control/trajectory_buffer.h"
+
+namespace rotors_control {
+
+// Default values.
+static const std::string kDefaultReplayController = "lee_position";
+// Largest difference to a recorded rotor velocity that still matches [rad/s].
+static constexpr double kDefaultReplayTolerance = 1.0;
+
+// Result of replaying one bag.
+struct ReplayResult {
+  ReplayResult()
+      : num_odometry(0),
+        num_compared(0),
+        num_mismatches(0),
+        max_error(0.0),
+        sum_squared_error(0.0),
+        num_rotor_values(0) {}
+
+  size_t num_odometry;
+  // Recorded actuator messages matched with a computed one by their stamp.
+  size_t num_compared;
+  // Compared messages with a rotor velocity off by more than the tolerance.
+  size_t num_mismatches;
+  // Largest difference of a rotor velocity [rad/s].
+  double max_error;
+  double sum_squared_error;
+  size_t num_rotor_values;
+  ros::Time first_mismatch;
+};
+
+// Replays the odometry and commands recorded in bags through the Lee position
+// or the roll pitch yawrate thrust controller, open loop and as fast as the
+// bag can be read, and compares the rotor velocities it computes against the
+// recorded actuator commands. The controller nodes stamp their actuator
+// commands with the odometry they were computed from, which pairs a recorded
+// command with its replayed one.
+//
+// The gains and vehicle parameters are read from the private namespace like
+// in the controller nodes, so the same yaml files apply. Trajectories are
+// sampled at the odometry stamps and unstamped ones start at their receive
+// time in the bag, also like in the node.
+class ControllerReplay {
+ public:
+  ControllerReplay(const ros::NodeHandle& private_nh);
+
+  // Returns false if the bag can't be read.
+  bool Replay(const std::string& bag_filename, ReplayResult* result);
+
+  double tolerance() const { return tolerance_; }
+
+ private:
+  struct ComputedCommand {
+    ros::Time stamp;
+    Eigen::VectorXd rotor_velocities;
+  };
+
+  void Reset();
+
+  void OdometryCallback(const nav_msgs::OdometryConstPtr& odometry_msg);
+  void CommandPoseCallback(const geometry_msgs::PoseStampedConstPtr& pose_msg);
+  void MultiDofJointTrajectoryCallback(
+      const trajectory_msgs::MultiDOFJointTrajectoryConstPtr& msg,
+      const ros::Time& receive_time);
+  void RollPitchYawrateThrustCallback(
+      const mav_msgs::RollPitchYawrateThrustConstPtr& msg);
+  void ActuatorsCallback(const mav_msgs::ActuatorsConstPtr& actuators_msg,
+                         ReplayResult* result);
+
+  ros::NodeHandle private_nh_;
+
+  bool use_lee_position_;
+  double tolerance_;
+
+  // Topics in the bag, without the leading slash.
+  std::string odometry_topic_;
+  std::string command_pose_topic_;
+  std::string command_trajectory_topic_;
+  std::string command_roll_pitch_yawrate_thrust_topic_;
+  std::string actuators_topic_;
+
+  LeePositionController lee_position_controller_;
+  RollPitchYawrateThrustController roll_pitch_yawrate_thrust_controller_;
+  TrajectoryBuffer trajectory_;
+  mav_msgs::EigenTrajectoryPoint trajectory_reference_;
+
+  // Whether a command of the bag was replayed, the computed commands are only
+  // compared from then on.
+  bool has_command_;
+  // Computed commands not matched with a recorded one yet, oldest first.
+  std::deque<ComputedCommand> computed_;
+};
+
+}
+
+#endif // ROTORS_CONTROL_CONTROLLER_REPLAY_H
@@ -47,8 +47,28 @@ LeePositionControllerNode::LeePositionControllerNode(
   motor_velocity_reference_pub_ = nh_.advertise<mav_msgs::Actuators>(
       mav_msgs::default_topics::COMMAND_ACTUATORS, 1);
 
-  command_timer_ = nh_.createTimer(ros::Duration(0), &LeePositionControllerNode::TimedCommandCallback, this,
-                                  true, false);
+  // Start from the gains read in InitializeParams() instead of the defaults
+  // of the config.
+  const LeePositionControllerParameters& parameters =
+      lee_position_controller_.controller_parameters_;
+  LeePositionControllerConfig config;
+  config.position_gain_x = parameters.position_gain_.x();
+  config.position_gain_y = parameters.position_gain_.y();
+  config.position_gain_z = parameters.position_gain_.z();
+  config.velocity_gain_x = parameters.velocity_gain_.x();
+  config.velocity_gain_y = parameters.velocity_gain_.y();
+  config.velocity_gain_z = parameters.velocity_gain_.z();
+  config.attitude_gain_x = parameters.attitude_gain_.x();
+  config.attitude_gain_y = parameters.attitude_gain_.y();
+  config.attitude_gain_z = parameters.attitude_gain_.z();
+  config.angular_rate_gain_x = parameters.angular_rate_gain_.x();
+  config.angular_rate_gain_y = parameters.angular_rate_gain_.y();
+  config.angular_rate_gain_z = parameters.angular_rate_gain_.z();
+  reconfigure_server_.reset(
+      new dynamic_reconfigure::Server<LeePositionControllerConfig>(private_nh_));
+  reconfigure_server_->updateConfig(config);
+  reconfigure_server_->setCallback(
+      boost::bind(&LeePositionControllerNode::ReconfigureCallback, this, _1, _2));
 }
 
 LeePositionControllerNode::~LeePositionControllerNode() { }
@@ -101,24 +121,17 @@ void LeePositionControllerNode::Publish() {
 void LeePositionControllerNode::CommandPoseCallback(
     const geometry_msgs::PoseStampedConstPtr& pose_msg) {
   // Clear all pending commands.
-  command_timer_.stop();
-  commands_.clear();
-  command_waiting_times_.clear();
+  trajectory_.Clear();
 
   mav_msgs::EigenTrajectoryPoint eigen_reference;
   mav_msgs::eigenTrajectoryPointFromPoseMsg(*pose_msg, &eigen_reference);
-  commands_.push_front(eigen_reference);
-
-  lee_position_controller_.SetTrajectoryPoint(commands_.front());
-  commands_.pop_front();
+  lee_position_controller_.SetTrajectoryPoint(eigen_reference);
 }
 
 void LeePositionControllerNode::MultiDofJointTrajectoryCallback(
     const trajectory_msgs::MultiDOFJointTrajectoryConstPtr& msg) {
   // Clear all pending commands.
-  command_timer_.stop();
-  commands_.clear();
-  command_waiting_times_.clear();
+  trajectory_.Clear();
 
   const size_t n_commands = msg->points.size();
 
@@ -127,47 +140,44 @@ void LeePositionControllerNode::MultiDofJointTrajectoryCallback(
     return;
   }
 
+  trajectory_.Reserve(n_commands);
   mav_msgs::EigenTrajectoryPoint eigen_reference;
-  mav_msgs::eigenTrajectoryPointFromMsg(msg->points.front(), &eigen_reference);
-  commands_.push_front(eigen_reference);
-
-  for (size_t i = 1; i < n_commands; ++i) {
-    const trajectory_msgs::MultiDOFJointTrajectoryPoint& reference_before = msg->points[i-1];
-    const trajectory_msgs::MultiDOFJointTrajectoryPoint& current_reference = msg->points[i];
-
-    mav_msgs::eigenTrajectoryPointFromMsg(current_reference, &eigen_reference);
-
-    commands_.push_back(eigen_reference);
-    command_waiting_times_.push_back(current_reference.time_from_start - reference_before.time_from_start);
+  for (size_t i = 0; i < n_commands; ++i) {
+    mav_msgs::eigenTrajectoryPointFromMsg(msg->points[i], &eigen_reference);
+    if (!trajectory_.PushBack(eigen_reference)) {
+      ROS_WARN_STREAM("Got MultiDOFJointTrajectory message with points out of order,"
+                      << " ignoring the points from index " << i << " on.");
+      break;
+    }
   }
 
-  // We can trigger the first command immediately.
-  lee_position_controller_.SetTrajectoryPoint(commands_.front());
-  commands_.pop_front();
-
-  if (n_commands > 1) {
-    command_timer_.setPeriod(command_waiting_times_.front());
-    command_waiting_times_.pop_front();
-    command_timer_.start();
+  // A stamped trajectory starts at its stamp, which keeps the chunks of a long
+  // mission on one time base. Otherwise the first point is active
+  // immediately, the following ones at their time from start relative to it.
+  const ros::Time now = ros::Time::now();
+  if (msg->header.stamp.isZero()) {
+    trajectory_.SetStartTime(now.toNSec() - msg->points.front().time_from_start.toNSec());
+  } else {
+    trajectory_.SetStartTime(msg->header.stamp.toNSec());
   }
+  trajectory_.Sample(now.toNSec(), &trajectory_reference_);
+  lee_position_controller_.SetTrajectoryPoint(trajectory_reference_);
 }
 
-void LeePositionControllerNode::TimedCommandCallback(const ros::TimerEvent& e) {
-
-  if(commands_.empty()){
-    ROS_WARN("Commands empty, this should not happen here");
-    return;
-  }
-
-  const mav_msgs::EigenTrajectoryPoint eigen_reference = commands_.front();
-  lee_position_controller_.SetTrajectoryPoint(commands_.front());
-  commands_.pop_front();
-  command_timer_.stop();
-  if(!command_waiting_times_.empty()){
-    command_timer_.setPeriod(command_waiting_times_.front());
-    command_waiting_times_.pop_front();
-    command_timer_.start();
-  }
+void LeePositionControllerNode::ReconfigureCallback(
+    LeePositionControllerConfig& config, uint32_t level) {
+  LeePositionControllerParameters& parameters =
+      lee_position_controller_.controller_parameters_;
+  parameters.position_gain_ << config.position_gain_x, config.position_gain_y,
+      config.position_gain_z;
+  parameters.velocity_gain_ << config.velocity_gain_x, config.velocity_gain_y,
+      config.velocity_gain_z;
+  parameters.attitude_gain_ << config.attitude_gain_x, config.attitude_gain_y,
+      config.attitude_gain_z;
+  parameters.angular_rate_gain_ << config.angular_rate_gain_x,
+      config.angular_rate_gain_y, config.angular_rate_gain_z;
+  // The odometry callback keeps running on the previous gains until the swap.
+  lee_position_controller_.UpdateGains();
 }
 
 void LeePositionControllerNode::OdometryCallback(const nav_msgs::OdometryConstPtr& odometry_msg) {
@@ -178,30 +188,21 @@ void LeePositionControllerNode::OdometryCallback(const nav_msgs::OdometryConstPt
   eigenOdometryFromMsg(odometry_msg, &odometry);
   lee_position_controller_.SetOdometry(odometry);
 
-  Eigen::VectorXd ref_rotor_velocities;
-  lee_position_controller_.CalculateRotorVelocities(&ref_rotor_velocities);
-
-  // Todo(ffurrer): Do this in the conversions header.
-  mav_msgs::ActuatorsPtr actuator_msg(new mav_msgs::Actuators);
-
-  actuator_msg->angular_velocities.clear();
-  for (int i = 0; i < ref_rotor_velocities.size(); i++)
-    actuator_msg->angular_velocities.push_back(ref_rotor_velocities[i]);
-  actuator_msg->header.stamp = odometry_msg->header.stamp;
+  // Sample the reference at the time of the state it is compared against.
+  if (!trajectory_.empty()) {
+    const int64_t stamp_ns = odometry_msg->header.stamp.toNSec();
+    trajectory_.Sample(stamp_ns, &trajectory_reference_);
+    lee_position_controller_.SetTrajectoryPoint(trajectory_reference_);
+    if (stamp_ns >= trajectory_.EndTime()) {
+      trajectory_.Clear();
+    }
+  }
 
-  motor_velocity_reference_pub_.publish(actuator_msg);
-}
+  lee_position_controller_.CalculateRotorVelocities(&ref_rotor_velocities_);
 
+  actuatorsMsgFromRotorVelocities(ref_rotor_velocities_, odometry_msg->header.stamp,
+                                  &actuator_msg_);
+  motor_velocity_reference_pub_.publish(actuator_msg_);
 }
 
-int main(int argc, char** argv) {
-  ros::init(argc, argv, "lee_position_controller_node");
-
-  ros::NodeHandle nh;
-  ros::NodeHandle private_nh("~");
-  rotors_control::LeePositionControllerNode lee_position_controller_node(nh, private_nh);
-
-  ros::spin();
-
-  return 0;
 }
@@ -21,10 +21,13 @@
 #ifndef ROTORS_CONTROL_LEE_POSITION_CONTROLLER_NODE_H
 #define ROTORS_CONTROL_LEE_POSITION_CONTROLLER_NODE_H
 
+#include <memory>
+
 #include <boost/bind.hpp>
 #include <Eigen/Eigen>
 #include <stdio.h>
 
+#include <dynamic_reconfigure/server.h>
 #include <geometry_msgs/PoseStamped.h>
 #include <mav_msgs/Actuators.h>
 #include <mav_msgs/AttitudeThrust.h>
@@ -36,6 +39,8 @@
 
 #include "rotors_control/common.h"
 #include "rotors_control/lee_position_controller.h"
+#include "rotors_control/trajectory_buffer.h"
+#include "rotors_control/LeePositionControllerConfig.h"
 
 namespace rotors_control {
 
@@ -63,11 +68,19 @@ class LeePositionControllerNode {
 
   ros::Publisher motor_velocity_reference_pub_;
 
-  mav_msgs::EigenTrajectoryPointDeque commands_;
-  std::deque<ros::Duration> command_waiting_times_;
-  ros::Timer command_timer_;
+  // Swaps new gains into the running controller, see
+  // LeePositionController::UpdateGains().
+  std::unique_ptr<dynamic_reconfigure::Server<LeePositionControllerConfig> >
+      reconfigure_server_;
+
+  // Reused on every odometry message to avoid allocations.
+  Eigen::VectorXd ref_rotor_velocities_;
+  mav_msgs::ActuatorsPtr actuator_msg_;
 
-  void TimedCommandCallback(const ros::TimerEvent& e);
+  // Pending trajectory, sampled at the time of every odometry message until
+  // its last point is reached.
+  TrajectoryBuffer trajectory_;
+  mav_msgs::EigenTrajectoryPoint trajectory_reference_;
 
   void MultiDofJointTrajectoryCallback(
       const trajectory_msgs::MultiDOFJointTrajectoryConstPtr& trajectory_reference_msg);
@@ -76,6 +89,8 @@ class LeePositionControllerNode {
       const geometry_msgs::PoseStampedConstPtr& pose_msg);
 
   void OdometryCallback(const nav_msgs::OdometryConstPtr& odometry_msg);
+
+  void ReconfigureCallback(LeePositionControllerConfig& config, uint32_t level);
 };
 }
 
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lee_position_controller_swarm_node.h"
+
+#include <boost/bind.hpp>
+#include <mav_msgs/default_topics.h>
+
+#include "rotors_control/parameters_ros.h"
+
+namespace rotors_control {
+
+namespace {
+
+void GetGain(const ros::NodeHandle& nh, const std::string& name, Eigen::Vector3d* gain) {
+  GetRosParameter(nh, name + "/x", gain->x(), &gain->x());
+  GetRosParameter(nh, name + "/y", gain->y(), &gain->y());
+  GetRosParameter(nh, name + "/z", gain->z(), &gain->z());
+}
+
+}  // namespace
+
+LeePositionControllerSwarmNode::LeePositionControllerSwarmNode(
+  const ros::NodeHandle& nh, const ros::NodeHandle& private_nh)
+  :nh_(nh),
+   private_nh_(private_nh){
+  InitializeParams();
+
+  std::string odometry_topic;
+  private_nh_.param<std::string>("odometry_topic", odometry_topic,
+                                 mav_msgs::default_topics::ODOMETRY);
+  double control_rate;
+  private_nh_.param("control_rate", control_rate, kDefaultSwarmControlRate);
+
+  const size_t num_vehicles = namespaces_.size();
+  odometry_.Resize(num_vehicles);
+  reference_.Resize(num_vehicles);
+  odometry_stamps_.resize(num_vehicles);
+  has_odometry_.assign(num_vehicles, false);
+  actuator_msgs_.resize(num_vehicles);
+
+  for (size_t i = 0; i < num_vehicles; ++i) {
+    const std::string prefix = namespaces_[i] + "/";
+    cmd_pose_subs_.push_back(nh_.subscribe<geometry_msgs::PoseStamped>(
+        prefix + mav_msgs::default_topics::COMMAND_POSE, 1,
+        boost::bind(&LeePositionControllerSwarmNode::CommandPoseCallback, this, _1, i)));
+    cmd_multi_dof_joint_trajectory_subs_.push_back(
+        nh_.subscribe<trajectory_msgs::MultiDOFJointTrajectory>(
+            prefix + mav_msgs::default_topics::COMMAND_TRAJECTORY, 1,
+            boost::bind(&LeePositionControllerSwarmNode::MultiDofJointTrajectoryCallback, this,
+                        _1, i)));
+    odometry_subs_.push_back(nh_.subscribe<nav_msgs::Odometry>(
+        prefix + odometry_topic, 1,
+        boost::bind(&LeePositionControllerSwarmNode::OdometryCallback, this, _1, i)));
+    motor_velocity_reference_pubs_.push_back(nh_.advertise<mav_msgs::Actuators>(
+        prefix + mav_msgs::default_topics::COMMAND_ACTUATORS, 1));
+  }
+
+  control_timer_ = nh_.createTimer(ros::Duration(1.0 / control_rate),
+                                   &LeePositionControllerSwarmNode::ControlCallback, this);
+  ROS_INFO("LeePositionControllerSwarmNode controls %zu vehicles at %.0f Hz.",
+           num_vehicles, control_rate);
+}
+
+LeePositionControllerSwarmNode::~LeePositionControllerSwarmNode() { }
+
+void LeePositionControllerSwarmNode::InitializeParams() {
+  if (!private_nh_.getParam("vehicle_namespaces", namespaces_)) {
+    std::string mav_name;
+    int num_vehicles;
+    private_nh_.param("mav_name", mav_name, kDefaultSwarmMavName);
+    private_nh_.param("num_vehicles", num_vehicles, kDefaultSwarmNumVehicles);
+    for (int i = 1; i <= num_vehicles; ++i) {
+      namespaces_.push_back(mav_name + std::to_string(i));
+    }
+  }
+
+  // Read parameters from rosparam, they are shared by all vehicles.
+  LeePositionControllerParameters& parameters = lee_position_controller_.controller_parameters_;
+  GetGain(private_nh_, "position_gain", &parameters.position_gain_);
+  GetGain(private_nh_, "velocity_gain", &parameters.velocity_gain_);
+  GetGain(private_nh_, "attitude_gain", &parameters.attitude_gain_);
+  GetGain(private_nh_, "angular_rate_gain", &parameters.angular_rate_gain_);
+  GetVehicleParameters(private_nh_, &lee_position_controller_.vehicle_parameters_);
+  lee_position_controller_.InitializeParameters();
+  batch_.reset(new LeePositionControllerBatch(lee_position_controller_));
+}
+
+void LeePositionControllerSwarmNode::SetReference(
+    size_t vehicle, const mav_msgs::EigenTrajectoryPoint& reference) {
+  reference_.position_W.col(vehicle) = reference.position_W;
+  reference_.velocity_W.col(vehicle) = reference.velocity_W;
+  reference_.acceleration_W.col(vehicle) = reference.acceleration_W;
+  reference_.yaw[vehicle] = reference.getYaw();
+  reference_.yaw_rate[vehicle] = reference.getYawRate();
+  reference_.active[vehicle] = true;
+}
+
+void LeePositionControllerSwarmNode::CommandPoseCallback(
+    const geometry_msgs::PoseStampedConstPtr& pose_msg, size_t vehicle) {
+  mav_msgs::EigenTrajectoryPoint eigen_reference;
+  mav_msgs::eigenTrajectoryPointFromPoseMsg(*pose_msg, &eigen_reference);
+  SetReference(vehicle, eigen_reference);
+}
+
+void LeePositionControllerSwarmNode::MultiDofJointTrajectoryCallback(
+    const trajectory_msgs::MultiDOFJointTrajectoryConstPtr& msg, size_t vehicle) {
+  if (msg->points.empty()) {
+    ROS_WARN_STREAM("Got MultiDOFJointTrajectory message, but message has no points.");
+    return;
+  }
+  if (msg->points.size() > 1) {
+    ROS_WARN_ONCE("LeePositionControllerSwarmNode only follows the first point of a trajectory.");
+  }
+
+  mav_msgs::EigenTrajectoryPoint eigen_reference;
+  mav_msgs::eigenTrajectoryPointFromMsg(msg->points.front(), &eigen_reference);
+  SetReference(vehicle, eigen_reference);
+}
+
+void LeePositionControllerSwarmNode::OdometryCallback(
+    const nav_msgs::OdometryConstPtr& odometry_msg, size_t vehicle) {
+  EigenOdometry odometry;
+  eigenOdometryFromMsg(odometry_msg, &odometry);
+  odometry_.position.col(vehicle) = odometry.position;
+  odometry_.orientation.col(vehicle) = odometry.orientation.coeffs();
+  odometry_.velocity.col(vehicle) = odometry.velocity;
+  odometry_.angular_velocity.col(vehicle) = odometry.angular_velocity;
+  odometry_stamps_[vehicle] = odometry_msg->header.stamp;
+  has_odometry_[vehicle] = true;
+}
+
+void LeePositionControllerSwarmNode::ControlCallback(const ros::TimerEvent& e) {
+  batch_->CalculateRotorVelocities(odometry_, reference_, &rotor_velocities_);
+
+  for (size_t i = 0; i < namespaces_.size(); ++i) {
+    if (!has_odometry_[i]) {
+      continue;
+    }
+    vehicle_rotor_velocities_ = rotor_velocities_.col(i);
+    actuatorsMsgFromRotorVelocities(vehicle_rotor_velocities_, odometry_stamps_[i],
+                                    &actuator_msgs_[i]);
+    motor_velocity_reference_pubs_[i].publish(actuator_msgs_[i]);
+  }
+}
+
+}
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "lee_position_controller_swarm_node");
+
+  ros::NodeHandle nh;
+  ros::NodeHandle private_nh("~");
+  rotors_control::LeePositionControllerSwarmNode lee_position_controller_swarm_node(nh, private_nh);
+
+  ros::spin();
+
+  return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_CONTROL_LEE_POSITION_CONTROLLER_SWARM_NODE_H
+#define ROTORS_CONTROL_LEE_POSITION_CONTROLLER_SWARM_NODE_H
+
+#include <string>
+#include <vector>
+
+#include <geometry_msgs/PoseStamped.h>
+#include <mav_msgs/Actuators.h>
+#include <nav_msgs/Odometry.h>
+#include <ros/ros.h>
+#include <trajectory_msgs/MultiDOFJointTrajectory.h>
+
+#include "rotors_control/common.h"
+#include "rotors_control/lee_position_controller.h"
+#include "rotors_control/lee_position_controller_batch.h"
+
+namespace rotors_control {
+
+// Default values.
+static constexpr double kDefaultSwarmControlRate = 100.0;
+static constexpr int kDefaultSwarmNumVehicles = 1;
+static const std::string kDefaultSwarmMavName = "firefly";
+
+// Runs the Lee position controller for a whole swarm of identical vehicles in
+// one process. The vehicles are the namespaces in ~vehicle_namespaces, or
+// <~mav_name>1 ... <~mav_name><~num_vehicles>. At ~control_rate, the rotor
+// velocities of all vehicles that received odometry are computed in one
+// batch and published in their namespaces.
+class LeePositionControllerSwarmNode {
+ public:
+  LeePositionControllerSwarmNode(const ros::NodeHandle& nh, const ros::NodeHandle& private_nh);
+  ~LeePositionControllerSwarmNode();
+
+  void InitializeParams();
+
+ private:
+  ros::NodeHandle nh_;
+  ros::NodeHandle private_nh_;
+
+  LeePositionController lee_position_controller_;
+  std::unique_ptr<LeePositionControllerBatch> batch_;
+
+  std::vector<std::string> namespaces_;
+
+  // subscribers, one per vehicle
+  std::vector<ros::Subscriber> cmd_multi_dof_joint_trajectory_subs_;
+  std::vector<ros::Subscriber> cmd_pose_subs_;
+  std::vector<ros::Subscriber> odometry_subs_;
+
+  std::vector<ros::Publisher> motor_velocity_reference_pubs_;
+
+  ros::Timer control_timer_;
+
+  // Latest state and reference of every vehicle.
+  LeePositionControllerBatch::Odometry odometry_;
+  LeePositionControllerBatch::Reference reference_;
+  std::vector<ros::Time> odometry_stamps_;
+  std::vector<bool> has_odometry_;
+
+  // Reused on every control step to avoid allocations.
+  Eigen::MatrixXd rotor_velocities_;
+  Eigen::VectorXd vehicle_rotor_velocities_;
+  std::vector<mav_msgs::ActuatorsPtr> actuator_msgs_;
+
+  void SetReference(size_t vehicle, const mav_msgs::EigenTrajectoryPoint& reference);
+
+  void MultiDofJointTrajectoryCallback(
+      const trajectory_msgs::MultiDOFJointTrajectoryConstPtr& trajectory_reference_msg,
+      size_t vehicle);
+
+  void CommandPoseCallback(const geometry_msgs::PoseStampedConstPtr& pose_msg, size_t vehicle);
+
+  void OdometryCallback(const nav_msgs::OdometryConstPtr& odometry_msg, size_t vehicle);
+
+  void ControlCallback(const ros::TimerEvent& e);
+};
+}
+
+#endif // ROTORS_CONTROL_LEE_POSITION_CONTROLLER_SWARM_NODE_H
@@ -24,45 +24,44 @@
 
 namespace rotors_control {
 
-RollPitchYawrateThrustControllerNode::RollPitchYawrateThrustControllerNode() {
+RollPitchYawrateThrustControllerNode::RollPitchYawrateThrustControllerNode(
+  const ros::NodeHandle& nh, const ros::NodeHandle& private_nh)
+  :nh_(nh),
+   private_nh_(private_nh){
   InitializeParams();
 
-  ros::NodeHandle nh;
-
-  cmd_roll_pitch_yawrate_thrust_sub_ = nh.subscribe(kDefaultCommandRollPitchYawrateThrustTopic, 1,
+  cmd_roll_pitch_yawrate_thrust_sub_ = nh_.subscribe(kDefaultCommandRollPitchYawrateThrustTopic, 1,
                                      &RollPitchYawrateThrustControllerNode::RollPitchYawrateThrustCallback, this);
-  odometry_sub_ = nh.subscribe(kDefaultOdometryTopic, 1,
+  odometry_sub_ = nh_.subscribe(kDefaultOdometryTopic, 1,
                                &RollPitchYawrateThrustControllerNode::OdometryCallback, this);
 
-  motor_velocity_reference_pub_ = nh.advertise<mav_msgs::Actuators>(
+  motor_velocity_reference_pub_ = nh_.advertise<mav_msgs::Actuators>(
       kDefaultCommandMotorSpeedTopic, 1);
 }
 
 RollPitchYawrateThrustControllerNode::~RollPitchYawrateThrustControllerNode() { }
 
 void RollPitchYawrateThrustControllerNode::InitializeParams() {
-  ros::NodeHandle pnh("~");
-
   // Read parameters from rosparam.
-  GetRosParameter(pnh, "attitude_gain/x",
+  GetRosParameter(private_nh_, "attitude_gain/x",
                   roll_pitch_yawrate_thrust_controller_.controller_parameters_.attitude_gain_.x(),
                   &roll_pitch_yawrate_thrust_controller_.controller_parameters_.attitude_gain_.x());
-  GetRosParameter(pnh, "attitude_gain/y",
+  GetRosParameter(private_nh_, "attitude_gain/y",
                   roll_pitch_yawrate_thrust_controller_.controller_parameters_.attitude_gain_.y(),
                   &roll_pitch_yawrate_thrust_controller_.controller_parameters_.attitude_gain_.y());
-  GetRosParameter(pnh, "attitude_gain/z",
+  GetRosParameter(private_nh_, "attitude_gain/z",
                   roll_pitch_yawrate_thrust_controller_.controller_parameters_.attitude_gain_.z(),
                   &roll_pitch_yawrate_thrust_controller_.controller_parameters_.attitude_gain_.z());
-  GetRosParameter(pnh, "angular_rate_gain/x",
+  GetRosParameter(private_nh_, "angular_rate_gain/x",
                   roll_pitch_yawrate_thrust_controller_.controller_parameters_.angular_rate_gain_.x(),
                   &roll_pitch_yawrate_thrust_controller_.controller_parameters_.angular_rate_gain_.x());
-  GetRosParameter(pnh, "angular_rate_gain/y",
+  GetRosParameter(private_nh_, "angular_rate_gain/y",
                   roll_pitch_yawrate_thrust_controller_.controller_parameters_.angular_rate_gain_.y(),
                   &roll_pitch_yawrate_thrust_controller_.controller_parameters_.angular_rate_gain_.y());
-  GetRosParameter(pnh, "angular_rate_gain/z",
+  GetRosParameter(private_nh_, "angular_rate_gain/z",
                   roll_pitch_yawrate_thrust_controller_.controller_parameters_.angular_rate_gain_.z(),
                   &roll_pitch_yawrate_thrust_controller_.controller_parameters_.angular_rate_gain_.z());
-  GetVehicleParameters(pnh, &roll_pitch_yawrate_thrust_controller_.vehicle_parameters_);
+  GetVehicleParameters(private_nh_, &roll_pitch_yawrate_thrust_controller_.vehicle_parameters_);
   roll_pitch_yawrate_thrust_controller_.InitializeParameters();
 }
 void RollPitchYawrateThrustControllerNode::Publish() {
@@ -84,28 +83,11 @@ void RollPitchYawrateThrustControllerNode::OdometryCallback(const nav_msgs::Odom
   eigenOdometryFromMsg(odometry_msg, &odometry);
   roll_pitch_yawrate_thrust_controller_.SetOdometry(odometry);
 
-  Eigen::VectorXd ref_rotor_velocities;
-  roll_pitch_yawrate_thrust_controller_.CalculateRotorVelocities(&ref_rotor_velocities);
-
-  // Todo(ffurrer): Do this in the conversions header.
-  mav_msgs::ActuatorsPtr actuator_msg(new mav_msgs::Actuators);
+  roll_pitch_yawrate_thrust_controller_.CalculateRotorVelocities(&ref_rotor_velocities_);
 
-  actuator_msg->angular_velocities.clear();
-  for (int i = 0; i < ref_rotor_velocities.size(); i++)
-    actuator_msg->angular_velocities.push_back(ref_rotor_velocities[i]);
-  actuator_msg->header.stamp = odometry_msg->header.stamp;
-
-  motor_velocity_reference_pub_.publish(actuator_msg);
+  actuatorsMsgFromRotorVelocities(ref_rotor_velocities_, odometry_msg->header.stamp,
+                                  &actuator_msg_);
+  motor_velocity_reference_pub_.publish(actuator_msg_);
 }
 
 }
-
-int main(int argc, char** argv) {
-  ros::init(argc, argv, "roll_pitch_yawrate_thrust_controller_node");
-
-  rotors_control::RollPitchYawrateThrustControllerNode roll_pitch_yawrate_thrust_controller_node;
-
-  ros::spin();
-
-  return 0;
-}
@@ -39,13 +39,15 @@ namespace rotors_control {
 
 class RollPitchYawrateThrustControllerNode {
  public:
-  RollPitchYawrateThrustControllerNode();
+  RollPitchYawrateThrustControllerNode(const ros::NodeHandle& nh, const ros::NodeHandle& private_nh);
   ~RollPitchYawrateThrustControllerNode();
 
   void InitializeParams();
   void Publish();
 
  private:
+  ros::NodeHandle nh_;
+  ros::NodeHandle private_nh_;
 
   RollPitchYawrateThrustController roll_pitch_yawrate_thrust_controller_;
 
@@ -57,6 +59,10 @@ class RollPitchYawrateThrustControllerNode {
 
   ros::Publisher motor_velocity_reference_pub_;
 
+  // Reused on every odometry message to avoid allocations.
+  Eigen::VectorXd ref_rotor_velocities_;
+  mav_msgs::ActuatorsPtr actuator_msg_;
+
   void RollPitchYawrateThrustCallback(
       const mav_msgs::RollPitchYawrateThrustConstPtr& roll_pitch_yawrate_thrust_reference_msg);
 
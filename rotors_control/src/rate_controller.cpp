@@ -20,6 +20,8 @@
 
 #include "rotors_control/rate_controller.h"
 
+namespace rotors_control {
+
 RateController::RateController()
     : gravity_(9.81),
       mass_(1.56779) {
@@ -37,12 +39,10 @@ void RateController::InitializeParams() {
   gain_angular_rate_(1) = 0.52;//0.6;
   gain_angular_rate_(2) = 0.025;
 
-  amount_rotors_ = 6;
-  allocation_matrix_.resize(4,amount_rotors_);
-  allocation_matrix_ << sin(M_PI/6),  1,  sin(M_PI/6), -sin(M_PI/6), -1, -sin(M_PI/6),
-                       -cos(M_PI/6),  0,  cos(M_PI/6),  cos(M_PI/6), 0, -cos(M_PI/6),
-                       -1,  1, -1,  1, -1, 1,
-                        1,  1,  1,  1, 1, 1;
+  // The default rotor configuration is the Asctec Firefly.
+  std::shared_ptr<const RotorAllocation> rotor_allocation =
+      RotorAllocation::Get(RotorConfiguration());
+  amount_rotors_ = rotor_allocation->rotor_count();
 
   inertia_matrix_<< 0.0347563,  0,  0,
                     0,  0.0458929,  0,
@@ -51,25 +51,11 @@ void RateController::InitializeParams() {
   // to make the tuning independent of the inertia matrix we divide here
   gain_angular_rate_ = gain_angular_rate_.transpose() * inertia_matrix_.inverse();
 
-  const double rotor_force_constant = 0.00000854858;  //F_i = k_n * rotor_velocity_i^2
-  const double rotor_moment_constant = 0.016;  // M_i = k_m * F_i
-
-  angular_acc_to_rotor_velocities_.resize(amount_rotors_, 4);
-  const double arm_length = 0.215;
-
-  Eigen::Matrix4d K;
-  K.setZero();
-  K(0, 0) = arm_length * rotor_force_constant;
-  K(1, 1) = arm_length * rotor_force_constant;
-  K(2, 2) = rotor_force_constant * rotor_moment_constant;
-  K(3, 3) = rotor_force_constant;
-
-  Eigen::Matrix4d I;
-  I.setZero();
-  I.block<3, 3>(0, 0) = inertia_matrix_;
-  I(3, 3) = 1;
-  angular_acc_to_rotor_velocities_ = allocation_matrix_.transpose()
-      * (allocation_matrix_ * allocation_matrix_.transpose()).inverse() * K.inverse() * I;
+  // The rotor constants are part of the cached allocation, the pseudo-inverse
+  // is only multiplied by the inertia matrix here.
+  rotor_allocation->AngularAccToRotorVelocities(inertia_matrix_,
+                                                &angular_acc_to_rotor_velocities_);
+  mixer_ = MakeRotorMixer(angular_acc_to_rotor_velocities_);
   initialized_params_ = true;
 }
 
@@ -77,8 +63,6 @@ void RateController::CalculateRotorVelocities(Eigen::VectorXd* rotor_velocities)
   assert(rotor_velocities);
   assert(initialized_params_);
 
-  rotor_velocities->resize(amount_rotors_);
-
   Eigen::Vector3d angular_acceleration;
   ComputeDesiredAngularAcc(&angular_acceleration);
 
@@ -86,9 +70,7 @@ void RateController::CalculateRotorVelocities(Eigen::VectorXd* rotor_velocities)
   angular_acceleration_thrust.block<3,1>(0,0) = angular_acceleration;
   angular_acceleration_thrust(3) = control_rate_thrust_reference_(3);
 
-  *rotor_velocities = angular_acc_to_rotor_velocities_ * angular_acceleration_thrust;
-  *rotor_velocities = rotor_velocities->cwiseMax(Eigen::VectorXd::Zero(rotor_velocities->rows()));
-  *rotor_velocities = rotor_velocities->cwiseSqrt();
+  mixer_->CalculateRotorVelocities(angular_acceleration_thrust, rotor_velocities);
 }
 
 // Implementation from the T. Lee et al. paper
@@ -109,3 +91,5 @@ void RateController::ComputeDesiredAngularAcc(Eigen::Vector3d* angular_accelerat
 
 
 ROTORS_CONTROL_REGISTER_CONTROLLER(RateController);
+
+}
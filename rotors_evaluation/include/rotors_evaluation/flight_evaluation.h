@@ -0,0 +1,172 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_EVALUATION_FLIGHT_EVALUATION_H
+#define ROTORS_EVALUATION_FLIGHT_EVALUATION_H
+
+#include <cstddef>
+#include <vector>
+
+namespace rotors_evaluation {
+
+// Same defaults as rosbag_tools/helpers.py and the *_eval.py scripts.
+static constexpr double kDefaultRmsCalcTime = 10.0;
+static constexpr double kDefaultSettlingRadius = 0.1;
+static constexpr double kDefaultMinSettledTime = 3.0;
+static constexpr double kDefaultFirstWaypointDelay = 5.0;
+static constexpr double kDefaultEndTime = 1000.0;
+static constexpr double kDefaultSettlingTimeMax = 10.0;
+static constexpr double kDefaultPositionErrorMax = 0.2;
+static constexpr double kDefaultAngularVelocityErrorMax = 0.2;
+static constexpr double kDefaultDisturbanceTime = 40.0;
+
+// x, y, z samples with their message time stamps, like XYZWithTime.
+struct TimedXyz {
+  std::vector<double> time;
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> z;
+
+  size_t size() const { return time.size(); }
+
+  void Append(double t, double x_value, double y_value, double z_value) {
+    time.push_back(t);
+    x.push_back(x_value);
+    y.push_back(y_value);
+    z.push_back(z_value);
+  }
+
+  // Index of the first sample after t.
+  size_t NextIndex(double t) const;
+
+  // Samples between the first one after start_time and the first one after
+  // end_time, like BaseWithTime.slice().
+  TimedXyz Slice(double start_time, double end_time) const;
+};
+
+// Distinct consecutive waypoints with the bag time they were recorded at,
+// like WaypointWithTime.
+struct Waypoints {
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> z;
+  std::vector<double> yaw;
+  std::vector<double> bag_time;
+
+  size_t size() const { return x.size(); }
+
+  // Appends the waypoint unless it equals the previous one.
+  void Append(double x_value, double y_value, double z_value, double yaw_value,
+              double t);
+};
+
+// Everything the evaluation needs from one flight.
+struct Flight {
+  Flight() : bag_time_start(0.0), bag_time_end(0.0) {}
+
+  TimedXyz position;
+  TimedXyz angular_velocity;
+  Waypoints waypoints;
+  std::vector<double> collision_times;
+  double bag_time_start;
+  double bag_time_end;
+};
+
+enum EvaluationMode {
+  kEvaluateWaypoints,
+  kEvaluateHovering,
+  kEvaluateDisturbance
+};
+
+struct EvaluationSettings {
+  EvaluationSettings()
+      : rms_calc_time(kDefaultRmsCalcTime),
+        settling_radius(kDefaultSettlingRadius),
+        min_settled_time(kDefaultMinSettledTime),
+        first_waypoint_delay(kDefaultFirstWaypointDelay),
+        total_end_time(kDefaultEndTime),
+        settling_time_max(kDefaultSettlingTimeMax),
+        position_error_max(kDefaultPositionErrorMax),
+        angular_velocity_error_max(kDefaultAngularVelocityErrorMax),
+        disturbance_time(kDefaultDisturbanceTime) {}
+
+  double rms_calc_time;
+  double settling_radius;
+  double min_settled_time;
+  double first_waypoint_delay;
+  double total_end_time;
+  double settling_time_max;
+  double position_error_max;
+  double angular_velocity_error_max;
+  double disturbance_time;
+};
+
+// Metrics of one flight, the values are only meaningful if the matching
+// has_* flag is set. Scores are only given for collision-free flights, as in
+// the Python scripts.
+struct EvaluationResult {
+  EvaluationResult()
+      : has_settling_time(false),
+        has_rms_errors(false),
+        collision_free(false),
+        settling_time(0.0),
+        position_rms_error(0.0),
+        angular_velocity_rms_error(0.0),
+        settling_time_score(0.0),
+        position_score(0.0),
+        angular_velocity_score(0.0) {}
+
+  bool has_settling_time;
+  bool has_rms_errors;
+  bool collision_free;
+  double settling_time;
+  double position_rms_error;
+  double angular_velocity_rms_error;
+  double settling_time_score;
+  double position_score;
+  double angular_velocity_score;
+};
+
+// RMS distance of the samples in series to the set point.
+double XyzRmsError(double set_point_x, double set_point_y, double set_point_z,
+                   const TimedXyz& series);
+
+// Time, measured from the first sample, after which series stays within
+// bounding_radius of the set point for at least min_time. Returns false if
+// it never settles.
+bool SettlingTime(double set_point_x, double set_point_y, double set_point_z,
+                  const TimedXyz& series, double bounding_radius,
+                  double min_time, double* settling_time);
+
+// Whether a collision was recorded in [start_time, end_time].
+bool HasCollisions(const Flight& flight, double start_time, double end_time);
+
+// Score of a value, scores has to hold 4 values, like helpers.get_score().
+double GetScore(double value, double max_value, const double* scores);
+
+// Computes the metrics of waypoints_eval.py, hovering_eval.py or
+// disturbance_eval.py. Returns false if the flight has no waypoint.
+bool EvaluateFlight(const Flight& flight, EvaluationMode mode,
+                    const EvaluationSettings& settings,
+                    EvaluationResult* result);
+
+}  // namespace rotors_evaluation
+
+#endif  // ROTORS_EVALUATION_FLIGHT_EVALUATION_H
@@ -0,0 +1,352 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Evaluates many bags in parallel, one bag per thread, and prints one line
+// of metrics per bag. Computes the same metrics as waypoints_eval.py,
+// hovering_eval.py and disturbance_eval.py, e.g.
+//
+//   rosrun rotors_evaluation batch_eval --mode waypoints --mav_name firefly
+//       --jobs 8 ~/.ros/campaign/*.bag
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <geometry_msgs/PointStamped.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <geometry_msgs/TransformStamped.h>
+#include <geometry_msgs/TwistStamped.h>
+#include <geometry_msgs/WrenchStamped.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <trajectory_msgs/MultiDOFJointTrajectory.h>
+
+#include "rotors_evaluation/flight_evaluation.h"
+
+namespace rotors_evaluation {
+
+// Same defaults as rosbag_tools/helpers.py.
+static const std::string kDefaultPoseTopic = "/ground_truth/pose";
+static const std::string kDefaultTwistTopic = "/ground_truth/twist";
+static const std::string kDefaultWaypointTopic = "/command/trajectory";
+static const std::string kDefaultWrenchTopic = "/wrench";
+
+struct BatchOptions {
+  BatchOptions()
+      : mode(kEvaluateWaypoints),
+        pose_topic(kDefaultPoseTopic),
+        twist_topic(kDefaultTwistTopic),
+        waypoint_topic(kDefaultWaypointTopic),
+        wrench_topic(kDefaultWrenchTopic),
+        jobs(std::thread::hardware_concurrency()) {}
+
+  EvaluationMode mode;
+  EvaluationSettings settings;
+  std::string mav_name;
+  std::string pose_topic;
+  std::string twist_topic;
+  std::string waypoint_topic;
+  std::string wrench_topic;
+  int jobs;
+  std::vector<std::string> bags;
+};
+
+struct BagEvaluation {
+  BagEvaluation() : evaluated(false), num_waypoints(0) {}
+
+  bool evaluated;
+  std::string error;
+  size_t num_waypoints;
+  EvaluationResult result;
+};
+
+// Reads the topics of the evaluation from the bag, one message at a time.
+bool ReadFlight(const std::string& bag_filename, const BatchOptions& options,
+                Flight* flight, std::string* error) {
+  const std::string pose_topic = options.mav_name + options.pose_topic;
+  const std::string twist_topic = options.mav_name + options.twist_topic;
+  const std::string waypoint_topic = options.mav_name + options.waypoint_topic;
+  const std::string wrench_topic = options.mav_name + options.wrench_topic;
+
+  try {
+    rosbag::Bag bag(bag_filename, rosbag::bagmode::Read);
+    rosbag::View view(bag, rosbag::TopicQuery(std::vector<std::string>{
+                               pose_topic, twist_topic, waypoint_topic,
+                               wrench_topic}));
+    bool first = true;
+    for (const rosbag::MessageInstance& message : view) {
+      const double bag_time = message.getTime().toSec();
+      if (first) {
+        flight->bag_time_start = bag_time;
+        first = false;
+      }
+      flight->bag_time_end = bag_time;
+
+      const std::string& topic = message.getTopic();
+      if (topic == pose_topic) {
+        geometry_msgs::PoseStamped::ConstPtr pose =
+            message.instantiate<geometry_msgs::PoseStamped>();
+        if (pose) {
+          flight->position.Append(pose->header.stamp.toSec(),
+                                  pose->pose.position.x, pose->pose.position.y,
+                                  pose->pose.position.z);
+          continue;
+        }
+        geometry_msgs::TransformStamped::ConstPtr transform =
+            message.instantiate<geometry_msgs::TransformStamped>();
+        if (transform) {
+          flight->position.Append(transform->header.stamp.toSec(),
+                                  transform->transform.translation.x,
+                                  transform->transform.translation.y,
+                                  transform->transform.translation.z);
+          continue;
+        }
+        geometry_msgs::PointStamped::ConstPtr point =
+            message.instantiate<geometry_msgs::PointStamped>();
+        if (point) {
+          flight->position.Append(point->header.stamp.toSec(), point->point.x,
+                                  point->point.y, point->point.z);
+        }
+      } else if (topic == twist_topic) {
+        geometry_msgs::TwistStamped::ConstPtr twist =
+            message.instantiate<geometry_msgs::TwistStamped>();
+        if (twist) {
+          flight->angular_velocity.Append(
+              twist->header.stamp.toSec(), twist->twist.angular.x,
+              twist->twist.angular.y, twist->twist.angular.z);
+        }
+      } else if (topic == waypoint_topic) {
+        trajectory_msgs::MultiDOFJointTrajectory::ConstPtr trajectory =
+            message.instantiate<trajectory_msgs::MultiDOFJointTrajectory>();
+        if (trajectory && !trajectory->points.empty() &&
+            !trajectory->points[0].transforms.empty()) {
+          const geometry_msgs::Transform& transform =
+              trajectory->points[0].transforms[0];
+          const geometry_msgs::Quaternion& q = transform.rotation;
+          const double yaw = std::atan2(2.0 * (q.w * q.z + q.x * q.y),
+                                        1.0 - 2.0 * (q.y * q.y + q.z * q.z));
+          flight->waypoints.Append(transform.translation.x,
+                                   transform.translation.y,
+                                   transform.translation.z, yaw, bag_time);
+        }
+      } else if (topic == wrench_topic) {
+        geometry_msgs::WrenchStamped::ConstPtr wrench =
+            message.instantiate<geometry_msgs::WrenchStamped>();
+        if (wrench) {
+          flight->collision_times.push_back(wrench->header.stamp.toSec());
+        }
+      }
+    }
+  } catch (const rosbag::BagException& e) {
+    *error = e.what();
+    return false;
+  }
+  return true;
+}
+
+void EvaluateBag(const std::string& bag_filename, const BatchOptions& options,
+                 BagEvaluation* evaluation) {
+  Flight flight;
+  if (!ReadFlight(bag_filename, options, &flight, &evaluation->error)) {
+    return;
+  }
+  evaluation->num_waypoints = flight.waypoints.size();
+  if (!EvaluateFlight(flight, options.mode, options.settings,
+                      &evaluation->result)) {
+    evaluation->error = "no waypoint on " + options.mav_name +
+                        options.waypoint_topic;
+    return;
+  }
+  evaluation->evaluated = true;
+}
+
+void PrintValue(bool valid, double value) {
+  if (valid) {
+    std::printf(" %12.3f", value);
+  } else {
+    std::printf(" %12s", "-");
+  }
+}
+
+void PrintSummary(const BatchOptions& options,
+                  const std::vector<BagEvaluation>& evaluations) {
+  std::printf("%-40s %9s %12s %12s %12s %9s %12s %12s %12s\n", "bag",
+              "waypoints", "settling[s]", "pos_rms[m]", "pqr_rms[r/s]",
+              "collision", "settling_pt", "pos_pt", "pqr_pt");
+  double score_sum = 0.0;
+  int num_scored = 0;
+  for (size_t i = 0; i < evaluations.size(); ++i) {
+    const BagEvaluation& evaluation = evaluations[i];
+    std::string name = options.bags[i];
+    const size_t slash = name.rfind('/');
+    if (slash != std::string::npos) {
+      name = name.substr(slash + 1);
+    }
+    if (!evaluation.evaluated) {
+      std::printf("%-40s failed: %s\n", name.c_str(), evaluation.error.c_str());
+      continue;
+    }
+    const EvaluationResult& result = evaluation.result;
+    std::printf("%-40s %9zu", name.c_str(), evaluation.num_waypoints);
+    PrintValue(result.has_settling_time, result.settling_time);
+    PrintValue(result.has_rms_errors, result.position_rms_error);
+    PrintValue(result.has_rms_errors, result.angular_velocity_rms_error);
+    std::printf(" %9s", result.collision_free ? "no" : "yes");
+    const bool scored = result.collision_free;
+    PrintValue(scored && result.has_settling_time, result.settling_time_score);
+    PrintValue(scored && result.has_rms_errors, result.position_score);
+    PrintValue(scored && result.has_rms_errors,
+               result.angular_velocity_score);
+    std::printf("\n");
+    if (scored) {
+      score_sum += result.settling_time_score + result.position_score +
+                   result.angular_velocity_score;
+      ++num_scored;
+    }
+  }
+  std::printf("\n%d of %zu flights scored, average total score %.2f\n",
+              num_scored, evaluations.size(),
+              num_scored > 0 ? score_sum / num_scored : 0.0);
+}
+
+void PrintUsage(const char* program) {
+  std::fprintf(
+      stderr,
+      "usage: %s [options] bag...\n"
+      "  --mode waypoints|hovering|disturbance  (default waypoints)\n"
+      "  --mav_name NAME              namespace of the topics\n"
+      "  --pose_topic TOPIC           default %s\n"
+      "  --twist_topic TOPIC          default %s\n"
+      "  --waypoint_topic TOPIC       default %s\n"
+      "  --wrench_topic TOPIC         default %s\n"
+      "  --settling_radius R          [m], default %.2f\n"
+      "  --min_settled_time T         [s], default %.1f\n"
+      "  --delay_first_evaluation T   [s], default %.1f\n"
+      "  --rms_calc_time T            [s], default %.1f\n"
+      "  --end_time T                 [s], default %.1f\n"
+      "  --disturbance_time T         [s], default %.1f\n"
+      "  --jobs N                     bags evaluated in parallel, default: "
+      "one per core\n",
+      program, kDefaultPoseTopic.c_str(), kDefaultTwistTopic.c_str(),
+      kDefaultWaypointTopic.c_str(), kDefaultWrenchTopic.c_str(),
+      kDefaultSettlingRadius, kDefaultMinSettledTime,
+      kDefaultFirstWaypointDelay, kDefaultRmsCalcTime, kDefaultEndTime,
+      kDefaultDisturbanceTime);
+}
+
+bool ParseOptions(int argc, char** argv, BatchOptions* options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg.compare(0, 2, "--") != 0) {
+      options->bags.push_back(arg);
+      continue;
+    }
+    if (i + 1 >= argc) {
+      std::fprintf(stderr, "Missing value of %s.\n", arg.c_str());
+      return false;
+    }
+    const std::string value = argv[++i];
+    EvaluationSettings& settings = options->settings;
+    if (arg == "--mode") {
+      if (value == "waypoints") {
+        options->mode = kEvaluateWaypoints;
+      } else if (value == "hovering") {
+        options->mode = kEvaluateHovering;
+      } else if (value == "disturbance") {
+        options->mode = kEvaluateDisturbance;
+      } else {
+        std::fprintf(stderr, "Unknown mode %s.\n", value.c_str());
+        return false;
+      }
+    } else if (arg == "--mav_name") {
+      options->mav_name = value;
+    } else if (arg == "--pose_topic") {
+      options->pose_topic = value;
+    } else if (arg == "--twist_topic") {
+      options->twist_topic = value;
+    } else if (arg == "--waypoint_topic") {
+      options->waypoint_topic = value;
+    } else if (arg == "--wrench_topic") {
+      options->wrench_topic = value;
+    } else if (arg == "--settling_radius") {
+      settings.settling_radius = std::atof(value.c_str());
+    } else if (arg == "--min_settled_time") {
+      settings.min_settled_time = std::atof(value.c_str());
+    } else if (arg == "--delay_first_evaluation") {
+      settings.first_waypoint_delay = std::atof(value.c_str());
+    } else if (arg == "--rms_calc_time") {
+      settings.rms_calc_time = std::atof(value.c_str());
+    } else if (arg == "--end_time") {
+      settings.total_end_time = std::atof(value.c_str());
+    } else if (arg == "--disturbance_time") {
+      settings.disturbance_time = std::atof(value.c_str());
+    } else if (arg == "--jobs") {
+      options->jobs = std::atoi(value.c_str());
+    } else {
+      std::fprintf(stderr, "Unknown option %s.\n", arg.c_str());
+      return false;
+    }
+  }
+  if (options->jobs < 1) {
+    options->jobs = 1;
+  }
+  return !options->bags.empty();
+}
+
+}  // namespace rotors_evaluation
+
+int main(int argc, char** argv) {
+  using namespace rotors_evaluation;
+
+  BatchOptions options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  // Every worker takes the next bag until none is left, so long and short
+  // flights balance out over the threads.
+  std::vector<BagEvaluation> evaluations(options.bags.size());
+  std::atomic<size_t> next_bag(0);
+  auto worker = [&]() {
+    for (size_t i = next_bag++; i < options.bags.size(); i = next_bag++) {
+      EvaluateBag(options.bags[i], options, &evaluations[i]);
+    }
+  };
+  const size_t num_threads =
+      std::min<size_t>(options.jobs, options.bags.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  PrintSummary(options, evaluations);
+  return 0;
+}
@@ -0,0 +1,268 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_evaluation/flight_evaluation.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace rotors_evaluation {
+
+namespace {
+
+const double kSettlingTimeScores[] = {0.0, 1.5, 3.5, 5.0};
+const double kPositionScores[] = {0.0, 1.5, 3.5, 5.0};
+const double kAngularVelocityScores[] = {0.0, 1.0, 2.0, 3.0};
+
+// Begin and end of the evaluation of a waypoint, relative to the start of
+// the bag, like helpers.get_evaluation_period().
+void GetEvaluationPeriod(const Flight& flight, const EvaluationSettings& settings,
+                         size_t index, double* begin_time, double* end_time) {
+  *begin_time = flight.waypoints.bag_time[index] - flight.bag_time_start;
+  if (index + 1 < flight.waypoints.size()) {
+    *end_time = flight.waypoints.bag_time[index + 1] - flight.bag_time_start;
+  } else {
+    *end_time = std::min(settings.total_end_time, flight.bag_time_end);
+  }
+}
+
+void ComputeRmsErrors(const Flight& flight, const Waypoints& waypoints,
+                      size_t index, double start_time, double end_time,
+                      double* position_rms_error,
+                      double* angular_velocity_rms_error) {
+  *position_rms_error =
+      XyzRmsError(waypoints.x[index], waypoints.y[index], waypoints.z[index],
+                  flight.position.Slice(start_time, end_time));
+  *angular_velocity_rms_error = XyzRmsError(
+      0.0, 0.0, 0.0, flight.angular_velocity.Slice(start_time, end_time));
+}
+
+double Average(const std::vector<double>& values) {
+  double sum = 0.0;
+  for (double value : values) {
+    sum += value;
+  }
+  return sum / values.size();
+}
+
+}  // namespace
+
+size_t TimedXyz::NextIndex(double t) const {
+  return std::upper_bound(time.begin(), time.end(), t) - time.begin();
+}
+
+TimedXyz TimedXyz::Slice(double start_time, double end_time) const {
+  const size_t start = NextIndex(start_time);
+  const size_t end = std::max(start, NextIndex(end_time));
+  TimedXyz sliced;
+  sliced.time.assign(time.begin() + start, time.begin() + end);
+  sliced.x.assign(x.begin() + start, x.begin() + end);
+  sliced.y.assign(y.begin() + start, y.begin() + end);
+  sliced.z.assign(z.begin() + start, z.begin() + end);
+  return sliced;
+}
+
+void Waypoints::Append(double x_value, double y_value, double z_value,
+                       double yaw_value, double t) {
+  if (!x.empty() && yaw.back() == yaw_value && x.back() == x_value &&
+      y.back() == y_value && z.back() == z_value) {
+    return;
+  }
+  x.push_back(x_value);
+  y.push_back(y_value);
+  z.push_back(z_value);
+  yaw.push_back(yaw_value);
+  bag_time.push_back(t);
+}
+
+double XyzRmsError(double set_point_x, double set_point_y, double set_point_z,
+                   const TimedXyz& series) {
+  if (series.size() == 0) {
+    return 0.0;
+  }
+  double sum_of_squares = 0.0;
+  for (size_t i = 0; i < series.size(); ++i) {
+    const double x_error = series.x[i] - set_point_x;
+    const double y_error = series.y[i] - set_point_y;
+    const double z_error = series.z[i] - set_point_z;
+    sum_of_squares += x_error * x_error + y_error * y_error + z_error * z_error;
+  }
+  return std::sqrt(sum_of_squares / series.size());
+}
+
+bool SettlingTime(double set_point_x, double set_point_y, double set_point_z,
+                  const TimedXyz& series, double bounding_radius,
+                  double min_time, double* settling_time) {
+  bool bounded = false;
+  double bounded_time = 0.0;
+  for (size_t i = 0; i < series.size(); ++i) {
+    const double x_error = series.x[i] - set_point_x;
+    const double y_error = series.y[i] - set_point_y;
+    const double z_error = series.z[i] - set_point_z;
+    const double error_radius =
+        std::sqrt(x_error * x_error + y_error * y_error + z_error * z_error);
+    if (error_radius > bounding_radius) {
+      bounded = false;
+    } else if (!bounded) {
+      bounded = true;
+      bounded_time = series.time[i];
+    } else if (series.time[i] - bounded_time >= min_time) {
+      *settling_time = bounded_time - series.time[0];
+      return true;
+    }
+  }
+  return false;
+}
+
+bool HasCollisions(const Flight& flight, double start_time, double end_time) {
+  for (double t : flight.collision_times) {
+    if (t >= start_time && t <= end_time) {
+      return true;
+    }
+  }
+  return false;
+}
+
+double GetScore(double value, double max_value, const double* scores) {
+  if (value > max_value) {
+    return scores[0];
+  } else if (value > 0.5 * max_value) {
+    return scores[1];
+  } else if (value > 0.1 * max_value) {
+    return scores[2];
+  }
+  return scores[3];
+}
+
+bool EvaluateFlight(const Flight& flight, EvaluationMode mode,
+                    const EvaluationSettings& settings,
+                    EvaluationResult* result) {
+  *result = EvaluationResult();
+  const Waypoints& waypoints = flight.waypoints;
+  if (waypoints.size() == 0) {
+    return false;
+  }
+
+  double begin_time;
+  double end_time;
+  double rms_evaluation_end_time = 0.0;
+
+  if (mode == kEvaluateWaypoints) {
+    std::vector<double> settling_times;
+    std::vector<double> position_rms_errors;
+    std::vector<double> angular_velocity_rms_errors;
+    for (size_t index = 0; index < waypoints.size(); ++index) {
+      GetEvaluationPeriod(flight, settings, index, &begin_time, &end_time);
+      // The MAV most likely still touches the ground at the first waypoint,
+      // its errors are computed after a delay but not counted.
+      if (index == 0) {
+        begin_time += settings.first_waypoint_delay;
+        rms_evaluation_end_time =
+            std::min(begin_time + settings.rms_calc_time, end_time);
+        continue;
+      }
+      double settling_time;
+      if (SettlingTime(waypoints.x[index], waypoints.y[index],
+                       waypoints.z[index],
+                       flight.position.Slice(begin_time, end_time),
+                       settings.settling_radius, settings.min_settled_time,
+                       &settling_time) &&
+          settling_time < settings.settling_time_max) {
+        const double rms_evaluation_start_time = begin_time + settling_time;
+        rms_evaluation_end_time = std::min(
+            rms_evaluation_start_time + settings.rms_calc_time, end_time);
+        double position_rms_error;
+        double angular_velocity_rms_error;
+        ComputeRmsErrors(flight, waypoints, index, rms_evaluation_start_time,
+                         rms_evaluation_end_time, &position_rms_error,
+                         &angular_velocity_rms_error);
+        settling_times.push_back(settling_time);
+        position_rms_errors.push_back(position_rms_error);
+        angular_velocity_rms_errors.push_back(angular_velocity_rms_error);
+      } else {
+        // Not settled, count 101 % of the maximum values.
+        settling_times.push_back(settings.settling_time_max * 1.01);
+        position_rms_errors.push_back(settings.position_error_max * 1.01);
+        angular_velocity_rms_errors.push_back(
+            settings.angular_velocity_error_max * 1.01);
+      }
+    }
+    if (!settling_times.empty()) {
+      result->has_settling_time = true;
+      result->has_rms_errors = true;
+      result->settling_time = Average(settling_times);
+      result->position_rms_error = Average(position_rms_errors);
+      result->angular_velocity_rms_error = Average(angular_velocity_rms_errors);
+    }
+  } else if (mode == kEvaluateHovering) {
+    GetEvaluationPeriod(flight, settings, 0, &begin_time, &end_time);
+    begin_time += settings.first_waypoint_delay;
+    rms_evaluation_end_time =
+        std::min(begin_time + settings.rms_calc_time, end_time);
+    ComputeRmsErrors(flight, waypoints, 0, begin_time, rms_evaluation_end_time,
+                     &result->position_rms_error,
+                     &result->angular_velocity_rms_error);
+    result->has_rms_errors = true;
+  } else {
+    GetEvaluationPeriod(flight, settings, 0, &begin_time, &end_time);
+    begin_time = settings.disturbance_time;
+    rms_evaluation_end_time =
+        std::min(begin_time + settings.rms_calc_time, end_time);
+    double settling_time;
+    if (SettlingTime(waypoints.x[0], waypoints.y[0], waypoints.z[0],
+                     flight.position.Slice(begin_time, end_time),
+                     settings.settling_radius, settings.min_settled_time,
+                     &settling_time) &&
+        settling_time < settings.settling_time_max) {
+      const double rms_evaluation_start_time = begin_time + settling_time;
+      rms_evaluation_end_time = std::min(
+          rms_evaluation_start_time + settings.rms_calc_time, end_time);
+      ComputeRmsErrors(flight, waypoints, 0, rms_evaluation_start_time,
+                       rms_evaluation_end_time, &result->position_rms_error,
+                       &result->angular_velocity_rms_error);
+      result->has_settling_time = true;
+      result->has_rms_errors = true;
+      result->settling_time = settling_time;
+    }
+  }
+
+  const double start_collision_time =
+      waypoints.bag_time[0] + settings.first_waypoint_delay;
+  result->collision_free =
+      !HasCollisions(flight, start_collision_time, rms_evaluation_end_time);
+  if (result->collision_free) {
+    if (result->has_settling_time) {
+      result->settling_time_score =
+          GetScore(result->settling_time, settings.settling_time_max,
+                   kSettlingTimeScores);
+    }
+    if (result->has_rms_errors) {
+      result->position_score =
+          GetScore(result->position_rms_error, settings.position_error_max,
+                   kPositionScores);
+      result->angular_velocity_score = GetScore(
+          result->angular_velocity_rms_error,
+          settings.angular_velocity_error_max, kAngularVelocityScores);
+    }
+  }
+  return true;
+}
+
+}  // namespace rotors_evaluation
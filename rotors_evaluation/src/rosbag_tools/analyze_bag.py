@@ -6,9 +6,12 @@ import matplotlib
 matplotlib.use('Agg')
 from matplotlib import pyplot
 import numpy
+import rospy
 from scipy import signal
 from geometry_msgs.msg import PoseStamped, Quaternion, Point
 
+from rosbag_tools.flight_log import FlightLog
+
 
 __author__ = "Fadri Furrer, Michael Burri, Markus Achtelik"
 __copyright__ = ("Copyright 2015, Fadri Furrer & Michael Burri & "
@@ -212,8 +215,12 @@ class AnalyzeBag(object):
 
     """This class can be used to plot data and compare data."""
 
-    def __init__(self, bag_path_name, save_plots, prefix=None):
+    def __init__(self, bag_path_name, save_plots, prefix=None,
+                 flight_log_path_name=None):
         self.bag = rosbag.Bag(bag_path_name)
+        # Streams found in the flight log are read from it instead of the bag.
+        self.flight_log = (FlightLog(flight_log_path_name)
+                           if flight_log_path_name else None)
         self.topics = []
         self.pose_topics = []
         self.twist_topics = []
@@ -276,7 +283,11 @@ class AnalyzeBag(object):
 
     def extract_messages(self):
         """Run through the bag file and assign the msgs to its attributes."""
-        for topic, msg, bag_time in self.bag.read_messages(topics=self.topics):
+        bag_topics = self.topics
+        if self.flight_log:
+            bag_topics = [topic for topic in self.topics
+                          if topic not in self.flight_log.streams]
+        for topic, msg, bag_time in self.bag.read_messages(topics=bag_topics):
             if self.bag_time_start is None:
                 self.bag_time_start = bag_time
             self.extract_pose_topics(topic, msg, bag_time)
@@ -286,6 +297,77 @@ class AnalyzeBag(object):
             self.extract_waypoint_topics(topic, msg, bag_time)
             self.extract_wrench_topics(topic, msg, bag_time)
             self.bag_time_end = bag_time
+        if self.flight_log:
+            self.extract_flight_log()
+
+    def extract_flight_log(self):
+        """Assign whole columns of the flight log streams to the attributes."""
+        log = self.flight_log
+        for index, topic in enumerate(self.pose_topics):
+            if topic not in log.streams:
+                continue
+            columns = log.read(topic)
+            self.pos[index].x = columns['position_x']
+            self.pos[index].y = columns['position_y']
+            self.pos[index].z = columns['position_z']
+            self.quat[index].w = columns['orientation_w']
+            self.quat[index].x = columns['orientation_x']
+            self.quat[index].y = columns['orientation_y']
+            self.quat[index].z = columns['orientation_z']
+            [self.rpy[index].roll, self.rpy[index].pitch,
+             self.rpy[index].yaw] = quaternion_columns_to_rpy(
+                 columns['orientation_w'], columns['orientation_x'],
+                 columns['orientation_y'], columns['orientation_z'])
+            for series in [self.pos[index], self.quat[index],
+                           self.rpy[index]]:
+                self._set_flight_log_times(series, topic)
+        for index, topic in enumerate(self.twist_topics):
+            if topic not in log.streams:
+                continue
+            columns = log.read(topic)
+            self.pqr[index].x = columns['angular_x']
+            self.pqr[index].y = columns['angular_y']
+            self.pqr[index].z = columns['angular_z']
+            self._set_flight_log_times(self.pqr[index], topic)
+        for index, topic in enumerate(self.imu_topics):
+            if topic not in log.streams:
+                continue
+            columns = log.read(topic)
+            self.acc[index].x = columns['linear_acceleration_x']
+            self.acc[index].y = columns['linear_acceleration_y']
+            self.acc[index].z = columns['linear_acceleration_z']
+            self._set_flight_log_times(self.acc[index], topic)
+        for index, topic in enumerate(self.motor_velocity_topics):
+            if topic not in log.streams:
+                continue
+            columns = log.read(topic)
+            names = [name for name in log.streams[topic].column_names()
+                     if name.startswith('motor_')]
+            self.motor_vel[index].data = numpy.column_stack(
+                [columns[name] for name in names])
+            self._set_flight_log_times(self.motor_vel[index], topic)
+        for index, topic in enumerate(self.wrench_topics):
+            if topic not in log.streams:
+                continue
+            columns = log.read(topic)
+            for name in ['force_x', 'force_y', 'force_z',
+                         'torque_x', 'torque_y', 'torque_z']:
+                self.wrench[index].__setattr__(name, columns[name])
+            self._set_flight_log_times(self.wrench[index], topic)
+
+    def _set_flight_log_times(self, series, topic):
+        """Set the times of series, and widen the bag time span to them."""
+        times = self.flight_log.read_times(topic)
+        series.time = times
+        series.bag_time = times
+        if len(times) == 0:
+            return
+        if (self.bag_time_start is None or
+                times[0] < self.bag_time_start.to_sec()):
+            self.bag_time_start = rospy.Time.from_sec(times[0])
+        if (self.bag_time_end is None or
+                times[-1] > self.bag_time_end.to_sec()):
+            self.bag_time_end = rospy.Time.from_sec(times[-1])
 
     def extract_pose_topics(self, topic, msg, bag_time):
         """Append the pose topic msg content to the rpy and pos attributes."""
@@ -630,6 +712,14 @@ class AnalyzeBag(object):
         return collision_times
 
 
+def quaternion_columns_to_rpy(w, x, y, z):
+    """Convert arrays of quaternion components to roll, pitch, yaw [deg]."""
+    roll = numpy.arctan2(2 * (w * x + y * z), 1 - 2 * (x ** 2 + y ** 2))
+    pitch = numpy.arcsin(numpy.clip(2 * (w * y - z * x), -1.0, 1.0))
+    yaw = numpy.arctan2(2 * (w * z + x * y), 1 - 2 * (y ** 2 + z ** 2))
+    return [roll * 180 / math.pi, pitch * 180 / math.pi, yaw * 180 / math.pi]
+
+
 def compare_two_xyz(xyz_one, xyz_two):
     # TODO(ff): Implement some position comparison
     pass
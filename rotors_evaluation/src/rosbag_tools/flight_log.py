@@ -0,0 +1,129 @@
+"""Reader for the columnar flight logs written by the GazeboBagPlugin."""
+
+import mmap
+import struct
+import zlib
+
+import numpy
+
+
+__author__ = "Fadri Furrer, Michael Burri, Markus Achtelik"
+__copyright__ = ("Copyright 2015, Fadri Furrer & Michael Burri & "
+                 "Markus Achtelik, ASL, ETH Zurich, Switzerland")
+__credits__ = ["Fadri Furrer", "Michael Burri", "Markus Achtelik"]
+__license__ = "ASL 2.0"
+__version__ = "0.1"
+__maintainer__ = "Fadri Furrer"
+__email__ = "fadri.furrer@mavt.ethz.ch"
+__status__ = "Development"
+
+
+# Has to match rotors_gazebo_plugins/flight_log.h.
+MAGIC = b'ROTORSFL'
+VERSION = 1
+FILE_HEADER = struct.Struct('<8sII')
+RECORD_HEADER = struct.Struct('<IIIIQQ')
+SCHEMA_RECORD = 1
+BLOCK_RECORD = 2
+ZLIB = 1
+COLUMN_TYPES = {'q': numpy.dtype('<i8'), 'd': numpy.dtype('<f8')}
+
+
+class FlightLogStream(object):
+
+    """Names, types and blocks of one stream of a flight log."""
+
+    def __init__(self, name, columns):
+        self.name = name
+        # List of (column name, numpy dtype).
+        self.columns = columns
+        # List of (header, payload offset) of the blocks.
+        self.blocks = []
+        self._arrays = None
+
+    def column_names(self):
+        return [name for name, _ in self.columns]
+
+    def num_rows(self):
+        return sum(header[2] for header, _ in self.blocks)
+
+
+class FlightLog(object):
+
+    """
+    Memory-maps a flight log and gives every column as a numpy array.
+
+    Only the record headers are read when opening the file. The columns of a
+    stream are assembled on first access: uncompressed blocks are used in
+    place from the mapping, compressed ones are inflated.
+    """
+
+    def __init__(self, path):
+        self._file = open(path, 'rb')
+        self._map = mmap.mmap(self._file.fileno(), 0, access=mmap.ACCESS_READ)
+        self.streams = {}
+        self._streams_by_id = {}
+        self._index()
+
+    def close(self):
+        self._map.close()
+        self._file.close()
+
+    def _index(self):
+        magic, version, _ = FILE_HEADER.unpack_from(self._map, 0)
+        if magic != MAGIC or version != VERSION:
+            raise IOError("Not a flight log of version %d." % VERSION)
+        offset = FILE_HEADER.size
+        size = len(self._map)
+        while offset + RECORD_HEADER.size <= size:
+            header = RECORD_HEADER.unpack_from(self._map, offset)
+            record_type, stream_id, _, _, stored_size, _ = header
+            payload = offset + RECORD_HEADER.size
+            if payload + stored_size > size:
+                # Truncated last block, e.g. the simulation was killed.
+                break
+            if record_type == SCHEMA_RECORD:
+                self._add_stream(stream_id,
+                                 self._map[payload:payload + stored_size])
+            elif record_type == BLOCK_RECORD:
+                self._streams_by_id[stream_id].blocks.append((header, payload))
+            offset = payload + stored_size + (-stored_size % 8)
+
+    def _add_stream(self, stream_id, schema):
+        lines = schema.decode('utf-8').splitlines()
+        columns = []
+        for line in lines[1:]:
+            name, type_code = line.rsplit(' ', 1)
+            columns.append((name, COLUMN_TYPES[type_code]))
+        stream = FlightLogStream(lines[0], columns)
+        self.streams[stream.name] = stream
+        self._streams_by_id[stream_id] = stream
+
+    def read(self, stream_name):
+        """Return a dict of column name to numpy array for the stream."""
+        stream = self.streams[stream_name]
+        if stream._arrays is not None:
+            return stream._arrays
+        parts = [[] for _ in stream.columns]
+        for header, payload in stream.blocks:
+            _, _, num_rows, compression, stored_size, raw_size = header
+            if compression == ZLIB:
+                data = zlib.decompress(self._map[payload:payload + stored_size])
+                base = 0
+            else:
+                data = self._map
+                base = payload
+            for index, (_, dtype) in enumerate(stream.columns):
+                parts[index].append(numpy.frombuffer(
+                    data, dtype=dtype, count=num_rows,
+                    offset=base + index * num_rows * dtype.itemsize))
+        stream._arrays = {}
+        for index, (name, dtype) in enumerate(stream.columns):
+            stream._arrays[name] = (numpy.concatenate(parts[index]) if
+                                    parts[index] else
+                                    numpy.array([], dtype=dtype))
+        return stream._arrays
+
+    def read_times(self, stream_name):
+        """Return the time stamps of the stream in seconds."""
+        return self.read(stream_name)['stamp_ns'] * 1e-9
@@ -70,6 +70,13 @@ def initialize():
         dest="bagfile",
         type="string",
         help="Specify the bag file you want to analyze, with the path.")
+    parser.add_option(
+        "-l", "--flight_log",
+        dest="flight_log",
+        default=None,
+        type="string",
+        help="Flight log recorded next to the bag file. The streams in it "
+             "are read from it instead of the bag.")
     parser.add_option(
         "-p", "--pose_topic",
         dest="pose_topic",
@@ -194,7 +201,8 @@ def initialize():
 
     # Create a new Analyze bag object, to do the evaluation on.
     ab = analyze_bag.AnalyzeBag(bag_path_name=bagfile, save_plots=save_plots,
-                                prefix=prefix)
+                                prefix=prefix,
+                                flight_log_path_name=options.flight_log)
 
     # Add all the topics of the different message types.
     for pose_topic in pose_topics:
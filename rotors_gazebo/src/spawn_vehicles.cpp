@@ -0,0 +1,291 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Spawns many copies of a vehicle type in one batch, started by
+// spawn_vehicles.launch.
+//
+// The xacro of the vehicle is expanded once with a placeholder namespace, and
+// the URDF converted to SDF. The SDF is cached in ~cache_dir, keyed by the
+// xacro file, its arguments and the modification times of the description
+// files, so that later launches skip xacro and the conversion altogether.
+// Every vehicle is then a copy of the cached SDF with the placeholder replaced
+// by its namespace. All factory messages are sent to Gazebo at once, which
+// inserts the models in the same world update instead of one spawn service
+// call after the other.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <gazebo/gazebo_client.hh>
+#include <gazebo/msgs/msgs.hh>
+#include <gazebo/transport/transport.hh>
+#include <ros/ros.h>
+#include <sdf/sdf.hh>
+
+namespace {
+
+static const std::string kDefaultMavName = "firefly";
+static const std::string kDefaultCacheDir = "rotors_vehicle_cache";
+static constexpr int kDefaultNumVehicles = 1;
+static constexpr int kDefaultColumns = 0;
+static constexpr double kDefaultSpacing = 2.0;
+static constexpr double kDefaultZ = 0.1;
+static constexpr double kDefaultConnectTimeout = 60.0;
+
+/// \brief  Namespace the xacro is expanded with, replaced by the namespace of
+///         every vehicle. It has to be a valid ROS name that does not occur
+///         in the description otherwise.
+static const std::string kNamespacePlaceholder = "rotors_spawn_namespace";
+
+/// \brief  64 bit FNV-1a hash.
+uint64_t Hash(const std::string& data, uint64_t hash = 14695981039346656037ull) {
+  for (const char c : data) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+/// \brief  Names and modification times of the files in a directory, the
+///         files the xacro of a vehicle includes.
+std::string DirectoryStamp(const std::string& directory) {
+  std::vector<std::string> names;
+  if (DIR* dir = opendir(directory.c_str())) {
+    while (struct dirent* entry = readdir(dir)) {
+      names.push_back(entry->d_name);
+    }
+    closedir(dir);
+  }
+  std::sort(names.begin(), names.end());
+  std::ostringstream stamp;
+  for (const std::string& name : names) {
+    struct stat info;
+    if (stat((directory + "/" + name).c_str(), &info) == 0 &&
+        S_ISREG(info.st_mode)) {
+      stamp << name << " " << info.st_mtime << "\n";
+    }
+  }
+  return stamp.str();
+}
+
+/// \brief  Runs a shell command and returns its standard output.
+bool RunCommand(const std::string& command, std::string* output) {
+  FILE* pipe = popen(command.c_str(), "r");
+  if (pipe == nullptr) {
+    return false;
+  }
+  char buffer[4096];
+  std::size_t count;
+  output->clear();
+  while ((count = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+    output->append(buffer, count);
+  }
+  return pclose(pipe) == 0;
+}
+
+bool ReadFile(const std::string& path, std::string* data) {
+  std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  data->assign(std::istreambuf_iterator<char>(file),
+               std::istreambuf_iterator<char>());
+  return true;
+}
+
+bool WriteFile(const std::string& path, const std::string& data) {
+  const std::string temporary_path = path + ".tmp";
+  {
+    std::ofstream file(temporary_path.c_str(),
+                       std::ios::out | std::ios::binary | std::ios::trunc);
+    file << data;
+    file.close();
+    if (!file) {
+      std::remove(temporary_path.c_str());
+      return false;
+    }
+  }
+  return std::rename(temporary_path.c_str(), path.c_str()) == 0;
+}
+
+/// \brief  Expands the xacro of a vehicle with the placeholder namespace and
+///         converts it to SDF.
+bool GenerateSdf(const std::string& model, const std::string& mav_name,
+                 const std::string& xacro_args, std::string* sdf_xml) {
+  const std::string command =
+      "rosrun xacro xacro '" + model + "' " + xacro_args + " mav_name:=" +
+      mav_name + " namespace:=" + kNamespacePlaceholder +
+      " log_file:=" + kNamespacePlaceholder;
+  std::string urdf;
+  if (!RunCommand(command, &urdf)) {
+    ROS_ERROR_STREAM("[spawn_vehicles] Could not run \"" << command << "\".");
+    return false;
+  }
+
+  sdf::SDFPtr sdf(new sdf::SDF());
+  sdf::init(sdf);
+  if (!sdf::readString(urdf, sdf) || !sdf->Root()->HasElement("model")) {
+    ROS_ERROR_STREAM("[spawn_vehicles] Could not convert the URDF of \""
+                     << model << "\" to SDF.");
+    return false;
+  }
+  sdf->Root()->GetElement("model")->GetAttribute("name")->Set(
+      kNamespacePlaceholder);
+  *sdf_xml = sdf->Root()->ToString("");
+  return true;
+}
+
+/// \brief  Replaces all occurrences of the placeholder by the namespace.
+std::string Instantiate(const std::string& sdf_xml,
+                        const std::string& robot_namespace) {
+  std::string result;
+  result.reserve(sdf_xml.size() + 16 * robot_namespace.size());
+  std::size_t begin = 0, position;
+  while ((position = sdf_xml.find(kNamespacePlaceholder, begin)) !=
+         std::string::npos) {
+    result.append(sdf_xml, begin, position - begin);
+    result.append(robot_namespace);
+    begin = position + kNamespacePlaceholder.size();
+  }
+  result.append(sdf_xml, begin, std::string::npos);
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "spawn_vehicles");
+  ros::NodeHandle private_nh("~");
+
+  std::string model, mav_name, xacro_args, namespace_prefix, cache_dir;
+  std::vector<std::string> namespaces;
+  std::vector<double> xs, ys, zs;
+  int num_vehicles, columns;
+  double spacing, x0, y0, z0, connect_timeout;
+  if (!private_nh.getParam("model", model)) {
+    ROS_ERROR("[spawn_vehicles] Please specify the xacro file of the vehicle in ~model.");
+    return 1;
+  }
+  private_nh.param("mav_name", mav_name, kDefaultMavName);
+  private_nh.param("xacro_args", xacro_args, std::string());
+  private_nh.param("namespace_prefix", namespace_prefix, mav_name);
+  private_nh.param("num_vehicles", num_vehicles, kDefaultNumVehicles);
+  private_nh.param("columns", columns, kDefaultColumns);
+  private_nh.param("spacing", spacing, kDefaultSpacing);
+  private_nh.param("x", x0, 0.0);
+  private_nh.param("y", y0, 0.0);
+  private_nh.param("z", z0, kDefaultZ);
+  private_nh.param("connect_timeout", connect_timeout, kDefaultConnectTimeout);
+  const char* home = std::getenv("HOME");
+  private_nh.param("cache_dir", cache_dir,
+                   std::string(home ? home : ".") + "/.ros/" + kDefaultCacheDir);
+
+  // Either explicit namespaces and positions, or num_vehicles of them named
+  // <namespace_prefix>1.. on a grid, as in benchmark_vehicles.launch.
+  private_nh.getParam("namespaces", namespaces);
+  private_nh.getParam("xs", xs);
+  private_nh.getParam("ys", ys);
+  private_nh.getParam("zs", zs);
+  if (namespaces.empty()) {
+    if (num_vehicles < 1) {
+      ROS_ERROR("[spawn_vehicles] ~num_vehicles must be at least 1, got %d.",
+                num_vehicles);
+      return 1;
+    }
+    for (int i = 1; i <= num_vehicles; ++i) {
+      namespaces.push_back(namespace_prefix + std::to_string(i));
+    }
+  }
+  if (columns <= 0) {
+    columns = static_cast<int>(std::sqrt(namespaces.size() - 1.0)) + 1;
+  }
+
+  std::ostringstream key;
+  key << model << "\n" << mav_name << "\n" << xacro_args << "\n"
+      << DirectoryStamp(model.substr(0, model.find_last_of('/')));
+  std::ostringstream cache_name;
+  cache_name << std::hex << std::setw(16) << std::setfill('0')
+             << Hash(key.str());
+  const std::string cache_path = cache_dir + "/" + cache_name.str() + ".sdf";
+
+  const ros::WallTime start = ros::WallTime::now();
+  std::string sdf_xml;
+  if (ReadFile(cache_path, &sdf_xml)) {
+    ROS_INFO_STREAM("[spawn_vehicles] Using the cached description "
+                    << cache_path << ".");
+  } else {
+    if (!GenerateSdf(model, mav_name, xacro_args, &sdf_xml)) {
+      return 1;
+    }
+    if (system(("mkdir -p '" + cache_dir + "'").c_str()) != 0 ||
+        !WriteFile(cache_path, sdf_xml)) {
+      ROS_WARN_STREAM("[spawn_vehicles] Could not cache the description in "
+                      << cache_path << ".");
+    }
+    ROS_INFO_STREAM("[spawn_vehicles] Generated the description of \""
+                    << model << "\" in "
+                    << (ros::WallTime::now() - start).toSec() << " s.");
+  }
+
+  gazebo::client::setup(argc, argv);
+  gazebo::transport::NodePtr node(new gazebo::transport::Node());
+  node->Init();
+  gazebo::transport::PublisherPtr factory_pub =
+      node->Advertise<gazebo::msgs::Factory>("~/factory", namespaces.size());
+  if (!factory_pub->WaitForConnection(
+          gazebo::common::Time(connect_timeout))) {
+    ROS_ERROR("[spawn_vehicles] Gazebo does not listen to factory messages.");
+    gazebo::client::shutdown();
+    return 1;
+  }
+
+  for (std::size_t i = 0; i < namespaces.size(); ++i) {
+    const double x = i < xs.size() ? xs[i] : x0 + (i % columns) * spacing;
+    const double y = i < ys.size() ? ys[i] : y0 + (i / columns) * spacing;
+    const double z = i < zs.size() ? zs[i] : z0;
+    gazebo::msgs::Factory factory;
+    factory.set_sdf(Instantiate(sdf_xml, namespaces[i]));
+    gazebo::msgs::Set(factory.mutable_pose(),
+                      ignition::math::Pose3d(x, y, z, 0.0, 0.0, 0.0));
+    factory_pub->Publish(factory);
+  }
+  // Messages are sent asynchronously, wait until all of them left.
+  while (factory_pub->GetOutgoingCount() > 0) {
+    factory_pub->SendMessage();
+    gazebo::common::Time::MSleep(10);
+  }
+  ROS_INFO_STREAM("[spawn_vehicles] Sent " << namespaces.size()
+                  << " vehicles to Gazebo in "
+                  << (ros::WallTime::now() - start).toSec() << " s.");
+
+  gazebo::client::shutdown();
+  return 0;
+}
@@ -0,0 +1,283 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Headless end-to-end throughput benchmark, started by
+// throughput_benchmark.launch.
+//
+// Flies every vehicle along a square of waypoints around its spawn position,
+// and measures over a fixed window of simulated time:
+//  - the real-time factor,
+//  - percentiles of the wall time per physics step, from the wall time between
+//    consecutive /clock messages divided by the number of steps in between,
+//  - the CPU time of gzserver, in total and per vehicle.
+// The results are written as JSON to ~output_file and the node exits, which
+// shuts down the launch file.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <Eigen/Core>
+#include <gazebo_msgs/GetPhysicsProperties.h>
+#include <mav_msgs/conversions.h>
+#include <mav_msgs/default_topics.h>
+#include <ros/ros.h>
+#include <rosgraph_msgs/Clock.h>
+#include <trajectory_msgs/MultiDOFJointTrajectory.h>
+
+namespace {
+
+static constexpr int kDefaultNumVehicles = 10;
+static constexpr double kDefaultSpacing = 2.0;
+static constexpr double kDefaultWarmup = 10.0;
+static constexpr double kDefaultDuration = 60.0;
+static constexpr double kDefaultWaypointPeriod = 4.0;
+static constexpr double kDefaultSquareSize = 1.0;
+static constexpr double kDefaultAltitude = 1.0;
+static const std::string kDefaultMavName = "firefly";
+static const std::string kDefaultOutputFile = "rotors_throughput_benchmark.json";
+
+/// \brief  Returns the user and system CPU time of the first process named
+///         gzserver [s], or a negative value if there is none.
+double GzserverCpuSeconds() {
+  DIR* proc = opendir("/proc");
+  if (proc == nullptr) {
+    return -1.0;
+  }
+  double cpu_seconds = -1.0;
+  while (struct dirent* entry = readdir(proc)) {
+    const std::string pid = entry->d_name;
+    if (pid.find_first_not_of("0123456789") != std::string::npos) {
+      continue;
+    }
+    std::ifstream comm("/proc/" + pid + "/comm");
+    std::string name;
+    if (!(comm >> name) || name != "gzserver") {
+      continue;
+    }
+    // The command name in parentheses is the second field, utime and stime
+    // are the 14th and 15th.
+    std::ifstream stat_file("/proc/" + pid + "/stat");
+    std::string stat((std::istreambuf_iterator<char>(stat_file)),
+                     std::istreambuf_iterator<char>());
+    const std::size_t comm_end = stat.rfind(')');
+    if (comm_end == std::string::npos) {
+      continue;
+    }
+    unsigned long utime, stime;
+    if (std::sscanf(stat.c_str() + comm_end + 1,
+                    " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                    &utime, &stime) == 2) {
+      cpu_seconds = static_cast<double>(utime + stime) / sysconf(_SC_CLK_TCK);
+      break;
+    }
+  }
+  closedir(proc);
+  return cpu_seconds;
+}
+
+double Percentile(const std::vector<double>& sorted_values, double fraction) {
+  if (sorted_values.empty()) {
+    return 0.0;
+  }
+  const std::size_t index = std::min<std::size_t>(
+      sorted_values.size() - 1, fraction * sorted_values.size());
+  return sorted_values[index];
+}
+
+class ThroughputBenchmark {
+ public:
+  ThroughputBenchmark(ros::NodeHandle nh, ros::NodeHandle private_nh)
+      : nh_(nh), waypoint_index_(-1), measuring_(false), done_(false) {
+    private_nh.param("num_vehicles", num_vehicles_, kDefaultNumVehicles);
+    private_nh.param("mav_name", mav_name_, kDefaultMavName);
+    private_nh.param("spacing", spacing_, kDefaultSpacing);
+    private_nh.param("warmup", warmup_, kDefaultWarmup);
+    private_nh.param("duration", duration_, kDefaultDuration);
+    private_nh.param("waypoint_period", waypoint_period_, kDefaultWaypointPeriod);
+    private_nh.param("square_size", square_size_, kDefaultSquareSize);
+    private_nh.param("altitude", altitude_, kDefaultAltitude);
+    private_nh.param("output_file", output_file_, kDefaultOutputFile);
+
+    // Same grid as benchmark_vehicles.launch, ceil(sqrt(num_vehicles)) columns.
+    columns_ = static_cast<int>(std::sqrt(num_vehicles_ - 1.0)) + 1;
+    for (int i = 1; i <= num_vehicles_; ++i) {
+      trajectory_pubs_.push_back(nh_.advertise<trajectory_msgs::MultiDOFJointTrajectory>(
+          mav_name_ + std::to_string(i) + "/" +
+              mav_msgs::default_topics::COMMAND_TRAJECTORY, 10));
+    }
+  }
+
+  bool Start() {
+    gazebo_msgs::GetPhysicsProperties physics;
+    if (!ros::service::waitForService("/gazebo/get_physics_properties", ros::Duration(60.0)) ||
+        !ros::service::call("/gazebo/get_physics_properties", physics)) {
+      ROS_ERROR("[throughput_benchmark] Could not get the physics properties.");
+      return false;
+    }
+    time_step_ = physics.response.time_step;
+    clock_sub_ = nh_.subscribe("/clock", 100, &ThroughputBenchmark::ClockCallback, this);
+    ROS_INFO("[throughput_benchmark] %d x %s, %.0f s warmup, %.0f s measured.",
+             num_vehicles_, mav_name_.c_str(), warmup_, duration_);
+    return true;
+  }
+
+  bool done() const { return done_; }
+
+ private:
+  void ClockCallback(const rosgraph_msgs::ClockConstPtr& clock_msg) {
+    const double sim_time = clock_msg->clock.toSec();
+    const ros::WallTime wall_time = ros::WallTime::now();
+
+    const int waypoint_index = static_cast<int>(sim_time / waypoint_period_);
+    if (waypoint_index != waypoint_index_) {
+      waypoint_index_ = waypoint_index;
+      PublishWaypoints();
+    }
+
+    if (!measuring_) {
+      if (sim_time >= warmup_) {
+        measuring_ = true;
+        start_sim_time_ = last_sim_time_ = sim_time;
+        start_wall_time_ = last_wall_time_ = wall_time;
+        start_cpu_seconds_ = GzserverCpuSeconds();
+      }
+      return;
+    }
+
+    const int steps = std::lround((sim_time - last_sim_time_) / time_step_);
+    if (steps > 0) {
+      step_times_.push_back((wall_time - last_wall_time_).toSec() / steps);
+      last_sim_time_ = sim_time;
+      last_wall_time_ = wall_time;
+    }
+    if (sim_time - start_sim_time_ >= duration_ && !done_) {
+      WriteResults(sim_time - start_sim_time_, (wall_time - start_wall_time_).toSec());
+      done_ = true;
+    }
+  }
+
+  /// \brief  Sends every vehicle to the next corner of a square around its
+  ///         spawn position.
+  void PublishWaypoints() {
+    static const double kCorners[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+    const double* corner = kCorners[waypoint_index_ % 4];
+    for (int i = 0; i < num_vehicles_; ++i) {
+      const Eigen::Vector3d position(
+          (i % columns_) * spacing_ + corner[0] * square_size_,
+          (i / columns_) * spacing_ + corner[1] * square_size_, altitude_);
+      trajectory_msgs::MultiDOFJointTrajectory trajectory_msg;
+      trajectory_msg.header.stamp = ros::Time::now();
+      mav_msgs::msgMultiDofJointTrajectoryFromPositionYaw(position, 0.0, &trajectory_msg);
+      trajectory_pubs_[i].publish(trajectory_msg);
+    }
+  }
+
+  void WriteResults(double sim_seconds, double wall_seconds) {
+    const double end_cpu_seconds = GzserverCpuSeconds();
+    double cpu_fraction = -1.0;
+    if (start_cpu_seconds_ >= 0.0 && end_cpu_seconds >= 0.0 && wall_seconds > 0.0) {
+      cpu_fraction = (end_cpu_seconds - start_cpu_seconds_) / wall_seconds;
+    }
+    std::sort(step_times_.begin(), step_times_.end());
+    const double rtf = wall_seconds > 0.0 ? sim_seconds / wall_seconds : 0.0;
+
+    std::ofstream output(output_file_);
+    output << "{\n"
+           << "  \"mav_name\": \"" << mav_name_ << "\",\n"
+           << "  \"num_vehicles\": " << num_vehicles_ << ",\n"
+           << "  \"time_step_s\": " << time_step_ << ",\n"
+           << "  \"sim_time_s\": " << sim_seconds << ",\n"
+           << "  \"wall_time_s\": " << wall_seconds << ",\n"
+           << "  \"real_time_factor\": " << rtf << ",\n"
+           << "  \"step_time_ms\": {\n"
+           << "    \"samples\": " << step_times_.size() << ",\n"
+           << "    \"p50\": " << Percentile(step_times_, 0.5) * 1e3 << ",\n"
+           << "    \"p90\": " << Percentile(step_times_, 0.9) * 1e3 << ",\n"
+           << "    \"p99\": " << Percentile(step_times_, 0.99) * 1e3 << ",\n"
+           << "    \"max\": " << Percentile(step_times_, 1.0) * 1e3 << "\n"
+           << "  },\n"
+           << "  \"gzserver_cpu_percent\": " << cpu_fraction * 100.0 << ",\n"
+           << "  \"gzserver_cpu_percent_per_vehicle\": "
+           << cpu_fraction * 100.0 / num_vehicles_ << "\n"
+           << "}\n";
+    if (!output) {
+      ROS_ERROR("[throughput_benchmark] Could not write %s.", output_file_.c_str());
+      return;
+    }
+    ROS_INFO("[throughput_benchmark] RTF %.3f, step time p50 %.3f ms, p99 %.3f ms, "
+             "gzserver CPU %.1f %% (%.1f %% per vehicle). Results written to %s.",
+             rtf, Percentile(step_times_, 0.5) * 1e3, Percentile(step_times_, 0.99) * 1e3,
+             cpu_fraction * 100.0, cpu_fraction * 100.0 / num_vehicles_,
+             output_file_.c_str());
+  }
+
+  ros::NodeHandle nh_;
+  ros::Subscriber clock_sub_;
+  std::vector<ros::Publisher> trajectory_pubs_;
+
+  int num_vehicles_;
+  int columns_;
+  std::string mav_name_;
+  double spacing_;
+  double warmup_;
+  double duration_;
+  double waypoint_period_;
+  double square_size_;
+  double altitude_;
+  std::string output_file_;
+  double time_step_;
+
+  int waypoint_index_;
+  bool measuring_;
+  bool done_;
+  double start_sim_time_;
+  double last_sim_time_;
+  ros::WallTime start_wall_time_;
+  ros::WallTime last_wall_time_;
+  double start_cpu_seconds_;
+  std::vector<double> step_times_;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "throughput_benchmark");
+  ros::NodeHandle nh;
+  ros::NodeHandle private_nh("~");
+
+  ThroughputBenchmark benchmark(nh, private_nh);
+  if (!benchmark.Start()) {
+    return 1;
+  }
+  while (ros::ok() && !benchmark.done()) {
+    ros::spinOnce();
+    ros::WallDuration(0.001).sleep();
+  }
+  ros::shutdown();
+  return 0;
+}
@@ -18,8 +18,16 @@
  * limitations under the License.
  */
 
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <fstream>
 #include <iostream>
+#include <memory>
 
 #include <Eigen/Geometry>
 #include <mav_msgs/conversions.h>
@@ -33,6 +41,18 @@ bool sim_running = false;
 
 static const int64_t kNanoSecondsInSecond = 1000000000;
 
+// Number of waypoints per published trajectory message.
+static const int kDefaultChunkSize = 1000;
+// Time [s] to wait such that everything can settle and the mav flies to the
+// initial position.
+static const double kDefaultSettleTime = 30.0;
+
+// Binary mission files start with this magic, followed by records of five
+// doubles in the byte order of the host: wait_time [s] x [m] y [m] z [m]
+// yaw [deg], i.e. the columns of the text format.
+static const char kBinaryMagic[8] = {'R', 'O', 'T', 'O', 'R', 'S', 'W', 'P'};
+static const std::string kBinaryExtension = ".bin";
+
 void callback(const sensor_msgs::ImuPtr& msg) {
   sim_running = true;
 }
@@ -52,37 +72,169 @@ class WaypointWithTime {
   double waiting_time;
 };
 
+// Reads the waypoints of a mission one at a time, so that the mission never
+// has to be in memory as a whole.
+class WaypointReader {
+ public:
+  virtual ~WaypointReader() {}
+  virtual bool Next(WaypointWithTime* waypoint) = 0;
+};
+
+// Stream-parses the text format.
+class TextWaypointReader : public WaypointReader {
+ public:
+  explicit TextWaypointReader(const std::string& filename)
+      : file_(filename.c_str()) {}
+
+  bool is_open() const { return file_.is_open(); }
+
+  bool Next(WaypointWithTime* waypoint) {
+    const float DEG_2_RAD = M_PI / 180.0;
+    double t, x, y, z, yaw;
+    // Only read complete waypoints.
+    if (!(file_ >> t >> x >> y >> z >> yaw)) {
+      return false;
+    }
+    *waypoint = WaypointWithTime(t, x, y, z, yaw * DEG_2_RAD);
+    return true;
+  }
+
+ private:
+  std::ifstream file_;
+};
+
+// Reads the binary format from a read-only memory mapping of the file.
+class BinaryWaypointReader : public WaypointReader {
+ public:
+  explicit BinaryWaypointReader(const std::string& filename)
+      : data_(NULL), size_(0), offset_(sizeof(kBinaryMagic)) {
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 &&
+        file_stat.st_size >= static_cast<off_t>(sizeof(kBinaryMagic))) {
+      void* data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+        data_ = static_cast<const char*>(data);
+        size_ = file_stat.st_size;
+        // The file is read once from front to back.
+        madvise(data, size_, MADV_SEQUENTIAL);
+      }
+    }
+    close(fd);
+  }
+
+  ~BinaryWaypointReader() {
+    if (data_) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+  bool is_open() const {
+    return data_ && memcmp(data_, kBinaryMagic, sizeof(kBinaryMagic)) == 0;
+  }
+
+  bool Next(WaypointWithTime* waypoint) {
+    const float DEG_2_RAD = M_PI / 180.0;
+    double record[5];
+    // Only read complete waypoints.
+    if (!data_ || offset_ + sizeof(record) > size_) {
+      return false;
+    }
+    memcpy(record, data_ + offset_, sizeof(record));
+    offset_ += sizeof(record);
+    *waypoint = WaypointWithTime(record[0], record[1], record[2], record[3],
+                                 record[4] * DEG_2_RAD);
+    return true;
+  }
+
+ private:
+  const char* data_;
+  size_t size_;
+  size_t offset_;
+};
+
+bool HasBinaryExtension(const std::string& filename) {
+  return filename.size() >= kBinaryExtension.size() &&
+      filename.compare(filename.size() - kBinaryExtension.size(),
+                       kBinaryExtension.size(), kBinaryExtension) == 0;
+}
+
+// Converts a text mission file to the binary format.
+int ConvertToBinary(const std::string& text_filename,
+                    const std::string& binary_filename) {
+  TextWaypointReader reader(text_filename);
+  if (!reader.is_open()) {
+    ROS_ERROR_STREAM("Unable to open poses file: " << text_filename);
+    return -1;
+  }
+  std::ofstream binary_file(binary_filename.c_str(), std::ios::binary);
+  binary_file.write(kBinaryMagic, sizeof(kBinaryMagic));
+  const double RAD_2_DEG = 180.0 / M_PI;
+  WaypointWithTime wp;
+  int n_waypoints = 0;
+  while (reader.Next(&wp)) {
+    const double record[5] = {wp.waiting_time, wp.position.x(), wp.position.y(),
+                              wp.position.z(), wp.yaw * RAD_2_DEG};
+    binary_file.write(reinterpret_cast<const char*>(record), sizeof(record));
+    ++n_waypoints;
+  }
+  if (!binary_file) {
+    ROS_ERROR_STREAM("Unable to write binary mission file: " << binary_filename);
+    return -1;
+  }
+  ROS_INFO("Converted %d waypoints.", n_waypoints);
+  return 0;
+}
+
 int main(int argc, char** argv) {
   ros::init(argc, argv, "waypoint_publisher");
   ros::NodeHandle nh;
+  ros::NodeHandle private_nh("~");
 
   ROS_INFO("Started waypoint_publisher.");
 
   ros::V_string args;
   ros::removeROSArgs(argc, argv, args);
 
+  if (args.size() == 4 && args.at(1) == "--to-binary") {
+    return ConvertToBinary(args.at(2), args.at(3));
+  }
+
   if (args.size() != 2 && args.size() != 3) {
     ROS_ERROR("Usage: waypoint_publisher <waypoint_file>"
-        "\nThe waypoint file should be structured as: space separated: wait_time [s] x[m] y[m] z[m] yaw[deg])");
+        "\nThe waypoint file should be structured as: space separated: wait_time [s] x[m] y[m] z[m] yaw[deg])"
+        "\nFiles ending in .bin are read as binary mission files, which are created with"
+        "\n       waypoint_publisher --to-binary <waypoint_file> <binary_file>");
     return -1;
   }
 
-  std::vector<WaypointWithTime> waypoints;
-  const float DEG_2_RAD = M_PI / 180.0;
-
-  std::ifstream wp_file(args.at(1).c_str());
+  int chunk_size;
+  double settle_time;
+  private_nh.param("chunk_size", chunk_size, kDefaultChunkSize);
+  private_nh.param("settle_time", settle_time, kDefaultSettleTime);
+  if (chunk_size < 1) {
+    chunk_size = kDefaultChunkSize;
+  }
 
-  if (wp_file.is_open()) {
-    double t, x, y, z, yaw;
-    // Only read complete waypoints.
-    while (wp_file >> t >> x >> y >> z >> yaw) {
-      waypoints.push_back(WaypointWithTime(t, x, y, z, yaw * DEG_2_RAD));
+  const std::string& filename = args.at(1);
+  std::unique_ptr<WaypointReader> reader;
+  if (HasBinaryExtension(filename)) {
+    BinaryWaypointReader* binary_reader = new BinaryWaypointReader(filename);
+    reader.reset(binary_reader);
+    if (!binary_reader->is_open()) {
+      ROS_ERROR_STREAM("Unable to open binary mission file: " << filename);
+      return -1;
     }
-    wp_file.close();
-    ROS_INFO("Read %d waypoints.", (int) waypoints.size());
   } else {
-    ROS_ERROR_STREAM("Unable to open poses file: " << args.at(1));
-    return -1;
+    TextWaypointReader* text_reader = new TextWaypointReader(filename);
+    reader.reset(text_reader);
+    if (!text_reader->is_open()) {
+      ROS_ERROR_STREAM("Unable to open poses file: " << filename);
+      return -1;
+    }
   }
 
   // The IMU is used, to determine if the simulator is running or not.
@@ -101,29 +253,58 @@ int main(int argc, char** argv) {
 
   ROS_INFO("...ok");
 
-  // Wait for 30s such that everything can settle and the mav flies to the initial position.
-  ros::Duration(30).sleep();
+  // Wait such that everything can settle and the mav flies to the initial position.
+  ros::Duration(settle_time).sleep();
 
   ROS_INFO("Start publishing waypoints.");
 
-  trajectory_msgs::MultiDOFJointTrajectoryPtr msg(new trajectory_msgs::MultiDOFJointTrajectory);
-  msg->header.stamp = ros::Time::now();
-  msg->points.resize(waypoints.size());
-  msg->joint_names.push_back("base_link");
+  // All chunks are stamped with the start of the mission and their points
+  // carry the time from that start, so the controller keeps one time base.
+  // Every chunk after the first repeats the last point of the previous one
+  // and is sent when the simulation time reaches that point, which lets the
+  // controller interpolate across the chunk boundary.
+  const ros::Time mission_start = ros::Time::now();
   int64_t time_from_start_ns = 0;
-  for (size_t i = 0; i < waypoints.size(); ++i) {
-    WaypointWithTime& wp = waypoints[i];
+  mav_msgs::EigenTrajectoryPoint trajectory_point;
+  bool has_previous_point = false;
+  size_t n_waypoints = 0;
+  WaypointWithTime wp;
+  bool more_waypoints = reader->Next(&wp);
+
+  while (more_waypoints && ros::ok()) {
+    trajectory_msgs::MultiDOFJointTrajectoryPtr msg(new trajectory_msgs::MultiDOFJointTrajectory);
+    msg->header.stamp = mission_start;
+    msg->joint_names.push_back("base_link");
+    msg->points.reserve(chunk_size + 1);
+
+    ros::Time chunk_start = mission_start;
+    if (has_previous_point) {
+      msg->points.resize(1);
+      mav_msgs::msgMultiDofJointTrajectoryPointFromEigen(trajectory_point, &msg->points[0]);
+      chunk_start += ros::Duration().fromNSec(trajectory_point.time_from_start_ns);
+    }
 
-    mav_msgs::EigenTrajectoryPoint trajectory_point;
-    trajectory_point.position_W = wp.position;
-    trajectory_point.setFromYaw(wp.yaw);
-    trajectory_point.time_from_start_ns = time_from_start_ns;
+    for (int i = 0; i < chunk_size && more_waypoints; ++i) {
+      trajectory_point.position_W = wp.position;
+      trajectory_point.setFromYaw(wp.yaw);
+      trajectory_point.time_from_start_ns = time_from_start_ns;
 
-    time_from_start_ns += static_cast<int64_t>(wp.waiting_time * kNanoSecondsInSecond);
+      time_from_start_ns += static_cast<int64_t>(wp.waiting_time * kNanoSecondsInSecond);
 
-    mav_msgs::msgMultiDofJointTrajectoryPointFromEigen(trajectory_point, &msg->points[i]);
+      msg->points.resize(msg->points.size() + 1);
+      mav_msgs::msgMultiDofJointTrajectoryPointFromEigen(trajectory_point, &msg->points.back());
+      ++n_waypoints;
+      more_waypoints = reader->Next(&wp);
+    }
+    has_previous_point = true;
+
+    // Waiting for the simulation time keeps the schedule independent of the
+    // wall clock and of the real time factor.
+    ros::Time::sleepUntil(chunk_start);
+    wp_pub.publish(msg);
+    ros::spinOnce();
   }
-  wp_pub.publish(msg);
+  ROS_INFO("Published %d waypoints.", (int) n_waypoints);
 
   ros::spinOnce();
   ros::shutdown();
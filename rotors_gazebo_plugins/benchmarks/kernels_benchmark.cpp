@@ -0,0 +1,324 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Google Benchmark suite of the math kernels of the plugins.
+//
+// Usage: kernels_benchmark [--benchmark_filter=<regex>] [other benchmark flags]
+//
+// The pure kernels (wind field lookup, depth noise, first order filter,
+// magnetic declination) run on synthetic inputs of realistic size. The IMU
+// noise and the fixed-wing forces are plugin members, which are loaded on a
+// model spawned in an empty world, the same way motor_model_benchmark does.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+
+#include "rotors_gazebo_plugins/common.h"
+#include "rotors_gazebo_plugins/depth_noise_model.hpp"
+#include "rotors_gazebo_plugins/gazebo_fw_dynamics_plugin.h"
+#include "rotors_gazebo_plugins/gazebo_imu_plugin.h"
+#include "rotors_gazebo_plugins/geo_mag_declination.h"
+#include "rotors_gazebo_plugins/wind_field.h"
+
+namespace {
+
+// Wind field of 1 km x 1 km at 5 m resolution with 20 vertical levels.
+static constexpr int kWindFieldNumXY = 200;
+static constexpr int kWindFieldNumZ = 20;
+static constexpr float kWindFieldResolution = 5.0f;
+static const std::string kWindFieldPath = "/tmp/rotors_kernels_benchmark_wind_field.bin";
+
+// Number of lookups per benchmark iteration, so that the random positions
+// are drawn outside of the timed loop.
+static constexpr int kNumLookups = 1024;
+
+static constexpr double kSamplingTime = 0.001;
+
+struct Position {
+  double x;
+  double y;
+  double z;
+};
+
+gazebo::physics::ModelPtr g_model;
+
+// ============================================================================
+// Wind field
+// ============================================================================
+
+const gazebo::WindField& BenchmarkWindField() {
+  static gazebo::WindField* wind_field = nullptr;
+  if (wind_field != nullptr) {
+    return *wind_field;
+  }
+  gazebo::WindFieldData data;
+  data.n_x = kWindFieldNumXY;
+  data.n_y = kWindFieldNumXY;
+  data.res_x = kWindFieldResolution;
+  data.res_y = kWindFieldResolution;
+  for (int z = 0; z < kWindFieldNumZ; ++z) {
+    data.vertical_spacing_factors.push_back(static_cast<float>(z) / (kWindFieldNumZ - 1));
+  }
+  const int n_columns = kWindFieldNumXY * kWindFieldNumXY;
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> terrain(0.0f, 20.0f);
+  std::normal_distribution<float> wind(0.0f, 3.0f);
+  for (int i = 0; i < n_columns; ++i) {
+    data.bottom_z.push_back(terrain(generator));
+    data.top_z.push_back(200.0f);
+  }
+  for (int i = 0; i < n_columns * kWindFieldNumZ; ++i) {
+    data.u.push_back(wind(generator));
+    data.v.push_back(wind(generator));
+    data.w.push_back(0.1f * wind(generator));
+  }
+  wind_field = new gazebo::WindField;
+  if (!gazebo::WindField::WriteBinary(data, kWindFieldPath) ||
+      !wind_field->LoadBinary(kWindFieldPath)) {
+    std::fprintf(stderr, "Could not create the wind field %s.\n", kWindFieldPath.c_str());
+    std::abort();
+  }
+  wind_field->PageIn();
+  return *wind_field;
+}
+
+/// \brief  Lookups at positions spread over the whole field.
+void BM_WindFieldInterpolateRandom(benchmark::State& state) {
+  const gazebo::WindField& wind_field = BenchmarkWindField();
+  const double extent = (kWindFieldNumXY - 1) * kWindFieldResolution;
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<double> horizontal(0.0, extent);
+  std::uniform_real_distribution<double> vertical(25.0, 190.0);
+  std::vector<Position> positions;
+  for (int i = 0; i < kNumLookups; ++i) {
+    positions.push_back({horizontal(generator), horizontal(generator), vertical(generator)});
+  }
+  gazebo::WindVelocity velocity;
+  for (auto _ : state) {
+    for (const Position& position : positions) {
+      benchmark::DoNotOptimize(
+          wind_field.Interpolate(position.x, position.y, position.z, &velocity));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kNumLookups);
+}
+BENCHMARK(BM_WindFieldInterpolateRandom);
+
+/// \brief  Lookups along a flight path at 10 m/s sampled at 1 kHz, as the
+///         wind plugin of a vehicle does.
+void BM_WindFieldInterpolateTrajectory(benchmark::State& state) {
+  const gazebo::WindField& wind_field = BenchmarkWindField();
+  std::vector<Position> positions;
+  for (int i = 0; i < kNumLookups; ++i) {
+    positions.push_back({100.0 + 0.01 * i, 100.0 + 0.005 * i, 50.0});
+  }
+  gazebo::WindVelocity velocity;
+  for (auto _ : state) {
+    for (const Position& position : positions) {
+      benchmark::DoNotOptimize(
+          wind_field.Interpolate(position.x, position.y, position.z, &velocity));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kNumLookups);
+}
+BENCHMARK(BM_WindFieldInterpolateTrajectory);
+
+// ============================================================================
+// Depth noise
+// ============================================================================
+
+/// \brief  Noise of one depth frame, Arg(0) x Arg(1) pixels on Arg(2) threads.
+template <class NoiseModel>
+void BM_DepthApplyNoise(benchmark::State& state) {
+  const uint32_t width = state.range(0);
+  const uint32_t height = state.range(1);
+  NoiseModel noise_model;
+  noise_model.min_depth = 0.2f;
+  noise_model.max_depth = 10.0f;
+  noise_model.SetNumThreads(state.range(2));
+
+  std::mt19937 generator(2);
+  std::uniform_real_distribution<float> depth(0.1f, 12.0f);
+  std::vector<float> frame(width * height);
+  for (float& pixel : frame) {
+    pixel = depth(generator);
+  }
+  std::vector<float> noisy_frame(frame.size());
+  for (auto _ : state) {
+    noise_model.ApplyNoise(width, height, frame.data(), noisy_frame.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * frame.size());
+}
+BENCHMARK_TEMPLATE(BM_DepthApplyNoise, KinectDepthNoiseModel)
+    ->Args({640, 480, 1})->Args({640, 480, 0})->UseRealTime();
+BENCHMARK_TEMPLATE(BM_DepthApplyNoise, D435DepthNoiseModel)
+    ->Args({640, 480, 1})->Args({1280, 720, 1})->Args({1280, 720, 0})->UseRealTime();
+
+// ============================================================================
+// First order filter
+// ============================================================================
+
+/// \brief  Motor velocity filter of a hexacopter for one tick.
+void BM_FirstOrderFilter(benchmark::State& state) {
+  static constexpr int kNumRotors = 6;
+  std::vector<gazebo::FirstOrderFilter<double> > filters(
+      kNumRotors, gazebo::FirstOrderFilter<double>(0.0125, 0.025, 0.0));
+  double reference = 0.0;
+  for (auto _ : state) {
+    reference = reference < 800.0 ? reference + 1.0 : 0.0;
+    for (gazebo::FirstOrderFilter<double>& filter : filters) {
+      benchmark::DoNotOptimize(filter.updateFilter(reference, kSamplingTime));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kNumRotors);
+}
+BENCHMARK(BM_FirstOrderFilter);
+
+// ============================================================================
+// Magnetic declination
+// ============================================================================
+
+void BM_GetMagDeclination(benchmark::State& state) {
+  std::mt19937 generator(3);
+  std::uniform_real_distribution<float> latitude(-M_PI / 3, M_PI / 3);
+  std::uniform_real_distribution<float> longitude(-M_PI, M_PI);
+  std::vector<std::pair<float, float> > coordinates;
+  for (int i = 0; i < kNumLookups; ++i) {
+    coordinates.emplace_back(latitude(generator), longitude(generator));
+  }
+  for (auto _ : state) {
+    for (const std::pair<float, float>& coordinate : coordinates) {
+      benchmark::DoNotOptimize(get_mag_declination(coordinate.first, coordinate.second));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kNumLookups);
+}
+BENCHMARK(BM_GetMagDeclination);
+
+// ============================================================================
+// Plugin kernels, on the model spawned in main()
+// ============================================================================
+
+void AddParam(const sdf::ElementPtr& plugin, const std::string& name,
+              const std::string& type, const std::string& value) {
+  sdf::ElementPtr param(new sdf::Element);
+  param->SetName(name);
+  param->AddValue(type, value, true);
+  plugin->InsertElement(param);
+}
+
+sdf::ElementPtr PluginSdf() {
+  sdf::ElementPtr plugin(new sdf::Element);
+  plugin->SetName("plugin");
+  AddParam(plugin, "robotNamespace", "string", "benchmark");
+  AddParam(plugin, "linkName", "string", "base_link");
+  return plugin;
+}
+
+/// \brief  Exposes the protected interface of the IMU plugin.
+class BenchmarkImuPlugin : public gazebo::GazeboImuPlugin {
+ public:
+  void Setup() { Load(g_model, PluginSdf()); }
+  void Step(Eigen::Vector3d* linear_acceleration, Eigen::Vector3d* angular_velocity) {
+    AddNoise(linear_acceleration, angular_velocity, kSamplingTime);
+  }
+};
+
+void BM_ImuAddNoise(benchmark::State& state) {
+  BenchmarkImuPlugin imu;
+  imu.Setup();
+  Eigen::Vector3d linear_acceleration(0.0, 0.0, 9.81);
+  Eigen::Vector3d angular_velocity(0.0, 0.0, 0.0);
+  for (auto _ : state) {
+    imu.Step(&linear_acceleration, &angular_velocity);
+    benchmark::DoNotOptimize(linear_acceleration);
+    benchmark::DoNotOptimize(angular_velocity);
+  }
+}
+BENCHMARK(BM_ImuAddNoise);
+
+/// \brief  Exposes the protected interface of the fixed-wing plugin.
+class BenchmarkFwDynamicsPlugin : public gazebo::GazeboFwDynamicsPlugin {
+ public:
+  void Setup(bool use_coefficient_table) {
+    sdf::ElementPtr sdf = PluginSdf();
+    AddParam(sdf, "useCoefficientTable", "bool", use_coefficient_table ? "true" : "false");
+    Load(g_model, sdf);
+  }
+  void Step() { UpdateForcesAndMoments(); }
+};
+
+/// \brief  Forces and moments of one tick in cruise flight, with the analytic
+///         coefficients for Arg(0) == 0 and the coefficient table otherwise.
+void BM_FwUpdateForcesAndMoments(benchmark::State& state) {
+  BenchmarkFwDynamicsPlugin fw_dynamics;
+  fw_dynamics.Setup(state.range(0) != 0);
+  // Keep the airspeed above kMinAirSpeedThresh, physics is not stepped.
+  g_model->GetLink("base_link")->SetLinearVel(ignition::math::Vector3d(15.0, 0.5, -0.3));
+  for (auto _ : state) {
+    fw_dynamics.Step();
+  }
+}
+BENCHMARK(BM_FwUpdateForcesAndMoments)->Arg(0)->Arg(1);
+
+std::string BenchmarkModelSdf() {
+  return "<sdf version='1.5'><model name='benchmark'>"
+         "<pose>0 0 50 0 0 0</pose>"
+         "<link name='base_link'><inertial><mass>2.65</mass></inertial></link>"
+         "<static>false</static></model></sdf>";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+
+  gazebo::setupServer(argc, argv);
+  gazebo::physics::WorldPtr world = gazebo::loadWorld("worlds/empty.world");
+  world->InsertModelString(BenchmarkModelSdf());
+  // The model is only added to the world during an update.
+  gazebo::runWorld(world, 1);
+  g_model = world->ModelByName("benchmark");
+  if (!g_model) {
+    std::fprintf(stderr, "Could not spawn the benchmark model.\n");
+    gazebo::shutdown();
+    return 1;
+  }
+
+  benchmark::RunSpecifiedBenchmarks();
+
+  g_model.reset();
+  gazebo::shutdown();
+  std::remove(kWindFieldPath.c_str());
+  return 0;
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the per-tick cost of the motor models of a hexacopter.
+//
+// Usage: motor_model_benchmark [n_ticks]
+//
+// The rotor moments are computed once the way GazeboMotorModel did before the
+// parent link was cached (GetParentJointsLinks() and two WorldCoGPose() calls
+// per rotor and tick) and once with the cached parent link and drag torque
+// axis. The full UpdateForcesAndMoments() of all rotors is timed as well.
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+
+#include "rotors_gazebo_plugins/gazebo_motor_model.h"
+
+namespace {
+
+static constexpr int kNumRotors = 6;
+static constexpr int kDefaultNumTicks = 100000;
+static constexpr double kArmLength = 0.215;
+static constexpr double kSamplingTime = 0.001;
+
+/// \brief  Exposes the protected interface of the motor model.
+class BenchmarkMotorModel : public gazebo::GazeboMotorModel {
+ public:
+  void Setup(gazebo::physics::ModelPtr model, sdf::ElementPtr sdf) {
+    Load(model, sdf);
+    sampling_time_ = kSamplingTime;
+  }
+  void Step() { UpdateForcesAndMoments(); }
+};
+
+std::string HexacopterSdf() {
+  std::ostringstream sdf;
+  sdf << "<sdf version='1.5'><model name='hexacopter'>"
+      << "<pose>0 0 1 0 0 0</pose>"
+      << "<link name='base_link'><inertial><mass>1.5</mass></inertial></link>";
+  for (int i = 0; i < kNumRotors; ++i) {
+    const double angle = 2.0 * M_PI * i / kNumRotors;
+    sdf << "<link name='rotor_" << i << "'>"
+        << "<pose>" << kArmLength * std::cos(angle) << " "
+        << kArmLength * std::sin(angle) << " 0.037 0 0 0</pose>"
+        << "<inertial><mass>0.005</mass></inertial></link>"
+        << "<joint name='rotor_" << i << "_joint' type='revolute'>"
+        << "<parent>base_link</parent><child>rotor_" << i << "</child>"
+        << "<axis><xyz>0 0 1</xyz><limit><lower>-1e16</lower>"
+        << "<upper>1e16</upper></limit></axis></joint>";
+  }
+  sdf << "<static>false</static></model></sdf>";
+  return sdf.str();
+}
+
+void AddParam(const sdf::ElementPtr& plugin, const std::string& name,
+              const std::string& type, const std::string& value) {
+  sdf::ElementPtr param(new sdf::Element);
+  param->SetName(name);
+  param->AddValue(type, value, true);
+  plugin->InsertElement(param);
+}
+
+sdf::ElementPtr MotorModelSdf(int i) {
+  sdf::ElementPtr plugin(new sdf::Element);
+  plugin->SetName("plugin");
+  AddParam(plugin, "robotNamespace", "string", "hexacopter");
+  AddParam(plugin, "jointName", "string", "rotor_" + std::to_string(i) + "_joint");
+  AddParam(plugin, "linkName", "string", "rotor_" + std::to_string(i));
+  AddParam(plugin, "motorNumber", "int", std::to_string(i));
+  AddParam(plugin, "turningDirection", "string", i % 2 == 0 ? "ccw" : "cw");
+  AddParam(plugin, "motorType", "string", "velocity");
+  return plugin;
+}
+
+/// \brief  Rotor moments of one tick the way they were computed before.
+void LegacyRotorMoments(const std::vector<gazebo::physics::LinkPtr>& rotors,
+                        double drag_torque) {
+  for (const gazebo::physics::LinkPtr& rotor : rotors) {
+    gazebo::physics::Link_V parent_links = rotor->GetParentJointsLinks();
+    ignition::math::Pose3d pose_difference =
+        rotor->WorldCoGPose() - parent_links.at(0)->WorldCoGPose();
+    ignition::math::Vector3d drag_torque_parent_frame =
+        pose_difference.Rot().RotateVector(ignition::math::Vector3d(0, 0, drag_torque));
+    parent_links.at(0)->AddRelativeTorque(drag_torque_parent_frame);
+  }
+}
+
+/// \brief  Rotor moments of one tick with the parent link and axis cached.
+void CachedRotorMoments(const gazebo::physics::LinkPtr& parent,
+                        const std::vector<ignition::math::Vector3d>& axes,
+                        double drag_torque) {
+  for (const ignition::math::Vector3d& axis : axes) {
+    parent->AddRelativeTorque(axis * drag_torque);
+  }
+}
+
+template <class Function>
+double NanosecondsPerTick(int n_ticks, Function function) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < n_ticks; ++i) {
+    function();
+  }
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / n_ticks;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int n_ticks = argc > 1 ? std::atoi(argv[1]) : kDefaultNumTicks;
+  if (n_ticks <= 0) {
+    std::cerr << "Usage: " << argv[0] << " [n_ticks]" << std::endl;
+    return 1;
+  }
+
+  gazebo::setupServer(argc, argv);
+  gazebo::physics::WorldPtr world = gazebo::loadWorld("worlds/empty.world");
+  world->InsertModelString(HexacopterSdf());
+  // The model is only added to the world during an update.
+  gazebo::runWorld(world, 1);
+  gazebo::physics::ModelPtr model = world->ModelByName("hexacopter");
+  if (!model) {
+    std::cerr << "Could not spawn the hexacopter model." << std::endl;
+    gazebo::shutdown();
+    return 1;
+  }
+
+  std::vector<gazebo::physics::LinkPtr> rotors;
+  std::vector<ignition::math::Vector3d> axes;
+  std::vector<std::unique_ptr<BenchmarkMotorModel> > motor_models;
+  for (int i = 0; i < kNumRotors; ++i) {
+    gazebo::physics::LinkPtr rotor = model->GetLink("rotor_" + std::to_string(i));
+    rotors.push_back(rotor);
+    axes.push_back((rotor->WorldCoGPose() - model->GetLink("base_link")->WorldCoGPose())
+                       .Rot().RotateVector(ignition::math::Vector3d(0, 0, 1)));
+    motor_models.emplace_back(new BenchmarkMotorModel);
+    motor_models.back()->Setup(model, MotorModelSdf(i));
+  }
+  const gazebo::physics::LinkPtr parent = model->GetLink("base_link");
+  const double drag_torque = 0.01;
+
+  const double legacy = NanosecondsPerTick(n_ticks, [&] {
+    LegacyRotorMoments(rotors, drag_torque);
+  });
+  const double cached = NanosecondsPerTick(n_ticks, [&] {
+    CachedRotorMoments(parent, axes, drag_torque);
+  });
+  const double update = NanosecondsPerTick(n_ticks, [&] {
+    for (const std::unique_ptr<BenchmarkMotorModel>& motor_model : motor_models) {
+      motor_model->Step();
+    }
+  });
+
+  std::cout << "Hexacopter, " << kNumRotors << " rotors, " << n_ticks << " ticks\n"
+            << "  rotor moments, parent lookup per tick: " << legacy << " ns/tick\n"
+            << "  rotor moments, cached fixed mount:     " << cached << " ns/tick\n"
+            << "  UpdateForcesAndMoments, all rotors:    " << update << " ns/tick"
+            << std::endl;
+
+  gazebo::shutdown();
+  return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2014-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef _GAZEBO_MULTI_LIFT_DRAG_PLUGIN_HH_
+#define _GAZEBO_MULTI_LIFT_DRAG_PLUGIN_HH_
+
+#include <string>
+#include <vector>
+
+#include "gazebo/common/Plugin.hh"
+#include "gazebo/physics/physics.hh"
+
+namespace gazebo
+{
+  /// \brief A plugin that simulates lift and drag of all lifting surfaces of
+  /// a model, with the aerodynamic model of LiftDragPlugin.
+  ///
+  /// Each <surface> element takes the parameters of a LiftDragPlugin
+  /// (link_name, a0, cla, cda, alpha_stall, cla_stall, cda_stall, cp,
+  /// forward, upward, area, radial_symmetry, control_joint_name,
+  /// control_joint_rad_to_cl), <air_density> applies to all of them.
+  ///
+  /// Surfaces are grouped by link. Per update every link is queried once,
+  /// all geometry is evaluated in the constant link frame and the forces
+  /// of all surfaces of a link are applied as a single force and torque.
+  class GAZEBO_VISIBLE MultiLiftDragPlugin : public ModelPlugin
+  {
+    /// \brief Constructor.
+    public: MultiLiftDragPlugin();
+
+    /// \brief Destructor.
+    public: ~MultiLiftDragPlugin();
+
+    // Documentation Inherited.
+    public: virtual void Load(physics::ModelPtr _model, sdf::ElementPtr _sdf);
+
+    /// \brief Callback for World Update events.
+    protected: virtual void OnUpdate();
+
+    /// \brief A lifting surface, everything is in link coordinates.
+    protected: struct Surface
+    {
+      /// \brief Coefficient of Lift / alpha slope.
+      double cla;
+
+      /// \brief Coefficient of Drag / alpha slope.
+      double cda;
+
+      /// \brief angle of attack when airfoil stalls
+      double alphaStall;
+
+      /// \brief Cl-alpha rate after stall
+      double claStall;
+
+      /// \brief Cd-alpha rate after stall
+      double cdaStall;
+
+      /// \brief initial angle of attack
+      double alpha0;
+
+      /// \brief effective planeform surface area
+      double area;
+
+      /// \brief see LiftDragPlugin::radialSymmetry
+      bool radialSymmetry;
+
+      /// \brief center of pressure
+      ignition::math::Vector3d cp;
+
+      /// \brief Center of pressure relative to the center of gravity.
+      ignition::math::Vector3d cpArm;
+
+      /// \brief Unit chord direction at zero angle of attack.
+      ignition::math::Vector3d forward;
+
+      /// \brief Unit upward direction.
+      ignition::math::Vector3d upward;
+
+      /// \brief Unit normal of the lift-drag plane, forward x upward.
+      ignition::math::Vector3d spanwise;
+
+      /// \brief Optional joint that actuates a control surface.
+      physics::JointPtr controlJoint;
+
+      /// \brief how much to change CL per radian of control surface joint
+      /// value.
+      double controlJointRadToCL;
+    };
+
+    /// \brief All surfaces attached to one link.
+    protected: struct LinkSurfaces
+    {
+      physics::LinkPtr link;
+
+      /// \brief Center of gravity in link coordinates.
+      ignition::math::Vector3d cog;
+
+      std::vector<Surface> surfaces;
+    };
+
+    /// \brief Reads a <surface> element, returns false if it is invalid.
+    protected: bool LoadSurface(sdf::ElementPtr _sdf, Surface &_surface,
+                                std::string &_linkName);
+
+    /// \brief Computes the force of a surface in link coordinates.
+    /// \param[in] _vel Velocity of the center of pressure in link
+    /// coordinates.
+    /// \return false if the surface has no relevant inflow.
+    protected: bool SurfaceForce(const Surface &_surface,
+                                 const ignition::math::Vector3d &_vel,
+                                 ignition::math::Vector3d &_force) const;
+
+    /// \brief Connection to World Update events.
+    protected: event::ConnectionPtr updateConnection;
+
+    /// \brief Pointer to model containing plugin.
+    protected: physics::ModelPtr model;
+
+    /// \brief air density
+    protected: double rho;
+
+    /// \brief The surfaces, grouped by link.
+    protected: std::vector<LinkSurfaces> links;
+  };
+}
+#endif
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_BLACK_BOX_RECORDER_H
+#define ROTORS_GAZEBO_PLUGINS_BLACK_BOX_RECORDER_H
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ros/message_traits.h>
+#include <ros/serialization.h>
+#include <ros/time.h>
+#include <rosbag/bag.h>
+
+namespace gazebo {
+
+/// \brief  Type of the messages of one topic in the black box.
+struct BlackBoxTopic {
+  std::string name;
+  std::string datatype;
+  std::string md5sum;
+  std::string definition;
+};
+
+/// \brief    A message already serialized by the black box, written to a bag
+///           as is.
+/// \details  Like topic_tools::ShapeShifter, it carries its type with it, so
+///           a single type can write the messages of every topic.
+struct BlackBoxMessage {
+  const BlackBoxTopic* topic;
+  const uint8_t* data;
+  uint32_t size;
+};
+
+/// \brief    Keeps the last seconds of a set of topics as serialized messages
+///           in a fixed-size ring, and writes them to a bag when flushed.
+/// \details  The byte ring and the index of the messages are allocated once,
+///           adding a message serializes it into the ring in place and drops
+///           the oldest ones to make room, or once they are older than the
+///           duration. A flush copies the ring and writes the copy on a
+///           background thread, so the caller never waits for the disk.
+class BlackBoxRecorder {
+ public:
+  /// \param[in] capacity Size of the ring [bytes].
+  /// \param[in] duration Age after which messages are dropped [s].
+  BlackBoxRecorder(std::size_t capacity, double duration);
+  ~BlackBoxRecorder();
+
+  template <class M>
+  void Add(const std::string& topic, const ros::Time& time, const M& msg) {
+    const uint32_t size = ros::serialization::serializationLength(msg);
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<std::string, int>::const_iterator it = topic_ids_.find(topic);
+    int topic_id;
+    if (it != topic_ids_.end()) {
+      topic_id = it->second;
+    } else {
+      BlackBoxTopic type;
+      type.name = topic;
+      type.datatype = ros::message_traits::datatype(msg);
+      type.md5sum = ros::message_traits::md5sum(msg);
+      type.definition = ros::message_traits::definition(msg);
+      topic_id = static_cast<int>(topics_.size());
+      topics_.push_back(type);
+      topic_ids_[topic] = topic_id;
+    }
+    uint8_t* data = Reserve(topic_id, time, size);
+    if (data == nullptr) {
+      return;
+    }
+    ros::serialization::OStream stream(data, size);
+    ros::serialization::serialize(stream, msg);
+  }
+
+  template <class M>
+  void Add(const std::string& topic, const ros::Time& time,
+           const boost::shared_ptr<M const>& msg) {
+    Add(topic, time, *msg);
+  }
+
+  /// \brief  Starts writing the messages in the ring to a new bag. Returns
+  ///         false if the previous flush is still being written.
+  bool Flush(const std::string& filename,
+             rosbag::compression::CompressionType compression);
+
+  /// \brief  Whether a flush is being written.
+  bool Flushing() const;
+
+  /// \brief  Messages that did not fit into the ring at all.
+  uint64_t num_oversized() const { return num_oversized_; }
+
+ private:
+  struct Record {
+    ros::Time time;
+    int topic_id;
+    std::size_t offset;
+    uint32_t size;
+  };
+
+  /// \brief  Makes room for a message of size bytes, returns where to
+  ///         serialize it or nullptr if it is larger than the ring.
+  uint8_t* Reserve(int topic_id, const ros::Time& time, uint32_t size);
+
+  void PopOldest();
+
+  /// \brief  Writes the messages of a flush, on the flush thread.
+  void WriteBag(const std::string& filename,
+                rosbag::compression::CompressionType compression,
+                const std::vector<BlackBoxTopic>& topics,
+                const std::vector<Record>& records,
+                const std::vector<uint8_t>& data);
+
+  ros::Duration duration_;
+
+  mutable std::mutex mutex_;
+  std::vector<uint8_t> buffer_;
+  /// \brief  Index of the messages in the ring, oldest at first_record_.
+  std::vector<Record> records_;
+  std::size_t first_record_;
+  std::size_t num_records_;
+  /// \brief  Where the next message goes in buffer_.
+  std::size_t write_offset_;
+  std::vector<BlackBoxTopic> topics_;
+  std::map<std::string, int> topic_ids_;
+  uint64_t num_oversized_;
+
+  std::thread flush_thread_;
+  bool flushing_;
+};
+
+}  // namespace gazebo
+
+namespace ros {
+namespace message_traits {
+
+template <>
+struct MD5Sum<gazebo::BlackBoxMessage> {
+  static const char* value(const gazebo::BlackBoxMessage& m) {
+    return m.topic->md5sum.c_str();
+  }
+  static const char* value() { return "*"; }
+};
+
+template <>
+struct DataType<gazebo::BlackBoxMessage> {
+  static const char* value(const gazebo::BlackBoxMessage& m) {
+    return m.topic->datatype.c_str();
+  }
+  static const char* value() { return "*"; }
+};
+
+template <>
+struct Definition<gazebo::BlackBoxMessage> {
+  static const char* value(const gazebo::BlackBoxMessage& m) {
+    return m.topic->definition.c_str();
+  }
+};
+
+}  // namespace message_traits
+
+namespace serialization {
+
+template <>
+struct Serializer<gazebo::BlackBoxMessage> {
+  template <typename Stream>
+  inline static void write(Stream& stream, const gazebo::BlackBoxMessage& m) {
+    std::memcpy(stream.advance(m.size), m.data, m.size);
+  }
+
+  inline static uint32_t serializedLength(const gazebo::BlackBoxMessage& m) {
+    return m.size;
+  }
+};
+
+}  // namespace serialization
+}  // namespace ros
+
+#endif  // ROTORS_GAZEBO_PLUGINS_BLACK_BOX_RECORDER_H
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_CHECKPOINT_STREAM_H
+#define ROTORS_GAZEBO_PLUGINS_CHECKPOINT_STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+namespace gazebo {
+
+/// \brief    Appends the state of a plugin to a checkpoint.
+/// \details  Values are written as raw bytes in the native byte order, a
+///           checkpoint is only meant to be restored on the machine and with
+///           the build that wrote it. The reader has to read the values back
+///           in the same order.
+class CheckpointWriter {
+ public:
+  /// \brief  Writes a trivially copyable value.
+  template <class T>
+  void Write(const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Checkpoint values must be trivially copyable.");
+    data_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  /// \brief  Writes count consecutive values, e.g. the coefficients of a
+  ///         fixed-size Eigen matrix.
+  template <class T>
+  void WriteArray(const T* values, std::size_t count) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Checkpoint values must be trivially copyable.");
+    data_.append(reinterpret_cast<const char*>(values), count * sizeof(T));
+  }
+
+  void WriteString(const std::string& value) {
+    Write<uint64_t>(value.size());
+    data_.append(value);
+  }
+
+  /// \brief  Writes a value through its stream operator, which is how the
+  ///         standard random number engines and distributions expose their
+  ///         state.
+  template <class T>
+  void WriteText(const T& value) {
+    std::ostringstream stream;
+    stream << value;
+    WriteString(stream.str());
+  }
+
+  const std::string& data() const { return data_; }
+
+  void Clear() { data_.clear(); }
+
+ private:
+  std::string data_;
+};
+
+/// \brief    Reads the state of a plugin back from a checkpoint.
+/// \details  All reads fail once a read ran past the end of the data, so that
+///           a plugin can read all of its state and check ok() once.
+class CheckpointReader {
+ public:
+  CheckpointReader(const char* data, std::size_t size)
+      : data_(data), size_(size), offset_(0), ok_(true) {}
+
+  explicit CheckpointReader(const std::string& data)
+      : CheckpointReader(data.data(), data.size()) {}
+
+  template <class T>
+  bool Read(T* value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Checkpoint values must be trivially copyable.");
+    return ReadBytes(value, sizeof(T));
+  }
+
+  template <class T>
+  bool ReadArray(T* values, std::size_t count) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Checkpoint values must be trivially copyable.");
+    return ReadBytes(values, count * sizeof(T));
+  }
+
+  bool ReadString(std::string* value) {
+    uint64_t size = 0;
+    if (!Read(&size) || size > size_ - offset_) {
+      ok_ = false;
+      return false;
+    }
+    value->assign(data_ + offset_, size);
+    offset_ += size;
+    return true;
+  }
+
+  template <class T>
+  bool ReadText(T* value) {
+    std::string text;
+    if (!ReadString(&text)) {
+      return false;
+    }
+    std::istringstream stream(text);
+    stream >> *value;
+    ok_ = ok_ && !stream.fail();
+    return ok_;
+  }
+
+  bool ok() const { return ok_; }
+
+  /// \brief  True if all data was read.
+  bool AtEnd() const { return offset_ == size_; }
+
+ private:
+  bool ReadBytes(void* destination, std::size_t size) {
+    if (!ok_ || size > size_ - offset_) {
+      ok_ = false;
+      return false;
+    }
+    std::memcpy(destination, data_ + offset_, size);
+    offset_ += size;
+    return true;
+  }
+
+  const char* data_;
+  std::size_t size_;
+  std::size_t offset_;
+  bool ok_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_CHECKPOINT_STREAM_H
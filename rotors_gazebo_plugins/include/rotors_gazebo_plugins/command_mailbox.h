@@ -0,0 +1,161 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ROTORS_GAZEBO_PLUGINS_COMMAND_MAILBOX_H
+#define ROTORS_GAZEBO_PLUGINS_COMMAND_MAILBOX_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace gazebo {
+
+/// \brief    Snapshot of the newest command of a CommandMailbox.
+template <std::size_t Capacity>
+struct MailboxCommand {
+  MailboxCommand() : sequence(0), stamp(0.0), size(0) {}
+
+  /// \brief  Number of the command, counting from 1. 0 if none was posted.
+  uint64_t sequence;
+  /// \brief  Time the command was posted at, in the clock of the producer [s].
+  double stamp;
+  std::size_t size;
+  double values[Capacity];
+};
+
+/// \brief    Fixed size, lock-free mailbox holding the newest command of one
+///           producer thread for one consumer thread.
+/// \details  Post() must only be called from the producer thread, e.g. a
+///           transport callback, and Fetch() only from the consumer, usually
+///           the physics thread. Older commands are overwritten, only the
+///           newest one is kept.
+///
+///           The command is double buffered: Post() writes the slot that does
+///           not hold the newest command, guarded by a version that is odd
+///           while the slot is written. Fetch() copies the newest slot and
+///           retries if its version changed meanwhile, which only happens if
+///           two commands are posted during one copy. Neither of them blocks
+///           or allocates, and a fetched command is never torn.
+template <std::size_t Capacity>
+class CommandMailbox {
+  static_assert(Capacity > 0, "CommandMailbox must hold at least one value.");
+
+ public:
+  CommandMailbox() : sequence_(0) {
+    for (Slot& slot : slots_) {
+      slot.version.store(0, std::memory_order_relaxed);
+      slot.sequence.store(0, std::memory_order_relaxed);
+      slot.stamp.store(0.0, std::memory_order_relaxed);
+      slot.size.store(0, std::memory_order_relaxed);
+      for (std::atomic<double>& value : slot.values) {
+        value.store(0.0, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /// \brief  Replaces the command, called by the producer. Values beyond the
+  ///         capacity are dropped.
+  /// \return The sequence number of the command.
+  uint64_t Post(const double* values, std::size_t size, double stamp) {
+    const uint64_t sequence = sequence_.load(std::memory_order_relaxed) + 1;
+    Slot& slot = slots_[sequence & 1];
+    const uint64_t version = slot.version.load(std::memory_order_relaxed);
+    slot.version.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    size = std::min(size, Capacity);
+    slot.sequence.store(sequence, std::memory_order_relaxed);
+    slot.stamp.store(stamp, std::memory_order_relaxed);
+    slot.size.store(size, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < size; ++i) {
+      slot.values[i].store(values[i], std::memory_order_relaxed);
+    }
+
+    slot.version.store(version + 2, std::memory_order_release);
+    sequence_.store(sequence, std::memory_order_release);
+    return sequence;
+  }
+
+  /// \brief  Copies the newest command if it is newer than last_sequence,
+  ///         called by the consumer.
+  /// \return False if no newer command was posted.
+  bool Fetch(uint64_t last_sequence, MailboxCommand<Capacity>* command) const {
+    while (true) {
+      const uint64_t sequence = sequence_.load(std::memory_order_acquire);
+      if (sequence <= last_sequence) {
+        return false;
+      }
+      const Slot& slot = slots_[sequence & 1];
+      const uint64_t version = slot.version.load(std::memory_order_acquire);
+      if (version & 1) {
+        // Overwritten by the command after the next, start over.
+        continue;
+      }
+
+      command->sequence = slot.sequence.load(std::memory_order_relaxed);
+      command->stamp = slot.stamp.load(std::memory_order_relaxed);
+      command->size = std::min<std::size_t>(
+          slot.size.load(std::memory_order_relaxed), Capacity);
+      for (std::size_t i = 0; i < command->size; ++i) {
+        command->values[i] = slot.values[i].load(std::memory_order_relaxed);
+      }
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.version.load(std::memory_order_relaxed) == version) {
+        return true;
+      }
+    }
+  }
+
+  /// \brief  Sequence number of the newest command, 0 if none was posted.
+  uint64_t sequence() const {
+    return sequence_.load(std::memory_order_acquire);
+  }
+
+ private:
+  static constexpr std::size_t kCacheLineSize = 64;
+
+  // The mailboxes are members of plugins, which are allocated with plain new,
+  // and before C++17 that does not honour an alignas beyond the alignment of
+  // the allocator. Instead, a full cache line of padding follows every part
+  // the threads write, so that the parts never share a cache line wherever
+  // the mailbox is placed.
+  struct Slot {
+    /// \brief  Odd while the producer writes the slot.
+    std::atomic<uint64_t> version;
+    std::atomic<uint64_t> sequence;
+    std::atomic<double> stamp;
+    std::atomic<std::size_t> size;
+    std::atomic<double> values[Capacity];
+    char padding[kCacheLineSize];
+  };
+
+  /// \brief  Sequence number of the newest command, which is held by slot
+  ///         sequence_ & 1.
+  std::atomic<uint64_t> sequence_;
+  char sequence_padding_[kCacheLineSize];
+  Slot slots_[2];
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_COMMAND_MAILBOX_H
@@ -24,6 +24,9 @@
 
 #include <Eigen/Dense>
 #include <gazebo/gazebo.hh>
+#include <google/protobuf/repeated_field.h>
+
+#include "rotors_gazebo_plugins/profiling.h"
 
 namespace gazebo {
 
@@ -38,7 +41,6 @@ namespace gazebo {
 // Suitable for debugging purposes. Left on permanently can swamp std::out and can crash Gazebo.
 
 static const bool kPrintOnPluginLoad    = false;
-static const bool kPrintOnUpdates       = false;
 static const bool kPrintOnMsgCallback   = false;
 
 /// @}
@@ -54,6 +56,8 @@ static constexpr double kDefaultRotorVelocitySlowdownSim = 10.0;
 // These should perhaps be defined in an .sdf/.xacro file instead?
 static const std::string kConnectGazeboToRosSubtopic = "connect_gazebo_to_ros_subtopic";
 static const std::string kConnectRosToGazeboSubtopic = "connect_ros_to_gazebo_subtopic";
+/// \brief    Topic for batches of Gazebo->ROS connections, see RosBridgeConnector.
+static const std::string kConnectGazeboToRosBatchSubtopic = "connect_gazebo_to_ros_batch_subtopic";
 
 /// \brief    Special-case topic for ROS interface plugin to listen to (if present)
 ///           and broadcast transforms to the ROS system.
@@ -125,6 +129,12 @@ class FirstOrderFilter {
 
   ~FirstOrderFilter() {}
 
+  /// \brief    Output of the last update, the state of the filter.
+  T previousState() const { return previousState_; }
+
+  /// \brief    Sets the state of the filter, e.g. when restoring a checkpoint.
+  void setPreviousState(T state) { previousState_ = state; }
+
  protected:
   double timeConstantUp_;
   double timeConstantDown_;
@@ -149,6 +159,22 @@ Eigen::Quaternion<typename Derived::Scalar> QuaternionFromSmallAngle(const Eigen
   }
 }
 
+/// \brief    Resizes a repeated field of a re-used protobuf message to size elements.
+/// \details  A repeated field keeps its storage when it shrinks, so once a message has
+///           been sized its elements can be overwritten with Set() every update without
+///           any allocation, instead of clearing the field and adding them again.
+template <typename T>
+void ResizeRepeatedField(int size, google::protobuf::RepeatedField<T>* field) {
+  if (field->size() > size) {
+    field->Truncate(size);
+    return;
+  }
+  field->Reserve(size);
+  while (field->size() < size) {
+    field->Add(T());
+  }
+}
+
 template<class In, class Out>
 void copyPosition(const In& in, Out* out) {
   out->x = in.x;
@@ -0,0 +1,149 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_CONTROL_LOOP_MONITOR_H
+#define ROTORS_GAZEBO_PLUGINS_CONTROL_LOOP_MONITOR_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gazebo/common/common.hh>
+#include <gazebo/physics/physics.hh>
+
+namespace gazebo {
+
+// Default values
+static constexpr double kDefaultControlDeadline = 0.01;  // [s]
+/// \brief  Largest number of requests waiting for their response, older ones
+///         are forgotten.
+static constexpr std::size_t kMaxOpenControlRequests = 64;
+
+/// \brief  Latency of one control loop over a reporting window.
+struct ControlLoopStats {
+  ControlLoopStats()
+      : deadline(0.0),
+        samples(0),
+        misses(0),
+        total_latency(0.0),
+        max_latency(0.0),
+        max_wall_latency(0.0) {}
+
+  std::string name;
+  /// \brief  Longest simulation time from a request to its response [s].
+  double deadline;
+  uint64_t samples;
+  /// \brief  Responses later than the deadline or never received.
+  uint64_t misses;
+  /// \brief  Simulation time from the requests to their responses [s].
+  double total_latency;
+  double max_latency;
+  /// \brief  Wall time from a request to its response [s], 0 if unknown.
+  double max_wall_latency;
+};
+
+class ControlLoopMonitor;
+
+/// \brief    Round trip of one control loop closed outside of Gazebo, like an
+///           autopilot answering the sensor messages with actuator controls,
+///           or a ROS controller answering the odometry with motor commands.
+/// \details  Unregisters from the monitor when destroyed.
+class ControlLoop {
+ public:
+  ControlLoop(std::shared_ptr<ControlLoopMonitor> monitor,
+              const std::string& name, double deadline);
+  ~ControlLoop();
+
+  /// \brief  Records a request, sent at the given simulation time.
+  void Request(const common::Time& sim_time);
+
+  /// \brief  Answers the oldest open request, received at the given
+  ///         simulation time. For loops answering every request.
+  void Respond(const common::Time& sim_time);
+
+  /// \brief  Answers the newest open request and forgets the older ones. For
+  ///         loops running at their own rate, which answer the latest data.
+  void RespondLatest(const common::Time& sim_time);
+
+  /// \brief  Reports the latency of a response the plugin measured itself,
+  ///         e.g. from the stamp the controller copied into its command.
+  void Report(double sim_latency, double wall_latency);
+
+  /// \brief  Counts the open requests as missed and forgets them.
+  void DropRequests();
+
+  /// \brief  Forgets the open requests without counting them, e.g. while
+  ///         the other end is not connected yet.
+  void ClearRequests();
+
+  /// \brief  Returns the statistics since the last call.
+  ControlLoopStats TakeStats();
+
+ private:
+  /// \brief  Records the latency of the front request and removes it.
+  ///         Called with mutex_ held.
+  void RespondFront(const common::Time& sim_time);
+  /// \brief  Called with mutex_ held.
+  void Record(double sim_latency, double wall_latency);
+
+  std::shared_ptr<ControlLoopMonitor> monitor_;
+
+  std::mutex mutex_;
+  /// \brief  Simulation and wall time of the open requests.
+  std::deque<std::pair<double, std::chrono::steady_clock::time_point> >
+      requests_;
+  ControlLoopStats stats_;
+};
+
+typedef std::shared_ptr<ControlLoop> ControlLoopPtr;
+
+/// \brief    Collects the latency of the control loops of a world, for the
+///           real time factor governor.
+/// \details  The monitor of a world is shared by all plugins reporting to it.
+class ControlLoopMonitor {
+ public:
+  /// \brief  Returns the monitor of a world, creating it on first use. The
+  ///         monitor is released when the last loop and reader are gone.
+  static std::shared_ptr<ControlLoopMonitor> Get(
+      const physics::WorldPtr& world);
+
+  /// \brief  Registers a control loop with a deadline in simulation time.
+  static ControlLoopPtr Connect(const physics::WorldPtr& world,
+                                const std::string& name, double deadline);
+
+  void Register(ControlLoop* loop);
+  void Unregister(ControlLoop* loop);
+
+  /// \brief  Returns the statistics of every loop since the last call.
+  std::vector<ControlLoopStats> TakeStats();
+
+ private:
+  std::mutex mutex_;
+  std::vector<ControlLoop*> loops_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_CONTROL_LOOP_MONITOR_H
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_COVARIANCE_MAP_H
+#define ROTORS_GAZEBO_PLUGINS_COVARIANCE_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gazebo {
+
+/// \brief    Intensities of a 2D grid in world frame, one byte per cell.
+/// \details  Cell (ix, iy) spans min_x + ix * resolution to min_x + (ix + 1)
+///           * resolution along x, and likewise along y. The cells are
+///           stored row by row, i.e. (ix, iy) is at ix + iy * width.
+struct CovarianceMapData {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  double min_x = 0.0;
+  double min_y = 0.0;
+  double resolution = 1.0;
+  std::vector<uint8_t> cells;
+
+  /// \brief  Reads a grayscale image, which is centered around the origin
+  ///         with one pixel per resolution x resolution meters. Rows of
+  ///         the image run along y.
+  bool ReadImage(const std::string& path, double resolution);
+};
+
+/// \brief    Header of the tiled covariance map format, followed by the
+///           tile index and the tiles, in host byte order.
+/// \details  The index holds n_tiles_x * n_tiles_y entries, tile (tx, ty)
+///           at tx + ty * n_tiles_x. An entry with kCovarianceMapUniformTile
+///           set stores the intensity of a uniform tile in its lowest byte,
+///           any other entry is the file offset of the tile_size * tile_size
+///           intensities of the tile, row by row. Cells of the last tiles
+///           beyond width and height are outside of the map.
+struct CovarianceMapFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t tile_size;
+  uint32_t width;
+  uint32_t height;
+  double min_x;
+  double min_y;
+  double resolution;
+  uint64_t index_offset;
+};
+
+static_assert(sizeof(CovarianceMapFileHeader) == 56,
+              "The covariance map file header must not contain padding.");
+
+static const char kCovarianceMapFileMagic[8] = {'R', 'O', 'T', 'O', 'R', 'S', 'C', 'M'};
+static constexpr uint32_t kCovarianceMapFileVersion = 1;
+static constexpr uint64_t kCovarianceMapUniformTile = uint64_t(1) << 63;
+static constexpr uint32_t kDefaultCovarianceMapTileSize = 256;
+
+/// \brief    Covariance map of the odometry plugin, in the tiled format.
+/// \details  A tiled file is mapped read-only, so only the tiles around the
+///           vehicles are paged in, and uniform tiles, e.g. open space, take
+///           no storage at all. Images are converted to the same layout in
+///           memory on load. A lookup reads one index entry and at most one
+///           byte of a tile.
+///
+///           The maps are shared by all plugins loading the same file, see
+///           Get().
+class CovarianceMap {
+ public:
+  CovarianceMap();
+  ~CovarianceMap();
+
+  CovarianceMap(const CovarianceMap&) = delete;
+  CovarianceMap& operator=(const CovarianceMap&) = delete;
+
+  /// \brief  Returns the map of a file, loading it on first use. The map is
+  ///         released when the last plugin holding it is unloaded.
+  /// \param[in] image_resolution Resolution of a plain image [m], ignored
+  ///            for tiled files.
+  /// \return NULL if the file could not be loaded.
+  static std::shared_ptr<const CovarianceMap> Get(const std::string& path,
+                                                  double image_resolution);
+
+  /// \brief  Loads a tiled file or an image, detecting the format from the
+  ///         file content.
+  bool Load(const std::string& path, double image_resolution);
+
+  /// \brief  Maps a tiled file into memory.
+  bool LoadBinary(const std::string& path);
+
+  void Clear();
+
+  /// \brief  Encodes a map in the tiled format.
+  static void Encode(const CovarianceMapData& data, uint32_t tile_size,
+                     std::vector<char>* file);
+
+  /// \brief  Writes a map in the tiled format.
+  static bool WriteBinary(const CovarianceMapData& data, uint32_t tile_size,
+                          const std::string& path);
+
+  /// \brief  Returns true if the file starts with the tiled format magic.
+  static bool IsBinaryFile(const std::string& path);
+
+  bool empty() const { return base_ == nullptr; }
+
+  /// \brief  Intensity of the cell at a world position, or -1 outside of
+  ///         the map.
+  int Intensity(double x, double y) const {
+    const double fx = (x - min_x_) / resolution_;
+    const double fy = (y - min_y_) / resolution_;
+    if (!(fx >= 0.0 && fx < width_ && fy >= 0.0 && fy < height_)) return -1;
+    const uint32_t ix = static_cast<uint32_t>(fx);
+    const uint32_t iy = static_cast<uint32_t>(fy);
+    const uint64_t entry =
+        index_[ix / tile_size_ + (iy / tile_size_) * n_tiles_x_];
+    if (entry & kCovarianceMapUniformTile) return entry & 0xff;
+    return static_cast<const uint8_t*>(base_)[entry + ix % tile_size_ +
+                                              (iy % tile_size_) * tile_size_];
+  }
+
+  std::size_t width() const { return width_; }
+  std::size_t height() const { return height_; }
+  double resolution() const { return resolution_; }
+  /// \brief  Number of tiles that are not uniform.
+  std::size_t num_stored_tiles() const { return num_stored_tiles_; }
+
+ private:
+  /// \brief  Checks the header and the index of a file in the tiled format.
+  bool Attach(const void* base, std::size_t size);
+
+  uint32_t width_;
+  uint32_t height_;
+  uint32_t tile_size_;
+  uint32_t n_tiles_x_;
+  double min_x_;
+  double min_y_;
+  double resolution_;
+  std::size_t num_stored_tiles_;
+
+  /// \brief  Start of the file content and its tile index.
+  const void* base_;
+  const uint64_t* index_;
+
+  /// \brief  Storage for maps converted from an image.
+  std::vector<char> buffer_;
+
+  void* mapped_data_;
+  std::size_t mapped_size_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_COVARIANCE_MAP_H
@@ -16,33 +16,96 @@
 #ifndef ROTORS_GAZEBO_PLUGINS_DEPTH_NOISE_MODEL_H
 #define ROTORS_GAZEBO_PLUGINS_DEPTH_NOISE_MODEL_H
 
-#include <Eigen/Eigen>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
 #include <random>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Eigen>
+
+#include "rotors_gazebo_plugins/normal_sample_buffer.h"
 
 class DepthNoiseModel {
  public:
-  DepthNoiseModel()
-      : max_depth(1000.0f), min_depth(0.2f), gen(std::random_device{}()) {}
+  DepthNoiseModel();
+  virtual ~DepthNoiseModel();
+
+  // Adds noise to the width x height depth image in place. The rows are split
+  // evenly between the threads, every thread draws from its own RNG stream.
+  void ApplyNoise(uint32_t width, uint32_t height, float *data);
 
-  virtual void ApplyNoise(uint32_t width, uint32_t height, float *data) = 0;
+  // Writes the noisy version of the depth image src to dest, in the same pass
+  // which reads src. src and dest may be the same.
+  void ApplyNoise(uint32_t width, uint32_t height, const float *src,
+                  float *dest);
+
+  // Number of threads working on a frame, including the calling one.
+  // 0 selects one thread per core.
+  void SetNumThreads(unsigned int num_threads);
+  unsigned int NumThreads() const { return streams_.size(); }
 
   float max_depth;  // [m]
   float min_depth;  // [m] Values smaller/larger than these two are replaced
                     //     by NaN
 
  protected:
+  // Called once per frame before the pixels, to set up per frame constants.
+  virtual void PrepareFrame(uint32_t width, uint32_t height) {}
+
+  // Writes n consecutive pixels of src with noise to dest, given one standard
+  // normal sample per pixel. Must not allocate, and is called concurrently
+  // from the threads.
+  virtual void ApplyNoiseToPixels(size_t n, const float *src, float *dest,
+                                  const float *normal_samples) const = 0;
+
   bool InRange(float depth) const;
 
   const float bad_point = std::numeric_limits<float>::quiet_NaN();
-  std::normal_distribution<float> dist;
-  std::mt19937 gen;
+
+ private:
+  // Pixels handled per call of ApplyNoiseToPixels, sized to stay in cache.
+  static constexpr size_t kPixelBlockSize = 1024;
+
+  struct RowStream {
+    explicit RowStream(uint64_t seed)
+        : normal(gazebo::kDefaultNormalSampleBlockSize, seed),
+          samples(kPixelBlockSize) {}
+
+    gazebo::NormalSampleBuffer normal;
+    std::vector<float> samples;
+  };
+
+  void ApplyNoiseToRows(unsigned int stream, uint32_t width, uint32_t height,
+                        const float *src, float *dest);
+  void WorkerThread(unsigned int stream);
+  void StopWorkers();
+
+  uint64_t seed_;
+  std::vector<RowStream> streams_;
+
+  // Workers for the streams 1..n-1, stream 0 runs in the calling thread.
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable frame_condition_;
+  std::condition_variable done_condition_;
+  uint64_t frame_;
+  unsigned int num_pending_;
+  bool stop_;
+  uint32_t frame_width_;
+  uint32_t frame_height_;
+  const float *frame_src_;
+  float *frame_dest_;
 };
 
 class KinectDepthNoiseModel : public DepthNoiseModel {
  public:
   KinectDepthNoiseModel() : DepthNoiseModel() {}
 
-  void ApplyNoise(uint32_t width, uint32_t height, float *data);
+ protected:
+  void ApplyNoiseToPixels(size_t n, const float *src, float *dest,
+                          const float *normal_samples) const;
 };
 
 class D435DepthNoiseModel : public DepthNoiseModel {
@@ -52,10 +115,9 @@ class D435DepthNoiseModel : public DepthNoiseModel {
         baseline(0.05f),     // Default 50 mm for D435
         subpixel_err(0.1f),  // Default subpixel calibration error
         max_stdev(3.0f),
+        multiplier_(0.0f),
         DepthNoiseModel() {}
 
-  void ApplyNoise(uint32_t width, uint32_t height, float *data);
-
   // public params...
   float h_fov;         // [rad]
   float baseline;      // [m]
@@ -63,6 +125,14 @@ class D435DepthNoiseModel : public DepthNoiseModel {
   float max_stdev;     // [m] cutoff for distance standard deviation:
                        //     If modeled standard deviation becomes bigger, it is replaced with this
                        //     value.
+
+ protected:
+  void PrepareFrame(uint32_t width, uint32_t height);
+  void ApplyNoiseToPixels(size_t n, const float *src, float *dest,
+                          const float *normal_samples) const;
+
+ private:
+  float multiplier_;
 };
 
 #endif  // ROTORS_GAZEBO_PLUGINS_DEPTH_NOISE_MODEL_H
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2018 Michael Pantic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ROTORS_GAZEBO_PLUGINS_DEPTH_NOISE_SHADER_H
+#define ROTORS_GAZEBO_PLUGINS_DEPTH_NOISE_SHADER_H
+
+#include <random>
+#include <string>
+
+#include <gazebo/rendering/ogre_gazebo.h>
+
+#include <rotors_gazebo_plugins/depth_noise_model.hpp>
+
+// Applies the noise of a DepthNoiseModel to the depth map of a depth camera
+// on the GPU, with the RotorS/DepthNoise compositor. The noise is added after
+// the depth pass and before the map is read back, so the frames handed to the
+// plugin are already noisy.
+class DepthNoiseShader : public Ogre::CompositorInstance::Listener {
+ public:
+  DepthNoiseShader();
+  ~DepthNoiseShader();
+
+  // Registers the compositor and shaders found below media_path (with
+  // materials/scripts and materials/programs). Call once before Attach().
+  static bool AddResourcePath(const std::string &media_path);
+
+  // Attaches the compositor to the viewport which renders into the depth
+  // texture of the given name. Must be called from the rendering thread.
+  // Returns false if the texture or the compositor is not available, the
+  // noise then has to be applied on the CPU.
+  bool Attach(const std::string &depth_texture_name, uint32_t width,
+              const DepthNoiseModel &model);
+
+  void Detach();
+
+  bool IsAttached() const { return compositor_ != nullptr; }
+
+  // Ogre::CompositorInstance::Listener
+  void notifyMaterialSetup(Ogre::uint32 pass_id, Ogre::MaterialPtr &mat);
+  void notifyMaterialRender(Ogre::uint32 pass_id, Ogre::MaterialPtr &mat);
+
+ private:
+  Ogre::Viewport *viewport_;
+  Ogre::CompositorInstance *compositor_;
+
+  // Uniforms of the fragment shader.
+  int model_;
+  float min_depth_;
+  float max_depth_;
+  float multiplier_;
+  float max_stdev_;
+
+  std::mt19937 gen_;
+  std::uniform_real_distribution<float> seed_dist_;
+};
+
+#endif  // ROTORS_GAZEBO_PLUGINS_DEPTH_NOISE_SHADER_H
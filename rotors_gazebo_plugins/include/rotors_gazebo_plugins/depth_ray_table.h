@@ -0,0 +1,117 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_DEPTH_RAY_TABLE_H
+#define ROTORS_GAZEBO_PLUGINS_DEPTH_RAY_TABLE_H
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace gazebo {
+
+/// \brief    Unprojection of the pixels of a depth camera, to turn a depth
+///           image into a point cloud in the optical frame.
+/// \details  For every pixel of the decimated grid, the table holds the
+///           index of its source pixel and its ray scaled to a unit z, as the
+///           depth camera renders the distance along the optical axis. A
+///           point is then only the depth times the ray, there is no
+///           trigonometry per frame. The table is rebuilt only if the
+///           resolution, the field of view or the decimation change.
+class DepthRayTable {
+ public:
+  DepthRayTable()
+      : image_width_(0), image_height_(0), hfov_(0.0), decimation_(0),
+        width_(0), height_(0) {}
+
+  /// \brief  Rebuilds the table for a camera, if it was built for another.
+  /// \param[in] hfov Horizontal field of view [rad].
+  /// \param[in] decimation Every decimation-th pixel of every decimation-th
+  ///            row becomes a point.
+  /// \return True if the table was rebuilt, the layout of the cloud changed.
+  bool Update(int image_width, int image_height, double hfov, int decimation) {
+    if (decimation < 1) decimation = 1;
+    if (image_width == image_width_ && image_height == image_height_ &&
+        hfov == hfov_ && decimation == decimation_) {
+      return false;
+    }
+    image_width_ = image_width;
+    image_height_ = image_height;
+    hfov_ = hfov;
+    decimation_ = decimation;
+    width_ = (image_width + decimation - 1) / decimation;
+    height_ = (image_height + decimation - 1) / decimation;
+
+    // The focal length of the camera info of GazeboRosCameraUtils, but the
+    // principal point at the center of the image, as in the per-pixel
+    // unprojection this replaces. The camera info puts it at (w + 1) / 2.
+    const double focal_length = image_width / (2.0 * std::tan(hfov / 2.0));
+    const double cx = 0.5 * (image_width - 1);
+    const double cy = 0.5 * (image_height - 1);
+    pixels_.resize(static_cast<std::size_t>(width_) * height_);
+    rays_.resize(2 * pixels_.size());
+    std::size_t k = 0;
+    for (int row = 0; row < image_height; row += decimation) {
+      for (int col = 0; col < image_width; col += decimation, ++k) {
+        pixels_[k] = static_cast<uint32_t>(row) * image_width + col;
+        rays_[2 * k] = static_cast<float>((col - cx) / focal_length);
+        rays_[2 * k + 1] = static_cast<float>((row - cy) / focal_length);
+      }
+    }
+    return true;
+  }
+
+  /// \brief  Size of the decimated grid, the organized cloud.
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+  /// \brief  Writes the x, y, z of every point of the grid to points, depths
+  ///         outside [min_depth, max_depth] become NaN.
+  void Unproject(const float* depth, float min_depth, float max_depth,
+                 float* points) const {
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const std::size_t size = pixels_.size();
+    for (std::size_t k = 0; k < size; ++k) {
+      const float d = depth[pixels_[k]];
+      // Also false for NaN.
+      const bool valid = d >= min_depth && d <= max_depth;
+      points[3 * k] = valid ? d * rays_[2 * k] : nan;
+      points[3 * k + 1] = valid ? d * rays_[2 * k + 1] : nan;
+      points[3 * k + 2] = valid ? d : nan;
+    }
+  }
+
+ private:
+  int image_width_;
+  int image_height_;
+  double hfov_;
+  int decimation_;
+  int width_;
+  int height_;
+  /// \brief  Index of the source pixel of every point.
+  std::vector<uint32_t> pixels_;
+  /// \brief  x and y of the ray of every point, for a unit depth.
+  std::vector<float> rays_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_DEPTH_RAY_TABLE_H
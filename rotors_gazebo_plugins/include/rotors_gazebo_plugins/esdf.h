@@ -0,0 +1,80 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_ESDF_H
+#define ROTORS_GAZEBO_PLUGINS_ESDF_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gazebo {
+
+/// \brief Magic number at the start of an ESDF file.
+static const char kEsdfFileMagic[8] = {'R', 'O', 'T', 'O', 'R', 'S', 'D', 'F'};
+static constexpr uint32_t kEsdfFileVersion = 1;
+
+/// \brief    Header of an ESDF file.
+/// \details  The header is followed by num_cells[0] * num_cells[1] *
+///           num_cells[2] floats in host byte order, the signed distance [m]
+///           of cell (ix, iy, iz) at index (ix * num_cells[1] + iy) *
+///           num_cells[2] + iz. The header is 64 bytes long, so that the
+///           distances are aligned when the file is memory mapped.
+struct EsdfFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_cells[3];
+  /// \brief Center of cell (0, 0, 0) in world frame [m].
+  double min[3];
+  /// \brief Edge length of a cell [m].
+  double voxel_size;
+  /// \brief Distances are clamped to +-max_distance [m], 0 if unclamped.
+  double max_distance;
+};
+
+static_assert(sizeof(EsdfFileHeader) == 64,
+              "The ESDF file header must not contain padding.");
+
+/// \brief Computes the exact Euclidean signed distance field of a dense grid.
+/// \details Free cells get the positive distance between their center and
+///          the closest center of a cell that is not free, all other cells
+///          the negative distance to the closest free cell. The squared
+///          distance transform is separated into one pass per axis, each
+///          pass processes its lines in parallel.
+/// \param[in] num_cells Number of cells along every axis.
+/// \param[in] free_cells Dense bitmap of the free cells, indexed like the
+///            distances.
+/// \param[in] max_distance Clamp the distances to +-max_distance [m], 0
+///            leaves them unclamped. Infinite without cells of the other kind.
+/// \param[in] num_threads Number of worker threads.
+/// \param[out] distances Signed distance of every cell [m].
+void ComputeEsdf(const int num_cells[3], double voxel_size,
+                 const std::vector<bool>& free_cells, double max_distance,
+                 int num_threads, std::vector<float>* distances);
+
+/// \brief Writes an ESDF file, through a temporary file so that no partial
+///        file is left behind.
+/// \return Whether the file was written.
+bool WriteEsdfFile(const std::string& path, const EsdfFileHeader& header,
+                   const std::vector<float>& distances);
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_ESDF_H
@@ -16,7 +16,14 @@
 */
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <gazebo/common/Plugin.hh>
 #include <gazebo/sensors/CameraSensor.hh>
@@ -31,7 +38,17 @@
 
 namespace gazebo {
 
+// Default values
+static constexpr int kDefaultGeotaggedWriterThreads = 1;
+static constexpr int kDefaultGeotaggedWriterQueueSize = 4;
+/// \brief    Simulation time between two reports of the capture statistics [s].
+static constexpr double kGeotaggedReportInterval = 10.0;
+
 /// \brief    Gazebo plugin that saves geotagged camera images to disk.
+/// \details  OnNewFrame() only copies the frame and the last GPS position into
+///           one of a fixed number of buffers. Colour conversion, resizing,
+///           JPEG encoding and the EXIF tagging are done by writer threads.
+///           If all buffers are in use, the frame is dropped.
 class GAZEBO_VISIBLE GeotaggedImagesPlugin : public SensorPlugin {
   public: GeotaggedImagesPlugin();
 
@@ -42,6 +59,17 @@ class GAZEBO_VISIBLE GeotaggedImagesPlugin : public SensorPlugin {
   public: void OnNewFrame(const unsigned char *image);
   public: void OnNewGpsPosition(ConstVector3dPtr& v);
 
+  /// \brief    A captured frame waiting for a writer thread.
+  private: struct FrameJob {
+    std::vector<unsigned char> image;
+    msgs::Vector3d gpsPosition;
+    int index;
+  };
+
+  private: void WriterThread();
+  private: void WriteFrame(const FrameJob& job);
+  private: void StopWriters();
+
   protected: float storeIntervalSec_;
   private: int imageCounter_;
   common::Time lastImageTime_;
@@ -60,6 +88,22 @@ class GAZEBO_VISIBLE GeotaggedImagesPlugin : public SensorPlugin {
   protected: unsigned int width_, height_, depth_;
   protected: unsigned int destWidth_, destHeight_; ///< output size
   protected: std::string format_;
+
+  private: int numWriterThreads_;
+  private: std::vector<std::thread> writerThreads_;
+  private: std::mutex writerMutex_;
+  private: std::condition_variable writerCondition_;
+  private: bool stopWriters_;
+  /// \brief    Buffers not in use, and captured frames in capture order.
+  private: std::vector<std::unique_ptr<FrameJob>> freeJobs_;
+  private: std::deque<std::unique_ptr<FrameJob>> pendingJobs_;
+
+  private: std::atomic<uint64_t> framesWritten_;
+  private: uint64_t framesCaptured_;
+  private: uint64_t framesDropped_;
+  private: uint64_t reportedFramesCaptured_;
+  private: uint64_t reportedFramesDropped_;
+  private: common::Time lastReportTime_;
 };
 
 } // namespace gazebo
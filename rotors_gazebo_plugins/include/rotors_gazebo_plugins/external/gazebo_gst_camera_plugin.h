@@ -16,6 +16,8 @@
 */
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <string>
 #include <mutex>
 
@@ -33,11 +35,27 @@
 namespace gazebo
 {
 
+// Default values
+static constexpr int kDefaultGstBufferPoolSize = 8;
+static const std::string kDefaultGstEncoder = "x264";
+static const std::string kDefaultGstCodec = "h264";
+static const std::string kDefaultGstUdpHost = "127.0.0.1";
+static constexpr int kDefaultGstBitrate = 800;
+static constexpr bool kDefaultGstZeroLatency = false;
+/// \brief Minimum wall time between two reports of dropped frames [s].
+static constexpr double kGstDropReportInterval = 5.0;
 
 /// \class  GstCameraPlugin
 /// \brief  A Gazebo plugin that can be attached to a camera and then streams the video data using gstreamer.
 /// It streams to a configurable UDP port, default is 5600.
 ///
+/// The encoder is selected with <encoder> (x264, nvenc or vaapi) and <codec>
+/// (h264 or h265), or given as a complete gst-launch style <encoderPipeline>.
+/// The camera frames are fed to the encoder without videoconvert whenever the
+/// encoder, or its hardware converter, accepts the pixel format of the camera.
+/// Extra encoder properties can be set with <encoderProperties>, e.g.
+/// "key-int-max=30 b-adapt=false".
+///
 /// Connect to the stream via command line with:
 /// gst-launch-1.0  -v udpsrc port=5600 caps='application/x-rtp, media=(string)video, clock-rate=(int)90000, encoding-name=(string)H264' \
 /// ! rtph264depay ! avdec_h264 ! videoconvert ! autovideosink fps-update-interval=1000 sync=false
@@ -54,13 +72,33 @@ class GAZEBO_VISIBLE GstCameraPlugin : public SensorPlugin
 		unsigned int depth, const std::string &format);
 
   public: void startGstThread();
+
+  /// \brief Called by appsrc when it wants more frames (need-data).
   public: void gstCallback(GstElement *appsrc);
 
+  /// \brief Called by appsrc when its queue is full (enough-data).
+  public: void gstEnoughDataCallback(GstElement *appsrc);
+
+  /// \brief Creates the configured encoder, or a bin from encoderPipeline.
+  private: GstElement* createEncoder();
+
+  /// \brief Creates the converter between appsrc and the encoder, or returns
+  /// null if the encoder accepts the frames as they are.
+  private: GstElement* createConverter(GstElement *encoder, GstCaps *caps);
+
   protected: unsigned int width, height, depth;
   float rate;
   protected: std::string format;
 
   protected: int udpPort;
+  protected: std::string udpHost;
+
+  protected: std::string encoderName;
+  protected: std::string codec;
+  protected: std::string encoderPipeline;
+  protected: std::string encoderProperties;
+  protected: int bitrate;
+  protected: bool zeroLatency;
 
   protected: sensors::CameraSensorPtr parentSensor;
   protected: rendering::CameraPtr camera;
@@ -71,11 +109,24 @@ class GAZEBO_VISIBLE GstCameraPlugin : public SensorPlugin
   private: std::string namespace_;
   private: const std::string topicName = "gst_video";
 
-  GstBuffer *frameBuffer;
+  /// \brief Source of the pipeline, frames are pushed into it from
+  /// OnNewFrame(). Null while the pipeline is not running.
+  GstElement *appSrc;
+  /// \brief Preallocated frame buffers, a buffer goes back to the pool once
+  /// the encoder is done with it.
+  GstBufferPool *bufferPool;
+  int bufferPoolSize;
   std::mutex frameBufferMutex;
   GMainLoop *mainLoop;
   GstClockTime gstTimestamp;
 
+  /// \brief False while appsrc signals that the encoder is behind.
+  std::atomic<bool> needData;
+  std::atomic<uint64_t> framesPushed;
+  std::atomic<uint64_t> framesDropped;
+  uint64_t reportedFramesDropped;
+  std::chrono::steady_clock::time_point lastDropReport;
+
 };
 
 } /* namespace gazebo */
@@ -22,16 +22,32 @@
 #ifndef _GAZEBO_RAY_PLUGIN_HH_
 #define _GAZEBO_RAY_PLUGIN_HH_
 
+#include <random>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
 #include "gazebo/common/Plugin.hh"
 #include "gazebo/sensors/SensorTypes.hh"
 #include "gazebo/sensors/RaySensor.hh"
 #include "gazebo/util/system.hh"
 
 #include "Lidar.pb.h"
+#include "LidarScan.pb.h"
 
 namespace gazebo
 {
+  // Default values
+  static constexpr bool kDefaultLidarMultiBeam = false;
+  static constexpr double kDefaultLidarRangeNoiseStdDev = 0.0;
+
   /// \brief    A Gazebo LIDAR plugin.
+  /// \details  By default publishes the first range of the ray sensor as a
+  ///           lidar message. With multiBeam set, the whole scan of a
+  ///           multi-beam (e.g. 16-128 beam spinning) sensor is read at once,
+  ///           noised and clipped as one batch and published as a single
+  ///           lidar_scan point cloud on "lidar_scan".
   class GAZEBO_VISIBLE GazeboLidarPlugin : public SensorPlugin
   {
     /// \brief Constructor
@@ -47,6 +63,13 @@ namespace gazebo
     /// \param take in SDF root element
     public: void Load(sensors::SensorPtr _parent, sdf::ElementPtr _sdf);
 
+    /// \brief Publishes the whole scan of the sensor as one message.
+    private: void PublishScan();
+
+    /// \brief Precomputes the unit vector of every beam and sizes the
+    ///        buffers and the packed point message for the scan.
+    private: void InitScan();
+
     /// \brief Pointer to parent
     protected: physics::WorldPtr world;
 
@@ -62,6 +85,23 @@ namespace gazebo
     private: 
       event::ConnectionPtr newLaserScansConnection;
       lidar_msgs::msgs::lidar lidar_message;
+
+    /// \brief Multi-beam mode, all buffers are sized once in InitScan().
+    private:
+      bool multi_beam_;
+      double range_noise_stddev_;
+      transport::PublisherPtr scan_pub_;
+      lidar_msgs::msgs::lidar_scan scan_message_;
+      std::mt19937 random_generator_;
+      std::normal_distribution<float> standard_normal_distribution_;
+      /// \brief Ranges as returned by the sensor, row-major per vertical beam.
+      std::vector<double> ranges_;
+      Eigen::ArrayXf range_buffer_;
+      Eigen::ArrayXf noise_buffer_;
+      /// \brief Components of the unit vector of every beam.
+      Eigen::ArrayXf beam_x_;
+      Eigen::ArrayXf beam_y_;
+      Eigen::ArrayXf beam_z_;
   };
 }
 #endif
@@ -17,6 +17,7 @@
 #ifndef _GAZEBO_OPTICAL_FLOW_PLUGIN_HH_
 #define _GAZEBO_OPTICAL_FLOW_PLUGIN_HH_
 
+#include <memory>
 #include <string>
 
 #include "gazebo/common/Plugin.hh"
@@ -37,6 +38,8 @@
 #include "flow_opencv.hpp"
 #include "flow_px4.hpp"
 
+#include "rotors_gazebo_plugins/pyramid_optical_flow.h"
+
 using namespace cv;
 using namespace std;
 
@@ -69,6 +72,8 @@ namespace gazebo
       boost::timer::cpu_timer timer_;
       OpticalFlowOpenCV *_optical_flow;
       // OpticalFlowPX4 *_optical_flow;
+      /// \brief Used instead of _optical_flow if flowEngine is "pyramid".
+      std::unique_ptr<PyramidOpticalFlow> pyramid_flow_;
 
       float hfov;
       float rate;
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_FAST_MULTI_COPTER_H
+#define ROTORS_GAZEBO_PLUGINS_FAST_MULTI_COPTER_H
+
+#include <Eigen/Eigen>
+
+#include <rotors_control/parameters.h>
+
+#include "rotors_gazebo_plugins/multi_copter.hpp"
+
+// Default rotor dynamics, the same as the defaults of GazeboMotorModel.
+static constexpr double kDefaultFastSimTimeConstantUp = 1.0 / 80.0;
+static constexpr double kDefaultFastSimTimeConstantDown = 1.0 / 40.0;
+static constexpr double kDefaultFastSimMaxRotVelocity = 838.0;
+static constexpr double kDefaultFastSimRotorDragCoefficient = 1.0e-4;
+static constexpr double kDefaultFastSimRollingMomentCoefficient = 1.0e-6;
+static constexpr double kDefaultFastSimGroundHeight = 0.0;
+
+/// \brief    Parameters of a FastMultiCopter.
+/// \details  The mass, inertia and rotor configuration are the vehicle
+///           parameters of rotors_control, so that the simulated vehicle and
+///           the controller are configured from the same YAML file.
+struct FastMultiCopterParameters {
+  FastMultiCopterParameters()
+      : time_constant_up(kDefaultFastSimTimeConstantUp),
+        time_constant_down(kDefaultFastSimTimeConstantDown),
+        max_rot_velocity(kDefaultFastSimMaxRotVelocity),
+        rotor_drag_coefficient(kDefaultFastSimRotorDragCoefficient),
+        rolling_moment_coefficient(kDefaultFastSimRollingMomentCoefficient),
+        enable_ground(true),
+        ground_height(kDefaultFastSimGroundHeight) {}
+
+  rotors_control::VehicleParameters vehicle;
+  double time_constant_up;
+  double time_constant_down;
+  double max_rot_velocity;
+  double rotor_drag_coefficient;
+  double rolling_moment_coefficient;
+  /// \brief  Whether the vehicle rests on a flat ground at ground_height.
+  bool enable_ground;
+  double ground_height;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/// \brief    Rigid body and rotor dynamics of a multicopter without Gazebo.
+/// \details  Integrates the forces and moments of GazeboMotorModel (thrust,
+///           drag torque, rotor drag and rolling moment) and gravity on a
+///           single rigid body with semi-implicit Euler steps. The rotor
+///           velocities follow their references with the first order
+///           dynamics of the motor model. The rotors are assumed to be in the
+///           body x-y plane at the CoG, thrusting along the body z-axis, which
+///           is the geometry the allocation matrix of rotors_control assumes.
+///           Contact with the ground is modeled by stopping the vehicle at the
+///           ground height. simulateMAV() does not allocate.
+class FastMultiCopter : public MultiCopter {
+ public:
+  explicit FastMultiCopter(const FastMultiCopterParameters& params);
+  FastMultiCopter(const FastMultiCopterParameters& params,
+                  MotorController* motor_controller);
+  virtual ~FastMultiCopter() {}
+
+  void simulateMAV(double dt, const Eigen::VectorXd& ref_rotor_rot_vels) override;
+  void initializeParams() override;
+  void publish() override {}
+
+  /// \brief  Resets the time, the rotors, the external wrench and the state
+  ///         of the vehicle.
+  void reset(const Eigen::Vector3d& position,
+             const Eigen::Quaterniond& attitude);
+
+  /// \brief  Wind velocity in world frame acting on the rotors.
+  void setWindSpeed(const Eigen::Vector3d& wind_speed_W) {
+    wind_speed_W_ = wind_speed_W;
+  }
+
+  /// \brief  External force in world frame and moment in body frame, e.g. a
+  ///         disturbance, acting on the CoG until changed.
+  void setExternalWrench(const Eigen::Vector3d& force_W,
+                         const Eigen::Vector3d& moment_B) {
+    external_force_W_ = force_W;
+    external_moment_B_ = moment_B;
+  }
+
+  const FastMultiCopterParameters& parameters() const { return params_; }
+  double time() const { return time_; }
+  bool onGround() const { return on_ground_; }
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+ private:
+  FastMultiCopterParameters params_;
+
+  double time_;
+  bool on_ground_;
+  Eigen::Vector3d wind_speed_W_;
+  Eigen::Vector3d external_force_W_;
+  Eigen::Vector3d external_moment_B_;
+
+  // Rotor geometry and constants, one entry per rotor.
+  Eigen::Array2Xd rotor_positions_;
+  Eigen::ArrayXd motor_constants_;
+  Eigen::ArrayXd yaw_moment_constants_;
+
+  Eigen::Matrix3d inertia_inverse_;
+
+  // Discretized rotor dynamics, recomputed when the step size changes.
+  double filter_dt_;
+  double alpha_up_;
+  double alpha_down_;
+
+  // Scratch buffer, sized in initializeParams() so that stepping does not allocate.
+  Eigen::ArrayXd thrusts_;
+};
+
+#endif // ROTORS_GAZEBO_PLUGINS_FAST_MULTI_COPTER_H
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_FAST_SIM_H
+#define ROTORS_GAZEBO_PLUGINS_FAST_SIM_H
+
+#include <string>
+#include <vector>
+
+#include <Eigen/Eigen>
+#include <rotors_control/lee_position_controller.h>
+
+#include "rotors_gazebo_plugins/fast_multi_copter.h"
+#include "rotors_gazebo_plugins/lee_motor_controller.h"
+
+// Default step sizes of a fast simulator flight.
+static constexpr double kDefaultFastSimPhysicsStep = 0.001;
+static constexpr double kDefaultFastSimControlPeriod = 0.01;
+
+/// \brief  Reads the mass, inertia and rotor configuration from a vehicle
+///         parameter file of rotors_gazebo/resource, e.g. firefly.yaml.
+/// \return False if the file could not be read.
+bool LoadVehicleParametersYAML(const std::string& yaml_path,
+                               rotors_control::VehicleParameters* vehicle_parameters);
+
+/// \brief  Reads the gains from a Lee controller parameter file of
+///         rotors_gazebo/resource, e.g. lee_controller_firefly.yaml.
+/// \return False if the file could not be read.
+bool LoadLeeControllerParametersYAML(
+    const std::string& yaml_path,
+    rotors_control::LeePositionControllerParameters* controller_parameters);
+
+/// \brief  Waypoint held for waiting_time [s], yaw in rad.
+struct FastSimWaypoint {
+  FastSimWaypoint() : waiting_time(0.0), position(Eigen::Vector3d::Zero()), yaw(0.0) {}
+  FastSimWaypoint(double _waiting_time, const Eigen::Vector3d& _position, double _yaw)
+      : waiting_time(_waiting_time), position(_position), yaw(_yaw) {}
+
+  double waiting_time;
+  Eigen::Vector3d position;
+  double yaw;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+typedef std::vector<FastSimWaypoint, Eigen::aligned_allocator<FastSimWaypoint>>
+    FastSimWaypoints;
+
+/// \brief  Reads a waypoint file in the format of waypoint_publisher_file:
+///         space separated wait_time [s] x [m] y [m] z [m] yaw [deg].
+/// \return False if the file could not be read or contains no waypoint.
+bool ReadWaypointFile(const std::string& path, FastSimWaypoints* waypoints);
+
+/// \brief  External wrench applied to the vehicle for duration [s] from
+///         start_time [s] on, force in world frame, moment in body frame.
+struct FastSimDisturbance {
+  FastSimDisturbance()
+      : start_time(0.0), duration(0.0), force_W(Eigen::Vector3d::Zero()),
+        moment_B(Eigen::Vector3d::Zero()) {}
+
+  double start_time;
+  double duration;
+  Eigen::Vector3d force_W;
+  Eigen::Vector3d moment_B;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+struct FastSimFlightOptions {
+  FastSimFlightOptions()
+      : physics_step(kDefaultFastSimPhysicsStep),
+        control_period(kDefaultFastSimControlPeriod),
+        start_position(Eigen::Vector3d::Zero()),
+        wind_speed_W(Eigen::Vector3d::Zero()) {}
+
+  double physics_step;
+  /// \brief  The controller runs every control_period, rounded to a multiple
+  ///         of physics_step, and holds its rotor velocities in between.
+  double control_period;
+  Eigen::Vector3d start_position;
+  /// \brief  Constant wind during the whole flight.
+  Eigen::Vector3d wind_speed_W;
+  std::vector<FastSimDisturbance, Eigen::aligned_allocator<FastSimDisturbance>>
+      disturbances;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+typedef std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d>>
+    FastSimVector3dSeries;
+
+/// \brief  State of the vehicle sampled every control period, like the
+///         ground truth odometry recorded in a bag.
+struct FastSimTrajectory {
+  void clear() {
+    time.clear();
+    position.clear();
+    angular_velocity.clear();
+    on_ground.clear();
+    waypoint_start_time.clear();
+  }
+
+  std::vector<double> time;
+  FastSimVector3dSeries position;
+  /// \brief  In body frame.
+  FastSimVector3dSeries angular_velocity;
+  std::vector<bool> on_ground;
+  /// \brief  Time at which each waypoint was commanded.
+  std::vector<double> waypoint_start_time;
+};
+
+struct FastSimFlightResult {
+  FastSimFlightResult()
+      : sim_time(0.0), wall_time(0.0), rms_position_error(0.0),
+        max_position_error(0.0), final_position_error(0.0), diverged(false) {}
+
+  double real_time_factor() const {
+    return wall_time > 0.0 ? sim_time / wall_time : 0.0;
+  }
+
+  double sim_time;
+  double wall_time;
+  /// \brief  Distance to the active waypoint over the whole flight [m].
+  double rms_position_error;
+  double max_position_error;
+  /// \brief  Distance to the last waypoint at the end of the flight [m].
+  double final_position_error;
+  /// \brief  The state became non-finite, the flight was aborted.
+  bool diverged;
+};
+
+/// \brief  Resets the vehicle to the start position and flies through the
+///         waypoints, commanding each one in turn for its waiting time.
+/// \param[out] trajectory If not null, the sampled state of the flight.
+FastSimFlightResult FlyWaypoints(const FastSimWaypoints& waypoints,
+                                 const FastSimFlightOptions& options,
+                                 FastMultiCopter* multi_copter,
+                                 LeeMotorController* motor_controller,
+                                 FastSimTrajectory* trajectory = nullptr);
+
+#endif // ROTORS_GAZEBO_PLUGINS_FAST_SIM_H
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_FAST_SIM_EVALUATION_H
+#define ROTORS_GAZEBO_PLUGINS_FAST_SIM_EVALUATION_H
+
+#include <Eigen/Eigen>
+
+#include "rotors_gazebo_plugins/fast_sim.h"
+
+// Defaults of rotors_evaluation, see helpers.initialize() and the scripts
+// hovering_eval.py, waypoints_eval.py and disturbance_eval.py.
+static constexpr double kDefaultEvaluationFirstWaypointDelay = 5.0;
+static constexpr double kDefaultEvaluationRmsCalcTime = 10.0;
+static constexpr double kDefaultEvaluationSettlingRadius = 0.1;
+static constexpr double kDefaultEvaluationMinSettledTime = 3.0;
+static constexpr double kDefaultEvaluationSettlingTimeMax = 10.0;
+static constexpr double kDefaultEvaluationPositionErrorMax = 0.2;
+static constexpr double kDefaultEvaluationAngularVelocityErrorMax = 0.2;
+static constexpr double kDefaultEvaluationDisturbanceTime = 40.0;
+
+/// \brief  Evaluation periods and limits, named as in rotors_evaluation.
+struct FastSimEvaluationSettings {
+  FastSimEvaluationSettings()
+      : first_waypoint_evaluation_delay(kDefaultEvaluationFirstWaypointDelay),
+        rms_calc_time(kDefaultEvaluationRmsCalcTime),
+        settling_radius(kDefaultEvaluationSettlingRadius),
+        min_settled_time(kDefaultEvaluationMinSettledTime),
+        settling_time_max(kDefaultEvaluationSettlingTimeMax),
+        position_error_max(kDefaultEvaluationPositionErrorMax),
+        angular_velocity_error_max(kDefaultEvaluationAngularVelocityErrorMax),
+        disturbance_time(kDefaultEvaluationDisturbanceTime) {}
+
+  double first_waypoint_evaluation_delay;
+  double rms_calc_time;
+  double settling_radius;
+  double min_settled_time;
+  double settling_time_max;
+  double position_error_max;
+  double angular_velocity_error_max;
+  double disturbance_time;
+};
+
+/// \brief  Result of one evaluation script on one flight.
+/// \details  As in waypoints_eval.py, a waypoint on which the vehicle does not
+///           settle within settling_time_max counts with 101 % of the maximum
+///           settling time and errors. valid is false if the vehicle touched
+///           the ground during the evaluation, in which case the scripts do
+///           not award points and score is zero.
+struct FastSimEvaluation {
+  FastSimEvaluation()
+      : valid(false), settled(false), settling_time(0.0),
+        position_rms_error(0.0), angular_velocity_rms_error(0.0), score(0.0) {}
+
+  bool valid;
+  bool settled;
+  double settling_time;
+  double position_rms_error;
+  double angular_velocity_rms_error;
+  /// \brief  Sum of the scores the script prints.
+  double score;
+};
+
+/// \brief  Score of a value with respect to its maximum, as get_score() in
+///         rotors_evaluation.
+double EvaluationScore(double value, double max_value, const double (&scores)[4]);
+
+/// \brief  Time after begin_time from which the position stays within radius
+///         of set_point for min_time, over the samples in [begin_time, end_time].
+/// \return False if the vehicle does not settle.
+bool SettlingTime(const FastSimTrajectory& trajectory, double begin_time,
+                  double end_time, const Eigen::Vector3d& set_point,
+                  double radius, double min_time, double* settling_time);
+
+/// \brief  RMS of the distance to set_point of the samples taken in
+///         [begin_time, end_time], e.g. trajectory.position.
+double RmsError(const std::vector<double>& time,
+                const FastSimVector3dSeries& samples, double begin_time,
+                double end_time, const Eigen::Vector3d& set_point);
+
+/// \brief  True if the vehicle stays off the ground in [begin_time, end_time].
+bool NoCollisions(const FastSimTrajectory& trajectory, double begin_time,
+                  double end_time);
+
+/// \brief  hovering_eval.py: errors while holding the first waypoint.
+FastSimEvaluation EvaluateHovering(const FastSimTrajectory& trajectory,
+                                   const FastSimWaypoints& waypoints,
+                                   const FastSimEvaluationSettings& settings);
+
+/// \brief  waypoints_eval.py: settling time and errors averaged over all
+///         waypoints, the settling time of the first one is not considered.
+FastSimEvaluation EvaluateWaypoints(const FastSimTrajectory& trajectory,
+                                    const FastSimWaypoints& waypoints,
+                                    const FastSimEvaluationSettings& settings);
+
+/// \brief  disturbance_eval.py: settling time and errors after a disturbance
+///         at disturbance_time, while holding the first waypoint.
+FastSimEvaluation EvaluateDisturbance(const FastSimTrajectory& trajectory,
+                                      const FastSimWaypoints& waypoints,
+                                      const FastSimEvaluationSettings& settings);
+
+#endif // ROTORS_GAZEBO_PLUGINS_FAST_SIM_EVALUATION_H
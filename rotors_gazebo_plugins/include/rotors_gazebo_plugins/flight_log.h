@@ -0,0 +1,133 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ROTORS_GAZEBO_PLUGINS_FLIGHT_LOG_H
+#define ROTORS_GAZEBO_PLUGINS_FLIGHT_LOG_H
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace gazebo {
+
+static constexpr int kDefaultFlightLogBlockRows = 1024;
+
+/// \brief Magic at the start of a flight log file, followed by the version.
+static const char kFlightLogMagic[8] = {'R', 'O', 'T', 'O', 'R', 'S', 'F', 'L'};
+static constexpr uint32_t kFlightLogVersion = 1;
+
+/// \brief Types of the records following the file header.
+enum FlightLogRecordType : uint32_t {
+  /// \brief Names and types of the columns of a stream.
+  kFlightLogSchemaRecord = 1,
+  /// \brief Rows of a stream, stored column after column.
+  kFlightLogBlockRecord = 2
+};
+
+enum FlightLogCompression : uint32_t {
+  kFlightLogUncompressed = 0,
+  kFlightLogZlib = 1
+};
+
+/// \brief Type of the values of a column, each 8 bytes wide.
+enum FlightLogColumnType : char {
+  kFlightLogInt64 = 'q',
+  kFlightLogFloat64 = 'd'
+};
+
+/// \brief    Header of every record, the payload follows it directly.
+/// \details  All records and payloads are padded to a multiple of 8 bytes,
+///           so the columns of an uncompressed block can be used in place
+///           from a memory-mapped file.
+struct FlightLogRecordHeader {
+  uint32_t type;
+  uint32_t stream_id;
+  uint32_t num_rows;
+  uint32_t compression;
+  /// \brief Size of the payload in the file, without the padding [bytes].
+  uint64_t stored_size;
+  /// \brief Size of the payload after decompression [bytes].
+  uint64_t raw_size;
+};
+
+/// \brief    Writes fixed-schema streams, e.g. the ground truth pose, as
+///           append-only blocks of typed columns.
+/// \details  Every stream starts with a nanosecond time stamp column
+///           ("stamp_ns") followed by its float64 columns. Rows are buffered
+///           per stream and written as one block, optionally zlib
+///           compressed, every block_rows rows and on Close(). Unlike a bag,
+///           there is no per-message connection header or index entry, and
+///           rotors_evaluation reads a block as one array per column. Append
+///           and AddStream may be called from several threads.
+class FlightLogWriter {
+ public:
+  FlightLogWriter();
+  ~FlightLogWriter();
+
+  /// \brief Create the file and write its header.
+  /// \return False if the file could not be created.
+  bool Open(const std::string& filename, FlightLogCompression compression,
+            int block_rows);
+
+  /// \brief Flush all buffered rows and close the file.
+  void Close();
+
+  bool IsOpen() const { return file_ != nullptr; }
+
+  /// \brief Define a stream and write its schema.
+  /// \param[in] name Name of the stream, the bag plugin uses the topic.
+  /// \param[in] columns Names of the float64 columns after the time stamp.
+  /// \return Id of the stream, passed to Append().
+  int AddStream(const std::string& name,
+                const std::vector<std::string>& columns);
+
+  /// \brief Buffer a row, num_values must match the columns of the stream.
+  void Append(int stream_id, int64_t stamp_ns, const double* values,
+              size_t num_values);
+
+ private:
+  struct Stream {
+    size_t num_columns;
+    size_t num_rows;
+    std::vector<int64_t> stamps;
+    /// \brief Buffered rows, column after column, block_rows_ per column.
+    std::vector<double> values;
+  };
+
+  void FlushStream(uint32_t stream_id);
+  void WriteRecord(uint32_t type, uint32_t stream_id, uint32_t num_rows,
+                   const uint8_t* payload, size_t size);
+
+  std::mutex mutex_;
+  std::FILE* file_;
+  FlightLogCompression compression_;
+  size_t block_rows_;
+  std::vector<Stream> streams_;
+  /// \brief Scratch buffers for building and compressing a block.
+  std::vector<uint8_t> block_buffer_;
+  std::vector<uint8_t> compressed_buffer_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_FLIGHT_LOG_H
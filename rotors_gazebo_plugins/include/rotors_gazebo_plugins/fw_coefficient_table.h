@@ -0,0 +1,266 @@
+/*
+ * Copyright 2017 Pavel Vechersky, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_FW_COEFFICIENT_TABLE_H_
+#define ROTORS_GAZEBO_PLUGINS_FW_COEFFICIENT_TABLE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#include "rotors_gazebo_plugins/fw_parameters.h"
+
+namespace gazebo {
+
+// Default values
+static constexpr int kDefaultCoefficientTableSamples = 256;
+
+/// \brief  Piecewise linear lookup of a number of values (channels) sampled
+///         on a uniform grid, clamped to the range of the grid.
+class LookupTable1D {
+ public:
+  LookupTable1D()
+      : x_min_(0.0),
+        x_max_(0.0),
+        inv_step_(0.0),
+        num_samples_(0),
+        num_channels_(0) {}
+
+  /// \brief  Samples f(x, double* values) at num_samples points in
+  ///         [x_min, x_max], f has to write num_channels values.
+  template <typename Function>
+  void Build(double x_min, double x_max, int num_samples, int num_channels,
+             Function f) {
+    num_samples = std::max(num_samples, 2);
+    x_min_ = x_min;
+    x_max_ = x_max;
+    inv_step_ = (x_max > x_min) ? (num_samples - 1) / (x_max - x_min) : 0.0;
+    num_samples_ = num_samples;
+    num_channels_ = num_channels;
+    values_.resize(num_samples * num_channels);
+    for (int i = 0; i < num_samples; ++i) {
+      const double x = x_min + (x_max - x_min) * i / (num_samples - 1);
+      f(x, &values_[i * num_channels]);
+    }
+  }
+
+  double Clamp(double x) const {
+    return std::min(std::max(x, x_min_), x_max_);
+  }
+
+  /// \brief  Writes the interpolated values at x to values.
+  void Lookup(double x, double* values) const {
+    const double s = (Clamp(x) - x_min_) * inv_step_;
+    const int i = std::min(static_cast<int>(s), num_samples_ - 2);
+    const double t = s - i;
+    const double* a = &values_[i * num_channels_];
+    const double* b = a + num_channels_;
+    for (int c = 0; c < num_channels_; ++c) {
+      values[c] = a[c] + t * (b[c] - a[c]);
+    }
+  }
+
+  bool empty() const { return values_.empty(); }
+  double x_min() const { return x_min_; }
+  double x_max() const { return x_max_; }
+
+ private:
+  double x_min_;
+  double x_max_;
+  double inv_step_;
+  int num_samples_;
+  int num_channels_;
+  /// \brief  Sample-major, all channels of a sample are adjacent.
+  std::vector<double> values_;
+};
+
+/// \brief  Linear interpolation in tabulated data with ascending breakpoints,
+///         clamped to the first and last value.
+inline double InterpolateBreakpoints(const std::vector<double>& breakpoints,
+                                     const std::vector<double>& values,
+                                     double x) {
+  if (x <= breakpoints.front())
+    return values.front();
+  if (x >= breakpoints.back())
+    return values.back();
+  const size_t i = std::upper_bound(breakpoints.begin(), breakpoints.end(), x) -
+      breakpoints.begin();
+  const double t = (x - breakpoints[i - 1]) /
+      (breakpoints[i] - breakpoints[i - 1]);
+  return values[i - 1] + t * (values[i] - values[i - 1]);
+}
+
+/// \brief  Precomputed aerodynamic coefficients of a fixed-wing.
+/// \details  The model of FWAerodynamicParameters is a sum of terms which
+///           each depend on a single variable, so each nonlinear term is
+///           tabulated over its variable: alpha, beta and the combined
+///           aileron and flap deflections. The alpha and beta tables also
+///           hold the sine and cosine used for the wind frame rotation.
+///           Instead of the polynomials, the alpha and beta tables can be
+///           built from tabulated (e.g. wind-tunnel) data, which may extend
+///           beyond the stall angle.
+struct FWCoefficientTable {
+  enum AlphaChannel {
+    kAlphaDrag,
+    kAlphaLift,
+    kAlphaPitchMoment,
+    kAlphaCos,
+    kAlphaSin,
+    kNumAlphaChannels
+  };
+
+  enum BetaChannel {
+    kBetaDrag,
+    kBetaSideForce,
+    kBetaRollMoment,
+    kBetaYawMoment,
+    kNumBetaChannels
+  };
+
+  enum DeflectionChannel {
+    kDeflectionDrag,
+    kDeflectionLift,
+    kNumDeflectionChannels
+  };
+
+  LookupTable1D alpha;
+  LookupTable1D beta;
+  LookupTable1D aileron_sum;
+  LookupTable1D flap_sum;
+
+  /// \brief  Tabulates the polynomial coefficients of aero within the alpha
+  ///         bounds, the full beta range and the deflection limits.
+  void Build(const FWAerodynamicParameters& aero,
+             const FWVehicleParameters& vehicle, int num_samples) {
+    alpha.Build(aero.alpha_min, aero.alpha_max, num_samples, kNumAlphaChannels,
+                [&aero](double a, double* c) {
+      c[kAlphaDrag] = aero.c_drag_alpha.dot(Eigen::Vector3d(1.0, a, a * a));
+      c[kAlphaLift] = aero.c_lift_alpha.dot(
+          Eigen::Vector4d(1.0, a, a * a, a * a * a));
+      c[kAlphaPitchMoment] = aero.c_pitch_moment_alpha.dot(
+          Eigen::Vector2d(1.0, a));
+      c[kAlphaCos] = cos(a);
+      c[kAlphaSin] = sin(a);
+    });
+
+    beta.Build(-M_PI_2, M_PI_2, num_samples, kNumBetaChannels,
+               [&aero](double b, double* c) {
+      c[kBetaDrag] = aero.c_drag_beta.dot(Eigen::Vector3d(0.0, b, b * b));
+      c[kBetaSideForce] = aero.c_side_force_beta.dot(Eigen::Vector2d(0.0, b));
+      c[kBetaRollMoment] = aero.c_roll_moment_beta.dot(
+          Eigen::Vector2d(0.0, b));
+      c[kBetaYawMoment] = aero.c_yaw_moment_beta.dot(Eigen::Vector2d(0.0, b));
+    });
+
+    aileron_sum.Build(
+        vehicle.aileron_left.deflection_min +
+            vehicle.aileron_right.deflection_min,
+        vehicle.aileron_left.deflection_max +
+            vehicle.aileron_right.deflection_max,
+        num_samples, kNumDeflectionChannels, [&aero](double d, double* c) {
+      c[kDeflectionDrag] = aero.c_drag_delta_ail.dot(
+          Eigen::Vector3d(0.0, d, d * d));
+      c[kDeflectionLift] = aero.c_lift_delta_ail.dot(Eigen::Vector2d(0.0, d));
+    });
+
+    flap_sum.Build(
+        2.0 * vehicle.flap.deflection_min, 2.0 * vehicle.flap.deflection_max,
+        num_samples, kNumDeflectionChannels, [&aero](double d, double* c) {
+      c[kDeflectionDrag] = aero.c_drag_delta_flp.dot(
+          Eigen::Vector3d(0.0, d, d * d));
+      c[kDeflectionLift] = aero.c_lift_delta_flp.dot(Eigen::Vector2d(0.0, d));
+    });
+  }
+
+  /// \brief  Replaces the alpha and/or beta table by the tabulated data in a
+  ///         YAML file, resampled to num_samples uniform samples, e.g.:
+  ///           alpha:
+  ///             breakpoints: [-0.3, 0.0, 0.3, 0.5]
+  ///             c_drag: [...]
+  ///             c_lift: [...]
+  ///             c_pitch_moment: [...]
+  ///           beta:
+  ///             breakpoints: [...]
+  ///             c_drag: [...]
+  ///             c_side_force: [...]
+  ///             c_roll_moment: [...]
+  ///             c_yaw_moment: [...]
+  ///         Angles in rad, breakpoints ascending. Lookups are clamped to the
+  ///         first and last breakpoint.
+  void LoadTableYAML(const std::string& yaml_path, int num_samples) {
+    const YAML::Node node = YAML::LoadFile(yaml_path);
+
+    if (node["alpha"]) {
+      const YAML::Node alpha_node = node["alpha"];
+      const std::vector<double> x = ReadTableRow(alpha_node, "breakpoints");
+      const std::vector<double> drag = ReadTableRow(alpha_node, "c_drag", x);
+      const std::vector<double> lift = ReadTableRow(alpha_node, "c_lift", x);
+      const std::vector<double> pitch =
+          ReadTableRow(alpha_node, "c_pitch_moment", x);
+      alpha.Build(x.front(), x.back(), num_samples, kNumAlphaChannels,
+                  [&](double a, double* c) {
+        c[kAlphaDrag] = InterpolateBreakpoints(x, drag, a);
+        c[kAlphaLift] = InterpolateBreakpoints(x, lift, a);
+        c[kAlphaPitchMoment] = InterpolateBreakpoints(x, pitch, a);
+        c[kAlphaCos] = cos(a);
+        c[kAlphaSin] = sin(a);
+      });
+    }
+
+    if (node["beta"]) {
+      const YAML::Node beta_node = node["beta"];
+      const std::vector<double> x = ReadTableRow(beta_node, "breakpoints");
+      const std::vector<double> drag = ReadTableRow(beta_node, "c_drag", x);
+      const std::vector<double> side =
+          ReadTableRow(beta_node, "c_side_force", x);
+      const std::vector<double> roll =
+          ReadTableRow(beta_node, "c_roll_moment", x);
+      const std::vector<double> yaw =
+          ReadTableRow(beta_node, "c_yaw_moment", x);
+      beta.Build(x.front(), x.back(), num_samples, kNumBetaChannels,
+                 [&](double b, double* c) {
+        c[kBetaDrag] = InterpolateBreakpoints(x, drag, b);
+        c[kBetaSideForce] = InterpolateBreakpoints(x, side, b);
+        c[kBetaRollMoment] = InterpolateBreakpoints(x, roll, b);
+        c[kBetaYawMoment] = InterpolateBreakpoints(x, yaw, b);
+      });
+    }
+  }
+
+ private:
+  /// \brief  Reads a row of a table, which has to have as many values as
+  ///         breakpoints (at least two breakpoints).
+  static std::vector<double> ReadTableRow(
+      const YAML::Node& node, const std::string& name,
+      const std::vector<double>& breakpoints = std::vector<double>()) {
+    std::vector<double> row = node[name].as<std::vector<double>>();
+    const size_t expected_size =
+        breakpoints.empty() ? std::max<size_t>(row.size(), 2) :
+                              breakpoints.size();
+    if (row.size() != expected_size) {
+      throw YAML::Exception(node.Mark(), "Coefficient table row \"" + name +
+                            "\" has the wrong number of values.");
+    }
+    return row;
+  }
+};
+
+}
+
+#endif /* ROTORS_GAZEBO_PLUGINS_FW_COEFFICIENT_TABLE_H_ */
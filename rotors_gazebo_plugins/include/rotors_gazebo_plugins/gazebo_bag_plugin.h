@@ -23,8 +23,15 @@
 #ifndef ROTORS_GAZEBO_PLUGINS_GAZEBO_BAG_PLUGIN_H
 #define ROTORS_GAZEBO_PLUGINS_GAZEBO_BAG_PLUGIN_H
 
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include <boost/make_shared.hpp>
 #include <gazebo/common/common.hh>
 #include <gazebo/common/Plugin.hh>
 #include <gazebo/gazebo.hh>
@@ -37,15 +44,20 @@
 #include <mav_msgs/AttitudeThrust.h>
 #include <mav_msgs/default_topics.h>
 #include <mav_msgs/RateThrust.h>
+#include <nav_msgs/Odometry.h>
 #include <ros/ros.h>
 #include <rosbag/bag.h>
 #include <sensor_msgs/Imu.h>
 #include <std_msgs/Float32.h>
+#include <std_srvs/Trigger.h>
 #include <trajectory_msgs/MultiDOFJointTrajectory.h>
 
 #include "rotors_comm/RecordRosbag.h"
 #include "rotors_comm/WindSpeed.h"
+#include "rotors_gazebo_plugins/black_box_recorder.h"
 #include "rotors_gazebo_plugins/common.h"
+#include "rotors_gazebo_plugins/flight_log.h"
+#include "rotors_gazebo_plugins/mpsc_queue.h"
 
 
 namespace gazebo {
@@ -57,6 +69,138 @@ static const std::string kDefaultBagFilename_ = "simulator.bag";
 static const std::string kDefaultRecordingServiceName = "record_rosbag";
 static constexpr bool kDefaultWaitToRecord = false;
 static constexpr bool kDefaultIsRecording = false;
+static constexpr bool kDefaultAsyncRecording = false;
+static constexpr int kDefaultBagQueueSize = 4096;
+static constexpr int kDefaultBagWriteBatchSize = 256;
+static constexpr int kDefaultBagChunkSize = 768 * 1024;
+static const std::string kDefaultBagCompression = "none";
+static constexpr int kDefaultBagStreamDecimation = 1;
+static constexpr double kDefaultBagStreamRate = 0.0;
+static constexpr double kDefaultBagStreamStartTime = 0.0;
+static constexpr double kDefaultBagStreamEndTime = -1.0;
+static constexpr bool kDefaultFlightLog = false;
+static const std::string kDefaultFlightLogCompression = "none";
+static constexpr bool kDefaultBlackBox = false;
+static constexpr double kDefaultBlackBoxDuration = 30.0;  // [s]
+static constexpr int kDefaultBlackBoxSize = 64 * 1024 * 1024;  // [bytes]
+static const std::string kDefaultBlackBoxServiceName = "flush_black_box";
+static constexpr double kDefaultBlackBoxCollisionForce = 0.0;  // [N]
+static constexpr double kDefaultBlackBoxMaxPositionError = 0.0;  // [m]
+
+/// \brief  Time the bag writer thread sleeps when its queue is empty [s].
+static constexpr double kBagWriterPeriod = 0.01;
+/// \brief  Minimum wall time between two warnings about dropped messages [s].
+static constexpr double kBagDropReportInterval = 1.0;
+
+/// \brief  Writes msg to the bag and reports failures, either for a message
+///         or for a shared pointer to one.
+template <class M>
+void WriteToBag(rosbag::Bag* bag, const std::string& topic,
+                const ros::Time& time, const M& msg) {
+  try {
+    bag->write(topic, time, msg);
+  }
+  catch (rosbag::BagIOException& e) {
+    gzerr << "Error while writing to bag " << e.what() << std::endl;
+  }
+  catch (rosbag::BagException& e) {
+    if (time < ros::TIME_MIN) {
+      gzerr << "Header stamp not set for msg published on topic: " << topic
+            << ". " << e.what() << std::endl;
+    }
+    else {
+      gzerr << "Error while writing to bag " << e.what() << std::endl;
+    }
+  }
+}
+
+/// \brief  A message waiting in the queue of the bag writer thread.
+class BagMessage {
+ public:
+  BagMessage(const std::string& topic, const ros::Time& time)
+      : topic_(topic), time_(time) {}
+  virtual ~BagMessage() {}
+
+  virtual void Write(rosbag::Bag* bag) const = 0;
+
+ protected:
+  std::string topic_;
+  ros::Time time_;
+};
+
+template <class T>
+class TypedBagMessage : public BagMessage {
+ public:
+  TypedBagMessage(const std::string& topic, const ros::Time& time,
+                  const boost::shared_ptr<T const>& msg)
+      : BagMessage(topic, time), msg_(msg) {}
+
+  void Write(rosbag::Bag* bag) const {
+    WriteToBag(bag, topic_, time_, msg_);
+  }
+
+ private:
+  boost::shared_ptr<T const> msg_;
+};
+
+/// \brief    Recording settings of one stream of the bag, e.g. the IMU
+///           messages or the ground truth pose.
+/// \details  Only the messages stamped inside [start_time, end_time] are
+///           recorded (an end_time < 0 leaves the window open), of these only
+///           every decimation-th one, and no two closer than min_period.
+///           Streams with a fixed schema go to the flight log instead of the
+///           bag if it is enabled, log_stream is then their id in it.
+class BagStream {
+ public:
+  BagStream()
+      : enabled(true),
+        decimation(kDefaultBagStreamDecimation),
+        min_period(0.0),
+        start_time(kDefaultBagStreamStartTime),
+        end_time(kDefaultBagStreamEndTime),
+        log_stream(-1),
+        num_in_window_(0),
+        last_write_time_(0.0) {}
+
+  /// \brief  Decides whether the message of this stream at time [s] should
+  ///         be written, and accounts for it.
+  bool ShouldWrite(double time) {
+    if (!enabled || time < start_time || (end_time >= 0.0 && time > end_time)) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (num_in_window_++ % decimation != 0) {
+      return false;
+    }
+    if (min_period > 0.0 && num_in_window_ > 1 &&
+        time - last_write_time_ < min_period) {
+      return false;
+    }
+    last_write_time_ = time;
+    return true;
+  }
+
+  /// \brief  Restarts the decimation, called when a recording starts.
+  void Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    num_in_window_ = 0;
+    last_write_time_ = 0.0;
+  }
+
+  /// \brief  Topic in the bag, including the namespace.
+  std::string topic;
+  bool enabled;
+  int decimation;
+  double min_period;
+  double start_time;
+  double end_time;
+  int log_stream;
+
+ private:
+  std::mutex mutex_;
+  uint64_t num_in_window_;
+  double last_write_time_;
+};
 
 /// \brief    This plugin is used to create rosbag files from within gazebo.
 /// \details  This plugin is ROS dependent, and is not built if NO_ROS=TRUE is provided to
@@ -89,6 +233,24 @@ class GazeboBagPlugin : public ModelPlugin {
         rotor_velocity_slowdown_sim_(kDefaultRotorVelocitySlowdownSim),
         wait_to_record_(kDefaultWaitToRecord),
         is_recording_(kDefaultIsRecording),
+        async_recording_(kDefaultAsyncRecording),
+        bag_queue_size_(kDefaultBagQueueSize),
+        bag_write_batch_size_(kDefaultBagWriteBatchSize),
+        bag_chunk_size_(kDefaultBagChunkSize),
+        bag_compression_(rosbag::compression::Uncompressed),
+        flight_log_enabled_(kDefaultFlightLog),
+        flight_log_compression_(kFlightLogUncompressed),
+        flight_log_block_rows_(kDefaultFlightLogBlockRows),
+        black_box_enabled_(kDefaultBlackBox),
+        black_box_duration_(kDefaultBlackBoxDuration),
+        black_box_size_(kDefaultBlackBoxSize),
+        black_box_service_name_(kDefaultBlackBoxServiceName),
+        black_box_collision_force_(kDefaultBlackBoxCollisionForce),
+        black_box_max_position_error_(kDefaultBlackBoxMaxPositionError),
+        last_black_box_trigger_(-1.0),
+        stop_bag_writer_(false),
+        num_bag_messages_dropped_(0),
+        num_bag_messages_written_(0),
         node_handle_(nullptr),
         contact_mgr_(nullptr) {}
 
@@ -154,12 +316,68 @@ class GazeboBagPlugin : public ModelPlugin {
   /// \param[in] now The current gazebo common::Time
   void LogWrenches(const common::Time now);
 
+  /// \brief Open the flight log next to the bag and define its streams.
+  /// \param[in] base_filename File name without the extension.
+  void StartFlightLog(const std::string& base_filename);
+
+  /// \brief Read the settings of a stream from the <name>Stream element and
+  ///        set its bag topic.
+  /// \param[in] _sdf SDF element of the plugin.
+  /// \param[in] name Name of the stream, e.g. imu.
+  /// \param[in] topic Topic of the stream, without the namespace.
+  /// \param[out] stream The stream to configure.
+  void LoadBagStream(sdf::ElementPtr _sdf, const std::string& name,
+                     const std::string& topic, BagStream* stream);
+
+  /// \brief Called when an odometry estimate to compare with the ground
+  ///        truth is received.
+  /// \param[in] odometry_msg An Odometry message from nav_msgs, in the world
+  ///            frame.
+  void EstimateCallback(const nav_msgs::OdometryConstPtr& odometry_msg);
+
+  /// \brief Flush the black box if a contact is stronger than the collision
+  ///        threshold.
+  /// \param[in] now The current gazebo common::Time
+  void CheckCollisions(const common::Time now);
+
+  /// \brief Write the black box to a new bag.
+  /// \param[in] reason What triggered the flush, part of the file name.
+  /// \param[in] automatic Whether a threshold triggered the flush, these are
+  ///            ignored for a black box duration after the last one.
+  /// \param[out] filename Name of the bag, if not null.
+  /// \return Whether the flush was started.
+  bool FlushBlackBox(const std::string& reason, bool automatic,
+                     std::string* filename);
+
+  /// \brief Called when a request to flush the black box is received.
+  bool BlackBoxServiceCallback(std_srvs::Trigger::Request& req,
+                               std_srvs::Trigger::Response& res);
+
   /// \brief Called when a request to start or stop recording is received.
   /// \param[in] req The request to start or stop recording.
   /// \param[out] res The response to be sent back to the client.
   bool RecordingServiceCallback(rotors_comm::RecordRosbag::Request& req,
                                 rotors_comm::RecordRosbag::Response& res);
 
+  /// \brief Start the thread draining the bag queue in asynchronous mode.
+  void StartBagWriter();
+
+  /// \brief Write everything still queued and join the bag writer thread.
+  void StopBagWriter();
+
+  /// \brief Main loop of the bag writer thread.
+  void BagWriterThread();
+
+  /// \brief Write a batch of queued messages to the bag and free them.
+  void WriteBagBatch(std::vector<BagMessage*>* batch);
+
+  /// \brief Free the messages left in the queue and count them as dropped.
+  void ClearBagQueue();
+
+  /// \brief Hand a message to the bag writer thread, or drop it if the queue
+  ///        is full. Takes ownership of msg.
+  void EnqueueBagMessage(BagMessage* msg);
+
  private:
   /// \brief Pointer to the update event connection.
   event::ConnectionPtr update_connection_;
@@ -195,6 +413,20 @@ class GazeboBagPlugin : public ModelPlugin {
   std::string recording_service_name_;
   double rotor_velocity_slowdown_sim_;
 
+  // Bag streams, one per recorded topic
+  BagStream imu_stream_;
+  BagStream external_force_stream_;
+  BagStream waypoint_stream_;
+  BagStream command_pose_stream_;
+  BagStream control_attitude_thrust_stream_;
+  BagStream control_motor_speed_stream_;
+  BagStream control_rate_thrust_stream_;
+  BagStream wind_speed_stream_;
+  BagStream motor_stream_;
+  BagStream ground_truth_pose_stream_;
+  BagStream ground_truth_twist_stream_;
+  BagStream wrench_stream_;
+
   /// \brief Mutex lock for thread safety of writing bag files
   boost::mutex mtx_;
 
@@ -204,6 +436,54 @@ class GazeboBagPlugin : public ModelPlugin {
   /// \brief Whether the plugin is currenly recording a rosbag
   bool is_recording_;
 
+  /// \brief Whether the callbacks only queue the messages, and a separate
+  ///        thread writes them to the bag.
+  bool async_recording_;
+  int bag_queue_size_;
+  int bag_write_batch_size_;
+  int bag_chunk_size_;
+  rosbag::compression::CompressionType bag_compression_;
+
+  /// \brief Whether the ground truth, IMU, motor and wrench streams are
+  ///        written to a columnar flight log instead of the bag.
+  bool flight_log_enabled_;
+  FlightLogCompression flight_log_compression_;
+  int flight_log_block_rows_;
+  FlightLogWriter flight_log_;
+
+  /// \brief Whether all streams are kept in an in-memory ring of the last
+  ///        black_box_duration_ seconds instead of being written, and only
+  ///        go to disk once the black box is flushed.
+  bool black_box_enabled_;
+  double black_box_duration_;
+  int black_box_size_;
+  std::string black_box_service_name_;
+  /// \brief Contact force flushing the black box [N], 0 disables it.
+  double black_box_collision_force_;
+  /// \brief Topic of an odometry estimate, empty disables its check.
+  std::string black_box_estimate_topic_;
+  /// \brief Distance between the estimate and the ground truth position
+  ///        flushing the black box [m], 0 disables it.
+  double black_box_max_position_error_;
+  std::unique_ptr<BlackBoxRecorder> black_box_;
+  /// \brief Guards the ground truth position and the last trigger time.
+  std::mutex black_box_mutex_;
+  ignition::math::Vector3d ground_truth_position_;
+  /// \brief Simulation time of the last automatic flush [s].
+  double last_black_box_trigger_;
+
+  /// \brief Messages waiting for the bag writer thread.
+  std::unique_ptr<MpscQueue<BagMessage*>> bag_queue_;
+  std::thread bag_writer_thread_;
+  std::mutex bag_writer_mutex_;
+  std::condition_variable bag_writer_condition_;
+  bool stop_bag_writer_;
+
+  /// \brief Messages lost because the bag queue was full.
+  std::atomic<uint64_t> num_bag_messages_dropped_;
+  /// \brief Messages written by the bag writer thread.
+  std::atomic<uint64_t> num_bag_messages_written_;
+
   rosbag::Bag bag_;
   ros::NodeHandle *node_handle_;
 
@@ -216,48 +496,41 @@ class GazeboBagPlugin : public ModelPlugin {
   ros::Subscriber control_rate_thrust_sub_;
   ros::Subscriber wind_speed_sub_;
   ros::Subscriber command_pose_sub_;
+  ros::Subscriber estimate_sub_;
 
   // Ros service server
   ros::ServiceServer recording_service_;
+  ros::ServiceServer black_box_service_;
 
   std::ofstream csvOut;
 
   template<class T>
   void writeBag(const std::string& topic, const ros::Time& time, const T& msg) {
-    boost::mutex::scoped_lock lock(mtx_);
-    try {
-      bag_.write(topic, time, msg);
-    }
-    catch (rosbag::BagIOException& e) {
-      gzerr << "Error while writing to bag " << e.what() << std::endl;
+    if (black_box_) {
+      black_box_->Add(topic, time, msg);
+      return;
     }
-    catch (rosbag::BagException& e) {
-      if (time < ros::TIME_MIN) {
-        gzerr<<"Header stamp not set for msg published on topic: "<< topic << ". " << e.what() << std::endl;
-      }
-      else {
-        gzerr << "Error while writing to bag " << e.what() << std::endl;
-      }
+    if (async_recording_) {
+      EnqueueBagMessage(
+          new TypedBagMessage<T>(topic, time, boost::make_shared<T>(msg)));
+      return;
     }
+    boost::mutex::scoped_lock lock(mtx_);
+    WriteToBag(&bag_, topic, time, msg);
   }
 
   template<class T>
   void writeBag(const std::string& topic, const ros::Time& time, boost::shared_ptr<T const> const& msg) {
-    boost::mutex::scoped_lock lock(mtx_);
-    try {
-      bag_.write(topic, time, msg);
+    if (black_box_) {
+      black_box_->Add(topic, time, msg);
+      return;
     }
-    catch (rosbag::BagIOException& e) {
-      gzerr << "Error while writing to bag " << e.what() << std::endl;
-    }
-    catch (rosbag::BagException& e) {
-      if (time < ros::TIME_MIN) {
-        gzerr<<"Header stamp not set for msg published on topic: "<< topic << ". " << e.what() << std::endl;
-      }
-      else {
-        gzerr << "Error while writing to bag " << e.what() << std::endl;
-      }
+    if (async_recording_) {
+      EnqueueBagMessage(new TypedBagMessage<T>(topic, time, msg));
+      return;
     }
+    boost::mutex::scoped_lock lock(mtx_);
+    WriteToBag(&bag_, topic, time, msg);
   }
 
 };
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_GAZEBO_CHECKPOINT_PLUGIN_H
+#define ROTORS_GAZEBO_PLUGINS_GAZEBO_CHECKPOINT_PLUGIN_H
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <gazebo/common/common.hh>
+#include <gazebo/common/Plugin.hh>
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+
+#include "rotors_gazebo_plugins/common.h"
+#include "rotors_gazebo_plugins/simulation_checkpoint.h"
+
+namespace gazebo {
+
+// Default values
+static const std::string kDefaultCheckpointTopic = "checkpoint";
+static const std::string kDefaultCheckpointResultTopic = "checkpoint_result";
+static constexpr double kDefaultCheckpointSaveTime = -1.0;  // [s]
+
+/// \brief    Saves and restores checkpoints of the world, see
+///           SimulationCheckpoint.
+/// \details  Requests are strings "save <path>" or "restore <path>" on the
+///           Gazebo topic ~/checkpointTopic, and the outcome is published on
+///           ~/checkpointResultTopic as "<ok|error> <request>". A request is
+///           handled at the end of the next world update, after all plugins
+///           have run, or right away while the world is paused.
+///
+///           With restoreFile set, the checkpoint is restored at the end of
+///           the first world update, so that many runs can be forked from one
+///           saved state. With saveFile and saveTime set, a checkpoint is
+///           saved once the simulation time reaches saveTime.
+class GazeboCheckpointPlugin : public WorldPlugin {
+ public:
+  GazeboCheckpointPlugin()
+      : WorldPlugin(), save_time_(kDefaultCheckpointSaveTime) {}
+
+  virtual ~GazeboCheckpointPlugin() {}
+
+ protected:
+  /// \brief Load the plugin.
+  /// \param[in] _world Pointer to the world that loaded this plugin.
+  /// \param[in] _sdf SDF element that describes the plugin.
+  void Load(physics::WorldPtr _world, sdf::ElementPtr _sdf);
+
+ private:
+  struct Request {
+    bool save;
+    std::string path;
+  };
+
+  void OnRequest(ConstGzStringPtr& msg);
+
+  /// \brief  Queues a request for the end of the next world update.
+  void QueueRequest(const Request& request);
+
+  /// \brief  Handles the queued requests and the timed save.
+  void OnWorldUpdateEnd();
+
+  void HandleRequest(const Request& request);
+
+  physics::WorldPtr world_;
+  std::shared_ptr<SimulationCheckpoint> checkpoint_;
+
+  transport::NodePtr node_handle_;
+  transport::SubscriberPtr request_sub_;
+  transport::PublisherPtr result_pub_;
+
+  /// \brief  Connected on the first request, after the model plugins, so
+  ///         that the requests are handled after their updates.
+  event::ConnectionPtr update_end_connection_;
+
+  std::mutex request_mutex_;
+  std::deque<Request> requests_;
+
+  std::string save_file_;
+  double save_time_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_GAZEBO_CHECKPOINT_PLUGIN_H
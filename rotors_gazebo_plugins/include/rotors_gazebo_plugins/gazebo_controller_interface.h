@@ -23,6 +23,11 @@
 #ifndef ROTORS_GAZEBO_PLUGINS_CONTROLLER_INTERFACE_H
 #define ROTORS_GAZEBO_PLUGINS_CONTROLLER_INTERFACE_H
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
 #include <boost/bind.hpp>
 #include <Eigen/Eigen>
 #include <stdio.h>
@@ -34,8 +39,20 @@
 #include <mav_msgs/default_topics.h>  // This comes from the mav_comm repo
 
 #include "Actuators.pb.h"
+#include "RollPitchYawrateThrust.pb.h"
+
+#ifdef ROTORS_EMBEDDED_CONTROLLER
+#include <rotors_control/controller_factory.h>
+#endif
 
+#include "rotors_gazebo_plugins/command_mailbox.h"
 #include "rotors_gazebo_plugins/common.h"
+#include "rotors_gazebo_plugins/control_loop_monitor.h"
+#include "rotors_gazebo_plugins/rigid_body_state.h"
+#include "rotors_gazebo_plugins/ros_bridge_connector.h"
+#include "rotors_gazebo_plugins/shm_records.h"
+#include "rotors_gazebo_plugins/shm_ring.h"
+#include "rotors_gazebo_plugins/update_dispatcher.h"
 
 namespace gazebo {
 
@@ -45,6 +62,11 @@ namespace gazebo {
 static const std::string kDefaultMotorVelocityReferenceTopic = "gazebo/command/motor_speed";
 
 typedef const boost::shared_ptr<const gz_sensor_msgs::Actuators> GzActuatorsMsgPtr;
+typedef const boost::shared_ptr<const gz_mav_msgs::RollPitchYawrateThrust>
+    GzRollPitchYawrateThrustMsgPtr;
+
+/// \brief    Number of physics steps per run of an embedded controller.
+static constexpr int kDefaultControllerUpdateDivisor = 1;
 
 class GazeboControllerInterface : public ModelPlugin {
  public:
@@ -56,7 +78,12 @@ class GazeboControllerInterface : public ModelPlugin {
         // DEFAULT TOPICS
         motor_velocity_reference_pub_topic_(kDefaultMotorVelocityReferenceTopic),
         command_motor_speed_sub_topic_(mav_msgs::default_topics::COMMAND_ACTUATORS),
+        command_attitude_thrust_sub_topic_(
+            mav_msgs::default_topics::COMMAND_ROLL_PITCH_YAWRATE_THRUST),
         //---------------
+        controller_update_divisor_(kDefaultControllerUpdateDivisor),
+        update_counter_(0),
+        shm_transport_(kDefaultShmTransport),
         node_handle_(NULL){}
   ~GazeboControllerInterface();
 
@@ -70,8 +97,9 @@ class GazeboControllerInterface : public ModelPlugin {
  private:
 
   /// \brief    Gets set to true the first time a motor command is received.
-  /// \details  OnUpdate() will not do anything until this is true.
-  bool received_first_reference_;
+  /// \details  OnUpdate() will not do anything until this is true. Also set
+  ///           by the transport thread if an embedded controller is used.
+  std::atomic<bool> received_first_reference_;
 
   /// \brief    Flag that is set to true once CreatePubsAndSubs() is called, used
   ///           to prevent CreatePubsAndSubs() from be called on every OnUpdate().
@@ -83,31 +111,79 @@ class GazeboControllerInterface : public ModelPlugin {
   ///           has loaded and listening to ConnectGazeboToRosTopic and ConnectRosToGazeboTopic messages).
   void CreatePubsAndSubs();
 
-  /// \details  This gets populated (including resizing if needed) when CommandMotorCallback() is
-  ///           called.
+  /// \details  This gets populated (including resizing if needed) from the
+  ///           newest command of command_mailbox_ at the start of OnUpdate().
   Eigen::VectorXd input_reference_;
 
+  /// \brief    Newest motor command, posted by CommandMotorCallback() on the
+  ///           transport thread.
+  CommandMailbox<kShmMaxRotors> command_mailbox_;
+  MailboxCommand<kShmMaxRotors> mailbox_command_;
+
   //===== VARIABLES READ FROM SDF FILE =====//
   std::string namespace_;
   std::string motor_velocity_reference_pub_topic_;
   std::string command_motor_speed_sub_topic_;
-
+  std::string command_attitude_thrust_sub_topic_;
+
+  /// \brief    Name of a controller registered with the ControllerFactory of
+  ///           rotors_control, empty to relay the motor commands.
+  /// \details  An embedded controller runs inside the physics update on the
+  ///           state of the link given by linkName, every
+  ///           controller_update_divisor_ physics steps. Only its references
+  ///           arrive over the transport, the control loop itself does not
+  ///           wait for any message.
+  std::string controller_name_;
+  int controller_update_divisor_;
+  uint64_t update_counter_;
+#ifdef ROTORS_EMBEDDED_CONTROLLER
+  std::shared_ptr<rotors_control::ControllerBase> controller_;
+#endif
+  std::shared_ptr<RigidBodyStateCache> link_state_;
+
+  /// \brief    Guards the references of the embedded controller, which are
+  ///           set from the transport callbacks.
+  std::mutex controller_mutex_;
+
+  /// \brief    Runs the embedded controller on the current state of the link
+  ///           and stores its rotor velocities in input_reference_.
+  void UpdateController();
+
+  /// \brief    Write the motor commands to a shared memory ring read by the
+  ///           motor models instead of publishing them.
+  bool shm_transport_;
+  ShmRingWriter<ShmRotorVelocitiesRecord> command_shm_;
+  ShmRotorVelocitiesRecord command_record_;
 
   gazebo::transport::NodePtr node_handle_;
+  /// \brief  Requests the Gazebo->ROS connections of the plugin.
+  RosBridgeConnector ros_bridge_connector_;
   gazebo::transport::PublisherPtr motor_velocity_reference_pub_;
+
+  /// \details    Re-used message object, defined here to reduce dynamic memory allocation.
+  gz_sensor_msgs::Actuators turning_velocities_msg_;
+
   gazebo::transport::SubscriberPtr cmd_motor_sub_;
+  gazebo::transport::SubscriberPtr cmd_attitude_thrust_sub_;
 
   physics::ModelPtr model_;
   physics::WorldPtr world_;
 
+  /// \brief  Age of the motor commands, whose stamp is the one of the
+  ///         odometry the controller answered, for the real time factor
+  ///         governor.
+  ControlLoopPtr control_loop_;
+
   /// \brief Pointer to the update event connection.
-  event::ConnectionPtr updateConnection_;
+  UpdateConnectionPtr updateConnection_;
 
   boost::thread callback_queue_thread_;
 
   void QueueThread();
 
   void CommandMotorCallback(GzActuatorsMsgPtr& actuators_msg);
+  void CommandAttitudeThrustCallback(
+      GzRollPitchYawrateThrustMsgPtr& roll_pitch_yawrate_thrust_msg);
 
 };
 
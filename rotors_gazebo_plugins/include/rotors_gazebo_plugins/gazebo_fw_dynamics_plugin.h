@@ -28,7 +28,9 @@
 #include "WindSpeed.pb.h"
 
 #include "rotors_gazebo_plugins/common.h"
+#include "rotors_gazebo_plugins/fw_coefficient_table.h"
 #include "rotors_gazebo_plugins/fw_parameters.h"
+#include "rotors_gazebo_plugins/update_dispatcher.h"
 
 namespace gazebo {
 
@@ -41,6 +43,7 @@ typedef const boost::shared_ptr<const gz_mav_msgs::WindSpeed>
 
 // Default values.
 static constexpr bool kDefaultIsInputJoystick = false;
+static constexpr bool kDefaultUseCoefficientTable = false;
 
 // Constants.
 static constexpr double kAirDensity = 1.18;
@@ -115,7 +118,7 @@ class GazeboFwDynamicsPlugin : public ModelPlugin {
   /// \brief    Pointer to the link.
   physics::LinkPtr link_;
   /// \brief    Pointer to the update event connection.
-  event::ConnectionPtr updateConnection_;
+  UpdateConnectionPtr updateConnection_;
 
   /// \brief    Most current wind speed reading [m/s].
   ignition::math::Vector3d W_wind_speed_W_B_;
@@ -126,6 +129,13 @@ class GazeboFwDynamicsPlugin : public ModelPlugin {
   /// \brief    The physical properties of the aircraft.
   FWVehicleParameters vehicle_params_;
 
+  /// \brief    Look up the aerodynamic coefficients in coefficient_table_
+  ///           instead of evaluating the polynomials of aero_params_.
+  bool use_coefficient_table_;
+  /// \brief    Coefficients tabulated at Load() from aero_params_ or from
+  ///           tabulated data.
+  FWCoefficientTable coefficient_table_;
+
   /// \brief    Left aileron deflection [rad].
   double delta_aileron_left_;
   /// \brief    Right aileron deflection [rad].
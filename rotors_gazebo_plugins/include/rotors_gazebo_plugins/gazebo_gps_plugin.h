@@ -19,6 +19,9 @@
 #define ROTORS_GAZEBO_PLUGINS_GPS_PLUGIN_H
 
 // SYSTEM
+#include <algorithm>
+#include <cmath>
+#include <memory>
 #include <random>
 
 // 3RD PARTY
@@ -30,6 +33,9 @@
 #include "NavSatFix.pb.h"     // GPS message type generated by protobuf .proto file
 #include "TwistStamped.pb.h"  // GPS ground speed message
 #include "rotors_gazebo_plugins/common.h"
+#include "rotors_gazebo_plugins/measurement_delay_queue.h"
+#include "rotors_gazebo_plugins/ros_bridge_connector.h"
+#include "rotors_gazebo_plugins/sky_visibility_map.h"
 
 namespace gazebo {
 
@@ -38,11 +44,33 @@ static constexpr double kDefaultHorPosStdDev = 3.0;
 static constexpr double kDefaultVerPosStdDev = 6.0;
 static constexpr double kDefaultHorVelStdDev = 0.1;
 static constexpr double kDefaultVerVelStdDev = 0.1;
+static constexpr int kDefaultGpsMeasurementDelay = 0;
+static constexpr bool kDefaultSkyVisibility = false;
+static constexpr int kDefaultSkyMapNumThreads = 0;
+static constexpr int kDefaultMinSatellitesForFix = 4;
+static constexpr double kDefaultMultipathStdDev = 2.0;  // [m]
+static constexpr double kDefaultMultipathCorrelationTime = 10.0;  // [s]
+/// \brief  Earth radius used to offset the fixes by the occlusion noise [m].
+static constexpr double kGpsEarthRadius = 6378137.0;
 
 class GazeboGpsPlugin : public SensorPlugin {
  public:
   typedef std::normal_distribution<> NormalDistribution;
 
+  /// \brief  A noisy fix and ground speed waiting for their publish time.
+  struct GpsMeasurement {
+    common::Time stamp;
+    double latitude;
+    double longitude;
+    double altitude;
+    ignition::math::Vector3d ground_speed;
+    bool has_fix;
+    /// \brief  Factor on the position standard deviations.
+    double noise_scale;
+  };
+  /// \brief  Measurements keyed by the sensor update they are published at.
+  typedef MeasurementDelayQueue<GpsMeasurement> GpsQueue;
+
   GazeboGpsPlugin();
   virtual ~GazeboGpsPlugin();
 
@@ -66,7 +94,19 @@ class GazeboGpsPlugin : public SensorPlugin {
   ///           has loaded and listening to ConnectGazeboToRosTopic and ConnectRosToGazeboTopic messages).
   void CreatePubsAndSubs();
 
+  /// \brief    Fills both messages from a measurement and publishes them.
+  void PublishMeasurement(const GpsMeasurement& measurement);
+
+  /// \brief    Degrades a fix by the satellites that are hidden at the
+  ///           position of the link: the fix is lost below
+  ///           min_satellites_for_fix_, the position noise grows as fewer
+  ///           satellites are in view, and a correlated multipath bias grows
+  ///           with the hidden part of the sky.
+  void ApplySkyVisibility(GpsMeasurement* measurement);
+
   gazebo::transport::NodePtr node_handle_;
+  /// \brief  Requests the Gazebo->ROS connections of the plugin.
+  RosBridgeConnector ros_bridge_connector_;
 
   gazebo::transport::PublisherPtr gz_gps_pub_;
 
@@ -103,6 +143,36 @@ class GazeboGpsPlugin : public SensorPlugin {
   std::random_device random_device_;
 
   std::mt19937 random_generator_;
+
+  /// \brief    Number of sensor updates a measurement is held back before it
+  ///           is published, read from SDF.
+  int measurement_delay_;
+
+  /// \brief    Sensor updates since the plugin was loaded.
+  int gps_sequence_;
+
+  /// \brief    Measurements that are not yet published.
+  GpsQueue gps_queue_;
+
+  double hor_pos_std_dev_;
+  double ver_pos_std_dev_;
+
+  /// \brief    Model the occlusion of the satellites by the static geometry
+  ///           of the world, read from SDF.
+  bool sky_visibility_;
+  SkyVisibilityParams sky_params_;
+  int sky_map_num_threads_;
+  /// \brief    Computed on the first sensor update, once the world is loaded.
+  std::shared_ptr<const SkyVisibilityMap> sky_map_;
+  int min_satellites_for_fix_;
+  /// \brief    Standard deviation of the multipath bias with the whole sky
+  ///           hidden [m].
+  double multipath_std_dev_;
+  double multipath_correlation_time_;
+  /// \brief    Multipath bias east and north [m].
+  double multipath_bias_[2];
+  common::Time last_multipath_time_;
+  NormalDistribution standard_normal_;
 };
 
 } // namespace gazebo 
@@ -31,8 +31,20 @@
 #include <gazebo/physics/physics.hh>
 
 #include "Imu.pb.h"
+#include "ImuDelta.pb.h"
 
 #include "rotors_gazebo_plugins/common.h"
+#include "rotors_gazebo_plugins/imu_delta_integrator.h"
+#include "rotors_gazebo_plugins/measurement_delay_queue.h"
+#include "rotors_gazebo_plugins/model_fidelity.h"
+#include "rotors_gazebo_plugins/ros_bridge_connector.h"
+#include "rotors_gazebo_plugins/normal_sample_buffer.h"
+#include "rotors_gazebo_plugins/rate_scheduler.h"
+#include "rotors_gazebo_plugins/rigid_body_state.h"
+#include "rotors_gazebo_plugins/shm_records.h"
+#include "rotors_gazebo_plugins/shm_ring.h"
+#include "rotors_gazebo_plugins/simulation_checkpoint.h"
+#include "rotors_gazebo_plugins/update_dispatcher.h"
 
 namespace gazebo {
 
@@ -55,6 +67,9 @@ static constexpr double kDefaultAdisAccelerometerTurnOnBiasSigma =
     20.0e-3 * 9.8;
 // Earth's gravity in Zurich (lat=+47.3667degN, lon=+8.5500degE, h=+500m, WGS84)
 static constexpr double kDefaultGravityMagnitude = 9.8068;
+static constexpr int kDefaultImuMeasurementDelay = 0;
+static constexpr double kDefaultImuDeltaRate = 0.0;  // [Hz], disabled
+static const std::string kDefaultImuDeltaTopic = "imu_delta";
 
 // A description of the parameters:
 // https://github.com/ethz-asl/kalibr/wiki/IMU-Noise-Model-and-Intrinsics
@@ -96,6 +111,15 @@ struct ImuParameters {
 
 class GazeboImuPlugin : public ModelPlugin {
  public:
+  /// \brief  A noisy measurement waiting for its publish time.
+  struct ImuMeasurement {
+    common::Time stamp;
+    ignition::math::Quaterniond orientation;
+    Eigen::Vector3d linear_acceleration;
+    Eigen::Vector3d angular_velocity;
+  };
+  /// \brief  Measurements keyed by the simulation step they are published at.
+  typedef MeasurementDelayQueue<ImuMeasurement> ImuQueue;
 
   GazeboImuPlugin();
   ~GazeboImuPlugin();
@@ -113,10 +137,26 @@ class GazeboImuPlugin : public ModelPlugin {
       Eigen::Vector3d* angular_velocity,
       const double dt);
 
+  /// \brief  Discretizes the noise model for the time step dt, only if it
+  ///         differs from the time step of the last call.
+  void UpdateNoiseCoefficients(const double dt);
+
   /// \brief  	This gets called by the world update start event.
   /// \details	Calculates IMU parameters and then publishes one IMU message.
   void OnUpdate(const common::UpdateInfo&);
 
+  /// \brief  Fills the IMU message from a measurement and publishes it.
+  void PublishMeasurement(const ImuMeasurement& measurement);
+
+  /// \brief  Adds a measurement to the delta angle and velocity, and
+  ///         publishes them at the end of the interval.
+  void IntegrateMeasurement(const ImuMeasurement& measurement);
+
+  /// \brief  Writes the noise processes and the delayed measurements to a
+  ///         checkpoint.
+  void SaveCheckpoint(CheckpointWriter* writer);
+  bool RestoreCheckpoint(CheckpointReader* reader);
+
  private:
 
   /// \brief    Flag that is set to true once CreatePubsAndSubs() is called, used
@@ -135,6 +175,8 @@ class GazeboImuPlugin : public ModelPlugin {
 
   /// \brief    Handle for the Gazebo node.
   transport::NodePtr node_handle_;
+  /// \brief  Requests the Gazebo->ROS connections of the plugin.
+  RosBridgeConnector ros_bridge_connector_;
 
   transport::PublisherPtr imu_pub_;
 
@@ -144,6 +186,20 @@ class GazeboImuPlugin : public ModelPlugin {
   std::default_random_engine random_generator_;
   std::normal_distribution<double> standard_normal_distribution_;
 
+  /// \brief    Standard normal samples for the noise processes.
+  NormalSampleBuffer normal_samples_;
+
+  /// \brief    Time step the discrete-time noise coefficients are valid for.
+  double noise_dt_;
+  // Discrete-time standard deviations and state-transitions of the noise
+  // processes, see AddNoise().
+  double sigma_g_d_;
+  double sigma_b_g_d_;
+  double phi_g_d_;
+  double sigma_a_d_;
+  double sigma_b_a_d_;
+  double phi_a_d_;
+
   /// \brief    Pointer to the world.
   physics::WorldPtr world_;
 
@@ -153,8 +209,11 @@ class GazeboImuPlugin : public ModelPlugin {
   /// \brief    Pointer to the link.
   physics::LinkPtr link_;
 
+  /// \brief    State snapshot of the link, shared with the other plugins.
+  std::shared_ptr<RigidBodyStateCache> link_state_;
+
   /// \brief    Pointer to the update event connection.
-  event::ConnectionPtr updateConnection_;
+  UpdateConnectionPtr updateConnection_;
 
   common::Time last_time_;
 
@@ -163,6 +222,15 @@ class GazeboImuPlugin : public ModelPlugin {
   //            and then published onto a topic
   gz_sensor_msgs::Imu imu_message_;
 
+  /// \brief    Write the measurements to a shared memory ring, read from SDF.
+  /// \details  The ROS interface and MAVLink interface plugins read the
+  ///           ring directly, the Gazebo message is then only built and
+  ///           published if somebody else subscribes to it.
+  bool shm_transport_;
+  ShmRingWriter<ShmImuRecord> imu_shm_;
+  /// \brief    Record written to imu_shm_, its covariances are set in Load().
+  ShmImuRecord imu_record_;
+
   ignition::math::Vector3d gravity_W_;
   ignition::math::Vector3d velocity_prev_W_;
 
@@ -173,6 +241,37 @@ class GazeboImuPlugin : public ModelPlugin {
   Eigen::Vector3d accelerometer_turn_on_bias_;
 
   ImuParameters imu_parameters_;
+
+  /// \brief    Number of simulation steps a measurement is held back before it
+  ///           is published, read from SDF.
+  int measurement_delay_;
+
+  /// \brief    Simulation steps since the plugin was loaded.
+  int imu_sequence_;
+
+  /// \brief    Measurements that are not yet published.
+  ImuQueue imu_queue_;
+
+  /// \brief    Publish the measurements preintegrated over 1 / imu_delta_rate_
+  ///           instead, read from SDF as deltaRate. 0 publishes every sample.
+  /// \details  The samples of every step are integrated with coning and
+  ///           sculling corrections, and published on imu_delta_topic_. The
+  ///           single samples are then only written to the shared memory ring
+  ///           and published over Gazebo if somebody subscribes to them, they
+  ///           are not bridged to ROS.
+  double imu_delta_rate_;
+  std::string imu_delta_topic_;
+  transport::PublisherPtr imu_delta_pub_;
+  gz_sensor_msgs::ImuDelta imu_delta_message_;
+  ImuDeltaIntegrator imu_delta_integrator_;
+  RateScheduler imu_delta_scheduler_;
+  /// \brief    Stamp of the last integrated measurement.
+  common::Time last_integrated_stamp_;
+
+  /// \brief    Level of detail of the sensors of the model.
+  std::shared_ptr<ModelFidelity> fidelity_;
+
+  CheckpointConnectionPtr checkpoint_connection_;
 };
 
 }  // namespace gazebo
@@ -27,7 +27,14 @@
 #include "MagneticField.pb.h"
 
 #include "rotors_gazebo_plugins/common.h"
+#include "rotors_gazebo_plugins/geo_magnetic_grid.h"
+#include "rotors_gazebo_plugins/local_tangent_plane.h"
+#include "rotors_gazebo_plugins/model_fidelity.h"
+#include "rotors_gazebo_plugins/publish_policy.h"
+#include "rotors_gazebo_plugins/rigid_body_state.h"
+#include "rotors_gazebo_plugins/ros_bridge_connector.h"
 #include "rotors_gazebo_plugins/sdf_api_wrapper.hpp"
+#include "rotors_gazebo_plugins/update_dispatcher.h"
 
 namespace gazebo {
 
@@ -38,6 +45,12 @@ static constexpr double kDefaultRefMagNorth = 0.000021493;
 static constexpr double kDefaultRefMagEast = 0.000000815;
 static constexpr double kDefaultRefMagDown = 0.000042795;
 
+// Default reference position [deg] for the lookup in a geomagnetic grid.
+static constexpr double kDefaultRefLatitude = 47.3667;
+static constexpr double kDefaultRefLongitude = 8.5500;
+
+static constexpr int kDefaultMagnetometerMeasurementDivisor = 1;
+
 class GazeboMagnetometerPlugin : public ModelPlugin {
 
  public:
@@ -66,6 +79,8 @@ class GazeboMagnetometerPlugin : public ModelPlugin {
   std::string namespace_;
   std::string magnetometer_topic_;
   gazebo::transport::NodePtr node_handle_;
+  /// \brief  Requests the Gazebo->ROS connections of the plugin.
+  RosBridgeConnector ros_bridge_connector_;
   gazebo::transport::PublisherPtr magnetometer_pub_;
   std::string frame_id_;
 
@@ -78,15 +93,40 @@ class GazeboMagnetometerPlugin : public ModelPlugin {
   /// \brief    Pointer to the link.
   physics::LinkPtr link_;
 
+  /// \brief    State snapshot of the link, shared with the other plugins.
+  std::shared_ptr<RigidBodyStateCache> link_state_;
+
+  /// \brief    Sensor level of detail of the model.
+  std::shared_ptr<ModelFidelity> fidelity_;
+
   //// \brief    Pointer to the update event connection.
-  event::ConnectionPtr updateConnection_;
+  UpdateConnectionPtr updateConnection_;
+
+  /// \brief    A measurement is published every measurement_divisor_
+  ///           physics steps, to run the magnetometer at its real rate.
+  int measurement_divisor_;
+  /// \brief    Offset of the measurement steps, staggered against the
+  ///           measurements of the other vehicles.
+  UpdateOffsetPtr measurement_offset_;
 
   ignition::math::Vector3d mag_W_;
 
+  /// \brief    Optional geomagnetic grid, the field then follows the position
+  ///           of the link relative to the reference position.
+  GeoMagneticGrid geo_magnetic_grid_;
+  /// \brief    The grid cell around the link.
+  GeoMagneticGrid::Cell geo_magnetic_cell_;
+  /// \brief    Reprojects the position of the link around the reference
+  ///           position.
+  LocalTangentPlane local_tangent_plane_;
+  /// \brief    Initial bias, added to the field from the grid.
+  ignition::math::Vector3d mag_bias_W_;
+
   /// \brief    Magnetic field message.
   /// \details  Reused message object which is defined here to reduce
   ///           memory allocation.
   gz_sensor_msgs::MagneticField mag_message_;
+  PublishPolicy publish_policy_;
 
   NormalDistribution noise_n_[3];
 
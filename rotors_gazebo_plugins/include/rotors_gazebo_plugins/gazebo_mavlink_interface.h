@@ -18,9 +18,13 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <math.h>
 #include <deque>
+#include <memory>
 #include <random>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -39,6 +43,15 @@
 #include "common/mavlink.h"     // Either provided by ROS or as CMake argument MAVLINK_HEADER_DIR
 
 #include "common.h"
+#include "control_loop_monitor.h"
+#include "geo_magnetic_grid.h"
+#include "local_tangent_plane.h"
+#include "mavlink_transport.h"
+#include "rate_scheduler.h"
+#include "rigid_body_state.h"
+#include "shm_records.h"
+#include "shm_ring.h"
+#include "update_dispatcher.h"
 //#include "mavlink/v1.0/common/mavlink.h"
 
 #include "CommandMotorSpeed.pb.h"
@@ -50,6 +63,17 @@ static const uint8_t mavlink_message_lengths[256] = MAVLINK_MESSAGE_LENGTHS;
 static const uint8_t mavlink_message_crcs[256] = MAVLINK_MESSAGE_CRCS;
 
 static const uint32_t kDefaultMavlinkUdpPort = 14560;
+static const int kDefaultMavlinkSystemId = 1;
+static const bool kDefaultMavlinkBatchedTransport = false;
+static const bool kDefaultMavlinkSharedSocket = false;
+static const bool kDefaultMavlinkLockstep = false;
+static const double kDefaultMavlinkLockstepTimeout = 0.1;  // [s]
+// Rates of the simulated sensors sent to the autopilot, 0 sends them with
+// every IMU measurement.
+static const double kDefaultMavlinkGpsRate = 5.0;  // [Hz]
+static const double kDefaultMavlinkMagRate = 100.0;  // [Hz]
+static const double kDefaultMavlinkBaroRate = 50.0;  // [Hz]
+static const double kDefaultMavlinkGroundTruthRate = 0.0;  // [Hz]
 
 namespace gazebo {
 
@@ -94,9 +118,21 @@ class GazeboMavlinkInterface : public ModelPlugin {
         zero_position_disarmed_{},
         zero_position_armed_{},
         input_index_{},
+        last_diff_pressure_(0.0f),
+        last_pressure_alt_(0.0f),
         lat_rad_(0.0),
         lon_rad_(0.0),
-        mavlink_udp_port_(kDefaultMavlinkUdpPort)
+        local_tangent_plane_(0.0, 0.0),
+        mavlink_udp_port_(kDefaultMavlinkUdpPort),
+        endpoint_(std::make_shared<MavlinkEndpoint>()),
+        lockstep_(kDefaultMavlinkLockstep),
+        lockstep_timeout_(kDefaultMavlinkLockstepTimeout),
+        sensor_batches_sent_(0),
+        sensor_batches_answered_(0),
+        lockstep_timeouts_(0),
+        reported_lockstep_timeouts_(0),
+        shm_transport_(kDefaultShmTransport),
+        shm_open_steps_(0)
         {}
   ~GazeboMavlinkInterface();
 
@@ -120,7 +156,12 @@ class GazeboMavlinkInterface : public ModelPlugin {
   transport::PublisherPtr motor_velocity_reference_pub_;
   transport::SubscriberPtr mav_control_sub_;
 
+  /// \details    Re-used message object, defined here to reduce dynamic memory allocation.
+  gz_mav_msgs::CommandMotorSpeed turning_velocities_msg_;
+
   physics::ModelPtr model_;
+  /// \brief  State snapshot of the canonical link of the model.
+  std::shared_ptr<RigidBodyStateCache> model_state_;
   physics::WorldPtr world_;
   physics::JointPtr left_elevon_joint_;
   physics::JointPtr right_elevon_joint_;
@@ -142,16 +183,33 @@ class GazeboMavlinkInterface : public ModelPlugin {
   std::vector<common::PID> pids_;
 
   /// \brief Pointer to the update event connection.
-  event::ConnectionPtr updateConnection_;
+  UpdateConnectionPtr updateConnection_;
 
   boost::thread callback_queue_thread_;
   void QueueThread();
   void ImuCallback(ImuPtr& imu_msg);
+  /// \brief Sends HIL_SENSOR and HIL_STATE_QUATERNION for one IMU measurement.
+  /// \param[in] queue Outbound queue of the calling thread.
+  void SendImu(const ignition::math::Quaterniond& q_gr,
+               const ignition::math::Vector3d& linear_acceleration,
+               const ignition::math::Vector3d& angular_velocity,
+               MavlinkEndpoint::OutboundQueue* queue);
+  /// \brief Sends all IMU measurements written to the ring since the last step.
+  void ReadShmImu();
   void LidarCallback(LidarPtr& lidar_msg);
   void OpticalFlowCallback(OpticalFlowPtr& opticalFlow_msg);
-  void send_mavlink_message(const uint8_t msgid, const void *msg, uint8_t component_ID);
+
+  /// \brief Serializes a message and queues it for the I/O thread.
+  /// \param[in] queue Outbound queue of the calling thread.
+  void send_mavlink_message(const uint8_t msgid, const void *msg, uint8_t component_ID,
+                            MavlinkEndpoint::OutboundQueue* queue);
   void handle_message(mavlink_message_t *msg);
-  void pollForMAVLinkMessages(double _dt, uint32_t _timeoutMs);
+  /// \brief Handles all messages the I/O thread received since the last call.
+  void handle_received_messages();
+  /// \brief Handles the received messages, blocking until the autopilot has
+  ///        answered every sensor batch sent so far or the lockstep timeout
+  ///        has passed.
+  void handle_received_messages_lockstep();
 
   static const unsigned kNOutMax = 16;
 
@@ -175,27 +233,37 @@ class GazeboMavlinkInterface : public ModelPlugin {
   std::string opticalFlow_sub_topic_;
 
   common::Time last_time_;
-  common::Time last_gps_time_;
   common::Time last_actuator_time_;
-  double gps_update_interval_;
+  /// \brief Decide which steps send HIL_GPS, and which IMU measurements
+  ///        update the magnetometer and barometer fields of HIL_SENSOR or
+  ///        send HIL_STATE_QUATERNION, read from SDF.
+  RateScheduler gps_scheduler_;
+  RateScheduler mag_scheduler_;
+  RateScheduler baro_scheduler_;
+  RateScheduler ground_truth_scheduler_;
+  /// \brief Newest magnetometer and barometer fields, repeated in the
+  ///        HIL_SENSOR messages that do not update them.
+  ignition::math::Vector3d last_mag_b_;
+  float last_diff_pressure_;
+  float last_pressure_alt_;
   double lat_rad_;
   double lon_rad_;
+  /// \brief Reprojects the local position to lat_rad_ and lon_rad_.
+  LocalTangentPlane local_tangent_plane_;
   void handle_control(double _dt);
 
   ignition::math::Vector3d gravity_W_;
   ignition::math::Vector3d velocity_prev_W_;
   ignition::math::Vector3d mag_d_;
+  /// \brief Optional geomagnetic grid, replaces the declination table and
+  ///        the constant field strength of mag_d_.
+  GeoMagneticGrid geo_magnetic_grid_;
+  /// \brief The grid cell around the vehicle.
+  GeoMagneticGrid::Cell geo_magnetic_cell_;
 
   std::default_random_engine random_generator_;
   std::normal_distribution<float> standard_normal_distribution_;
 
-  int fd_;
-  struct sockaddr_in myaddr_;  ///< The locally bound address
-  struct sockaddr_in srcaddr_;  ///< SITL instance
-  socklen_t addrlen_;
-  unsigned char buf_[65535];
-  struct pollfd fds_[1];
-
   struct sockaddr_in srcaddr_2_;  ///< MAVROS
 
   //so we dont have to do extra callbacks
@@ -207,5 +275,34 @@ class GazeboMavlinkInterface : public ModelPlugin {
   in_addr_t mavlink_addr_;
   int mavlink_udp_port_;
 
+  /// \brief Socket and I/O thread, owned or shared with other vehicles.
+  std::shared_ptr<MavlinkTransport> transport_;
+  /// \brief Queues to and from the I/O thread.
+  std::shared_ptr<MavlinkEndpoint> endpoint_;
+
+  /// \brief Wait in every physics step for the actuator controls that answer
+  ///        the previous sensor batch.
+  bool lockstep_;
+  /// \brief Longest wait for the actuator controls in one step [s].
+  double lockstep_timeout_;
+  /// \brief Number of HIL_SENSOR messages sent, written by SendImu().
+  std::atomic<uint64_t> sensor_batches_sent_;
+  /// \brief Number of sensor batches answered by HIL_ACTUATOR_CONTROLS.
+  uint64_t sensor_batches_answered_;
+  uint64_t lockstep_timeouts_;
+  uint64_t reported_lockstep_timeouts_;
+  std::chrono::steady_clock::time_point last_lockstep_report_;
+  /// \brief Round trip from the sensor batches to the actuator controls, for
+  ///        the real time factor governor.
+  ControlLoopPtr control_loop_;
+
+  /// \brief Read the IMU from and write the motor commands to shared memory
+  ///        rings instead of the Gazebo transport.
+  bool shm_transport_;
+  ShmRingReader<ShmImuRecord> imu_shm_;
+  int shm_open_steps_;
+  ShmRingWriter<ShmRotorVelocitiesRecord> command_shm_;
+  ShmRotorVelocitiesRecord command_record_;
+
   };
 }
@@ -36,8 +36,18 @@
 #include <mav_msgs/default_topics.h>  // This comes from the mav_comm repo
 
 // USER
+#include "rotors_gazebo_plugins/command_mailbox.h"
 #include "rotors_gazebo_plugins/common.h"
+#include "rotors_gazebo_plugins/model_arena.h"
 #include "rotors_gazebo_plugins/motor_model.hpp"
+#include "rotors_gazebo_plugins/rigid_body_state.h"
+#include "rotors_gazebo_plugins/ros_bridge_connector.h"
+#include "rotors_gazebo_plugins/rotor_aero_table.h"
+#include "rotors_gazebo_plugins/shm_records.h"
+#include "rotors_gazebo_plugins/shm_ring.h"
+#include "rotors_gazebo_plugins/simulation_checkpoint.h"
+#include "rotors_gazebo_plugins/update_dispatcher.h"
+#include "rotors_gazebo_plugins/vehicle_motor_model.h"
 #include "Float32.pb.h"
 #include "CommandMotorSpeed.pb.h"
 #include "WindSpeed.pb.h"
@@ -68,6 +78,10 @@ static constexpr double kDefaultTimeConstantDown = 1.0 / 40.0;
 static constexpr double kDefaulMaxRotVelocity = 838.0;
 static constexpr double kDefaultRotorDragCoefficient = 1.0e-4;
 static constexpr double kDefaultRollingMomentCoefficient = 1.0e-6;
+static constexpr bool kDefaultUseVehicleMotorModel = false;
+/// \brief  Tolerance on the alignment of the joint and rotor axes below which a
+///         rotor is treated as fixed mount.
+static constexpr double kFixedMountTolerance = 1.0e-9;
 
 class GazeboMotorModel : public MotorModel, public ModelPlugin {
 
@@ -96,6 +110,11 @@ class GazeboMotorModel : public MotorModel, public ModelPlugin {
         rotor_velocity_slowdown_sim_(kDefaultRotorVelocitySlowdownSim),
         time_constant_down_(kDefaultTimeConstantDown),
         time_constant_up_(kDefaultTimeConstantUp),
+        use_vehicle_motor_model_(kDefaultUseVehicleMotorModel),
+        shm_transport_(kDefaultShmTransport),
+        shm_open_steps_(0),
+        fixed_mount_(false),
+        drag_torque_axis_(0, 0, 1),
         node_handle_(nullptr),
         wind_speed_W_(0, 0, 0),
         pubs_and_subs_created_(false) {}
@@ -152,9 +171,44 @@ class GazeboMotorModel : public MotorModel, public ModelPlugin {
   double time_constant_down_;
   double time_constant_up_;
 
+  /// \brief    Thrust and drag torque coefficients over rotor speed and
+  ///           airspeed, read from aeroTablePath. The constants above are
+  ///           used if NULL.
+  std::shared_ptr<const RotorAeroTable> aero_table_;
+
+  /// \brief    If true, the forces and moments of this rotor are computed
+  ///           together with all other rotors of the model that enable it.
+  bool use_vehicle_motor_model_;
+  std::shared_ptr<VehicleMotorModel> vehicle_motor_model_;
+
+  /// \brief    Also read the motor commands from the shared memory ring of
+  ///           the command topic, read from SDF.
+  /// \details  The ring is written by the MAVLink or the controller interface
+  ///           plugin instead of publishing the commands, if they enable
+  ///           shmTransport as well. Commands on the Gazebo topic, e.g. from
+  ///           ROS, are still applied.
+  bool shm_transport_;
+  ShmRingReader<ShmRotorVelocitiesRecord> command_shm_;
+  int shm_open_steps_;
+
+  /// \brief    Applies the newest command of the shared memory ring, opening
+  ///           the ring first if needed.
+  void ReadShmCommand();
+
+  /// \brief    Sets the reference of the motor from a command, limited to the
+  ///           maximum of the motor type.
+  void SetMotorInput(double command);
+
+  /// \brief    Newest command of the Gazebo topic, posted by the transport
+  ///           thread and applied at the start of each physics step.
+  CommandMailbox<1> command_mailbox_;
+  MailboxCommand<1> mailbox_command_;
+
   common::PID pids_;
 
   gazebo::transport::NodePtr node_handle_;
+  /// \brief  Requests the Gazebo->ROS connections of the plugin.
+  RosBridgeConnector ros_bridge_connector_;
 
   gazebo::transport::PublisherPtr motor_velocity_pub_;
 
@@ -169,9 +223,19 @@ class GazeboMotorModel : public MotorModel, public ModelPlugin {
   physics::ModelPtr model_;
   physics::JointPtr joint_;
   physics::LinkPtr link_;
+  std::shared_ptr<RigidBodyStateCache> link_state_;
+  /// \brief    Link the rotor is mounted on, the moments are applied to it.
+  physics::LinkPtr parent_link_;
+
+  /// \brief    True if the rotor spins about the z-axis of its CoG frame, so that
+  ///           the direction of its drag torque in the parent frame is constant.
+  bool fixed_mount_;
+  /// \brief    Direction of the drag torque in the parent link frame. Only valid
+  ///           if fixed_mount_ is true.
+  ignition::math::Vector3d drag_torque_axis_;
 
   /// \brief Pointer to the update event connection.
-  event::ConnectionPtr updateConnection_;
+  UpdateConnectionPtr updateConnection_;
 
   boost::thread callback_queue_thread_;
 
@@ -185,8 +249,16 @@ class GazeboMotorModel : public MotorModel, public ModelPlugin {
 
   void WindSpeedCallback(GzWindSpeedMsgPtr& wind_speed_msg);
 
-  std::unique_ptr<FirstOrderFilter<double>> rotor_velocity_filter_;
+  ArenaUniquePtr<FirstOrderFilter<double>> rotor_velocity_filter_;
   ignition::math::Vector3d wind_speed_W_;
+
+  /// \brief    Writes the motor command and the state of the rotor velocity
+  ///           filter to a checkpoint. The position controller of a servo
+  ///           starts over from a reset integrator after a restore.
+  void SaveCheckpoint(CheckpointWriter* writer);
+  bool RestoreCheckpoint(CheckpointReader* reader);
+
+  CheckpointConnectionPtr checkpoint_connection_;
 };
 
 } // namespace gazebo {
@@ -36,6 +36,10 @@
 #include "JointState.pb.h"
 
 #include "rotors_gazebo_plugins/common.h"
+#include "rotors_gazebo_plugins/ros_bridge_connector.h"
+#include "rotors_gazebo_plugins/shm_records.h"
+#include "rotors_gazebo_plugins/shm_ring.h"
+#include "rotors_gazebo_plugins/update_dispatcher.h"
 
 namespace gazebo {
 
@@ -58,6 +62,7 @@ class GazeboMultirotorBasePlugin : public ModelPlugin {
         frame_id_(kDefaultFrameId),
         rotor_velocity_slowdown_sim_(kDefaultRotorVelocitySlowdownSim),
         node_handle_(NULL),
+        shm_transport_(kDefaultShmTransport),
         pubs_and_subs_created_(false) {}
 
   virtual ~GazeboMultirotorBasePlugin();
@@ -86,7 +91,7 @@ class GazeboMultirotorBasePlugin : public ModelPlugin {
   void CreatePubsAndSubs();
 
   /// \brief Pointer to the update event connection.
-  event::ConnectionPtr update_connection_;
+  UpdateConnectionPtr update_connection_;
 
   physics::WorldPtr world_;
   physics::ModelPtr model_;
@@ -108,12 +113,23 @@ class GazeboMultirotorBasePlugin : public ModelPlugin {
   /// \details    Re-used message object, defined here to reduce dynamic memory allocation.
   gz_sensor_msgs::Actuators actuators_msg_;
 
+  /// \brief    Write the motor velocities to a shared memory ring, read from
+  ///           SDF.
+  /// \details  The ROS interface plugin reads the ring directly, the
+  ///           actuators message is then only published if somebody else
+  ///           subscribes to it.
+  bool shm_transport_;
+  ShmRingWriter<ShmRotorVelocitiesRecord> motor_shm_;
+  ShmRotorVelocitiesRecord motor_record_;
+
   gazebo::transport::PublisherPtr joint_state_pub_;
 
   /// \details    Re-used message object, defined here to reduce dynamic memory allocation.
   gz_sensor_msgs::JointState joint_state_msg_;
 
   gazebo::transport::NodePtr node_handle_;
+  /// \brief  Requests the Gazebo->ROS connections of the plugin.
+  RosBridgeConnector ros_bridge_connector_;
 };
 
 } // namespace gazebo
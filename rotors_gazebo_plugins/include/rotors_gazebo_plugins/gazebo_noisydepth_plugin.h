@@ -54,8 +54,16 @@
 #include <std_msgs/Float64.h>
 
 #include <rotors_gazebo_plugins/depth_noise_model.hpp>
+#include <rotors_gazebo_plugins/depth_ray_table.h>
+#include <rotors_gazebo_plugins/depth_noise_shader.h>
+#include <rotors_gazebo_plugins/model_fidelity.h>
 
 namespace gazebo {
+
+// Same defaults as the point cloud of gazebo_ros_depth_camera.
+static constexpr double kDefaultPointCloudCutoff = 0.4;  // [m]
+static constexpr double kDefaultPointCloudCutoffMax = 5.0;  // [m]
+
 class GazeboNoisyDepth : public DepthCameraPlugin, GazeboRosCameraUtils {
  public:
   GazeboNoisyDepth();
@@ -83,6 +91,8 @@ class GazeboNoisyDepth : public DepthCameraPlugin, GazeboRosCameraUtils {
   void DepthImageDisconnect();
   void DepthInfoConnect();
   void DepthInfoDisconnect();
+  void PointCloudConnect();
+  void PointCloudDisconnect();
   void FillDepthImage(const float *_src);
   bool FillDepthImageHelper(const uint32_t rows_arg,
                             const uint32_t cols_arg,
@@ -90,11 +100,39 @@ class GazeboNoisyDepth : public DepthCameraPlugin, GazeboRosCameraUtils {
                             const float *data_arg,
                             sensor_msgs::Image *image_msg);
 
+  /// \brief Unprojects the noisy depth image into point_cloud_msg_ and
+  ///        publishes it, called with lock_ held.
+  void FillPointCloud(const float *depth);
+
   virtual void PublishCameraInfo();
 
+  /// \brief Attach the GPU noise stage to the depth camera, falls back to the
+  ///        CPU noise model if that fails. Called from the rendering thread.
+  void SetupGpuNoise();
+
+  /// \brief Stops rendering at low fidelity, and resumes it at full fidelity
+  ///        if anyone is subscribed.
+  void OnFidelityChanged(FidelityLevel level);
+
+  /// \brief True if the model of the camera runs at low fidelity, it then
+  ///        does not render.
+  bool LowFidelity() const { return this->fidelity_ && this->fidelity_->low(); }
+
   event::ConnectionPtr load_connection_;
   std::unique_ptr<DepthNoiseModel> noise_model;
 
+  /// \brief Whether the noise should be added on the GPU before readback.
+  bool depth_noise_on_gpu_;
+  bool gpu_noise_setup_done_;
+  /// \brief Whether the current frame was rendered with the noise shader.
+  bool frame_has_gpu_noise_;
+  std::string depth_noise_shader_path_;
+  DepthNoiseShader gpu_noise_;
+
+  /// \brief Sensor level of detail of the model the camera is attached to.
+  std::shared_ptr<ModelFidelity> fidelity_;
+  int fidelity_listener_id_;
+
   ros::Publisher depth_image_pub_;
   ros::Publisher depth_image_camera_info_pub_;
 
@@ -104,6 +142,18 @@ class GazeboNoisyDepth : public DepthCameraPlugin, GazeboRosCameraUtils {
   std::string depth_image_topic_name_;
   std::string depth_image_camera_info_topic_name_;
 
+  /// \brief Organized cloud of the noisy depth in the optical frame, every
+  ///        point_cloud_decimation_-th pixel of every such row. Points outside
+  ///        [point_cloud_cutoff_, point_cloud_cutoff_max_] are NaN.
+  ros::Publisher point_cloud_pub_;
+  int point_cloud_connect_count_;
+  std::string point_cloud_topic_name_;
+  double point_cloud_cutoff_;
+  double point_cloud_cutoff_max_;
+  int point_cloud_decimation_;
+  DepthRayTable point_cloud_rays_;
+  sensor_msgs::PointCloud2 point_cloud_msg_;
+
   common::Time depth_sensor_update_time_;
   common::Time last_depth_image_camera_info_update_time_;
   sensor_msgs::Image depth_image_msg_;
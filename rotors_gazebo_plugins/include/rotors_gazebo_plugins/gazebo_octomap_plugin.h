@@ -22,28 +22,61 @@
 #ifndef ROTORS_GAZEBO_PLUGINS_GAZEBO_OCTOMAP_PLUGIN_H
 #define ROTORS_GAZEBO_PLUGINS_GAZEBO_OCTOMAP_PLUGIN_H
 
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <map>
 #include <math.h>
+#include <string>
+#include <vector>
 
 #include <rotors_gazebo_plugins/common.h>
+#include <rotors_gazebo_plugins/esdf.h>
+#include <rotors_gazebo_plugins/mesh_voxelizer.h>
+#include <rotors_gazebo_plugins/world_geometry.h>
 #include <gazebo/common/common.hh>
 #include <gazebo/gazebo.hh>
 #include <gazebo/physics/physics.hh>
 #include <octomap/octomap.h>
 #include <ros/ros.h>
+#include <rotors_comm/Esdf.h>
 #include <rotors_comm/Octomap.h>
+#include <rotors_comm/OctomapChunk.h>
 #include <sdf/sdf.hh>
 #include <std_srvs/Empty.h>
 
 namespace gazebo {
 
+// Default values
+/// \brief  Number of worker threads, 0 uses one per hardware thread.
+static constexpr int kDefaultOctomapNumThreads = 0;
+/// \brief  Only cast rays in cells close to the bounds of the collision geometry.
+static constexpr bool kDefaultOctomapHierarchical = false;
+/// \brief  Directory the octomaps are cached in, empty disables the cache.
+static const std::string kDefaultOctomapCacheDirectory = "";
+/// \brief  Only update the cells around models that moved or were added.
+static constexpr bool kDefaultOctomapIncremental = false;
+/// \brief  Serve Euclidean signed distance fields of the octomap.
+static constexpr bool kDefaultOctomapEsdf = false;
+/// \brief  Voxelize the collision shapes directly instead of casting rays.
+static constexpr bool kDefaultOctomapMeshVoxelization = false;
+
 /// \brief    Octomap plugin for Gazebo.
 /// \details  This plugin is dependent on ROS, and is not built if NO_ROS=TRUE is provided to
 ///           CMakeLists.txt. The PX4/Firmware build does not build this file.
 class OctomapFromGazeboWorld : public WorldPlugin {
  public:
   OctomapFromGazeboWorld()
-      : WorldPlugin(), node_handle_(kDefaultNamespace), octomap_(NULL) {}
+      : WorldPlugin(),
+        node_handle_(kDefaultNamespace),
+        octomap_(NULL),
+        num_threads_(1),
+        hierarchical_(kDefaultOctomapHierarchical),
+        octomap_hash_(0),
+        incremental_(kDefaultOctomapIncremental),
+        esdf_(kDefaultOctomapEsdf),
+        mesh_voxelization_(kDefaultOctomapMeshVoxelization),
+        has_incremental_state_(false) {}
   virtual ~OctomapFromGazeboWorld();
 
  protected:
@@ -57,18 +90,159 @@ class OctomapFromGazeboWorld : public WorldPlugin {
                        gazebo::physics::RayShapePtr ray,
                        const double leaf_size);
 
-  void FloodFill(const ignition::math::Vector3d & seed_point,
-                 const ignition::math::Vector3d & bounding_box_origin,
-                 const ignition::math::Vector3d & bounding_box_lengths,
-                 const double leaf_size);
+  typedef std::vector<octomap::OcTreeKey> KeyVector;
+  /// \brief Indices of cells within a slab, iy * num_cells[2] + iz.
+  typedef std::vector<int64_t> CellVector;
+
+  /// \brief Grid the octomap is sampled on, cell centers lie at
+  ///        min + (i, j, k) * leaf_size.
+  struct SamplingGrid {
+    ignition::math::Vector3d min;
+    double leaf_size;
+    int num_cells[3];
+
+    ignition::math::Vector3d CellCenter(int ix, int iy, int iz) const {
+      return ignition::math::Vector3d(min.X() + ix * leaf_size,
+                                      min.Y() + iy * leaf_size,
+                                      min.Z() + iz * leaf_size);
+    }
+
+    /// \brief Center of a cell, given its index in a dense bitmap.
+    ignition::math::Vector3d CellCenter(int64_t index) const {
+      return CellCenter(index / (static_cast<int64_t>(num_cells[1]) * num_cells[2]),
+                        (index / num_cells[2]) % num_cells[1],
+                        index % num_cells[2]);
+    }
+
+    /// \brief Index of a cell in a dense bitmap of the grid.
+    int64_t CellIndex(int ix, int iy, int iz) const {
+      return (static_cast<int64_t>(ix) * num_cells[1] + iy) * num_cells[2] + iz;
+    }
+
+    int64_t NumCells() const {
+      return static_cast<int64_t>(num_cells[0]) * num_cells[1] * num_cells[2];
+    }
+
+    bool operator==(const SamplingGrid& other) const {
+      return min == other.min && leaf_size == other.leaf_size &&
+             num_cells[0] == other.num_cells[0] &&
+             num_cells[1] == other.num_cells[1] &&
+             num_cells[2] == other.num_cells[2];
+    }
+  };
+
+  /// \brief Cells [begin, end) of the sampling grid along every axis.
+  struct CellBox {
+    int begin[3];
+    int end[3];
+
+    bool IsEmpty() const {
+      return begin[0] >= end[0] || begin[1] >= end[1] || begin[2] >= end[2];
+    }
+  };
+
+  /// \brief Axis aligned bounding boxes of the models in the world, by name.
+  typedef std::map<std::string, ignition::math::Box> ModelBoundsMap;
+
+  /// \brief Ray tests the cells of slab ix within [iy_begin, iy_end) x
+  ///        [iz_begin, iz_end), skipping every part of the region that none
+  ///        of the candidate bounds reaches into.
+  /// \param[in] candidates Bounds that might reach into the region.
+  /// \param[out] cells Occupied cells of the slab.
+  /// \param[out] num_ray_tests Number of cells that were ray tested.
+  void RasterizeNearGeometry(int ix, int iy_begin, int iy_end, int iz_begin,
+                             int iz_end, const SamplingGrid& grid,
+                             const std::vector<const GeometryBound*>& candidates,
+                             gazebo::physics::RayShapePtr ray, CellVector* cells,
+                             int64_t* num_ray_tests);
+
+  /// \brief Marks the cells of the grid that the collision shapes of the
+  ///        world touch, by voxelizing their triangles instead of casting
+  ///        rays through the physics engine, see MeshVoxelizer.
+  /// \param[in] cells If not NULL, only these cells are written.
+  /// \param[in] regions If not NULL, only the triangles reaching into these
+  ///            regions are voxelized, they must cover cells.
+  void VoxelizeCollisions(const SamplingGrid& grid, const CellVector* cells,
+                          const std::vector<CellBox>* regions,
+                          std::vector<bool>* occupied_cells);
+
+  /// \brief Collects cells of the sampling grid, one x slab at a time, on
+  ///        worker threads and merges them into the octomap.
+  /// \param[in] num_slabs Number of cells of the grid along x.
+  /// \param[in] description Name of the step in the progress messages.
+  /// \param[in] init_thread Called once on every worker before collecting.
+  /// \param[in] collect Collects the cells of one slab, given the index of
+  ///            the worker and of the slab.
+  /// \param[in] merge Merges the cells of one slab, given the index of the
+  ///            slab, called on this thread in slab order.
+  /// \param[in] merge_while_collecting Merge slabs while the workers are still
+  ///            running. Only allowed if collect does not read what merge writes.
+  template <class Cell>
+  void ProcessSlabs(int num_slabs, const std::string& description,
+                    const std::function<void()>& init_thread,
+                    const std::function<void(int, int, std::vector<Cell>*)>& collect,
+                    const std::function<void(int, const std::vector<Cell>&)>& merge,
+                    bool merge_while_collecting);
+
+  /// \brief Marks all cells connected to the seed cell that are not occupied
+  ///        as free, one span of cells along z at a time.
+  /// \param[in] occupied_cells Dense bitmap of the occupied cells of the grid.
+  /// \param[in,out] free_cells Dense bitmap of the free cells of the grid.
+  /// \param[out] filled_cells If not NULL, the cells that were marked free.
+  void FloodFill(const SamplingGrid& grid, int ix, int iy, int iz,
+                 const std::vector<bool>& occupied_cells,
+                 std::vector<bool>* free_cells,
+                 CellVector* filled_cells = NULL);
+
+  /// \brief Hash of the models in the world and of the requested bounding
+  ///        box and leaf size, identifies a cached octomap.
+  uint64_t OctomapHash(const rotors_comm::Octomap::Request& msg) const;
+
+  /// \brief Replaces the octomap by an empty one.
+  void ResetOctomap(double leaf_size);
+
+  /// \brief Bounding boxes of all models in the world.
+  ModelBoundsMap ModelBounds() const;
+
+  /// \brief Cells of the grid overlapping a box, grown by one cell on every
+  ///        side. Non-finite bounds extend to the end of the grid.
+  static CellBox CellsInBox(const SamplingGrid& grid,
+                            const ignition::math::Box& box);
+
+  /*! \brief Updates the octomap of the last full build to the moved, added
+  *          and removed models.
+  *
+  * Only the cells overlapping the old and the new bounding boxes of the
+  * changed models are ray tested again. Their free space is flood filled from
+  * the free cells around them, which also frees unknown space that a moved
+  * model opened up. Space that an added model encloses outside of its
+  * bounding box stays free until the next full build.
+  *
+  * The changed cells are published as an octomap diff, an octomap whose
+  * known cells replace those of the previous map.
+  */
+  void UpdateOctomap(const rotors_comm::Octomap::Request& msg);
+
+  /// \brief Publishes the current octomap in tiles of the sampling grid, so
+  ///        that only the octomap of one tile is serialized at a time.
+  /// \param[in] chunk_size Side length of the tiles [m], rounded to cells.
+  /// \return Number of published chunks.
+  uint32_t PublishOctomapChunks(double chunk_size, const ros::Time& stamp);
   
   /*! \brief Creates octomap by floodfilling freespace.
   *
   * Creates an octomap of the environment in 3 steps:
   *   -# Casts rays along the central X,Y and Z axis of each cell. Marks any 
-  *     cell where a ray intersects a mesh as occupied
+  *     cell where a ray intersects a mesh as occupied. The cells are split
+  *     into x slabs that are processed in parallel, with one ray per thread.
+  *     In hierarchical mode, the slabs are subdivided recursively and only
+  *     cells that the bounds of a collision reach into are ray tested, which
+  *     gives the same map.
+  *     In mesh voxelization mode, no ray is cast, every cell that the
+  *     triangulated collision shapes touch is marked instead.
   *   -# Floodfills the area from the top and bottom marking all connected
-  *     space that has not been set to occupied as free.
+  *     space that has not been set to occupied as free. Both are tracked in
+  *     dense bitmaps of the grid, the octomap is only built at the end.
   *   -# Labels all remaining unknown space as occupied.
   *
   * Can give incorrect results in the following situations:
@@ -76,7 +250,13 @@ class OctomapFromGazeboWorld : public WorldPlugin {
   *     completely enclosed by occupied cells.
   *   -# A completely enclosed hollow space will be marked as occupied.
   *   -# Cells containing a mesh that does not intersect its central axes will
-  *     be marked as unoccupied
+  *     be marked as unoccupied, unless the meshes are voxelized.
+  *
+  * The octomap is reused if the world and the request did not change since
+  * the last call, and is loaded from the cache directory if it has been
+  * created there before. In incremental mode, requests for the same grid
+  * only update the cells around the models that changed, see
+  * UpdateOctomap().
   */
   void CreateOctomap(const rotors_comm::Octomap::Request& msg);
 
@@ -84,10 +264,40 @@ class OctomapFromGazeboWorld : public WorldPlugin {
   physics::WorldPtr world_;
   ros::NodeHandle node_handle_;
   ros::ServiceServer srv_;
+  ros::ServiceServer esdf_srv_;
   octomap::OcTree* octomap_;
   ros::Publisher octomap_publisher_;
+  ros::Publisher octomap_diff_publisher_;
+  ros::Publisher octomap_chunk_publisher_;
+  /// \brief Number of threads the octomap is created with.
+  int num_threads_;
+  /// \brief Only ray test the cells close to collision geometry.
+  bool hierarchical_;
+  /// \brief Directory the octomaps are cached in, disabled if empty.
+  std::string cache_directory_;
+  /// \brief Hash of the current octomap, see OctomapHash().
+  uint64_t octomap_hash_;
+  /// \brief Update the octomap incrementally, see UpdateOctomap().
+  bool incremental_;
+  /// \brief Serve distance fields, see EsdfServiceCallback().
+  bool esdf_;
+  /// \brief Voxelize the collision shapes, see VoxelizeCollisions().
+  bool mesh_voxelization_;
+  /// \brief Grid the current octomap was sampled on.
+  SamplingGrid grid_;
+  /// \brief The bitmaps and the model bounds below describe the current
+  ///        octomap. Only kept in incremental or ESDF mode, and not for an
+  ///        octomap read from the cache.
+  bool has_incremental_state_;
+  std::vector<bool> occupied_cells_;
+  std::vector<bool> free_cells_;
+  ModelBoundsMap model_bounds_;
   bool ServiceCallback(rotors_comm::Octomap::Request& req,
                        rotors_comm::Octomap::Response& res);
+  /// \brief Creates the octomap of the request and writes the signed
+  ///        distance field of its cells to req.filename, see esdf.h.
+  bool EsdfServiceCallback(rotors_comm::Esdf::Request& req,
+                           rotors_comm::Esdf::Response& res);
 };
 
 } // namespace gazebo
@@ -24,9 +24,9 @@
 #define ROTORS_GAZEBO_PLUGINS_GAZEBO_ODOMETRY_PLUGIN_H
 
 #include <cmath>
-#include <deque>
 #include <random>
 #include <stdio.h>
+#include <vector>
 
 #include <boost/array.hpp>
 #include <boost/bind.hpp>
@@ -34,14 +34,26 @@
 #include <gazebo/common/Plugin.hh>
 #include <gazebo/gazebo.hh>
 #include <gazebo/physics/physics.hh>
-#include <opencv2/core/core.hpp>
 
 #include <mav_msgs/default_topics.h>  // This comes from the mav_comm repo
 
 #include "rotors_gazebo_plugins/common.h"
+#include "rotors_gazebo_plugins/covariance_map.h"
+#include "rotors_gazebo_plugins/measurement_delay_queue.h"
+#include "rotors_gazebo_plugins/model_fidelity.h"
+#include "rotors_gazebo_plugins/rigid_body_state.h"
+#include "rotors_gazebo_plugins/ros_bridge_connector.h"
 #include "rotors_gazebo_plugins/sdf_api_wrapper.hpp"
+#include "rotors_gazebo_plugins/shm_records.h"
+#include "rotors_gazebo_plugins/shm_ring.h"
+#include "rotors_gazebo_plugins/simulation_checkpoint.h"
+#include "rotors_gazebo_plugins/update_dispatcher.h"
 
 #include "Odometry.pb.h"
+#include "PoseWithCovarianceStamped.pb.h"
+#include "TransformStamped.pb.h"
+#include "TransformStampedWithFrameIds.pb.h"
+#include "Vector3dStamped.pb.h"
 
 
 namespace gazebo {
@@ -53,16 +65,33 @@ static const std::string kDefaultLinkName = "odometry_sensor_link";
 
 static constexpr int kDefaultMeasurementDelay = 0;
 static constexpr int kDefaultMeasurementDivisor = 1;
+static constexpr int kDefaultOutputDivisor = 1;
 static constexpr int kDefaultGazeboSequence = 0;
 static constexpr int kDefaultOdometrySequence = 0;
 static constexpr double kDefaultUnknownDelay = 0.0;
 static constexpr double kDefaultCovarianceImageScale = 1.0;
+/// \brief  Noise scale at the lowest nonzero covariance map intensity, the
+///         default leaves the noise unscaled.
+static constexpr double kDefaultCovarianceImageMaxNoiseScale = 1.0;
 
 class GazeboOdometryPlugin : public ModelPlugin {
  public:
   typedef std::normal_distribution<> NormalDistribution;
   typedef std::uniform_real_distribution<> UniformDistribution;
-  typedef std::deque<std::pair<int, gz_geometry_msgs::Odometry> > OdometryQueue;
+
+  /// \brief  A noise-free measurement waiting for its publish time.
+  struct OdometryMeasurement {
+    int32_t stamp_sec;
+    int32_t stamp_nsec;
+    ignition::math::Pose3d pose;
+    ignition::math::Vector3d linear_velocity;
+    ignition::math::Vector3d angular_velocity;
+    /// \brief  Factor on the noise standard deviations, from the covariance
+    ///         map at the measured position.
+    double noise_scale;
+  };
+  /// \brief  Measurements keyed by the Gazebo sequence they are published at.
+  typedef MeasurementDelayQueue<OdometryMeasurement> OdometryQueue;
   typedef boost::array<double, 36> CovarianceMatrix;
 
   GazeboOdometryPlugin()
@@ -84,6 +113,15 @@ class GazeboOdometryPlugin : public ModelPlugin {
         gazebo_sequence_(kDefaultGazeboSequence),
         odometry_sequence_(kDefaultOdometrySequence),
         covariance_image_scale_(kDefaultCovarianceImageScale),
+        covariance_image_max_noise_scale_(kDefaultCovarianceImageMaxNoiseScale),
+        published_noise_scale_(1.0),
+        pose_divisor_(kDefaultOutputDivisor),
+        pose_with_covariance_stamped_divisor_(kDefaultOutputDivisor),
+        position_stamped_divisor_(kDefaultOutputDivisor),
+        transform_stamped_divisor_(kDefaultOutputDivisor),
+        odometry_divisor_(kDefaultOutputDivisor),
+        broadcast_transform_divisor_(kDefaultOutputDivisor),
+        shm_transport_(kDefaultShmTransport),
         pubs_and_subs_created_(false) {}
 
   ~GazeboOdometryPlugin();
@@ -107,8 +145,51 @@ class GazeboOdometryPlugin : public ModelPlugin {
   ///           has loaded and listening to ConnectGazeboToRosTopic and ConnectRosToGazeboTopic messages).
   void CreatePubsAndSubs();
 
+  /// \brief    Adds noise to a measurement and publishes it on all outputs
+  ///           that are due and have subscribers.
+  /// \details  Outputs are due on every n-th published measurement, with n
+  ///           their divisor. The noise is only sampled if at least one
+  ///           output is published, and not at all if add_noise is false.
+  void PublishMeasurement(const OdometryMeasurement& measurement,
+                          bool add_noise = true);
+
+  /// \brief    Writes the random number generator, the noise distributions
+  ///           and the delayed measurements to a checkpoint.
+  void SaveCheckpoint(CheckpointWriter* writer);
+  bool RestoreCheckpoint(CheckpointReader* reader);
+
+  /// \brief    Returns true if the output with the given divisor is due for the
+  ///           current measurement and has subscribers.
+  bool OutputDue(const gazebo::transport::PublisherPtr& publisher,
+                 int divisor) const {
+    return odometry_sequence_ % divisor == 0 && publisher->HasConnections();
+  }
+
+  /// \brief    Delayed odometry measurements.
+  /// \details  The queue is sized in Load() to hold all measurements that
+  ///           can be delayed at the same time, so that OnUpdate() does not
+  ///           allocate. The messages are only built when a measurement is
+  ///           published.
   OdometryQueue odometry_queue_;
 
+  // Messages built from the published measurement, reused for every publish.
+  gz_geometry_msgs::Odometry odometry_msg_;
+  gz_geometry_msgs::PoseWithCovarianceStamped pose_with_covariance_stamped_msg_;
+  gz_geometry_msgs::Vector3dStamped position_stamped_msg_;
+  gz_geometry_msgs::TransformStamped transform_stamped_msg_;
+  gz_geometry_msgs::TransformStampedWithFrameIds
+      transform_stamped_with_frame_ids_msg_;
+
+  /// \brief    Write the odometry to a shared memory ring, read from SDF.
+  /// \details  The ring takes the divisor of the odometry topic. The ROS
+  ///           interface plugin reads it directly, the odometry message is
+  ///           then only published if somebody else subscribes to it.
+  bool shm_transport_;
+  ShmRingWriter<ShmOdometryRecord> odometry_shm_;
+  /// \brief    Record written to odometry_shm_, its covariances are set in
+  ///           Load().
+  ShmOdometryRecord odometry_record_;
+
   std::string namespace_;
   std::string pose_pub_topic_;
   std::string pose_with_covariance_stamped_pub_topic_;
@@ -133,16 +214,41 @@ class GazeboOdometryPlugin : public ModelPlugin {
 
   int measurement_delay_;
   int measurement_divisor_;
+  /// \brief  Offset of the measurement steps, staggered against the
+  ///         measurements of the other vehicles.
+  UpdateOffsetPtr measurement_offset_;
   int gazebo_sequence_;
+  /// \brief  Number of measurements that reached their publish time.
   int odometry_sequence_;
   double unknown_delay_;
+  /// \brief  Resolution of a covariance image [m/pixel], tiled covariance
+  ///         maps store their own.
   double covariance_image_scale_;
-  cv::Mat covariance_image_;
+  /// \brief  Noise scale at intensity 1 of the covariance map, falling
+  ///         linearly to 1 at intensity 255. Intensity 0 drops the
+  ///         measurement.
+  double covariance_image_max_noise_scale_;
+  /// \brief  Noise scale of the covariances in odometry_msg_ and
+  ///         odometry_record_.
+  double published_noise_scale_;
+
+  // Every n-th published measurement is sent on the respective output.
+  int pose_divisor_;
+  int pose_with_covariance_stamped_divisor_;
+  int position_stamped_divisor_;
+  int transform_stamped_divisor_;
+  int odometry_divisor_;
+  int broadcast_transform_divisor_;
+  /// \brief  Covariance map shared with the other odometry plugins, NULL
+  ///         if none is configured.
+  std::shared_ptr<const CovarianceMap> covariance_map_;
 
   std::random_device random_device_;
   std::mt19937 random_generator_;
 
   gazebo::transport::NodePtr node_handle_;
+  /// \brief  Requests the Gazebo->ROS connections of the plugin.
+  RosBridgeConnector ros_bridge_connector_;
 
   gazebo::transport::PublisherPtr pose_pub_;
   gazebo::transport::PublisherPtr pose_with_covariance_stamped_pub_;
@@ -159,10 +265,15 @@ class GazeboOdometryPlugin : public ModelPlugin {
   physics::WorldPtr world_;
   physics::ModelPtr model_;
   physics::LinkPtr link_;
+  std::shared_ptr<RigidBodyStateCache> link_state_;
   physics::EntityPtr parent_link_;
 
+  /// \brief    Level of detail of the sensors of the model.
+  std::shared_ptr<ModelFidelity> fidelity_;
+
   /// \brief    Pointer to the update event connection.
-  event::ConnectionPtr updateConnection_;
+  UpdateConnectionPtr updateConnection_;
+  CheckpointConnectionPtr checkpoint_connection_;
 
   boost::thread callback_queue_thread_;
   void QueueThread();
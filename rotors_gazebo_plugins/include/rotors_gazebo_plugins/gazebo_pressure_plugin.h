@@ -17,7 +17,9 @@
 #ifndef ROTORS_GAZEBO_PLUGINS_PRESSURE_PLUGIN_H
 #define ROTORS_GAZEBO_PLUGINS_PRESSURE_PLUGIN_H
 
+#include <cmath>
 #include <random>
+#include <vector>
 
 #include <glog/logging.h>
 
@@ -29,6 +31,11 @@
 #include "FluidPressure.pb.h"
 
 #include "rotors_gazebo_plugins/common.h"
+#include "rotors_gazebo_plugins/model_fidelity.h"
+#include "rotors_gazebo_plugins/publish_policy.h"
+#include "rotors_gazebo_plugins/rigid_body_state.h"
+#include "rotors_gazebo_plugins/ros_bridge_connector.h"
+#include "rotors_gazebo_plugins/update_dispatcher.h"
 
 namespace gazebo {
 // Constants
@@ -47,6 +54,47 @@ static constexpr double kAirConstantDimensionless = kGravityMagnitude *
 static const std::string kDefaultPressurePubTopic = "air_pressure";
 static constexpr double kDefaultRefAlt = 500.0; /* m, Zurich: h=+500m, WGS84) */
 static constexpr double kDefaultPressureVar = 0.0; /* Pa^2, pressure variance */
+static constexpr int kDefaultPressureMeasurementDivisor = 1;
+/* m, world heights covered by the pressure table */
+static constexpr double kDefaultPressureTableMinHeight = -100.0;
+static constexpr double kDefaultPressureTableMaxHeight = 1000.0;
+static constexpr double kDefaultPressureTableResolution = 1.0; /* m */
+
+/// \brief    ISA pressure over geometric altitude, sampled on a uniform grid.
+/// \details  The error of the linear interpolation is at most resolution^2
+///           / 8 times the curvature of the pressure, below 1.5e-4 Pa above
+///           sea level for samples 1 m apart, far below any barometer noise.
+///           Altitudes outside the table are evaluated with the closed form.
+class IsaPressureTable {
+ public:
+  IsaPressureTable()
+      : min_altitude_(0.0), inv_resolution_(0.0), last_sample_(0.0) {}
+
+  /// \brief  Samples the pressure from min_altitude to max_altitude [m].
+  void Build(double min_altitude, double max_altitude, double resolution);
+
+  /// \brief  Pressure at a geometric altitude [Pa].
+  double Pressure(double altitude) const {
+    const double position = (altitude - min_altitude_) * inv_resolution_;
+    if (position >= 0.0 && position < last_sample_) {
+      const std::size_t index = static_cast<std::size_t>(position);
+      const double fraction = position - index;
+      return pressures_[index] +
+             fraction * (pressures_[index + 1] - pressures_[index]);
+    }
+    return IsaPressure(altitude);
+  }
+
+  /// \brief  The ISA barometric formula at a geometric altitude [Pa].
+  static double IsaPressure(double altitude);
+
+ private:
+  double min_altitude_;
+  double inv_resolution_;
+  /// \brief  Index of the last sample, as the upper bound of the lookup.
+  double last_sample_;
+  std::vector<double> pressures_;
+};
 
 class GazeboPressurePlugin : public ModelPlugin {
  public:
@@ -79,6 +127,8 @@ class GazeboPressurePlugin : public ModelPlugin {
 
   /// \brief    Handle for the Gazebo node.
   gazebo::transport::NodePtr node_handle_;
+  /// \brief  Requests the Gazebo->ROS connections of the plugin.
+  RosBridgeConnector ros_bridge_connector_;
 
   /// \brief    Pressure message publisher.
   gazebo::transport::PublisherPtr pressure_pub_;
@@ -101,8 +151,15 @@ class GazeboPressurePlugin : public ModelPlugin {
   /// \brief    Pointer to the link.
   physics::LinkPtr link_;
 
+  /// \brief    State snapshot of the canonical link of the model, whose
+  ///           height the pressure is computed at.
+  std::shared_ptr<RigidBodyStateCache> model_state_;
+
+  /// \brief    Sensor level of detail of the model.
+  std::shared_ptr<ModelFidelity> fidelity_;
+
   /// \brief    Pointer to the update event connection.
-  event::ConnectionPtr updateConnection_;
+  UpdateConnectionPtr updateConnection_;
 
   /// \brief    Reference altitude (meters).
   double ref_alt_;
@@ -110,6 +167,15 @@ class GazeboPressurePlugin : public ModelPlugin {
   /// \brief    Pressure measurement variance (Pa^2).
   double pressure_var_;
 
+  /// \brief    A measurement is published every measurement_divisor_
+  ///           physics steps, to run the barometer at its real rate.
+  int measurement_divisor_;
+  /// \brief    Offset of the measurement steps, staggered against the
+  ///           measurements of the other vehicles.
+  UpdateOffsetPtr measurement_offset_;
+
+  IsaPressureTable pressure_table_;
+
   /// \brief    Normal distribution for pressure noise.
   NormalDistribution pressure_n_[1];
 
@@ -117,6 +183,7 @@ class GazeboPressurePlugin : public ModelPlugin {
   /// \details  This is modified everytime OnUpdate() is called,
   //            and then published onto a topic
   gz_sensor_msgs::FluidPressure pressure_message_;
+  PublishPolicy publish_policy_;
 
   std::mt19937 random_generator_;
 };
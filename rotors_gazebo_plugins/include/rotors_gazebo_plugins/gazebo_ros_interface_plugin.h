@@ -18,7 +18,14 @@
 #define ROTORS_GAZEBO_PLUGINS_MSG_INTERFACE_PLUGIN_H
 
 // SYSTEM INCLUDES
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <random>
+#include <thread>
+#include <unordered_map>
 
 #include <Eigen/Core>
 #include <gazebo/common/Plugin.hh>
@@ -35,6 +42,7 @@
 
 //============= GAZEBO MSG TYPES ==============//
 #include "ConnectGazeboToRosTopic.pb.h"
+#include "ConnectGazeboToRosTopics.pb.h"
 #include "ConnectRosToGazeboTopic.pb.h"
 
 #include "Actuators.pb.h"
@@ -42,12 +50,14 @@
 #include "Float32.pb.h"
 #include "FluidPressure.pb.h"
 #include "Imu.pb.h"
+#include "ImuDelta.pb.h"
 #include "JointState.pb.h"
 #include "MagneticField.pb.h"
 #include "NavSatFix.pb.h"
 #include "Odometry.pb.h"
 #include "PoseWithCovarianceStamped.pb.h"
 #include "RollPitchYawrateThrust.pb.h"
+#include "SwarmTelemetry.pb.h"
 #include "TransformStamped.pb.h"
 #include "TransformStampedWithFrameIds.pb.h"
 #include "TwistStamped.pb.h"
@@ -66,6 +76,9 @@
 #include <mav_msgs/Actuators.h>
 #include <mav_msgs/RollPitchYawrateThrust.h>
 #include <nav_msgs/Odometry.h>
+#include <rotors_comm/ImuDelta.h>
+#include <rotors_comm/SetFidelity.h>
+#include <rotors_comm/SwarmTelemetry.h>
 #include <rotors_comm/WindSpeed.h>
 #include <sensor_msgs/FluidPressure.h>
 #include <sensor_msgs/Imu.h>
@@ -75,12 +88,18 @@
 #include <std_msgs/Float32.h>
 
 #include "rotors_gazebo_plugins/common.h"
+#include "rotors_gazebo_plugins/model_fidelity.h"
+#include "rotors_gazebo_plugins/shm_records.h"
+#include "rotors_gazebo_plugins/shm_ring.h"
+#include "rotors_gazebo_plugins/swarm_shard_link.h"
 
 namespace gazebo {
 
 // typedef's to make life easier
 typedef const boost::shared_ptr<const gz_std_msgs::ConnectGazeboToRosTopic>
     GzConnectGazeboToRosTopicMsgPtr;
+typedef const boost::shared_ptr<const gz_std_msgs::ConnectGazeboToRosTopics>
+    GzConnectGazeboToRosTopicsMsgPtr;
 typedef const boost::shared_ptr<const gz_std_msgs::ConnectRosToGazeboTopic>
     GzConnectRosToGazeboTopicMsgPtr;
 typedef const boost::shared_ptr<const gz_std_msgs::Float32> GzFloat32MsgPtr;
@@ -103,18 +122,122 @@ typedef const boost::shared_ptr<const gz_geometry_msgs::WrenchStamped>
     GzWrenchStampedMsgPtr;
 typedef const boost::shared_ptr<const gz_mav_msgs::RollPitchYawrateThrust>
     GzRollPitchYawrateThrustPtr;
+typedef const boost::shared_ptr<const gz_mav_msgs::SwarmTelemetry>
+    GzSwarmTelemetryMsgPtr;
 typedef const boost::shared_ptr<const gz_mav_msgs::WindSpeed> GzWindSpeedMsgPtr;
 typedef const boost::shared_ptr<const gz_sensor_msgs::Actuators>
     GzActuatorsMsgPtr;
 typedef const boost::shared_ptr<const gz_sensor_msgs::FluidPressure>
     GzFluidPressureMsgPtr;
 typedef const boost::shared_ptr<const gz_sensor_msgs::Imu> GzImuPtr;
+typedef const boost::shared_ptr<const gz_sensor_msgs::ImuDelta> GzImuDeltaPtr;
 typedef const boost::shared_ptr<const gz_sensor_msgs::JointState>
     GzJointStateMsgPtr;
 typedef const boost::shared_ptr<const gz_sensor_msgs::MagneticField>
     GzMagneticFieldMsgPtr;
 typedef const boost::shared_ptr<const gz_sensor_msgs::NavSatFix> GzNavSatFixPtr;
 
+// Default values
+static constexpr double kDefaultConversionStatsInterval = 0.0;
+static constexpr int kDefaultNumBridgeThreads = 0;
+static constexpr int kDefaultBridgeQueueSize = 16;
+static constexpr bool kDefaultBridgeDropOldest = true;
+/// \brief  Number of preallocated ROS messages per Gazebo->ROS connection.
+static constexpr std::size_t kRosMessagePoolSize = 4;
+/// \brief  Number of queued messages a bridge worker handles on one topic,
+///         before it moves on to the next topic.
+static constexpr std::size_t kBridgeBatchSize = 8;
+/// \brief  Highest rate of the transforms broadcast per child frame [Hz],
+///         0 for no limit.
+static constexpr double kDefaultTfMaxRate = 0.0;
+
+/// \brief    Number of messages bridged from Gazebo to ROS on one topic, and
+///           the wall time spent converting them.
+struct BridgeTopicStats {
+  BridgeTopicStats()
+      : num_messages(0),
+        total_conversion_ns(0),
+        max_conversion_ns(0),
+        queue_depth(0),
+        max_queue_depth(0),
+        num_dropped(0) {}
+
+  std::atomic<uint64_t> num_messages;
+  std::atomic<uint64_t> total_conversion_ns;
+  std::atomic<uint64_t> max_conversion_ns;
+
+  // Only used with bridge worker threads.
+  std::atomic<uint64_t> queue_depth;
+  std::atomic<uint64_t> max_queue_depth;
+  /// \brief  Messages dropped because the queue of the topic was full.
+  std::atomic<uint64_t> num_dropped;
+};
+
+/// \brief  Index of a connection in the registry of the ROS interface plugin.
+typedef std::size_t BridgeConnectionHandle;
+
+/// \brief    A Gazebo->ROS connection, owned by the ROS interface plugin.
+class BridgeConnection {
+ public:
+  BridgeConnection(const std::string& gazebo_topic,
+                   const std::string& ros_topic)
+      : gazebo_topic(gazebo_topic), ros_topic(ros_topic) {}
+  virtual ~BridgeConnection() {}
+
+  /// \brief  Converts and publishes up to kBridgeBatchSize queued messages.
+  ///         Only called by one worker at a time.
+  /// \return True if messages are left and the connection has to be
+  ///         scheduled again.
+  virtual bool ProcessQueued() = 0;
+
+  const std::string gazebo_topic;
+  const std::string ros_topic;
+  BridgeTopicStats stats;
+  transport::SubscriberPtr subscriber;
+};
+
+/// \brief    A Gazebo->ROS connection that reads the records of a shared
+///           memory ring instead of subscribing to the Gazebo topic.
+/// \details  The ring is polled at the end of every world update, on the
+///           physics thread, so it never goes through the bridge workers.
+class ShmBridgeConnection : public BridgeConnection {
+ public:
+  ShmBridgeConnection(const std::string& gazebo_topic,
+                      const std::string& ros_topic)
+      : BridgeConnection(gazebo_topic, ros_topic) {}
+
+  bool ProcessQueued() override { return false; }
+
+  /// \brief  Converts and publishes all records written since the last poll.
+  virtual void Poll() = 0;
+};
+
+/// \brief    Threads that convert and publish the Gazebo->ROS messages, off
+///           the Gazebo transport threads.
+/// \details  A connection is scheduled when a message is queued for it and
+///           none of its messages is pending, so that the messages of a topic
+///           are published in order, by one worker at a time.
+class BridgeWorkerPool {
+ public:
+  BridgeWorkerPool() : stopping_(false) {}
+  ~BridgeWorkerPool() { Stop(); }
+
+  void Start(int num_threads);
+  /// \brief  Joins the workers, messages still queued are not published.
+  void Stop();
+
+  void Schedule(BridgeConnection* connection);
+
+ private:
+  void WorkerThread();
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<BridgeConnection*> ready_;
+  bool stopping_;
+  std::vector<std::thread> threads_;
+};
+
 /// \brief    ROS interface plugin for Gazebo.
 /// \details  This routes messages to/from Gazebo and ROS. This is used
 ///           so that individual plugins are not ROS dependent.
@@ -135,6 +258,10 @@ class GazeboRosInterfacePlugin : public WorldPlugin {
   /// \details	Calculates IMU parameters and then publishes one IMU message.
   void OnUpdate(const common::UpdateInfo&);
 
+  /// \brief  This gets called by the world update end event, and polls the
+  ///         shared memory rings.
+  void OnUpdateEnd();
+
  private:
   /// \brief  Provides a way for GzConnectGazeboToRosTopicMsgCallback() to
   ///         connect a Gazebo subscriber to a ROS publisher.
@@ -142,16 +269,59 @@ class GazeboRosInterfacePlugin : public WorldPlugin {
   ///   GazeboMsgT  The type of the message that will be subscribed to the
   ///   Gazebo framework.
   ///   RosMsgT     The type of the message published to the ROS framework.
+  ///   fp converts a Gazebo message into a ROS message taken from a pool of
+  ///   the connection, which is then published by shared pointer.
+  /// \return Handle of the new connection, or of the existing one if the
+  ///         Gazebo topic is already connected.
   template <typename GazeboMsgT, typename RosMsgT>
-  void ConnectHelper(void (GazeboRosInterfacePlugin::*fp)(
-                         const boost::shared_ptr<GazeboMsgT const>&,
-                         ros::Publisher),
-                     GazeboRosInterfacePlugin* ptr, std::string gazeboNamespace,
-                     std::string gazeboTopicName, std::string rosTopicName,
-                     transport::NodePtr gz_node_handle);
-
-  std::vector<gazebo::transport::NodePtr> nodePtrs_;
-  std::vector<gazebo::transport::SubscriberPtr> subscriberPtrs_;
+  BridgeConnectionHandle ConnectHelper(
+      void (GazeboRosInterfacePlugin::*fp)(
+          const boost::shared_ptr<GazeboMsgT const>&, RosMsgT*),
+      GazeboRosInterfacePlugin* ptr, std::string gazeboNamespace,
+      std::string gazeboTopicName, std::string rosTopicName,
+      transport::NodePtr gz_node_handle);
+
+  /// \brief  Connects the shared memory ring shm_name, which mirrors a Gazebo
+  ///         topic, to a ROS publisher.
+  /// \details fp converts a record into a ROS message, and also gets the
+  ///         reader for the frame ids stored in the ring.
+  /// \return False if the ring can't be opened.
+  template <typename RecordT, typename RosMsgT>
+  bool ShmConnectHelper(
+      void (GazeboRosInterfacePlugin::*fp)(
+          const RecordT&, const ShmRingReader<RecordT>&, RosMsgT*),
+      const std::string& gazeboTopicName, const std::string& rosTopicName,
+      const std::string& shmName);
+
+  /// \brief  Logs the conversion statistics of all connected topics.
+  void PrintConversionStats();
+
+  /// \brief  Registry of the Gazebo->ROS connections of this plugin, indexed
+  ///         by their handle. Connections are never removed while the plugin
+  ///         is loaded, the Gazebo subscribers and the bridge workers keep
+  ///         pointers to them.
+  std::vector<std::unique_ptr<BridgeConnection> > connections_;
+  /// \brief  Handles of the connections, by Gazebo topic.
+  std::unordered_map<std::string, BridgeConnectionHandle> connection_handles_;
+  std::mutex connections_mutex_;
+  /// \brief  The connections of connections_ that read a shared memory ring.
+  std::vector<ShmBridgeConnection*> shm_connections_;
+
+  /// \brief  Subscribers of the ROS->Gazebo connections.
+  std::vector<ros::Subscriber> ros_subscribers_;
+
+  /// \brief  Switches the sensor level of detail of a model.
+  /// \details In a sharded world (see SwarmShardLink), only the gateway
+  ///          advertises set_fidelity, and forwards the requests for the
+  ///          models of another shard to its shard_<id>/set_fidelity.
+  ros::ServiceServer set_fidelity_service_;
+  bool SetFidelityCallback(rotors_comm::SetFidelity::Request& request,
+                           rotors_comm::SetFidelity::Response& response);
+
+  /// \brief  Shard of this world, negative if it is not sharded.
+  int shard_id_;
+  bool shard_gateway_;
+  double shard_timeout_;
 
   // std::string namespace_;
 
@@ -166,6 +336,22 @@ class GazeboRosInterfacePlugin : public WorldPlugin {
 
   /// \brief  Pointer to the update event connection.
   event::ConnectionPtr updateConnection_;
+  event::ConnectionPtr updateEndConnection_;
+
+  /// \brief  Interval of logging the conversion statistics [s], 0 to only log
+  ///         them when the plugin is unloaded.
+  double conversion_stats_interval_;
+  common::Time last_conversion_stats_time_;
+
+  /// \brief  Number of bridge worker threads, 0 to convert and publish the
+  ///         Gazebo->ROS messages on the Gazebo transport threads.
+  int num_bridge_threads_;
+  /// \brief  Number of messages queued per topic for the bridge workers.
+  int bridge_queue_size_;
+  /// \brief  Drop the oldest queued message of a full queue, rather than the
+  ///         new one.
+  bool bridge_drop_oldest_;
+  BridgeWorkerPool bridge_workers_;
 
   // ============================================ //
   // ====== CONNECT GAZEBO TO ROS MESSAGES ====== //
@@ -175,6 +361,20 @@ class GazeboRosInterfacePlugin : public WorldPlugin {
   void GzConnectGazeboToRosTopicMsgCallback(
       GzConnectGazeboToRosTopicMsgPtr& gz_connect_gazebo_to_ros_topic_msg);
 
+  /// \brief  Connects all topics of a batch, sent by a RosBridgeConnector.
+  transport::SubscriberPtr gz_connect_gazebo_to_ros_topics_sub_;
+  void GzConnectGazeboToRosTopicsMsgCallback(
+      GzConnectGazeboToRosTopicsMsgPtr& gz_connect_gazebo_to_ros_topics_msg);
+
+  void ConnectGazeboToRosTopic(const gz_std_msgs::ConnectGazeboToRosTopic&
+                                   gz_connect_gazebo_to_ros_topic_msg);
+
+  /// \brief  Connects the shared memory ring named in the message.
+  /// \return False if the message type has no ring, or the ring can't be
+  ///         opened, and the Gazebo topic has to be subscribed instead.
+  bool ConnectShmRingToRosTopic(const gz_std_msgs::ConnectGazeboToRosTopic&
+                                    gz_connect_gazebo_to_ros_topic_msg);
+
   // ============================================ //
   // ====== CONNECT ROS TO GAZEBO MESSAGES ====== //
   // ============================================ //
@@ -213,81 +413,96 @@ class GazeboRosInterfacePlugin : public WorldPlugin {
 
   // ACTUATORS
   void GzActuatorsMsgCallback(GzActuatorsMsgPtr& gz_actuators_msg,
-                              ros::Publisher ros_publisher);
-  mav_msgs::Actuators ros_actuators_msg_;
+                              mav_msgs::Actuators* ros_actuators_msg);
 
   // FLOAT32
   void GzFloat32MsgCallback(GzFloat32MsgPtr& gz_float_32_msg,
-                            ros::Publisher ros_publisher);
-  std_msgs::Float32 ros_float_32_msg_;
+                            std_msgs::Float32* ros_float_32_msg);
 
   // FLUID PRESSURE
-  void GzFluidPressureMsgCallback(GzFluidPressureMsgPtr& gz_fluid_pressure_msg,
-                                  ros::Publisher ros_publisher);
-  sensor_msgs::FluidPressure ros_fluid_pressure_msg_;
+  void GzFluidPressureMsgCallback(
+      GzFluidPressureMsgPtr& gz_fluid_pressure_msg,
+      sensor_msgs::FluidPressure* ros_fluid_pressure_msg);
 
   // IMU
-  void GzImuMsgCallback(GzImuPtr& gz_imu_msg, ros::Publisher ros_publisher);
-  sensor_msgs::Imu ros_imu_msg_;
+  void GzImuMsgCallback(GzImuPtr& gz_imu_msg, sensor_msgs::Imu* ros_imu_msg);
+
+  // IMU DELTA
+  void GzImuDeltaMsgCallback(GzImuDeltaPtr& gz_imu_delta_msg,
+                             rotors_comm::ImuDelta* ros_imu_delta_msg);
 
   // JOINT STATE
   void GzJointStateMsgCallback(GzJointStateMsgPtr& gz_joint_state_msg,
-                               ros::Publisher ros_publisher);
-  sensor_msgs::JointState ros_joint_state_msg_;
+                               sensor_msgs::JointState* ros_joint_state_msg);
 
   // MAGNETIC FIELD
-  void GzMagneticFieldMsgCallback(GzMagneticFieldMsgPtr& gz_magnetic_field_msg,
-                                  ros::Publisher ros_publisher);
-  sensor_msgs::MagneticField ros_magnetic_field_msg_;
+  void GzMagneticFieldMsgCallback(
+      GzMagneticFieldMsgPtr& gz_magnetic_field_msg,
+      sensor_msgs::MagneticField* ros_magnetic_field_msg);
 
   // NAT SAT FIX (GPS)
   void GzNavSatFixCallback(GzNavSatFixPtr& gz_nav_sat_fix_msg,
-                           ros::Publisher ros_publisher);
-  sensor_msgs::NavSatFix ros_nav_sat_fix_msg_;
+                           sensor_msgs::NavSatFix* ros_nav_sat_fix_msg);
 
   // ODOMETRY
   void GzOdometryMsgCallback(GzOdometryMsgPtr& gz_odometry_msg,
-                             ros::Publisher ros_publisher);
-  nav_msgs::Odometry ros_odometry_msg_;
+                             nav_msgs::Odometry* ros_odometry_msg);
 
   // POSE
   void GzPoseMsgCallback(GzPoseMsgPtr& gz_pose_msg,
-                         ros::Publisher ros_publisher);
-  geometry_msgs::Pose ros_pose_msg_;
+                         geometry_msgs::Pose* ros_pose_msg);
 
   // POSE WITH COVARIANCE STAMPED
   void GzPoseWithCovarianceStampedMsgCallback(
       GzPoseWithCovarianceStampedMsgPtr& gz_pose_with_covariance_stamped_msg,
-      ros::Publisher ros_publisher);
-  geometry_msgs::PoseWithCovarianceStamped
-      ros_pose_with_covariance_stamped_msg_;
+      geometry_msgs::PoseWithCovarianceStamped*
+          ros_pose_with_covariance_stamped_msg);
 
   // POSITION STAMPED
   void GzVector3dStampedMsgCallback(
       GzVector3dStampedMsgPtr& gz_vector_3d_stamped_msg,
-      ros::Publisher ros_publisher);
-  geometry_msgs::PointStamped ros_position_stamped_msg_;
+      geometry_msgs::PointStamped* ros_position_stamped_msg);
+
+  // SWARM TELEMETRY
+  void GzSwarmTelemetryMsgCallback(
+      GzSwarmTelemetryMsgPtr& gz_swarm_telemetry_msg,
+      rotors_comm::SwarmTelemetry* ros_swarm_telemetry_msg);
 
   // TRANSFORM STAMPED
   void GzTransformStampedMsgCallback(
       GzTransformStampedMsgPtr& gz_transform_stamped_msg,
-      ros::Publisher ros_publisher);
-  geometry_msgs::TransformStamped ros_transform_stamped_msg_;
+      geometry_msgs::TransformStamped* ros_transform_stamped_msg);
 
   // TWIST STAMPED
-  void GzTwistStampedMsgCallback(GzTwistStampedMsgPtr& gz_twist_stamped_msg,
-                                 ros::Publisher ros_publisher);
-  geometry_msgs::TwistStamped ros_twist_stamped_msg_;
+  void GzTwistStampedMsgCallback(
+      GzTwistStampedMsgPtr& gz_twist_stamped_msg,
+      geometry_msgs::TwistStamped* ros_twist_stamped_msg);
 
   // WIND SPEED
   void GzWindSpeedMsgCallback(GzWindSpeedMsgPtr& gz_wind_speed_msg,
-                              ros::Publisher ros_publisher);
-  rotors_comm::WindSpeed ros_wind_speed_msg_;
+                              rotors_comm::WindSpeed* ros_wind_speed_msg);
 
   // WRENCH STAMPED
-  void GzWrenchStampedMsgCallback(GzWrenchStampedMsgPtr& gz_wrench_stamped_msg,
-                                  ros::Publisher ros_publisher);
-  geometry_msgs::WrenchStamped ros_wrench_stamped_msg_;
+  void GzWrenchStampedMsgCallback(
+      GzWrenchStampedMsgPtr& gz_wrench_stamped_msg,
+      geometry_msgs::WrenchStamped* ros_wrench_stamped_msg);
+
+  // ============================================ //
+  // ====== SHARED MEMORY->ROS CONVERTERS ======= //
+  // ============================================ //
+
+  void ShmImuRecordToRos(const ShmImuRecord& record,
+                         const ShmRingReader<ShmImuRecord>& ring,
+                         sensor_msgs::Imu* ros_imu_msg);
+
+  void ShmOdometryRecordToRos(const ShmOdometryRecord& record,
+                              const ShmRingReader<ShmOdometryRecord>& ring,
+                              nav_msgs::Odometry* ros_odometry_msg);
+
+  void ShmRotorVelocitiesRecordToRos(
+      const ShmRotorVelocitiesRecord& record,
+      const ShmRingReader<ShmRotorVelocitiesRecord>& ring,
+      mav_msgs::Actuators* ros_actuators_msg);
 
   // ============================================ //
   // ===== ROS->GAZEBO CALLBACKS/CONVERTERS ===== //
@@ -322,12 +537,33 @@ class GazeboRosInterfacePlugin : public WorldPlugin {
 
   /// \brief    This is a special-case callback which listens for Gazebo
   ///           "Transform" messages. Upon receiving one it
-  ///           broadcasts the transform on the ROS system (using
-  ///           transform_broadcast()).
+  ///           queues the transform for the next broadcast on the ROS system.
   void GzBroadcastTransformMsgCallback(
       GzTransformStampedWithFrameIdsMsgPtr& broadcast_transform_msg);
 
-  tf::Transform tf_;
+  /// \brief    Broadcasts the queued transforms as one tf message.
+  /// \details  Called at the end of every world update, so that the
+  ///           transforms of all vehicles in a step share one message.
+  void BroadcastQueuedTransforms();
+
+  /// \brief    State of the transforms of one child frame.
+  struct TfFrameState {
+    TfFrameState() : batch(0), index(0) {}
+    /// \brief  Batch and index in it of the last queued transform.
+    uint64_t batch;
+    std::size_t index;
+    ros::Time last_stamp;
+  };
+
+  /// \brief    Transforms are decimated to this rate per child frame [Hz].
+  double tf_max_rate_;
+  /// \brief    Transforms for the next broadcast, at most one per child frame.
+  std::vector<geometry_msgs::TransformStamped> queued_transforms_;
+  std::vector<geometry_msgs::TransformStamped> broadcast_transforms_;
+  /// \brief    Number of the batch in queued_transforms_.
+  uint64_t tf_batch_;
+  std::unordered_map<std::string, TfFrameState> tf_frames_;
+  std::mutex transforms_mutex_;
   tf::TransformBroadcaster transform_broadcaster_;
 };
 
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_GAZEBO_RTF_GOVERNOR_PLUGIN_H
+#define ROTORS_GAZEBO_PLUGINS_GAZEBO_RTF_GOVERNOR_PLUGIN_H
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <gazebo/common/common.hh>
+#include <gazebo/common/Plugin.hh>
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+
+#include "RtfGovernorStatus.pb.h"
+
+#include "rotors_gazebo_plugins/common.h"
+#include "rotors_gazebo_plugins/control_loop_monitor.h"
+#include "rotors_gazebo_plugins/update_dispatcher.h"
+
+namespace gazebo {
+
+// Default values
+static const std::string kDefaultRtfGovernorTopic = "rotors/rtf_governor";
+static constexpr double kDefaultRtfGovernorPeriod = 1.0;  // [s]
+static constexpr double kDefaultMinRealTimeFactor = 0.1;
+static constexpr double kDefaultMaxRealTimeFactor = 10.0;
+static constexpr double kDefaultInitialRealTimeFactor = 1.0;
+static constexpr double kDefaultRtfIncreaseFactor = 1.1;
+static constexpr double kDefaultRtfDecreaseFactor = 0.7;
+/// \brief  The factor is only raised while the slowest loop stays below this
+///         fraction of its deadline.
+static constexpr double kDefaultRtfDeadlineMargin = 0.5;
+/// \brief  Below this fraction of the target, the simulation is considered
+///         compute bound and the target is not raised further.
+static constexpr double kRtfComputeBoundFraction = 0.9;
+
+/// \brief    Adjusts the real time factor of the world to the fastest one at
+///           which the control loops still meet their deadlines.
+/// \details  The autopilots and ROS controllers answer the sensor data in
+///           wall time, so their latency in simulation time grows with the
+///           real time factor. The MAVLink and controller interface plugins
+///           report the round trip of their loops to the ControlLoopMonitor
+///           of the world. Once per period of wall time, the governor lowers
+///           the target factor by decreaseFactor if any loop missed its
+///           deadline, and raises it by increaseFactor if all loops stayed
+///           below deadlineMargin of their deadline and the simulation keeps
+///           up with the target. The target is applied as the real time
+///           update rate of the physics engine.
+///
+///           Every decision is published on ~/governorTopic, together with
+///           the loop latencies and the wall time per step of the plugins on
+///           the update dispatcher, which names the plugin to look at when
+///           the simulation is compute bound.
+class GazeboRtfGovernorPlugin : public WorldPlugin {
+ public:
+  GazeboRtfGovernorPlugin()
+      : WorldPlugin(),
+        period_(kDefaultRtfGovernorPeriod),
+        min_rtf_(kDefaultMinRealTimeFactor),
+        max_rtf_(kDefaultMaxRealTimeFactor),
+        target_rtf_(kDefaultInitialRealTimeFactor),
+        increase_factor_(kDefaultRtfIncreaseFactor),
+        decrease_factor_(kDefaultRtfDecreaseFactor),
+        deadline_margin_(kDefaultRtfDeadlineMargin),
+        last_iterations_(0) {}
+
+  virtual ~GazeboRtfGovernorPlugin() {}
+
+ protected:
+  /// \brief Load the plugin.
+  /// \param[in] _world Pointer to the world that loaded this plugin.
+  /// \param[in] _sdf SDF element that describes the plugin.
+  void Load(physics::WorldPtr _world, sdf::ElementPtr _sdf);
+
+ private:
+  void OnWorldUpdateEnd();
+
+  /// \brief  Decides on the target of the next period and publishes it.
+  void Govern(double wall_seconds);
+
+  /// \brief  Sets the real time update rate of the physics engine for the
+  ///         target factor.
+  void ApplyTarget();
+
+  physics::WorldPtr world_;
+  std::shared_ptr<ControlLoopMonitor> monitor_;
+  std::shared_ptr<UpdateDispatcher> dispatcher_;
+
+  transport::NodePtr node_handle_;
+  transport::PublisherPtr status_pub_;
+  event::ConnectionPtr update_end_connection_;
+
+  /// \brief  Wall time between two decisions [s].
+  double period_;
+  double min_rtf_;
+  double max_rtf_;
+  double target_rtf_;
+  double increase_factor_;
+  double decrease_factor_;
+  double deadline_margin_;
+
+  std::chrono::steady_clock::time_point last_wall_time_;
+  common::Time last_sim_time_;
+  uint64_t last_iterations_;
+  /// \brief  Wall time spent in each dispatcher plugin up to the last
+  ///         decision, by plugin id [s].
+  std::map<int, double> last_plugin_seconds_;
+
+  gz_diagnostic_msgs::RtfGovernorStatus status_msg_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_GAZEBO_RTF_GOVERNOR_PLUGIN_H
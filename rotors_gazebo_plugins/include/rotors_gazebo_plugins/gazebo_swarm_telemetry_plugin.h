@@ -0,0 +1,130 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_GAZEBO_SWARM_TELEMETRY_PLUGIN_H
+#define ROTORS_GAZEBO_PLUGINS_GAZEBO_SWARM_TELEMETRY_PLUGIN_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gazebo/common/common.hh>
+#include <gazebo/common/Plugin.hh>
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+
+#include "SwarmTelemetry.pb.h"
+
+#include "rotors_gazebo_plugins/common.h"
+#include "rotors_gazebo_plugins/rate_scheduler.h"
+#include "rotors_gazebo_plugins/ros_bridge_connector.h"
+#include "rotors_gazebo_plugins/swarm_shard_link.h"
+
+namespace gazebo {
+
+// Default values
+static const std::string kDefaultSwarmTelemetryTopic = "swarm_telemetry";
+static constexpr double kDefaultSwarmTelemetryRate = 0.0;  // [Hz], every step
+static const std::string kDefaultSwarmTelemetryLinkName = "base_link";
+
+/// \brief    Publishes the pose, twist and rotor speeds of every vehicle of
+///           the world in one message per step.
+/// \details  A ground station following a swarm otherwise subscribes to the
+///           odometry and the motor speeds of every vehicle, one topic per
+///           vehicle and motor. Instead, this plugin reads the state of all
+///           vehicles from the physics engine at the end of the step and
+///           packs it into one SwarmTelemetry message, with an array per
+///           quantity and one entry per vehicle.
+///
+///           Every model with a link named linkName is a vehicle, and the
+///           joints of its rotor_<i> child links its motors, like in the bag
+///           plugin. Set modelPrefix to only include the models whose names
+///           start with it. Vehicles spawned or removed during the
+///           simulation are picked up on the next step.
+///
+///           In sharding mode (shardId >= 0), the swarm is spread over
+///           several gzserver processes, each with its own instance of this
+///           plugin. Every shard sends the state of its vehicles to the
+///           shardPeers over UDP (see SwarmShardLink) and only publishes them
+///           locally. The shard with shardGateway set publishes the vehicles
+///           of all shards, with the shard of every vehicle in vehicle_shard,
+///           and is the only one bridging the topic to ROS.
+class GazeboSwarmTelemetryPlugin : public WorldPlugin {
+ public:
+  GazeboSwarmTelemetryPlugin()
+      : WorldPlugin(),
+        link_name_(kDefaultSwarmTelemetryLinkName),
+        rotor_velocity_slowdown_sim_(kDefaultRotorVelocitySlowdownSim),
+        num_models_(0),
+        shard_gateway_(false),
+        shard_timeout_(kDefaultSwarmShardTimeout) {}
+
+  virtual ~GazeboSwarmTelemetryPlugin() {}
+
+ protected:
+  /// \brief Load the plugin.
+  /// \param[in] _world Pointer to the world that loaded this plugin.
+  /// \param[in] _sdf SDF element that describes the plugin.
+  void Load(physics::WorldPtr _world, sdf::ElementPtr _sdf);
+
+ private:
+  struct Vehicle {
+    physics::LinkPtr link;
+    /// \brief  Rotor joints, by motor number.
+    std::vector<physics::JointPtr> motors;
+  };
+
+  void OnWorldUpdateEnd();
+
+  /// \brief  Collects the vehicles and sizes the message for them.
+  void FindVehicles();
+
+  /// \brief  Publishes the local vehicles followed by the ones of the other
+  ///         shards.
+  void PublishGatewayTelemetry();
+
+  physics::WorldPtr world_;
+
+  transport::NodePtr node_handle_;
+  transport::PublisherPtr telemetry_pub_;
+  RosBridgeConnector ros_bridge_connector_;
+  event::ConnectionPtr update_end_connection_;
+
+  std::string link_name_;
+  std::string model_prefix_;
+  double rotor_velocity_slowdown_sim_;
+  RateScheduler scheduler_;
+
+  std::vector<Vehicle> vehicles_;
+  /// \brief  Number of models in the world when the vehicles were collected.
+  unsigned int num_models_;
+
+  gz_mav_msgs::SwarmTelemetry telemetry_msg_;
+
+  /// \brief  NULL unless the world is sharded.
+  std::shared_ptr<SwarmShardLink> shard_link_;
+  bool shard_gateway_;
+  double shard_timeout_;
+  std::vector<SwarmShardVehicle> remote_vehicles_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_GAZEBO_SWARM_TELEMETRY_PLUGIN_H
@@ -23,7 +23,9 @@
 #ifndef ROTORS_GAZEBO_PLUGINS_GAZEBO_WIND_PLUGIN_H
 #define ROTORS_GAZEBO_PLUGINS_GAZEBO_WIND_PLUGIN_H
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <gazebo/common/common.hh>
 #include <gazebo/common/Plugin.hh>
@@ -33,6 +35,14 @@
 #include <mav_msgs/default_topics.h>  // This comes from the mav_comm repo
 
 #include "rotors_gazebo_plugins/common.h"
+#include "rotors_gazebo_plugins/publish_policy.h"
+#include "rotors_gazebo_plugins/ros_bridge_connector.h"
+#include "rotors_gazebo_plugins/simulation_checkpoint.h"
+#include "rotors_gazebo_plugins/update_dispatcher.h"
+#include "rotors_gazebo_plugins/wind_field.h"
+#include "rotors_gazebo_plugins/wind_field_sequence.h"
+#include "rotors_gazebo_plugins/wind_service.h"
+#include "rotors_gazebo_plugins/wind_turbulence.h"
 
 #include "WindSpeed.pb.h"             // Wind speed message
 #include "WrenchStamped.pb.h"         // Wind force message
@@ -58,6 +68,12 @@ static const ignition::math::Vector3d kDefaultWindDirection = ignition::math::Ve
 static const ignition::math::Vector3d kDefaultWindGustDirection = ignition::math::Vector3d (0, 1, 0);
 
 static constexpr bool kDefaultUseCustomStaticWindField = false;
+static constexpr bool kDefaultUseWorldWindService = false;
+static constexpr int kDefaultCustomWindFieldFrameCount = 1;
+static constexpr double kDefaultCustomWindFieldFramePeriod = 1.0;
+/// \brief Airspeed the turbulence is advanced with at least [m/s], so that a
+///        hovering vehicle in calm air still sees it evolve.
+static constexpr double kDefaultTurbulenceMinAirspeed = 1.0;
 
 
 
@@ -80,6 +96,12 @@ class GazeboWindPlugin : public ModelPlugin {
         wind_direction_(kDefaultWindDirection),
         wind_gust_direction_(kDefaultWindGustDirection),
         use_custom_static_wind_field_(kDefaultUseCustomStaticWindField),
+        use_world_wind_service_(kDefaultUseWorldWindService),
+        wind_service_link_id_(-1),
+        wind_field_frame_count_(kDefaultCustomWindFieldFrameCount),
+        wind_field_frame_period_(kDefaultCustomWindFieldFramePeriod),
+        turbulence_min_airspeed_(kDefaultTurbulenceMinAirspeed),
+        turbulence_distance_(0.0),
         frame_id_(kDefaultFrameId),
         link_name_(kDefaultLinkName),
         node_handle_(nullptr),
@@ -111,7 +133,7 @@ class GazeboWindPlugin : public ModelPlugin {
   void CreatePubsAndSubs();
 
   /// \brief    Pointer to the update event connection.
-  event::ConnectionPtr update_connection_;
+  UpdateConnectionPtr update_connection_;
 
   physics::WorldPtr world_;
   physics::ModelPtr model_;
@@ -140,59 +162,62 @@ class GazeboWindPlugin : public ModelPlugin {
 
   /// \brief    Variables for custom wind field generation.
   bool use_custom_static_wind_field_;
-  float min_x_;
-  float min_y_;
-  int n_x_;
-  int n_y_;
-  float res_x_;
-  float res_y_;
-  std::vector<float> vertical_spacing_factors_;
-  std::vector<float> bottom_z_;
-  std::vector<float> top_z_;
-  std::vector<float> u_;
-  std::vector<float> v_;
-  std::vector<float> w_;
-  
-  /// \brief  Reads wind data from a text file and saves it.
+
+  /// \brief    Preprocessed custom wind field, read once in ReadCustomWindField().
+  WindField wind_field_;
+
+  /// \brief    Time-varying custom wind field, used if wind_field_frame_count_ > 1.
+  WindFieldSequence wind_field_sequence_;
+  int wind_field_frame_count_;
+  double wind_field_frame_period_;
+
+  /// \brief    Custom wind field shared by all models, owned by GazeboWindWorldPlugin.
+  bool use_world_wind_service_;
+  std::shared_ptr<WindService> wind_service_;
+  int wind_service_link_id_;
+
+  /// \brief    Turbulence added to the wind velocity, shared by all models
+  ///           with the same turbulence parameters. Not used if NULL.
+  std::shared_ptr<const WindTurbulence> turbulence_;
+  double turbulence_min_airspeed_;
+  /// \brief    Distance the link has flown through the air [m], the position
+  ///           in the turbulence sequence.
+  double turbulence_distance_;
+  common::Time turbulence_last_time_;
+
+  /// \brief  Adds the turbulence at the distance flown through the air to the
+  ///         wind velocity, in the frame of the horizontal mean wind.
+  /// \param[in,out] wind_velocity Mean wind velocity at the link.
+  void AddTurbulence(const common::Time& now,
+                     ignition::math::Vector3d* wind_velocity);
+
+  /// \brief  Writes the position in the turbulence sequence to a checkpoint.
+  ///         The gusts follow the simulation time, which is restored with
+  ///         the world.
+  void SaveCheckpoint(CheckpointWriter* writer);
+  bool RestoreCheckpoint(CheckpointReader* reader);
+
+  CheckpointConnectionPtr checkpoint_connection_;
+
+  /// \brief  Reads wind data from a text or binary file and saves it.
   /// \param[in] custom_wind_field_path Path to the wind field from ~/.ros.
   void ReadCustomWindField(std::string& custom_wind_field_path);
-  
-  /// \brief  Functions for trilinear interpolation of wind field at aircraft position.
-  
-  /// \brief  Linear interpolation
-  /// \param[in]  position y-coordinate of the target point.
-  ///             values Pointer to an array of size 2 containing the wind values
-  ///                    of the two points to interpolate from (12 and 13).
-  ///             points Pointer to an array of size 2 containing the y-coordinate 
-  ///                    of the two points to interpolate from.
-  ignition::math::Vector3d LinearInterpolation(double position, ignition::math::Vector3d * values, double* points) const;
-  
-  /// \brief  Bilinear interpolation
-  /// \param[in]  position Pointer to an array of size 2 containing the x- and 
-  ///                      y-coordinates of the target point.
-  ///             values Pointer to an array of size 4 containing the wind values 
-  ///                    of the four points to interpolate from (8, 9, 10 and 11).
-  ///             points Pointer to an array of size 14 containing the z-coordinate
-  ///                    of the eight points to interpolate from, the x-coordinate 
-  ///                    of the four intermediate points (8, 9, 10 and 11), and the 
-  ///                    y-coordinate of the last two intermediate points (12 and 13).
-  ignition::math::Vector3d BilinearInterpolation(double* position, ignition::math::Vector3d * values, double* points) const;
-  
-  /// \brief  Trilinear interpolation
-  /// \param[in]  link_position Vector3 containing the x, y and z-coordinates
-  ///                           of the target point.
-  ///             values Pointer to an array of size 8 containing the wind values of the 
-  ///                    eight points to interpolate from (0, 1, 2, 3, 4, 5, 6 and 7).
-  ///             points Pointer to an array of size 14 containing the z-coordinate          
-  ///                    of the eight points to interpolate from, the x-coordinate 
-  ///                    of the four intermediate points (8, 9, 10 and 11), and the 
-  ///                    y-coordinate of the last two intermediate points (12 and 13).
-  ignition::math::Vector3d TrilinearInterpolation(ignition::math::Vector3d link_position, ignition::math::Vector3d * values, double* points) const;
+
+  /// \brief  Interpolates the custom wind field at the given position.
+  /// \param[in]  wind_field Wind field to interpolate.
+  /// \param[in]  link_position Position of the link in world coordinates.
+  /// \param[out] wind_velocity Interpolated wind velocity.
+  /// \return False if the position is outside of the custom wind field.
+  bool CustomWindFieldVelocity(const WindField& wind_field,
+                               const ignition::math::Vector3d& link_position,
+                               ignition::math::Vector3d* wind_velocity) const;
   
   gazebo::transport::PublisherPtr wind_force_pub_;
   gazebo::transport::PublisherPtr wind_speed_pub_;
 
   gazebo::transport::NodePtr node_handle_;
+  /// \brief  Requests the Gazebo->ROS connections of the plugin.
+  RosBridgeConnector ros_bridge_connector_;
 
   /// \brief    Gazebo message for sending wind data.
   /// \details  This is defined at the class scope so that it is re-created
@@ -203,6 +228,11 @@ class GazeboWindPlugin : public ModelPlugin {
   /// \details  This is defined at the class scope so that it is re-created
   ///           everytime a wind speed message needs to be sent, increasing performance.
   gz_mav_msgs::WindSpeed wind_speed_msg_;
+
+  /// \brief When the wind force and the wind speed are published. They share
+  ///        the mode, the force has the windForcePublishChangeThreshold.
+  PublishPolicy wind_force_policy_;
+  PublishPolicy wind_speed_policy_;
 };
 }
 
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_GAZEBO_WIND_WORLD_PLUGIN_H
+#define ROTORS_GAZEBO_PLUGINS_GAZEBO_WIND_WORLD_PLUGIN_H
+
+#include <memory>
+
+#include <gazebo/common/common.hh>
+#include <gazebo/common/Plugin.hh>
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+
+#include "rotors_gazebo_plugins/common.h"
+#include "rotors_gazebo_plugins/wind_service.h"
+
+namespace gazebo {
+
+/// \brief    This gazebo plugin owns a single wind field for the whole world.
+/// \details  Models load GazeboWindPlugin with useWorldWindService set to true,
+///           which then reads the wind velocity at its link from this plugin
+///           instead of keeping its own copy of the wind field.
+class GazeboWindWorldPlugin : public WorldPlugin {
+ public:
+  GazeboWindWorldPlugin() : WorldPlugin() {}
+
+  virtual ~GazeboWindWorldPlugin();
+
+ protected:
+
+  /// \brief Load the plugin.
+  /// \param[in] _world Pointer to the world that loaded this plugin.
+  /// \param[in] _sdf SDF element that describes the plugin.
+  void Load(physics::WorldPtr _world, sdf::ElementPtr _sdf);
+
+  /// \brief Called when the world is updated.
+  /// \param[in] _info Update timing information.
+  void OnUpdate(const common::UpdateInfo& /*_info*/);
+
+ private:
+  /// \brief    Pointer to the update event connection.
+  event::ConnectionPtr update_connection_;
+
+  physics::WorldPtr world_;
+
+  std::shared_ptr<WindService> wind_service_;
+};
+}
+
+#endif // ROTORS_GAZEBO_PLUGINS_GAZEBO_WIND_WORLD_PLUGIN_H
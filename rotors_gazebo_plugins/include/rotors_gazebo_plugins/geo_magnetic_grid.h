@@ -0,0 +1,192 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_GEO_MAGNETIC_GRID_H
+#define ROTORS_GAZEBO_PLUGINS_GEO_MAGNETIC_GRID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gazebo {
+
+/// \brief    Earth magnetic field at a geodetic position.
+struct GeoMagneticField {
+  /// \brief  Declination, positive east of true north [rad].
+  double declination = 0.0;
+  /// \brief  Inclination, positive below the horizontal [rad].
+  double inclination = 0.0;
+  /// \brief  Total intensity [T].
+  double intensity = 0.0;
+
+  /// \brief  Field components in the north, east and down directions [T].
+  void ToNED(double* north, double* east, double* down) const;
+};
+
+/// \brief    Declination [deg], inclination [deg] and intensity [nT] of a
+///           grid vertex, as tabulated by the World Magnetic Model.
+struct GeoMagneticGridVertex {
+  float declination;
+  float inclination;
+  float intensity;
+};
+
+/// \brief    Regular latitude/longitude grid as described by the text format.
+/// \details  The text format has one vertex per line:
+///             latitude longitude declination inclination intensity
+///           in degrees and nT, separated by spaces or commas, e.g. the grid
+///           output of the NOAA WMM calculator. Lines starting with '#' are
+///           ignored, the vertices may appear in any order. Vertices are
+///           stored row by row, i.e. (lat, lon) is at lon + lat * n_lon.
+struct GeoMagneticGridData {
+  float min_lat = 0.0f;
+  float min_lon = 0.0f;
+  float res_lat = 0.0f;
+  float res_lon = 0.0f;
+  uint32_t n_lat = 0;
+  uint32_t n_lon = 0;
+  std::vector<GeoMagneticGridVertex> vertices;
+
+  /// \brief  Reads the grid from a text file.
+  /// \return True if the file holds a complete, regularly spaced grid.
+  bool ReadTextFile(const std::string& path);
+};
+
+/// \brief    Header of the binary geomagnetic grid format, followed by the
+///           n_lat * n_lon vertices, in host byte order.
+struct GeoMagneticGridFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t n_lat;
+  uint32_t n_lon;
+  float min_lat;
+  float min_lon;
+  float res_lat;
+  float res_lon;
+  uint64_t vertices_offset;
+};
+
+static const char kGeoMagneticGridFileMagic[8] = {'R', 'O', 'T', 'O', 'R', 'S', 'G', 'M'};
+static constexpr uint32_t kGeoMagneticGridFileVersion = 1;
+
+/// \brief    High-resolution declination, inclination and intensity grid,
+///           e.g. sampled from the World Magnetic Model.
+/// \details  Replaces the 10 degree declination-only table of
+///           get_mag_declination(). The grid is either read from a text file
+///           or mapped read-only from a binary file, so the pages are shared
+///           between all plugins and processes using it. A grid spanning
+///           360 degrees of longitude wraps around the antimeridian.
+class GeoMagneticGrid {
+ public:
+  /// \brief  The four vertices around a position, so that lookups within
+  ///         the same grid cell only interpolate.
+  struct Cell {
+    bool valid = false;
+    /// \brief  South-west corner and extent of the cell [deg].
+    double lat0 = 0.0;
+    double lon0 = 0.0;
+    double res_lat = 0.0;
+    double res_lon = 0.0;
+    GeoMagneticGridVertex sw;
+    GeoMagneticGridVertex se;
+    GeoMagneticGridVertex nw;
+    GeoMagneticGridVertex ne;
+    /// \brief  North, east and down components [T] of sw, se, nw and ne.
+    double ned[4][3];
+
+    /// \brief  True if the position [deg] is within the cell.
+    bool Contains(double lat, double lon) const {
+      return valid && lat >= lat0 && lat <= lat0 + res_lat && lon >= lon0 &&
+             lon <= lon0 + res_lon;
+    }
+  };
+
+  GeoMagneticGrid();
+  ~GeoMagneticGrid();
+
+  GeoMagneticGrid(const GeoMagneticGrid&) = delete;
+  GeoMagneticGrid& operator=(const GeoMagneticGrid&) = delete;
+
+  /// \brief  Loads the grid, detecting the format from the file content.
+  bool Load(const std::string& path);
+
+  /// \brief  Maps a binary grid file into memory.
+  bool LoadBinary(const std::string& path);
+
+  /// \brief  Frees the grid.
+  void Clear();
+
+  /// \brief  Writes a grid in the binary format.
+  static bool WriteBinary(const GeoMagneticGridData& data,
+                          const std::string& path);
+
+  /// \brief  Returns true if the file starts with the binary format magic.
+  static bool IsBinaryFile(const std::string& path);
+
+  bool empty() const { return vertices_ == nullptr; }
+
+  /// \brief  Interpolates all three field values at once.
+  /// \param[in]  lat_rad, lon_rad  Geodetic position [rad].
+  /// \return False if the grid is empty or does not cover the position.
+  bool Interpolate(double lat_rad, double lon_rad,
+                   GeoMagneticField* field) const;
+
+  /// \brief  As Interpolate(), but only reads the grid if the position left
+  ///         the cached cell.
+  bool Interpolate(double lat_rad, double lon_rad, Cell* cell,
+                   GeoMagneticField* field) const;
+
+  /// \brief  Interpolates the north, east and down components [T] of the
+  ///         field, which are computed once per cell, so that lookups within
+  ///         the cached cell need no trigonometric functions.
+  bool InterpolateNED(double lat_rad, double lon_rad, Cell* cell,
+                      double* north, double* east, double* down) const;
+
+ private:
+  /// \brief  Fills cell with the grid cell around the position [deg].
+  bool FindCell(double lat, double lon, Cell* cell) const;
+
+  /// \brief  Wraps a longitude [deg] into the grid, if it spans 360 deg.
+  double WrapLongitude(double lon) const;
+
+  const GeoMagneticGridVertex& vertex(std::size_t lat, std::size_t lon) const {
+    return vertices_[lon + lat * n_lon_];
+  }
+
+  std::size_t n_lat_;
+  std::size_t n_lon_;
+  double min_lat_;
+  double min_lon_;
+  double res_lat_;
+  double res_lon_;
+  bool wraps_;
+
+  /// \brief  Storage for grids read from a text file.
+  GeoMagneticGridData data_;
+
+  void* mapped_data_;
+  std::size_t mapped_size_;
+  const GeoMagneticGridVertex* vertices_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_GEO_MAGNETIC_GRID_H
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_IMU_DELTA_INTEGRATOR_H
+#define ROTORS_GAZEBO_PLUGINS_IMU_DELTA_INTEGRATOR_H
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace gazebo {
+
+/// \brief    Integrates IMU samples into the delta angle and delta velocity
+///           over an output interval, like the integrating outputs of
+///           strapdown IMUs.
+/// \details  Every sample is held over its step, the coning and sculling
+///           corrections follow the two-sample recursions of Savage, "Strapdown
+///           Inertial Navigation Integration Algorithm Design" (1998), which
+///           use the previous sample also across the start of an interval:
+///
+///             beta  += 1/2 (alpha + 1/6 dtheta_prev) x dtheta
+///             gamma += 1/2 ((alpha + 1/6 dtheta_prev) x dv +
+///                           (nu + 1/6 dv_prev) x dtheta)
+///
+///           with alpha and nu the sums of the angle and velocity increments
+///           dtheta and dv since the start of the interval. The delta angle
+///           alpha + beta is the rotation vector from the IMU frame at the
+///           start of the interval to the one at its end, the delta velocity
+///           nu + 1/2 alpha x nu + gamma is the integral of the specific force
+///           in the IMU frame at the start of the interval.
+class ImuDeltaIntegrator {
+ public:
+  ImuDeltaIntegrator() { Reset(); }
+
+  /// \brief  Forgets the interval and the previous sample, e.g. after a
+  ///         restore.
+  void Reset() {
+    previous_delta_angle_.setZero();
+    previous_delta_velocity_.setZero();
+    StartInterval();
+  }
+
+  /// \brief  Starts a new interval, called after the previous one has been
+  ///         read.
+  void StartInterval() {
+    angle_.setZero();
+    velocity_.setZero();
+    coning_.setZero();
+    sculling_.setZero();
+    dt_ = 0.0;
+    num_samples_ = 0;
+  }
+
+  /// \brief  Adds a sample held over a step.
+  /// \param[in] angular_velocity Angular velocity in the IMU frame [rad/s].
+  /// \param[in] linear_acceleration Specific force in the IMU frame [m/s^2].
+  /// \param[in] dt Length of the step [s].
+  void Add(const Eigen::Vector3d& angular_velocity,
+           const Eigen::Vector3d& linear_acceleration, double dt) {
+    const Eigen::Vector3d delta_angle = angular_velocity * dt;
+    const Eigen::Vector3d delta_velocity = linear_acceleration * dt;
+    const Eigen::Vector3d angle = angle_ + previous_delta_angle_ / 6.0;
+    const Eigen::Vector3d velocity = velocity_ + previous_delta_velocity_ / 6.0;
+
+    coning_ += 0.5 * angle.cross(delta_angle);
+    sculling_ +=
+        0.5 * (angle.cross(delta_velocity) + velocity.cross(delta_angle));
+    angle_ += delta_angle;
+    velocity_ += delta_velocity;
+
+    previous_delta_angle_ = delta_angle;
+    previous_delta_velocity_ = delta_velocity;
+    dt_ += dt;
+    ++num_samples_;
+  }
+
+  /// \brief  Rotation vector over the interval [rad].
+  Eigen::Vector3d DeltaAngle() const { return angle_ + coning_; }
+
+  /// \brief  Velocity change over the interval, without gravity [m/s].
+  Eigen::Vector3d DeltaVelocity() const {
+    return velocity_ + 0.5 * angle_.cross(velocity_) + sculling_;
+  }
+
+  /// \brief  Length of the interval [s].
+  double dt() const { return dt_; }
+  int num_samples() const { return num_samples_; }
+
+ private:
+  /// \brief  Sums of the increments since the start of the interval.
+  Eigen::Vector3d angle_;
+  Eigen::Vector3d velocity_;
+  Eigen::Vector3d coning_;
+  Eigen::Vector3d sculling_;
+  /// \brief  Increments of the last sample.
+  Eigen::Vector3d previous_delta_angle_;
+  Eigen::Vector3d previous_delta_velocity_;
+  double dt_;
+  int num_samples_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_IMU_DELTA_INTEGRATOR_H
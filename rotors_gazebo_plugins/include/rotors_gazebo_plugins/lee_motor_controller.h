@@ -0,0 +1,58 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_LEE_MOTOR_CONTROLLER_H
+#define ROTORS_GAZEBO_PLUGINS_LEE_MOTOR_CONTROLLER_H
+
+#include <mav_msgs/eigen_mav_msgs.h>
+#include <rotors_control/lee_position_controller.h>
+
+#include "rotors_gazebo_plugins/motor_controller.hpp"
+
+/// \brief    Runs the LeePositionController of rotors_control as the motor
+///           controller of a MultiCopter, on the true state of the vehicle.
+class LeeMotorController : public MotorController {
+ public:
+  LeeMotorController(const rotors_control::VehicleParameters& vehicle_parameters,
+                     const rotors_control::LeePositionControllerParameters& controller_parameters);
+  virtual ~LeeMotorController() {}
+
+  void calculateRefMotorVelocities(double dt) override;
+  void initializeParams() override;
+  void publish() override {}
+
+  /// \brief  Sets the reference, the rotors stay off until the first one.
+  void setTrajectoryPoint(const mav_msgs::EigenTrajectoryPoint& trajectory_point) {
+    lee_position_controller_.SetTrajectoryPoint(trajectory_point);
+  }
+
+  /// \brief  The wrapped controller, call initializeParams() after changing
+  ///         its parameters.
+  rotors_control::LeePositionController& controller() {
+    return lee_position_controller_;
+  }
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+ private:
+  rotors_control::LeePositionController lee_position_controller_;
+  rotors_control::EigenOdometry odometry_;
+};
+
+#endif // ROTORS_GAZEBO_PLUGINS_LEE_MOTOR_CONTROLLER_H
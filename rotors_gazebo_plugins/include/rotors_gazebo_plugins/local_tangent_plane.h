@@ -0,0 +1,82 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_LOCAL_TANGENT_PLANE_H
+#define ROTORS_GAZEBO_PLUGINS_LOCAL_TANGENT_PLANE_H
+
+namespace gazebo {
+
+// Earth radius of the GPS reprojection of GazeboMavlinkInterface [m].
+static constexpr double kDefaultLocalTangentPlaneEarthRadius = 6353000.0;
+// Distance after which the reprojection is linearized again [m].
+static constexpr double kDefaultRelinearizationDistance = 100.0;
+
+/// \brief    Converts local north/east positions around a reference point
+///           into geodetic coordinates (azimuthal equidistant projection on
+///           a sphere).
+/// \details  The sine and cosine of the reference latitude are computed
+///           once. As vehicles move little between updates, the exact
+///           projection is only evaluated when the position moved further
+///           than the relinearization distance from the last linearization
+///           point; in between, the Jacobian at that point is used, which is
+///           accurate to millimeters at the default distance.
+class LocalTangentPlane {
+ public:
+  LocalTangentPlane(
+      double ref_lat_rad, double ref_lon_rad,
+      double earth_radius = kDefaultLocalTangentPlaneEarthRadius,
+      double relinearization_distance = kDefaultRelinearizationDistance);
+
+  /// \brief  Geodetic coordinates [rad] of a local position [m].
+  void ToGeodetic(double north, double east, double* lat_rad, double* lon_rad);
+
+  /// \brief  The exact projection, without the linearization.
+  void ToGeodeticExact(double north, double east, double* lat_rad,
+                       double* lon_rad) const;
+
+  double ref_lat_rad() const { return ref_lat_rad_; }
+  double ref_lon_rad() const { return ref_lon_rad_; }
+
+ private:
+  /// \brief  Evaluates the projection and its Jacobian at a position.
+  void Linearize(double north, double east);
+
+  double ref_lat_rad_;
+  double ref_lon_rad_;
+  double sin_ref_lat_;
+  double cos_ref_lat_;
+  double inv_earth_radius_;
+  double relinearization_distance_sq_;
+
+  bool linearized_;
+  double lin_north_;
+  double lin_east_;
+  double lin_lat_;
+  double lin_lon_;
+  /// \brief  Jacobian of (lat, lon) with respect to (north, east).
+  double dlat_dnorth_;
+  double dlat_deast_;
+  double dlon_dnorth_;
+  double dlon_deast_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_LOCAL_TANGENT_PLANE_H
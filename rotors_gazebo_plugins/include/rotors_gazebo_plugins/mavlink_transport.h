@@ -0,0 +1,177 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ROTORS_GAZEBO_PLUGINS_MAVLINK_TRANSPORT_H
+#define ROTORS_GAZEBO_PLUGINS_MAVLINK_TRANSPORT_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "common/mavlink.h"     // Either provided by ROS or as CMake argument MAVLINK_HEADER_DIR
+
+#include "spsc_ring_buffer.h"
+
+#if defined(__linux__)
+#define ROTORS_MAVLINK_HAVE_MMSG 1
+#endif
+
+namespace gazebo {
+
+/// \brief Time the MAVLink I/O thread waits for incoming data, before it
+///        checks for outgoing messages again [ms].
+static const int kMavlinkIoPollTimeoutMs = 1;
+static const std::size_t kMavlinkQueueCapacity = 64;
+/// \brief Number of datagrams read with one recvmmsg() call.
+static const std::size_t kMavlinkReceiveBatchSize = 32;
+/// \brief Size of the buffer of each datagram read with recvmmsg() [bytes].
+static const std::size_t kMavlinkReceiveBufferSize = 4096;
+
+/// \brief A serialized MAVLink message, queued for the I/O thread.
+struct MavlinkPacket {
+  uint16_t length;
+  uint8_t data[MAVLINK_MAX_PACKET_LEN];
+};
+
+/// \brief    Message queues between one vehicle and the MAVLink I/O thread.
+/// \details  Every queue has a single producer and a single consumer: the
+///           physics thread and the transport thread queue outgoing messages
+///           in their own queue, and the physics thread handles the incoming
+///           ones.
+struct MavlinkEndpoint {
+  typedef SpscRingBuffer<MavlinkPacket, kMavlinkQueueCapacity> OutboundQueue;
+
+  MavlinkEndpoint() : system_id(0), outbound_dropped(0), inbound_dropped(0) {}
+
+  /// \brief Messages sent from the update of the vehicle, on the physics thread.
+  OutboundQueue update_outbound;
+  /// \brief Messages sent from the sensor callbacks, on the transport thread.
+  OutboundQueue sensor_outbound;
+  /// \brief Messages received from the autopilot of the vehicle.
+  SpscRingBuffer<mavlink_message_t, kMavlinkQueueCapacity> inbound;
+
+  /// \brief System ID of the autopilot, used to dispatch the incoming messages
+  ///        on a shared socket.
+  uint8_t system_id;
+  /// \brief Address of the autopilot, only used by the I/O thread once the
+  ///        endpoint is added. Updated to the source of its messages.
+  struct sockaddr_in remote_address;
+
+  std::atomic<uint64_t> outbound_dropped;
+  std::atomic<uint64_t> inbound_dropped;
+
+  /// \brief Waits until a message is received or the deadline has passed.
+  /// \return False on timeout.
+  bool WaitForInbound(const std::chrono::steady_clock::time_point& deadline) {
+    std::unique_lock<std::mutex> lock(inbound_mutex);
+    return inbound_condition.wait_until(lock, deadline,
+                                        [this] { return !inbound.Empty(); });
+  }
+
+  /// \brief Wakes up WaitForInbound(), called by the I/O thread after it
+  ///        queued incoming messages.
+  void NotifyInbound() {
+    { std::lock_guard<std::mutex> lock(inbound_mutex); }
+    inbound_condition.notify_one();
+  }
+
+  std::mutex inbound_mutex;
+  std::condition_variable inbound_condition;
+};
+
+/// \brief    UDP socket and I/O thread for the MAVLink traffic of one or more
+///           vehicles.
+/// \details  In batched mode, all queued messages are sent with a single
+///           sendmmsg() per iteration of the I/O thread and all pending
+///           datagrams are read with recvmmsg(). A shared transport serves all
+///           vehicles of the simulation over one socket, and dispatches the
+///           incoming messages by their system ID.
+class MavlinkTransport {
+ public:
+  explicit MavlinkTransport(bool batched);
+  ~MavlinkTransport();
+
+  /// \brief Returns the transport shared by all vehicles, creating it on
+  ///        first use.
+  static std::shared_ptr<MavlinkTransport> GetShared(bool batched);
+
+  /// \brief Binds the socket to a port chosen by the OS and starts the I/O
+  ///        thread. Does nothing if the transport is already open.
+  /// \return False if the socket could not be set up.
+  bool Open();
+
+  /// \brief Adds the queues of a vehicle.
+  /// \return False, with a warning, if another vehicle has the same system ID.
+  bool AddEndpoint(const std::shared_ptr<MavlinkEndpoint>& endpoint);
+  void RemoveEndpoint(const std::shared_ptr<MavlinkEndpoint>& endpoint);
+
+  bool batched() const { return batched_; }
+
+ private:
+  void IoThread();
+  void SendQueued();
+  void ReceivePending();
+  /// \brief Parses one datagram and queues its messages for their endpoints.
+  void Dispatch(const uint8_t* data, std::size_t length,
+                const struct sockaddr_in& source);
+  void ReportDropped();
+
+  bool batched_;
+  int fd_;
+  struct pollfd fds_[1];
+
+  std::thread io_thread_;
+  std::atomic<bool> io_thread_running_;
+
+  /// \brief Protects endpoints_, only held briefly by the I/O thread.
+  std::mutex endpoints_mutex_;
+  std::vector<std::shared_ptr<MavlinkEndpoint> > endpoints_;
+  /// \brief Copy of endpoints_ for the I/O thread.
+  std::vector<std::shared_ptr<MavlinkEndpoint> > io_endpoints_;
+
+  // Scratch buffers of the I/O thread.
+  std::vector<MavlinkPacket> send_packets_;
+  std::vector<MavlinkEndpoint*> send_endpoints_;
+  std::vector<uint8_t> receive_buffer_;
+#ifdef ROTORS_MAVLINK_HAVE_MMSG
+  std::vector<struct mmsghdr> send_headers_;
+  std::vector<struct iovec> send_iovecs_;
+  std::vector<struct mmsghdr> receive_headers_;
+  std::vector<struct iovec> receive_iovecs_;
+  std::vector<struct sockaddr_in> receive_addresses_;
+#endif
+
+  uint64_t dropped_unknown_system_;
+  uint64_t reported_dropped_;
+  std::chrono::steady_clock::time_point last_report_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_MAVLINK_TRANSPORT_H
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_MEASUREMENT_DELAY_QUEUE_H
+#define ROTORS_GAZEBO_PLUGINS_MEASUREMENT_DELAY_QUEUE_H
+
+#include <cstddef>
+#include <vector>
+
+#include "rotors_gazebo_plugins/model_arena.h"
+
+namespace gazebo {
+
+/// \brief    Fixed capacity FIFO of measurements that are held back until
+///           their release time, used to simulate sensor delays.
+/// \details  The records are allocated once in Reset() and overwritten in
+///           place, so T should be a small plain struct with the raw
+///           measurement, from which the message is only built on release.
+///           Release times have to be pushed in non-decreasing order, which is
+///           the case for a constant delay.
+template <class T, class Key = int>
+class MeasurementDelayQueue {
+ public:
+  MeasurementDelayQueue() : front_(0), size_(0) {}
+
+  /// \brief  Allocates the records from the arena of a model from here on.
+  ///         Drops all records, call Reset() afterwards.
+  void UseArena(const ArenaAllocator<char>& allocator) {
+    records_ = Records(ArenaAllocator<Record>(allocator));
+    front_ = 0;
+    size_ = 0;
+  }
+
+  /// \brief  Drops all records and allocates room for capacity of them.
+  void Reset(std::size_t capacity) {
+    records_.resize(capacity > 0 ? capacity : 1);
+    front_ = 0;
+    size_ = 0;
+  }
+
+  /// \brief  Capacity for a delay of delay steps when a measurement is taken
+  ///         every divisor steps.
+  static std::size_t CapacityFor(int delay, int divisor = 1) {
+    return static_cast<std::size_t>(delay / divisor + 1);
+  }
+
+  std::size_t Size() const { return size_; }
+  std::size_t Capacity() const { return records_.size(); }
+  bool Empty() const { return size_ == 0; }
+  bool Full() const { return size_ == records_.size(); }
+
+  /// \brief  Appends a record that is released at release.
+  /// \return The record to fill in, or nullptr if the queue is full.
+  T* Push(Key release) {
+    if (Full()) {
+      return nullptr;
+    }
+    Record& record = records_[(front_ + size_) % records_.size()];
+    ++size_;
+    record.release = release;
+    return &record.value;
+  }
+
+  /// \brief  True if the oldest record is due at now.
+  bool Ready(Key now) const {
+    return size_ > 0 && !(now < records_[front_].release);
+  }
+
+  /// \brief  The oldest record, only valid if the queue is not empty.
+  const T& Front() const { return records_[front_].value; }
+
+  /// \brief  The i-th oldest record and its release, e.g. to write the queue
+  ///         to a checkpoint. Only valid for i < Size().
+  const T& At(std::size_t i) const {
+    return records_[(front_ + i) % records_.size()].value;
+  }
+  Key ReleaseAt(std::size_t i) const {
+    return records_[(front_ + i) % records_.size()].release;
+  }
+
+  /// \brief  Removes the oldest record.
+  void Pop() {
+    if (size_ > 0) {
+      front_ = (front_ + 1) % records_.size();
+      --size_;
+    }
+  }
+
+ private:
+  struct Record {
+    Key release;
+    T value;
+  };
+
+  typedef ArenaVector<Record> Records;
+
+  Records records_;
+  std::size_t front_;
+  std::size_t size_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_MEASUREMENT_DELAY_QUEUE_H
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_MESH_VOXELIZER_H
+#define ROTORS_GAZEBO_PLUGINS_MESH_VOXELIZER_H
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <gazebo/physics/physics.hh>
+
+namespace gazebo {
+
+/// \brief Triangle of a collision surface in world frame.
+struct CollisionTriangle {
+  ignition::math::Vector3d vertices[3];
+};
+
+/// \brief Separating axis test of a triangle against an axis aligned box,
+///        after Akenine-Moeller. True if they overlap or touch.
+bool TriangleBoxOverlap(const ignition::math::Vector3d& box_center,
+                        const ignition::math::Vector3d& box_half_size,
+                        const CollisionTriangle& triangle);
+
+/// \brief    Voxelizes the collision surfaces of a world into a dense bitmap.
+/// \details  The collision shapes are triangulated once, boxes exactly and
+///           spheres and cylinders finely enough that the triangulation does
+///           not deviate from the shape by more than half a cell. Meshes are
+///           read through the mesh manager, planes are clipped to the grid.
+///           Shapes without a triangulation, such as heightmaps, are
+///           voxelized by their bounding box.
+///
+///           A cell is occupied if any triangle touches its box, which the
+///           workers decide with a separating axis test, in parallel over
+///           the triangles. The interior of a closed shape is not marked, it
+///           stays unknown like in the ray tests of the octomap plugin.
+class MeshVoxelizer {
+ public:
+  /// \param[in] min Center of the first cell.
+  /// \param[in] leaf_size Side length of a cell, the cell centers lie at
+  ///            min + (ix, iy, iz) * leaf_size.
+  /// \param[in] num_cells Number of cells along every axis, the bitmap is
+  ///            indexed by (ix * num_cells[1] + iy) * num_cells[2] + iz.
+  MeshVoxelizer(const ignition::math::Vector3d& min, double leaf_size,
+                const int num_cells[3]);
+
+  /// \brief Triangulates the collisions of all models in the world that
+  ///        reach into the grid. Must not run while the world steps.
+  void AddWorld(const physics::WorldPtr& world);
+
+  /// \brief Only keeps the triangles that reach into one of the boxes,
+  ///        given by their min and max corners in world frame. The cells
+  ///        outside of the boxes may then be incomplete. Call before adding
+  ///        triangles.
+  void SetRegions(
+      const std::vector<std::pair<ignition::math::Vector3d,
+                                  ignition::math::Vector3d> >& regions);
+
+  void AddTriangle(const CollisionTriangle& triangle);
+
+  /// \brief Marks the cells touched by the triangles added so far.
+  /// \param[in] num_threads Number of workers, 0 uses one per hardware
+  ///            thread.
+  void Voxelize(int num_threads);
+
+  bool IsOccupied(int64_t index) const {
+    return (words_[index >> 6].load(std::memory_order_relaxed) >>
+            (index & 63)) & 1;
+  }
+
+  size_t NumTriangles() const { return triangles_.size(); }
+
+ private:
+  void AddCollision(const physics::CollisionPtr& collision);
+  /// \brief Adds the triangles of a shape given in the collision frame.
+  void AddTriangles(const std::vector<ignition::math::Vector3d>& vertices,
+                    const ignition::math::Pose3d& pose);
+  void AddBox(const ignition::math::Vector3d& size,
+              const ignition::math::Pose3d& pose);
+  void AddPlane(const ignition::math::Vector3d& normal,
+                const ignition::math::Pose3d& pose);
+  void AddSphere(double radius, const ignition::math::Pose3d& pose);
+  void AddCylinder(double radius, double length,
+                   const ignition::math::Pose3d& pose);
+  bool AddMesh(const physics::MeshShapePtr& mesh_shape,
+               const ignition::math::Pose3d& pose);
+
+  /// \brief Number of segments of a circle of the radius, so that its chords
+  ///        stay within half a cell of it.
+  int NumSegments(double radius) const;
+
+  /// \brief Marks the cells touched by one triangle.
+  void VoxelizeTriangle(const CollisionTriangle& triangle);
+
+  ignition::math::Vector3d min_;
+  double leaf_size_;
+  int num_cells_[3];
+  /// \brief Corners of the space covered by the cells.
+  ignition::math::Vector3d grid_min_;
+  ignition::math::Vector3d grid_max_;
+  /// \brief Boxes the triangles must reach into, none if empty.
+  std::vector<std::pair<ignition::math::Vector3d, ignition::math::Vector3d> >
+      regions_;
+  std::vector<CollisionTriangle> triangles_;
+  /// \brief Bitmap of the occupied cells, 64 cells per word.
+  std::vector<std::atomic<uint64_t> > words_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_MESH_VOXELIZER_H
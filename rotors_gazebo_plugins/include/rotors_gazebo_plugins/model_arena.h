@@ -0,0 +1,305 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_MODEL_ARENA_H
+#define ROTORS_GAZEBO_PLUGINS_MODEL_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <gazebo/physics/PhysicsTypes.hh>
+
+namespace gazebo {
+
+/// \brief  Size of the blocks the chunks are carved from [bytes].
+static constexpr std::size_t kModelArenaBlockSize = 64 * 1024;
+/// \brief  Chunk sizes are powers of two from the minimum to the maximum
+///         [bytes]. Larger allocations are taken from the global heap, and
+///         only accounted.
+static constexpr std::size_t kModelArenaMinChunkSize = 16;
+static constexpr std::size_t kModelArenaMaxChunkSize = 16 * 1024;
+static constexpr int kModelArenaNumSizeClasses = 11;
+
+template <class T>
+class ArenaAllocator;
+
+/// \brief    Pool that the plugins of one model allocate their long-lived
+///           state from, and the accounting of its memory by plugin.
+/// \details  Small allocations are carved from 64 KiB blocks in power of two
+///           chunks. Freed chunks go to a free list of their size and are
+///           reused by the next allocation of that size, so delay queues and
+///           buffers that are resized keep to the blocks of their model
+///           instead of fragmenting the global heap. The blocks are only
+///           returned all at once, when the last plugin of the model releases
+///           the arena, i.e. despawning a vehicle frees its blocks in one go.
+///
+///           Every allocation is accounted to the plugin it is tagged with.
+///           The usage of all arenas is published once per second of wall
+///           time on ~/rotors/plugin_memory, as PluginMemoryStats.
+///
+///           Plugins allocate through ArenaAllocator, e.g. in an ArenaVector,
+///           or with ArenaNew(). Allocation takes a lock and is meant for
+///           state set up on load, not for every update.
+class ModelArena {
+ public:
+  /// \brief  Memory in use by one plugin of the model.
+  struct PluginUsage {
+    PluginUsage() : bytes(0), peak_bytes(0), allocations(0) {}
+
+    std::string plugin;
+    uint64_t bytes;
+    uint64_t peak_bytes;
+    uint64_t allocations;
+  };
+
+  explicit ModelArena(const std::string& model_name)
+      : model_name_(model_name), block_offset_(0), large_bytes_(0) {
+    for (FreeChunk*& free_chunk : free_chunks_) {
+      free_chunk = nullptr;
+    }
+  }
+
+  ModelArena(const ModelArena&) = delete;
+  ModelArena& operator=(const ModelArena&) = delete;
+
+  /// \brief  Returns the arena of a model, creating it on first use. It is
+  ///         released when the last allocator of the model is destroyed.
+  static std::shared_ptr<ModelArena> Get(const physics::ModelPtr& model);
+
+  /// \brief  Allocator of the arena of a model, accounting to a plugin.
+  static ArenaAllocator<char> ForPlugin(const physics::ModelPtr& model,
+                                        const std::string& plugin);
+
+  /// \brief  Returns the arenas of all models that have one.
+  static std::vector<std::shared_ptr<ModelArena> > Arenas();
+
+  /// \brief  Tag that the allocations of a plugin are accounted to.
+  int Tag(const std::string& plugin) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::size_t tag = 0; tag < usage_.size(); ++tag) {
+      if (usage_[tag].plugin == plugin) {
+        return tag;
+      }
+    }
+    usage_.push_back(PluginUsage());
+    usage_.back().plugin = plugin;
+    return usage_.size() - 1;
+  }
+
+  /// \brief  Allocates bytes, aligned for any fundamental type.
+  void* Allocate(std::size_t bytes, int tag) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int size_class = SizeClass(bytes);
+    std::size_t size = bytes;
+    void* pointer;
+    if (size_class < 0) {
+      pointer = ::operator new(bytes);
+      large_bytes_ += bytes;
+    } else {
+      size = kModelArenaMinChunkSize << size_class;
+      if (free_chunks_[size_class] != nullptr) {
+        pointer = free_chunks_[size_class];
+        free_chunks_[size_class] = free_chunks_[size_class]->next;
+      } else {
+        if (blocks_.empty() || block_offset_ + size > kModelArenaBlockSize) {
+          blocks_.emplace_back(new char[kModelArenaBlockSize]);
+          block_offset_ = 0;
+        }
+        pointer = blocks_.back().get() + block_offset_;
+        block_offset_ += size;
+      }
+    }
+    PluginUsage& usage = usage_[tag];
+    usage.bytes += size;
+    usage.peak_bytes = usage.bytes > usage.peak_bytes ? usage.bytes
+                                                      : usage.peak_bytes;
+    ++usage.allocations;
+    return pointer;
+  }
+
+  /// \brief  Returns an allocation of bytes to the arena.
+  void Deallocate(void* pointer, std::size_t bytes, int tag) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int size_class = SizeClass(bytes);
+    std::size_t size = bytes;
+    if (size_class < 0) {
+      ::operator delete(pointer);
+      large_bytes_ -= bytes;
+    } else {
+      size = kModelArenaMinChunkSize << size_class;
+      FreeChunk* free_chunk = static_cast<FreeChunk*>(pointer);
+      free_chunk->next = free_chunks_[size_class];
+      free_chunks_[size_class] = free_chunk;
+    }
+    PluginUsage& usage = usage_[tag];
+    usage.bytes -= size;
+    --usage.allocations;
+  }
+
+  /// \brief  Usage of every plugin that allocated from the arena.
+  std::vector<PluginUsage> Usage() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return usage_;
+  }
+
+  /// \brief  Memory held by the arena, its blocks and the large allocations
+  ///         [bytes].
+  uint64_t reserved_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return blocks_.size() * kModelArenaBlockSize + large_bytes_;
+  }
+
+  const std::string& model_name() const { return model_name_; }
+
+ private:
+  struct FreeChunk {
+    FreeChunk* next;
+  };
+
+  /// \brief  Index of the smallest chunk size holding bytes, or -1 if the
+  ///         largest one does not.
+  static int SizeClass(std::size_t bytes) {
+    if (bytes > kModelArenaMaxChunkSize) {
+      return -1;
+    }
+    int size_class = 0;
+    for (std::size_t size = kModelArenaMinChunkSize; size < bytes;
+         size <<= 1) {
+      ++size_class;
+    }
+    return size_class;
+  }
+
+  std::string model_name_;
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<char[]> > blocks_;
+  /// \brief  First unused byte of the last block.
+  std::size_t block_offset_;
+  FreeChunk* free_chunks_[kModelArenaNumSizeClasses];
+  uint64_t large_bytes_;
+  /// \brief  By tag.
+  std::vector<PluginUsage> usage_;
+};
+
+/// \brief    Standard allocator of the arena of a model, accounting to one of
+///           its plugins.
+/// \details  The allocator keeps the arena alive. A default constructed
+///           allocator uses the global heap, so that containers work the
+///           same before a plugin has chosen an arena.
+template <class T>
+class ArenaAllocator {
+ public:
+  static_assert(alignof(T) <= alignof(std::max_align_t),
+                "Over-aligned types can't be allocated from a model arena.");
+
+  typedef T value_type;
+  typedef std::true_type propagate_on_container_copy_assignment;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  ArenaAllocator() : tag_(0) {}
+  ArenaAllocator(const std::shared_ptr<ModelArena>& arena, int tag)
+      : arena_(arena), tag_(tag) {}
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U>& other)
+      : arena_(other.arena()), tag_(other.tag()) {}
+
+  T* allocate(std::size_t n) {
+    if (!arena_) {
+      return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T), tag_));
+  }
+
+  void deallocate(T* pointer, std::size_t n) {
+    if (!arena_) {
+      ::operator delete(pointer);
+      return;
+    }
+    arena_->Deallocate(pointer, n * sizeof(T), tag_);
+  }
+
+  const std::shared_ptr<ModelArena>& arena() const { return arena_; }
+  int tag() const { return tag_; }
+
+ private:
+  std::shared_ptr<ModelArena> arena_;
+  int tag_;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena() && a.tag() == b.tag();
+}
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return !(a == b);
+}
+
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
+
+/// \brief  Destroys an object created with ArenaNew().
+template <class T>
+class ArenaDeleter {
+ public:
+  ArenaDeleter() {}
+  explicit ArenaDeleter(const ArenaAllocator<T>& allocator)
+      : allocator_(allocator) {}
+
+  void operator()(T* pointer) {
+    pointer->~T();
+    allocator_.deallocate(pointer, 1);
+  }
+
+ private:
+  ArenaAllocator<T> allocator_;
+};
+
+template <class T>
+using ArenaUniquePtr = std::unique_ptr<T, ArenaDeleter<T> >;
+
+/// \brief  Creates an object in an arena, like std::make_unique().
+template <class T, class... Args>
+ArenaUniquePtr<T> ArenaNew(const ArenaAllocator<char>& allocator,
+                           Args&&... args) {
+  ArenaAllocator<T> typed_allocator(allocator);
+  T* pointer = typed_allocator.allocate(1);
+  try {
+    new (pointer) T(std::forward<Args>(args)...);
+  } catch (...) {
+    typed_allocator.deallocate(pointer, 1);
+    throw;
+  }
+  return ArenaUniquePtr<T>(pointer, ArenaDeleter<T>(typed_allocator));
+}
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_MODEL_ARENA_H
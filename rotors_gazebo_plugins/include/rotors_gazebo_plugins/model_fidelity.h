@@ -0,0 +1,117 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_MODEL_FIDELITY_H
+#define ROTORS_GAZEBO_PLUGINS_MODEL_FIDELITY_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <gazebo/physics/physics.hh>
+
+namespace gazebo {
+
+enum FidelityLevel { kFidelityFull = 0, kFidelityLow = 1 };
+
+// Default values
+static constexpr FidelityLevel kDefaultFidelityLevel = kFidelityFull;
+static constexpr int kDefaultLowFidelityRateDivisor = 10;
+
+/// \brief    Level of detail of the sensors of one model, switched at runtime.
+/// \details  At full fidelity the sensor plugins behave as configured. At low
+///           fidelity they skip their noise models and delays, publish the
+///           ground truth only every rate_divisor() world updates, and
+///           cameras stop rendering. Swarm runs keep the vehicles of interest
+///           at full fidelity and run the others at low fidelity.
+///
+///           The level is shared by all plugins of a model. It is set through
+///           the set_fidelity service of GazeboRosInterfacePlugin, or
+///           initially with the SDF parameters fidelityLevel ("full" or
+///           "low") and lowFidelityRateDivisor of any of the plugins.
+class ModelFidelity {
+ public:
+  typedef std::function<void(FidelityLevel)> Listener;
+
+  ModelFidelity()
+      : level_(kDefaultFidelityLevel),
+        rate_divisor_(kDefaultLowFidelityRateDivisor),
+        next_listener_id_(0) {}
+
+  /// \brief  Returns the fidelity of a model, creating it on first use. It is
+  ///         released when the last plugin of the model is unloaded.
+  static std::shared_ptr<ModelFidelity> Get(const physics::ModelPtr& model);
+
+  /// \brief  Returns the fidelity of a model, creating it on first use, and
+  ///         applies the fidelityLevel and lowFidelityRateDivisor parameters
+  ///         of a plugin if it has them.
+  static std::shared_ptr<ModelFidelity> Get(const physics::ModelPtr& model,
+                                            const sdf::ElementPtr& sdf);
+
+  /// \brief  Returns the fidelity of a model, or nullptr if none of its
+  ///         plugins uses it.
+  static std::shared_ptr<ModelFidelity> Find(const physics::ModelPtr& model);
+
+  /// \brief  Switches the level and notifies the listeners.
+  /// \param[in] rate_divisor Updates between two low fidelity measurements,
+  ///            0 keeps the current one.
+  void Set(FidelityLevel level, int rate_divisor = 0);
+
+  FidelityLevel level() const {
+    return static_cast<FidelityLevel>(level_.load(std::memory_order_relaxed));
+  }
+  bool low() const { return level() == kFidelityLow; }
+  int rate_divisor() const {
+    return rate_divisor_.load(std::memory_order_relaxed);
+  }
+
+  /// \brief  True if a plugin at low fidelity skips the world update with the
+  ///         given iteration.
+  bool Skip(uint64_t iteration) const {
+    return low() && iteration % rate_divisor() != 0;
+  }
+
+  /// \brief  Calls listener on every change of the level, for plugins that
+  ///         do not run on the world update, like cameras. The listener must
+  ///         not add or remove listeners itself.
+  /// \return Id to remove the listener with.
+  int AddListener(const Listener& listener);
+  void RemoveListener(int id);
+
+ private:
+  std::atomic<int> level_;
+  std::atomic<int> rate_divisor_;
+
+  std::mutex listener_mutex_;
+  std::map<int, Listener> listeners_;
+  int next_listener_id_;
+};
+
+/// \brief  Parses "full" or "low".
+/// \return False if the name is unknown.
+bool ParseFidelityLevel(const std::string& name, FidelityLevel* level);
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_MODEL_FIDELITY_H
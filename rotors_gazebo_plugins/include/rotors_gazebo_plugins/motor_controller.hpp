@@ -28,25 +28,39 @@ class MotorController
 {
   public:
     MotorController(int amount_motors) :
-      ref_rotor_rot_vels_(Eigen::VectorXd::Zero(amount_motors)){};
-    virtual ~MotorController();
-    void getMotorVelocities() {
-      calculateRefMotorVelocities();
+      position_(Eigen::Vector3d::Zero()),
+      velocity_(Eigen::Vector3d::Zero()),
+      attitude_(Eigen::Quaterniond::Identity()),
+      angular_rate_(Eigen::Vector3d::Zero()),
+      ref_rotor_rot_vels_(Eigen::VectorXd::Zero(amount_motors)) {}
+    virtual ~MotorController() {}
+
+    // Position and velocity in world frame, angular rate in body frame.
+    void setState(const Eigen::Vector3d& position,
+                  const Eigen::Vector3d& velocity,
+                  const Eigen::Quaterniond& attitude,
+                  const Eigen::Vector3d& angular_rate) {
+      position_ = position;
+      velocity_ = velocity;
+      attitude_ = attitude;
+      angular_rate_ = angular_rate;
+    }
+
+    const Eigen::VectorXd& getMotorVelocities(double dt) {
+      calculateRefMotorVelocities(dt);
       return ref_rotor_rot_vels_;
     }
 
-    virtual void calculateRefMotorVelocities() = 0;
+    virtual void calculateRefMotorVelocities(double dt) = 0;
     virtual void initializeParams() = 0;
     virtual void publish() = 0;
 
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
   protected:
-    // imu_
-    // odom_
-
     Eigen::Vector3d position_;
     Eigen::Vector3d velocity_;
-    Eigen::Quaternion attitude_;
+    Eigen::Quaterniond attitude_;
+    Eigen::Vector3d angular_rate_;
     Eigen::VectorXd ref_rotor_rot_vels_;
 };
 
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ROTORS_GAZEBO_PLUGINS_MPSC_QUEUE_H
+#define ROTORS_GAZEBO_PLUGINS_MPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace gazebo {
+
+/// \brief    Bounded, lock-free queue between any number of producer threads
+///           and one consumer thread.
+/// \details  Every slot carries a sequence number [Vyukov] which tells the
+///           producers whether it is free and the consumer whether it has
+///           been filled. Producers only contend on the tail index, and
+///           neither TryPush() nor TryPop() blocks or allocates. The capacity
+///           is rounded up to a power of two.
+template <class T>
+class MpscQueue {
+ public:
+  explicit MpscQueue(std::size_t capacity)
+      : capacity_(RoundUpToPowerOfTwo(capacity)),
+        cells_(new Cell[capacity_]),
+        head_(0),
+        tail_(0) {
+    for (std::size_t i = 0; i < capacity_; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  /// \brief  Appends a copy of value, may be called from any thread.
+  /// \return False if the queue is full.
+  bool TryPush(const T& value) {
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[tail & (capacity_ - 1)];
+      const std::size_t sequence =
+          cell->sequence.load(std::memory_order_acquire);
+      const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) -
+                                  static_cast<std::ptrdiff_t>(tail);
+      if (diff == 0) {
+        // The slot is free, try to claim it.
+        if (tail_.compare_exchange_weak(tail, tail + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // The consumer has not released this slot yet.
+        return false;
+      } else {
+        // Another producer claimed the slot first.
+        tail = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->value = value;
+    cell->sequence.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// \brief  Removes the oldest element, called by the consumer.
+  /// \return False if the queue is empty, or the oldest element is still
+  ///         being written by a producer.
+  bool TryPop(T* value) {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    Cell* cell = &cells_[head & (capacity_ - 1)];
+    if (cell->sequence.load(std::memory_order_acquire) != head + 1) {
+      return false;
+    }
+    *value = cell->value;
+    cell->sequence.store(head + capacity_, std::memory_order_release);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// \brief  Number of queued elements, only approximate while producers are
+  ///         pushing.
+  std::size_t SizeApprox() const {
+    const std::size_t head = head_.load(std::memory_order_acquire);
+    const std::size_t tail = tail_.load(std::memory_order_acquire);
+    return tail > head ? tail - head : 0;
+  }
+
+  std::size_t Capacity() const { return capacity_; }
+
+ private:
+  static constexpr std::size_t kCacheLineSize = 64;
+
+  struct Cell {
+    std::atomic<std::size_t> sequence;
+    T value;
+  };
+
+  static std::size_t RoundUpToPowerOfTwo(std::size_t n) {
+    std::size_t capacity = 1;
+    while (capacity < n) {
+      capacity <<= 1;
+    }
+    return capacity;
+  }
+
+  const std::size_t capacity_;
+  std::unique_ptr<Cell[]> cells_;
+  /// \brief  Index of the next element to pop, written by the consumer.
+  std::atomic<std::size_t> head_;
+  char head_padding_[kCacheLineSize - sizeof(std::atomic<std::size_t>)];
+  /// \brief  Index of the next element to push, claimed by the producers.
+  std::atomic<std::size_t> tail_;
+  char tail_padding_[kCacheLineSize - sizeof(std::atomic<std::size_t>)];
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_MPSC_QUEUE_H
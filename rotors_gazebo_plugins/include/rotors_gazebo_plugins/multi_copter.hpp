@@ -22,6 +22,8 @@
 #ifndef ROTORS_GAZEBO_PLUGINS_MULTI_COPTER_H
 #define ROTORS_GAZEBO_PLUGINS_MULTI_COPTER_H
 
+#include <cassert>
+
 #include <Eigen/Eigen>
 
 #include "rotors_gazebo_plugins/motor_controller.hpp"
@@ -31,47 +33,58 @@ class MultiCopter
 {
   public:
     MultiCopter(int amount_rotors) :
+      motor_controller_(nullptr),
       position_(Eigen::Vector3d::Zero()),
       velocity_(Eigen::Vector3d::Zero()),
       attitude_(Eigen::Quaterniond::Identity()),
+      angular_rate_(Eigen::Vector3d::Zero()),
       rotor_rot_vels_(Eigen::VectorXd::Zero(amount_rotors))
     {}
     MultiCopter(int amount_rotors,
-      MotorController& motor_controller) :
+      MotorController* motor_controller) :
       MultiCopter(amount_rotors)
     {
       setMotorController(motor_controller);
     }
-    ~MultiCopter();
+    virtual ~MultiCopter() {}
 
+    // The motor controller is not owned by the multicopter.
     void setMotorController(
-      MotorController& motor_controller) {
+      MotorController* motor_controller) {
       motor_controller_ = motor_controller;
     }
 
-    Eigen::VectorXd getRefMotorVelocities(double dt) {
-      return motor_controller_.getMotorVelocities(dt);
+    // Passes the current state to the motor controller and returns its
+    // reference rotor velocities.
+    const Eigen::VectorXd& getRefMotorVelocities(double dt) {
+      assert(motor_controller_ != nullptr);
+      motor_controller_->setState(position_, velocity_, attitude_,
+                                  angular_rate_);
+      return motor_controller_->getMotorVelocities(dt);
     }
 
-    Eigen::VectorXd getMotorVelocities() {
+    const Eigen::VectorXd& getMotorVelocities() const {
       return rotor_rot_vels_;
     }
 
-    virtual Eigen::Vector4d simulateMAV(double dt,
-      Eigen::VectorXd ref_rotor_rot_vels) = 0;
+    // Advances the vehicle by dt, with the rotors tracking ref_rotor_rot_vels.
+    virtual void simulateMAV(double dt,
+      const Eigen::VectorXd& ref_rotor_rot_vels) = 0;
     virtual void initializeParams() = 0;
     virtual void publish() = 0;
 
-    const MotorController motorController() {
+    MotorController* motorController() const {
       return motor_controller_;
     }
-    const Eigen::Vector3d position() {return position_;}
-    const Eigen::Vector3d velocity() {return velocity_;}
-    const Eigen::Quaterniond attitude() {return attitude_;}
+    // Position and velocity in world frame, angular rate in body frame.
+    const Eigen::Vector3d& position() const {return position_;}
+    const Eigen::Vector3d& velocity() const {return velocity_;}
+    const Eigen::Quaterniond& attitude() const {return attitude_;}
+    const Eigen::Vector3d& angularRate() const {return angular_rate_;}
 
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
   protected:
-    MotorController motor_controller_;
+    MotorController* motor_controller_;
     Eigen::Vector3d position_;
     Eigen::Vector3d velocity_;
     Eigen::Quaterniond attitude_;
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_NORMAL_SAMPLE_BUFFER_H
+#define ROTORS_GAZEBO_PLUGINS_NORMAL_SAMPLE_BUFFER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gazebo {
+
+// Default values
+static constexpr std::size_t kDefaultNormalSampleBlockSize = 1024;
+static constexpr uint64_t kDefaultNormalSampleSeed = 5489u;
+
+/// \brief    Standard normal samples, generated ahead of time in blocks.
+/// \details  The samples are drawn with the ziggurat method of Marsaglia and
+///           Tsang (128 layers) from a xorshift128+ generator, in a tight loop
+///           over the whole block, which is considerably cheaper than drawing
+///           them one by one through std::normal_distribution.
+class NormalSampleBuffer {
+ public:
+  explicit NormalSampleBuffer(
+      std::size_t block_size = kDefaultNormalSampleBlockSize,
+      uint64_t seed = kDefaultNormalSampleSeed)
+      : samples_(block_size), index_(samples_.size()) {
+    // Layer boundaries for r = x[1] and layer area v [Marsaglia 2000].
+    const double r = 3.442619855899;
+    const double v = 9.91256303526217e-3;
+    x_[0] = v / std::exp(-0.5 * r * r);
+    x_[1] = r;
+    for (int i = 1; i < kNumLayers - 1; ++i) {
+      x_[i + 1] = std::sqrt(-2.0 * std::log(v / x_[i] + std::exp(-0.5 * x_[i] * x_[i])));
+    }
+    x_[kNumLayers] = 0.0;
+    for (int i = 0; i <= kNumLayers; ++i) {
+      f_[i] = std::exp(-0.5 * x_[i] * x_[i]);
+    }
+    Seed(seed);
+  }
+
+  /// \brief  Restarts the sequence from the given seed.
+  void Seed(uint64_t seed) {
+    // Expand the seed with splitmix64, the state must not be all zero.
+    for (int i = 0; i < 2; ++i) {
+      seed += 0x9E3779B97F4A7C15ull;
+      uint64_t z = seed;
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      state_[i] = z ^ (z >> 31);
+    }
+    index_ = samples_.size();
+  }
+
+  /// \brief  Returns the next standard normal sample.
+  double Next() {
+    if (index_ == samples_.size()) {
+      Refill();
+    }
+    return samples_[index_++];
+  }
+
+  /// \brief  State the sequence continues from, to be passed to SetState().
+  /// \details The samples of a block are regenerated from the generator state
+  ///          at its start, so that the state stays a few bytes.
+  void GetState(uint64_t state[2], std::size_t* index) const {
+    const uint64_t* source = index_ < samples_.size() ? block_state_ : state_;
+    state[0] = source[0];
+    state[1] = source[1];
+    *index = index_;
+  }
+
+  /// \brief  Continues the sequence from a state returned by GetState().
+  void SetState(const uint64_t state[2], std::size_t index) {
+    state_[0] = state[0];
+    state_[1] = state[1];
+    if (index < samples_.size()) {
+      Refill();
+      index_ = index;
+    } else {
+      index_ = samples_.size();
+    }
+  }
+
+  /// \brief  Writes the next n standard normal samples to out.
+  template <class T>
+  void Fill(T* out, std::size_t n) {
+    while (n > 0) {
+      if (index_ == samples_.size()) {
+        Refill();
+      }
+      const std::size_t count = std::min(n, samples_.size() - index_);
+      const double* samples = &samples_[index_];
+      for (std::size_t i = 0u; i < count; ++i) {
+        out[i] = static_cast<T>(samples[i]);
+      }
+      index_ += count;
+      out += count;
+      n -= count;
+    }
+  }
+
+ private:
+  static constexpr int kNumLayers = 128;
+
+  uint64_t NextBits() {
+    uint64_t s1 = state_[0];
+    const uint64_t s0 = state_[1];
+    state_[0] = s0;
+    s1 ^= s1 << 23;
+    state_[1] = s1 ^ s0 ^ (s1 >> 17) ^ (s0 >> 26);
+    return state_[1] + s0;
+  }
+
+  /// \brief  Uniform number in [0, 1) from the upper 53 bits.
+  static double ToUniform(uint64_t bits) {
+    return (bits >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  double Sample() {
+    while (true) {
+      // The lowest bits select the layer, the upper bits the position in it.
+      const uint64_t bits = NextBits();
+      const int i = bits & (kNumLayers - 1);
+      const double x = (2.0 * ToUniform(bits) - 1.0) * x_[i];
+      if (std::abs(x) < x_[i + 1]) {
+        return x;
+      }
+      if (i == 0) {
+        // Tail beyond r.
+        double a, b;
+        do {
+          a = -std::log(1.0 - ToUniform(NextBits())) / x_[1];
+          b = -std::log(1.0 - ToUniform(NextBits()));
+        } while (2.0 * b < a * a);
+        return x > 0.0 ? x_[1] + a : -x_[1] - a;
+      }
+      // Wedge between the rectangle of the layer and the density.
+      if (f_[i] + ToUniform(NextBits()) * (f_[i + 1] - f_[i]) <
+          std::exp(-0.5 * x * x)) {
+        return x;
+      }
+    }
+  }
+
+  void Refill() {
+    block_state_[0] = state_[0];
+    block_state_[1] = state_[1];
+    for (std::size_t i = 0u; i < samples_.size(); ++i) {
+      samples_[i] = Sample();
+    }
+    index_ = 0;
+  }
+
+  std::vector<double> samples_;
+  std::size_t index_;
+  uint64_t state_[2];
+  /// \brief  Generator state the current block was drawn from.
+  uint64_t block_state_[2];
+  /// \brief  Right edges of the layers and the density at these edges.
+  double x_[kNumLayers + 1];
+  double f_[kNumLayers + 1];
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_NORMAL_SAMPLE_BUFFER_H
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_PROFILING_H
+#define ROTORS_GAZEBO_PLUGINS_PROFILING_H
+
+/// \file     Timing instrumentation of the plugin hot paths.
+/// \details  ROTORS_PROFILE_SCOPE(name) times the rest of the enclosing scope
+///           and adds the sample to the histogram of name. Every thread fills
+///           histograms of its own, so recording a sample takes no locks and
+///           no atomic read-modify-writes. Once per second of wall time, the
+///           p50, p99 and max of every name over the last second are
+///           published on ~/rotors/plugin_timing.
+///
+///           The instrumentation is only compiled in with BUILD_PROFILING,
+///           which defines ROTORS_PROFILING. Otherwise, the macro expands to
+///           nothing.
+
+#ifdef ROTORS_PROFILING
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace gazebo {
+
+/// \brief  Histogram of the durations recorded at one instrumented scope.
+class ProfilingSite {
+ public:
+  /// \brief  Four buckets per octave of nanoseconds, up to 2^40 ns.
+  static constexpr int kBucketCount = 160;
+
+  /// \brief  Samples of one thread, only written by that thread.
+  struct Histogram {
+    Histogram();
+    std::atomic<uint64_t> buckets[kBucketCount];
+    std::atomic<uint64_t> max_ns;
+  };
+
+  /// \brief  Returns the site of a name, creating it on first use. Sites are
+  ///         never destroyed.
+  static ProfilingSite* Get(const std::string& name);
+
+  /// \brief  Returns all sites created so far.
+  static std::vector<ProfilingSite*> Sites();
+
+  static int Bucket(uint64_t ns);
+
+  /// \brief  Lower bound of the duration of a bucket [ns].
+  static double BucketLowerBound(int bucket);
+
+  void Record(uint64_t ns) {
+    Histogram* histogram = LocalHistogram();
+    std::atomic<uint64_t>& bucket = histogram->buckets[Bucket(ns)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+    // Collect() resets the max from another thread, a plain store could
+    // overwrite that reset with a smaller stale max.
+    uint64_t max_ns = histogram->max_ns.load(std::memory_order_relaxed);
+    while (ns > max_ns &&
+           !histogram->max_ns.compare_exchange_weak(
+               max_ns, ns, std::memory_order_relaxed)) {
+    }
+  }
+
+  /// \brief  Sums the histograms of all threads. The max is reset.
+  void Collect(std::vector<uint64_t>* counts, uint64_t* max_ns);
+
+  const std::string& Name() const { return name_; }
+
+ private:
+  ProfilingSite(const std::string& name, int id);
+
+  Histogram* LocalHistogram() {
+    static thread_local std::vector<Histogram*> histograms;
+    if (static_cast<std::size_t>(id_) < histograms.size() &&
+        histograms[id_] != nullptr) {
+      return histograms[id_];
+    }
+    return AddLocalHistogram(&histograms);
+  }
+
+  Histogram* AddLocalHistogram(std::vector<Histogram*>* histograms);
+
+  std::string name_;
+  int id_;
+
+  std::mutex mutex_;
+  std::vector<Histogram*> histograms_;
+};
+
+/// \brief  Records the time from construction to destruction at a site.
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(ProfilingSite* site)
+      : site_(site), start_(std::chrono::steady_clock::now()) {}
+
+  ~ScopedTimer() {
+    site_->Record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_).count());
+  }
+
+ private:
+  ProfilingSite* site_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace gazebo
+
+#define ROTORS_PROFILE_CONCAT_IMPL(a, b) a##b
+#define ROTORS_PROFILE_CONCAT(a, b) ROTORS_PROFILE_CONCAT_IMPL(a, b)
+
+#define ROTORS_PROFILE_SCOPE(name)                                         \
+  static ::gazebo::ProfilingSite* const ROTORS_PROFILE_CONCAT(             \
+      rotors_profile_site_, __LINE__) = ::gazebo::ProfilingSite::Get(name); \
+  ::gazebo::ScopedTimer ROTORS_PROFILE_CONCAT(rotors_profile_timer_,        \
+                                              __LINE__)(                    \
+      ROTORS_PROFILE_CONCAT(rotors_profile_site_, __LINE__))
+
+#else  // ROTORS_PROFILING
+
+#define ROTORS_PROFILE_SCOPE(name)
+
+#endif  // ROTORS_PROFILING
+
+#endif  // ROTORS_GAZEBO_PLUGINS_PROFILING_H
@@ -0,0 +1,140 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_PUBLISH_POLICY_H
+#define ROTORS_GAZEBO_PLUGINS_PUBLISH_POLICY_H
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "rotors_gazebo_plugins/common.h"
+#include "rotors_gazebo_plugins/rate_scheduler.h"
+
+namespace gazebo {
+
+// Default values
+static const std::string kDefaultPublishMode = "every_tick";
+static constexpr double kDefaultPublishRate = 0.0;  // [Hz]
+static constexpr double kDefaultPublishChangeThreshold = 0.0;
+static constexpr double kDefaultPublishHeartbeatPeriod = 1.0;  // [s]
+
+/// \brief    Decides when a plugin publishes a slowly varying signal, e.g.
+///           a constant wind or the magnetic field.
+/// \details  The mode is read from the publishMode parameter of the plugin:
+///           - every_tick: every measurement is published, the default.
+///           - rate: measurements are published at publishRate.
+///           - on_change: a measurement is published once a value differs
+///             from the last published one by more than
+///             publishChangeThreshold, and at least every
+///             publishHeartbeatPeriod seconds otherwise (0 disables the
+///             heartbeat), so subscribers can tell a constant signal from a
+///             dead publisher.
+///           The threshold is a dead band around the last published values,
+///           so it should be above the noise of the signal. After a world
+///           reset the next measurement is always published.
+class PublishPolicy {
+ public:
+  enum Mode { kEveryTick, kRate, kOnChange };
+
+  /// \brief  Largest number of values a policy compares.
+  static constexpr int kMaxValues = 6;
+
+  PublishPolicy()
+      : mode_(kEveryTick),
+        change_threshold_(kDefaultPublishChangeThreshold),
+        heartbeat_period_(kDefaultPublishHeartbeatPeriod),
+        has_published_(false),
+        last_publish_time_(0.0) {
+    std::fill(last_values_, last_values_ + kMaxValues, 0.0);
+  }
+
+  /// \brief  Reads the policy from the parameters of a plugin.
+  /// \param[in] plugin_name Name used in the error messages.
+  void Load(sdf::ElementPtr sdf, const std::string& plugin_name) {
+    std::string mode = kDefaultPublishMode;
+    double rate = kDefaultPublishRate;
+    getSdfParam<std::string>(sdf, "publishMode", mode, mode);
+    getSdfParam<double>(sdf, "publishRate", rate, rate);
+    getSdfParam<double>(sdf, "publishChangeThreshold", change_threshold_,
+                        change_threshold_);
+    getSdfParam<double>(sdf, "publishHeartbeatPeriod", heartbeat_period_,
+                        heartbeat_period_);
+    if (mode == "rate" && rate > 0.0) {
+      mode_ = kRate;
+      scheduler_.SetRate(rate);
+    } else if (mode == "on_change") {
+      mode_ = kOnChange;
+    } else if (mode != "every_tick") {
+      gzerr << "[" << plugin_name << "] Unknown publishMode \"" << mode
+            << "\" or publishRate not positive, expected every_tick, rate or "
+               "on_change. Publishing every tick.\n";
+    }
+  }
+
+  /// \brief  True if the measurement of num_values values at time [s]
+  ///         should be published, it then becomes the last published one.
+  bool ShouldPublish(double time, const double* values, int num_values) {
+    if (num_values > kMaxValues) num_values = kMaxValues;
+    switch (mode_) {
+      case kEveryTick:
+        return true;
+      case kRate:
+        return scheduler_.Due(time);
+      case kOnChange:
+        break;
+    }
+
+    bool publish = !has_published_ || time < last_publish_time_ ||
+                   (heartbeat_period_ > 0.0 &&
+                    time - last_publish_time_ >= heartbeat_period_);
+    for (int i = 0; i < num_values && !publish; ++i) {
+      publish = std::abs(values[i] - last_values_[i]) > change_threshold_;
+    }
+    if (!publish) {
+      return false;
+    }
+    std::copy(values, values + num_values, last_values_);
+    has_published_ = true;
+    last_publish_time_ = time;
+    return true;
+  }
+
+  Mode mode() const { return mode_; }
+
+  double change_threshold() const { return change_threshold_; }
+  void set_change_threshold(double change_threshold) {
+    change_threshold_ = change_threshold;
+  }
+
+ private:
+  Mode mode_;
+  RateScheduler scheduler_;
+  double change_threshold_;
+  double heartbeat_period_;
+
+  bool has_published_;
+  double last_publish_time_;
+  double last_values_[kMaxValues];
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_PUBLISH_POLICY_H
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_PYRAMID_OPTICAL_FLOW_H
+#define ROTORS_GAZEBO_PLUGINS_PYRAMID_OPTICAL_FLOW_H
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace gazebo {
+
+// Default values
+static constexpr unsigned int kDefaultOpticalFlowRoiSize = 64;
+static constexpr int kDefaultOpticalFlowOutputRate = 20;
+
+/// \brief    Lucas-Kanade flow on the central, downsampled region of a camera
+///           image, with the same output as the PX4 OpticalFlow library.
+/// \details  Only the central square of the image is used, converted to
+///           grayscale and downsampled to roi_size x roi_size (64 x 64, as on
+///           a PX4Flow sensor). The pyramid and the tracked features of the
+///           previous frame are kept, so every frame builds just one pyramid,
+///           and new features are only detected once too many were lost. All
+///           buffers are reused between frames.
+class PyramidOpticalFlow {
+ public:
+  /// \param[in]  focal_length  Focal length of the full image [px].
+  /// \param[in]  output_rate   Rate of the integrated flow [Hz], -1 outputs
+  ///                           the flow of every frame.
+  PyramidOpticalFlow(unsigned int width, unsigned int height,
+                     unsigned int depth, float focal_length, int output_rate,
+                     unsigned int roi_size = kDefaultOpticalFlowRoiSize);
+
+  /// \brief  Tracks the features from the previous frame into image (RGB or
+  ///         grayscale, as given by the depth).
+  /// \param[out] dt_us   Integration time of the output flow [us].
+  /// \param[out] flow_x  Integrated angular flow around the image x axis.
+  /// \param[out] flow_y  Integrated angular flow around the image y axis.
+  /// \return The quality in [0, 255], or -1 if no flow is due yet.
+  int calcFlow(const uint8_t* image, uint32_t image_time_us, int& dt_us,
+               float& flow_x, float& flow_y);
+
+ private:
+  static constexpr int kMaxFeatures = 32;
+  static constexpr int kMinFeatures = 16;
+  static constexpr int kPyramidLevels = 2;
+  static constexpr int kWindowSize = 13;
+
+  /// \brief  Converts and downsamples the central square of image to roi_.
+  void PrepareRoi(const uint8_t* image);
+  void DetectFeatures(std::vector<cv::Point2f>* features);
+
+  unsigned int width_;
+  unsigned int height_;
+  unsigned int depth_;
+  unsigned int roi_size_;
+  cv::Rect roi_rect_;
+  /// \brief  Focal length in pixels of the downsampled region.
+  float focal_length_;
+  uint32_t output_interval_us_;
+
+  cv::Mat gray_;
+  cv::Mat roi_;
+  std::vector<cv::Mat> pyramid_;
+  std::vector<cv::Mat> previous_pyramid_;
+  std::vector<cv::Point2f> features_;
+  std::vector<cv::Point2f> previous_features_;
+  std::vector<uchar> status_;
+  std::vector<float> error_;
+
+  bool has_previous_;
+  uint32_t previous_time_us_;
+
+  float flow_x_integral_;
+  float flow_y_integral_;
+  uint32_t integration_time_us_;
+  int num_tracked_;
+  int num_features_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_PYRAMID_OPTICAL_FLOW_H
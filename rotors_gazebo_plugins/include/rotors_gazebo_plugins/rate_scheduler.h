@@ -0,0 +1,66 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_RATE_SCHEDULER_H
+#define ROTORS_GAZEBO_PLUGINS_RATE_SCHEDULER_H
+
+namespace gazebo {
+
+/// \brief    Decides which of a stream of events in simulation time are due
+///           to sample a sensor at a fixed rate.
+/// \details  The events are due on a fixed grid of 1 / rate, so a rate that
+///           does not divide the event rate does not drift. If events are
+///           missed for longer than a period, the grid restarts at the next
+///           event. A rate of 0 makes every event due.
+class RateScheduler {
+ public:
+  RateScheduler() : period_(0.0), next_time_(0.0), last_time_(0.0) {}
+
+  /// \param[in] rate Sensor rate [Hz], 0 for every event.
+  void SetRate(double rate) {
+    period_ = rate > 0.0 ? 1.0 / rate : 0.0;
+    next_time_ = 0.0;
+  }
+
+  /// \brief  True if the event at time [s] is due, the next one is scheduled
+  ///         then.
+  bool Due(double time) {
+    // The world was reset.
+    if (time < last_time_) next_time_ = time;
+    last_time_ = time;
+    if (period_ <= 0.0) return true;
+    // Events a tiny bit early are due, e.g. 1 kHz steps for a 250 Hz rate.
+    if (time < next_time_ - kTolerance * period_) return false;
+    next_time_ += period_;
+    if (next_time_ <= time) next_time_ = time + period_;
+    return true;
+  }
+
+ private:
+  static constexpr double kTolerance = 1.0e-3;
+
+  double period_;
+  double next_time_;
+  double last_time_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_RATE_SCHEDULER_H
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_RIGID_BODY_STATE_H
+#define ROTORS_GAZEBO_PLUGINS_RIGID_BODY_STATE_H
+
+#include <memory>
+#include <mutex>
+
+#include <gazebo/physics/physics.hh>
+
+namespace gazebo {
+
+/// \brief  Kinematic state of a link at one physics step.
+struct RigidBodyState {
+  ignition::math::Pose3d world_pose;
+  ignition::math::Pose3d world_cog_pose;
+  ignition::math::Vector3d world_linear_vel;
+  ignition::math::Vector3d world_angular_vel;
+  ignition::math::Vector3d relative_linear_vel;
+  ignition::math::Vector3d relative_angular_vel;
+  ignition::math::Vector3d world_linear_accel;
+  ignition::math::Vector3d relative_linear_accel;
+};
+
+/// \brief    Snapshot of the state of a link, shared by all plugins reading it.
+/// \details  The sensor and actuator plugins of a model get the cache of the
+///           link they are attached to. The first plugin reading the state in
+///           a physics step queries the physics engine, all others read the
+///           same snapshot, so that every plugin sees a consistent state.
+class RigidBodyStateCache {
+ public:
+  explicit RigidBodyStateCache(physics::LinkPtr link);
+
+  /// \brief  Returns the cache of a link, creating it on first use. The cache
+  ///         is released when the last plugin holding it is unloaded.
+  static std::shared_ptr<RigidBodyStateCache> Get(const physics::LinkPtr& link);
+
+  /// \brief  Returns the state of the link at the current physics step. It
+  ///         is returned by value, since plugins also read it on transport
+  ///         threads while the physics thread updates the cache.
+  RigidBodyState State();
+
+  const physics::LinkPtr& Link() const { return link_; }
+
+ private:
+  physics::LinkPtr link_;
+  physics::WorldPtr world_;
+
+  /// \brief  Physics iteration the snapshot was taken at.
+  uint64_t last_update_iteration_;
+  bool updated_;
+
+  std::mutex mutex_;
+  RigidBodyState state_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_RIGID_BODY_STATE_H
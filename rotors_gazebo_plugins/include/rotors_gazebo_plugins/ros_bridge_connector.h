@@ -0,0 +1,75 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_ROS_BRIDGE_CONNECTOR_H
+#define ROTORS_GAZEBO_PLUGINS_ROS_BRIDGE_CONNECTOR_H
+
+#include <gazebo/transport/transport.hh>
+
+#include "ConnectGazeboToRosTopic.pb.h"
+#include "ConnectGazeboToRosTopics.pb.h"
+
+#include "rotors_gazebo_plugins/common.h"
+
+namespace gazebo {
+
+/// \brief    Collects the Gazebo->ROS connections of a plugin and requests all
+///           of them from the ROS interface plugin with one message.
+/// \details  Publish() does not block. The ROS interface plugin subscribes to
+///           the batches with latching, so the batch is delivered even if it
+///           subscribes after it was published, as long as the publisher is
+///           alive. The connector therefore has to live as long as the plugin.
+class RosBridgeConnector {
+ public:
+  void Add(const gz_std_msgs::ConnectGazeboToRosTopic& connection) {
+    *msg_.add_connections() = connection;
+  }
+
+  void Add(const std::string& gazebo_topic, const std::string& ros_topic,
+           gz_std_msgs::ConnectGazeboToRosTopic::MsgType msg_type) {
+    gz_std_msgs::ConnectGazeboToRosTopic* connection = msg_.add_connections();
+    connection->set_gazebo_topic(gazebo_topic);
+    connection->set_ros_topic(ros_topic);
+    connection->set_msgtype(msg_type);
+  }
+
+  /// \brief  Sends the connections added so far. Only the latest batch of a
+  ///         connector is kept for a late subscriber, so all connections
+  ///         should be added before.
+  void Publish(const transport::NodePtr& node_handle) {
+    if (msg_.connections_size() == 0) {
+      return;
+    }
+    if (!pub_) {
+      pub_ = node_handle->Advertise<gz_std_msgs::ConnectGazeboToRosTopics>(
+          "~/" + kConnectGazeboToRosBatchSubtopic, 1);
+    }
+    pub_->Publish(msg_, false);
+    msg_.Clear();
+  }
+
+ private:
+  gz_std_msgs::ConnectGazeboToRosTopics msg_;
+  transport::PublisherPtr pub_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_ROS_BRIDGE_CONNECTOR_H
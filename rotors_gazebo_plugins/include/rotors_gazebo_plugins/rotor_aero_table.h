@@ -0,0 +1,94 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_ROTOR_AERO_TABLE_H
+#define ROTORS_GAZEBO_PLUGINS_ROTOR_AERO_TABLE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gazebo {
+
+/// \brief    Precomputed thrust and torque coefficients of a rotor, e.g. from
+///           momentum theory or BEMT, over rotor speed and airspeed.
+/// \details  The coefficients are the thrust [N] and the drag torque [Nm]
+///           per squared rotor velocity [(rad/s)^2], so that a table that is
+///           constant over the airspeeds reproduces motorConstant and
+///           motorConstant * momentConstant. The text file lists the axes as
+///
+///             min_rotor_speed: 0           (|omega| [rad/s])
+///             res_rotor_speed: 100
+///             n_rotor_speed: 10
+///             min_axial_speed: -10         (climb speed along the thrust [m/s])
+///             res_axial_speed: 1
+///             n_axial_speed: 21
+///             min_perpendicular_speed: 0   (edgewise speed [m/s])
+///             res_perpendicular_speed: 1
+///             n_perpendicular_speed: 11
+///
+///           followed by the thrust_coefficients: and torque_coefficients:
+///           lines, with the perpendicular speed varying fastest and the
+///           rotor speed slowest. Both coefficients of a grid vertex are
+///           stored next to each other, so that a lookup reads eight
+///           neighbouring pairs. Speeds outside of the table are clamped.
+class RotorAeroTable {
+ public:
+  RotorAeroTable();
+
+  /// \brief  Returns the table of a file, reading it on first use, or NULL
+  ///         if it cannot be read. All rotors using the same file share it.
+  static std::shared_ptr<const RotorAeroTable> Get(const std::string& path);
+
+  /// \brief  Reads the table from a text file.
+  /// \return False if the file cannot be read or is inconsistent.
+  bool LoadText(const std::string& path);
+
+  /// \brief  Interpolates the coefficients trilinearly, that is bilinearly
+  ///         in the airspeeds between the two nearest rotor speeds.
+  /// \param[in]  rotor_speed Absolute rotor velocity [rad/s].
+  /// \param[in]  axial_speed Velocity of the rotor through the air along its
+  ///             thrust direction [m/s].
+  /// \param[in]  perpendicular_speed Velocity of the rotor through the air
+  ///             perpendicular to its axis [m/s].
+  void Lookup(double rotor_speed, double axial_speed,
+              double perpendicular_speed, double* thrust_coefficient,
+              double* torque_coefficient) const;
+
+ private:
+  /// \brief  Uniformly spaced axis of the table.
+  struct Axis {
+    double min;
+    double inv_res;
+    int n;
+
+    /// \brief  Index of the lower vertex and weight of the upper one.
+    void Locate(double value, int* index, double* weight) const;
+  };
+
+  /// \brief  Rotor speed, axial and perpendicular speed.
+  Axis axes_[3];
+  /// \brief  Thrust and torque coefficients of every vertex, interleaved.
+  std::vector<double> coefficients_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_ROTOR_AERO_TABLE_H
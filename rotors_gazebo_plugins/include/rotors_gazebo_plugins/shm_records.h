@@ -0,0 +1,89 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ROTORS_GAZEBO_PLUGINS_SHM_RECORDS_H
+#define ROTORS_GAZEBO_PLUGINS_SHM_RECORDS_H
+
+#include <cstdint>
+
+namespace gazebo {
+
+/// \brief  Record types of the shared memory rings, checked when a reader
+///         opens a ring.
+enum ShmRecordType : uint32_t {
+  kShmImuRecord = 1,
+  kShmOdometryRecord = 2,
+  kShmRotorVelocitiesRecord = 3,
+};
+
+/// \brief  Largest number of rotors in a ShmRotorVelocitiesRecord.
+static constexpr int kShmMaxRotors = 16;
+
+/// \brief  Stamp of a record, in simulation time.
+struct ShmStamp {
+  int32_t sec;
+  int32_t nsec;
+};
+
+/// \brief  IMU measurement, the fields of gz_sensor_msgs::Imu.
+/// \details The frame id is stored once in the ring.
+struct ShmImuRecord {
+  static constexpr ShmRecordType kType = kShmImuRecord;
+
+  ShmStamp stamp;
+  /// \brief  w, x, y, z.
+  double orientation[4];
+  double angular_velocity[3];
+  double linear_acceleration[3];
+  double orientation_covariance[9];
+  double angular_velocity_covariance[9];
+  double linear_acceleration_covariance[9];
+};
+
+/// \brief  Odometry measurement, the fields of gz_geometry_msgs::Odometry.
+/// \details The parent and child frame ids are stored once in the ring.
+struct ShmOdometryRecord {
+  static constexpr ShmRecordType kType = kShmOdometryRecord;
+
+  ShmStamp stamp;
+  double position[3];
+  /// \brief  w, x, y, z.
+  double orientation[4];
+  double linear_velocity[3];
+  double angular_velocity[3];
+  double pose_covariance[36];
+  double twist_covariance[36];
+};
+
+/// \brief  Rotor velocities, used both for the measured and for the
+///         commanded velocities of a vehicle.
+struct ShmRotorVelocitiesRecord {
+  static constexpr ShmRecordType kType = kShmRotorVelocitiesRecord;
+
+  ShmStamp stamp;
+  int32_t num_rotors;
+  int32_t padding;
+  double angular_velocities[kShmMaxRotors];
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_SHM_RECORDS_H
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ROTORS_GAZEBO_PLUGINS_SHM_RING_H
+#define ROTORS_GAZEBO_PLUGINS_SHM_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace gazebo {
+
+static constexpr bool kDefaultShmTransport = false;
+static constexpr uint32_t kDefaultShmRingCapacity = 64;
+/// \brief  Size of the frame id strings stored in a ring, including the
+///         terminating zero.
+static constexpr std::size_t kShmFrameIdSize = 64;
+/// \brief  Simulation steps between two attempts of a reader to open a ring
+///         that does not exist yet.
+static constexpr int kShmOpenRetrySteps = 100;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "The shared memory ring needs lock-free 64 bit atomics.");
+
+/// \brief    Name of the shared memory segment that mirrors a Gazebo topic.
+/// \details  The name contains the id of the gzserver process, so that the
+///           rings of simulations running side by side do not collide, and
+///           is the same for every plugin of the process that asks for the
+///           same topic.
+std::string ShmRingName(const std::string& gazebo_topic);
+
+/// \brief    Fixed size records in a named POSIX shared memory segment,
+///           written by one producer and read by any number of readers, in
+///           this or in other processes.
+/// \details  Write() never blocks and never waits for the readers: a reader
+///           that falls behind by more than the capacity of the ring loses
+///           the oldest records, which suits sensor streams where only
+///           recent data matters. Every slot carries a sequence number that
+///           is odd while the producer writes it, so that a reader detects a
+///           record overwritten while it copied it and drops it instead of
+///           returning it torn.
+///
+///           The producer creates the segment, and unlinks it when the ring
+///           is destroyed. A reader only sees the records written after it
+///           opened the ring.
+class ShmRing {
+ public:
+  ShmRing();
+  ~ShmRing();
+
+  ShmRing(const ShmRing&) = delete;
+  ShmRing& operator=(const ShmRing&) = delete;
+
+  /// \brief  Creates the segment name as the producer of the ring,
+  ///         replacing a segment left behind by an earlier process.
+  /// \param[in] capacity Number of records, rounded up to a power of 2.
+  bool Create(const std::string& name, uint32_t record_type,
+              uint32_t record_size, uint32_t capacity,
+              const std::string& frame_id, const std::string& child_frame_id);
+
+  /// \brief  Opens an existing segment as a reader. Fails if it does not
+  ///         exist yet or holds another record type.
+  bool Open(const std::string& name, uint32_t record_type,
+            uint32_t record_size);
+
+  void Close();
+
+  bool IsOpen() const { return header_ != nullptr; }
+
+  /// \brief  Appends a record, only called by the producer.
+  void Write(const void* record);
+
+  /// \brief  Copies the oldest record not read yet.
+  /// \return False if there is none.
+  bool Read(void* record);
+
+  /// \brief  Copies the newest record and skips all older ones.
+  /// \return False if nothing was written since the last read.
+  bool ReadLatest(void* record);
+
+  const char* frame_id() const;
+  const char* child_frame_id() const;
+
+  /// \brief  Records this reader lost because the producer overtook it.
+  uint64_t num_lost() const { return num_lost_; }
+
+ private:
+  struct Header;
+
+  std::atomic<uint64_t>* SlotSequence(uint64_t index) const;
+  const char* SlotData(uint64_t index) const;
+
+  std::string name_;
+  bool owner_;
+  void* memory_;
+  std::size_t memory_size_;
+  Header* header_;
+  std::size_t slot_size_;
+  uint32_t record_size_;
+  uint64_t index_mask_;
+
+  /// \brief  Index of the next record to read, per reader.
+  uint64_t read_count_;
+  uint64_t num_lost_;
+};
+
+/// \brief    Producer end of a ring of RecordT, which has to be trivially
+///           copyable and define its ShmRecordType kType.
+template <class RecordT>
+class ShmRingWriter {
+ public:
+  bool Create(const std::string& name, const std::string& frame_id = "",
+              const std::string& child_frame_id = "",
+              uint32_t capacity = kDefaultShmRingCapacity) {
+    return ring_.Create(name, RecordT::kType, sizeof(RecordT), capacity,
+                        frame_id, child_frame_id);
+  }
+  bool IsOpen() const { return ring_.IsOpen(); }
+  void Write(const RecordT& record) { ring_.Write(&record); }
+
+ private:
+  static_assert(std::is_trivially_copyable<RecordT>::value,
+                "Shared memory records must be trivially copyable.");
+  ShmRing ring_;
+};
+
+/// \brief    Reader end of a ring of RecordT.
+template <class RecordT>
+class ShmRingReader {
+ public:
+  bool Open(const std::string& name) {
+    return ring_.Open(name, RecordT::kType, sizeof(RecordT));
+  }
+  bool IsOpen() const { return ring_.IsOpen(); }
+  bool Read(RecordT* record) { return ring_.Read(record); }
+  bool ReadLatest(RecordT* record) { return ring_.ReadLatest(record); }
+  const char* frame_id() const { return ring_.frame_id(); }
+  const char* child_frame_id() const { return ring_.child_frame_id(); }
+  uint64_t num_lost() const { return ring_.num_lost(); }
+
+ private:
+  ShmRing ring_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_SHM_RING_H
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_SIMULATION_CHECKPOINT_H
+#define ROTORS_GAZEBO_PLUGINS_SIMULATION_CHECKPOINT_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <Eigen/Core>
+#include <gazebo/common/common.hh>
+#include <gazebo/physics/physics.hh>
+
+#include "rotors_gazebo_plugins/checkpoint_stream.h"
+
+namespace gazebo {
+
+class SimulationCheckpoint;
+
+/// \brief    Registration of a plugin with the checkpoint of its world.
+/// \details  Unregisters the plugin when destroyed.
+class CheckpointConnection {
+ public:
+  CheckpointConnection(std::shared_ptr<SimulationCheckpoint> checkpoint,
+                       int id);
+  ~CheckpointConnection();
+
+ private:
+  std::shared_ptr<SimulationCheckpoint> checkpoint_;
+  int id_;
+};
+
+typedef std::shared_ptr<CheckpointConnection> CheckpointConnectionPtr;
+
+/// \brief    Saves and restores the state of a world together with the
+///           internal state of its RotorS plugins.
+/// \details  A checkpoint is a binary blob of the simulation time and
+///           iteration, the pose and velocity of all links and the position
+///           and velocity of all joints of the non-static models, followed by
+///           one section per registered plugin. The plugins register under a
+///           name that is unique and stable across runs, derived from the
+///           scoped name of their model and link, and write whatever state is
+///           not set up again from SDF: noise processes, random number
+///           generators, filters and delay queues.
+///
+///           Restoring a checkpoint requires the same models and plugins to
+///           be loaded, models are not spawned or removed. The contact state
+///           of the physics engine is not part of a checkpoint, so a restored
+///           run does not repeat the original one bit by bit.
+///
+///           Save() and Restore() must not overlap with a world update, they
+///           are called from the world update end event or while the world is
+///           paused, see GazeboCheckpointPlugin.
+class SimulationCheckpoint {
+ public:
+  typedef std::function<void(CheckpointWriter*)> SaveCallback;
+  typedef std::function<bool(CheckpointReader*)> RestoreCallback;
+
+  explicit SimulationCheckpoint(physics::WorldPtr world);
+
+  /// \brief  Returns the checkpoint of a world, creating it on first use. It
+  ///         is released when the last plugin is unregistered.
+  static std::shared_ptr<SimulationCheckpoint> Get(
+      const physics::WorldPtr& world);
+
+  /// \brief  Registers the state of a plugin with the checkpoint of its world.
+  static CheckpointConnectionPtr Connect(const physics::WorldPtr& world,
+                                         const std::string& name,
+                                         const SaveCallback& save,
+                                         const RestoreCallback& restore);
+
+  /// \return Id to unregister the plugin with.
+  int Register(const std::string& name, const SaveCallback& save,
+               const RestoreCallback& restore);
+
+  void Unregister(int id);
+
+  /// \brief  Writes the world and all registered plugins to blob.
+  bool Save(std::string* blob);
+
+  /// \brief  Sets the world and all registered plugins to the state in blob.
+  /// \return False if the blob is not a checkpoint or did not match the
+  ///         world, which is then only partially restored.
+  bool Restore(const std::string& blob);
+
+  /// \brief  Writes a checkpoint to a file, through a temporary file that is
+  ///         renamed once it is complete.
+  static bool WriteFile(const std::string& path, const std::string& blob);
+
+  static bool ReadFile(const std::string& path, std::string* blob);
+
+ private:
+  struct Entry {
+    std::string name;
+    SaveCallback save;
+    RestoreCallback restore;
+  };
+
+  void SaveWorld(CheckpointWriter* writer);
+  bool RestoreWorld(CheckpointReader* reader);
+
+  physics::WorldPtr world_;
+
+  /// \brief  Guards the entries, plugins are loaded and unloaded while a
+  ///         checkpoint may be taken.
+  std::mutex mutex_;
+  std::map<int, Entry> entries_;
+  int next_id_;
+};
+
+// Helpers for the Gazebo and Eigen types held by the plugins.
+void WriteCheckpoint(const common::Time& time, CheckpointWriter* writer);
+void WriteCheckpoint(const ignition::math::Vector3d& vector,
+                     CheckpointWriter* writer);
+void WriteCheckpoint(const ignition::math::Quaterniond& quaternion,
+                     CheckpointWriter* writer);
+void WriteCheckpoint(const ignition::math::Pose3d& pose,
+                     CheckpointWriter* writer);
+void WriteCheckpoint(const Eigen::Vector3d& vector, CheckpointWriter* writer);
+
+bool ReadCheckpoint(CheckpointReader* reader, common::Time* time);
+bool ReadCheckpoint(CheckpointReader* reader, ignition::math::Vector3d* vector);
+bool ReadCheckpoint(CheckpointReader* reader,
+                    ignition::math::Quaterniond* quaternion);
+bool ReadCheckpoint(CheckpointReader* reader, ignition::math::Pose3d* pose);
+bool ReadCheckpoint(CheckpointReader* reader, Eigen::Vector3d* vector);
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_SIMULATION_CHECKPOINT_H
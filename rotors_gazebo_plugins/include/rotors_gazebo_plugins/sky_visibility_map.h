@@ -0,0 +1,118 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_SKY_VISIBILITY_MAP_H
+#define ROTORS_GAZEBO_PLUGINS_SKY_VISIBILITY_MAP_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <gazebo/physics/physics.hh>
+
+#include "rotors_gazebo_plugins/world_geometry.h"
+
+namespace gazebo {
+
+// Default values
+static constexpr double kDefaultSkyMapResolution = 2.0;  // [m]
+static constexpr double kDefaultSkyMapMargin = 20.0;  // [m]
+static constexpr int kDefaultSkyMapNumLevels = 4;
+static constexpr double kDefaultSkyMapLevelSpacing = 10.0;  // [m]
+static constexpr double kDefaultSkyMapMinHeight = 1.0;  // [m]
+static constexpr int kDefaultNumSatellites = 12;
+static constexpr double kDefaultSatelliteMinElevation = 10.0;  // [deg]
+/// \brief  Largest number of cells per level, the resolution is coarsened
+///         for larger worlds.
+static constexpr int64_t kMaxSkyMapCellsPerLevel = 1 << 22;
+
+/// \brief    Parameters of a sky visibility map.
+struct SkyVisibilityParams {
+  SkyVisibilityParams()
+      : resolution(kDefaultSkyMapResolution),
+        margin(kDefaultSkyMapMargin),
+        num_levels(kDefaultSkyMapNumLevels),
+        level_spacing(kDefaultSkyMapLevelSpacing),
+        min_height(kDefaultSkyMapMinHeight),
+        num_satellites(kDefaultNumSatellites),
+        satellite_min_elevation(kDefaultSatelliteMinElevation) {}
+
+  /// \brief  Size of a grid cell [m].
+  double resolution;
+  /// \brief  Distance the grid extends beyond the static geometry [m].
+  double margin;
+  /// \brief  Number of heights the visibility is evaluated at.
+  int num_levels;
+  /// \brief  Distance between two levels [m].
+  double level_spacing;
+  /// \brief  World z of the lowest level [m].
+  double min_height;
+  int num_satellites;
+  /// \brief  Elevation of the lowest satellite [deg].
+  double satellite_min_elevation;
+};
+
+/// \brief    Number of GNSS satellites in view over a 2D grid of the world.
+/// \details  The satellites are spread over a fixed sky, from the minimum
+///           elevation up to the zenith. Each cell of the grid is evaluated
+///           at a few heights, by casting a ray from the cell center to every
+///           satellite against the bounding boxes of the static collision
+///           geometry of the world, the same bounds the octomap plugin
+///           rasterizes. The rays are cast once, on worker threads, and a
+///           lookup during the simulation is a single array access.
+///
+///           Positions outside the grid or above all geometry see every
+///           satellite. The map of a world is shared by all plugins asking
+///           for it with the same parameters.
+class SkyVisibilityMap {
+ public:
+  SkyVisibilityMap(const std::vector<GeometryBound>& bounds,
+                   const SkyVisibilityParams& params, int num_threads);
+
+  /// \brief  Returns the map of a world, computing it on first use. The map
+  ///         is released when the last plugin holding it is unloaded.
+  /// \param[in] num_threads Threads the map is computed with, 0 uses one
+  ///            per hardware thread.
+  static std::shared_ptr<const SkyVisibilityMap> Get(
+      const physics::WorldPtr& world, const SkyVisibilityParams& params,
+      int num_threads);
+
+  /// \brief  Number of satellites in view at a world position.
+  int VisibleSatellites(const ignition::math::Vector3d& position) const;
+
+  int num_satellites() const { return params_.num_satellites; }
+
+ private:
+  SkyVisibilityParams params_;
+
+  double min_x_;
+  double min_y_;
+  int num_cells_x_;
+  int num_cells_y_;
+  /// \brief  Highest point of the static geometry [m].
+  double max_height_;
+  /// \brief  Satellites in view, indexed by (level * num_cells_y_ + iy) *
+  ///         num_cells_x_ + ix.
+  std::vector<uint8_t> visible_satellites_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_SKY_VISIBILITY_MAP_H
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ROTORS_GAZEBO_PLUGINS_SPSC_RING_BUFFER_H
+#define ROTORS_GAZEBO_PLUGINS_SPSC_RING_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+
+namespace gazebo {
+
+/// \brief    Fixed size, lock-free queue between one producer and one consumer
+///           thread.
+/// \details  TryPush() must only be called from the producer thread and
+///           TryPop() only from the consumer thread. Neither of them blocks or
+///           allocates. The head and the tail are kept on separate cache
+///           lines, so that the two threads do not contend for them.
+template <class T, std::size_t Capacity>
+class SpscRingBuffer {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "The capacity of SpscRingBuffer must be a power of two.");
+
+ public:
+  SpscRingBuffer() : head_(0), tail_(0) {}
+
+  /// \brief  Appends a copy of value, called by the producer.
+  /// \return False if the queue is full.
+  bool TryPush(const T& value) {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    buffer_[tail & (Capacity - 1)] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// \brief  Removes the oldest element, called by the consumer.
+  /// \return False if the queue is empty.
+  bool TryPop(T* value) {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    *value = buffer_[head & (Capacity - 1)];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// \brief  True if there is nothing to pop, called by the consumer.
+  bool Empty() const {
+    return head_.load(std::memory_order_relaxed) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+ private:
+  static constexpr std::size_t kCacheLineSize = 64;
+
+  /// \brief  Index of the next element to pop, written by the consumer.
+  std::atomic<std::size_t> head_;
+  char head_padding_[kCacheLineSize - sizeof(std::atomic<std::size_t>)];
+  /// \brief  Index of the next element to push, written by the producer.
+  std::atomic<std::size_t> tail_;
+  char tail_padding_[kCacheLineSize - sizeof(std::atomic<std::size_t>)];
+  T buffer_[Capacity];
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_SPSC_RING_BUFFER_H
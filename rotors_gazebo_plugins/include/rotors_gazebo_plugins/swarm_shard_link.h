@@ -0,0 +1,145 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_SWARM_SHARD_LINK_H
+#define ROTORS_GAZEBO_PLUGINS_SWARM_SHARD_LINK_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+
+#include "SwarmTelemetry.pb.h"
+
+namespace gazebo {
+
+// Default values
+/// \brief  Sharding is disabled for negative shard IDs.
+static constexpr int kDefaultSwarmShardId = -1;
+static constexpr int kDefaultSwarmShardPort = 14650;
+/// \brief  Vehicles of another shard are forgotten if they were not heard of
+///         for this long [s] of wall time.
+static constexpr double kDefaultSwarmShardTimeout = 1.0;
+/// \brief  Largest datagram sent between shards [bytes], the vehicles of a
+///         shard are split over several datagrams if needed.
+static constexpr std::size_t kSwarmShardMaxDatagramSize = 60000;
+/// \brief  Time the receive thread waits for a datagram, before it checks
+///         whether it should stop [ms].
+static constexpr int kSwarmShardPollTimeoutMs = 100;
+
+/// \brief    State of a vehicle simulated by another shard.
+struct SwarmShardVehicle {
+  std::string name;
+  uint32_t shard = 0;
+  /// \brief  Simulation time of the state on its shard [s].
+  double stamp = 0.0;
+  double position[3];
+  /// \brief  w, x, y, z.
+  double orientation[4];
+  double linear_velocity[3];
+  double angular_velocity[3];
+  std::vector<double> motor_speed;
+  std::chrono::steady_clock::time_point received;
+};
+
+/// \brief    Exchanges the vehicle states between the shards of a swarm.
+/// \details  In sharding mode, the vehicles of a swarm are spread over
+///           several gzserver processes or hosts, each simulating a part of
+///           them. Every shard sends the state of its own vehicles as
+///           SwarmTelemetry datagrams to the UDP ports of all other shards,
+///           and keeps the latest state of every vehicle it hears of.
+///
+///           The link of a world is registered by the swarm telemetry plugin,
+///           other plugins of the world find it with ForWorld(), e.g. to be
+///           aware of the vehicles of the other shards.
+class SwarmShardLink {
+ public:
+  SwarmShardLink();
+  ~SwarmShardLink();
+
+  SwarmShardLink(const SwarmShardLink&) = delete;
+  SwarmShardLink& operator=(const SwarmShardLink&) = delete;
+
+  /// \brief  Binds the UDP port, resolves the peers and starts the receive
+  ///         thread.
+  /// \param[in] peers Addresses of the other shards, as host:port.
+  /// \return False if the socket could not be set up or a peer could not be
+  ///         resolved.
+  bool Open(uint32_t shard_id, int port, const std::vector<std::string>& peers);
+
+  /// \brief  Sends the vehicles of a telemetry message to all peers, on the
+  ///         calling thread.
+  void Send(const gz_mav_msgs::SwarmTelemetry& telemetry);
+
+  /// \brief  Vehicles of the other shards heard of within the timeout [s],
+  ///         sorted by name.
+  void RemoteVehicles(double timeout,
+                      std::vector<SwarmShardVehicle>* vehicles) const;
+
+  /// \brief  Shard simulating a vehicle, or -1 if it was not heard of within
+  ///         the timeout [s].
+  int ShardOf(const std::string& vehicle_name, double timeout) const;
+
+  uint32_t shard_id() const { return shard_id_; }
+
+  /// \brief  Makes the link of a world available to its other plugins.
+  static void Register(const std::string& world_name,
+                       const std::shared_ptr<SwarmShardLink>& link);
+
+  /// \brief  Link of a world, or NULL if the world is not sharded.
+  static std::shared_ptr<SwarmShardLink> ForWorld(const std::string& world_name);
+
+  /// \brief  Splits a whitespace separated list of host:port addresses.
+  static std::vector<std::string> ParsePeers(const std::string& peers);
+
+ private:
+  void ReceiveThread();
+  /// \brief  Stores the vehicles of one received datagram.
+  void Receive(const gz_mav_msgs::SwarmTelemetry& telemetry);
+  void SendDatagram(const gz_mav_msgs::SwarmTelemetry& datagram);
+
+  uint32_t shard_id_;
+  int fd_;
+  std::vector<struct sockaddr_in> peers_;
+
+  std::thread receive_thread_;
+  std::atomic<bool> receive_thread_running_;
+
+  /// \brief  Protects vehicles_.
+  mutable std::mutex vehicles_mutex_;
+  std::map<std::string, SwarmShardVehicle> vehicles_;
+
+  // Scratch storage of Send().
+  gz_mav_msgs::SwarmTelemetry datagram_;
+  std::string send_buffer_;
+
+  uint64_t num_invalid_datagrams_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_SWARM_SHARD_LINK_H
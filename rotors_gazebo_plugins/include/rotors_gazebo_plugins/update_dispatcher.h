@@ -0,0 +1,266 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_UPDATE_DISPATCHER_H
+#define ROTORS_GAZEBO_PLUGINS_UPDATE_DISPATCHER_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gazebo/common/common.hh>
+#include <gazebo/physics/physics.hh>
+
+#include "rotors_gazebo_plugins/update_thread_pool.h"
+
+namespace gazebo {
+
+// Default update priorities of the model plugins, lower priorities run first
+// within a model.
+static constexpr int kUpdatePriorityCommand = 0;
+static constexpr int kUpdatePriorityEnvironment = 10;
+static constexpr int kUpdatePriorityActuator = 20;
+static constexpr int kUpdatePrioritySensor = 30;
+
+static constexpr bool kDefaultUseUpdateDispatcher = false;
+static constexpr int kDefaultUpdateRateDivisor = 1;
+static constexpr int kDefaultUpdateThreads = 1;
+static const std::string kDefaultUpdatePhase = "pre";
+/// \brief  Negative offsets are chosen by the dispatcher.
+static constexpr int kDefaultUpdateOffset = -1;
+static constexpr double kDefaultUpdateCost = 1.0;
+
+class UpdateDispatcher;
+
+/// \brief    Connection of a plugin to the world update, either directly to
+///           the world update event or through the update dispatcher.
+/// \details  Disconnects the plugin when destroyed.
+class UpdateConnection {
+ public:
+  explicit UpdateConnection(event::ConnectionPtr connection);
+  UpdateConnection(std::shared_ptr<UpdateDispatcher> dispatcher, int id);
+  ~UpdateConnection();
+
+ private:
+  event::ConnectionPtr connection_;
+  std::shared_ptr<UpdateDispatcher> dispatcher_;
+  int id_;
+};
+
+typedef std::shared_ptr<UpdateConnection> UpdateConnectionPtr;
+
+/// \brief    Step offset of a periodic update, spread against the other
+///           periodic updates of the world.
+/// \details  Releases the offset when destroyed.
+class UpdateOffset {
+ public:
+  UpdateOffset(std::shared_ptr<UpdateDispatcher> dispatcher, int divisor,
+               int offset, double cost);
+  ~UpdateOffset();
+
+  /// \brief  True on the steps the update with this offset is due on.
+  bool Due(uint64_t step) const { return (step + offset_) % divisor_ == 0; }
+
+  int offset() const { return offset_; }
+
+ private:
+  std::shared_ptr<UpdateDispatcher> dispatcher_;
+  int divisor_;
+  int offset_;
+  double cost_;
+};
+
+typedef std::shared_ptr<UpdateOffset> UpdateOffsetPtr;
+
+/// \brief    Calls the update of the model plugins of a world from a single
+///           world update event connection.
+/// \details  The plugins are kept in one flat array, sorted by model and, within
+///           a model, by priority, so that they run in a deterministic order and
+///           the plugins of a vehicle right after each other. Plugins with a
+///           rate divisor n are only called every n-th world update. The wall
+///           time spent in every plugin is collected and reported when the
+///           plugin is unregistered.
+///
+///           Periodic updates are staggered: every plugin with a rate divisor
+///           n runs on the steps where (step + offset) is a multiple of n,
+///           with the offset chosen so that the periodic updates of all
+///           vehicles are spread evenly over the steps of their period,
+///           instead of all vehicles sampling their slow sensors on the same
+///           step. The offset can be fixed with the SDF parameter
+///           updateOffset, and updateCost weighs expensive plugins.
+///
+///           Plugins run either before the physics step, on the world update
+///           begin event, or after it, on the world update end event. With
+///           more than one update thread, the vehicles of a phase are updated
+///           in parallel, while the plugins of one vehicle still run in order
+///           on the same thread. Such plugins must not share unguarded state
+///           with the plugins of other vehicles.
+class UpdateDispatcher {
+ public:
+  typedef std::function<void(const common::UpdateInfo&)> Callback;
+
+  enum Phase { kPrePhysics = 0, kPostPhysics = 1, kPhaseCount = 2 };
+
+  /// \brief  Wall time spent in the update of a plugin.
+  struct Timing {
+    uint64_t calls = 0;
+    double total_seconds = 0.0;
+    double max_seconds = 0.0;
+  };
+
+  /// \brief  Timing of one registered plugin.
+  struct PluginTiming {
+    int id;
+    std::string name;
+    Timing timing;
+  };
+
+  explicit UpdateDispatcher(physics::WorldPtr world);
+
+  /// \brief  Returns the dispatcher of a world, creating it on first use. The
+  ///         dispatcher is released when the last plugin is unregistered.
+  static std::shared_ptr<UpdateDispatcher> Get(const physics::WorldPtr& world);
+
+  /// \brief  Connects the update of a model plugin. Plugins opt in to the
+  ///         dispatcher with the SDF parameter useUpdateDispatcher, and may
+  ///         override their priority, rate and phase with updatePriority,
+  ///         updateRateDivisor and updatePhase ("pre" or "post"), and set the
+  ///         updateOffset and updateCost of a divided rate. The number of
+  ///         update threads of the world is the largest updateThreads of its
+  ///         plugins. Otherwise, the callback is connected directly to the
+  ///         world update begin event.
+  static UpdateConnectionPtr Connect(const physics::ModelPtr& model,
+                                     const sdf::ElementPtr& sdf,
+                                     const std::string& name,
+                                     int default_priority,
+                                     const Callback& callback);
+
+  /// \brief  Registers the update of a plugin of a model.
+  /// \return Id to unregister the plugin with.
+  int Register(const physics::ModelPtr& model, const std::string& name,
+               Phase phase, int priority, int rate_divisor,
+               const Callback& callback, int offset = kDefaultUpdateOffset,
+               double cost = kDefaultUpdateCost);
+
+  /// \brief  Staggers a periodic update a plugin schedules itself, like a
+  ///         measurement every n-th update, against all other periodic
+  ///         updates of the world. The offset is chosen by the dispatcher of
+  ///         the world unless the plugin sets the SDF parameter
+  ///         <prefix>Offset, and <prefix>Cost weighs it.
+  /// \param[in] name Name of the plugin, for error messages.
+  /// \param[in] param_prefix Prefix of the SDF parameters, e.g.
+  ///            "measurement" for measurementOffset and measurementCost.
+  static UpdateOffsetPtr Stagger(const physics::WorldPtr& world,
+                                 const sdf::ElementPtr& sdf,
+                                 const std::string& name,
+                                 const std::string& param_prefix, int divisor);
+
+  /// \brief  Reserves the step offset of an update every divisor steps.
+  /// \param[in] offset Offset to use, or negative to pick the offset whose
+  ///            steps carry the lowest cost of the other periodic updates.
+  /// \return The offset, in [0, divisor).
+  int ReserveOffset(int divisor, int offset, double cost);
+  void ReleaseOffset(int divisor, int offset, double cost);
+
+  /// \brief  Updates the vehicles on at least thread_count threads, including
+  ///         the world update thread.
+  void RequestThreads(int thread_count);
+
+  /// \brief  Unregisters a plugin and reports the time spent in its update.
+  void Unregister(int id);
+
+  /// \brief  Returns the time spent so far in the update of every plugin
+  ///         registered.
+  std::vector<PluginTiming> Timings();
+
+ private:
+  struct Entry {
+    int id;
+    const physics::Model* model;
+    int group;
+    int priority;
+    int rate_divisor;
+    int offset;
+    double cost;
+    Callback callback;
+    std::string name;
+  };
+
+  /// \brief  Plugins of one phase, sorted by model and priority. The entries
+  ///         are copied on write, so that the world update runs the plugins
+  ///         on a snapshot without holding the mutex.
+  struct PhaseEntries {
+    std::vector<Entry> entries;
+    /// \brief  Index of the first entry of every model, followed by the
+    ///         number of entries.
+    std::vector<std::size_t> group_begin;
+  };
+
+  void OnWorldUpdateBegin(const common::UpdateInfo& info);
+  void OnWorldUpdateEnd();
+  /// \brief  Runs the plugins of a phase due on the current step and adds
+  ///         their wall time to the timings.
+  void Dispatch(Phase phase, const common::UpdateInfo& info);
+  static void RunEntries(const PhaseEntries& phase, std::size_t begin,
+                         std::size_t end, uint64_t step,
+                         const common::UpdateInfo& info,
+                         std::vector<double>* seconds);
+  static void UpdateGroups(PhaseEntries* phase);
+  int ReserveOffsetLocked(int divisor, int offset, double cost);
+  void ReleaseOffsetLocked(int divisor, int offset, double cost);
+
+  physics::WorldPtr world_;
+  event::ConnectionPtr update_begin_connection_;
+  event::ConnectionPtr update_end_connection_;
+
+  /// \brief  Guards the members below. It is not held while the plugins
+  ///         run, so they may register, unregister and read the timings.
+  std::mutex mutex_;
+  std::shared_ptr<const PhaseEntries> phases_[kPhaseCount];
+  /// \brief  Timings of the registered plugins, by id.
+  std::map<int, Timing> timings_;
+  std::map<const physics::Model*, int> groups_;
+  int next_group_;
+  int next_id_;
+
+  /// \brief  Summed cost of the periodic updates, by rate divisor and
+  ///         offset.
+  std::map<std::pair<int, int>, double> offset_costs_;
+
+  std::shared_ptr<UpdateThreadPool> thread_pool_;
+
+  /// \brief  Update info of the current world update, passed to the plugins
+  ///         running after the physics step.
+  common::UpdateInfo info_;
+  /// \brief  Set by the begin event of this world, consumed by the end event,
+  ///         which is shared by all worlds.
+  bool update_pending_;
+
+  /// \brief  Number of world updates dispatched so far.
+  uint64_t step_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_UPDATE_DISPATCHER_H
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_UPDATE_THREAD_POOL_H
+#define ROTORS_GAZEBO_PLUGINS_UPDATE_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gazebo {
+
+/// \brief    Runs a batch of independent tasks on a fixed set of threads.
+/// \details  The calling thread works on the batch as well. Tasks are handed
+///           out one at a time from a shared counter, so threads that finish
+///           early take over the remaining tasks of slower ones. Run() returns
+///           once all tasks are done, which is the only synchronization point
+///           per batch.
+class UpdateThreadPool {
+ public:
+  typedef std::function<void(std::size_t)> Task;
+
+  /// \param[in] thread_count Number of threads including the calling one.
+  explicit UpdateThreadPool(int thread_count);
+  ~UpdateThreadPool();
+
+  UpdateThreadPool(const UpdateThreadPool&) = delete;
+  UpdateThreadPool& operator=(const UpdateThreadPool&) = delete;
+
+  int ThreadCount() const { return workers_.size() + 1; }
+
+  /// \brief  Calls task(i) for all i in [0, task_count) and waits for all of
+  ///         them to finish.
+  void Run(std::size_t task_count, const Task& task);
+
+ private:
+  void WorkerLoop();
+  void RunTasks();
+
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable start_condition_;
+  std::condition_variable done_condition_;
+  uint64_t generation_;
+  int busy_workers_;
+  bool stop_;
+
+  const Task* task_;
+  std::size_t task_count_;
+  std::atomic<std::size_t> next_task_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_UPDATE_THREAD_POOL_H
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_VEHICLE_MOTOR_MODEL_H
+#define ROTORS_GAZEBO_PLUGINS_VEHICLE_MOTOR_MODEL_H
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <gazebo/physics/physics.hh>
+
+#include "rotors_gazebo_plugins/rigid_body_state.h"
+#include "rotors_gazebo_plugins/rotor_aero_table.h"
+
+namespace gazebo {
+
+/// \brief    Parameters of a single velocity controlled rotor.
+struct VehicleRotor {
+  physics::JointPtr joint;
+  physics::LinkPtr link;
+  int motor_number;
+  int turning_direction;
+  double motor_constant;
+  double moment_constant;
+  double rotor_drag_coefficient;
+  double rolling_moment_coefficient;
+  double rotor_velocity_slowdown_sim;
+  /// \brief  Replaces the motor and moment constants if not NULL.
+  std::shared_ptr<const RotorAeroTable> aero_table;
+};
+
+/// \brief    Forces and moments of all rotors of a vehicle, computed in one batch.
+/// \details  The GazeboMotorModel instances of a model that have the vehicle
+///           motor model enabled share one instance of this class. Once per
+///           physics step, the state of the body the rotors are mounted on is
+///           read once, the thrust, air drag, drag torque and rolling moment of
+///           all rotors are evaluated together, and the summed wrench is
+///           applied to the body. The rotors are assumed to be rigidly mounted,
+///           so that their position and axis in the body frame are resolved
+///           when they are added.
+class VehicleMotorModel {
+ public:
+  explicit VehicleMotorModel(physics::ModelPtr model);
+
+  /// \brief  Returns the vehicle motor model of a model, creating it on first use.
+  static std::shared_ptr<VehicleMotorModel> Get(const physics::ModelPtr& model);
+
+  /// \brief  Adds a rotor to the batch.
+  /// \return False if the rotor is not mounted on the same body as the rotors
+  ///         added before.
+  bool AddRotor(const VehicleRotor& rotor);
+
+  /// \brief  Wind velocity in world frame acting on all rotors.
+  void SetWindSpeed(const ignition::math::Vector3d& wind_speed_W) {
+    wind_speed_W_ = wind_speed_W;
+  }
+
+  /// \brief  Computes and applies the wrench of all rotors, once per physics step.
+  /// \param[in] sampling_time Time since the last physics step [s], used to
+  ///                          detect rotor velocity aliasing.
+  void Update(double sampling_time);
+
+ private:
+  physics::ModelPtr model_;
+  physics::WorldPtr world_;
+
+  /// \brief  Link all rotors are mounted on, the summed wrench is applied to it.
+  physics::LinkPtr body_;
+  std::shared_ptr<RigidBodyStateCache> body_state_;
+
+  /// \brief  Physics iteration of the last call to Update().
+  uint64_t last_update_iteration_;
+  bool updated_;
+
+  ignition::math::Vector3d wind_speed_W_;
+
+  std::vector<physics::JointPtr> joints_;
+  std::vector<int> motor_numbers_;
+
+  // Rotor geometry in the body frame, one column per rotor.
+  /// \brief  Origin of the rotor link, relative to the origin of the body.
+  Eigen::Matrix3Xd positions_;
+  /// \brief  Origin of the rotor link, relative to the CoG of the body.
+  Eigen::Matrix3Xd moment_arms_;
+  /// \brief  Direction of the thrust, the z-axis of the rotor link.
+  Eigen::Matrix3Xd thrust_axes_;
+  /// \brief  Rotation axis of the rotor joint.
+  Eigen::Matrix3Xd joint_axes_;
+
+  // Rotor parameters, one entry per rotor.
+  Eigen::ArrayXd turning_directions_;
+  Eigen::ArrayXd motor_constants_;
+  Eigen::ArrayXd moment_constants_;
+  Eigen::ArrayXd rotor_drag_coefficients_;
+  Eigen::ArrayXd rolling_moment_coefficients_;
+  Eigen::ArrayXd rotor_velocity_slowdowns_;
+  /// \brief  Coefficient tables, NULL for the rotors using the constants.
+  std::vector<std::shared_ptr<const RotorAeroTable> > aero_tables_;
+  bool has_aero_tables_;
+
+  // Scratch buffers, sized in AddRotor() so that Update() does not allocate.
+  Eigen::ArrayXd rotor_velocities_;
+  Eigen::ArrayXd thrusts_;
+  /// \brief  Thrust and drag torque per squared rotor velocity.
+  Eigen::ArrayXd thrust_coefficients_;
+  Eigen::ArrayXd torque_coefficients_;
+  Eigen::ArrayXd scales_;
+  Eigen::ArrayXd axial_velocities_;
+  Eigen::Matrix3Xd relative_velocities_;
+  Eigen::Matrix3Xd forces_;
+  Eigen::Matrix3Xd moments_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_VEHICLE_MOTOR_MODEL_H
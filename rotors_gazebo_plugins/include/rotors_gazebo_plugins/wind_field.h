@@ -0,0 +1,226 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_WIND_FIELD_H
+#define ROTORS_GAZEBO_PLUGINS_WIND_FIELD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "rotors_gazebo_plugins/model_arena.h"
+
+namespace gazebo {
+
+// Default values
+static constexpr uint32_t kDefaultWindFieldTileSize = 16;
+
+/// \brief    Wind velocity and world z-coordinate of a single grid vertex.
+struct WindFieldVertex {
+  float u;
+  float v;
+  float w;
+  float z;
+};
+
+/// \brief    Interpolated wind velocity [m/s].
+struct WindVelocity {
+  double u;
+  double v;
+  double w;
+};
+
+/// \brief    Custom wind field as described by the text file format.
+/// \details  Velocities are stored layer by layer, i.e. the value at grid
+///           index (x, y, z) is found at x + y * n_x + z * n_x * n_y.
+struct WindFieldData {
+  float min_x = 0.0f;
+  float min_y = 0.0f;
+  int n_x = 0;
+  int n_y = 0;
+  float res_x = 0.0f;
+  float res_y = 0.0f;
+  std::vector<float> vertical_spacing_factors;
+  std::vector<float> bottom_z;
+  std::vector<float> top_z;
+  std::vector<float> u;
+  std::vector<float> v;
+  std::vector<float> w;
+
+  /// \brief  Reads the custom wind field from a text file.
+  /// \return True if the file could be read and its content is consistent.
+  bool ReadTextFile(const std::string& path);
+
+  /// \brief  Checks that the sizes of all arrays match the grid dimensions.
+  bool IsConsistent() const;
+};
+
+/// \brief    Header of the binary wind field format.
+/// \details  The file consists of this header, followed by the vertical spacing
+///           factors, bottom_z and top_z as float arrays. The vertices are stored
+///           afterwards in tiles of tile_n_x * tile_n_y grid columns, every tile
+///           starting on a page boundary so that tiles which are never visited
+///           are never read from disk. Within a tile, the vertices of one column
+///           are contiguous. All values are stored in host byte order.
+struct WindFieldFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t n_x;
+  uint32_t n_y;
+  uint32_t n_z;
+  uint32_t tile_n_x;
+  uint32_t tile_n_y;
+  float min_x;
+  float min_y;
+  float res_x;
+  float res_y;
+  uint64_t vertical_spacing_factors_offset;
+  uint64_t bottom_z_offset;
+  uint64_t top_z_offset;
+  uint64_t tiles_offset;
+  /// \brief  Number of vertices from the start of one tile to the next.
+  uint64_t tile_stride;
+};
+
+static const char kWindFieldFileMagic[8] = {'R', 'O', 'T', 'O', 'R', 'S', 'W', 'F'};
+static constexpr uint32_t kWindFieldFileVersion = 1;
+
+/// \brief    Preprocessed custom wind field used for the lookups at runtime.
+/// \details  The field is either read from a text file into memory or opened
+///           read-only with mmap from a binary file, in which case the pages
+///           are shared between all processes using the same file.
+class WindField {
+ public:
+  WindField();
+  ~WindField();
+
+  WindField(const WindField&) = delete;
+  WindField& operator=(const WindField&) = delete;
+
+  /// \brief  Loads the wind field, detecting the format from the file content.
+  bool Load(const std::string& path);
+
+  /// \brief  Builds the wind field in memory from the text file format.
+  bool LoadText(const std::string& path);
+
+  /// \brief  Maps a binary wind field file into memory.
+  bool LoadBinary(const std::string& path);
+
+  /// \brief  Frees the wind field.
+  void Clear();
+
+  /// \brief  Allocates the vertices of the fields read from text files from
+  ///         the arena of a model from here on. Frees the wind field.
+  void UseArena(const ArenaAllocator<char>& allocator);
+
+  /// \brief  Reads every page of a mapped wind field, so that later lookups
+  ///         do not have to wait for the disk.
+  void PageIn() const;
+
+  /// \brief  Writes a wind field in the binary format.
+  /// \param[in] data          Wind field to write.
+  /// \param[in] path          Path of the output file.
+  /// \param[in] tile_size     Number of grid columns along x and y per tile.
+  static bool WriteBinary(const WindFieldData& data, const std::string& path,
+                          uint32_t tile_size = kDefaultWindFieldTileSize);
+
+  /// \brief  Returns true if the file starts with the binary format magic.
+  static bool IsBinaryFile(const std::string& path);
+
+  bool empty() const { return vertices_ == nullptr; }
+
+  std::size_t n_x() const { return n_x_; }
+  std::size_t n_y() const { return n_y_; }
+  std::size_t n_z() const { return n_z_; }
+  float min_x() const { return min_x_; }
+  float min_y() const { return min_y_; }
+  float res_x() const { return res_x_; }
+  float res_y() const { return res_y_; }
+  const float* vertical_spacing_factors() const { return vertical_spacing_factors_; }
+
+  /// \brief  Bottom z-coordinate of the grid column at index x + y * n_x.
+  float bottom_z(std::size_t column) const { return bottom_z_[column]; }
+
+  /// \brief  Top z-coordinate of the grid column at index x + y * n_x.
+  float top_z(std::size_t column) const { return top_z_[column]; }
+
+  /// \brief  Interpolates the wind velocity at the given position.
+  /// \details Trilinear interpolation between the eight enclosing grid points,
+  ///          first in z-direction, then in x-direction, then in y-direction.
+  /// \param[in]  x, y, z       Position in world coordinates.
+  /// \param[out] wind_velocity Interpolated wind velocity.
+  /// \return False if the position is outside of the wind field.
+  bool Interpolate(double x, double y, double z, WindVelocity* wind_velocity) const;
+
+  /// \brief  Returns the vertex at grid index (x, y, z).
+  const WindFieldVertex& vertex(std::size_t x, std::size_t y, std::size_t z) const {
+    const std::size_t tile_x = x / tile_n_x_;
+    const std::size_t tile_y = y / tile_n_y_;
+    const std::size_t column_in_tile =
+        (x - tile_x * tile_n_x_) + (y - tile_y * tile_n_y_) * tile_n_x_;
+    return vertices_[(tile_x + tile_y * n_tiles_x_) * tile_stride_ +
+                     column_in_tile * n_z_ + z];
+  }
+
+ private:
+  /// \brief  Finds the pair of vertical grid indices enclosing a normalized height.
+  /// \param[in]  vertical_factor Normalized height of the aircraft within a column.
+  /// \param[out] idx_lower Index of the grid point just below the aircraft.
+  /// \param[out] idx_upper Index of the grid point just above the aircraft.
+  void FindVerticalIndices(float vertical_factor, std::size_t* idx_lower,
+                           std::size_t* idx_upper) const;
+
+  /// \brief  Arranges the vertices of the wind field tile by tile.
+  /// \param[in]  tile_stride Number of vertices reserved per tile, >= the
+  ///                         number of vertices of a full tile.
+  static void BuildTiles(const WindFieldData& data, std::size_t tile_n_x,
+                         std::size_t tile_n_y, std::size_t tile_stride,
+                         WindFieldVertex* vertices);
+
+  std::size_t n_x_;
+  std::size_t n_y_;
+  std::size_t n_z_;
+  std::size_t tile_n_x_;
+  std::size_t tile_n_y_;
+  std::size_t n_tiles_x_;
+  std::size_t tile_stride_;
+  float min_x_;
+  float min_y_;
+  float res_x_;
+  float res_y_;
+
+  const float* vertical_spacing_factors_;
+  const float* bottom_z_;
+  const float* top_z_;
+  const WindFieldVertex* vertices_;
+
+  /// \brief  Storage if the field was read from a text file.
+  WindFieldData data_;
+  ArenaVector<WindFieldVertex> vertex_storage_;
+
+  /// \brief  Mapped region if the field was read from a binary file.
+  void* mapped_data_;
+  std::size_t mapped_size_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_WIND_FIELD_H
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_WIND_FIELD_SEQUENCE_H
+#define ROTORS_GAZEBO_PLUGINS_WIND_FIELD_SEQUENCE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "rotors_gazebo_plugins/wind_field.h"
+
+namespace gazebo {
+
+/// \brief    Time-varying custom wind field, made of frames sampled at a fixed period.
+/// \details  Only three frames are held in memory at any time, independent of
+///           the length of the sequence: the two frames enclosing the current
+///           time, and the next frame which is loaded by a background thread.
+///           The physics thread never waits for the background thread, if the
+///           next frame is not ready in time the latest frame is held.
+class WindFieldSequence {
+ public:
+  WindFieldSequence();
+  ~WindFieldSequence();
+
+  WindFieldSequence(const WindFieldSequence&) = delete;
+  WindFieldSequence& operator=(const WindFieldSequence&) = delete;
+
+  /// \brief  Loads the first two frames and starts prefetching the third one.
+  /// \param[in] path_pattern  printf-style pattern of the frame file paths,
+  ///                          taking the frame index, e.g. "wind_%04d.bin".
+  /// \param[in] n_frames      Number of frames in the sequence, at least 2.
+  /// \param[in] frame_period  Time between two consecutive frames [s].
+  bool Open(const std::string& path_pattern, int n_frames, double frame_period);
+
+  /// \brief  Stops the prefetch thread and frees all frames.
+  void Close();
+
+  /// \brief  Returns the two frames to interpolate between at the given time.
+  /// \param[in]  time    Time since the start of the sequence [s].
+  /// \param[out] frame_a Frame at or before the given time.
+  /// \param[out] frame_b Frame after frame_a.
+  /// \param[out] alpha   Interpolation weight of frame_b, in [0, 1].
+  void GetFrames(double time, const WindField** frame_a,
+                 const WindField** frame_b, double* alpha);
+
+ private:
+  static constexpr int kNumSlots = 3;
+
+  std::string FramePath(int frame) const;
+
+  /// \brief  Loads the pair of frames starting at frame into the current
+  ///         slots, after the time went back, e.g. on a world reset, and
+  ///         restarts the prefetching from it.
+  void Rewind(int frame);
+
+  /// \brief  Loads the requested frames into prefetch_slot_ until Close() is called.
+  void PrefetchThread();
+
+  std::string path_pattern_;
+  int n_frames_;
+  double frame_period_;
+
+  WindField slots_[kNumSlots];
+
+  /// \brief  Index of the frame held by each slot, -1 if none.
+  int slot_frame_[kNumSlots];
+
+  /// \brief  Slot of the frame at or before the current time.
+  int current_slot_;
+
+  /// \brief  Slot the background thread loads the next frame into.
+  int prefetch_slot_;
+
+  /// \brief  Frame requested from the background thread, -1 if none.
+  int prefetch_frame_;
+
+  /// \brief  Set by the background thread once prefetch_slot_ is loaded.
+  std::atomic<bool> prefetch_ready_;
+
+  /// \brief  Set while the background thread loads prefetch_slot_.
+  bool loading_;
+
+  bool stop_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  /// \brief  Notified when the background thread finished loading a frame.
+  std::condition_variable loaded_condition_;
+  std::thread prefetch_thread_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_WIND_FIELD_SEQUENCE_H
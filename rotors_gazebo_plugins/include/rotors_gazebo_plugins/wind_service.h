@@ -0,0 +1,101 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_WIND_SERVICE_H
+#define ROTORS_GAZEBO_PLUGINS_WIND_SERVICE_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <gazebo/physics/physics.hh>
+
+#include "rotors_gazebo_plugins/wind_field.h"
+#include "rotors_gazebo_plugins/wind_field_sequence.h"
+
+namespace gazebo {
+
+/// \brief    Single wind field shared by all models of a world.
+/// \details  The service is created by GazeboWindWorldPlugin and looked up by
+///           the GazeboWindPlugin instances of the models, which register the
+///           link they sample the wind at. Once per physics step, the wind is
+///           evaluated for all registered links in one pass, and every plugin
+///           reads its sample directly, without a transport round-trip.
+class WindService {
+ public:
+  explicit WindService(physics::WorldPtr world);
+
+  /// \brief  Makes the service of a world available to the model plugins.
+  static void Advertise(const std::shared_ptr<WindService>& service);
+
+  /// \brief  Removes the service of a world.
+  static void Unadvertise(const physics::WorldPtr& world);
+
+  /// \brief  Returns the service of a world, or nullptr if there is none.
+  static std::shared_ptr<WindService> Find(const physics::WorldPtr& world);
+
+  /// \brief  Loads a custom wind field, either a single file or a sequence of
+  ///         frame_count frames if frame_count > 1.
+  bool LoadWindField(const std::string& path, int frame_count, double frame_period);
+
+  /// \brief  Wind velocity outside of the custom wind field, or everywhere if
+  ///         no custom wind field was loaded.
+  void SetDefaultWindVelocity(const ignition::math::Vector3d& wind_velocity) {
+    default_wind_velocity_ = wind_velocity;
+  }
+
+  /// \brief  Registers a link the wind is evaluated at.
+  /// \return Id to read the wind velocity of the link with.
+  int RegisterLink(const physics::LinkPtr& link);
+
+  /// \brief  Stops evaluating the wind of a link.
+  void UnregisterLink(int id);
+
+  /// \brief  Evaluates the wind for all registered links, once per physics step.
+  ///         Safe to call from the update threads of several vehicles.
+  void Update();
+
+  /// \brief  Returns the wind velocity at the link of the current physics step.
+  ///         By value, as registering another link may move the velocities.
+  ignition::math::Vector3d GetWindVelocity(int id);
+
+ private:
+  physics::WorldPtr world_;
+
+  /// \brief  Physics iteration of the last call to Update().
+  uint64_t last_update_iteration_;
+  bool updated_;
+  /// \brief  Guards the links and their velocities, links are registered
+  ///         while the links of other vehicles are updated.
+  std::mutex update_mutex_;
+
+  std::vector<physics::LinkPtr> links_;
+  std::vector<ignition::math::Vector3d> wind_velocities_;
+
+  ignition::math::Vector3d default_wind_velocity_;
+  int frame_count_;
+  WindField wind_field_;
+  WindFieldSequence wind_field_sequence_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_WIND_SERVICE_H
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_WIND_TURBULENCE_H
+#define ROTORS_GAZEBO_PLUGINS_WIND_TURBULENCE_H
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rotors_gazebo_plugins/wind_field.h"
+
+namespace gazebo {
+
+// Default values
+static constexpr double kDefaultTurbulenceStdDevU = 1.0;  // [m/s]
+static constexpr double kDefaultTurbulenceStdDevV = 1.0;  // [m/s]
+static constexpr double kDefaultTurbulenceStdDevW = 0.5;  // [m/s]
+static constexpr double kDefaultTurbulenceLengthScaleU = 200.0;  // [m]
+static constexpr double kDefaultTurbulenceLengthScaleV = 200.0;  // [m]
+static constexpr double kDefaultTurbulenceLengthScaleW = 50.0;  // [m]
+static constexpr double kDefaultTurbulenceSampleSpacing = 1.0;  // [m]
+static constexpr int kDefaultTurbulenceNumSamples = 1 << 16;
+static constexpr int kDefaultTurbulenceSeed = 0;
+
+/// \brief    Spectrum of the turbulence, as in MIL-F-8785C / MIL-HDBK-1797.
+enum class TurbulenceModel { kDryden, kVonKarman };
+
+/// \brief    Parses "dryden" or "von_karman".
+/// \return   False for any other name.
+bool ParseTurbulenceModel(const std::string& name, TurbulenceModel* model);
+
+/// \brief    Parameters of a turbulence sequence. Axis 0 is along the mean
+///           wind (u), 1 lateral (v) and 2 vertical (w).
+struct TurbulenceParams {
+  TurbulenceParams()
+      : model(TurbulenceModel::kDryden),
+        std_dev{kDefaultTurbulenceStdDevU, kDefaultTurbulenceStdDevV,
+                kDefaultTurbulenceStdDevW},
+        length_scale{kDefaultTurbulenceLengthScaleU,
+                     kDefaultTurbulenceLengthScaleV,
+                     kDefaultTurbulenceLengthScaleW},
+        sample_spacing(kDefaultTurbulenceSampleSpacing),
+        num_samples(kDefaultTurbulenceNumSamples),
+        seed(kDefaultTurbulenceSeed) {}
+
+  TurbulenceModel model;
+  /// \brief  Standard deviation of the turbulence velocity [m/s].
+  double std_dev[3];
+  /// \brief  Turbulence length scale [m].
+  double length_scale[3];
+  /// \brief  Distance between two samples of the sequence [m].
+  double sample_spacing;
+  /// \brief  Length of the sequence, rounded up to a power of two.
+  int num_samples;
+  int seed;
+};
+
+/// \brief    Frozen turbulence along the distance flown through the air.
+/// \details  Gaussian white noise is shaped by the spatial power spectral
+///           density of the model and transformed by an inverse FFT once,
+///           per axis, when the sequence is created. The sequence is
+///           periodic, so it is read as a ring buffer indexed by distance,
+///           and a sample costs one lookup and a linear interpolation.
+///
+///           A sequence is shared by all plugins asking for it with the
+///           same parameters, each vehicle reads it at its own distance.
+class WindTurbulence {
+ public:
+  explicit WindTurbulence(const TurbulenceParams& params);
+
+  /// \brief  Returns the sequence of the parameters, synthesizing it on
+  ///         first use. It is released when the last plugin holding it is
+  ///         unloaded.
+  static std::shared_ptr<const WindTurbulence> Get(
+      const TurbulenceParams& params);
+
+  /// \brief  Turbulence velocity at a distance along the sequence [m/s],
+  ///         in the frame of the mean wind.
+  WindVelocity Sample(double distance) const {
+    const double position = distance * inv_sample_spacing_;
+    const double first = std::floor(position);
+    const double fraction = position - first;
+    // The mask wraps negative positions as well.
+    const uint64_t index =
+        static_cast<uint64_t>(static_cast<int64_t>(first)) & index_mask_;
+    const float* a = &samples_[3 * index];
+    const float* b = &samples_[3 * ((index + 1) & index_mask_)];
+    WindVelocity velocity;
+    velocity.u = a[0] + fraction * (b[0] - a[0]);
+    velocity.v = a[1] + fraction * (b[1] - a[1]);
+    velocity.w = a[2] + fraction * (b[2] - a[2]);
+    return velocity;
+  }
+
+  /// \brief  Distance after which the sequence repeats [m].
+  double period() const { return (index_mask_ + 1) * sample_spacing_; }
+
+ private:
+  double sample_spacing_;
+  double inv_sample_spacing_;
+  uint64_t index_mask_;
+  /// \brief  Interleaved u, v and w of every sample.
+  std::vector<float> samples_;
+};
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_WIND_TURBULENCE_H
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_GAZEBO_PLUGINS_WORLD_GEOMETRY_H
+#define ROTORS_GAZEBO_PLUGINS_WORLD_GEOMETRY_H
+
+#include <vector>
+
+#include <gazebo/physics/physics.hh>
+
+namespace gazebo {
+
+/// \brief Conservative bound of a collision in world frame, either its
+///        axis aligned bounding box or, for planes, the plane itself.
+struct GeometryBound {
+  bool is_plane;
+  ignition::math::Vector3d min;
+  ignition::math::Vector3d max;
+  ignition::math::Vector3d normal;
+  double offset;
+
+  /// \brief Whether the bound reaches into the axis aligned box [min, max].
+  bool Intersects(const ignition::math::Vector3d& box_min,
+                  const ignition::math::Vector3d& box_max) const;
+
+  /// \brief Whether the ray from origin along direction hits the bounding
+  ///        box. Always false for planes.
+  bool IntersectsRay(const ignition::math::Vector3d& origin,
+                     const ignition::math::Vector3d& direction) const;
+};
+
+/// \brief Collects the bounds of all collisions of all models in the world.
+/// \param[in] static_only Skip the models that are not static, such as the
+///            vehicles.
+std::vector<GeometryBound> CollectGeometryBounds(const physics::WorldPtr& world,
+                                                 bool static_only = false);
+
+}  // namespace gazebo
+
+#endif  // ROTORS_GAZEBO_PLUGINS_WORLD_GEOMETRY_H
@@ -0,0 +1,54 @@
+#version 120
+
+// Depth noise of KinectDepthNoiseModel (model 0) and D435DepthNoiseModel
+// (model 1), see depth_noise_model.cpp for the references.
+
+uniform sampler2D depth_map;
+uniform int model;
+uniform float min_depth;
+uniform float max_depth;
+// D435: subpixel_err / (f * baseline * 1e6), f in pixels.
+uniform float multiplier;
+uniform float max_stdev;
+// NaN, set from the CPU as GLSL 1.20 has no way to write one.
+uniform float bad_point;
+// New random value for every frame.
+uniform float seed;
+
+varying vec2 uv;
+
+// Hash without sine [Hoskins], uniform in [0, 1).
+float hash(vec3 p)
+{
+  p = fract(p * 0.1031);
+  p += dot(p, p.zyx + 31.32);
+  return fract((p.x + p.y) * p.z);
+}
+
+void main()
+{
+  float depth = texture2D(depth_map, uv).r;
+  if (!(depth > min_depth && depth < max_depth))
+  {
+    gl_FragColor = vec4(bad_point, 0.0, 0.0, 1.0);
+    return;
+  }
+
+  // Standard normal sample by Box-Muller.
+  vec3 p = vec3(gl_FragCoord.xy, seed);
+  float u1 = max(hash(p), 1e-7);
+  float u2 = hash(p + vec3(17.13, 3.71, 29.3));
+  float normal = sqrt(-2.0 * log(u1)) * cos(6.28318530718 * u2);
+
+  float stdev;
+  if (model == 1)
+  {
+    float rms = depth * depth * 1e6 * multiplier;
+    stdev = min(rms * rms, max_stdev);
+  }
+  else
+  {
+    stdev = 0.0012 + 0.0019 * (depth - 0.4) * (depth - 0.4);
+  }
+  gl_FragColor = vec4(depth + normal * stdev, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/black_box_recorder.h"
+
+#include <algorithm>
+
+#include <gazebo/common/Console.hh>
+
+namespace gazebo {
+
+/// \brief  Smallest average message size the index of the ring is sized for
+///         [bytes], with smaller messages the oldest ones are dropped early.
+static constexpr std::size_t kBlackBoxMinRecordSize = 32;
+
+BlackBoxRecorder::BlackBoxRecorder(std::size_t capacity, double duration)
+    : duration_(std::max(duration, 0.0)),
+      buffer_(capacity),
+      records_(std::max<std::size_t>(capacity / kBlackBoxMinRecordSize, 1)),
+      first_record_(0),
+      num_records_(0),
+      write_offset_(0),
+      num_oversized_(0),
+      flushing_(false) {}
+
+BlackBoxRecorder::~BlackBoxRecorder() {
+  if (flush_thread_.joinable()) {
+    flush_thread_.join();
+  }
+}
+
+void BlackBoxRecorder::PopOldest() {
+  first_record_ = (first_record_ + 1) % records_.size();
+  --num_records_;
+}
+
+uint8_t* BlackBoxRecorder::Reserve(int topic_id, const ros::Time& time,
+                                   uint32_t size) {
+  if (size > buffer_.size()) {
+    ++num_oversized_;
+    return nullptr;
+  }
+  while (num_records_ > 0 && records_[first_record_].time + duration_ < time) {
+    PopOldest();
+  }
+  if (num_records_ == records_.size()) {
+    PopOldest();
+  }
+
+  std::size_t offset = 0;
+  while (num_records_ > 0) {
+    const std::size_t head = records_[first_record_].offset;
+    if (head < write_offset_) {
+      // The messages are contiguous, there is room behind them and in front.
+      if (buffer_.size() - write_offset_ >= size) {
+        offset = write_offset_;
+        break;
+      }
+      if (head >= size) {
+        offset = 0;
+        break;
+      }
+    } else if (head - write_offset_ >= size) {
+      // The messages wrap around, the gap between the newest and the oldest.
+      offset = write_offset_;
+      break;
+    }
+    PopOldest();
+  }
+
+  Record& record = records_[(first_record_ + num_records_) % records_.size()];
+  record.time = time;
+  record.topic_id = topic_id;
+  record.offset = offset;
+  record.size = size;
+  ++num_records_;
+  write_offset_ = offset + size;
+  return buffer_.data() + offset;
+}
+
+bool BlackBoxRecorder::Flush(
+    const std::string& filename,
+    rosbag::compression::CompressionType compression) {
+  std::vector<BlackBoxTopic> topics;
+  std::vector<Record> records;
+  std::vector<uint8_t> data;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (flushing_) {
+      return false;
+    }
+    if (flush_thread_.joinable()) {
+      flush_thread_.join();
+    }
+
+    // Copy the ring in order, so the writer needs no lock.
+    std::size_t total_size = 0;
+    records.reserve(num_records_);
+    for (std::size_t i = 0; i < num_records_; ++i) {
+      records.push_back(records_[(first_record_ + i) % records_.size()]);
+      total_size += records.back().size;
+    }
+    data.resize(total_size);
+    std::size_t offset = 0;
+    for (Record& record : records) {
+      std::memcpy(data.data() + offset, buffer_.data() + record.offset,
+                  record.size);
+      record.offset = offset;
+      offset += record.size;
+    }
+    topics = topics_;
+    flushing_ = true;
+    // Started under the lock, so that concurrent flushes never assign over
+    // a joinable thread.
+    flush_thread_ = std::thread(&BlackBoxRecorder::WriteBag, this, filename,
+                                compression, std::move(topics),
+                                std::move(records), std::move(data));
+  }
+  return true;
+}
+
+bool BlackBoxRecorder::Flushing() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return flushing_;
+}
+
+void BlackBoxRecorder::WriteBag(
+    const std::string& filename,
+    rosbag::compression::CompressionType compression,
+    const std::vector<BlackBoxTopic>& topics,
+    const std::vector<Record>& records, const std::vector<uint8_t>& data) {
+  try {
+    rosbag::Bag bag;
+    bag.open(filename, rosbag::bagmode::Write);
+    bag.setCompression(compression);
+    for (const Record& record : records) {
+      BlackBoxMessage msg;
+      msg.topic = &topics[record.topic_id];
+      msg.data = data.data() + record.offset;
+      msg.size = record.size;
+      bag.write(msg.topic->name, record.time, msg);
+    }
+    bag.close();
+    gzmsg << "[black_box_recorder] Wrote " << records.size()
+          << " messages to " << filename << ".\n";
+  }
+  catch (rosbag::BagException& e) {
+    gzerr << "[black_box_recorder] Error while writing " << filename << ": "
+          << e.what() << "\n";
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  flushing_ = false;
+}
+
+}  // namespace gazebo
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/control_loop_monitor.h"
+
+#include <algorithm>
+#include <map>
+
+namespace gazebo {
+
+namespace {
+
+std::mutex& RegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::map<const physics::World*, std::weak_ptr<ControlLoopMonitor> >&
+Registry() {
+  static std::map<const physics::World*, std::weak_ptr<ControlLoopMonitor> >
+      registry;
+  return registry;
+}
+
+}  // namespace
+
+ControlLoop::ControlLoop(std::shared_ptr<ControlLoopMonitor> monitor,
+                         const std::string& name, double deadline)
+    : monitor_(monitor) {
+  stats_.name = name;
+  stats_.deadline = deadline;
+  monitor_->Register(this);
+}
+
+ControlLoop::~ControlLoop() { monitor_->Unregister(this); }
+
+void ControlLoop::Request(const common::Time& sim_time) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (requests_.size() >= kMaxOpenControlRequests) {
+    requests_.pop_front();
+  }
+  requests_.emplace_back(sim_time.Double(), std::chrono::steady_clock::now());
+}
+
+void ControlLoop::Respond(const common::Time& sim_time) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  RespondFront(sim_time);
+}
+
+void ControlLoop::RespondLatest(const common::Time& sim_time) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (requests_.size() > 1) {
+    requests_.erase(requests_.begin(), requests_.end() - 1);
+  }
+  RespondFront(sim_time);
+}
+
+void ControlLoop::Report(double sim_latency, double wall_latency) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Record(sim_latency, wall_latency);
+}
+
+void ControlLoop::DropRequests() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.misses += requests_.size();
+  requests_.clear();
+}
+
+void ControlLoop::ClearRequests() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  requests_.clear();
+}
+
+ControlLoopStats ControlLoop::TakeStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ControlLoopStats stats = stats_;
+  stats_.samples = 0;
+  stats_.misses = 0;
+  stats_.total_latency = 0.0;
+  stats_.max_latency = 0.0;
+  stats_.max_wall_latency = 0.0;
+  return stats;
+}
+
+void ControlLoop::RespondFront(const common::Time& sim_time) {
+  if (requests_.empty()) {
+    return;
+  }
+  const double sim_latency = sim_time.Double() - requests_.front().first;
+  const double wall_latency = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - requests_.front().second).count();
+  requests_.pop_front();
+  Record(sim_latency, wall_latency);
+}
+
+void ControlLoop::Record(double sim_latency, double wall_latency) {
+  // Responses stamped before a world reset are meaningless.
+  if (sim_latency < 0.0) {
+    return;
+  }
+  ++stats_.samples;
+  if (sim_latency > stats_.deadline) {
+    ++stats_.misses;
+  }
+  stats_.total_latency += sim_latency;
+  stats_.max_latency = std::max(stats_.max_latency, sim_latency);
+  stats_.max_wall_latency = std::max(stats_.max_wall_latency, wall_latency);
+}
+
+std::shared_ptr<ControlLoopMonitor> ControlLoopMonitor::Get(
+    const physics::WorldPtr& world) {
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  std::weak_ptr<ControlLoopMonitor>& entry = Registry()[world.get()];
+  std::shared_ptr<ControlLoopMonitor> monitor = entry.lock();
+  if (!monitor) {
+    monitor = std::make_shared<ControlLoopMonitor>();
+    entry = monitor;
+  }
+  return monitor;
+}
+
+ControlLoopPtr ControlLoopMonitor::Connect(const physics::WorldPtr& world,
+                                           const std::string& name,
+                                           double deadline) {
+  return std::make_shared<ControlLoop>(Get(world), name, deadline);
+}
+
+void ControlLoopMonitor::Register(ControlLoop* loop) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  loops_.push_back(loop);
+}
+
+void ControlLoopMonitor::Unregister(ControlLoop* loop) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  loops_.erase(std::remove(loops_.begin(), loops_.end(), loop), loops_.end());
+}
+
+std::vector<ControlLoopStats> ControlLoopMonitor::TakeStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<ControlLoopStats> stats;
+  stats.reserve(loops_.size());
+  for (ControlLoop* loop : loops_) {
+    stats.push_back(loop->TakeStats());
+  }
+  return stats;
+}
+
+}  // namespace gazebo
@@ -0,0 +1,311 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/covariance_map.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+namespace gazebo {
+
+namespace {
+
+std::mutex& RegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::map<std::string, std::weak_ptr<const CovarianceMap> >& Registry() {
+  static std::map<std::string, std::weak_ptr<const CovarianceMap> > registry;
+  return registry;
+}
+
+}  // namespace
+
+bool CovarianceMapData::ReadImage(const std::string& path,
+                                  double image_resolution) {
+  const cv::Mat image = cv::imread(path, CV_LOAD_IMAGE_GRAYSCALE);
+  if (image.data == NULL || image_resolution <= 0.0) {
+    return false;
+  }
+  width = image.cols;
+  height = image.rows;
+  resolution = image_resolution;
+  // Pixel (width / 2, height / 2) starts at the origin.
+  min_x = -static_cast<double>(width / 2) * resolution;
+  min_y = -static_cast<double>(height / 2) * resolution;
+  cells.resize(static_cast<std::size_t>(width) * height);
+  for (uint32_t row = 0; row < height; ++row) {
+    std::memcpy(&cells[static_cast<std::size_t>(row) * width],
+                image.ptr<uint8_t>(row), width);
+  }
+  return true;
+}
+
+CovarianceMap::CovarianceMap()
+    : width_(0),
+      height_(0),
+      tile_size_(1),
+      n_tiles_x_(0),
+      min_x_(0.0),
+      min_y_(0.0),
+      resolution_(1.0),
+      num_stored_tiles_(0),
+      base_(nullptr),
+      index_(nullptr),
+      mapped_data_(nullptr),
+      mapped_size_(0) {}
+
+CovarianceMap::~CovarianceMap() {
+  Clear();
+}
+
+void CovarianceMap::Clear() {
+  if (mapped_data_ != nullptr) {
+    munmap(mapped_data_, mapped_size_);
+    mapped_data_ = nullptr;
+    mapped_size_ = 0;
+  }
+  std::vector<char>().swap(buffer_);
+  base_ = nullptr;
+  index_ = nullptr;
+  width_ = 0;
+  height_ = 0;
+  num_stored_tiles_ = 0;
+}
+
+std::shared_ptr<const CovarianceMap> CovarianceMap::Get(
+    const std::string& path, double image_resolution) {
+  std::ostringstream key;
+  key << std::setprecision(17) << path << " " << image_resolution;
+
+  // Plugins asking for the same map wait for the first one to load it.
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  std::weak_ptr<const CovarianceMap>& entry = Registry()[key.str()];
+  std::shared_ptr<const CovarianceMap> map = entry.lock();
+  if (!map) {
+    std::shared_ptr<CovarianceMap> loaded = std::make_shared<CovarianceMap>();
+    if (!loaded->Load(path, image_resolution)) {
+      return nullptr;
+    }
+    map = loaded;
+    entry = map;
+  }
+  return map;
+}
+
+bool CovarianceMap::IsBinaryFile(const std::string& path) {
+  std::ifstream fin(path, std::ios::binary);
+  char magic[sizeof(kCovarianceMapFileMagic)];
+  if (!fin.read(magic, sizeof(magic))) {
+    return false;
+  }
+  return std::memcmp(magic, kCovarianceMapFileMagic, sizeof(magic)) == 0;
+}
+
+bool CovarianceMap::Load(const std::string& path, double image_resolution) {
+  if (IsBinaryFile(path)) {
+    return LoadBinary(path);
+  }
+
+  Clear();
+  CovarianceMapData data;
+  if (!data.ReadImage(path, image_resolution)) {
+    return false;
+  }
+  Encode(data, kDefaultCovarianceMapTileSize, &buffer_);
+  if (!Attach(buffer_.data(), buffer_.size())) {
+    Clear();
+    return false;
+  }
+  return true;
+}
+
+bool CovarianceMap::LoadBinary(const std::string& path) {
+  Clear();
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 ||
+      static_cast<std::size_t>(file_stat.st_size) <
+          sizeof(CovarianceMapFileHeader)) {
+    close(fd);
+    return false;
+  }
+  mapped_size_ = file_stat.st_size;
+  mapped_data_ = mmap(nullptr, mapped_size_, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping stays valid after the file descriptor is closed.
+  close(fd);
+  if (mapped_data_ == MAP_FAILED) {
+    mapped_data_ = nullptr;
+    mapped_size_ = 0;
+    return false;
+  }
+  // Only the tiles around the vehicles are read.
+  madvise(mapped_data_, mapped_size_, MADV_RANDOM);
+
+  if (!Attach(mapped_data_, mapped_size_)) {
+    Clear();
+    return false;
+  }
+  return true;
+}
+
+bool CovarianceMap::Attach(const void* base, std::size_t size) {
+  CovarianceMapFileHeader header;
+  std::memcpy(&header, base, sizeof(header));
+  if (std::memcmp(header.magic, kCovarianceMapFileMagic,
+                  sizeof(header.magic)) != 0 ||
+      header.version != kCovarianceMapFileVersion || header.tile_size == 0 ||
+      header.width == 0 || header.height == 0 || !(header.resolution > 0.0) ||
+      header.index_offset % sizeof(uint64_t) != 0) {
+    return false;
+  }
+  const uint64_t n_tiles_x =
+      (static_cast<uint64_t>(header.width) + header.tile_size - 1) /
+      header.tile_size;
+  const uint64_t n_tiles_y =
+      (static_cast<uint64_t>(header.height) + header.tile_size - 1) /
+      header.tile_size;
+  const uint64_t n_tiles = n_tiles_x * n_tiles_y;
+  const uint64_t tile_bytes =
+      static_cast<uint64_t>(header.tile_size) * header.tile_size;
+  if (header.index_offset > size ||
+      n_tiles > (size - header.index_offset) / sizeof(uint64_t)) {
+    return false;
+  }
+
+  // Every stored tile must lie within the file, so that lookups need no
+  // checks.
+  const char* bytes = static_cast<const char*>(base);
+  const uint64_t* index =
+      reinterpret_cast<const uint64_t*>(bytes + header.index_offset);
+  std::size_t num_stored_tiles = 0;
+  for (uint64_t tile = 0; tile < n_tiles; ++tile) {
+    if (index[tile] & kCovarianceMapUniformTile) continue;
+    if (index[tile] > size || tile_bytes > size - index[tile]) {
+      return false;
+    }
+    ++num_stored_tiles;
+  }
+
+  base_ = base;
+  index_ = index;
+  width_ = header.width;
+  height_ = header.height;
+  tile_size_ = header.tile_size;
+  n_tiles_x_ = n_tiles_x;
+  min_x_ = header.min_x;
+  min_y_ = header.min_y;
+  resolution_ = header.resolution;
+  num_stored_tiles_ = num_stored_tiles;
+  return true;
+}
+
+void CovarianceMap::Encode(const CovarianceMapData& data, uint32_t tile_size,
+                           std::vector<char>* file) {
+  tile_size = std::max<uint32_t>(1, tile_size);
+  const uint32_t n_tiles_x = (data.width + tile_size - 1) / tile_size;
+  const uint32_t n_tiles_y = (data.height + tile_size - 1) / tile_size;
+  const std::size_t tile_bytes = static_cast<std::size_t>(tile_size) * tile_size;
+
+  CovarianceMapFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kCovarianceMapFileMagic, sizeof(header.magic));
+  header.version = kCovarianceMapFileVersion;
+  header.tile_size = tile_size;
+  header.width = data.width;
+  header.height = data.height;
+  header.min_x = data.min_x;
+  header.min_y = data.min_y;
+  header.resolution = data.resolution;
+  header.index_offset = sizeof(header);
+
+  std::vector<uint64_t> index(static_cast<std::size_t>(n_tiles_x) * n_tiles_y);
+  file->assign(sizeof(header) + index.size() * sizeof(uint64_t), 0);
+  std::vector<char> tile(tile_bytes);
+  for (uint32_t ty = 0; ty < n_tiles_y; ++ty) {
+    for (uint32_t tx = 0; tx < n_tiles_x; ++tx) {
+      // Cells beyond the map are never read, they repeat the first cell.
+      const uint8_t first =
+          data.cells[static_cast<std::size_t>(ty) * tile_size * data.width +
+                     static_cast<std::size_t>(tx) * tile_size];
+      bool uniform = true;
+      std::fill(tile.begin(), tile.end(), static_cast<char>(first));
+      for (uint32_t y = 0; y < tile_size; ++y) {
+        const uint32_t iy = ty * tile_size + y;
+        if (iy >= data.height) break;
+        for (uint32_t x = 0; x < tile_size; ++x) {
+          const uint32_t ix = tx * tile_size + x;
+          if (ix >= data.width) break;
+          const uint8_t value =
+              data.cells[ix + static_cast<std::size_t>(iy) * data.width];
+          tile[x + static_cast<std::size_t>(y) * tile_size] =
+              static_cast<char>(value);
+          uniform = uniform && value == first;
+        }
+      }
+      uint64_t& entry = index[tx + static_cast<std::size_t>(ty) * n_tiles_x];
+      if (uniform) {
+        entry = kCovarianceMapUniformTile | first;
+      } else {
+        entry = file->size();
+        file->insert(file->end(), tile.begin(), tile.end());
+      }
+    }
+  }
+  std::memcpy(file->data(), &header, sizeof(header));
+  std::memcpy(file->data() + sizeof(header), index.data(),
+              index.size() * sizeof(uint64_t));
+}
+
+bool CovarianceMap::WriteBinary(const CovarianceMapData& data,
+                                uint32_t tile_size, const std::string& path) {
+  if (data.width == 0 || data.height == 0 || !(data.resolution > 0.0) ||
+      data.cells.size() != static_cast<std::size_t>(data.width) * data.height) {
+    return false;
+  }
+
+  std::vector<char> file;
+  Encode(data, tile_size, &file);
+  std::ofstream fout(path, std::ios::binary | std::ios::trunc);
+  if (!fout.is_open()) {
+    return false;
+  }
+  fout.write(file.data(), file.size());
+  return static_cast<bool>(fout);
+}
+
+}  // namespace gazebo
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Converts a grayscale covariance image of the odometry plugin, centered
+// around the origin, into the tiled format that CovarianceMap maps into
+// memory.
+//
+// Usage: covariance_map_converter <input image> <output.bin> <resolution>
+//                                 [tile size]
+
+#include <cstdlib>
+#include <iostream>
+
+#include "rotors_gazebo_plugins/covariance_map.h"
+
+int main(int argc, char** argv) {
+  if (argc != 4 && argc != 5) {
+    std::cerr << "Usage: " << argv[0]
+              << " <input image> <output.bin> <resolution> [tile size]\n";
+    return EXIT_FAILURE;
+  }
+
+  const double resolution = std::atof(argv[3]);
+  const int tile_size =
+      argc == 5 ? std::atoi(argv[4]) : gazebo::kDefaultCovarianceMapTileSize;
+  if (resolution <= 0.0 || tile_size <= 0) {
+    std::cerr << "The resolution and the tile size must be positive.\n";
+    return EXIT_FAILURE;
+  }
+
+  gazebo::CovarianceMapData data;
+  if (!data.ReadImage(argv[1], resolution)) {
+    std::cerr << "Could not read a grayscale image from '" << argv[1]
+              << "'.\n";
+    return EXIT_FAILURE;
+  }
+
+  if (!gazebo::CovarianceMap::WriteBinary(data, tile_size, argv[2])) {
+    std::cerr << "Could not write the tiled covariance map to '" << argv[2]
+              << "'.\n";
+    return EXIT_FAILURE;
+  }
+
+  gazebo::CovarianceMap map;
+  if (!map.LoadBinary(argv[2])) {
+    std::cerr << "Could not read back the tiled covariance map '" << argv[2]
+              << "'.\n";
+    return EXIT_FAILURE;
+  }
+  std::cout << "Converted covariance map with " << data.width << " x "
+            << data.height << " cells at " << data.resolution << " m, "
+            << map.num_stored_tiles() << " of its tiles are not uniform.\n";
+  return EXIT_SUCCESS;
+}
@@ -18,56 +18,175 @@
 
 #include <rotors_gazebo_plugins/depth_noise_model.hpp>
 
+DepthNoiseModel::DepthNoiseModel()
+    : max_depth(1000.0f),
+      min_depth(0.2f),
+      seed_(std::random_device{}()),
+      frame_(0),
+      num_pending_(0),
+      stop_(false),
+      frame_width_(0),
+      frame_height_(0),
+      frame_src_(nullptr),
+      frame_dest_(nullptr) {
+  SetNumThreads(1);
+}
+
+DepthNoiseModel::~DepthNoiseModel() { StopWorkers(); }
+
 inline bool DepthNoiseModel::InRange(const float depth) const {
   return depth > this->min_depth && depth < this->max_depth;
 }
 
-void D435DepthNoiseModel::ApplyNoise(const uint32_t width,
-                                     const uint32_t height, float *data) {
-  if (data == nullptr) {
+void DepthNoiseModel::SetNumThreads(unsigned int num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  StopWorkers();
+
+  // Independent streams, the seeds are spread out by the golden ratio.
+  streams_.clear();
+  streams_.reserve(num_threads);
+  for (unsigned int i = 0; i < num_threads; ++i) {
+    streams_.emplace_back(seed_ + i * 0x9E3779B97F4A7C15ull);
+  }
+
+  stop_ = false;
+  for (unsigned int i = 1; i < num_threads; ++i) {
+    workers_.emplace_back(&DepthNoiseModel::WorkerThread, this, i);
+  }
+}
+
+void DepthNoiseModel::StopWorkers() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  frame_condition_.notify_all();
+  for (std::thread &worker : workers_) {
+    worker.join();
+  }
+  workers_.clear();
+}
+
+void DepthNoiseModel::ApplyNoise(const uint32_t width, const uint32_t height,
+                                 float *data) {
+  ApplyNoise(width, height, data, data);
+}
+
+void DepthNoiseModel::ApplyNoise(const uint32_t width, const uint32_t height,
+                                 const float *src, float *dest) {
+  if (src == nullptr || dest == nullptr) {
     return;
   }
+  PrepareFrame(width, height);
+
+  if (workers_.empty()) {
+    ApplyNoiseToRows(0, width, height, src, dest);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    frame_width_ = width;
+    frame_height_ = height;
+    frame_src_ = src;
+    frame_dest_ = dest;
+    num_pending_ = workers_.size();
+    ++frame_;
+  }
+  frame_condition_.notify_all();
+
+  ApplyNoiseToRows(0, width, height, src, dest);
 
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_condition_.wait(lock, [this] { return num_pending_ == 0; });
+}
+
+void DepthNoiseModel::WorkerThread(const unsigned int stream) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // A worker started by a later SetNumThreads() only takes the next frame.
+  uint64_t frame = frame_;
+  while (true) {
+    frame_condition_.wait(lock, [this, frame] {
+      return stop_ || frame_ != frame;
+    });
+    if (stop_) {
+      return;
+    }
+    frame = frame_;
+    const uint32_t width = frame_width_;
+    const uint32_t height = frame_height_;
+    const float *src = frame_src_;
+    float *dest = frame_dest_;
+    lock.unlock();
+
+    ApplyNoiseToRows(stream, width, height, src, dest);
+
+    lock.lock();
+    if (--num_pending_ == 0) {
+      done_condition_.notify_one();
+    }
+  }
+}
+
+void DepthNoiseModel::ApplyNoiseToRows(const unsigned int stream,
+                                       const uint32_t width,
+                                       const uint32_t height,
+                                       const float *src, float *dest) {
+  const size_t num_streams = streams_.size();
+  const size_t row_begin = height * stream / num_streams;
+  const size_t row_end = height * (stream + 1) / num_streams;
+  RowStream &row_stream = streams_[stream];
+
+  size_t pixel = row_begin * width;
+  const size_t pixel_end = row_end * width;
+  while (pixel < pixel_end) {
+    const size_t n = std::min(kPixelBlockSize, pixel_end - pixel);
+    row_stream.normal.Fill(row_stream.samples.data(), n);
+    ApplyNoiseToPixels(n, src + pixel, dest + pixel,
+                       row_stream.samples.data());
+    pixel += n;
+  }
+}
+
+void D435DepthNoiseModel::PrepareFrame(const uint32_t width,
+                                       const uint32_t height) {
   float f = 0.5f * (width / tanf(h_fov / 2.0f));
-  float multiplier = (subpixel_err) / (f * baseline * 1e6f);
-  Eigen::Map<Eigen::VectorXf> data_vector_map(data, width * height);
+  multiplier_ = (subpixel_err) / (f * baseline * 1e6f);
+}
+
+void D435DepthNoiseModel::ApplyNoiseToPixels(
+    const size_t n, const float *src, float *dest,
+    const float *normal_samples) const {
+  Eigen::Map<const Eigen::ArrayXf> depth(src, n);
+  Eigen::Map<const Eigen::ArrayXf> normal(normal_samples, n);
+  Eigen::Map<Eigen::ArrayXf> noisy_depth(dest, n);
 
   // Formula taken from the Intel Whitepaper:
   // "Best-Known-Methods for Tuning Intel RealSense™ D400 Depth Cameras for Best Performance".
   // We are using the theoretical RMS model formula.
-  Eigen::VectorXf rms_noise = (data_vector_map * 1000.0).array().square() * multiplier;
-  Eigen::VectorXf noise = rms_noise.array().square();
-
-  // Sample noise for each pixel and transform variance according to error at this depth.
-  for (int i = 0; i < width * height; ++i) {
-    if (InRange(data_vector_map[i])) {
-      data_vector_map[i] +=
-          this->dist(this->gen) * std::min(((float)noise(i)), max_stdev);
-    } else {
-      data_vector_map[i] = this->bad_point;
-    }
-  }
+  // Scale the noise of each pixel according to the error at this depth. The
+  // whole block is evaluated without branches, so that Eigen vectorizes it.
+  noisy_depth = (depth > min_depth && depth < max_depth)
+              .select(depth + normal * ((depth * 1000.0f).square() *
+                                        multiplier_).square().min(max_stdev),
+                      bad_point);
 }
 
-void KinectDepthNoiseModel::ApplyNoise(const uint32_t width,
-                                       const uint32_t height, float *data) {
-  if (data == nullptr) {
-    return;
-  }
+void KinectDepthNoiseModel::ApplyNoiseToPixels(
+    const size_t n, const float *src, float *dest,
+    const float *normal_samples) const {
+  Eigen::Map<const Eigen::ArrayXf> depth(src, n);
+  Eigen::Map<const Eigen::ArrayXf> normal(normal_samples, n);
+  Eigen::Map<Eigen::ArrayXf> noisy_depth(dest, n);
 
   // Axial noise model from
   // https://ieeexplore.ieee.org/stamp/stamp.jsp?arnumber=6375037,
   // Nguyen, Izadi & Lovell: "Modeling Kinect Sensor Noise for Improved 3D Reconstrucion and Tracking", 3DIM/3DPVT, 2012.
   // We are using the 10-60 Degree model as an approximation.
-  Eigen::Map<Eigen::VectorXf> data_vector_map(data, width * height);
-  Eigen::VectorXf var_noise = 0.0012f + 0.0019f * (data_vector_map.array() - 0.4f).array().square();
-
-  // Sample noise for each pixel and transform variance according to error at this depth.
-  for (int i = 0; i < width * height; ++i) {
-    if (InRange(data_vector_map[i])) {
-      data_vector_map[i] += this->dist(this->gen) * var_noise(i);
-    } else {
-      data_vector_map[i] = this->bad_point;
-    }
-  }
+  noisy_depth = (depth > min_depth && depth < max_depth)
+              .select(depth + normal * (0.0012f + 0.0019f *
+                                        (depth - 0.4f).square()),
+                      bad_point);
 }
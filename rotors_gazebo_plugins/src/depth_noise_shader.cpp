@@ -0,0 +1,143 @@
+/*
+ * Copyright 2018 Michael Pantic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <rotors_gazebo_plugins/depth_noise_shader.h>
+
+#include <cmath>
+#include <limits>
+
+#include <gazebo/common/Console.hh>
+#include <gazebo/rendering/RenderEngine.hh>
+
+namespace {
+const char kCompositorName[] = "RotorS/DepthNoise";
+// Identifier of the render_quad pass in depth_noise.compositor.
+const Ogre::uint32 kNoisePassId = 1;
+// Values of the model uniform in depth_noise_fs.glsl.
+const int kKinectModel = 0;
+const int kD435Model = 1;
+}  // namespace
+
+DepthNoiseShader::DepthNoiseShader()
+    : viewport_(nullptr),
+      compositor_(nullptr),
+      model_(kKinectModel),
+      min_depth_(0.0f),
+      max_depth_(0.0f),
+      multiplier_(0.0f),
+      max_stdev_(0.0f),
+      gen_(std::random_device{}()),
+      // Keeps the hash input in a range where float fractions are exact.
+      seed_dist_(0.0f, 1000.0f) {}
+
+DepthNoiseShader::~DepthNoiseShader() { Detach(); }
+
+bool DepthNoiseShader::AddResourcePath(const std::string &media_path) {
+  if (Ogre::CompositorManager::getSingleton().resourceExists(kCompositorName)) {
+    return true;
+  }
+  gazebo::rendering::RenderEngine::Instance()->AddResourcePath(media_path);
+  return Ogre::CompositorManager::getSingleton().resourceExists(
+      kCompositorName);
+}
+
+bool DepthNoiseShader::Attach(const std::string &depth_texture_name,
+                              const uint32_t width,
+                              const DepthNoiseModel &model) {
+  Detach();
+
+  const D435DepthNoiseModel *d435 =
+      dynamic_cast<const D435DepthNoiseModel *>(&model);
+  if (d435 != nullptr) {
+    model_ = kD435Model;
+    // Same as D435DepthNoiseModel::PrepareFrame().
+    const float f = 0.5f * (width / tanf(d435->h_fov / 2.0f));
+    multiplier_ = d435->subpixel_err / (f * d435->baseline * 1e6f);
+    max_stdev_ = d435->max_stdev;
+  } else if (dynamic_cast<const KinectDepthNoiseModel *>(&model) != nullptr) {
+    model_ = kKinectModel;
+  } else {
+    gzerr << "[depth_noise_shader] Noise model has no GPU implementation.\n";
+    return false;
+  }
+  min_depth_ = model.min_depth;
+  max_depth_ = model.max_depth;
+
+  Ogre::TexturePtr texture =
+      Ogre::TextureManager::getSingleton().getByName(depth_texture_name);
+  if (texture.isNull()) {
+    gzerr << "[depth_noise_shader] Depth texture " << depth_texture_name
+          << " not found.\n";
+    return false;
+  }
+  Ogre::RenderTarget *target = texture->getBuffer()->getRenderTarget();
+  if (target == nullptr || target->getNumViewports() == 0) {
+    gzerr << "[depth_noise_shader] Depth texture " << depth_texture_name
+          << " has no viewport.\n";
+    return false;
+  }
+
+  viewport_ = target->getViewport(0);
+  compositor_ = Ogre::CompositorManager::getSingleton().addCompositor(
+      viewport_, kCompositorName);
+  if (compositor_ == nullptr) {
+    gzerr << "[depth_noise_shader] Could not add compositor "
+          << kCompositorName << ".\n";
+    viewport_ = nullptr;
+    return false;
+  }
+  compositor_->addListener(this);
+  Ogre::CompositorManager::getSingleton().setCompositorEnabled(
+      viewport_, kCompositorName, true);
+  return true;
+}
+
+void DepthNoiseShader::Detach() {
+  if (compositor_ == nullptr) {
+    return;
+  }
+  compositor_->removeListener(this);
+  Ogre::CompositorManager::getSingleton().setCompositorEnabled(
+      viewport_, kCompositorName, false);
+  Ogre::CompositorManager::getSingleton().removeCompositor(viewport_,
+                                                          kCompositorName);
+  compositor_ = nullptr;
+  viewport_ = nullptr;
+}
+
+void DepthNoiseShader::notifyMaterialSetup(Ogre::uint32 pass_id,
+                                           Ogre::MaterialPtr &mat) {
+  if (pass_id != kNoisePassId) {
+    return;
+  }
+  Ogre::GpuProgramParametersSharedPtr params =
+      mat->getTechnique(0)->getPass(0)->getFragmentProgramParameters();
+  params->setNamedConstant("model", model_);
+  params->setNamedConstant("min_depth", min_depth_);
+  params->setNamedConstant("max_depth", max_depth_);
+  params->setNamedConstant("multiplier", multiplier_);
+  params->setNamedConstant("max_stdev", max_stdev_);
+  params->setNamedConstant("bad_point",
+                           std::numeric_limits<float>::quiet_NaN());
+}
+
+void DepthNoiseShader::notifyMaterialRender(Ogre::uint32 pass_id,
+                                            Ogre::MaterialPtr &mat) {
+  if (pass_id != kNoisePassId) {
+    return;
+  }
+  mat->getTechnique(0)->getPass(0)->getFragmentProgramParameters()
+      ->setNamedConstant("seed", seed_dist_(gen_));
+}
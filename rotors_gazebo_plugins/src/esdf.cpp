@@ -0,0 +1,194 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/esdf.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <thread>
+
+namespace gazebo {
+
+namespace {
+
+/// \brief Squared distance [cells^2] of the cells that no site can reach.
+static constexpr double kUnreachable = 1.0e20;
+
+/// \brief Runs work(thread, index) for every index in [0, count) on
+///        num_threads worker threads.
+void ParallelFor(int64_t count, int num_threads,
+                 const std::function<void(int, int64_t)>& work) {
+  std::atomic<int64_t> next(0);
+  std::vector<std::thread> workers;
+  for (int thread = 0; thread < num_threads; ++thread) {
+    workers.emplace_back([&, thread]() {
+      for (int64_t index = next++; index < count; index = next++) {
+        work(thread, index);
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
+
+/// \brief Buffers of the one dimensional transform of a worker.
+struct LineScratch {
+  std::vector<double> values;
+  std::vector<int> parabolas;
+  std::vector<double> boundaries;
+
+  void Resize(int n) {
+    values.resize(n);
+    parabolas.resize(n);
+    boundaries.resize(n + 1);
+  }
+};
+
+/// \brief Squared distance transform of the n samples line[i * stride], in
+///        place. Every sample is replaced by the minimum over j of
+///        line[j] + (i - j)^2, the lower envelope of the parabolas rooted at
+///        the samples (Felzenszwalb and Huttenlocher).
+void TransformLine(float* line, int64_t stride, int n, LineScratch* scratch) {
+  double* values = scratch->values.data();
+  int* parabolas = scratch->parabolas.data();
+  double* boundaries = scratch->boundaries.data();
+  for (int i = 0; i < n; ++i) {
+    values[i] = line[i * stride];
+  }
+
+  int k = 0;
+  parabolas[0] = 0;
+  boundaries[0] = -std::numeric_limits<double>::infinity();
+  boundaries[1] = std::numeric_limits<double>::infinity();
+  for (int q = 1; q < n; ++q) {
+    double s;
+    while (true) {
+      const int p = parabolas[k];
+      s = ((values[q] + static_cast<double>(q) * q) -
+           (values[p] + static_cast<double>(p) * p)) / (2.0 * (q - p));
+      if (s > boundaries[k]) break;
+      --k;
+    }
+    ++k;
+    parabolas[k] = q;
+    boundaries[k] = s;
+    boundaries[k + 1] = std::numeric_limits<double>::infinity();
+  }
+
+  k = 0;
+  for (int q = 0; q < n; ++q) {
+    while (boundaries[k + 1] < q) ++k;
+    const double offset = q - parabolas[k];
+    line[q * stride] = static_cast<float>(
+        std::min(kUnreachable, offset * offset + values[parabolas[k]]));
+  }
+}
+
+/// \brief Squared distance [cells^2] of every cell to the closest cell whose
+///        free flag equals sites_are_free.
+void SquaredDistanceToSites(const int num_cells[3],
+                            const std::vector<bool>& free_cells,
+                            bool sites_are_free, int num_threads,
+                            std::vector<float>* squared_distances) {
+  const int64_t slab_size = static_cast<int64_t>(num_cells[1]) * num_cells[2];
+  const int64_t size = num_cells[0] * slab_size;
+  squared_distances->resize(size);
+  float* distances = squared_distances->data();
+  for (int64_t index = 0; index < size; ++index) {
+    distances[index] = free_cells[index] == sites_are_free ? 0.0f : kUnreachable;
+  }
+
+  std::vector<LineScratch> scratch(num_threads);
+  for (LineScratch& buffers : scratch) {
+    buffers.Resize(*std::max_element(num_cells, num_cells + 3));
+  }
+
+  // Along z, then y, then x. A line of each pass starts at every cell of
+  // the plane spanned by the other two axes.
+  ParallelFor(num_cells[0] * static_cast<int64_t>(num_cells[1]), num_threads,
+              [&](int thread, int64_t line) {
+                TransformLine(distances + line * num_cells[2], 1, num_cells[2],
+                              &scratch[thread]);
+              });
+  ParallelFor(num_cells[0] * static_cast<int64_t>(num_cells[2]), num_threads,
+              [&](int thread, int64_t line) {
+                const int64_t ix = line / num_cells[2];
+                const int64_t iz = line % num_cells[2];
+                TransformLine(distances + ix * slab_size + iz, num_cells[2],
+                              num_cells[1], &scratch[thread]);
+              });
+  ParallelFor(slab_size, num_threads, [&](int thread, int64_t line) {
+    TransformLine(distances + line, slab_size, num_cells[0], &scratch[thread]);
+  });
+}
+
+}  // namespace
+
+void ComputeEsdf(const int num_cells[3], double voxel_size,
+                 const std::vector<bool>& free_cells, double max_distance,
+                 int num_threads, std::vector<float>* distances) {
+  num_threads = std::max(1, num_threads);
+  std::vector<float> to_free;
+  SquaredDistanceToSites(num_cells, free_cells, false, num_threads, distances);
+  SquaredDistanceToSites(num_cells, free_cells, true, num_threads, &to_free);
+
+  const float infinity = std::numeric_limits<float>::infinity();
+  const float limit = max_distance > 0.0 ? max_distance : infinity;
+  float* signed_distances = distances->data();
+  ParallelFor(num_threads, num_threads, [&](int, int64_t part) {
+    const int64_t size = distances->size();
+    const int64_t end = size * (part + 1) / num_threads;
+    for (int64_t index = size * part / num_threads; index < end; ++index) {
+      const bool is_free = free_cells[index];
+      const float squared_distance =
+          is_free ? signed_distances[index] : to_free[index];
+      const float distance = squared_distance >= kUnreachable
+                                 ? infinity
+                                 : std::sqrt(squared_distance) * voxel_size;
+      signed_distances[index] = std::min(limit, distance) * (is_free ? 1 : -1);
+    }
+  });
+}
+
+bool WriteEsdfFile(const std::string& path, const EsdfFileHeader& header,
+                   const std::vector<float>& distances) {
+  const std::string temporary_path = path + ".tmp";
+  {
+    std::ofstream file(temporary_path.c_str(),
+                       std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(distances.data()),
+               distances.size() * sizeof(float));
+    file.close();
+    if (!file) {
+      std::remove(temporary_path.c_str());
+      return false;
+    }
+  }
+  return std::rename(temporary_path.c_str(), path.c_str()) == 0;
+}
+
+}  // namespace gazebo
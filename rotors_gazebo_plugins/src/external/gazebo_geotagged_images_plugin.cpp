@@ -17,6 +17,7 @@
 
 #include "rotors_gazebo_plugins/external/gazebo_geotagged_images_plugin.h"
 
+#include <algorithm>
 #include <math.h>
 #include <string>
 #include <iostream>
@@ -36,14 +37,60 @@ GZ_REGISTER_SENSOR_PLUGIN(GeotaggedImagesPlugin)
 
 
 GeotaggedImagesPlugin::GeotaggedImagesPlugin() :
-    SensorPlugin(), width_(0), height_(0), depth_(0), imageCounter_(0) {}
+    SensorPlugin(), width_(0), height_(0), depth_(0), imageCounter_(0),
+    numWriterThreads_(kDefaultGeotaggedWriterThreads), stopWriters_(false),
+    framesWritten_(0), framesCaptured_(0), framesDropped_(0),
+    reportedFramesCaptured_(0), reportedFramesDropped_(0) {}
 
 GeotaggedImagesPlugin::~GeotaggedImagesPlugin()
 {
+  this->newFrameConnection_.reset();
+  StopWriters();
+  if (framesCaptured_ > 0) {
+    gzmsg << "[gazebo_geotagging_images_camera_plugin] Captured "
+          << framesCaptured_ << " frames, wrote " << framesWritten_
+          << ", dropped " << framesDropped_ << ".\n";
+  }
   this->parentSensor_.reset();
   this->camera_.reset();
 }
 
+void GeotaggedImagesPlugin::StopWriters()
+{
+  {
+    std::lock_guard<std::mutex> lock(writerMutex_);
+    stopWriters_ = true;
+  }
+  writerCondition_.notify_all();
+  for (std::thread& writer : writerThreads_) {
+    writer.join();
+  }
+  writerThreads_.clear();
+}
+
+void GeotaggedImagesPlugin::WriterThread()
+{
+  std::unique_lock<std::mutex> lock(writerMutex_);
+  while (true) {
+    writerCondition_.wait(lock, [this] {
+      return stopWriters_ || !pendingJobs_.empty();
+    });
+    // The frames still queued on shutdown are written before exiting.
+    if (pendingJobs_.empty()) {
+      return;
+    }
+    std::unique_ptr<FrameJob> job = std::move(pendingJobs_.front());
+    pendingJobs_.pop_front();
+    lock.unlock();
+
+    WriteFrame(*job);
+    ++framesWritten_;
+
+    lock.lock();
+    freeJobs_.push_back(std::move(job));
+  }
+}
+
 void GeotaggedImagesPlugin::Load(sensors::SensorPtr sensor, sdf::ElementPtr sdf)
 {
   if(kPrintOnPluginLoad) {
@@ -96,6 +143,14 @@ void GeotaggedImagesPlugin::Load(sensors::SensorPtr sensor, sdf::ElementPtr sdf)
 	destHeight_ = sdf->GetElement("height")->Get<int>();
   }
 
+  if (sdf->HasElement("writerThreads")) {
+    numWriterThreads_ = std::max(1, sdf->GetElement("writerThreads")->Get<int>());
+  }
+  int writerQueueSize = kDefaultGeotaggedWriterQueueSize;
+  if (sdf->HasElement("writerQueueSize")) {
+    writerQueueSize = std::max(1, sdf->GetElement("writerQueueSize")->Get<int>());
+  }
+
 
   //check if exiftool exists
   if (system("exiftool -ver &>/dev/null") != 0) {
@@ -119,6 +174,17 @@ void GeotaggedImagesPlugin::Load(sensors::SensorPtr sensor, sdf::ElementPtr sdf)
   storageDir_ = "frames";
   boost::filesystem::remove_all(storageDir_); //clear existing images
   boost::filesystem::create_directory(storageDir_);
+
+  // All frame buffers are allocated up front, one per queue slot and writer.
+  for (int i = 0; i < writerQueueSize + numWriterThreads_; ++i) {
+    std::unique_ptr<FrameJob> job(new FrameJob);
+    job->image.resize(width_ * height_ * depth_);
+    freeJobs_.push_back(std::move(job));
+  }
+  lastReportTime_ = lastImageTime_;
+  for (int i = 0; i < numWriterThreads_; ++i) {
+    writerThreads_.emplace_back(&GeotaggedImagesPlugin::WriterThread, this);
+  }
 }
 
 void GeotaggedImagesPlugin::OnNewGpsPosition(ConstVector3dPtr& v)
@@ -137,13 +203,54 @@ void GeotaggedImagesPlugin::OnNewFrame(const unsigned char * image)
     return;
   }
 
-  Mat frame = Mat(height_, width_, CV_8UC3);
-  Mat frameBGR = Mat(height_, width_, CV_8UC3);
-  frame.data = (uchar*)image; //frame has not the right color format yet -> convert
-  cvtColor(frame, frameBGR, CV_RGB2BGR);
+  // Hand the frame over to a writer, or drop it if all of them are busy.
+  std::unique_ptr<FrameJob> job;
+  {
+    std::lock_guard<std::mutex> lock(writerMutex_);
+    if (!freeJobs_.empty()) {
+      job = std::move(freeJobs_.back());
+      freeJobs_.pop_back();
+    }
+  }
+  if (job) {
+    memcpy(job->image.data(), image, job->image.size());
+    job->gpsPosition = lastGpsPosition_;
+    job->index = imageCounter_++;
+    {
+      std::lock_guard<std::mutex> lock(writerMutex_);
+      pendingJobs_.push_back(std::move(job));
+    }
+    writerCondition_.notify_one();
+    ++framesCaptured_;
+  } else {
+    ++framesDropped_;
+  }
+  lastImageTime_ = currentTime;
+
+  const double reportElapsed = (currentTime - lastReportTime_).Double();
+  if (reportElapsed >= kGeotaggedReportInterval) {
+    const uint64_t captured = framesCaptured_ - reportedFramesCaptured_;
+    const uint64_t dropped = framesDropped_ - reportedFramesDropped_;
+    gzmsg << "[gazebo_geotagging_images_camera_plugin] Captured "
+          << captured / reportElapsed << " frames/s over the last "
+          << reportElapsed << " s, dropped " << dropped << " ("
+          << framesDropped_ << " in total).\n";
+    reportedFramesCaptured_ = framesCaptured_;
+    reportedFramesDropped_ = framesDropped_;
+    lastReportTime_ = currentTime;
+  }
+}
+
+void GeotaggedImagesPlugin::WriteFrame(const FrameJob& job)
+{
+  // The buffer is only read, the Mat merely wraps it.
+  Mat frame = Mat(height_, width_, CV_8UC3,
+                  const_cast<unsigned char*>(job.image.data()));
+  Mat frameBGR;
+  cvtColor(frame, frameBGR, CV_RGB2BGR); //frame has not the right color format yet -> convert
 
   char file_name[256];
-  snprintf(file_name, sizeof(file_name), "%s/DSC%05i.jpg", storageDir_.c_str(), imageCounter_);
+  snprintf(file_name, sizeof(file_name), "%s/DSC%05i.jpg", storageDir_.c_str(), job.index);
 
   if (destWidth_ != width_ || destHeight_ != height_) {
     Mat frameResized;
@@ -155,9 +262,9 @@ void GeotaggedImagesPlugin::OnNewFrame(const unsigned char * image)
   }
 
   char gps_tag_command[1024];
-  double lat = lastGpsPosition_.x();
+  double lat = job.gpsPosition.x();
   char north_south = 'N', east_west = 'E';
-  double lon = lastGpsPosition_.y();
+  double lon = job.gpsPosition.y();
   if (lat < 0.) {
     lat = -lat;
     north_south = 'S';
@@ -171,11 +278,7 @@ void GeotaggedImagesPlugin::OnNewFrame(const unsigned char * image)
 //    " -gpsdatetime=now -gpsmapdatum=WGS-84"
     " -datetimeoriginal=now -gpsdop=0.8"
     " -gpsmeasuremode=3-d -gpssatellites=13 -gpsaltitude=%.3lf -overwrite_original %s &>/dev/null",
-    north_south, east_west, lat, lon, lastGpsPosition_.z(), file_name);
+    north_south, east_west, lat, lon, job.gpsPosition.z(), file_name);
 
   system(gps_tag_command);
-
-  ++imageCounter_;
-  lastImageTime_ = currentTime;
-
 }
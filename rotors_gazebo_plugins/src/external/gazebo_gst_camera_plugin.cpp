@@ -23,9 +23,11 @@
 #include "gazebo/sensors/DepthCameraSensor.hh"
 #include "rotors_gazebo_plugins/external/gazebo_gst_camera_plugin.h"
 
+#include <algorithm>
 #include <math.h>
 #include <string>
 #include <iostream>
+#include <sstream>
 #include <thread>
 #include <time.h>
 
@@ -35,36 +37,179 @@ using namespace gazebo;
 GZ_REGISTER_SENSOR_PLUGIN(GstCameraPlugin)
 
 
+namespace {
+
+/// Encoder element and the converter that uploads frames to it, per
+/// <encoder> and <codec>.
+struct GstEncoderInfo {
+  const char* encoder;
+  const char* codec;
+  const char* element;
+  const char* converter;
+  const char* parser;
+  const char* payloader;
+};
+
+const GstEncoderInfo kGstEncoders[] = {
+  {"x264", "h264", "x264enc", "videoconvert", "h264parse", "rtph264pay"},
+  {"nvenc", "h264", "nvh264enc", "cudaupload ! cudaconvert", "h264parse", "rtph264pay"},
+  {"vaapi", "h264", "vaapih264enc", "vaapipostproc", "h264parse", "rtph264pay"},
+  {"x265", "h265", "x265enc", "videoconvert", "h265parse", "rtph265pay"},
+  {"nvenc", "h265", "nvh265enc", "cudaupload ! cudaconvert", "h265parse", "rtph265pay"},
+  {"vaapi", "h265", "vaapih265enc", "vaapipostproc", "h265parse", "rtph265pay"},
+};
+
+/// Properties which minimize the latency of an encoder, skipped if the
+/// installed version does not have them.
+const char* const kGstZeroLatencyProperties[][3] = {
+  {"x264enc", "tune", "zerolatency"},
+  {"x264enc", "speed-preset", "ultrafast"},
+  {"x265enc", "tune", "zerolatency"},
+  {"x265enc", "speed-preset", "ultrafast"},
+  {"nvh264enc", "zerolatency", "true"},
+  {"nvh264enc", "preset", "low-latency-hq"},
+  {"nvh265enc", "zerolatency", "true"},
+  {"nvh265enc", "preset", "low-latency-hq"},
+  {"vaapih264enc", "rate-control", "cbr"},
+  {"vaapih265enc", "rate-control", "cbr"},
+};
+
+const char* gstFormatFromGazebo(const std::string& format) {
+  if (format == "R8G8B8" || format == "RGB_INT8") return "RGB";
+  if (format == "B8G8R8" || format == "BGR_INT8") return "BGR";
+  if (format == "L8" || format == "L_INT8") return "GRAY8";
+  return nullptr;
+}
+
+/// Sets a property from its string representation, if the element has it.
+bool setPropertyFromString(GstElement* element, const std::string& name,
+                           const std::string& value) {
+  if (!g_object_class_find_property(G_OBJECT_GET_CLASS(element), name.c_str())) {
+    gzdbg << "[gazebo_gst_camera_plugin] " << GST_ELEMENT_NAME(element)
+          << " has no property " << name << ", not setting it.\n";
+    return false;
+  }
+  gst_util_set_object_arg(G_OBJECT(element), name.c_str(), value.c_str());
+  return true;
+}
+
+/// True if the sink pad of element can take buffers with caps.
+bool acceptsCaps(GstElement* element, GstCaps* caps) {
+  GstPad* pad = gst_element_get_static_pad(element, "sink");
+  if (!pad) {
+    return false;
+  }
+  GstCaps* padCaps = gst_pad_query_caps(pad, NULL);
+  const bool accepts = gst_caps_can_intersect(caps, padCaps);
+  gst_caps_unref(padCaps);
+  gst_object_unref(pad);
+  return accepts;
+}
+
+const GstEncoderInfo* findEncoder(const std::string& encoder, const std::string& codec) {
+  for (const GstEncoderInfo& info : kGstEncoders) {
+    if (encoder == info.encoder && codec == info.codec) {
+      return &info;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace
+
 static void cb_need_data(GstElement *appsrc, guint unused_size, gpointer user_data) {
   GstCameraPlugin *plugin = (GstCameraPlugin*)user_data;
   plugin->gstCallback(appsrc);
 }
 
+static void cb_enough_data(GstElement *appsrc, gpointer user_data) {
+  GstCameraPlugin *plugin = (GstCameraPlugin*)user_data;
+  plugin->gstEnoughDataCallback(appsrc);
+}
+
 void GstCameraPlugin::gstCallback(GstElement *appsrc) {
+  needData = true;
+}
+
+void GstCameraPlugin::gstEnoughDataCallback(GstElement *appsrc) {
+  // The encoder is behind, drop frames in OnNewFrame() until it catches up.
+  needData = false;
+}
 
-  frameBufferMutex.lock();
+GstElement* GstCameraPlugin::createEncoder() {
+  if (!encoderPipeline.empty()) {
+    GError* error = nullptr;
+    GstElement* bin = gst_parse_bin_from_description(encoderPipeline.c_str(), TRUE, &error);
+    if (!bin) {
+      gzerr << "[gazebo_gst_camera_plugin] Invalid encoderPipeline \""
+            << encoderPipeline << "\": " << (error ? error->message : "") << "\n";
+      g_clear_error(&error);
+    }
+    return bin;
+  }
 
-  while (!frameBuffer) {
-	/* can happen if not initialized yet */
-    frameBufferMutex.unlock();
-    usleep(10000);
-    frameBufferMutex.lock();
+  const GstEncoderInfo* info = findEncoder(encoderName, codec);
+  if (!info) {
+    gzerr << "[gazebo_gst_camera_plugin] Unknown encoder " << encoderName
+          << " for codec " << codec << ".\n";
+    return nullptr;
+  }
+  GstElement* encoder = gst_element_factory_make(info->element, "Encoder");
+  if (!encoder) {
+    gzerr << "[gazebo_gst_camera_plugin] GStreamer element " << info->element
+          << " is not installed.\n";
+    return nullptr;
   }
 
-  GST_BUFFER_PTS(frameBuffer) = gstTimestamp;
-  GST_BUFFER_DURATION(frameBuffer) = gst_util_uint64_scale_int (1, GST_SECOND, (int)rate);
-  gstTimestamp += GST_BUFFER_DURATION(frameBuffer);
+  // All the supported encoders take the bitrate in kbit/s.
+  setPropertyFromString(encoder, "bitrate", std::to_string(bitrate));
+  if (encoderName == "x264" && !zeroLatency) {
+    g_object_set(G_OBJECT(encoder), "speed-preset", 2, NULL); //lower = faster, 6=medium
+  }
+  if (zeroLatency) {
+    for (const auto& property : kGstZeroLatencyProperties) {
+      if (std::string(property[0]) == info->element) {
+        setPropertyFromString(encoder, property[1], property[2]);
+      }
+    }
+  }
 
-  GstFlowReturn ret;
-  g_signal_emit_by_name(appsrc, "push-buffer", frameBuffer, &ret);
+  // Additional "name=value" pairs, separated by spaces.
+  std::istringstream properties(encoderProperties);
+  std::string property;
+  while (properties >> property) {
+    const size_t pos = property.find('=');
+    if (pos == std::string::npos) {
+      gzerr << "[gazebo_gst_camera_plugin] Ignoring encoder property \""
+            << property << "\", expected name=value.\n";
+      continue;
+    }
+    setPropertyFromString(encoder, property.substr(0, pos), property.substr(pos + 1));
+  }
+  return encoder;
+}
 
-  frameBufferMutex.unlock();
+GstElement* GstCameraPlugin::createConverter(GstElement *encoder, GstCaps *caps) {
+  if (acceptsCaps(encoder, caps)) {
+    return nullptr;
+  }
 
-  if (ret != GST_FLOW_OK) {
-    /* something wrong, stop pushing */
-    gzerr << "g_signal_emit_by_name failed" << endl;
-    g_main_loop_quit(mainLoop);
+  // Prefer the converter of the encoder, e.g. on the GPU, over videoconvert.
+  const GstEncoderInfo* info = encoderPipeline.empty() ? findEncoder(encoderName, codec) : nullptr;
+  if (info && std::string(info->converter) != "videoconvert") {
+    GError* error = nullptr;
+    GstElement* converter = gst_parse_bin_from_description(info->converter, TRUE, &error);
+    g_clear_error(&error);
+    if (converter && acceptsCaps(converter, caps)) {
+      return converter;
+    }
+    if (converter) {
+      gst_object_unref(converter);
+    }
   }
+  gzmsg << "[gazebo_gst_camera_plugin] Encoder does not accept "
+        << gstFormatFromGazebo(this->format) << " frames, using videoconvert.\n";
+  return gst_element_factory_make("videoconvert", "Convert");
 }
 
 static void* start_thread(void* param) {
@@ -89,54 +234,75 @@ void GstCameraPlugin::startGstThread() {
     return;
   }
 
+  const char* gstFormat = gstFormatFromGazebo(this->format);
+  if (!gstFormat) {
+    gzerr << "ERR: Unsupported camera image format " << this->format << ". \n";
+    return;
+  }
+
   GstElement* dataSrc = gst_element_factory_make("appsrc", "AppSrc");
-  GstElement* testSrc = gst_element_factory_make("videotestsrc", "FileSrc");
-  GstElement* conv  = gst_element_factory_make("videoconvert", "Convert");
-  GstElement* encoder = gst_element_factory_make("x264enc", "AvcEncoder");
-  GstElement* parser  = gst_element_factory_make("h264parse", "Parser");
-  GstElement* payload = gst_element_factory_make("rtph264pay", "PayLoad");
+  GstElement* encoder = createEncoder();
+  const bool h265 = codec == "h265";
+  GstElement* parser  = gst_element_factory_make(h265 ? "h265parse" : "h264parse", "Parser");
+  GstElement* payload = gst_element_factory_make(h265 ? "rtph265pay" : "rtph264pay", "PayLoad");
   GstElement* sink  = gst_element_factory_make("udpsink", "UdpSink");
-  if (!dataSrc || !testSrc || !conv || !encoder || !parser || !payload || !sink) {
+  if (!dataSrc || !encoder || !parser || !payload || !sink) {
     gzerr << "ERR: Create elements failed. \n";
     return;
   }
 
-// gzerr <<"width"<< this->width<<"\n";
-// gzerr <<"height"<< this->height<<"\n";
-// gzerr <<"rate"<< this->rate<<"\n";
-
   // Config src
-  g_object_set(G_OBJECT(dataSrc), "caps",
-      gst_caps_new_simple ("video/x-raw",
-      "format", G_TYPE_STRING, "RGB",
+  GstCaps* caps = gst_caps_new_simple ("video/x-raw",
+      "format", G_TYPE_STRING, gstFormat,
       "width", G_TYPE_INT, this->width,
       "height", G_TYPE_INT, this->height,
       "framerate", GST_TYPE_FRACTION, (unsigned int)this->rate, 1,
-      NULL),
+      NULL);
+  // Never block the rendering thread, and keep at most one frame queued in
+  // appsrc, the rest waits in the encoder.
+  const guint frameSize = this->width * this->height * this->depth;
+  g_object_set(G_OBJECT(dataSrc), "caps", caps,
       "is-live", TRUE,
+      "block", FALSE,
+      "max-bytes", (guint64)frameSize,
       NULL);
 
-  // Config encoder
-  g_object_set(G_OBJECT(encoder), "bitrate", 800, NULL);
-  g_object_set(G_OBJECT(encoder), "speed-preset", 2, NULL); //lower = faster, 6=medium
-  //g_object_set(G_OBJECT(encoder), "tune", "zerolatency", NULL);
-  //g_object_set(G_OBJECT(encoder), "low-latency", 1, NULL);
-  //g_object_set(G_OBJECT(encoder), "control-rate", 2, NULL);
+  GstElement* conv = createConverter(encoder, caps);
+
+  // Preallocate the frame buffers, OnNewFrame() drops the frame if none is
+  // free.
+  GstBufferPool* pool = gst_buffer_pool_new();
+  GstStructure* poolConfig = gst_buffer_pool_get_config(pool);
+  gst_buffer_pool_config_set_params(poolConfig, caps, frameSize,
+      this->bufferPoolSize, this->bufferPoolSize);
+  gst_caps_unref(caps);
+  if (!gst_buffer_pool_set_config(pool, poolConfig) ||
+      !gst_buffer_pool_set_active(pool, TRUE)) {
+    gzerr << "ERR: Setting up the buffer pool failed. \n";
+    gst_object_unref(pool);
+    return;
+  }
 
   // Config payload
   g_object_set(G_OBJECT(payload), "config-interval", 1, NULL);
 
   // Config udpsink
-  g_object_set(G_OBJECT(sink), "host", "127.0.0.1", NULL);
+  g_object_set(G_OBJECT(sink), "host", this->udpHost.c_str(), NULL);
   g_object_set(G_OBJECT(sink), "port", this->udpPort, NULL);
   //g_object_set(G_OBJECT(sink), "sync", false, NULL);
   //g_object_set(G_OBJECT(sink), "async", false, NULL);
 
-  // Connect all elements to pipeline
-  gst_bin_add_many(GST_BIN(pipeline), dataSrc, conv, encoder, parser, payload, sink, NULL);
-
-  // Link all elements
-  if (gst_element_link_many(dataSrc, conv, encoder, parser, payload, sink, NULL) != TRUE) {
+  // Connect all elements to pipeline and link them, the converter is only
+  // there if the encoder cannot take the camera frames directly.
+  gst_bin_add_many(GST_BIN(pipeline), dataSrc, encoder, parser, payload, sink, NULL);
+  bool linked;
+  if (conv) {
+    gst_bin_add(GST_BIN(pipeline), conv);
+    linked = gst_element_link_many(dataSrc, conv, encoder, parser, payload, sink, NULL);
+  } else {
+    linked = gst_element_link_many(dataSrc, encoder, parser, payload, sink, NULL);
+  }
+  if (linked != TRUE) {
     gzerr << "ERR: Link all the elements failed. \n";
     return;
   }
@@ -144,13 +310,26 @@ void GstCameraPlugin::startGstThread() {
   // Set up appsrc
   g_object_set(G_OBJECT(dataSrc), "stream-type", 0, "format", GST_FORMAT_TIME, NULL);
   g_signal_connect(dataSrc, "need-data", G_CALLBACK(cb_need_data), this);
+  g_signal_connect(dataSrc, "enough-data", G_CALLBACK(cb_enough_data), this);
 
   // Start
   gst_element_set_state(pipeline, GST_STATE_PLAYING);
+  {
+    std::lock_guard<std::mutex> guard(frameBufferMutex);
+    appSrc = dataSrc;
+    bufferPool = pool;
+  }
   g_main_loop_run(mainLoop);
 
   // Clean up
+  {
+    std::lock_guard<std::mutex> guard(frameBufferMutex);
+    appSrc = nullptr;
+    bufferPool = nullptr;
+  }
   gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_buffer_pool_set_active(pool, FALSE);
+  gst_object_unref(pool);
   gst_object_unref(GST_OBJECT(pipeline));
   g_main_loop_unref(mainLoop);
   mainLoop = nullptr;
@@ -159,8 +338,9 @@ void GstCameraPlugin::startGstThread() {
 
 /////////////////////////////////////////////////
 GstCameraPlugin::GstCameraPlugin()
-: SensorPlugin(), width(0), height(0), depth(0), frameBuffer(nullptr), mainLoop(nullptr),
-  gstTimestamp(0)
+: SensorPlugin(), width(0), height(0), depth(0), appSrc(nullptr), bufferPool(nullptr),
+  bufferPoolSize(kDefaultGstBufferPoolSize), mainLoop(nullptr), gstTimestamp(0),
+  needData(true), framesPushed(0), framesDropped(0), reportedFramesDropped(0)
 {
 }
 
@@ -172,11 +352,8 @@ GstCameraPlugin::~GstCameraPlugin()
   if (mainLoop) {
     g_main_loop_quit(mainLoop);
   }
-  std::lock_guard<std::mutex> guard(frameBufferMutex);
-  if (frameBuffer) {
-	  gst_buffer_unref(frameBuffer);
-	  frameBuffer = nullptr;
-  }
+  gzmsg << "[gazebo_gst_camera_plugin] Streamed " << framesPushed
+        << " frames, dropped " << framesDropped << ".\n";
 }
 
 /////////////////////////////////////////////////
@@ -228,6 +405,43 @@ void GstCameraPlugin::Load(sensors::SensorPtr sensor, sdf::ElementPtr sdf)
 	this->udpPort = sdf->GetElement("udpPort")->Get<int>();
   }
 
+  this->udpHost = kDefaultGstUdpHost;
+  if (sdf->HasElement("udpHost")) {
+    this->udpHost = sdf->GetElement("udpHost")->Get<std::string>();
+  }
+
+  this->encoderName = kDefaultGstEncoder;
+  if (sdf->HasElement("encoder")) {
+    this->encoderName = sdf->GetElement("encoder")->Get<std::string>();
+  }
+
+  this->codec = kDefaultGstCodec;
+  if (sdf->HasElement("codec")) {
+    this->codec = sdf->GetElement("codec")->Get<std::string>();
+  }
+
+  if (sdf->HasElement("encoderPipeline")) {
+    this->encoderPipeline = sdf->GetElement("encoderPipeline")->Get<std::string>();
+  }
+
+  if (sdf->HasElement("encoderProperties")) {
+    this->encoderProperties = sdf->GetElement("encoderProperties")->Get<std::string>();
+  }
+
+  this->bitrate = kDefaultGstBitrate;
+  if (sdf->HasElement("bitrate")) {
+    this->bitrate = sdf->GetElement("bitrate")->Get<int>();
+  }
+
+  this->zeroLatency = kDefaultGstZeroLatency;
+  if (sdf->HasElement("zeroLatency")) {
+    this->zeroLatency = sdf->GetElement("zeroLatency")->Get<bool>();
+  }
+
+  if (sdf->HasElement("bufferPoolSize")) {
+    this->bufferPoolSize = std::max(2, sdf->GetElement("bufferPoolSize")->Get<int>());
+  }
+
   node_handle_ = transport::NodePtr(new transport::Node());
   node_handle_->Init(namespace_);
 
@@ -252,21 +466,60 @@ void GstCameraPlugin::OnNewFrame(const unsigned char * image,
 
   image = this->camera->ImageData(0);
 
-  std::lock_guard<std::mutex> guard(frameBufferMutex);
-
-  if (frameBuffer) {
-	gst_buffer_unref(frameBuffer);
+  if (!needData) {
+    ++framesDropped;
+  } else {
+    std::lock_guard<std::mutex> guard(frameBufferMutex);
+    if (!appSrc) {
+      /* pipeline not running yet */
+      return;
+    }
+
+    // Gazebo renders the next frame into the same memory, so the frame is
+    // copied once, into a buffer the encoder can hold on to. A frame without a
+    // free buffer is dropped instead of allocating one.
+    GstBuffer *frameBuffer = nullptr;
+    GstBufferPoolAcquireParams params = GstBufferPoolAcquireParams();
+    params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+    if (gst_buffer_pool_acquire_buffer(bufferPool, &frameBuffer, &params) != GST_FLOW_OK) {
+      ++framesDropped;
+    } else {
+      guint size = width * height * depth;
+      GstMapInfo mapInfo;
+      if (gst_buffer_map(frameBuffer, &mapInfo, GST_MAP_WRITE)) {
+        memcpy(mapInfo.data, image, size);
+        gst_buffer_unmap(frameBuffer, &mapInfo);
+      } else {
+        gzerr << "gst_buffer_map failed"<<endl;
+      }
+
+      GST_BUFFER_PTS(frameBuffer) = gstTimestamp;
+      GST_BUFFER_DURATION(frameBuffer) = gst_util_uint64_scale_int (1, GST_SECOND, (int)rate);
+      gstTimestamp += GST_BUFFER_DURATION(frameBuffer);
+
+      // push-buffer takes its own reference, ours goes back with the unref.
+      GstFlowReturn ret;
+      g_signal_emit_by_name(appSrc, "push-buffer", frameBuffer, &ret);
+      gst_buffer_unref(frameBuffer);
+
+      if (ret != GST_FLOW_OK) {
+        /* something wrong, stop pushing */
+        gzerr << "g_signal_emit_by_name failed" << endl;
+        g_main_loop_quit(mainLoop);
+      } else {
+        ++framesPushed;
+      }
+    }
   }
 
-  // Alloc buffer
-  guint size = width * height * 3;
-  frameBuffer = gst_buffer_new_allocate(NULL, size, NULL);
-
-  GstMapInfo mapInfo;
-  if (gst_buffer_map(frameBuffer, &mapInfo, GST_MAP_WRITE)) {
-    memcpy(mapInfo.data, image, size);
-    gst_buffer_unmap(frameBuffer, &mapInfo);
-  } else {
-	  gzerr << "gst_buffer_map failed"<<endl;
+  const uint64_t dropped = framesDropped;
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (dropped > reportedFramesDropped &&
+      now - lastDropReport > std::chrono::duration<double>(kGstDropReportInterval)) {
+    gzwarn << "[gazebo_gst_camera_plugin] Encoder falling behind, dropped "
+           << dropped - reportedFramesDropped << " frames (" << dropped
+           << " of " << dropped + framesPushed << " in total).\n";
+    reportedFramesDropped = dropped;
+    lastDropReport = now;
   }
 }
@@ -32,6 +32,7 @@
 #include <chrono>
 #include <cmath>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <stdio.h>
 #include <boost/algorithm/string.hpp>
@@ -46,6 +47,10 @@ GZ_REGISTER_SENSOR_PLUGIN(GazeboLidarPlugin)
 
 
 GazeboLidarPlugin::GazeboLidarPlugin()
+    : multi_beam_(kDefaultLidarMultiBeam),
+      range_noise_stddev_(kDefaultLidarRangeNoiseStdDev),
+      random_generator_(std::random_device{}()),
+      standard_normal_distribution_(0.0f, 1.0f)
 {
 }
 
@@ -92,11 +97,66 @@ void GazeboLidarPlugin::Load(sensors::SensorPtr _parent, sdf::ElementPtr _sdf)
   boost::replace_all(topicName, "::", "/");
 
   lidar_pub_ = node_handle_->Advertise<lidar_msgs::msgs::lidar>(topicName, 10);
+
+  getSdfParam<bool>(_sdf, "multiBeam", multi_beam_, multi_beam_);
+  getSdfParam<double>(_sdf, "rangeNoiseStdDev", range_noise_stddev_,
+                      range_noise_stddev_);
+  if (multi_beam_) {
+    topicName += "_scan";
+    scan_pub_ =
+        node_handle_->Advertise<lidar_msgs::msgs::lidar_scan>(topicName, 10);
+    InitScan();
+  }
+}
+
+
+void GazeboLidarPlugin::InitScan()
+{
+  const int width = parentSensor->RangeCount();
+  const int height = parentSensor->VerticalRangeCount();
+  const int num_beams = width * height;
+
+  const double angle_min = parentSensor->AngleMin().Radian();
+  const double angle_step = width > 1 ?
+      (parentSensor->AngleMax().Radian() - angle_min) / (width - 1) : 0.0;
+  const double vertical_angle_min = parentSensor->VerticalAngleMin().Radian();
+  const double vertical_angle_step = height > 1 ?
+      (parentSensor->VerticalAngleMax().Radian() - vertical_angle_min) /
+      (height - 1) : 0.0;
+
+  beam_x_.resize(num_beams);
+  beam_y_.resize(num_beams);
+  beam_z_.resize(num_beams);
+  for (int j = 0; j < height; ++j) {
+    const double pitch = vertical_angle_min + j * vertical_angle_step;
+    for (int i = 0; i < width; ++i) {
+      const double yaw = angle_min + i * angle_step;
+      const int index = j * width + i;
+      beam_x_[index] = cos(pitch) * cos(yaw);
+      beam_y_[index] = cos(pitch) * sin(yaw);
+      beam_z_[index] = sin(pitch);
+    }
+  }
+
+  ranges_.reserve(num_beams);
+  range_buffer_.resize(num_beams);
+  noise_buffer_.resize(num_beams);
+
+  scan_message_.set_min_distance(parentSensor->RangeMin());
+  scan_message_.set_max_distance(parentSensor->RangeMax());
+  scan_message_.set_width(width);
+  scan_message_.set_height(height);
+  scan_message_.mutable_points()->resize(3 * num_beams * sizeof(float));
 }
 
 
 void GazeboLidarPlugin::OnNewLaserScans()
 {
+  if (multi_beam_) {
+    PublishScan();
+    return;
+  }
+
   lidar_message.set_time_msec(0);
   lidar_message.set_min_distance(parentSensor->RangeMin());
   lidar_message.set_max_distance(parentSensor->RangeMax());
@@ -104,3 +164,43 @@ void GazeboLidarPlugin::OnNewLaserScans()
 
   lidar_pub_->Publish(lidar_message);
 }
+
+
+void GazeboLidarPlugin::PublishScan()
+{
+  // Copies all ranges under a single lock of the sensor.
+  parentSensor->Ranges(ranges_);
+  const int num_beams = beam_x_.size();
+  if (static_cast<int>(ranges_.size()) != num_beams) {
+    gzerr << "[gazebo_lidar_plugin] Got " << ranges_.size()
+          << " ranges, expected " << num_beams << ".\n";
+    return;
+  }
+
+  range_buffer_ =
+      Eigen::Map<const Eigen::ArrayXd>(ranges_.data(), num_beams).cast<float>();
+  if (range_noise_stddev_ > 0.0) {
+    for (int i = 0; i < num_beams; ++i) {
+      noise_buffer_[i] = standard_normal_distribution_(random_generator_);
+    }
+    range_buffer_ += static_cast<float>(range_noise_stddev_) * noise_buffer_;
+  }
+
+  // Beams without a return (infinite range) are clipped as well.
+  const float min_distance = scan_message_.min_distance();
+  const float max_distance = scan_message_.max_distance();
+  range_buffer_ = (range_buffer_ < min_distance || range_buffer_ > max_distance)
+      .select(std::numeric_limits<float>::quiet_NaN(), range_buffer_);
+
+  // Writes straight into the pre-sized bytes of the message.
+  Eigen::Map<Eigen::Array<float, 3, Eigen::Dynamic>> points(
+      reinterpret_cast<float*>(&(*scan_message_.mutable_points())[0]), 3,
+      num_beams);
+  points.row(0) = (range_buffer_ * beam_x_).transpose();
+  points.row(1) = (range_buffer_ * beam_y_).transpose();
+  points.row(2) = (range_buffer_ * beam_z_).transpose();
+
+  scan_message_.set_time_msec(
+      parentSensor->LastMeasurementTime().Double() * 1e3);
+  scan_pub_->Publish(scan_message_);
+}
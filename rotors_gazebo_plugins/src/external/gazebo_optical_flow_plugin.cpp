@@ -40,7 +40,8 @@ GZ_REGISTER_SENSOR_PLUGIN(OpticalFlowPlugin)
 
 /////////////////////////////////////////////////
 OpticalFlowPlugin::OpticalFlowPlugin()
-: SensorPlugin(), width(0), height(0), depth(0), timer_()
+: SensorPlugin(), width(0), height(0), depth(0), timer_(),
+  _optical_flow(nullptr)
 {
 
 }
@@ -48,6 +49,7 @@ OpticalFlowPlugin::OpticalFlowPlugin()
 /////////////////////////////////////////////////
 OpticalFlowPlugin::~OpticalFlowPlugin()
 {
+  delete _optical_flow;
   this->parentSensor.reset();
   this->camera.reset();
 }
@@ -85,7 +87,17 @@ void OpticalFlowPlugin::Load(sensors::SensorPtr _sensor, sdf::ElementPtr _sdf)
   this->depth = this->camera->ImageDepth();
   this->format = this->camera->ImageFormat();
 
-  if (this->width != 64 || this->height != 64) {
+  // "opencv" runs the PX4 OpticalFlow library on the full 64 x 64 image,
+  // "pyramid" tracks on the downsampled center of an image of any size.
+  std::string flow_engine = "opencv";
+  getSdfParam<std::string>(_sdf, "flowEngine", flow_engine, flow_engine);
+  const bool use_pyramid_flow = (flow_engine == "pyramid");
+  if (!use_pyramid_flow && flow_engine != "opencv") {
+    gzerr << "[gazebo_optical_flow_plugin] Unknown flowEngine \"" << flow_engine
+          << "\", using \"opencv\".\n";
+  }
+
+  if (!use_pyramid_flow && (this->width != 64 || this->height != 64)) {
     gzerr << "[gazebo_optical_flow_plugin] Incorrect image size, must by 64 x 64.\n";
   }
 
@@ -116,9 +128,22 @@ void OpticalFlowPlugin::Load(sensors::SensorPtr _sensor, sdf::ElementPtr _sdf)
   this->parentSensor->SetActive(true);
 
   //init flow
-  const int ouput_rate = 20; // -1 means use rate of camera
-  _optical_flow = new OpticalFlowOpenCV(focal_length, focal_length, ouput_rate);
-  // _optical_flow = new OpticalFlowPX4(focal_length, focal_length, ouput_rate, this->width);
+  int ouput_rate = kDefaultOpticalFlowOutputRate; // -1 means use rate of camera
+  getSdfParam<int>(_sdf, "outputRate", ouput_rate, ouput_rate);
+  if (use_pyramid_flow) {
+    int roi_size = kDefaultOpticalFlowRoiSize;
+    getSdfParam<int>(_sdf, "roiSize", roi_size, roi_size);
+    if (roi_size <= 0) {
+      gzerr << "[gazebo_optical_flow_plugin] roiSize must be positive, using "
+            << kDefaultOpticalFlowRoiSize << ".\n";
+      roi_size = kDefaultOpticalFlowRoiSize;
+    }
+    pyramid_flow_.reset(new PyramidOpticalFlow(this->width, this->height,
+        this->depth, focal_length, ouput_rate, roi_size));
+  } else {
+    _optical_flow = new OpticalFlowOpenCV(focal_length, focal_length, ouput_rate);
+    // _optical_flow = new OpticalFlowPX4(focal_length, focal_length, ouput_rate, this->width);
+  }
 
 }
 
@@ -141,7 +166,12 @@ void OpticalFlowPlugin::OnNewFrame(const unsigned char * _image,
   float flow_x_ang = 0;
   float flow_y_ang = 0;
   //calculate angular flow
-  int quality = _optical_flow->calcFlow((uint8_t *)_image, frame_time_us, dt_us, flow_x_ang, flow_y_ang);
+  int quality;
+  if (pyramid_flow_) {
+    quality = pyramid_flow_->calcFlow(_image, frame_time_us, dt_us, flow_x_ang, flow_y_ang);
+  } else {
+    quality = _optical_flow->calcFlow((uint8_t *)_image, frame_time_us, dt_us, flow_x_ang, flow_y_ang);
+  }
 
 
 
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/fast_multi_copter.h"
+
+#include <cmath>
+
+FastMultiCopter::FastMultiCopter(const FastMultiCopterParameters& params)
+    : MultiCopter(params.vehicle.rotor_configuration_.rotors.size()),
+      params_(params),
+      time_(0.0),
+      on_ground_(false),
+      wind_speed_W_(Eigen::Vector3d::Zero()),
+      external_force_W_(Eigen::Vector3d::Zero()),
+      external_moment_B_(Eigen::Vector3d::Zero()),
+      filter_dt_(-1.0),
+      alpha_up_(0.0),
+      alpha_down_(0.0) {
+  initializeParams();
+}
+
+FastMultiCopter::FastMultiCopter(const FastMultiCopterParameters& params,
+                                 MotorController* motor_controller)
+    : FastMultiCopter(params) {
+  setMotorController(motor_controller);
+}
+
+void FastMultiCopter::initializeParams() {
+  const std::vector<rotors_control::Rotor>& rotors =
+      params_.vehicle.rotor_configuration_.rotors;
+  const int num_rotors = rotors.size();
+
+  rotor_positions_.resize(2, num_rotors);
+  motor_constants_.resize(num_rotors);
+  yaw_moment_constants_.resize(num_rotors);
+  for (int i = 0; i < num_rotors; ++i) {
+    const rotors_control::Rotor& rotor = rotors[i];
+    rotor_positions_(0, i) = std::cos(rotor.angle) * rotor.arm_length;
+    rotor_positions_(1, i) = std::sin(rotor.angle) * rotor.arm_length;
+    motor_constants_(i) = rotor.rotor_force_constant;
+    // Same sign convention as the allocation matrix of rotors_control.
+    yaw_moment_constants_(i) = -rotor.direction * rotor.rotor_moment_constant;
+  }
+
+  inertia_inverse_ = params_.vehicle.inertia_.inverse();
+  rotor_rot_vels_.setZero(num_rotors);
+  thrusts_.resize(num_rotors);
+  filter_dt_ = -1.0;
+}
+
+void FastMultiCopter::reset(const Eigen::Vector3d& position,
+                            const Eigen::Quaterniond& attitude) {
+  time_ = 0.0;
+  on_ground_ = false;
+  position_ = position;
+  velocity_.setZero();
+  attitude_ = attitude.normalized();
+  angular_rate_.setZero();
+  rotor_rot_vels_.setZero();
+  external_force_W_.setZero();
+  external_moment_B_.setZero();
+}
+
+void FastMultiCopter::simulateMAV(double dt,
+                                  const Eigen::VectorXd& ref_rotor_rot_vels) {
+  assert(ref_rotor_rot_vels.size() == rotor_rot_vels_.size());
+  if (dt <= 0.0)
+    return;
+
+  // Exact discretization of the first order rotor dynamics, as in
+  // FirstOrderFilter, with the exponentials cached for a fixed step size.
+  if (dt != filter_dt_) {
+    alpha_up_ = std::exp(-dt / params_.time_constant_up);
+    alpha_down_ = std::exp(-dt / params_.time_constant_down);
+    filter_dt_ = dt;
+  }
+  for (int i = 0; i < rotor_rot_vels_.size(); ++i) {
+    const double ref = std::min(std::max(ref_rotor_rot_vels(i), 0.0),
+                                params_.max_rot_velocity);
+    const double alpha = ref > rotor_rot_vels_(i) ? alpha_up_ : alpha_down_;
+    rotor_rot_vels_(i) = alpha * rotor_rot_vels_(i) + (1.0 - alpha) * ref;
+  }
+
+  const auto rot_vels = rotor_rot_vels_.array();
+  thrusts_ = motor_constants_ * rot_vels.square();
+  const double total_speed = rot_vels.abs().sum();
+
+  const Eigen::Matrix3d R_W_B = attitude_.toRotationMatrix();
+
+  // Velocity of the air relative to the rotor planes, in body frame.
+  Eigen::Vector3d air_velocity_B = R_W_B.transpose() * (velocity_ - wind_speed_W_);
+  air_velocity_B.z() = 0.0;
+
+  // Forces and moments of all rotors in body frame. The drag of a rotor acts
+  // at the rotor, so it also adds a moment about the CoG.
+  Eigen::Vector3d force_B = -params_.rotor_drag_coefficient * total_speed * air_velocity_B;
+  force_B.z() += thrusts_.sum();
+
+  Eigen::Vector3d drag_arm_B = Eigen::Vector3d::Zero();
+  drag_arm_B.head<2>() = rotor_positions_.matrix() * rot_vels.abs().matrix();
+
+  Eigen::Vector3d moment_B;
+  moment_B.x() = (rotor_positions_.row(1) * thrusts_.transpose()).sum();
+  moment_B.y() = -(rotor_positions_.row(0) * thrusts_.transpose()).sum();
+  moment_B.z() = (yaw_moment_constants_ * thrusts_).sum();
+  moment_B -= params_.rotor_drag_coefficient * drag_arm_B.cross(air_velocity_B);
+  moment_B -= params_.rolling_moment_coefficient * total_speed * air_velocity_B;
+  moment_B += external_moment_B_;
+
+  // Semi-implicit Euler: velocities first, then positions with the new velocities.
+  const Eigen::Vector3d acceleration_W =
+      (R_W_B * force_B + external_force_W_) / params_.vehicle.mass_
+      - Eigen::Vector3d(0.0, 0.0, params_.vehicle.gravity_);
+  const Eigen::Vector3d inertia_angular_rate =
+      params_.vehicle.inertia_ * angular_rate_;
+  const Eigen::Vector3d angular_acceleration_B =
+      inertia_inverse_ * (moment_B - angular_rate_.cross(inertia_angular_rate));
+
+  velocity_ += acceleration_W * dt;
+  angular_rate_ += angular_acceleration_B * dt;
+  position_ += velocity_ * dt;
+
+  const Eigen::Vector3d rotation_B = angular_rate_ * dt;
+  const double rotation_angle = rotation_B.norm();
+  if (rotation_angle > 0.0) {
+    attitude_ = attitude_ * Eigen::Quaterniond(
+        Eigen::AngleAxisd(rotation_angle, rotation_B / rotation_angle));
+    attitude_.normalize();
+  }
+
+  // The ground stops the vehicle until the thrust lifts it off again. A
+  // landed vehicle stands level on its legs, only its yaw is kept.
+  on_ground_ = false;
+  if (params_.enable_ground && position_.z() <= params_.ground_height) {
+    position_.z() = params_.ground_height;
+    if (velocity_.z() <= 0.0) {
+      const Eigen::Vector3d heading = R_W_B.col(0);
+      attitude_ = Eigen::AngleAxisd(std::atan2(heading.y(), heading.x()),
+                                    Eigen::Vector3d::UnitZ());
+      velocity_.setZero();
+      angular_rate_.setZero();
+      on_ground_ = true;
+    }
+  }
+
+  time_ += dt;
+}
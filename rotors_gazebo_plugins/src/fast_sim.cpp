@@ -0,0 +1,206 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/fast_sim.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#include <yaml-cpp/yaml.h>
+
+bool LoadVehicleParametersYAML(const std::string& yaml_path,
+                               rotors_control::VehicleParameters* vehicle_parameters) {
+  assert(vehicle_parameters != nullptr);
+  try {
+    const YAML::Node node = YAML::LoadFile(yaml_path);
+
+    vehicle_parameters->mass_ = node["mass"].as<double>();
+    const YAML::Node inertia = node["inertia"];
+    vehicle_parameters->inertia_ <<
+        inertia["xx"].as<double>(), inertia["xy"].as<double>(), inertia["xz"].as<double>(),
+        inertia["xy"].as<double>(), inertia["yy"].as<double>(), inertia["yz"].as<double>(),
+        inertia["xz"].as<double>(), inertia["yz"].as<double>(), inertia["zz"].as<double>();
+
+    // The rotors are numbered from 0, in the order of the allocation matrix.
+    const YAML::Node rotor_configuration = node["rotor_configuration"];
+    std::vector<rotors_control::Rotor> rotors;
+    for (int i = 0; rotor_configuration[std::to_string(i)]; ++i) {
+      const YAML::Node rotor_node = rotor_configuration[std::to_string(i)];
+      rotors_control::Rotor rotor;
+      rotor.angle = rotor_node["angle"].as<double>();
+      rotor.arm_length = rotor_node["arm_length"].as<double>();
+      rotor.rotor_force_constant = rotor_node["rotor_force_constant"].as<double>();
+      rotor.rotor_moment_constant = rotor_node["rotor_moment_constant"].as<double>();
+      rotor.direction = rotor_node["direction"].as<double>();
+      rotors.push_back(rotor);
+    }
+    if (rotors.empty()) {
+      std::cerr << "No rotor_configuration in '" << yaml_path << "'.\n";
+      return false;
+    }
+    vehicle_parameters->rotor_configuration_.rotors = rotors;
+  } catch (const YAML::Exception& e) {
+    std::cerr << "Could not read vehicle parameters from '" << yaml_path
+              << "': " << e.what() << "\n";
+    return false;
+  }
+  return true;
+}
+
+bool LoadLeeControllerParametersYAML(
+    const std::string& yaml_path,
+    rotors_control::LeePositionControllerParameters* controller_parameters) {
+  assert(controller_parameters != nullptr);
+  const auto read_gain = [](const YAML::Node& node, Eigen::Vector3d* gain) {
+    *gain << node["x"].as<double>(), node["y"].as<double>(), node["z"].as<double>();
+  };
+  try {
+    const YAML::Node node = YAML::LoadFile(yaml_path);
+    read_gain(node["position_gain"], &controller_parameters->position_gain_);
+    read_gain(node["velocity_gain"], &controller_parameters->velocity_gain_);
+    read_gain(node["attitude_gain"], &controller_parameters->attitude_gain_);
+    read_gain(node["angular_rate_gain"], &controller_parameters->angular_rate_gain_);
+  } catch (const YAML::Exception& e) {
+    std::cerr << "Could not read controller parameters from '" << yaml_path
+              << "': " << e.what() << "\n";
+    return false;
+  }
+  return true;
+}
+
+bool ReadWaypointFile(const std::string& path, FastSimWaypoints* waypoints) {
+  assert(waypoints != nullptr);
+  std::ifstream wp_file(path.c_str());
+  if (!wp_file.is_open()) {
+    std::cerr << "Unable to open waypoint file '" << path << "'.\n";
+    return false;
+  }
+
+  waypoints->clear();
+  double t, x, y, z, yaw;
+  while (wp_file >> t >> x >> y >> z >> yaw) {
+    waypoints->push_back(
+        FastSimWaypoint(t, Eigen::Vector3d(x, y, z), yaw * M_PI / 180.0));
+  }
+  return !waypoints->empty();
+}
+
+FastSimFlightResult FlyWaypoints(const FastSimWaypoints& waypoints,
+                                 const FastSimFlightOptions& options,
+                                 FastMultiCopter* multi_copter,
+                                 LeeMotorController* motor_controller,
+                                 FastSimTrajectory* trajectory) {
+  assert(multi_copter != nullptr);
+  assert(motor_controller != nullptr);
+  assert(options.physics_step > 0.0);
+
+  FastSimFlightResult result;
+  multi_copter->setMotorController(motor_controller);
+  multi_copter->reset(options.start_position, Eigen::Quaterniond::Identity());
+  multi_copter->setWindSpeed(options.wind_speed_W);
+
+  const double dt = options.physics_step;
+  const int control_divisor =
+      std::max(1, static_cast<int>(std::round(options.control_period / dt)));
+
+  if (trajectory != nullptr) {
+    trajectory->clear();
+    double flight_time = 0.0;
+    for (const FastSimWaypoint& waypoint : waypoints)
+      flight_time += waypoint.waiting_time;
+    const size_t num_samples = flight_time / (control_divisor * dt) + 1;
+    trajectory->time.reserve(num_samples);
+    trajectory->position.reserve(num_samples);
+    trajectory->angular_velocity.reserve(num_samples);
+    trajectory->on_ground.reserve(num_samples);
+  }
+
+  double squared_error_sum = 0.0;
+  uint64_t num_steps = 0;
+  Eigen::VectorXd ref_rotor_velocities =
+      Eigen::VectorXd::Zero(multi_copter->getMotorVelocities().size());
+
+  const auto wall_start = std::chrono::steady_clock::now();
+  for (const FastSimWaypoint& waypoint : waypoints) {
+    mav_msgs::EigenTrajectoryPoint trajectory_point;
+    trajectory_point.position_W = waypoint.position;
+    trajectory_point.setFromYaw(waypoint.yaw);
+    motor_controller->setTrajectoryPoint(trajectory_point);
+    if (trajectory != nullptr)
+      trajectory->waypoint_start_time.push_back(multi_copter->time());
+
+    const uint64_t waypoint_steps =
+        static_cast<uint64_t>(std::round(waypoint.waiting_time / dt));
+    for (uint64_t i = 0; i < waypoint_steps; ++i, ++num_steps) {
+      if (num_steps % control_divisor == 0) {
+        if (!options.disturbances.empty()) {
+          // The disturbances change at the control rate, they are held
+          // for whole control periods.
+          Eigen::Vector3d force_W = Eigen::Vector3d::Zero();
+          Eigen::Vector3d moment_B = Eigen::Vector3d::Zero();
+          const double time = multi_copter->time();
+          for (const FastSimDisturbance& disturbance : options.disturbances) {
+            if (time >= disturbance.start_time &&
+                time < disturbance.start_time + disturbance.duration) {
+              force_W += disturbance.force_W;
+              moment_B += disturbance.moment_B;
+            }
+          }
+          multi_copter->setExternalWrench(force_W, moment_B);
+        }
+        if (trajectory != nullptr) {
+          trajectory->time.push_back(multi_copter->time());
+          trajectory->position.push_back(multi_copter->position());
+          trajectory->angular_velocity.push_back(multi_copter->angularRate());
+          trajectory->on_ground.push_back(multi_copter->onGround());
+        }
+        ref_rotor_velocities = multi_copter->getRefMotorVelocities(control_divisor * dt);
+      }
+      multi_copter->simulateMAV(dt, ref_rotor_velocities);
+
+      if (!multi_copter->position().allFinite() ||
+          !multi_copter->attitude().coeffs().allFinite()) {
+        result.diverged = true;
+        break;
+      }
+      const double error = (multi_copter->position() - waypoint.position).norm();
+      squared_error_sum += error * error;
+      result.max_position_error = std::max(result.max_position_error, error);
+      result.final_position_error = error;
+    }
+    if (result.diverged)
+      break;
+  }
+  const auto wall_end = std::chrono::steady_clock::now();
+
+  result.sim_time = multi_copter->time();
+  result.wall_time = std::chrono::duration<double>(wall_end - wall_start).count();
+  if (num_steps > 0)
+    result.rms_position_error = std::sqrt(squared_error_sum / num_steps);
+  if (result.diverged) {
+    result.max_position_error = std::numeric_limits<double>::infinity();
+    result.final_position_error = std::numeric_limits<double>::infinity();
+  }
+  return result;
+}
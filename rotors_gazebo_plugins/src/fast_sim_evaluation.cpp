@@ -0,0 +1,270 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/fast_sim_evaluation.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const double kSettlingTimeScores[4] = {0.0, 1.5, 3.5, 5.0};
+const double kPositionErrorScores[4] = {0.0, 1.5, 3.5, 5.0};
+const double kAngularVelocityErrorScores[4] = {0.0, 1.0, 2.0, 3.0};
+
+// Begin and end of the period in which a waypoint is active.
+void WaypointPeriod(const FastSimTrajectory& trajectory, size_t index,
+                    double* begin_time, double* end_time) {
+  *begin_time = trajectory.waypoint_start_time[index];
+  if (index + 1 < trajectory.waypoint_start_time.size())
+    *end_time = trajectory.waypoint_start_time[index + 1];
+  else
+    *end_time = trajectory.time.empty() ? *begin_time : trajectory.time.back();
+}
+
+// Errors from the settling time on, or 101 % of the maximum values as in
+// waypoints_eval.py if the vehicle does not settle in time.
+void EvaluateSettling(const FastSimTrajectory& trajectory, double begin_time,
+                      double end_time, const Eigen::Vector3d& set_point,
+                      const FastSimEvaluationSettings& settings,
+                      FastSimEvaluation* evaluation, double* rms_end_time) {
+  double settling_time;
+  *rms_end_time = std::min(begin_time + settings.rms_calc_time, end_time);
+  evaluation->settled =
+      SettlingTime(trajectory, begin_time, end_time, set_point,
+                   settings.settling_radius, settings.min_settled_time,
+                   &settling_time) &&
+      settling_time < settings.settling_time_max;
+  if (evaluation->settled) {
+    const double rms_begin_time = begin_time + settling_time;
+    *rms_end_time = std::min(rms_begin_time + settings.rms_calc_time, end_time);
+    evaluation->settling_time = settling_time;
+    evaluation->position_rms_error = RmsError(
+        trajectory.time, trajectory.position, rms_begin_time, *rms_end_time,
+        set_point);
+    evaluation->angular_velocity_rms_error = RmsError(
+        trajectory.time, trajectory.angular_velocity, rms_begin_time,
+        *rms_end_time, Eigen::Vector3d::Zero());
+  } else {
+    evaluation->settling_time = 1.01 * settings.settling_time_max;
+    evaluation->position_rms_error = 1.01 * settings.position_error_max;
+    evaluation->angular_velocity_rms_error =
+        1.01 * settings.angular_velocity_error_max;
+  }
+}
+
+void ScoreSettling(const FastSimEvaluationSettings& settings,
+                   FastSimEvaluation* evaluation) {
+  evaluation->score =
+      EvaluationScore(evaluation->settling_time, settings.settling_time_max,
+                      kSettlingTimeScores) +
+      EvaluationScore(evaluation->position_rms_error,
+                      settings.position_error_max, kPositionErrorScores) +
+      EvaluationScore(evaluation->angular_velocity_rms_error,
+                      settings.angular_velocity_error_max,
+                      kAngularVelocityErrorScores);
+}
+
+}  // namespace
+
+double EvaluationScore(double value, double max_value, const double (&scores)[4]) {
+  if (value > max_value)
+    return scores[0];
+  else if (value > 0.5 * max_value)
+    return scores[1];
+  else if (value > 0.1 * max_value)
+    return scores[2];
+  return scores[3];
+}
+
+bool SettlingTime(const FastSimTrajectory& trajectory, double begin_time,
+                  double end_time, const Eigen::Vector3d& set_point,
+                  double radius, double min_time, double* settling_time) {
+  assert(settling_time != nullptr);
+  bool bounded = false;
+  double bounded_time = 0.0;
+  double first_time = 0.0;
+  bool first = true;
+  for (size_t i = 0; i < trajectory.time.size(); ++i) {
+    const double time = trajectory.time[i];
+    if (time < begin_time)
+      continue;
+    if (time > end_time)
+      break;
+    if (first) {
+      first_time = time;
+      first = false;
+    }
+    if ((trajectory.position[i] - set_point).norm() <= radius) {
+      if (!bounded) {
+        bounded = true;
+        bounded_time = time;
+      } else if (time - bounded_time >= min_time) {
+        *settling_time = bounded_time - first_time;
+        return true;
+      }
+    } else {
+      bounded = false;
+    }
+  }
+  return false;
+}
+
+double RmsError(const std::vector<double>& time,
+                const FastSimVector3dSeries& samples, double begin_time,
+                double end_time, const Eigen::Vector3d& set_point) {
+  assert(time.size() == samples.size());
+  double sum_of_squares = 0.0;
+  size_t num_samples = 0;
+  for (size_t i = 0; i < time.size(); ++i) {
+    if (time[i] < begin_time)
+      continue;
+    if (time[i] > end_time)
+      break;
+    sum_of_squares += (samples[i] - set_point).squaredNorm();
+    ++num_samples;
+  }
+  return num_samples > 0 ? std::sqrt(sum_of_squares / num_samples) : 0.0;
+}
+
+bool NoCollisions(const FastSimTrajectory& trajectory, double begin_time,
+                  double end_time) {
+  for (size_t i = 0; i < trajectory.time.size(); ++i) {
+    if (trajectory.time[i] < begin_time)
+      continue;
+    if (trajectory.time[i] > end_time)
+      break;
+    if (trajectory.on_ground[i])
+      return false;
+  }
+  return true;
+}
+
+FastSimEvaluation EvaluateHovering(const FastSimTrajectory& trajectory,
+                                   const FastSimWaypoints& waypoints,
+                                   const FastSimEvaluationSettings& settings) {
+  FastSimEvaluation evaluation;
+  if (trajectory.waypoint_start_time.empty())
+    return evaluation;
+
+  double begin_time, end_time;
+  WaypointPeriod(trajectory, 0, &begin_time, &end_time);
+  begin_time += settings.first_waypoint_evaluation_delay;
+  const double rms_end_time = std::min(begin_time + settings.rms_calc_time, end_time);
+
+  evaluation.settled = true;
+  evaluation.position_rms_error = RmsError(
+      trajectory.time, trajectory.position, begin_time, rms_end_time,
+      waypoints[0].position);
+  evaluation.angular_velocity_rms_error = RmsError(
+      trajectory.time, trajectory.angular_velocity, begin_time, rms_end_time,
+      Eigen::Vector3d::Zero());
+
+  evaluation.valid = NoCollisions(trajectory, begin_time, rms_end_time);
+  if (evaluation.valid) {
+    evaluation.score =
+        EvaluationScore(evaluation.position_rms_error,
+                        settings.position_error_max, kPositionErrorScores) +
+        EvaluationScore(evaluation.angular_velocity_rms_error,
+                        settings.angular_velocity_error_max,
+                        kAngularVelocityErrorScores);
+  }
+  return evaluation;
+}
+
+FastSimEvaluation EvaluateWaypoints(const FastSimTrajectory& trajectory,
+                                    const FastSimWaypoints& waypoints,
+                                    const FastSimEvaluationSettings& settings) {
+  FastSimEvaluation evaluation;
+  const size_t num_waypoints = trajectory.waypoint_start_time.size();
+  if (num_waypoints == 0)
+    return evaluation;
+
+  double first_begin_time = 0.0;
+  double rms_end_time = 0.0;
+  double settling_time_sum = 0.0;
+  double position_rms_sum = 0.0;
+  double angular_velocity_rms_sum = 0.0;
+  size_t num_settling_times = 0;
+  evaluation.settled = true;
+  for (size_t i = 0; i < num_waypoints; ++i) {
+    double begin_time, end_time;
+    WaypointPeriod(trajectory, i, &begin_time, &end_time);
+    const Eigen::Vector3d& set_point = waypoints[i].position;
+
+    // The vehicle most likely still stands on the ground when the first
+    // waypoint is commanded, its settling time is not considered.
+    if (i == 0) {
+      begin_time += settings.first_waypoint_evaluation_delay;
+      first_begin_time = begin_time;
+      rms_end_time = std::min(begin_time + settings.rms_calc_time, end_time);
+      position_rms_sum += RmsError(trajectory.time, trajectory.position,
+                                   begin_time, rms_end_time, set_point);
+      angular_velocity_rms_sum += RmsError(
+          trajectory.time, trajectory.angular_velocity, begin_time,
+          rms_end_time, Eigen::Vector3d::Zero());
+      continue;
+    }
+
+    FastSimEvaluation waypoint_evaluation;
+    EvaluateSettling(trajectory, begin_time, end_time, set_point, settings,
+                     &waypoint_evaluation, &rms_end_time);
+    evaluation.settled = evaluation.settled && waypoint_evaluation.settled;
+    settling_time_sum += waypoint_evaluation.settling_time;
+    position_rms_sum += waypoint_evaluation.position_rms_error;
+    angular_velocity_rms_sum += waypoint_evaluation.angular_velocity_rms_error;
+    ++num_settling_times;
+  }
+
+  evaluation.settling_time =
+      num_settling_times > 0 ? settling_time_sum / num_settling_times : 0.0;
+  evaluation.position_rms_error = position_rms_sum / num_waypoints;
+  evaluation.angular_velocity_rms_error = angular_velocity_rms_sum / num_waypoints;
+
+  evaluation.valid = NoCollisions(trajectory, first_begin_time, rms_end_time);
+  if (evaluation.valid)
+    ScoreSettling(settings, &evaluation);
+  return evaluation;
+}
+
+FastSimEvaluation EvaluateDisturbance(const FastSimTrajectory& trajectory,
+                                      const FastSimWaypoints& waypoints,
+                                      const FastSimEvaluationSettings& settings) {
+  FastSimEvaluation evaluation;
+  if (trajectory.waypoint_start_time.empty())
+    return evaluation;
+
+  double begin_time, end_time;
+  WaypointPeriod(trajectory, 0, &begin_time, &end_time);
+  const double collision_begin_time =
+      begin_time + settings.first_waypoint_evaluation_delay;
+
+  double rms_end_time;
+  EvaluateSettling(trajectory, settings.disturbance_time, end_time,
+                   waypoints[0].position, settings, &evaluation, &rms_end_time);
+
+  // The scripts do not score a vehicle that does not settle after the
+  // disturbance.
+  evaluation.valid = evaluation.settled &&
+      NoCollisions(trajectory, collision_begin_time, rms_end_time);
+  if (evaluation.valid)
+    ScoreSettling(settings, &evaluation);
+  return evaluation;
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Flies a multicopter with the Lee position controller in the fast simulator,
+// without Gazebo, and prints the tracking errors and the real time factor.
+// Fails if the vehicle diverges or ends further than max_final_error from the
+// last waypoint, so that it can be used for regression flights.
+//
+// Usage: fast_sim_flight <vehicle.yaml> <lee_controller.yaml> [options]
+//   --waypoints <file>         waypoint_publisher_file format, default hover at 1 m
+//   --physics-step <s>         default 0.001
+//   --control-rate <Hz>        default 100
+//   --repeat <n>               fly the waypoints n times, default 1
+//   --max-final-error <m>      default 0.1
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "rotors_gazebo_plugins/fast_sim.h"
+
+static constexpr double kDefaultMaxFinalError = 0.1;
+static constexpr double kDefaultHoverHeight = 1.0;
+static constexpr double kDefaultHoverTime = 10.0;
+
+int main(int argc, char** argv) {
+  if (argc < 3 || (argc - 3) % 2 != 0) {
+    std::cerr << "Usage: " << argv[0] << " <vehicle.yaml> <lee_controller.yaml>"
+              << " [--waypoints <file>] [--physics-step <s>] [--control-rate <Hz>]"
+              << " [--repeat <n>] [--max-final-error <m>]\n";
+    return EXIT_FAILURE;
+  }
+
+  FastMultiCopterParameters vehicle_params;
+  rotors_control::LeePositionControllerParameters controller_params;
+  if (!LoadVehicleParametersYAML(argv[1], &vehicle_params.vehicle) ||
+      !LoadLeeControllerParametersYAML(argv[2], &controller_params)) {
+    return EXIT_FAILURE;
+  }
+
+  FastSimFlightOptions options;
+  FastSimWaypoints waypoints;
+  int repeat = 1;
+  double max_final_error = kDefaultMaxFinalError;
+  for (int i = 3; i < argc; i += 2) {
+    const std::string option = argv[i];
+    const char* value = argv[i + 1];
+    if (option == "--waypoints") {
+      if (!ReadWaypointFile(value, &waypoints))
+        return EXIT_FAILURE;
+    } else if (option == "--physics-step") {
+      options.physics_step = std::atof(value);
+    } else if (option == "--control-rate") {
+      options.control_period = 1.0 / std::atof(value);
+    } else if (option == "--repeat") {
+      repeat = std::atoi(value);
+    } else if (option == "--max-final-error") {
+      max_final_error = std::atof(value);
+    } else {
+      std::cerr << "Unknown option '" << option << "'.\n";
+      return EXIT_FAILURE;
+    }
+  }
+  if (!(options.physics_step > 0.0) || !(options.control_period > 0.0) || repeat < 1) {
+    std::cerr << "Physics step, control rate and repeat must be positive.\n";
+    return EXIT_FAILURE;
+  }
+  if (waypoints.empty()) {
+    waypoints.push_back(FastSimWaypoint(
+        kDefaultHoverTime, Eigen::Vector3d(0.0, 0.0, kDefaultHoverHeight), 0.0));
+  }
+
+  LeeMotorController motor_controller(vehicle_params.vehicle, controller_params);
+  FastMultiCopter multi_copter(vehicle_params, &motor_controller);
+
+  FastSimFlightResult result;
+  double sim_time = 0.0;
+  double wall_time = 0.0;
+  for (int i = 0; i < repeat; ++i) {
+    result = FlyWaypoints(waypoints, options, &multi_copter, &motor_controller);
+    sim_time += result.sim_time;
+    wall_time += result.wall_time;
+    if (result.diverged)
+      break;
+  }
+
+  std::cout << "Flew " << sim_time << " s in " << wall_time << " s, real time factor "
+            << (wall_time > 0.0 ? sim_time / wall_time : 0.0) << ".\n"
+            << "Position error: rms " << result.rms_position_error
+            << " m, max " << result.max_position_error
+            << " m, final " << result.final_position_error << " m.\n";
+
+  if (result.diverged) {
+    std::cerr << "The vehicle diverged.\n";
+    return EXIT_FAILURE;
+  }
+  if (result.final_position_error > max_final_error) {
+    std::cerr << "Final position error exceeds " << max_final_error << " m.\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
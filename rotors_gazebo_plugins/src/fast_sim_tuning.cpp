@@ -0,0 +1,360 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Sweeps the gains of the Lee position controller in the fast simulator and
+// scores every combination with the hovering, waypoint and disturbance
+// evaluations of rotors_evaluation, averaged over Monte-Carlo runs with
+// random disturbances and wind. The runs are spread over all cores and the
+// results are written as one CSV row per gain combination.
+//
+// Usage: fast_sim_tuning <vehicle.yaml> <lee_controller.yaml> <sweep.yaml>
+//                        <results.csv> [num_threads]
+//
+// The sweep file lists scales applied to all axes of each gain of the
+// controller file, the combinations are their cartesian product. All entries
+// are optional, see rotors_gazebo/resource/fast_sim_tuning_firefly.yaml.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#include "rotors_gazebo_plugins/fast_sim.h"
+#include "rotors_gazebo_plugins/fast_sim_evaluation.h"
+
+static constexpr int kDefaultSeeds = 8;
+static constexpr double kDefaultHoverHeight = 1.0;
+static constexpr double kDefaultWaypointTime = 20.0;
+static constexpr double kDefaultDisturbanceForce = 5.0;
+static constexpr double kDefaultDisturbanceDuration = 0.5;
+static constexpr double kDefaultWindSpeedSigma = 0.0;
+
+struct SweepSettings {
+  SweepSettings()
+      : seeds(kDefaultSeeds),
+        first_seed(0),
+        disturbance_force(kDefaultDisturbanceForce),
+        disturbance_duration(kDefaultDisturbanceDuration),
+        wind_speed_sigma(kDefaultWindSpeedSigma),
+        position_gain_scales(1, 1.0),
+        velocity_gain_scales(1, 1.0),
+        attitude_gain_scales(1, 1.0),
+        angular_rate_gain_scales(1, 1.0) {}
+
+  int seeds;
+  int first_seed;
+  /// \brief  Maximum force [N] of the disturbance, in a random horizontal
+  ///         direction with a random magnitude of 50 to 100 % of it.
+  double disturbance_force;
+  double disturbance_duration;
+  /// \brief  Standard deviation of the constant wind per axis [m/s].
+  double wind_speed_sigma;
+  std::vector<double> position_gain_scales;
+  std::vector<double> velocity_gain_scales;
+  std::vector<double> attitude_gain_scales;
+  std::vector<double> angular_rate_gain_scales;
+  FastSimWaypoints waypoints;
+  FastSimFlightOptions flight_options;
+  FastSimEvaluationSettings evaluation_settings;
+};
+
+// Scales of one gain combination.
+struct GainScales {
+  double position;
+  double velocity;
+  double attitude;
+  double angular_rate;
+};
+
+// Evaluations of one Monte-Carlo run of a gain combination.
+struct RunResult {
+  FastSimEvaluation hovering;
+  FastSimEvaluation waypoints;
+  FastSimEvaluation disturbance;
+};
+
+template <typename T>
+void ReadOptional(const YAML::Node& node, const std::string& name, T* value) {
+  if (node[name])
+    *value = node[name].as<T>();
+}
+
+bool LoadSweepYAML(const std::string& yaml_path, SweepSettings* settings) {
+  try {
+    const YAML::Node node = YAML::LoadFile(yaml_path);
+    ReadOptional(node, "seeds", &settings->seeds);
+    ReadOptional(node, "first_seed", &settings->first_seed);
+    ReadOptional(node, "disturbance_force", &settings->disturbance_force);
+    ReadOptional(node, "disturbance_duration", &settings->disturbance_duration);
+    ReadOptional(node, "wind_speed_sigma", &settings->wind_speed_sigma);
+    ReadOptional(node, "position_gain_scales", &settings->position_gain_scales);
+    ReadOptional(node, "velocity_gain_scales", &settings->velocity_gain_scales);
+    ReadOptional(node, "attitude_gain_scales", &settings->attitude_gain_scales);
+    ReadOptional(node, "angular_rate_gain_scales", &settings->angular_rate_gain_scales);
+    ReadOptional(node, "physics_step", &settings->flight_options.physics_step);
+    if (node["control_rate"])
+      settings->flight_options.control_period = 1.0 / node["control_rate"].as<double>();
+
+    FastSimEvaluationSettings& evaluation = settings->evaluation_settings;
+    ReadOptional(node, "first_waypoint_evaluation_delay",
+                 &evaluation.first_waypoint_evaluation_delay);
+    ReadOptional(node, "rms_calc_time", &evaluation.rms_calc_time);
+    ReadOptional(node, "settling_radius", &evaluation.settling_radius);
+    ReadOptional(node, "min_settled_time", &evaluation.min_settled_time);
+    ReadOptional(node, "disturbance_time", &evaluation.disturbance_time);
+
+    std::string waypoint_file;
+    ReadOptional(node, "waypoints", &waypoint_file);
+    if (!waypoint_file.empty() && !ReadWaypointFile(waypoint_file, &settings->waypoints))
+      return false;
+  } catch (const YAML::Exception& e) {
+    std::cerr << "Could not read the sweep from '" << yaml_path << "': "
+              << e.what() << "\n";
+    return false;
+  }
+
+  if (settings->seeds < 1 || settings->position_gain_scales.empty() ||
+      settings->velocity_gain_scales.empty() ||
+      settings->attitude_gain_scales.empty() ||
+      settings->angular_rate_gain_scales.empty() ||
+      !(settings->flight_options.physics_step > 0.0) ||
+      !(settings->flight_options.control_period > 0.0)) {
+    std::cerr << "The sweep needs at least one seed and one scale per gain,"
+              << " and positive step sizes.\n";
+    return false;
+  }
+
+  if (settings->waypoints.empty()) {
+    const double t = kDefaultWaypointTime;
+    settings->waypoints.push_back(FastSimWaypoint(t, Eigen::Vector3d(0, 0, 1), 0.0));
+    settings->waypoints.push_back(FastSimWaypoint(t, Eigen::Vector3d(1, 0, 1), 0.0));
+    settings->waypoints.push_back(FastSimWaypoint(t, Eigen::Vector3d(1, 1, 2), M_PI / 2.0));
+    settings->waypoints.push_back(FastSimWaypoint(t, Eigen::Vector3d(0, 1, 1), M_PI / 2.0));
+    settings->waypoints.push_back(FastSimWaypoint(t, Eigen::Vector3d(0, 0, 1), 0.0));
+  }
+  return true;
+}
+
+// Flies the three scenarios of the evaluation scripts with the given gains.
+RunResult EvaluateRun(const FastMultiCopterParameters& vehicle_params,
+                      const rotors_control::LeePositionControllerParameters& base_params,
+                      const SweepSettings& settings, const GainScales& scales,
+                      int seed, FastSimTrajectory* trajectory) {
+  rotors_control::LeePositionControllerParameters controller_params = base_params;
+  controller_params.position_gain_ *= scales.position;
+  controller_params.velocity_gain_ *= scales.velocity;
+  controller_params.attitude_gain_ *= scales.attitude;
+  controller_params.angular_rate_gain_ *= scales.angular_rate;
+
+  LeeMotorController motor_controller(vehicle_params.vehicle, controller_params);
+  FastMultiCopter multi_copter(vehicle_params, &motor_controller);
+  const FastSimEvaluationSettings& evaluation_settings = settings.evaluation_settings;
+
+  std::mt19937 random_generator(seed);
+  std::normal_distribution<double> wind_distribution(0.0, 1.0);
+  std::uniform_real_distribution<double> uniform_distribution(0.0, 1.0);
+  FastSimFlightOptions options = settings.flight_options;
+  options.wind_speed_W << wind_distribution(random_generator),
+                          wind_distribution(random_generator),
+                          wind_distribution(random_generator);
+  options.wind_speed_W *= settings.wind_speed_sigma;
+
+  RunResult result;
+  const Eigen::Vector3d hover_position(0.0, 0.0, kDefaultHoverHeight);
+
+  FastSimWaypoints hovering(1, FastSimWaypoint(
+      evaluation_settings.first_waypoint_evaluation_delay +
+      evaluation_settings.rms_calc_time, hover_position, 0.0));
+  FlyWaypoints(hovering, options, &multi_copter, &motor_controller, trajectory);
+  result.hovering = EvaluateHovering(*trajectory, hovering, evaluation_settings);
+
+  FlyWaypoints(settings.waypoints, options, &multi_copter, &motor_controller, trajectory);
+  result.waypoints = EvaluateWaypoints(*trajectory, settings.waypoints, evaluation_settings);
+
+  FastSimDisturbance disturbance;
+  const double direction = 2.0 * M_PI * uniform_distribution(random_generator);
+  const double magnitude = settings.disturbance_force *
+      (0.5 + 0.5 * uniform_distribution(random_generator));
+  disturbance.start_time = evaluation_settings.disturbance_time;
+  disturbance.duration = settings.disturbance_duration;
+  disturbance.force_W << magnitude * std::cos(direction),
+                         magnitude * std::sin(direction), 0.0;
+  options.disturbances.push_back(disturbance);
+  FastSimWaypoints disturbed(1, FastSimWaypoint(
+      evaluation_settings.disturbance_time + evaluation_settings.settling_time_max +
+      evaluation_settings.rms_calc_time, hover_position, 0.0));
+  FlyWaypoints(disturbed, options, &multi_copter, &motor_controller, trajectory);
+  result.disturbance = EvaluateDisturbance(*trajectory, disturbed, evaluation_settings);
+  return result;
+}
+
+// Mean of a value over the runs, and the count of valid runs.
+struct Aggregate {
+  Aggregate() : valid(0), settling_time(0.0), settling_time_max(0.0),
+                position_rms_error(0.0), angular_velocity_rms_error(0.0),
+                score(0.0), score_min(std::numeric_limits<double>::max()) {}
+
+  void Add(const FastSimEvaluation& evaluation, int num_runs) {
+    valid += evaluation.valid;
+    settling_time += evaluation.settling_time / num_runs;
+    settling_time_max = std::max(settling_time_max, evaluation.settling_time);
+    position_rms_error += evaluation.position_rms_error / num_runs;
+    angular_velocity_rms_error += evaluation.angular_velocity_rms_error / num_runs;
+    score += evaluation.score / num_runs;
+    score_min = std::min(score_min, evaluation.score);
+  }
+
+  int valid;
+  double settling_time;
+  double settling_time_max;
+  double position_rms_error;
+  double angular_velocity_rms_error;
+  double score;
+  double score_min;
+};
+
+int main(int argc, char** argv) {
+  if (argc < 5 || argc > 6) {
+    std::cerr << "Usage: " << argv[0] << " <vehicle.yaml> <lee_controller.yaml>"
+              << " <sweep.yaml> <results.csv> [num_threads]\n";
+    return EXIT_FAILURE;
+  }
+
+  FastMultiCopterParameters vehicle_params;
+  rotors_control::LeePositionControllerParameters controller_params;
+  SweepSettings settings;
+  if (!LoadVehicleParametersYAML(argv[1], &vehicle_params.vehicle) ||
+      !LoadLeeControllerParametersYAML(argv[2], &controller_params) ||
+      !LoadSweepYAML(argv[3], &settings)) {
+    return EXIT_FAILURE;
+  }
+
+  int num_threads = std::max(1u, std::thread::hardware_concurrency());
+  if (argc == 6) {
+    num_threads = std::atoi(argv[5]);
+    if (num_threads <= 0) {
+      std::cerr << "Number of threads must be a positive integer.\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::vector<GainScales> combinations;
+  for (double position : settings.position_gain_scales)
+    for (double velocity : settings.velocity_gain_scales)
+      for (double attitude : settings.attitude_gain_scales)
+        for (double angular_rate : settings.angular_rate_gain_scales)
+          combinations.push_back(GainScales{position, velocity, attitude, angular_rate});
+
+  // One job per run, so that the cores stay busy when there are fewer
+  // combinations than cores. The results do not depend on the scheduling.
+  const int num_runs = settings.seeds;
+  const size_t num_jobs = combinations.size() * num_runs;
+  std::vector<RunResult> results(num_jobs);
+  std::atomic<size_t> next_job(0);
+
+  const auto wall_start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int thread = 0; thread < num_threads; ++thread) {
+    workers.emplace_back([&]() {
+      FastSimTrajectory trajectory;
+      for (size_t job = next_job++; job < num_jobs; job = next_job++) {
+        results[job] = EvaluateRun(vehicle_params, controller_params, settings,
+                                   combinations[job / num_runs],
+                                   settings.first_seed + job % num_runs,
+                                   &trajectory);
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  const double wall_time = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - wall_start).count();
+
+  std::ofstream output(argv[4]);
+  if (!output.is_open()) {
+    std::cerr << "Could not write results to '" << argv[4] << "'.\n";
+    return EXIT_FAILURE;
+  }
+  output << "position_gain_scale,velocity_gain_scale,attitude_gain_scale,"
+         << "angular_rate_gain_scale,runs,"
+         << "hover_valid,hover_position_rms,hover_angular_velocity_rms,"
+         << "waypoints_valid,waypoints_settling_time,waypoints_position_rms,"
+         << "waypoints_angular_velocity_rms,"
+         << "disturbance_valid,disturbance_settling_time,"
+         << "disturbance_settling_time_max,disturbance_position_rms,"
+         << "disturbance_angular_velocity_rms,score,score_min\n";
+  output << std::setprecision(6);
+
+  size_t best = 0;
+  double best_score = -1.0;
+  for (size_t i = 0; i < combinations.size(); ++i) {
+    Aggregate hovering, waypoints, disturbance;
+    double score_min = std::numeric_limits<double>::max();
+    for (int run = 0; run < num_runs; ++run) {
+      const RunResult& result = results[i * num_runs + run];
+      hovering.Add(result.hovering, num_runs);
+      waypoints.Add(result.waypoints, num_runs);
+      disturbance.Add(result.disturbance, num_runs);
+      score_min = std::min(score_min, result.hovering.score +
+                           result.waypoints.score + result.disturbance.score);
+    }
+    const double score = hovering.score + waypoints.score + disturbance.score;
+    if (score > best_score) {
+      best_score = score;
+      best = i;
+    }
+
+    const GainScales& scales = combinations[i];
+    output << scales.position << "," << scales.velocity << ","
+           << scales.attitude << "," << scales.angular_rate << "," << num_runs << ","
+           << hovering.valid << "," << hovering.position_rms_error << ","
+           << hovering.angular_velocity_rms_error << ","
+           << waypoints.valid << "," << waypoints.settling_time << ","
+           << waypoints.position_rms_error << ","
+           << waypoints.angular_velocity_rms_error << ","
+           << disturbance.valid << "," << disturbance.settling_time << ","
+           << disturbance.settling_time_max << ","
+           << disturbance.position_rms_error << ","
+           << disturbance.angular_velocity_rms_error << ","
+           << score << "," << score_min << "\n";
+  }
+
+  const GainScales& scales = combinations[best];
+  std::cout << "Evaluated " << combinations.size() << " gain combinations with "
+            << num_runs << " runs each on " << num_threads << " threads in "
+            << wall_time << " s.\n"
+            << "Best mean score " << best_score << " with gain scales position "
+            << scales.position << ", velocity " << scales.velocity
+            << ", attitude " << scales.attitude << ", angular rate "
+            << scales.angular_rate << ".\n";
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/flight_log.h"
+
+#include <cstring>
+
+#include <zlib.h>
+
+namespace gazebo {
+
+namespace {
+
+const uint8_t kPadding[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+
+size_t PaddingOf(size_t size) { return (8 - size % 8) % 8; }
+
+}  // namespace
+
+FlightLogWriter::FlightLogWriter()
+    : file_(nullptr),
+      compression_(kFlightLogUncompressed),
+      block_rows_(kDefaultFlightLogBlockRows) {}
+
+FlightLogWriter::~FlightLogWriter() { Close(); }
+
+bool FlightLogWriter::Open(const std::string& filename,
+                           FlightLogCompression compression, int block_rows) {
+  Close();
+  std::lock_guard<std::mutex> lock(mutex_);
+  file_ = std::fopen(filename.c_str(), "wb");
+  if (file_ == nullptr) {
+    return false;
+  }
+  compression_ = compression;
+  block_rows_ = block_rows > 0 ? block_rows : kDefaultFlightLogBlockRows;
+  streams_.clear();
+
+  const uint32_t header[2] = {kFlightLogVersion, 0};
+  std::fwrite(kFlightLogMagic, sizeof(kFlightLogMagic), 1, file_);
+  std::fwrite(header, sizeof(header), 1, file_);
+  return true;
+}
+
+void FlightLogWriter::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (file_ == nullptr) {
+    return;
+  }
+  for (size_t i = 0; i < streams_.size(); ++i) {
+    FlushStream(i);
+  }
+  std::fclose(file_);
+  file_ = nullptr;
+}
+
+int FlightLogWriter::AddStream(const std::string& name,
+                               const std::vector<std::string>& columns) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (file_ == nullptr) {
+    return -1;
+  }
+  Stream stream;
+  stream.num_columns = columns.size();
+  stream.num_rows = 0;
+  stream.stamps.resize(block_rows_);
+  stream.values.resize(block_rows_ * columns.size());
+  streams_.push_back(stream);
+
+  // One line for the name, then one "<column> <type>" line per column.
+  std::string schema = name + "\nstamp_ns " + char(kFlightLogInt64) + "\n";
+  for (const std::string& column : columns) {
+    schema += column + " " + char(kFlightLogFloat64) + "\n";
+  }
+  const uint32_t stream_id = streams_.size() - 1;
+  WriteRecord(kFlightLogSchemaRecord, stream_id, 0,
+              reinterpret_cast<const uint8_t*>(schema.data()), schema.size());
+  return stream_id;
+}
+
+void FlightLogWriter::Append(int stream_id, int64_t stamp_ns,
+                             const double* values, size_t num_values) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (file_ == nullptr || stream_id < 0 ||
+      stream_id >= static_cast<int>(streams_.size())) {
+    return;
+  }
+  Stream& stream = streams_[stream_id];
+  if (num_values != stream.num_columns) {
+    return;
+  }
+  const size_t row = stream.num_rows++;
+  stream.stamps[row] = stamp_ns;
+  for (size_t i = 0; i < num_values; ++i) {
+    stream.values[i * block_rows_ + row] = values[i];
+  }
+  if (stream.num_rows == block_rows_) {
+    FlushStream(stream_id);
+  }
+}
+
+void FlightLogWriter::FlushStream(uint32_t stream_id) {
+  Stream& stream = streams_[stream_id];
+  if (stream.num_rows == 0) {
+    return;
+  }
+  const size_t rows = stream.num_rows;
+  const size_t column_size = rows * sizeof(double);
+  block_buffer_.resize(column_size * (stream.num_columns + 1));
+  std::memcpy(&block_buffer_[0], &stream.stamps[0], column_size);
+  for (size_t i = 0; i < stream.num_columns; ++i) {
+    std::memcpy(&block_buffer_[column_size * (i + 1)],
+                &stream.values[i * block_rows_], column_size);
+  }
+  WriteRecord(kFlightLogBlockRecord, stream_id, rows, &block_buffer_[0],
+              block_buffer_.size());
+  stream.num_rows = 0;
+}
+
+void FlightLogWriter::WriteRecord(uint32_t type, uint32_t stream_id,
+                                  uint32_t num_rows, const uint8_t* payload,
+                                  size_t size) {
+  FlightLogRecordHeader header;
+  header.type = type;
+  header.stream_id = stream_id;
+  header.num_rows = num_rows;
+  header.compression = kFlightLogUncompressed;
+  header.stored_size = size;
+  header.raw_size = size;
+
+  if (type == kFlightLogBlockRecord && compression_ == kFlightLogZlib) {
+    uLongf compressed_size = compressBound(size);
+    compressed_buffer_.resize(compressed_size);
+    // Only keep the compressed block if it actually got smaller.
+    if (compress2(&compressed_buffer_[0], &compressed_size, payload, size,
+                  Z_BEST_SPEED) == Z_OK &&
+        compressed_size < size) {
+      header.compression = kFlightLogZlib;
+      header.stored_size = compressed_size;
+      payload = &compressed_buffer_[0];
+    }
+  }
+
+  std::fwrite(&header, sizeof(header), 1, file_);
+  std::fwrite(payload, header.stored_size, 1, file_);
+  std::fwrite(kPadding, PaddingOf(header.stored_size), 1, file_);
+}
+
+}  // namespace gazebo
@@ -21,19 +21,43 @@
 
 #include "rotors_gazebo_plugins/gazebo_bag_plugin.h"
 
+#include <algorithm>
+#include <chrono>
 #include <ctime>
 
 #include <mav_msgs/Actuators.h>
 
 namespace gazebo {
 
+namespace {
+
+/// \brief Local wall time, as used in the bag file names.
+std::string DateTimeString() {
+  time_t rawtime;
+  struct tm* timeinfo;
+  char buffer[80];
+
+  time(&rawtime);
+  timeinfo = localtime(&rawtime);
+
+  strftime(buffer, 80, "%Y-%m-%d-%H-%M-%S", timeinfo);
+  return std::string(buffer);
+}
+
+}  // namespace
+
 GazeboBagPlugin::~GazeboBagPlugin() {
   
   if (node_handle_) {
     node_handle_->shutdown();
     delete node_handle_;
   }
+  StopBagWriter();
+  ClearBagQueue();
   bag_.close();
+  flight_log_.Close();
+  // Waits for a flush still being written.
+  black_box_.reset();
 }
 
 void GazeboBagPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
@@ -108,6 +132,105 @@ void GazeboBagPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
 
   getSdfParam<bool>(_sdf, "waitToRecordBag", wait_to_record_, wait_to_record_);
 
+  LoadBagStream(_sdf, "imu", imu_topic_, &imu_stream_);
+  LoadBagStream(_sdf, "externalForce", external_force_topic_,
+                &external_force_stream_);
+  LoadBagStream(_sdf, "waypoint", waypoint_topic_, &waypoint_stream_);
+  LoadBagStream(_sdf, "commandPose", command_pose_topic_,
+                &command_pose_stream_);
+  LoadBagStream(_sdf, "commandAttitudeThrust", control_attitude_thrust_topic_,
+                &control_attitude_thrust_stream_);
+  LoadBagStream(_sdf, "commandMotorSpeed", control_motor_speed_topic_,
+                &control_motor_speed_stream_);
+  LoadBagStream(_sdf, "commandRateThrust", control_rate_thrust_topic_,
+                &control_rate_thrust_stream_);
+  LoadBagStream(_sdf, "windSpeed", wind_speed_topic_, &wind_speed_stream_);
+  LoadBagStream(_sdf, "motor", motor_topic_, &motor_stream_);
+  LoadBagStream(_sdf, "pose", ground_truth_pose_topic_,
+                &ground_truth_pose_stream_);
+  LoadBagStream(_sdf, "twist", ground_truth_twist_topic_,
+                &ground_truth_twist_stream_);
+  LoadBagStream(_sdf, "wrenches", wrench_topic_, &wrench_stream_);
+
+  getSdfParam<bool>(_sdf, "asyncRecording", async_recording_,
+                    async_recording_);
+  getSdfParam<int>(_sdf, "bagQueueSize", bag_queue_size_, bag_queue_size_);
+  getSdfParam<int>(_sdf, "bagWriteBatchSize", bag_write_batch_size_,
+                   bag_write_batch_size_);
+  getSdfParam<int>(_sdf, "bagChunkSize", bag_chunk_size_, bag_chunk_size_);
+  std::string bag_compression = kDefaultBagCompression;
+  getSdfParam<std::string>(_sdf, "bagCompression", bag_compression,
+                           bag_compression);
+  if (bag_compression == "none") {
+    bag_compression_ = rosbag::compression::Uncompressed;
+  } else if (bag_compression == "bz2") {
+    bag_compression_ = rosbag::compression::BZ2;
+  } else if (bag_compression == "lz4") {
+    bag_compression_ = rosbag::compression::LZ4;
+  } else {
+    gzerr << "[gazebo_bag_plugin] Unknown bagCompression \"" << bag_compression
+          << "\", expected none, bz2 or lz4. Writing uncompressed.\n";
+    bag_compression_ = rosbag::compression::Uncompressed;
+  }
+  getSdfParam<bool>(_sdf, "flightLog", flight_log_enabled_,
+                    flight_log_enabled_);
+  getSdfParam<int>(_sdf, "flightLogBlockRows", flight_log_block_rows_,
+                   flight_log_block_rows_);
+  std::string flight_log_compression = kDefaultFlightLogCompression;
+  getSdfParam<std::string>(_sdf, "flightLogCompression",
+                           flight_log_compression, flight_log_compression);
+  if (flight_log_compression == "zlib") {
+    flight_log_compression_ = kFlightLogZlib;
+  } else if (flight_log_compression != "none") {
+    gzerr << "[gazebo_bag_plugin] Unknown flightLogCompression \""
+          << flight_log_compression
+          << "\", expected none or zlib. Writing uncompressed.\n";
+  }
+  if (bag_queue_size_ < 1) {
+    gzwarn << "[gazebo_bag_plugin] bagQueueSize must be positive, using "
+           << kDefaultBagQueueSize << ".\n";
+    bag_queue_size_ = kDefaultBagQueueSize;
+  }
+  if (bag_write_batch_size_ < 1) {
+    bag_write_batch_size_ = 1;
+  }
+  if (async_recording_) {
+    bag_queue_.reset(new MpscQueue<BagMessage*>(bag_queue_size_));
+  }
+
+  getSdfParam<bool>(_sdf, "blackBox", black_box_enabled_, black_box_enabled_);
+  getSdfParam<double>(_sdf, "blackBoxDuration", black_box_duration_,
+                      black_box_duration_);
+  getSdfParam<int>(_sdf, "blackBoxSize", black_box_size_, black_box_size_);
+  getSdfParam<std::string>(_sdf, "blackBoxServiceName",
+                           black_box_service_name_, black_box_service_name_);
+  getSdfParam<double>(_sdf, "blackBoxCollisionForce",
+                      black_box_collision_force_, black_box_collision_force_);
+  getSdfParam<std::string>(_sdf, "blackBoxEstimateTopic",
+                           black_box_estimate_topic_,
+                           black_box_estimate_topic_);
+  getSdfParam<double>(_sdf, "blackBoxMaxPositionError",
+                      black_box_max_position_error_,
+                      black_box_max_position_error_);
+  if (black_box_enabled_) {
+    if (black_box_size_ < 1) {
+      gzwarn << "[gazebo_bag_plugin] blackBoxSize must be positive, using "
+             << kDefaultBlackBoxSize << ".\n";
+      black_box_size_ = kDefaultBlackBoxSize;
+    }
+    if (flight_log_enabled_) {
+      gzwarn << "[gazebo_bag_plugin] The flight log is not written in black "
+                "box mode, all streams go to the black box.\n";
+      flight_log_enabled_ = false;
+    }
+    // The streams are written to the ring from here on, never to bag_.
+    black_box_.reset(
+        new BlackBoxRecorder(black_box_size_, black_box_duration_));
+    black_box_service_ = node_handle_->advertiseService(
+        black_box_service_name_, &GazeboBagPlugin::BlackBoxServiceCallback,
+        this);
+  }
+
   recording_service_ = node_handle_->advertiseService(
       recording_service_name_, &GazeboBagPlugin::RecordingServiceCallback,
       this);
@@ -152,27 +275,24 @@ void GazeboBagPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
 
 // This gets called by the world update start event.
 void GazeboBagPlugin::OnUpdate(const common::UpdateInfo& _info) {
-  if (kPrintOnUpdates) {
-    gzdbg << __FUNCTION__ << "() called." << std::endl;
-  }
+  ROTORS_PROFILE_SCOPE("gazebo_bag_plugin");
 
   // Get the current simulation time.
   common::Time now = world_->SimTime();
+  if (black_box_) {
+    if (black_box_max_position_error_ > 0.0) {
+      std::lock_guard<std::mutex> lock(black_box_mutex_);
+      ground_truth_position_ = link_->WorldPose().Pos();
+    }
+    CheckCollisions(now);
+  }
   LogWrenches(now);
   LogGroundTruth(now);
   LogMotorVelocities(now);
 }
 
 void GazeboBagPlugin::StartRecording() {
-  time_t rawtime;
-  struct tm* timeinfo;
-  char buffer[80];
-
-  time(&rawtime);
-  timeinfo = localtime(&rawtime);
-
-  strftime(buffer, 80, "%Y-%m-%d-%H-%M-%S", timeinfo);
-  std::string date_time_str(buffer);
+  std::string date_time_str = DateTimeString();
 
   std::string key(".bag");
   size_t pos = bag_filename_.rfind(key);
@@ -181,8 +301,29 @@ void GazeboBagPlugin::StartRecording() {
   }
   std::string full_bag_filename = bag_filename_ + "_" + date_time_str + ".bag";
 
-  // Open a bag file and store it in ~/.ros/<full_bag_filename>.
-  bag_.open(full_bag_filename, rosbag::bagmode::Write);
+  // Every recording starts its decimation and minimum period afresh.
+  for (BagStream* stream :
+       {&imu_stream_, &external_force_stream_, &waypoint_stream_,
+        &command_pose_stream_, &control_attitude_thrust_stream_,
+        &control_motor_speed_stream_, &control_rate_thrust_stream_,
+        &wind_speed_stream_, &motor_stream_, &ground_truth_pose_stream_,
+        &ground_truth_twist_stream_, &wrench_stream_}) {
+    stream->Reset();
+  }
+
+  // Open a bag file and store it in ~/.ros/<full_bag_filename>. The black
+  // box opens its own bag on every flush instead.
+  if (!black_box_) {
+    bag_.open(full_bag_filename, rosbag::bagmode::Write);
+    bag_.setCompression(bag_compression_);
+    if (bag_chunk_size_ > 0) {
+      bag_.setChunkThreshold(bag_chunk_size_);
+    }
+    StartBagWriter();
+    if (flight_log_enabled_) {
+      StartFlightLog(bag_filename_ + "_" + date_time_str);
+    }
+  }
 
   // Subscriber to IMU sensor_msgs::Imu Message.
   imu_sub_ = node_handle_->subscribe(imu_topic_, 10,
@@ -220,6 +361,14 @@ void GazeboBagPlugin::StartRecording() {
       node_handle_->subscribe(wind_speed_topic_, 10,
                               &GazeboBagPlugin::WindSpeedCallback, this);
 
+  // Subscriber to the odometry estimate checked against the ground truth.
+  if (black_box_ && !black_box_estimate_topic_.empty() &&
+      black_box_max_position_error_ > 0.0) {
+    estimate_sub_ =
+        node_handle_->subscribe(black_box_estimate_topic_, 10,
+                                &GazeboBagPlugin::EstimateCallback, this);
+  }
+
   // Listen to the update event. This event is broadcast every
   // simulation iteration.
   update_connection_ = event::Events::ConnectWorldUpdateBegin(
@@ -228,8 +377,13 @@ void GazeboBagPlugin::StartRecording() {
   // Set the flag that we are actively recording.
   is_recording_ = true;
 
-  ROS_INFO("GazeboBagPlugin START recording bagfile %s",
-           full_bag_filename.c_str());
+  if (black_box_) {
+    ROS_INFO("GazeboBagPlugin START recording the last %.1f s into a black "
+             "box of %d bytes", black_box_duration_, black_box_size_);
+  } else {
+    ROS_INFO("GazeboBagPlugin START recording bagfile %s",
+             full_bag_filename.c_str());
+  }
 }
 
 void GazeboBagPlugin::StopRecording() {
@@ -242,78 +396,292 @@ void GazeboBagPlugin::StopRecording() {
   control_motor_speed_sub_.shutdown();
   control_rate_thrust_sub_.shutdown();
   wind_speed_sub_.shutdown();
+  estimate_sub_.shutdown();
 
   // Disconnect the update event.
   
 
-  // Close the bag.
+  // Write what is still queued and close the bag.
+  StopBagWriter();
+  ClearBagQueue();
   bag_.close();
+  flight_log_.Close();
 
   // Clear the flag to show that we are not actively recording
   is_recording_ = false;
 
-  ROS_INFO("GazeboBagPlugin STOP recording bagfile");
+  if (async_recording_) {
+    ROS_INFO("GazeboBagPlugin STOP recording bagfile, wrote %lu messages, "
+             "dropped %lu", static_cast<unsigned long>(
+                 num_bag_messages_written_.load()),
+             static_cast<unsigned long>(num_bag_messages_dropped_.load()));
+  } else {
+    ROS_INFO("GazeboBagPlugin STOP recording bagfile");
+  }
+}
+
+void GazeboBagPlugin::StartFlightLog(const std::string& base_filename) {
+  const std::string filename = base_filename + ".rflog";
+  for (BagStream* stream : {&ground_truth_pose_stream_,
+                            &ground_truth_twist_stream_, &imu_stream_,
+                            &motor_stream_, &wrench_stream_}) {
+    stream->log_stream = -1;
+  }
+  if (!flight_log_.Open(filename, flight_log_compression_,
+                        flight_log_block_rows_)) {
+    gzerr << "[gazebo_bag_plugin] Could not create flight log " << filename
+          << ", writing everything to the bag.\n";
+    return;
+  }
+
+  // The stream names are the bag topics, so the evaluation finds them under
+  // the same names in either file.
+  ground_truth_pose_stream_.log_stream = flight_log_.AddStream(
+      ground_truth_pose_stream_.topic,
+      {"position_x", "position_y", "position_z", "orientation_w",
+       "orientation_x", "orientation_y", "orientation_z"});
+  ground_truth_twist_stream_.log_stream = flight_log_.AddStream(
+      ground_truth_twist_stream_.topic,
+      {"linear_x", "linear_y", "linear_z", "angular_x", "angular_y",
+       "angular_z"});
+  imu_stream_.log_stream = flight_log_.AddStream(
+      imu_stream_.topic,
+      {"orientation_w", "orientation_x", "orientation_y", "orientation_z",
+       "angular_velocity_x", "angular_velocity_y", "angular_velocity_z",
+       "linear_acceleration_x", "linear_acceleration_y",
+       "linear_acceleration_z"});
+  std::vector<std::string> motor_columns;
+  for (size_t i = 0; i < motor_joints_.size(); ++i) {
+    motor_columns.push_back("motor_" + std::to_string(i));
+  }
+  motor_stream_.log_stream =
+      flight_log_.AddStream(motor_stream_.topic, motor_columns);
+  wrench_stream_.log_stream = flight_log_.AddStream(
+      wrench_stream_.topic,
+      {"force_x", "force_y", "force_z", "torque_x", "torque_y", "torque_z"});
+
+  ROS_INFO("GazeboBagPlugin START recording flight log %s", filename.c_str());
+}
+
+void GazeboBagPlugin::StartBagWriter() {
+  if (!async_recording_ || bag_writer_thread_.joinable()) {
+    return;
+  }
+  ClearBagQueue();
+  num_bag_messages_dropped_ = 0;
+  num_bag_messages_written_ = 0;
+  stop_bag_writer_ = false;
+  bag_writer_thread_ = std::thread(&GazeboBagPlugin::BagWriterThread, this);
+}
+
+void GazeboBagPlugin::StopBagWriter() {
+  if (!bag_writer_thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(bag_writer_mutex_);
+    stop_bag_writer_ = true;
+  }
+  bag_writer_condition_.notify_one();
+  bag_writer_thread_.join();
+}
+
+void GazeboBagPlugin::BagWriterThread() {
+  std::vector<BagMessage*> batch;
+  batch.reserve(bag_write_batch_size_);
+  uint64_t reported_dropped = 0;
+  std::chrono::steady_clock::time_point last_drop_report;
+
+  std::unique_lock<std::mutex> lock(bag_writer_mutex_);
+  while (true) {
+    // Everything queued before the stop request is still written.
+    const bool stop = stop_bag_writer_;
+    lock.unlock();
+
+    BagMessage* msg;
+    while (bag_queue_->TryPop(&msg)) {
+      batch.push_back(msg);
+      if (batch.size() == static_cast<size_t>(bag_write_batch_size_)) {
+        WriteBagBatch(&batch);
+      }
+    }
+    WriteBagBatch(&batch);
+
+    const uint64_t dropped = num_bag_messages_dropped_;
+    const std::chrono::steady_clock::time_point now =
+        std::chrono::steady_clock::now();
+    if (dropped > reported_dropped &&
+        now - last_drop_report >
+            std::chrono::duration<double>(kBagDropReportInterval)) {
+      gzwarn << "[gazebo_bag_plugin] Bag queue of size "
+             << bag_queue_->Capacity() << " is full, dropped "
+             << dropped - reported_dropped << " messages (" << dropped
+             << " in total).\n";
+      reported_dropped = dropped;
+      last_drop_report = now;
+    }
+
+    lock.lock();
+    if (stop) {
+      break;
+    }
+    bag_writer_condition_.wait_for(
+        lock, std::chrono::duration<double>(kBagWriterPeriod),
+        [this] { return stop_bag_writer_; });
+  }
+}
+
+void GazeboBagPlugin::WriteBagBatch(std::vector<BagMessage*>* batch) {
+  if (batch->empty()) {
+    return;
+  }
+  {
+    boost::mutex::scoped_lock lock(mtx_);
+    for (BagMessage* msg : *batch) {
+      msg->Write(&bag_);
+    }
+  }
+  num_bag_messages_written_ += batch->size();
+  for (BagMessage* msg : *batch) {
+    delete msg;
+  }
+  batch->clear();
+}
+
+void GazeboBagPlugin::ClearBagQueue() {
+  if (!bag_queue_) {
+    return;
+  }
+  // Messages can still be queued by the callbacks after the writer thread
+  // drained the queue for the last time, they count as dropped.
+  BagMessage* msg;
+  while (bag_queue_->TryPop(&msg)) {
+    delete msg;
+    ++num_bag_messages_dropped_;
+  }
+}
+
+void GazeboBagPlugin::EnqueueBagMessage(BagMessage* msg) {
+  if (!bag_queue_->TryPush(msg)) {
+    delete msg;
+    ++num_bag_messages_dropped_;
+    return;
+  }
+  // Wake the writer early instead of letting the queue fill up.
+  if (bag_queue_->SizeApprox() >=
+      static_cast<size_t>(bag_write_batch_size_)) {
+    bag_writer_condition_.notify_one();
+  }
 }
 
 void GazeboBagPlugin::ImuCallback(const sensor_msgs::ImuConstPtr& imu_msg) {
   common::Time now = world_->SimTime();
+  if (!imu_stream_.ShouldWrite(now.Double())) {
+    return;
+  }
+  if (imu_stream_.log_stream >= 0) {
+    const double values[] = {
+        imu_msg->orientation.w, imu_msg->orientation.x,
+        imu_msg->orientation.y, imu_msg->orientation.z,
+        imu_msg->angular_velocity.x, imu_msg->angular_velocity.y,
+        imu_msg->angular_velocity.z, imu_msg->linear_acceleration.x,
+        imu_msg->linear_acceleration.y, imu_msg->linear_acceleration.z};
+    flight_log_.Append(imu_stream_.log_stream,
+                       imu_msg->header.stamp.toNSec(), values, 10);
+    return;
+  }
   ros::Time ros_now = ros::Time(now.sec, now.nsec);
-  writeBag(namespace_ + "/" + imu_topic_, ros_now, imu_msg);
+  writeBag(imu_stream_.topic, ros_now, imu_msg);
 }
 
 void GazeboBagPlugin::ExternalForceCallback(
     const geometry_msgs::WrenchStampedConstPtr& force_msg) {
   common::Time now = world_->SimTime();
+  if (!external_force_stream_.ShouldWrite(now.Double())) {
+    return;
+  }
   ros::Time ros_now = ros::Time(now.sec, now.nsec);
-  writeBag(namespace_ + "/" + external_force_topic_, ros_now, force_msg);
+  writeBag(external_force_stream_.topic, ros_now, force_msg);
 }
 
 void GazeboBagPlugin::WaypointCallback(
     const trajectory_msgs::MultiDOFJointTrajectoryConstPtr& trajectory_msg) {
   common::Time now = world_->SimTime();
+  if (!waypoint_stream_.ShouldWrite(now.Double())) {
+    return;
+  }
   ros::Time ros_now = ros::Time(now.sec, now.nsec);
-  writeBag(namespace_ + "/" + waypoint_topic_, ros_now, trajectory_msg);
+  writeBag(waypoint_stream_.topic, ros_now, trajectory_msg);
 }
 
 void GazeboBagPlugin::CommandPoseCallback(
     const geometry_msgs::PoseStampedConstPtr& pose_msg) {
   common::Time now = world_->SimTime();
+  if (!command_pose_stream_.ShouldWrite(now.Double())) {
+    return;
+  }
   ros::Time ros_now = ros::Time(now.sec, now.nsec);
-  writeBag(namespace_ + "/" + command_pose_topic_, ros_now, pose_msg);
+  writeBag(command_pose_stream_.topic, ros_now, pose_msg);
 }
 
 void GazeboBagPlugin::AttitudeThrustCallback(
     const mav_msgs::AttitudeThrustConstPtr& control_msg) {
   common::Time now = world_->SimTime();
+  if (!control_attitude_thrust_stream_.ShouldWrite(now.Double())) {
+    return;
+  }
   ros::Time ros_now = ros::Time(now.sec, now.nsec);
-  writeBag(namespace_ + "/" + control_attitude_thrust_topic_, ros_now,
-           control_msg);
+  writeBag(control_attitude_thrust_stream_.topic, ros_now, control_msg);
 }
 
 void GazeboBagPlugin::ActuatorsCallback(
     const mav_msgs::ActuatorsConstPtr& control_msg) {
   common::Time now = world_->SimTime();
+  if (!control_motor_speed_stream_.ShouldWrite(now.Double())) {
+    return;
+  }
   ros::Time ros_now = ros::Time(now.sec, now.nsec);
-  writeBag(namespace_ + "/" + control_motor_speed_topic_, ros_now, control_msg);
+  writeBag(control_motor_speed_stream_.topic, ros_now, control_msg);
 }
 
 void GazeboBagPlugin::RateThrustCallback(
     const mav_msgs::RateThrustConstPtr& control_msg) {
   common::Time now = world_->SimTime();
+  if (!control_rate_thrust_stream_.ShouldWrite(now.Double())) {
+    return;
+  }
   ros::Time ros_now = ros::Time(now.sec, now.nsec);
-  writeBag(namespace_ + "/" + control_rate_thrust_topic_, ros_now, control_msg);
+  writeBag(control_rate_thrust_stream_.topic, ros_now, control_msg);
 }
 
 void GazeboBagPlugin::WindSpeedCallback(
     const rotors_comm::WindSpeedConstPtr& wind_speed_msg) {
   common::Time now = world_->SimTime();
+  if (!wind_speed_stream_.ShouldWrite(now.Double())) {
+    return;
+  }
   ros::Time ros_now = ros::Time(now.sec, now.nsec);
-  writeBag(namespace_ + "/" + wind_speed_topic_, ros_now, wind_speed_msg);
+  writeBag(wind_speed_stream_.topic, ros_now, wind_speed_msg);
 }
 
 void GazeboBagPlugin::LogMotorVelocities(const common::Time now) {
+  if (!motor_stream_.ShouldWrite(now.Double())) {
+    return;
+  }
   ros::Time ros_now = ros::Time(now.sec, now.nsec);
 
+  if (motor_stream_.log_stream >= 0) {
+    std::vector<double> values(motor_joints_.size());
+    for (MotorNumberToJointMap::iterator m = motor_joints_.begin();
+         m != motor_joints_.end(); ++m) {
+      values[m->first] =
+          m->second->GetVelocity(0) * rotor_velocity_slowdown_sim_;
+    }
+    flight_log_.Append(motor_stream_.log_stream, ros_now.toNSec(),
+                       values.data(), values.size());
+    return;
+  }
+
   mav_msgs::Actuators rot_velocities_msg;
   rot_velocities_msg.angular_velocities.resize(motor_joints_.size());
 
@@ -326,47 +694,70 @@ void GazeboBagPlugin::LogMotorVelocities(const common::Time now) {
   rot_velocities_msg.header.stamp.sec = now.sec;
   rot_velocities_msg.header.stamp.nsec = now.nsec;
 
-  writeBag(namespace_ + "/" + motor_topic_, ros_now, rot_velocities_msg);
+  writeBag(motor_stream_.topic, ros_now, rot_velocities_msg);
 }
 
 void GazeboBagPlugin::LogGroundTruth(const common::Time now) {
   ros::Time ros_now = ros::Time(now.sec, now.nsec);
 
-  geometry_msgs::PoseStamped pose_msg;
-  geometry_msgs::TwistStamped twist_msg;
-
-  // Get pose and update the message.
-  ignition::math::Pose3d pose = link_->WorldPose();
-  pose_msg.header.frame_id = frame_id_;
-  pose_msg.header.stamp.sec = now.sec;
-  pose_msg.header.stamp.nsec = now.nsec;
-  pose_msg.pose.position.x = pose.Pos().X();
-  pose_msg.pose.position.y = pose.Pos().Y();
-  pose_msg.pose.position.z = pose.Pos().Z();
-  pose_msg.pose.orientation.w = pose.Rot().W();
-  pose_msg.pose.orientation.x = pose.Rot().X();
-  pose_msg.pose.orientation.y = pose.Rot().Y();
-  pose_msg.pose.orientation.z = pose.Rot().Z();
-
-  writeBag(namespace_ + "/" + ground_truth_pose_topic_, ros_now, pose_msg);
-
-  // Get twist and update the message.
-  ignition::math::Vector3d linear_veloctiy = link_->WorldLinearVel();
-  ignition::math::Vector3d angular_veloctiy = link_->WorldAngularVel();
-  twist_msg.header.frame_id = frame_id_;
-  twist_msg.header.stamp.sec = now.sec;
-  twist_msg.header.stamp.nsec = now.nsec;
-  twist_msg.twist.linear.x = linear_veloctiy.X();
-  twist_msg.twist.linear.y = linear_veloctiy.Y();
-  twist_msg.twist.linear.z = linear_veloctiy.Z();
-  twist_msg.twist.angular.x = angular_veloctiy.X();
-  twist_msg.twist.angular.y = angular_veloctiy.Y();
-  twist_msg.twist.angular.z = angular_veloctiy.Z();
-
-  writeBag(namespace_ + "/" + ground_truth_twist_topic_, ros_now, twist_msg);
+  if (ground_truth_pose_stream_.ShouldWrite(now.Double())) {
+    // Get pose and update the message.
+    ignition::math::Pose3d pose = link_->WorldPose();
+    if (ground_truth_pose_stream_.log_stream >= 0) {
+      const double values[] = {pose.Pos().X(), pose.Pos().Y(), pose.Pos().Z(),
+                               pose.Rot().W(), pose.Rot().X(), pose.Rot().Y(),
+                               pose.Rot().Z()};
+      flight_log_.Append(ground_truth_pose_stream_.log_stream,
+                         ros_now.toNSec(), values, 7);
+    } else {
+      geometry_msgs::PoseStamped pose_msg;
+      pose_msg.header.frame_id = frame_id_;
+      pose_msg.header.stamp.sec = now.sec;
+      pose_msg.header.stamp.nsec = now.nsec;
+      pose_msg.pose.position.x = pose.Pos().X();
+      pose_msg.pose.position.y = pose.Pos().Y();
+      pose_msg.pose.position.z = pose.Pos().Z();
+      pose_msg.pose.orientation.w = pose.Rot().W();
+      pose_msg.pose.orientation.x = pose.Rot().X();
+      pose_msg.pose.orientation.y = pose.Rot().Y();
+      pose_msg.pose.orientation.z = pose.Rot().Z();
+
+      writeBag(ground_truth_pose_stream_.topic, ros_now, pose_msg);
+    }
+  }
+
+  if (ground_truth_twist_stream_.ShouldWrite(now.Double())) {
+    // Get twist and update the message.
+    ignition::math::Vector3d linear_veloctiy = link_->WorldLinearVel();
+    ignition::math::Vector3d angular_veloctiy = link_->WorldAngularVel();
+    if (ground_truth_twist_stream_.log_stream >= 0) {
+      const double values[] = {linear_veloctiy.X(), linear_veloctiy.Y(),
+                               linear_veloctiy.Z(), angular_veloctiy.X(),
+                               angular_veloctiy.Y(), angular_veloctiy.Z()};
+      flight_log_.Append(ground_truth_twist_stream_.log_stream,
+                         ros_now.toNSec(), values, 6);
+    } else {
+      geometry_msgs::TwistStamped twist_msg;
+      twist_msg.header.frame_id = frame_id_;
+      twist_msg.header.stamp.sec = now.sec;
+      twist_msg.header.stamp.nsec = now.nsec;
+      twist_msg.twist.linear.x = linear_veloctiy.X();
+      twist_msg.twist.linear.y = linear_veloctiy.Y();
+      twist_msg.twist.linear.z = linear_veloctiy.Z();
+      twist_msg.twist.angular.x = angular_veloctiy.X();
+      twist_msg.twist.angular.y = angular_veloctiy.Y();
+      twist_msg.twist.angular.z = angular_veloctiy.Z();
+
+      writeBag(ground_truth_twist_stream_.topic, ros_now, twist_msg);
+    }
+  }
 }
 
 void GazeboBagPlugin::LogWrenches(const common::Time now) {
+  // Skip the iteration over the contacts entirely if no wrench is due.
+  if (!wrench_stream_.ShouldWrite(now.Double())) {
+    return;
+  }
   geometry_msgs::WrenchStamped wrench_msg;
   std::vector<physics::Contact*> contacts = contact_mgr_->GetContacts();
   for (int i = 0; i < contact_mgr_->GetContactCount(); ++i) {
@@ -376,6 +767,18 @@ void GazeboBagPlugin::LogWrenches(const common::Time now) {
 
     // Exclude extremely small forces.
     if (body1_force < 1e-10) continue;
+    if (wrench_stream_.log_stream >= 0) {
+      // The log has no frame_id, the contact pair is not recorded there.
+      const double values[] = {contacts[i]->wrench->body1Force.X(),
+                               contacts[i]->wrench->body1Force.Y(),
+                               contacts[i]->wrench->body1Force.Z(),
+                               contacts[i]->wrench->body1Torque.X(),
+                               contacts[i]->wrench->body1Torque.Y(),
+                               contacts[i]->wrench->body1Torque.Z()};
+      flight_log_.Append(wrench_stream_.log_stream,
+                         ros::Time(now.sec, now.nsec).toNSec(), values, 6);
+      continue;
+    }
     // Do this, such that all the contacts are logged.
     // (publishing on the same topic with the same time stamp is impossible)
     ros::Time ros_now = ros::Time(now.sec, now.nsec + i * 1000);
@@ -391,8 +794,114 @@ void GazeboBagPlugin::LogWrenches(const common::Time now) {
     wrench_msg.wrench.torque.y = contacts[i]->wrench->body1Torque.Y();
     wrench_msg.wrench.torque.z = contacts[i]->wrench->body1Torque.Z();
 
-    writeBag(namespace_ + "/" + wrench_topic_, ros_now, wrench_msg);
+    writeBag(wrench_stream_.topic, ros_now, wrench_msg);
+  }
+}
+
+void GazeboBagPlugin::LoadBagStream(sdf::ElementPtr _sdf,
+                                    const std::string& name,
+                                    const std::string& topic,
+                                    BagStream* stream) {
+  stream->topic = namespace_ + "/" + topic;
+  if (!_sdf->HasElement(name + "Stream")) {
+    return;
+  }
+  sdf::ElementPtr stream_sdf = _sdf->GetElement(name + "Stream");
+  double rate;
+  getSdfParam<bool>(stream_sdf, "enabled", stream->enabled, true);
+  getSdfParam<int>(stream_sdf, "decimation", stream->decimation,
+                   kDefaultBagStreamDecimation);
+  getSdfParam<double>(stream_sdf, "rate", rate, kDefaultBagStreamRate);
+  getSdfParam<double>(stream_sdf, "startTime", stream->start_time,
+                      kDefaultBagStreamStartTime);
+  getSdfParam<double>(stream_sdf, "endTime", stream->end_time,
+                      kDefaultBagStreamEndTime);
+  if (stream->decimation < 1) {
+    gzwarn << "[gazebo_bag_plugin] decimation of " << name
+           << "Stream must be at least 1, recording every message.\n";
+    stream->decimation = 1;
+  }
+  stream->min_period = rate > 0.0 ? 1.0 / rate : 0.0;
+}
+
+void GazeboBagPlugin::EstimateCallback(
+    const nav_msgs::OdometryConstPtr& odometry_msg) {
+  const ignition::math::Vector3d estimate(odometry_msg->pose.pose.position.x,
+                                          odometry_msg->pose.pose.position.y,
+                                          odometry_msg->pose.pose.position.z);
+  double error;
+  {
+    std::lock_guard<std::mutex> lock(black_box_mutex_);
+    error = (estimate - ground_truth_position_).Length();
+  }
+  if (error > black_box_max_position_error_ &&
+      FlushBlackBox("estimate_error", true, nullptr)) {
+    gzwarn << "[gazebo_bag_plugin] Position estimate is " << error
+           << " m off the ground truth, flushed the black box.\n";
+  }
+}
+
+void GazeboBagPlugin::CheckCollisions(const common::Time now) {
+  if (black_box_collision_force_ <= 0.0) {
+    return;
+  }
+  std::vector<physics::Contact*> contacts = contact_mgr_->GetContacts();
+  double max_force = 0.0;
+  for (int i = 0; i < contact_mgr_->GetContactCount(); ++i) {
+    // Only the contacts of this vehicle trigger its black box.
+    const physics::Contact* contact = contacts[i];
+    if (contact->collision1 && contact->collision1->GetModel() == model_) {
+      max_force = std::max(max_force, contact->wrench->body1Force.Length());
+    } else if (contact->collision2 &&
+               contact->collision2->GetModel() == model_) {
+      max_force = std::max(max_force, contact->wrench->body2Force.Length());
+    }
+  }
+  if (max_force > black_box_collision_force_ &&
+      FlushBlackBox("collision", true, nullptr)) {
+    gzwarn << "[gazebo_bag_plugin] Collision with a force of " << max_force
+           << " N at " << now.Double() << " s, flushed the black box.\n";
+  }
+}
+
+bool GazeboBagPlugin::FlushBlackBox(const std::string& reason, bool automatic,
+                                    std::string* filename) {
+  if (!black_box_ || !is_recording_) {
+    return false;
+  }
+  if (automatic) {
+    // A crash keeps triggering, the bag of its first step already holds the
+    // seconds leading up to it.
+    const double now = world_->SimTime().Double();
+    std::lock_guard<std::mutex> lock(black_box_mutex_);
+    if (last_black_box_trigger_ >= 0.0 && now >= last_black_box_trigger_ &&
+        now - last_black_box_trigger_ < black_box_duration_) {
+      return false;
+    }
+    last_black_box_trigger_ = now;
+  }
+  const std::string black_box_filename =
+      bag_filename_ + "_blackbox_" + DateTimeString() + "_" + reason + ".bag";
+  if (!black_box_->Flush(black_box_filename, bag_compression_)) {
+    gzwarn << "[gazebo_bag_plugin] Still writing the last black box, ignoring "
+           << reason << " flush.\n";
+    return false;
+  }
+  if (filename) {
+    *filename = black_box_filename;
+  }
+  ROS_INFO("GazeboBagPlugin FLUSH black box to %s", black_box_filename.c_str());
+  return true;
+}
+
+bool GazeboBagPlugin::BlackBoxServiceCallback(
+    std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res) {
+  res.success = FlushBlackBox("request", false, &res.message);
+  if (!res.success) {
+    res.message = is_recording_ ? "Still writing the last black box."
+                                : "Not recording.";
   }
+  return true;
 }
 
 bool GazeboBagPlugin::RecordingServiceCallback(
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/gazebo_checkpoint_plugin.h"
+
+#include <sstream>
+
+namespace gazebo {
+
+void GazeboCheckpointPlugin::Load(physics::WorldPtr _world,
+                                  sdf::ElementPtr _sdf) {
+  if (kPrintOnPluginLoad) {
+    gzdbg << __FUNCTION__ << "() called." << std::endl;
+  }
+
+  world_ = _world;
+  checkpoint_ = SimulationCheckpoint::Get(world_);
+
+  std::string checkpoint_topic = kDefaultCheckpointTopic;
+  std::string checkpoint_result_topic = kDefaultCheckpointResultTopic;
+  std::string restore_file;
+  getSdfParam<std::string>(_sdf, "checkpointTopic", checkpoint_topic,
+                           checkpoint_topic);
+  getSdfParam<std::string>(_sdf, "checkpointResultTopic",
+                           checkpoint_result_topic, checkpoint_result_topic);
+  getSdfParam<std::string>(_sdf, "restoreFile", restore_file, restore_file);
+  getSdfParam<std::string>(_sdf, "saveFile", save_file_, save_file_);
+  getSdfParam<double>(_sdf, "saveTime", save_time_, save_time_);
+
+  node_handle_ = transport::NodePtr(new transport::Node());
+  node_handle_->Init(world_->Name());
+  result_pub_ = node_handle_->Advertise<msgs::GzString>(
+      "~/" + checkpoint_result_topic, 1);
+  request_sub_ = node_handle_->Subscribe(
+      "~/" + checkpoint_topic, &GazeboCheckpointPlugin::OnRequest, this);
+
+  if (!restore_file.empty()) {
+    Request request;
+    request.save = false;
+    request.path = restore_file;
+    QueueRequest(request);
+  }
+  if (!save_file_.empty() && save_time_ >= 0.0) {
+    std::lock_guard<std::mutex> lock(request_mutex_);
+    update_end_connection_ = event::Events::ConnectWorldUpdateEnd(
+        boost::bind(&GazeboCheckpointPlugin::OnWorldUpdateEnd, this));
+  }
+}
+
+void GazeboCheckpointPlugin::OnRequest(ConstGzStringPtr& msg) {
+  std::istringstream stream(msg->data());
+  std::string command;
+  Request request;
+  stream >> command >> std::ws;
+  std::getline(stream, request.path);
+  request.save = command == "save";
+  if ((!request.save && command != "restore") || request.path.empty()) {
+    gzerr << "[gazebo_checkpoint_plugin] Unknown request \"" << msg->data()
+          << "\", expected \"save <path>\" or \"restore <path>\".\n";
+    return;
+  }
+
+  if (world_->IsPaused()) {
+    HandleRequest(request);
+  } else {
+    QueueRequest(request);
+  }
+}
+
+void GazeboCheckpointPlugin::QueueRequest(const Request& request) {
+  std::lock_guard<std::mutex> lock(request_mutex_);
+  requests_.push_back(request);
+  if (!update_end_connection_) {
+    update_end_connection_ = event::Events::ConnectWorldUpdateEnd(
+        boost::bind(&GazeboCheckpointPlugin::OnWorldUpdateEnd, this));
+  }
+}
+
+void GazeboCheckpointPlugin::OnWorldUpdateEnd() {
+  if (!save_file_.empty() && save_time_ >= 0.0 &&
+      world_->SimTime().Double() >= save_time_) {
+    Request request;
+    request.save = true;
+    request.path = save_file_;
+    HandleRequest(request);
+    save_time_ = kDefaultCheckpointSaveTime;
+  }
+
+  std::deque<Request> requests;
+  {
+    std::lock_guard<std::mutex> lock(request_mutex_);
+    requests.swap(requests_);
+  }
+  for (const Request& request : requests) {
+    HandleRequest(request);
+  }
+}
+
+void GazeboCheckpointPlugin::HandleRequest(const Request& request) {
+  common::Timer timer;
+  timer.Start();
+  std::string blob;
+  bool success;
+  if (request.save) {
+    success = checkpoint_->Save(&blob) &&
+              SimulationCheckpoint::WriteFile(request.path, blob);
+  } else {
+    success = SimulationCheckpoint::ReadFile(request.path, &blob) &&
+              checkpoint_->Restore(blob);
+  }
+
+  const std::string description =
+      (request.save ? "save " : "restore ") + request.path;
+  if (success) {
+    gzmsg << "[gazebo_checkpoint_plugin] " << description << " ("
+          << blob.size() << " bytes) took " << timer.GetElapsed().Double()
+          << " s.\n";
+  } else {
+    gzerr << "[gazebo_checkpoint_plugin] Could not " << description << ".\n";
+  }
+
+  msgs::GzString result;
+  result.set_data((success ? "ok " : "error ") + description);
+  result_pub_->Publish(result);
+}
+
+GZ_REGISTER_WORLD_PLUGIN(GazeboCheckpointPlugin);
+
+}  // namespace gazebo
@@ -63,52 +63,127 @@ void GazeboControllerInterface::Load(physics::ModelPtr _model,
   getSdfParam<std::string>(_sdf, "motorSpeedCommandPubTopic",
                            motor_velocity_reference_pub_topic_,
                            motor_velocity_reference_pub_topic_);
+  getSdfParam<std::string>(_sdf, "commandAttitudeThrustSubTopic",
+                           command_attitude_thrust_sub_topic_,
+                           command_attitude_thrust_sub_topic_);
+  getSdfParam<std::string>(_sdf, "controller", controller_name_,
+                           controller_name_);
+  getSdfParam<int>(_sdf, "controllerUpdateDivisor", controller_update_divisor_,
+                   controller_update_divisor_);
+  getSdfParam<bool>(_sdf, "shmTransport", shm_transport_, shm_transport_);
+  double control_deadline = kDefaultControlDeadline;
+  getSdfParam<double>(_sdf, "controlDeadline", control_deadline,
+                      control_deadline);
+  control_loop_ = ControlLoopMonitor::Connect(
+      world_, model_->GetName() + "/controller", control_deadline);
+  if (controller_update_divisor_ < 1) {
+    gzerr << "[gazebo_controller_interface] controllerUpdateDivisor must be"
+          << " positive, running the controller every physics step.\n";
+    controller_update_divisor_ = 1;
+  }
+
+  if (!controller_name_.empty()) {
+#ifdef ROTORS_EMBEDDED_CONTROLLER
+    controller_ = rotors_control::ControllerFactory::Instance().CreateController(
+        controller_name_);
+    if (controller_) {
+      std::string link_name;
+      getSdfParam<std::string>(_sdf, "linkName", link_name, link_name);
+      physics::LinkPtr link =
+          link_name.empty() ? model_->GetLink() : model_->GetLink(link_name);
+      if (link == NULL)
+        gzthrow("[gazebo_controller_interface] Couldn't find specified link \""
+                << link_name << "\".");
+      link_state_ = RigidBodyStateCache::Get(link);
+
+      controller_->InitializeParams();
+      gzmsg << "[gazebo_controller_interface] Running " << controller_name_
+            << " every " << controller_update_divisor_ << " physics steps.\n";
+    } else {
+      std::string controller_names;
+      for (const std::string& name :
+           rotors_control::ControllerFactory::Instance().ControllerNames())
+        controller_names += " " + name;
+      gzerr << "[gazebo_controller_interface] Unknown controller \""
+            << controller_name_ << "\", available controllers:"
+            << controller_names << ". Relaying the motor commands.\n";
+    }
+#else
+    gzerr << "[gazebo_controller_interface] Built without rotors_control,"
+          << " can't run controller \"" << controller_name_
+          << "\". Relaying the motor commands.\n";
+#endif
+  }
+
+  // Frame ID is not used for this particular message
+  turning_velocities_msg_.mutable_header()->set_frame_id("");
 
-  // Listen to the update event. This event is broadcast every
-  // simulation iteration.
-  updateConnection_ = event::Events::ConnectWorldUpdateBegin(
+  // Listen to the update event, either directly or through the update
+  // dispatcher of the world. This event is broadcast every simulation
+  // iteration.
+  updateConnection_ = UpdateDispatcher::Connect(
+      _model, _sdf, "gazebo_controller_interface", kUpdatePriorityCommand,
       boost::bind(&GazeboControllerInterface::OnUpdate, this, _1));
 }
 
 void GazeboControllerInterface::OnUpdate(const common::UpdateInfo& /*_info*/) {
-  if (kPrintOnUpdates) {
-    gzdbg << __FUNCTION__ << "() called." << std::endl;
-  }
+  ROTORS_PROFILE_SCOPE("gazebo_controller_interface");
 
   if (!pubs_and_subs_created_) {
     CreatePubsAndSubs();
     pubs_and_subs_created_ = true;
   }
 
+  if (command_mailbox_.Fetch(mailbox_command_.sequence, &mailbox_command_)) {
+    // Only allocates if the number of rotors changes.
+    input_reference_.resize(mailbox_command_.size);
+    for (std::size_t i = 0; i < mailbox_command_.size; ++i) {
+      input_reference_[i] = mailbox_command_.values[i];
+    }
+    received_first_reference_ = true;
+  }
+
   if (!received_first_reference_) {
     return;
   }
 
+#ifdef ROTORS_EMBEDDED_CONTROLLER
+  if (controller_) {
+    if (update_counter_++ % controller_update_divisor_ != 0)
+      return;
+    UpdateController();
+  }
+#endif
+
   common::Time now = world_->SimTime();
 
-  gz_sensor_msgs::Actuators turning_velocities_msg;
+  if (command_shm_.IsOpen()) {
+    command_record_.stamp.sec = now.sec;
+    command_record_.stamp.nsec = now.nsec;
+    command_record_.num_rotors =
+        std::min<int>(input_reference_.size(), kShmMaxRotors);
+    for (int i = 0; i < command_record_.num_rotors; ++i) {
+      command_record_.angular_velocities[i] = input_reference_[i];
+    }
+    command_shm_.Write(command_record_);
+    return;
+  }
 
+  ResizeRepeatedField(input_reference_.size(),
+                      turning_velocities_msg_.mutable_angular_velocities());
   for (int i = 0; i < input_reference_.size(); i++) {
-    turning_velocities_msg.add_angular_velocities((double)input_reference_[i]);
+    turning_velocities_msg_.set_angular_velocities(i, input_reference_[i]);
   }
 
-  turning_velocities_msg.mutable_header()->mutable_stamp()->set_sec(now.sec);
-  turning_velocities_msg.mutable_header()->mutable_stamp()->set_nsec(now.nsec);
+  turning_velocities_msg_.mutable_header()->mutable_stamp()->set_sec(now.sec);
+  turning_velocities_msg_.mutable_header()->mutable_stamp()->set_nsec(now.nsec);
 
-  // Frame ID is not used for this particular message
-  turning_velocities_msg.mutable_header()->set_frame_id("");
-
-  motor_velocity_reference_pub_->Publish(turning_velocities_msg);
+  motor_velocity_reference_pub_->Publish(turning_velocities_msg_);
 }
 
 void GazeboControllerInterface::CreatePubsAndSubs() {
   gzdbg << __FUNCTION__ << "() called." << std::endl;
 
-  // Create temporary "ConnectGazeboToRosTopic" publisher and message
-  gazebo::transport::PublisherPtr gz_connect_gazebo_to_ros_topic_pub =
-      node_handle_->Advertise<gz_std_msgs::ConnectGazeboToRosTopic>(
-          "~/" + kConnectGazeboToRosSubtopic, 1);
-
   // Create temporary "ConnectRosToGazeboTopic" publisher and message
   gazebo::transport::PublisherPtr gz_connect_ros_to_gazebo_topic_pub =
       node_handle_->Advertise<gz_std_msgs::ConnectRosToGazeboTopic>(
@@ -128,6 +203,17 @@ void GazeboControllerInterface::CreatePubsAndSubs() {
       node_handle_->Advertise<gz_sensor_msgs::Actuators>(
           namespace_ + "/" + motor_velocity_reference_pub_topic_, 1);
 
+  // The ring is named like the topic the motor models subscribe to.
+  if (shm_transport_) {
+    const std::string shm_name = ShmRingName(
+        "~/" + namespace_ + "/" + motor_velocity_reference_pub_topic_);
+    if (!command_shm_.Create(shm_name)) {
+      gzerr << "[gazebo_controller_interface] Can't create the shared memory"
+            << " ring \"" << shm_name << "\", publishing the motor commands"
+            << " instead.\n";
+    }
+  }
+
   // Connect to ROS
   gz_std_msgs::ConnectGazeboToRosTopic connect_gazebo_to_ros_topic_msg;
   connect_gazebo_to_ros_topic_msg.set_gazebo_topic(
@@ -136,8 +222,12 @@ void GazeboControllerInterface::CreatePubsAndSubs() {
       namespace_ + "/" + motor_velocity_reference_pub_topic_);
   connect_gazebo_to_ros_topic_msg.set_msgtype(
       gz_std_msgs::ConnectGazeboToRosTopic::ACTUATORS);
-  gz_connect_gazebo_to_ros_topic_pub->Publish(connect_gazebo_to_ros_topic_msg,
-                                              true);
+  if (command_shm_.IsOpen()) {
+    connect_gazebo_to_ros_topic_msg.set_shm_name(ShmRingName(
+        "~/" + namespace_ + "/" + motor_velocity_reference_pub_topic_));
+  }
+  ros_bridge_connector_.Add(connect_gazebo_to_ros_topic_msg);
+  ros_bridge_connector_.Publish(node_handle_);
 
   // ================================================ //
   // ===== MOTOR SPEED MSG SETUP (ROS -> GAZEBO) ==== //
@@ -161,24 +251,104 @@ void GazeboControllerInterface::CreatePubsAndSubs() {
   gz_connect_ros_to_gazebo_topic_pub->Publish(connect_ros_to_gazebo_topic_msg,
                                               true);
 
+#ifdef ROTORS_EMBEDDED_CONTROLLER
+  // =================================================== //
+  // ===== ATTITUDE THRUST MSG SETUP (ROS -> GAZEBO) ===== //
+  // =================================================== //
+  // Only an embedded controller can follow attitude references.
+  if (controller_) {
+    cmd_attitude_thrust_sub_ = node_handle_->Subscribe(
+        "~/" + namespace_ + "/" + command_attitude_thrust_sub_topic_,
+        &GazeboControllerInterface::CommandAttitudeThrustCallback, this);
+
+    connect_ros_to_gazebo_topic_msg.set_ros_topic(
+        namespace_ + "/" + command_attitude_thrust_sub_topic_);
+    connect_ros_to_gazebo_topic_msg.set_gazebo_topic(
+        "~/" + namespace_ + "/" + command_attitude_thrust_sub_topic_);
+    connect_ros_to_gazebo_topic_msg.set_msgtype(
+        gz_std_msgs::ConnectRosToGazeboTopic::ROLL_PITCH_YAWRATE_THRUST);
+    gz_connect_ros_to_gazebo_topic_pub->Publish(connect_ros_to_gazebo_topic_msg,
+                                                true);
+  }
+#endif
+
   gzdbg << __FUNCTION__ << "() called." << std::endl;
 }
 
+void GazeboControllerInterface::UpdateController() {
+#ifdef ROTORS_EMBEDDED_CONTROLLER
+  const RigidBodyState state = link_state_->State();
+  const ignition::math::Quaterniond& attitude = state.world_pose.Rot();
+  const ignition::math::Vector3d& angular_rate = state.relative_angular_vel;
+
+  std::lock_guard<std::mutex> lock(controller_mutex_);
+  controller_->SetAttitude(Eigen::Quaterniond(
+      attitude.W(), attitude.X(), attitude.Y(), attitude.Z()));
+  controller_->SetAngularRate(
+      Eigen::Vector3d(angular_rate.X(), angular_rate.Y(), angular_rate.Z()));
+  controller_->CalculateRotorVelocities(&input_reference_);
+#endif
+}
+
 void GazeboControllerInterface::CommandMotorCallback(
     GzActuatorsMsgPtr& actuators_msg) {
   if (kPrintOnMsgCallback) {
     gzdbg << __FUNCTION__ << "() called." << std::endl;
   }
 
-  input_reference_.resize(actuators_msg->angular_velocities_size());
-  for (int i = 0; i < actuators_msg->angular_velocities_size(); ++i) {
-    input_reference_[i] = actuators_msg->angular_velocities(i);
+  // Unstamped commands tell nothing about the latency.
+  const common::Time stamp(actuators_msg->header().stamp().sec(),
+                           actuators_msg->header().stamp().nsec());
+  if (stamp != common::Time::Zero) {
+    control_loop_->Report((world_->SimTime() - stamp).Double(), 0.0);
+  }
+
+#ifdef ROTORS_EMBEDDED_CONTROLLER
+  // The motor commands are the reference of an embedded controller.
+  if (controller_) {
+    Eigen::VectorXd motor_reference(actuators_msg->angular_velocities_size());
+    for (int i = 0; i < actuators_msg->angular_velocities_size(); ++i) {
+      motor_reference[i] = actuators_msg->angular_velocities(i);
+    }
+    std::lock_guard<std::mutex> lock(controller_mutex_);
+    controller_->SetMotorReference(motor_reference);
+    received_first_reference_ = true;
+    return;
+  }
+#endif
+
+  if (actuators_msg->angular_velocities_size() > kShmMaxRotors) {
+    gzerr << "[gazebo_controller_interface] Motor command for "
+          << actuators_msg->angular_velocities_size()
+          << " rotors, only the first " << kShmMaxRotors << " are applied.\n";
+  }
+  // Applied by OnUpdate() on the physics thread.
+  double command[kShmMaxRotors];
+  const int num_rotors =
+      std::min(actuators_msg->angular_velocities_size(), kShmMaxRotors);
+  for (int i = 0; i < num_rotors; ++i) {
+    command[i] = actuators_msg->angular_velocities(i);
+  }
+  command_mailbox_.Post(command, num_rotors, world_->SimTime().Double());
+}
+
+void GazeboControllerInterface::CommandAttitudeThrustCallback(
+    GzRollPitchYawrateThrustMsgPtr& roll_pitch_yawrate_thrust_msg) {
+  if (kPrintOnMsgCallback) {
+    gzdbg << __FUNCTION__ << "() called." << std::endl;
   }
 
-  // We have received a motor command reference (it may not be the first, but
-  // this
-  // does not matter)
+#ifdef ROTORS_EMBEDDED_CONTROLLER
+  // Multicopters use the z-component of the thrust.
+  const Eigen::Vector4d attitude_thrust_reference(
+      roll_pitch_yawrate_thrust_msg->roll(),
+      roll_pitch_yawrate_thrust_msg->pitch(),
+      roll_pitch_yawrate_thrust_msg->yaw_rate(),
+      roll_pitch_yawrate_thrust_msg->thrust().z());
+  std::lock_guard<std::mutex> lock(controller_mutex_);
+  controller_->SetAttitudeThrustReference(attitude_thrust_reference);
   received_first_reference_ = true;
+#endif
 }
 
 GZ_REGISTER_MODEL_PLUGIN(GazeboControllerInterface);
@@ -31,6 +31,7 @@ GazeboFwDynamicsPlugin::GazeboFwDynamicsPlugin()
       delta_flap_(0.0),
       delta_rudder_(0.0),
       throttle_(0.0),
+      use_coefficient_table_(kDefaultUseCoefficientTable),
       pubs_and_subs_created_(false) {
 }
 
@@ -114,16 +115,38 @@ void GazeboFwDynamicsPlugin::Load(physics::ModelPtr _model,
                            wind_speed_sub_topic_,
                            mav_msgs::default_topics::WIND_SPEED);
 
-  // Listen to the update event. This event is broadcast every
-  // simulation iteration.
-  this->updateConnection_ = event::Events::ConnectWorldUpdateBegin(
-          boost::bind(&GazeboFwDynamicsPlugin::OnUpdate, this, _1));
+  // Optionally tabulate the aerodynamic coefficients. Tabulated data from a
+  // YAML file replaces the alpha and beta polynomials.
+  std::string coefficient_table_yaml;
+  int coefficient_table_samples = kDefaultCoefficientTableSamples;
+  getSdfParam<bool>(_sdf, "useCoefficientTable", use_coefficient_table_,
+                    use_coefficient_table_);
+  getSdfParam<std::string>(_sdf, "coefficientTableYAML",
+                           coefficient_table_yaml, coefficient_table_yaml);
+  getSdfParam<int>(_sdf, "coefficientTableSamples", coefficient_table_samples,
+                   coefficient_table_samples);
+  if (!coefficient_table_yaml.empty())
+    use_coefficient_table_ = true;
+
+  if (use_coefficient_table_) {
+    coefficient_table_.Build(aero_params_, vehicle_params_,
+                             coefficient_table_samples);
+    if (!coefficient_table_yaml.empty()) {
+      coefficient_table_.LoadTableYAML(coefficient_table_yaml,
+                                       coefficient_table_samples);
+    }
+  }
+
+  // Listen to the update event, either directly or through the update
+  // dispatcher of the world. This event is broadcast every simulation
+  // iteration.
+  this->updateConnection_ = UpdateDispatcher::Connect(
+      _model, _sdf, "gazebo_fw_dynamics_plugin", kUpdatePriorityActuator,
+      boost::bind(&GazeboFwDynamicsPlugin::OnUpdate, this, _1));
 }
 
 void GazeboFwDynamicsPlugin::OnUpdate(const common::UpdateInfo& _info) {
-  if (kPrintOnUpdates) {
-    gzdbg << __FUNCTION__ << "() called." << std::endl;
-  }
+  ROTORS_PROFILE_SCOPE("gazebo_fw_dynamics_plugin");
 
   if (!pubs_and_subs_created_) {
     CreatePubsAndSubs();
@@ -160,12 +183,6 @@ void GazeboFwDynamicsPlugin::UpdateForcesAndMoments() {
   double beta = (V < kMinAirSpeedThresh) ? 0.0 : asin(v / V);
   double alpha = (u < kMinAirSpeedThresh) ? 0.0 : atan(w / u);
 
-  // Bound the angle of attack.
-  if (alpha > aero_params_.alpha_max)
-    alpha = aero_params_.alpha_max;
-  else if (alpha < aero_params_.alpha_min)
-    alpha = aero_params_.alpha_min;
-
   // Pre-compute the common component in the force and moment calculations.
   const double q_bar_S = 0.5 * kAirDensity * V * V * vehicle_params_.wing_surface;
 
@@ -175,28 +192,73 @@ void GazeboFwDynamicsPlugin::UpdateForcesAndMoments() {
   double flap_sum = 2.0 * delta_flap_;
   double flap_diff = 0.0;
 
+  // The coefficients of the terms which are nonlinear in a single variable,
+  // and the sine and cosine of alpha.
+  double c_alpha[FWCoefficientTable::kNumAlphaChannels];
+  double c_beta[FWCoefficientTable::kNumBetaChannels];
+  double c_aileron[FWCoefficientTable::kNumDeflectionChannels];
+  double c_flap[FWCoefficientTable::kNumDeflectionChannels];
+
+  if (use_coefficient_table_) {
+    // The lookups are bounded by the table ranges, which implies the bounds
+    // on the angle of attack.
+    alpha = coefficient_table_.alpha.Clamp(alpha);
+    coefficient_table_.alpha.Lookup(alpha, c_alpha);
+    coefficient_table_.beta.Lookup(beta, c_beta);
+    coefficient_table_.aileron_sum.Lookup(aileron_sum, c_aileron);
+    coefficient_table_.flap_sum.Lookup(flap_sum, c_flap);
+  } else {
+    // Bound the angle of attack.
+    if (alpha > aero_params_.alpha_max)
+      alpha = aero_params_.alpha_max;
+    else if (alpha < aero_params_.alpha_min)
+      alpha = aero_params_.alpha_min;
+
+    c_alpha[FWCoefficientTable::kAlphaDrag] = aero_params_.c_drag_alpha.dot(
+        Eigen::Vector3d(1.0, alpha, alpha * alpha));
+    c_alpha[FWCoefficientTable::kAlphaLift] = aero_params_.c_lift_alpha.dot(
+        Eigen::Vector4d(1.0, alpha, alpha * alpha, alpha * alpha * alpha));
+    c_alpha[FWCoefficientTable::kAlphaPitchMoment] =
+        aero_params_.c_pitch_moment_alpha.dot(Eigen::Vector2d(1.0, alpha));
+    c_alpha[FWCoefficientTable::kAlphaCos] = cos(alpha);
+    c_alpha[FWCoefficientTable::kAlphaSin] = sin(alpha);
+
+    c_beta[FWCoefficientTable::kBetaDrag] = aero_params_.c_drag_beta.dot(
+        Eigen::Vector3d(0.0, beta, beta * beta));
+    c_beta[FWCoefficientTable::kBetaSideForce] =
+        aero_params_.c_side_force_beta.dot(Eigen::Vector2d(0.0, beta));
+    c_beta[FWCoefficientTable::kBetaRollMoment] =
+        aero_params_.c_roll_moment_beta.dot(Eigen::Vector2d(0.0, beta));
+    c_beta[FWCoefficientTable::kBetaYawMoment] =
+        aero_params_.c_yaw_moment_beta.dot(Eigen::Vector2d(0.0, beta));
+
+    c_aileron[FWCoefficientTable::kDeflectionDrag] =
+        aero_params_.c_drag_delta_ail.dot(
+            Eigen::Vector3d(0.0, aileron_sum, aileron_sum * aileron_sum));
+    c_aileron[FWCoefficientTable::kDeflectionLift] =
+        aero_params_.c_lift_delta_ail.dot(Eigen::Vector2d(0.0, aileron_sum));
+
+    c_flap[FWCoefficientTable::kDeflectionDrag] =
+        aero_params_.c_drag_delta_flp.dot(
+            Eigen::Vector3d(0.0, flap_sum, flap_sum * flap_sum));
+    c_flap[FWCoefficientTable::kDeflectionLift] =
+        aero_params_.c_lift_delta_flp.dot(Eigen::Vector2d(0.0, flap_sum));
+  }
+
   // Compute the forces in the wind frame.
   const double drag = q_bar_S *
-      (aero_params_.c_drag_alpha.dot(
-           Eigen::Vector3d(1.0, alpha, alpha * alpha)) +
-       aero_params_.c_drag_beta.dot(
-           Eigen::Vector3d(0.0, beta, beta * beta)) +
-       aero_params_.c_drag_delta_ail.dot(
-           Eigen::Vector3d(0.0, aileron_sum, aileron_sum * aileron_sum)) +
-       aero_params_.c_drag_delta_flp.dot(
-           Eigen::Vector3d(0.0, flap_sum, flap_sum * flap_sum)));
+      (c_alpha[FWCoefficientTable::kAlphaDrag] +
+       c_beta[FWCoefficientTable::kBetaDrag] +
+       c_aileron[FWCoefficientTable::kDeflectionDrag] +
+       c_flap[FWCoefficientTable::kDeflectionDrag]);
 
   const double side_force = q_bar_S *
-      (aero_params_.c_side_force_beta.dot(
-           Eigen::Vector2d(0.0, beta)));
+      c_beta[FWCoefficientTable::kBetaSideForce];
 
   const double lift = q_bar_S *
-      (aero_params_.c_lift_alpha.dot(
-           Eigen::Vector4d(1.0, alpha, alpha * alpha, alpha * alpha * alpha)) +
-       aero_params_.c_lift_delta_ail.dot(
-           Eigen::Vector2d(0.0, aileron_sum)) +
-       aero_params_.c_lift_delta_flp.dot(
-           Eigen::Vector2d(0.0, flap_sum)));
+      (c_alpha[FWCoefficientTable::kAlphaLift] +
+       c_aileron[FWCoefficientTable::kDeflectionLift] +
+       c_flap[FWCoefficientTable::kDeflectionLift]);
 
   const Eigen::Vector3d forces_Wind(-drag, side_force, -lift);
 
@@ -212,8 +274,7 @@ void GazeboFwDynamicsPlugin::UpdateForcesAndMoments() {
 
   // Compute the moments in the wind frame.
   const double rolling_moment = q_bar_S * vehicle_params_.wing_span *
-      (aero_params_.c_roll_moment_beta.dot(
-           Eigen::Vector2d(0.0, beta)) +
+      (c_beta[FWCoefficientTable::kBetaRollMoment] +
        aero_params_.c_roll_moment_p.dot(
            Eigen::Vector2d(0.0, p_hat)) +
        aero_params_.c_roll_moment_r.dot(
@@ -224,16 +285,14 @@ void GazeboFwDynamicsPlugin::UpdateForcesAndMoments() {
            Eigen::Vector2d(0.0, flap_diff)));
 
   const double pitching_moment = q_bar_S * vehicle_params_.chord_length *
-      (aero_params_.c_pitch_moment_alpha.dot(
-           Eigen::Vector2d(1.0, alpha)) +
+      (c_alpha[FWCoefficientTable::kAlphaPitchMoment] +
        aero_params_.c_pitch_moment_q.dot(
            Eigen::Vector2d(0.0, q_hat)) +
        aero_params_.c_pitch_moment_delta_elv.dot(
            Eigen::Vector2d(0.0, delta_elevator_)));
 
   const double yawing_moment = q_bar_S * vehicle_params_.wing_span *
-      (aero_params_.c_yaw_moment_beta.dot(
-           Eigen::Vector2d(0.0, beta)) +
+      (c_beta[FWCoefficientTable::kBetaYawMoment] +
        aero_params_.c_yaw_moment_r.dot(
            Eigen::Vector2d(0.0, r_hat)) +
        aero_params_.c_yaw_moment_delta_rud.dot(
@@ -253,8 +312,10 @@ void GazeboFwDynamicsPlugin::UpdateForcesAndMoments() {
       sin(vehicle_params_.thrust_inclination));
 
   // Compute the transform between the body frame and the wind frame.
-  double ca = cos(alpha);
-  double sa = sin(alpha);
+  double ca = c_alpha[FWCoefficientTable::kAlphaCos];
+  double sa = c_alpha[FWCoefficientTable::kAlphaSin];
+  // The sideslip is not clamped to the range of the beta table, so its sine
+  // and cosine are not read from it.
   double cb = cos(beta);
   double sb = sin(beta);
 
@@ -30,7 +30,20 @@ GazeboGpsPlugin::GazeboGpsPlugin()
     : SensorPlugin(),
       // node_handle_(0),
       random_generator_(random_device_()),
-      pubs_and_subs_created_(false) {}
+      measurement_delay_(kDefaultGpsMeasurementDelay),
+      gps_sequence_(0),
+      pubs_and_subs_created_(false),
+      hor_pos_std_dev_(kDefaultHorPosStdDev),
+      ver_pos_std_dev_(kDefaultVerPosStdDev),
+      sky_visibility_(kDefaultSkyVisibility),
+      sky_map_num_threads_(kDefaultSkyMapNumThreads),
+      min_satellites_for_fix_(kDefaultMinSatellitesForFix),
+      multipath_std_dev_(kDefaultMultipathStdDev),
+      multipath_correlation_time_(kDefaultMultipathCorrelationTime),
+      standard_normal_(0.0, 1.0) {
+  multipath_bias_[0] = 0.0;
+  multipath_bias_[1] = 0.0;
+}
 
 GazeboGpsPlugin::~GazeboGpsPlugin() {
 }
@@ -75,8 +88,6 @@ void GazeboGpsPlugin::Load(sensors::SensorPtr _sensor, sdf::ElementPtr _sdf) {
           << "\"\n";
 
   // Retrieve the rest of the SDF parameters.
-  double hor_pos_std_dev;
-  double ver_pos_std_dev;
   double hor_vel_std_dev;
   double ver_vel_std_dev;
 
@@ -86,14 +97,49 @@ void GazeboGpsPlugin::Load(sensors::SensorPtr _sensor, sdf::ElementPtr _sdf) {
   getSdfParam<std::string>(_sdf, "groundSpeedTopic", ground_speed_topic_,
                            mav_msgs::default_topics::GROUND_SPEED);
 
-  getSdfParam<double>(_sdf, "horPosStdDev", hor_pos_std_dev,
+  getSdfParam<double>(_sdf, "horPosStdDev", hor_pos_std_dev_,
                       kDefaultHorPosStdDev);
-  getSdfParam<double>(_sdf, "verPosStdDev", ver_pos_std_dev,
+  getSdfParam<double>(_sdf, "verPosStdDev", ver_pos_std_dev_,
                       kDefaultVerPosStdDev);
   getSdfParam<double>(_sdf, "horVelStdDev", hor_vel_std_dev,
                       kDefaultHorVelStdDev);
   getSdfParam<double>(_sdf, "verVelStdDev", ver_vel_std_dev,
                       kDefaultVerVelStdDev);
+  getSdfParam<int>(_sdf, "measurementDelay", measurement_delay_,
+                   measurement_delay_);
+  if (measurement_delay_ < 0) {
+    gzthrow("[gazebo_gps_plugin] measurementDelay must not be negative.");
+  }
+  if (link_) {
+    gps_queue_.UseArena(
+        ModelArena::ForPlugin(link_->GetModel(), "gazebo_gps_plugin"));
+  }
+  gps_queue_.Reset(GpsQueue::CapacityFor(measurement_delay_));
+
+  getSdfParam<bool>(_sdf, "skyVisibility", sky_visibility_, sky_visibility_);
+  getSdfParam<double>(_sdf, "skyMapResolution", sky_params_.resolution,
+                      sky_params_.resolution);
+  getSdfParam<double>(_sdf, "skyMapMargin", sky_params_.margin,
+                      sky_params_.margin);
+  getSdfParam<int>(_sdf, "skyMapLevels", sky_params_.num_levels,
+                   sky_params_.num_levels);
+  getSdfParam<double>(_sdf, "skyMapLevelSpacing", sky_params_.level_spacing,
+                      sky_params_.level_spacing);
+  getSdfParam<double>(_sdf, "skyMapMinHeight", sky_params_.min_height,
+                      sky_params_.min_height);
+  getSdfParam<int>(_sdf, "skyMapNumThreads", sky_map_num_threads_,
+                   sky_map_num_threads_);
+  getSdfParam<int>(_sdf, "numSatellites", sky_params_.num_satellites,
+                   sky_params_.num_satellites);
+  getSdfParam<double>(_sdf, "satelliteMinElevation",
+                      sky_params_.satellite_min_elevation,
+                      sky_params_.satellite_min_elevation);
+  getSdfParam<int>(_sdf, "minSatellitesForFix", min_satellites_for_fix_,
+                   min_satellites_for_fix_);
+  getSdfParam<double>(_sdf, "multipathStdDev", multipath_std_dev_,
+                      multipath_std_dev_);
+  getSdfParam<double>(_sdf, "multipathCorrelationTime",
+                      multipath_correlation_time_, multipath_correlation_time_);
 
   // Connect to the sensor update event.
   this->updateConnection_ = this->parent_sensor_->ConnectUpdated(
@@ -121,8 +167,8 @@ void GazeboGpsPlugin::Load(sensors::SensorPtr _sensor, sdf::ElementPtr _sdf) {
   for (int i = 0; i < 9; i++) {
     switch (i) {
       case 0:
-        gz_gps_message_.add_position_covariance(hor_pos_std_dev *
-                                                hor_pos_std_dev);
+        gz_gps_message_.add_position_covariance(hor_pos_std_dev_ *
+                                                hor_pos_std_dev_);
         break;
       case 1:
       case 2:
@@ -130,8 +176,8 @@ void GazeboGpsPlugin::Load(sensors::SensorPtr _sensor, sdf::ElementPtr _sdf) {
         gz_gps_message_.add_position_covariance(0);
         break;
       case 4:
-        gz_gps_message_.add_position_covariance(hor_pos_std_dev *
-                                                hor_pos_std_dev);
+        gz_gps_message_.add_position_covariance(hor_pos_std_dev_ *
+                                                hor_pos_std_dev_);
         break;
       case 5:
       case 6:
@@ -139,8 +185,8 @@ void GazeboGpsPlugin::Load(sensors::SensorPtr _sensor, sdf::ElementPtr _sdf) {
         gz_gps_message_.add_position_covariance(0);
         break;
       case 8:
-        gz_gps_message_.add_position_covariance(ver_pos_std_dev *
-                                                ver_pos_std_dev);
+        gz_gps_message_.add_position_covariance(ver_pos_std_dev_ *
+                                                ver_pos_std_dev_);
         break;
     }
   }
@@ -153,9 +199,7 @@ void GazeboGpsPlugin::Load(sensors::SensorPtr _sensor, sdf::ElementPtr _sdf) {
 }
 
 void GazeboGpsPlugin::OnUpdate() {
-  if (kPrintOnUpdates) {
-    gzdbg << __FUNCTION__ << "() called." << std::endl;
-  }
+  ROTORS_PROFILE_SCOPE("gazebo_gps_plugin");
 
   if (!pubs_and_subs_created_) {
     CreatePubsAndSubs();
@@ -173,28 +217,113 @@ void GazeboGpsPlugin::OnUpdate() {
                                       ground_speed_n_[1](random_generator_),
                                       ground_speed_n_[2](random_generator_));
 
-  // Fill the GPS message.
   current_time = parent_sensor_->LastMeasurementTime();
 
-  gz_gps_message_.set_latitude(parent_sensor_->Latitude().Degree());
-  gz_gps_message_.set_longitude(parent_sensor_->Longitude().Degree());
-  gz_gps_message_.set_altitude(parent_sensor_->Altitude());
+  GpsMeasurement* measurement =
+      gps_queue_.Push(gps_sequence_ + measurement_delay_);
+  if (measurement != nullptr) {
+    measurement->stamp = current_time;
+    measurement->latitude = parent_sensor_->Latitude().Degree();
+    measurement->longitude = parent_sensor_->Longitude().Degree();
+    measurement->altitude = parent_sensor_->Altitude();
+    measurement->ground_speed = W_ground_speed_W_L;
+    measurement->has_fix = true;
+    measurement->noise_scale = 1.0;
+    if (sky_visibility_) {
+      ApplySkyVisibility(measurement);
+    }
+  }
+
+  if (gps_queue_.Ready(gps_sequence_)) {
+    PublishMeasurement(gps_queue_.Front());
+    gps_queue_.Pop();
+  }
+
+  ++gps_sequence_;
+}
+
+void GazeboGpsPlugin::ApplySkyVisibility(GpsMeasurement* measurement) {
+  if (!sky_map_) {
+    sky_map_ =
+        SkyVisibilityMap::Get(world_, sky_params_, sky_map_num_threads_);
+    last_multipath_time_ = measurement->stamp;
+  }
+
+  const int num_satellites = sky_map_->num_satellites();
+  const int num_visible =
+      sky_map_->VisibleSatellites(link_->WorldPose().Pos());
+  measurement->has_fix = num_visible >= min_satellites_for_fix_;
+  // The dilution of precision grows about with the inverse square root of
+  // the number of satellites in view.
+  measurement->noise_scale =
+      std::sqrt(static_cast<double>(num_satellites) / std::max(num_visible, 1));
+
+  // First order Gauss-Markov bias, in steady state its standard deviation is
+  // multipath_std_dev_ times the hidden part of the sky.
+  const double dt = std::max(
+      0.0, (measurement->stamp - last_multipath_time_).Double());
+  last_multipath_time_ = measurement->stamp;
+  const double decay = multipath_correlation_time_ > 0.0
+                           ? std::exp(-dt / multipath_correlation_time_)
+                           : 0.0;
+  const double hidden_fraction =
+      1.0 - static_cast<double>(num_visible) / num_satellites;
+  const double bias_std_dev = multipath_std_dev_ * hidden_fraction *
+                              std::sqrt(1.0 - decay * decay);
+  for (double& bias : multipath_bias_) {
+    bias = decay * bias + bias_std_dev * standard_normal_(random_generator_);
+  }
+
+  // The GPS sensor already adds the nominal noise, only the excess is added
+  // here.
+  const double excess = std::sqrt(
+      measurement->noise_scale * measurement->noise_scale - 1.0);
+  const double east = multipath_bias_[0] + hor_pos_std_dev_ * excess *
+                                               standard_normal_(random_generator_);
+  const double north = multipath_bias_[1] + hor_pos_std_dev_ * excess *
+                                                standard_normal_(random_generator_);
+  const double up =
+      ver_pos_std_dev_ * excess * standard_normal_(random_generator_);
+
+  const double lat_rad = measurement->latitude * M_PI / 180.0;
+  measurement->latitude += north / kGpsEarthRadius * 180.0 / M_PI;
+  measurement->longitude +=
+      east / (kGpsEarthRadius * std::cos(lat_rad)) * 180.0 / M_PI;
+  measurement->altitude += up;
+}
 
-  gz_gps_message_.mutable_header()->mutable_stamp()->set_sec(current_time.sec);
+void GazeboGpsPlugin::PublishMeasurement(const GpsMeasurement& measurement) {
+  // Fill the GPS message.
+  gz_gps_message_.set_status(measurement.has_fix
+                                 ? gz_sensor_msgs::NavSatFix::STATUS_FIX
+                                 : gz_sensor_msgs::NavSatFix::STATUS_NO_FIX);
+  const double scale_sq = measurement.noise_scale * measurement.noise_scale;
+  gz_gps_message_.set_position_covariance(
+      0, scale_sq * hor_pos_std_dev_ * hor_pos_std_dev_);
+  gz_gps_message_.set_position_covariance(
+      4, scale_sq * hor_pos_std_dev_ * hor_pos_std_dev_);
+  gz_gps_message_.set_position_covariance(
+      8, scale_sq * ver_pos_std_dev_ * ver_pos_std_dev_);
+  gz_gps_message_.set_latitude(measurement.latitude);
+  gz_gps_message_.set_longitude(measurement.longitude);
+  gz_gps_message_.set_altitude(measurement.altitude);
+
+  gz_gps_message_.mutable_header()->mutable_stamp()->set_sec(
+      measurement.stamp.sec);
   gz_gps_message_.mutable_header()->mutable_stamp()->set_nsec(
-      current_time.nsec);
+      measurement.stamp.nsec);
 
   // Fill the ground speed message.
   gz_ground_speed_message_.mutable_twist()->mutable_linear()->set_x(
-      W_ground_speed_W_L.X());
+      measurement.ground_speed.X());
   gz_ground_speed_message_.mutable_twist()->mutable_linear()->set_y(
-      W_ground_speed_W_L.Y());
+      measurement.ground_speed.Y());
   gz_ground_speed_message_.mutable_twist()->mutable_linear()->set_z(
-      W_ground_speed_W_L.Z());
+      measurement.ground_speed.Z());
   gz_ground_speed_message_.mutable_header()->mutable_stamp()->set_sec(
-      current_time.sec);
+      measurement.stamp.sec);
   gz_ground_speed_message_.mutable_header()->mutable_stamp()->set_nsec(
-      current_time.nsec);
+      measurement.stamp.nsec);
 
   // Publish the GPS message.
   gz_gps_pub_->Publish(gz_gps_message_);
@@ -204,11 +333,6 @@ void GazeboGpsPlugin::OnUpdate() {
 }
 
 void GazeboGpsPlugin::CreatePubsAndSubs() {
-  // Create temporary "ConnectGazeboToRosTopic" publisher and message
-  gazebo::transport::PublisherPtr connect_gazebo_to_ros_topic_pub =
-      node_handle_->Advertise<gz_std_msgs::ConnectGazeboToRosTopic>(
-          "~/" + kConnectGazeboToRosSubtopic, 1);
-
   gz_std_msgs::ConnectGazeboToRosTopic connect_gazebo_to_ros_topic_msg;
 
   // ============================================ //
@@ -222,8 +346,7 @@ void GazeboGpsPlugin::CreatePubsAndSubs() {
   connect_gazebo_to_ros_topic_msg.set_ros_topic(namespace_ + "/" + gps_topic_);
   connect_gazebo_to_ros_topic_msg.set_msgtype(
       gz_std_msgs::ConnectGazeboToRosTopic::NAV_SAT_FIX);
-  connect_gazebo_to_ros_topic_pub->Publish(connect_gazebo_to_ros_topic_msg,
-                                           true);
+  ros_bridge_connector_.Add(connect_gazebo_to_ros_topic_msg);
 
   // ============================================ //
   // == GROUND SPEED (TWIST STAMPED) MSG SETUP == //
@@ -238,7 +361,8 @@ void GazeboGpsPlugin::CreatePubsAndSubs() {
                                                 ground_speed_topic_);
   connect_gazebo_to_ros_topic_msg.set_msgtype(
       gz_std_msgs::ConnectGazeboToRosTopic::TWIST_STAMPED);
-  connect_gazebo_to_ros_topic_pub->Publish(connect_gazebo_to_ros_topic_msg);
+  ros_bridge_connector_.Add(connect_gazebo_to_ros_topic_msg);
+  ros_bridge_connector_.Publish(node_handle_);
 }
 
 GZ_REGISTER_SENSOR_PLUGIN(GazeboGpsPlugin);
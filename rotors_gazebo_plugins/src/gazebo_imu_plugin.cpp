@@ -41,6 +41,12 @@ GazeboImuPlugin::GazeboImuPlugin()
     : ModelPlugin(),
       node_handle_(0),
       velocity_prev_W_(0, 0, 0),
+      noise_dt_(-1.0),
+      measurement_delay_(kDefaultImuMeasurementDelay),
+      imu_sequence_(0),
+      imu_delta_rate_(kDefaultImuDeltaRate),
+      imu_delta_topic_(kDefaultImuDeltaTopic),
+      shm_transport_(kDefaultShmTransport),
       pubs_and_subs_created_(false) {}
 
 GazeboImuPlugin::~GazeboImuPlugin() {
@@ -84,6 +90,7 @@ void GazeboImuPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
   if (link_ == NULL)
     gzthrow("[gazebo_imu_plugin] Couldn't find specified link \"" << link_name_
                                                                   << "\".");
+  link_state_ = RigidBodyStateCache::Get(link_);
 
   frame_id_ = link_name_;
 
@@ -115,13 +122,35 @@ void GazeboImuPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
   getSdfParam<double>(_sdf, "accelerometerTurnOnBiasSigma",
                       imu_parameters_.accelerometer_turn_on_bias_sigma,
                       imu_parameters_.accelerometer_turn_on_bias_sigma);
+  getSdfParam<int>(_sdf, "measurementDelay", measurement_delay_,
+                   measurement_delay_);
+  if (measurement_delay_ < 0) {
+    gzthrow("[gazebo_imu_plugin] measurementDelay must not be negative.");
+  }
+  imu_queue_.UseArena(ModelArena::ForPlugin(model_, "gazebo_imu_plugin"));
+  imu_queue_.Reset(ImuQueue::CapacityFor(measurement_delay_));
+  getSdfParam<bool>(_sdf, "shmTransport", shm_transport_, shm_transport_);
+  getSdfParam<double>(_sdf, "deltaRate", imu_delta_rate_, imu_delta_rate_);
+  getSdfParam<std::string>(_sdf, "imuDeltaTopic", imu_delta_topic_,
+                           imu_delta_topic_);
+  if (imu_delta_rate_ < 0.0) {
+    gzthrow("[gazebo_imu_plugin] deltaRate must not be negative.");
+  }
+  imu_delta_scheduler_.SetRate(imu_delta_rate_);
 
   last_time_ = world_->SimTime();
+  fidelity_ = ModelFidelity::Get(model_, _sdf);
 
-  // Listen to the update event. This event is broadcast every
-  // simulation iteration.
-  this->updateConnection_ = event::Events::ConnectWorldUpdateBegin(
+  // Listen to the update event, either directly or through the update
+  // dispatcher of the world. This event is broadcast every simulation
+  // iteration.
+  this->updateConnection_ = UpdateDispatcher::Connect(
+      _model, _sdf, "gazebo_imu_plugin", kUpdatePrioritySensor,
       boost::bind(&GazeboImuPlugin::OnUpdate, this, _1));
+  checkpoint_connection_ = SimulationCheckpoint::Connect(
+      world_, model_->GetScopedName() + "/gazebo_imu_plugin/" + link_name_,
+      boost::bind(&GazeboImuPlugin::SaveCheckpoint, this, _1),
+      boost::bind(&GazeboImuPlugin::RestoreCheckpoint, this, _1));
 
   //==============================================//
   //====== POPULATE STATIC PARTS OF IMU MSG ======//
@@ -129,6 +158,7 @@ void GazeboImuPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
 
   //  imu_message_.header.frame_id = frame_id_;
   imu_message_.mutable_header()->set_frame_id(frame_id_);
+  imu_delta_message_.mutable_header()->set_frame_id(frame_id_);
 
   // We assume uncorrelated noise on the 3 channels -> only set diagonal
   // elements. Only the broadband noise component is considered, specified as a
@@ -191,6 +221,15 @@ void GazeboImuPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
     }
   }
 
+  for (int i = 0; i < 9; i++) {
+    imu_record_.orientation_covariance[i] =
+        imu_message_.orientation_covariance(i);
+    imu_record_.angular_velocity_covariance[i] =
+        imu_message_.angular_velocity_covariance(i);
+    imu_record_.linear_acceleration_covariance[i] =
+        imu_message_.linear_acceleration_covariance(i);
+  }
+
   gravity_W_ = world_->Gravity();
   imu_parameters_.gravity_magnitude = gravity_W_.Length();
 
@@ -210,63 +249,69 @@ void GazeboImuPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
   accelerometer_bias_.setZero();
 }
 
-void GazeboImuPlugin::AddNoise(Eigen::Vector3d* linear_acceleration,
-                               Eigen::Vector3d* angular_velocity,
-                               const double dt) {
-  GZ_ASSERT(linear_acceleration != nullptr, "Linear acceleration was null.");
-  GZ_ASSERT(angular_velocity != nullptr, "Angular velocity was null.");
-  GZ_ASSERT(dt > 0.0, "Change in time must be greater than 0.");
+void GazeboImuPlugin::UpdateNoiseCoefficients(const double dt) {
+  // With a fixed step size, the coefficients are only computed once.
+  if (dt == noise_dt_) {
+    return;
+  }
+  noise_dt_ = dt;
 
   // Gyrosocpe
   double tau_g = imu_parameters_.gyroscope_bias_correlation_time;
   // Discrete-time standard deviation equivalent to an "integrating" sampler
   // with integration time dt.
-  double sigma_g_d = 1 / sqrt(dt) * imu_parameters_.gyroscope_noise_density;
+  sigma_g_d_ = 1 / sqrt(dt) * imu_parameters_.gyroscope_noise_density;
   double sigma_b_g = imu_parameters_.gyroscope_random_walk;
   // Compute exact covariance of the process after dt [Maybeck 4-114].
-  double sigma_b_g_d = sqrt(-sigma_b_g * sigma_b_g * tau_g / 2.0 *
-                            (exp(-2.0 * dt / tau_g) - 1.0));
+  sigma_b_g_d_ = sqrt(-sigma_b_g * sigma_b_g * tau_g / 2.0 *
+                      (exp(-2.0 * dt / tau_g) - 1.0));
   // Compute state-transition.
-  double phi_g_d = exp(-1.0 / tau_g * dt);
-  // Simulate gyroscope noise processes and add them to the true angular rate.
-  for (int i = 0; i < 3; ++i) {
-    gyroscope_bias_[i] =
-        phi_g_d * gyroscope_bias_[i] +
-        sigma_b_g_d * standard_normal_distribution_(random_generator_);
-    (*angular_velocity)[i] =
-        (*angular_velocity)[i] + gyroscope_bias_[i] +
-        sigma_g_d * standard_normal_distribution_(random_generator_) +
-        gyroscope_turn_on_bias_[i];
-  }
+  phi_g_d_ = exp(-1.0 / tau_g * dt);
 
   // Accelerometer
   double tau_a = imu_parameters_.accelerometer_bias_correlation_time;
   // Discrete-time standard deviation equivalent to an "integrating" sampler
   // with integration time dt.
-  double sigma_a_d = 1 / sqrt(dt) * imu_parameters_.accelerometer_noise_density;
+  sigma_a_d_ = 1 / sqrt(dt) * imu_parameters_.accelerometer_noise_density;
   double sigma_b_a = imu_parameters_.accelerometer_random_walk;
   // Compute exact covariance of the process after dt [Maybeck 4-114].
-  double sigma_b_a_d = sqrt(-sigma_b_a * sigma_b_a * tau_a / 2.0 *
-                            (exp(-2.0 * dt / tau_a) - 1.0));
+  sigma_b_a_d_ = sqrt(-sigma_b_a * sigma_b_a * tau_a / 2.0 *
+                      (exp(-2.0 * dt / tau_a) - 1.0));
   // Compute state-transition.
-  double phi_a_d = exp(-1.0 / tau_a * dt);
+  phi_a_d_ = exp(-1.0 / tau_a * dt);
+}
+
+void GazeboImuPlugin::AddNoise(Eigen::Vector3d* linear_acceleration,
+                               Eigen::Vector3d* angular_velocity,
+                               const double dt) {
+  GZ_ASSERT(linear_acceleration != nullptr, "Linear acceleration was null.");
+  GZ_ASSERT(angular_velocity != nullptr, "Angular velocity was null.");
+  GZ_ASSERT(dt > 0.0, "Change in time must be greater than 0.");
+
+  UpdateNoiseCoefficients(dt);
+
+  // Simulate gyroscope noise processes and add them to the true angular rate.
+  for (int i = 0; i < 3; ++i) {
+    gyroscope_bias_[i] =
+        phi_g_d_ * gyroscope_bias_[i] + sigma_b_g_d_ * normal_samples_.Next();
+    (*angular_velocity)[i] =
+        (*angular_velocity)[i] + gyroscope_bias_[i] +
+        sigma_g_d_ * normal_samples_.Next() + gyroscope_turn_on_bias_[i];
+  }
+
   // Simulate accelerometer noise processes and add them to the true linear
   // acceleration.
   for (int i = 0; i < 3; ++i) {
     accelerometer_bias_[i] =
-        phi_a_d * accelerometer_bias_[i] +
-        sigma_b_a_d * standard_normal_distribution_(random_generator_);
+        phi_a_d_ * accelerometer_bias_[i] + sigma_b_a_d_ * normal_samples_.Next();
     (*linear_acceleration)[i] =
         (*linear_acceleration)[i] + accelerometer_bias_[i] +
-        sigma_a_d * standard_normal_distribution_(random_generator_) +
-        accelerometer_turn_on_bias_[i];
+        sigma_a_d_ * normal_samples_.Next() + accelerometer_turn_on_bias_[i];
   }
 }
 
 void GazeboImuPlugin::OnUpdate(const common::UpdateInfo& _info) {
-  if (kPrintOnUpdates) {
-    gzdbg << __FUNCTION__ << "() called." << std::endl;
-  }
+  ROTORS_PROFILE_SCOPE("gazebo_imu_plugin");
 
   if (!pubs_and_subs_created_) {
     CreatePubsAndSubs();
@@ -278,27 +323,92 @@ void GazeboImuPlugin::OnUpdate(const common::UpdateInfo& _info) {
   last_time_ = current_time;
   double t = current_time.Double();
 
-  ignition::math::Pose3d T_W_I = link_->WorldPose();  // TODO(burrimi): Check tf.
+  const bool low_fidelity = fidelity_->low();
+  if (fidelity_->Skip(world_->Iterations())) {
+    ++imu_sequence_;
+    return;
+  }
+
+  const RigidBodyState state = link_state_->State();
+  ignition::math::Pose3d T_W_I = state.world_pose;  // TODO(burrimi): Check tf.
   ignition::math::Quaterniond C_W_I = T_W_I.Rot();
 
   ignition::math::Vector3d acceleration_I =
-      link_->RelativeLinearAccel() - C_W_I.RotateVectorReverse(gravity_W_);
+      state.relative_linear_accel - C_W_I.RotateVectorReverse(gravity_W_);
 
-  ignition::math::Vector3d angular_vel_I = link_->RelativeAngularVel();
+  ignition::math::Vector3d angular_vel_I = state.relative_angular_vel;
 
   Eigen::Vector3d linear_acceleration_I(acceleration_I.X(), acceleration_I.Y(),
                                         acceleration_I.Z());
   Eigen::Vector3d angular_velocity_I(angular_vel_I.X(), angular_vel_I.Y(),
                                      angular_vel_I.Z());
 
+  // At low fidelity, the ground truth is published right away, without noise
+  // and delay.
+  if (low_fidelity) {
+    if (!imu_queue_.Empty()) {
+      imu_queue_.Reset(imu_queue_.Capacity());
+    }
+    ImuMeasurement ground_truth;
+    ground_truth.stamp = current_time;
+    ground_truth.orientation = C_W_I;
+    ground_truth.linear_acceleration = linear_acceleration_I;
+    ground_truth.angular_velocity = angular_velocity_I;
+    PublishMeasurement(ground_truth);
+    ++imu_sequence_;
+    return;
+  }
+
   AddNoise(&linear_acceleration_I, &angular_velocity_I, dt);
 
+  ImuMeasurement* measurement =
+      imu_queue_.Push(imu_sequence_ + measurement_delay_);
+  if (measurement != nullptr) {
+    measurement->stamp = current_time;
+    measurement->orientation = C_W_I;
+    measurement->linear_acceleration = linear_acceleration_I;
+    measurement->angular_velocity = angular_velocity_I;
+  }
+
+  if (imu_queue_.Ready(imu_sequence_)) {
+    PublishMeasurement(imu_queue_.Front());
+    imu_queue_.Pop();
+  }
+
+  ++imu_sequence_;
+}
+
+void GazeboImuPlugin::PublishMeasurement(const ImuMeasurement& measurement) {
+  if (imu_delta_rate_ > 0.0) {
+    IntegrateMeasurement(measurement);
+  }
+
+  if (imu_shm_.IsOpen()) {
+    imu_record_.stamp.sec = measurement.stamp.sec;
+    imu_record_.stamp.nsec = measurement.stamp.nsec;
+    imu_record_.orientation[0] = measurement.orientation.W();
+    imu_record_.orientation[1] = measurement.orientation.X();
+    imu_record_.orientation[2] = measurement.orientation.Y();
+    imu_record_.orientation[3] = measurement.orientation.Z();
+    for (int i = 0; i < 3; i++) {
+      imu_record_.angular_velocity[i] = measurement.angular_velocity[i];
+      imu_record_.linear_acceleration[i] = measurement.linear_acceleration[i];
+    }
+    imu_shm_.Write(imu_record_);
+  }
+  if ((imu_shm_.IsOpen() || imu_delta_rate_ > 0.0) &&
+      !imu_pub_->HasConnections()) {
+    return;
+  }
+
   // Fill IMU message.
   //  imu_message_.header.stamp.sec = current_time.sec;
-  imu_message_.mutable_header()->mutable_stamp()->set_sec(current_time.sec);
+  imu_message_.mutable_header()->mutable_stamp()->set_sec(
+      measurement.stamp.sec);
 
   //  imu_message_.header.stamp.nsec = current_time.nsec;
-  imu_message_.mutable_header()->mutable_stamp()->set_nsec(current_time.nsec);
+  imu_message_.mutable_header()->mutable_stamp()->set_nsec(
+      measurement.stamp.nsec);
 
   /// \todo(burrimi): Add orientation estimator.
   // NOTE: rotors_simulator used to set the orientation to "0", since it is
@@ -312,24 +422,23 @@ void GazeboImuPlugin::OnUpdate(const common::UpdateInfo& _info) {
   imu_message_.set_allocated_orientation(orientation);*/
 
   /// \todo(burrimi): add noise.
-  gazebo::msgs::Quaternion* orientation = new gazebo::msgs::Quaternion();
-  orientation->set_w(C_W_I.W());
-  orientation->set_x(C_W_I.X());
-  orientation->set_y(C_W_I.Y());
-  orientation->set_z(C_W_I.Z());
-  imu_message_.set_allocated_orientation(orientation);
-
-  gazebo::msgs::Vector3d* linear_acceleration = new gazebo::msgs::Vector3d();
-  linear_acceleration->set_x(linear_acceleration_I[0]);
-  linear_acceleration->set_y(linear_acceleration_I[1]);
-  linear_acceleration->set_z(linear_acceleration_I[2]);
-  imu_message_.set_allocated_linear_acceleration(linear_acceleration);
-
-  gazebo::msgs::Vector3d* angular_velocity = new gazebo::msgs::Vector3d();
-  angular_velocity->set_x(angular_velocity_I[0]);
-  angular_velocity->set_y(angular_velocity_I[1]);
-  angular_velocity->set_z(angular_velocity_I[2]);
-  imu_message_.set_allocated_angular_velocity(angular_velocity);
+  // The sub-messages are owned by imu_message_ and reused on every update.
+  gazebo::msgs::Quaternion* orientation = imu_message_.mutable_orientation();
+  orientation->set_w(measurement.orientation.W());
+  orientation->set_x(measurement.orientation.X());
+  orientation->set_y(measurement.orientation.Y());
+  orientation->set_z(measurement.orientation.Z());
+
+  gazebo::msgs::Vector3d* linear_acceleration =
+      imu_message_.mutable_linear_acceleration();
+  linear_acceleration->set_x(measurement.linear_acceleration[0]);
+  linear_acceleration->set_y(measurement.linear_acceleration[1]);
+  linear_acceleration->set_z(measurement.linear_acceleration[2]);
+
+  gazebo::msgs::Vector3d* angular_velocity = imu_message_.mutable_angular_velocity();
+  angular_velocity->set_x(measurement.angular_velocity[0]);
+  angular_velocity->set_y(measurement.angular_velocity[1]);
+  angular_velocity->set_z(measurement.angular_velocity[2]);
 
   // Publish the IMU message
   imu_pub_->Publish(imu_message_);
@@ -337,12 +446,47 @@ void GazeboImuPlugin::OnUpdate(const common::UpdateInfo& _info) {
   // std::cout << "Published IMU message.\n";
 }
 
-void GazeboImuPlugin::CreatePubsAndSubs() {
-  // Create temporary "ConnectGazeboToRosTopic" publisher and message
-  gazebo::transport::PublisherPtr connect_gazebo_to_ros_topic_pub =
-      node_handle_->Advertise<gz_std_msgs::ConnectGazeboToRosTopic>(
-          "~/" + kConnectGazeboToRosSubtopic, 1);
+void GazeboImuPlugin::IntegrateMeasurement(
+    const ImuMeasurement& measurement) {
+  // Each sample is held from the previous one, the first one after a start
+  // or a reset only starts the integration.
+  const double dt = (measurement.stamp - last_integrated_stamp_).Double();
+  const bool first = last_integrated_stamp_ == common::Time::Zero || dt <= 0.0;
+  last_integrated_stamp_ = measurement.stamp;
+  if (first) {
+    imu_delta_integrator_.Reset();
+    imu_delta_scheduler_.Due(measurement.stamp.Double());
+    return;
+  }
+  imu_delta_integrator_.Add(measurement.angular_velocity,
+                            measurement.linear_acceleration, dt);
+  if (!imu_delta_scheduler_.Due(measurement.stamp.Double())) {
+    return;
+  }
+
+  imu_delta_message_.mutable_header()->mutable_stamp()->set_sec(
+      measurement.stamp.sec);
+  imu_delta_message_.mutable_header()->mutable_stamp()->set_nsec(
+      measurement.stamp.nsec);
+  imu_delta_message_.set_dt(imu_delta_integrator_.dt());
+  const Eigen::Vector3d delta_angle = imu_delta_integrator_.DeltaAngle();
+  gazebo::msgs::Vector3d* angle = imu_delta_message_.mutable_delta_angle();
+  angle->set_x(delta_angle[0]);
+  angle->set_y(delta_angle[1]);
+  angle->set_z(delta_angle[2]);
+  const Eigen::Vector3d delta_velocity = imu_delta_integrator_.DeltaVelocity();
+  gazebo::msgs::Vector3d* velocity =
+      imu_delta_message_.mutable_delta_velocity();
+  velocity->set_x(delta_velocity[0]);
+  velocity->set_y(delta_velocity[1]);
+  velocity->set_z(delta_velocity[2]);
+  imu_delta_message_.set_num_samples(imu_delta_integrator_.num_samples());
+  imu_delta_pub_->Publish(imu_delta_message_);
+
+  imu_delta_integrator_.StartInterval();
+}
 
+void GazeboImuPlugin::CreatePubsAndSubs() {
   // ============================================ //
   // =============== IMU MSG SETUP ============== //
   // ============================================ //
@@ -357,8 +501,101 @@ void GazeboImuPlugin::CreatePubsAndSubs() {
   connect_gazebo_to_ros_topic_msg.set_ros_topic(namespace_ + "/" + imu_topic_);
   connect_gazebo_to_ros_topic_msg.set_msgtype(
       gz_std_msgs::ConnectGazeboToRosTopic::IMU);
-  connect_gazebo_to_ros_topic_pub->Publish(connect_gazebo_to_ros_topic_msg,
-                                           true);
+  if (shm_transport_) {
+    const std::string shm_name =
+        ShmRingName("~/" + namespace_ + "/" + imu_topic_);
+    if (imu_shm_.Create(shm_name, frame_id_)) {
+      connect_gazebo_to_ros_topic_msg.set_shm_name(shm_name);
+    } else {
+      gzerr << "[gazebo_imu_plugin] Can't create the shared memory ring \""
+            << shm_name << "\", publishing over Gazebo transport only.\n";
+    }
+  }
+  // In the delta mode only the preintegrated measurements go to ROS.
+  if (imu_delta_rate_ > 0.0) {
+    imu_delta_pub_ = node_handle_->Advertise<gz_sensor_msgs::ImuDelta>(
+        "~/" + namespace_ + "/" + imu_delta_topic_, 1);
+
+    gz_std_msgs::ConnectGazeboToRosTopic connect_imu_delta_msg;
+    connect_imu_delta_msg.set_gazebo_topic("~/" + namespace_ + "/" +
+                                           imu_delta_topic_);
+    connect_imu_delta_msg.set_ros_topic(namespace_ + "/" + imu_delta_topic_);
+    connect_imu_delta_msg.set_msgtype(
+        gz_std_msgs::ConnectGazeboToRosTopic::IMU_DELTA);
+    ros_bridge_connector_.Add(connect_imu_delta_msg);
+  } else {
+    ros_bridge_connector_.Add(connect_gazebo_to_ros_topic_msg);
+  }
+  ros_bridge_connector_.Publish(node_handle_);
+}
+
+void GazeboImuPlugin::SaveCheckpoint(CheckpointWriter* writer) {
+  writer->WriteText(random_generator_);
+  writer->WriteText(standard_normal_distribution_);
+  uint64_t sample_state[2];
+  std::size_t sample_index;
+  normal_samples_.GetState(sample_state, &sample_index);
+  writer->WriteArray(sample_state, 2);
+  writer->Write<uint64_t>(sample_index);
+
+  WriteCheckpoint(last_time_, writer);
+  WriteCheckpoint(velocity_prev_W_, writer);
+  WriteCheckpoint(gyroscope_bias_, writer);
+  WriteCheckpoint(accelerometer_bias_, writer);
+  WriteCheckpoint(gyroscope_turn_on_bias_, writer);
+  WriteCheckpoint(accelerometer_turn_on_bias_, writer);
+
+  writer->Write<int32_t>(imu_sequence_);
+  writer->Write<uint64_t>(imu_queue_.Size());
+  for (std::size_t i = 0u; i < imu_queue_.Size(); ++i) {
+    const ImuMeasurement& measurement = imu_queue_.At(i);
+    writer->Write<int32_t>(imu_queue_.ReleaseAt(i));
+    WriteCheckpoint(measurement.stamp, writer);
+    WriteCheckpoint(measurement.orientation, writer);
+    WriteCheckpoint(measurement.linear_acceleration, writer);
+    WriteCheckpoint(measurement.angular_velocity, writer);
+  }
+}
+
+bool GazeboImuPlugin::RestoreCheckpoint(CheckpointReader* reader) {
+  reader->ReadText(&random_generator_);
+  reader->ReadText(&standard_normal_distribution_);
+  uint64_t sample_state[2];
+  uint64_t sample_index = 0;
+  if (reader->ReadArray(sample_state, 2) && reader->Read(&sample_index)) {
+    normal_samples_.SetState(sample_state, sample_index);
+  }
+
+  ReadCheckpoint(reader, &last_time_);
+  ReadCheckpoint(reader, &velocity_prev_W_);
+  ReadCheckpoint(reader, &gyroscope_bias_);
+  ReadCheckpoint(reader, &accelerometer_bias_);
+  ReadCheckpoint(reader, &gyroscope_turn_on_bias_);
+  ReadCheckpoint(reader, &accelerometer_turn_on_bias_);
+
+  int32_t sequence = 0;
+  uint64_t queue_size = 0;
+  reader->Read(&sequence);
+  reader->Read(&queue_size);
+  imu_sequence_ = sequence;
+  imu_queue_.Reset(imu_queue_.Capacity());
+  for (uint64_t i = 0u; i < queue_size && reader->ok(); ++i) {
+    int32_t release = 0;
+    reader->Read(&release);
+    ImuMeasurement* measurement = imu_queue_.Push(release);
+    if (measurement == nullptr) {
+      gzerr << "[gazebo_imu_plugin] The checkpoint holds more delayed "
+            << "measurements than measurementDelay allows.\n";
+      return false;
+    }
+    ReadCheckpoint(reader, &measurement->stamp);
+    ReadCheckpoint(reader, &measurement->orientation);
+    ReadCheckpoint(reader, &measurement->linear_acceleration);
+    ReadCheckpoint(reader, &measurement->angular_velocity);
+  }
+  // The interval of the preintegrated measurements starts over.
+  last_integrated_stamp_ = common::Time::Zero;
+  return reader->ok();
 }
 
 GZ_REGISTER_MODEL_PLUGIN(GazeboImuPlugin);
@@ -26,7 +26,10 @@ namespace gazebo {
 GazeboMagnetometerPlugin::GazeboMagnetometerPlugin()
     : ModelPlugin(),
       random_generator_(random_device_()),
-      pubs_and_subs_created_(false) {
+      local_tangent_plane_(kDefaultRefLatitude * M_PI / 180.0,
+                           kDefaultRefLongitude * M_PI / 180.0),
+      pubs_and_subs_created_(false),
+      measurement_divisor_(kDefaultMagnetometerMeasurementDivisor) {
   // Nothing
 }
 
@@ -65,6 +68,8 @@ void GazeboMagnetometerPlugin::Load(physics::ModelPtr _model,
   if (link_ == NULL)
     gzthrow("[gazebo_magnetometer_plugin] Couldn't find specified link \""
             << link_name << "\".");
+  link_state_ = RigidBodyStateCache::Get(link_);
+  fidelity_ = ModelFidelity::Get(model_, _sdf);
 
   frame_id_ = link_name;
 
@@ -82,13 +87,53 @@ void GazeboMagnetometerPlugin::Load(physics::ModelPtr _model,
   getSdfParam<double>(_sdf, "refMagNorth", ref_mag_north, kDefaultRefMagNorth);
   getSdfParam<double>(_sdf, "refMagEast", ref_mag_east, kDefaultRefMagEast);
   getSdfParam<double>(_sdf, "refMagDown", ref_mag_down, kDefaultRefMagDown);
+
+  // A geomagnetic grid replaces the reference field by the field at the
+  // position of the link, with the origin at the reference position.
+  std::string geo_magnetic_grid_path;
+  getSdfParam<std::string>(_sdf, "geoMagneticGrid", geo_magnetic_grid_path,
+                           geo_magnetic_grid_path);
+  if (!geo_magnetic_grid_path.empty()) {
+    double ref_latitude;
+    double ref_longitude;
+    getSdfParam<double>(_sdf, "refLatitude", ref_latitude, kDefaultRefLatitude);
+    getSdfParam<double>(_sdf, "refLongitude", ref_longitude,
+                        kDefaultRefLongitude);
+    local_tangent_plane_ = LocalTangentPlane(ref_latitude * M_PI / 180.0,
+                                             ref_longitude * M_PI / 180.0);
+
+    if (!geo_magnetic_grid_.Load(geo_magnetic_grid_path) ||
+        !geo_magnetic_grid_.InterpolateNED(
+            local_tangent_plane_.ref_lat_rad(),
+            local_tangent_plane_.ref_lon_rad(), &geo_magnetic_cell_,
+            &ref_mag_north, &ref_mag_east, &ref_mag_down)) {
+      gzerr << "[gazebo_magnetometer_plugin] Could not look up the reference "
+            << "position in the geomagnetic grid \"" << geo_magnetic_grid_path
+            << "\", using refMagNorth/East/Down.\n";
+      geo_magnetic_grid_.Clear();
+    }
+  }
+
   getSdfParam<SdfVector3>(_sdf, "noiseNormal", noise_normal, zeros3);
   getSdfParam<SdfVector3>(_sdf, "noiseUniformInitialBias",
                           noise_uniform_initial_bias, zeros3);
+  publish_policy_.Load(_sdf, "gazebo_magnetometer_plugin");
+  getSdfParam<int>(_sdf, "measurementDivisor", measurement_divisor_,
+                   measurement_divisor_);
+  if (measurement_divisor_ < 1) {
+    gzerr << "[gazebo_magnetometer_plugin] measurementDivisor must be "
+          << "positive, publishing every physics step.\n";
+    measurement_divisor_ = 1;
+  }
+  measurement_offset_ = UpdateDispatcher::Stagger(
+      world_, _sdf, "gazebo_magnetometer_plugin", "measurement",
+      measurement_divisor_);
 
-  // Listen to the update event. This event is broadcast every simulation
+  // Listen to the update event, either directly or through the update
+  // dispatcher of the world. This event is broadcast every simulation
   // iteration.
-  this->updateConnection_ = event::Events::ConnectWorldUpdateBegin(
+  this->updateConnection_ = UpdateDispatcher::Connect(
+      _model, _sdf, "gazebo_magnetometer_plugin", kUpdatePrioritySensor,
       boost::bind(&GazeboMagnetometerPlugin::OnUpdate, this, _1));
 
   // Create the normal noise distributions
@@ -107,9 +152,11 @@ void GazeboMagnetometerPlugin::Load(physics::ModelPtr _model,
 
   // Initialize the reference magnetic field vector in world frame, taking into
   // account the initial bias
-  mag_W_ = ignition::math::Vector3d (ref_mag_north + initial_bias[0](random_generator_),
-                         ref_mag_east + initial_bias[1](random_generator_),
-                         ref_mag_down + initial_bias[2](random_generator_));
+  mag_bias_W_.X() = initial_bias[0](random_generator_);
+  mag_bias_W_.Y() = initial_bias[1](random_generator_);
+  mag_bias_W_.Z() = initial_bias[2](random_generator_);
+  mag_W_ = ignition::math::Vector3d (ref_mag_north, ref_mag_east, ref_mag_down) +
+      mag_bias_W_;
 
   // Fill the static parts of the magnetometer message.
   mag_message_.mutable_header()->set_frame_id(frame_id_);
@@ -143,26 +190,58 @@ void GazeboMagnetometerPlugin::Load(physics::ModelPtr _model,
 }
 
 void GazeboMagnetometerPlugin::OnUpdate(const common::UpdateInfo& _info) {
-  if (kPrintOnUpdates) {
-    gzdbg << __FUNCTION__ << "() called." << std::endl;
-  }
+  ROTORS_PROFILE_SCOPE("gazebo_magnetometer_plugin");
 
   if (!pubs_and_subs_created_) {
     CreatePubsAndSubs();
     pubs_and_subs_created_ = true;
   }
 
+  // At low fidelity the rate divisor of the model replaces the
+  // measurement divisor.
+  const bool skip = fidelity_->low()
+                        ? fidelity_->Skip(world_->Iterations())
+                        : !measurement_offset_->Due(world_->Iterations());
+  if (skip) {
+    return;
+  }
+
   // Get the current pose and time from Gazebo
-  ignition::math::Pose3d T_W_B = link_->WorldPose();
+  ignition::math::Pose3d T_W_B = link_state_->State().world_pose;
   common::Time current_time = world_->SimTime();
 
-  // Calculate the magnetic field noise.
-  ignition::math::Vector3d mag_noise(noise_n_[0](random_generator_),
-                          noise_n_[1](random_generator_),
-                          noise_n_[2](random_generator_));
+  // Follow the field of the grid, which only needs to be read again when the
+  // link leaves the current grid cell.
+  if (!geo_magnetic_grid_.empty()) {
+    // The world frame is the north east down frame of mag_W_, so x points
+    // north and y points east.
+    double lat_rad, lon_rad;
+    local_tangent_plane_.ToGeodetic(T_W_B.Pos().X(), T_W_B.Pos().Y(), &lat_rad,
+                                    &lon_rad);
+    double north, east, down;
+    if (geo_magnetic_grid_.InterpolateNED(lat_rad, lon_rad, &geo_magnetic_cell_,
+                                          &north, &east, &down)) {
+      mag_W_ = ignition::math::Vector3d(north, east, down) + mag_bias_W_;
+    }
+  }
+
+  // Calculate the magnetic field noise. At low fidelity the field is
+  // published without noise and bias.
+  ignition::math::Vector3d mag_noise;
+  if (fidelity_->low()) {
+    mag_noise = -mag_bias_W_;
+  } else {
+    mag_noise.Set(noise_n_[0](random_generator_),
+                  noise_n_[1](random_generator_),
+                  noise_n_[2](random_generator_));
+  }
 
   // Rotate the earth magnetic field into the inertial frame
   ignition::math::Vector3d field_B = T_W_B.Rot().RotateVectorReverse(mag_W_ + mag_noise);
+  const double field_values[] = {field_B.X(), field_B.Y(), field_B.Z()};
+  if (!publish_policy_.ShouldPublish(current_time.Double(), field_values, 3)) {
+    return;
+  }
 
   // Fill the magnetic field message
   mag_message_.mutable_header()->mutable_stamp()->set_sec(current_time.sec);
@@ -176,11 +255,6 @@ void GazeboMagnetometerPlugin::OnUpdate(const common::UpdateInfo& _info) {
 }
 
 void GazeboMagnetometerPlugin::CreatePubsAndSubs() {
-  // Create temporary "ConnectGazeboToRosTopic" publisher and message
-  gazebo::transport::PublisherPtr connect_gazebo_to_ros_topic_pub =
-      node_handle_->Advertise<gz_std_msgs::ConnectGazeboToRosTopic>(
-          "~/" + kConnectGazeboToRosSubtopic, 1);
-
   // ============================================ //
   // ========= MAGNETIC FIELD MSG SETUP ========= //
   // ============================================ //
@@ -196,8 +270,8 @@ void GazeboMagnetometerPlugin::CreatePubsAndSubs() {
                                                 magnetometer_topic_);
   connect_gazebo_to_ros_topic_msg.set_msgtype(
       gz_std_msgs::ConnectGazeboToRosTopic::MAGNETIC_FIELD);
-  connect_gazebo_to_ros_topic_pub->Publish(connect_gazebo_to_ros_topic_msg,
-                                           true);
+  ros_bridge_connector_.Add(connect_gazebo_to_ros_topic_msg);
+  ros_bridge_connector_.Publish(node_handle_);
 }
 
 GZ_REGISTER_MODEL_PLUGIN(GazeboMagnetometerPlugin);
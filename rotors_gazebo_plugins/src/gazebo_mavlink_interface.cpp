@@ -46,6 +46,9 @@ static const float kEarthRadius_m = 6353000;  // m
 GZ_REGISTER_MODEL_PLUGIN(GazeboMavlinkInterface);
 
 GazeboMavlinkInterface::~GazeboMavlinkInterface() {
+  if (transport_) {
+    transport_->RemoveEndpoint(endpoint_);
+  }
 }
 
 void GazeboMavlinkInterface::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
@@ -56,9 +59,18 @@ void GazeboMavlinkInterface::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf
 
   // Store the pointer to the model.
   model_ = _model;
+  model_state_ = RigidBodyStateCache::Get(model_->GetLink());
 
   world_ = model_->GetWorld();
 
+  // The round trip to the autopilot is reported to the real time factor
+  // governor.
+  double control_deadline = kDefaultControlDeadline;
+  getSdfParam<double>(_sdf, "mavlink_control_deadline", control_deadline,
+                      control_deadline);
+  control_loop_ = ControlLoopMonitor::Connect(
+      world_, model_->GetName() + "/mavlink", control_deadline);
+
   namespace_.clear();
   if (_sdf->HasElement("robotNamespace")) {
     namespace_ = _sdf->GetElement("robotNamespace")->Get<std::string>();
@@ -75,10 +87,20 @@ void GazeboMavlinkInterface::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf
   gzdbg << "motorSpeedCommandPubTopic = \"" << motor_velocity_reference_pub_topic_ << "\"." << std::endl;
 
   getSdfParam<std::string>(_sdf, "imuSubTopic", imu_sub_topic_, imu_sub_topic_);
+  getSdfParam<bool>(_sdf, "shmTransport", shm_transport_, shm_transport_);
   getSdfParam<std::string>(_sdf, "lidarSubTopic", lidar_sub_topic_, lidar_sub_topic_);
   getSdfParam<std::string>(_sdf, "opticalFlowSubTopic",
       opticalFlow_sub_topic_, opticalFlow_sub_topic_);
 
+  std::string geo_magnetic_grid_path;
+  getSdfParam<std::string>(_sdf, "geoMagneticGrid", geo_magnetic_grid_path,
+                           geo_magnetic_grid_path);
+  if (!geo_magnetic_grid_path.empty() &&
+      !geo_magnetic_grid_.Load(geo_magnetic_grid_path)) {
+    gzerr << "[gazebo_mavlink_interface] Could not load the geomagnetic grid \""
+          << geo_magnetic_grid_path << "\", using the declination table.\n";
+  }
+
   // set input_reference_ from inputs.control
   input_reference_.resize(kNOutMax);
   joints_.resize(kNOutMax);
@@ -404,17 +426,23 @@ void GazeboMavlinkInterface::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf
     }
   }
 
-  // Listen to the update event. This event is broadcast every
-  // simulation iteration.
-  updateConnection_ = event::Events::ConnectWorldUpdateBegin(
+  // Listen to the update event, either directly or through the update
+  // dispatcher of the world. This event is broadcast every simulation
+  // iteration.
+  updateConnection_ = UpdateDispatcher::Connect(
+      _model, _sdf, "gazebo_mavlink_interface", kUpdatePriorityCommand,
       boost::bind(&GazeboMavlinkInterface::OnUpdate, this, _1));
 
   //==============================================//
   //============ GAZEBO PUB/SUB SETUP ============//
   //==============================================//
 
-  gzdbg << "Creating Gazebo subscriber on topic \"" << "~/" + namespace_ + "/" + imu_sub_topic_ << "\"." << std::endl;
-  imu_sub_ = node_handle_->Subscribe("~/" + namespace_ + "/" + imu_sub_topic_, &GazeboMavlinkInterface::ImuCallback, this);
+  // With shmTransport the IMU is read from the ring of the IMU plugin in
+  // OnUpdate() instead.
+  if (!shm_transport_) {
+    gzdbg << "Creating Gazebo subscriber on topic \"" << "~/" + namespace_ + "/" + imu_sub_topic_ << "\"." << std::endl;
+    imu_sub_ = node_handle_->Subscribe("~/" + namespace_ + "/" + imu_sub_topic_, &GazeboMavlinkInterface::ImuCallback, this);
+  }
 
   gzdbg << "Creating Gazebo subscriber on topic \"" << "~/" + namespace_ + "/" + lidar_sub_topic_ << "\"." << std::endl;
   lidar_sub_ = node_handle_->Subscribe("~/" + namespace_ + "/" + lidar_sub_topic_, &GazeboMavlinkInterface::LidarCallback, this);
@@ -425,6 +453,14 @@ void GazeboMavlinkInterface::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf
   // Publish gazebo's motor_speed message
   gzdbg << "Creating Gazebo publisher on topic \"" << "~/" + namespace_ + "/" + motor_velocity_reference_pub_topic_ << "\"." << std::endl;
   motor_velocity_reference_pub_ = node_handle_->Advertise<gz_mav_msgs::CommandMotorSpeed>("~/" + namespace_ + "/" + motor_velocity_reference_pub_topic_, 1);
+  if (shm_transport_) {
+    const std::string shm_name = ShmRingName(
+        "~/" + namespace_ + "/" + motor_velocity_reference_pub_topic_);
+    if (!command_shm_.Create(shm_name)) {
+      gzerr << "[gazebo_mavlink_interface] Can't create the shared memory ring \""
+            << shm_name << "\", publishing the motor commands instead.\n";
+    }
+  }
 
   // This topic is subscribed to by gazebo_geotagged_images_plugin.cpp
   /// \todo Should this be an absolute topic!?!
@@ -433,9 +469,23 @@ void GazeboMavlinkInterface::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf
 
 
   rotor_count_ = 5;
+  local_tangent_plane_ =
+      LocalTangentPlane(kLatZurich_rad, kLonZurich_rad, kEarthRadius_m);
   last_time_ = world_->SimTime();
-  last_gps_time_ = world_->SimTime();
-  gps_update_interval_ = 0.2;  // in seconds for 5Hz
+
+  double gps_rate = kDefaultMavlinkGpsRate;
+  double mag_rate = kDefaultMavlinkMagRate;
+  double baro_rate = kDefaultMavlinkBaroRate;
+  double ground_truth_rate = kDefaultMavlinkGroundTruthRate;
+  getSdfParam<double>(_sdf, "mavlink_gps_rate", gps_rate, gps_rate);
+  getSdfParam<double>(_sdf, "mavlink_mag_rate", mag_rate, mag_rate);
+  getSdfParam<double>(_sdf, "mavlink_baro_rate", baro_rate, baro_rate);
+  getSdfParam<double>(_sdf, "mavlink_ground_truth_rate", ground_truth_rate,
+                      ground_truth_rate);
+  gps_scheduler_.SetRate(gps_rate);
+  mag_scheduler_.SetRate(mag_rate);
+  baro_scheduler_.SetRate(baro_rate);
+  ground_truth_scheduler_.SetRate(ground_truth_rate);
 
   gravity_W_ = world_->Gravity();
 
@@ -467,91 +517,128 @@ void GazeboMavlinkInterface::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf
     mavlink_udp_port_ = _sdf->GetElement("mavlink_udp_port")->Get<int>();
   }
 
-  // try to setup udp socket for communcation with simulator
-  if ((fd_ = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
-    printf("create socket failed\n");
-    return;
+  int system_id = kDefaultMavlinkSystemId;
+  bool batched_transport = kDefaultMavlinkBatchedTransport;
+  bool shared_socket = kDefaultMavlinkSharedSocket;
+  getSdfParam<int>(_sdf, "mavlink_system_id", system_id, system_id);
+  getSdfParam<bool>(_sdf, "mavlink_batched_transport", batched_transport,
+                    batched_transport);
+  getSdfParam<bool>(_sdf, "mavlink_shared_socket", shared_socket, shared_socket);
+  getSdfParam<bool>(_sdf, "mavlink_lockstep", lockstep_, lockstep_);
+  getSdfParam<double>(_sdf, "mavlink_lockstep_timeout", lockstep_timeout_,
+                      lockstep_timeout_);
+  if (shared_socket && !_sdf->HasElement("mavlink_system_id")) {
+    // Vehicles on a shared socket are told apart by system ID. Without one,
+    // follow the PX4 multi-vehicle convention of port 14560 + i for the
+    // system ID 1 + i.
+    const int derived_id = kDefaultMavlinkSystemId +
+                           static_cast<int>(mavlink_udp_port_) -
+                           static_cast<int>(kDefaultMavlinkUdpPort);
+    if (derived_id >= 1 && derived_id <= 255) {
+      system_id = derived_id;
+    } else {
+      gzwarn << "[gazebo_mavlink_interface] Cannot derive a MAVLink system ID "
+             << "from port " << mavlink_udp_port_ << ", set mavlink_system_id "
+             << "for every vehicle on the shared socket.\n";
+    }
+  }
+  if (system_id < 1 || system_id > 255) {
+    gzerr << "[gazebo_mavlink_interface] mavlink_system_id must be in "
+          << "[1, 255], using " << kDefaultMavlinkSystemId << ".\n";
+    system_id = kDefaultMavlinkSystemId;
   }
 
-  memset((char *)&myaddr_, 0, sizeof(myaddr_));
-  myaddr_.sin_family = AF_INET;
-  myaddr_.sin_addr.s_addr = htonl(INADDR_ANY);
-  // Let the OS pick the port
-  myaddr_.sin_port = htons(0);
+  endpoint_->system_id = system_id;
+  memset(&endpoint_->remote_address, 0, sizeof(endpoint_->remote_address));
+  endpoint_->remote_address.sin_family = AF_INET;
+  endpoint_->remote_address.sin_addr.s_addr = mavlink_addr_;
+  endpoint_->remote_address.sin_port = htons(mavlink_udp_port_);
 
-  if (bind(fd_, (struct sockaddr *)&myaddr_, sizeof(myaddr_)) < 0) {
-    printf("bind failed\n");
+  if (shared_socket) {
+    transport_ = MavlinkTransport::GetShared(batched_transport);
+  } else {
+    transport_ = std::make_shared<MavlinkTransport>(batched_transport);
+  }
+  if (!transport_->Open()) {
+    transport_.reset();
     return;
   }
-
-  srcaddr_.sin_family = AF_INET;
-  srcaddr_.sin_addr.s_addr = mavlink_addr_;
-  srcaddr_.sin_port = htons(mavlink_udp_port_);
-  addrlen_ = sizeof(srcaddr_);
-
-  fds_[0].fd = fd_;
-  fds_[0].events = POLLIN;
-
-
+  transport_->AddEndpoint(endpoint_);
 }
 
 
 void GazeboMavlinkInterface::OnUpdate(const common::UpdateInfo& /*_info*/) {
+  ROTORS_PROFILE_SCOPE("gazebo_mavlink_interface");
 
   common::Time current_time = world_->SimTime();
   double dt = (current_time - last_time_).Double();
 
-  pollForMAVLinkMessages(dt, 1000);
+  if (shm_transport_) {
+    ReadShmImu();
+  }
+
+  if (lockstep_) {
+    handle_received_messages_lockstep();
+  } else {
+    handle_received_messages();
+  }
 
   handle_control(dt);
 
   if(received_first_reference_) {
 
-    gz_mav_msgs::CommandMotorSpeed turning_velocities_msg;
+    ResizeRepeatedField(input_reference_.size(),
+                        turning_velocities_msg_.mutable_motor_speed());
 
     for (int i = 0; i < input_reference_.size(); i++){
       if (last_actuator_time_ == 0 || (current_time - last_actuator_time_).Double() > 0.2) {
-        turning_velocities_msg.add_motor_speed(0);
+        turning_velocities_msg_.set_motor_speed(i, 0);
       } else {
-        turning_velocities_msg.add_motor_speed(input_reference_[i]);
+        turning_velocities_msg_.set_motor_speed(i, input_reference_[i]);
       }
     }
 
-    // TODO Add timestamp and Header
-    // turning_velocities_msg->header.stamp.sec = current_time.sec;
-    // turning_velocities_msg->header.stamp.nsec = current_time.nsec;
-
-    // gzerr << turning_velocities_msg.motor_speed(0) << "\n";
-    motor_velocity_reference_pub_->Publish(turning_velocities_msg);
+    // The motor models read the commands from the ring, nothing is published.
+    if (command_shm_.IsOpen()) {
+      command_record_.stamp.sec = current_time.sec;
+      command_record_.stamp.nsec = current_time.nsec;
+      command_record_.num_rotors = std::min<int>(
+          turning_velocities_msg_.motor_speed_size(), kShmMaxRotors);
+      std::copy(turning_velocities_msg_.motor_speed().begin(),
+                turning_velocities_msg_.motor_speed().begin() +
+                    command_record_.num_rotors,
+                command_record_.angular_velocities);
+      command_shm_.Write(command_record_);
+    } else {
+      // TODO Add timestamp and Header
+      // turning_velocities_msg->header.stamp.sec = current_time.sec;
+      // turning_velocities_msg->header.stamp.nsec = current_time.nsec;
+
+      // gzerr << turning_velocities_msg_.motor_speed(0) << "\n";
+      motor_velocity_reference_pub_->Publish(turning_velocities_msg_);
+    }
   }
 
   last_time_ = current_time;
 
   //send gps
-  ignition::math::Pose3d T_W_I = model_->WorldPose(); //TODO(burrimi): Check tf.
+  const RigidBodyState state = model_state_->State();
+  ignition::math::Pose3d T_W_I = state.world_pose; //TODO(burrimi): Check tf.
   ignition::math::Vector3d pos_W_I = T_W_I.Pos();  // Use the models' world position for GPS and pressure alt.
 
-  ignition::math::Vector3d velocity_current_W = model_->WorldLinearVel();  // Use the models' world position for GPS velocity.
+  // TODO: Remove GPS message from IMU plugin. Added gazebo GPS plugin. This is temp here.
+  // reproject local position to gps coordinates, also used by the ground
+  // truth and the magnetic field of SendImu(), the linearized projection is
+  // cheap enough for every step.
+  local_tangent_plane_.ToGeodetic(pos_W_I.Y(), pos_W_I.X(), &lat_rad_,
+                                  &lon_rad_);  // north, east
 
-  ignition::math::Vector3d velocity_current_W_xy = velocity_current_W;
-  velocity_current_W_xy.Z() = 0;
+  if (gps_scheduler_.Due(current_time.Double())) {
+    ignition::math::Vector3d velocity_current_W = state.world_linear_vel;  // Use the models' world position for GPS velocity.
 
-  // TODO: Remove GPS message from IMU plugin. Added gazebo GPS plugin. This is temp here.
-  // reproject local position to gps coordinates
-  double x_rad = pos_W_I.Y() / kEarthRadius_m; // north
-  double y_rad = pos_W_I.X() / kEarthRadius_m; // east
-  double c = sqrt(x_rad * x_rad + y_rad * y_rad);
-  double sin_c = sin(c);
-  double cos_c = cos(c);
-  if (c != 0.0) {
-    lat_rad_ = asin(cos_c * sin(kLatZurich_rad) + (x_rad * sin_c * cos(kLatZurich_rad)) / c);
-    lon_rad_ = (kLonZurich_rad + atan2(y_rad * sin_c, c * cos(kLatZurich_rad) * cos_c - x_rad * sin(kLatZurich_rad) * sin_c));
-  } else {
-   lat_rad_ = kLatZurich_rad;
-    lon_rad_ = kLonZurich_rad;
-  }
+    ignition::math::Vector3d velocity_current_W_xy = velocity_current_W;
+    velocity_current_W_xy.Z() = 0;
 
-  if (current_time.Double() - last_gps_time_.Double() > gps_update_interval_) {  // 5Hz
     // Raw UDP mavlink
     mavlink_hil_gps_t hil_gps_msg;
     hil_gps_msg.time_usec = current_time.nsec/1000;
@@ -589,7 +676,7 @@ void GazeboMavlinkInterface::OnUpdate(const common::UpdateInfo& /*_info*/) {
     }
     gps_debug_msg_count++;*/
 
-    send_mavlink_message(MAVLINK_MSG_ID_HIL_GPS, &hil_gps_msg, 200);
+    send_mavlink_message(MAVLINK_MSG_ID_HIL_GPS, &hil_gps_msg, 200, &endpoint_->update_outbound);
 
     // Also publish GPS info on Gazebo topic
     msgs::Vector3d gps_msg;
@@ -597,18 +684,19 @@ void GazeboMavlinkInterface::OnUpdate(const common::UpdateInfo& /*_info*/) {
     gps_msg.set_y(lon_rad_ * 180. / M_PI);
     gps_msg.set_z(hil_gps_msg.alt / 1000.f);
     gps_pub_->Publish(gps_msg);
-
-    last_gps_time_ = current_time;
   }
 }
 
-void GazeboMavlinkInterface::send_mavlink_message(const uint8_t msgid, const void *msg, uint8_t component_ID) {
+void GazeboMavlinkInterface::send_mavlink_message(const uint8_t msgid, const void *msg, uint8_t component_ID,
+                                                  MavlinkEndpoint::OutboundQueue* queue) {
 
   component_ID = 0;
   uint8_t payload_len = mavlink_message_lengths[msgid];
   unsigned packet_len = payload_len + MAVLINK_NUM_NON_PAYLOAD_BYTES;
 
-  uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+  MavlinkPacket packet;
+  packet.length = packet_len;
+  uint8_t* buf = packet.data;
 
   // Header
   buf[0] = MAVLINK_STX;
@@ -631,12 +719,9 @@ void GazeboMavlinkInterface::send_mavlink_message(const uint8_t msgid, const voi
   buf[MAVLINK_NUM_HEADER_BYTES + payload_len] = (uint8_t)(checksum & 0xFF);
   buf[MAVLINK_NUM_HEADER_BYTES + payload_len + 1] = (uint8_t)(checksum >> 8);
 
-  ssize_t len;
-
-  len = sendto(fd_, buf, packet_len, 0, (struct sockaddr *)&srcaddr_, sizeof(srcaddr_));
-
-  if (len <= 0) {
-    printf("Failed sending mavlink message\n");
+  // The I/O thread sends it, no syscall on this thread.
+  if (!queue->TryPush(packet)) {
+    ++endpoint_->outbound_dropped;
   }
 }
 
@@ -656,16 +741,57 @@ void GazeboMavlinkInterface::ImuCallback(ImuPtr& imu_message) {
   }
   imu_debug_msg_count++;*/
 
+  SendImu(ignition::math::Quaterniond(imu_message->orientation().w(),
+                                      imu_message->orientation().x(),
+                                      imu_message->orientation().y(),
+                                      imu_message->orientation().z()),
+          ignition::math::Vector3d(imu_message->linear_acceleration().x(),
+                                   imu_message->linear_acceleration().y(),
+                                   imu_message->linear_acceleration().z()),
+          ignition::math::Vector3d(imu_message->angular_velocity().x(),
+                                   imu_message->angular_velocity().y(),
+                                   imu_message->angular_velocity().z()),
+          &endpoint_->sensor_outbound);
+}
+
+void GazeboMavlinkInterface::ReadShmImu() {
+  if (!imu_shm_.IsOpen()) {
+    if (shm_open_steps_++ % kShmOpenRetrySteps != 0 ||
+        !imu_shm_.Open(ShmRingName("~/" + namespace_ + "/" + imu_sub_topic_))) {
+      if (shm_open_steps_ == 10 * kShmOpenRetrySteps) {
+        gzwarn << "[gazebo_mavlink_interface] No shared memory ring for the IMU"
+               << " yet, is shmTransport enabled in the IMU plugin?\n";
+      }
+      return;
+    }
+    gzdbg << "[gazebo_mavlink_interface] Reading the IMU from shared memory.\n";
+  }
+
+  // Every measurement is sent, from the physics thread.
+  ShmImuRecord imu;
+  while (imu_shm_.Read(&imu)) {
+    SendImu(ignition::math::Quaterniond(imu.orientation[0], imu.orientation[1],
+                                        imu.orientation[2], imu.orientation[3]),
+            ignition::math::Vector3d(imu.linear_acceleration[0],
+                                     imu.linear_acceleration[1],
+                                     imu.linear_acceleration[2]),
+            ignition::math::Vector3d(imu.angular_velocity[0],
+                                     imu.angular_velocity[1],
+                                     imu.angular_velocity[2]),
+            &endpoint_->update_outbound);
+  }
+}
+
+void GazeboMavlinkInterface::SendImu(
+    const ignition::math::Quaterniond& q_gr,
+    const ignition::math::Vector3d& linear_acceleration,
+    const ignition::math::Vector3d& angular_velocity,
+    MavlinkEndpoint::OutboundQueue* queue) {
   // frames
   // g - gazebo (ENU), east, north, up
   // r - rotors imu frame (FLU), forward, left, up
   // b - px4 (FRD) forward, right down
   // n - px4 (NED) north, east, down
-  ignition::math::Quaterniond q_gr = ignition::math::Quaterniond(
-    imu_message->orientation().w(),
-    imu_message->orientation().x(),
-    imu_message->orientation().y(),
-    imu_message->orientation().z());
 
 
   // q_br
@@ -696,35 +822,17 @@ void GazeboMavlinkInterface::ImuCallback(ImuPtr& imu_message) {
   ignition::math::Quaterniond q_gb = q_gr*q_br.Inverse();
   ignition::math::Quaterniond q_nb = q_ng*q_gb;
 
-  ignition::math::Vector3d pos_g = model_->WorldPose().Pos();
+  // One snapshot, the state is updated by the physics thread meanwhile.
+  const RigidBodyState state = model_state_->State();
+  ignition::math::Vector3d pos_g = state.world_pose.Pos();
   ignition::math::Vector3d pos_n = q_ng.RotateVector(pos_g);
 
   //gzerr << "got imu: " << C_W_I << "\n";
   //gzerr << "got pose: " << T_W_I.rot << "\n";
-  float declination = get_mag_declination(lat_rad_, lon_rad_);
-
-  ignition::math::Quaterniond q_dn(0.0, 0.0, declination);
-  ignition::math::Vector3d mag_n = q_dn.RotateVectorReverse(mag_d_);
-
-  ignition::math::Vector3d vel_b = q_br.RotateVector(model_->RelativeLinearVel());
-  ignition::math::Vector3d vel_n = q_ng.RotateVector(model_->WorldLinearVel());
-  ignition::math::Vector3d omega_nb_b = q_br.RotateVector(model_->RelativeAngularVel());
-
-  standard_normal_distribution_ = std::normal_distribution<float>(0, 0.01f);
-  ignition::math::Vector3d mag_noise_b(
-    standard_normal_distribution_(random_generator_),
-    standard_normal_distribution_(random_generator_),
-    standard_normal_distribution_(random_generator_));
-
-  ignition::math::Vector3d accel_b = q_br.RotateVector(ignition::math::Vector3d (
-    imu_message->linear_acceleration().x(),
-    imu_message->linear_acceleration().y(),
-    imu_message->linear_acceleration().z()));
-  ignition::math::Vector3d gyro_b = q_br.RotateVector(ignition::math::Vector3d (
-    imu_message->angular_velocity().x(),
-    imu_message->angular_velocity().y(),
-    imu_message->angular_velocity().z()));
-  ignition::math::Vector3d mag_b = q_nb.RotateVectorReverse(mag_n) + mag_noise_b;
+  const double sim_time = world_->SimTime().Double();
+
+  ignition::math::Vector3d accel_b = q_br.RotateVector(linear_acceleration);
+  ignition::math::Vector3d gyro_b = q_br.RotateVector(angular_velocity);
 
   mavlink_hil_sensor_t sensor_msg;
   sensor_msg.time_usec = world_->SimTime().nsec/1000;
@@ -734,27 +842,63 @@ void GazeboMavlinkInterface::ImuCallback(ImuPtr& imu_message) {
   sensor_msg.xgyro = gyro_b.X();
   sensor_msg.ygyro = gyro_b.Y();
   sensor_msg.zgyro = gyro_b.Z();
-  sensor_msg.xmag = mag_b.X();
-  sensor_msg.ymag = mag_b.Y();
-  sensor_msg.zmag = mag_b.Z();
-  sensor_msg.abs_pressure = 0.0;
-  float rho = 1.2754f; // density of air, TODO why is this not 1.225 as given by std. atmos.
-  sensor_msg.diff_pressure = 0.5f*rho*vel_b.X()*vel_b.X() / 100;
+  // Bits 0 - 5 of fields_updated, the accelerometer and the gyroscope are
+  // updated with every measurement.
+  sensor_msg.fields_updated = 0x3F;
+
+  // The magnetometer and the barometer run at their own, lower rates. The
+  // fields of the other messages repeat their last values.
+  if (mag_scheduler_.Due(sim_time)) {
+    // The grid components are interpolated within the cached cell, in the n
+    // frame of mag_d_ rotated by the declination.
+    ignition::math::Vector3d mag_n;
+    double mag_north, mag_east, mag_down;
+    if (geo_magnetic_grid_.InterpolateNED(lat_rad_, lon_rad_, &geo_magnetic_cell_,
+                                          &mag_north, &mag_east, &mag_down)) {
+      mag_n = ignition::math::Vector3d(mag_north, -mag_east, -mag_down) * 1e4;
+    } else {
+      float declination = get_mag_declination(lat_rad_, lon_rad_);
+
+      ignition::math::Quaterniond q_dn(0.0, 0.0, declination);
+      mag_n = q_dn.RotateVectorReverse(mag_d_);
+    }
 
-  float p1, p2;
+    standard_normal_distribution_ = std::normal_distribution<float>(0, 0.01f);
+    ignition::math::Vector3d mag_noise_b(
+      standard_normal_distribution_(random_generator_),
+      standard_normal_distribution_(random_generator_),
+      standard_normal_distribution_(random_generator_));
 
-  // need to add noise to pressure alt
-  do {
-      p1 = rand() * (1.0 / RAND_MAX);
-      p2 = rand() * (1.0 / RAND_MAX);
-  } while (p1 <= __FLT_EPSILON__);
+    last_mag_b_ = q_nb.RotateVectorReverse(mag_n) + mag_noise_b;
+    sensor_msg.fields_updated |= 0x1C0;
+  }
+  sensor_msg.xmag = last_mag_b_.X();
+  sensor_msg.ymag = last_mag_b_.Y();
+  sensor_msg.zmag = last_mag_b_.Z();
 
-  float n = sqrtf(-2.0 * logf(p1)) * cosf(2.0f * M_PI * p2);
-  float alt_n = -pos_n.Z() + n * sqrtf(0.006f);
+  if (baro_scheduler_.Due(sim_time)) {
+    ignition::math::Vector3d vel_b = q_br.RotateVector(state.relative_linear_vel);
+    float rho = 1.2754f; // density of air, TODO why is this not 1.225 as given by std. atmos.
+    last_diff_pressure_ = 0.5f*rho*vel_b.X()*vel_b.X() / 100;
 
-  sensor_msg.pressure_alt = (std::isfinite(alt_n)) ? alt_n : -pos_n.Z();
+    float p1, p2;
+
+    // need to add noise to pressure alt
+    do {
+        p1 = rand() * (1.0 / RAND_MAX);
+        p2 = rand() * (1.0 / RAND_MAX);
+    } while (p1 <= __FLT_EPSILON__);
+
+    float n = sqrtf(-2.0 * logf(p1)) * cosf(2.0f * M_PI * p2);
+    float alt_n = -pos_n.Z() + n * sqrtf(0.006f);
+
+    last_pressure_alt_ = (std::isfinite(alt_n)) ? alt_n : -pos_n.Z();
+    sensor_msg.fields_updated |= 0xE00;
+  }
+  sensor_msg.abs_pressure = 0.0;
+  sensor_msg.diff_pressure = last_diff_pressure_;
+  sensor_msg.pressure_alt = last_pressure_alt_;
   sensor_msg.temperature = 0.0;
-  sensor_msg.fields_updated = 4095;
 
   //gyro needed for optical flow message
   optflow_xgyro_ = gyro_b.X();
@@ -784,10 +928,20 @@ void GazeboMavlinkInterface::ImuCallback(ImuPtr& imu_message) {
   }
   imu_msg_count++;*/
 
-  send_mavlink_message(MAVLINK_MSG_ID_HIL_SENSOR, &sensor_msg, 200);
+  send_mavlink_message(MAVLINK_MSG_ID_HIL_SENSOR, &sensor_msg, 200, queue);
+  ++sensor_batches_sent_;
+  control_loop_->Request(world_->SimTime());
+
+  if (!ground_truth_scheduler_.Due(sim_time)) {
+    return;
+  }
+
+  ignition::math::Vector3d vel_b = q_br.RotateVector(state.relative_linear_vel);
+  ignition::math::Vector3d vel_n = q_ng.RotateVector(state.world_linear_vel);
+  ignition::math::Vector3d omega_nb_b = q_br.RotateVector(state.relative_angular_vel);
 
   // ground truth
-  ignition::math::Vector3d accel_true_b = q_br.RotateVector(model_->RelativeLinearAccel());
+  ignition::math::Vector3d accel_true_b = q_br.RotateVector(state.relative_linear_accel);
 
   // send ground truth
   mavlink_hil_state_quaternion_t hil_state_quat;
@@ -811,7 +965,7 @@ void GazeboMavlinkInterface::ImuCallback(ImuPtr& imu_message) {
 
   // assumed indicated airspeed due to flow aligned with pitot (body x)
   hil_state_quat.ind_airspeed = vel_b.X();
-  hil_state_quat.true_airspeed = model_->WorldLinearVel().Length() * 100; //no wind simulated
+  hil_state_quat.true_airspeed = state.world_linear_vel.Length() * 100; //no wind simulated
 
   hil_state_quat.xacc = accel_true_b.X() * 1000;
   hil_state_quat.yacc = accel_true_b.Y() * 1000;
@@ -844,7 +998,7 @@ void GazeboMavlinkInterface::ImuCallback(ImuPtr& imu_message) {
   }
   quat_msg_count++;*/
 
-  send_mavlink_message(MAVLINK_MSG_ID_HIL_STATE_QUATERNION, &hil_state_quat, 200);
+  send_mavlink_message(MAVLINK_MSG_ID_HIL_STATE_QUATERNION, &hil_state_quat, 200, queue);
 }
 
 void GazeboMavlinkInterface::LidarCallback(LidarPtr& lidar_message) {
@@ -865,7 +1019,7 @@ void GazeboMavlinkInterface::LidarCallback(LidarPtr& lidar_message) {
   //distance needed for optical flow message
   optflow_distance_ = lidar_message->current_distance(); //[m]
 
-  send_mavlink_message(MAVLINK_MSG_ID_DISTANCE_SENSOR, &sensor_msg, 200);
+  send_mavlink_message(MAVLINK_MSG_ID_DISTANCE_SENSOR, &sensor_msg, 200, &endpoint_->sensor_outbound);
 
 }
 
@@ -887,7 +1041,7 @@ void GazeboMavlinkInterface::OpticalFlowCallback(OpticalFlowPtr& opticalFlow_mes
   sensor_msg.time_delta_distance_us = opticalFlow_message->time_delta_distance_us();
   sensor_msg.distance = optflow_distance_;
 
-  send_mavlink_message(MAVLINK_MSG_ID_HIL_OPTICAL_FLOW, &sensor_msg, 200);
+  send_mavlink_message(MAVLINK_MSG_ID_HIL_OPTICAL_FLOW, &sensor_msg, 200, &endpoint_->sensor_outbound);
 }
 
 /*ssize_t GazeboMavlinkInterface::receive(void *_buf, const size_t _size, uint32_t _timeoutMs)
@@ -909,30 +1063,48 @@ void GazeboMavlinkInterface::OpticalFlowCallback(OpticalFlowPtr& opticalFlow_mes
   return recv(this->handle, _buf, _size, 0);
 }*/
 
-void GazeboMavlinkInterface::pollForMAVLinkMessages(double _dt, uint32_t _timeoutMs)
+void GazeboMavlinkInterface::handle_received_messages()
 {
-  // convert timeout in ms to timeval
-  struct timeval tv;
-  tv.tv_sec = _timeoutMs / 1000;
-  tv.tv_usec = (_timeoutMs % 1000) * 1000UL;
+  mavlink_message_t msg;
+  while (endpoint_->inbound.TryPop(&msg)) {
+    handle_message(&msg);
+  }
+}
 
-  // poll
-  ::poll(&fds_[0], (sizeof(fds_[0])/sizeof(fds_[0])), 0);
+void GazeboMavlinkInterface::handle_received_messages_lockstep()
+{
+  handle_received_messages();
+  // Do not stall the simulation before the autopilot is connected.
+  if (!received_first_reference_) {
+    sensor_batches_answered_ = sensor_batches_sent_;
+    control_loop_->ClearRequests();
+    return;
+  }
 
-  if (fds_[0].revents & POLLIN) {
-    int len = recvfrom(fd_, buf_, sizeof(buf_), 0, (struct sockaddr *)&srcaddr_, &addrlen_);
-    if (len > 0) {
-      mavlink_message_t msg;
-      mavlink_status_t status;
-      for (unsigned i = 0; i < len; ++i)
-      {
-        if (mavlink_parse_char(MAVLINK_COMM_0, buf_[i], &msg, &status))
-        {
-          // have a message, handle it
-          handle_message(&msg);
-        }
-      }
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  const std::chrono::steady_clock::time_point deadline =
+      now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(lockstep_timeout_));
+  while (sensor_batches_answered_ < sensor_batches_sent_) {
+    if (!endpoint_->WaitForInbound(deadline)) {
+      // Carry on with the last controls, and do not wait for the missed
+      // answers in the next steps.
+      sensor_batches_answered_ = sensor_batches_sent_;
+      control_loop_->DropRequests();
+      ++lockstep_timeouts_;
+      break;
     }
+    handle_received_messages();
+  }
+
+  if (lockstep_timeouts_ != reported_lockstep_timeouts_ &&
+      now - last_lockstep_report_ > std::chrono::seconds(1)) {
+    gzwarn << "[gazebo_mavlink_interface] No actuator controls within "
+           << lockstep_timeout_ << " s in "
+           << lockstep_timeouts_ - reported_lockstep_timeouts_
+           << " steps, the autopilot does not keep up.\n";
+    reported_lockstep_timeouts_ = lockstep_timeouts_;
+    last_lockstep_report_ = now;
   }
 }
 
@@ -952,13 +1124,23 @@ void GazeboMavlinkInterface::handle_message(mavlink_message_t *msg)
     }
 
     last_actuator_time_ = world_->SimTime();
+    if (sensor_batches_answered_ < sensor_batches_sent_) {
+      ++sensor_batches_answered_;
+    }
+    // In lockstep, every sensor batch is answered. Otherwise the autopilot
+    // runs at its own rate and answers the latest batch.
+    if (lockstep_) {
+      control_loop_->Respond(last_actuator_time_);
+    } else {
+      control_loop_->RespondLatest(last_actuator_time_);
+    }
 
     for (unsigned i = 0; i < kNOutMax; i++) {
       input_index_[i] = i;
     }
 
-    // set rotor speeds, controller targets
-    input_reference_.resize(kNOutMax);
+    // set rotor speeds, controller targets, input_reference_ is sized in
+    // Load() and the messages are handled on the physics thread.
     for (int i = 0; i < input_reference_.size(); i++) {
       if (armed) {
         input_reference_[i] = (controls.controls[input_index_[i]] + input_offset_[i])
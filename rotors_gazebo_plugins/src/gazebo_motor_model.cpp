@@ -87,6 +87,32 @@ void GazeboMotorModel::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
     gzthrow(
         "[gazebo_motor_model] Couldn't find specified link \"" << link_name_
                                                                << "\".");
+  link_state_ = RigidBodyStateCache::Get(link_);
+
+  // Moments get the parent link, such that the resulting torques can be
+  // applied.
+  physics::Link_V parent_links = link_->GetParentJointsLinks();
+  if (parent_links.empty())
+    gzthrow(
+        "[gazebo_motor_model] Couldn't find the parent link of \"" << link_name_
+                                                                   << "\".");
+  parent_link_ = parent_links.at(0);
+
+  // The drag torque acts along the z-axis of the rotor CoG frame. If that axis
+  // is parallel to the joint axis, spinning the rotor does not change its
+  // direction in the parent frame, and it can be computed once.
+  const ignition::math::Vector3d joint_axis_L =
+      link_->WorldPose().Rot().RotateVectorReverse(joint_->GlobalAxis(0));
+  const ignition::math::Vector3d cog_z_axis_L =
+      link_->GetInertial()->Pose().Rot().RotateVector(
+          ignition::math::Vector3d(0, 0, 1));
+  fixed_mount_ = joint_->GetParent() == parent_link_ &&
+      std::abs(joint_axis_L.Dot(cog_z_axis_L)) > 1.0 - kFixedMountTolerance;
+  if (fixed_mount_) {
+    drag_torque_axis_ =
+        (link_->WorldCoGPose() - parent_link_->WorldCoGPose()).Rot().RotateVector(
+            ignition::math::Vector3d(0, 0, 1));
+  }
 
   if (_sdf->HasElement("motorNumber"))
     motor_number_ = _sdf->GetElement("motorNumber")->Get<int>();
@@ -196,29 +222,81 @@ void GazeboMotorModel::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
       _sdf, "timeConstantDown", time_constant_down_, time_constant_down_);
   getSdfParam<double>(
       _sdf, "rotorVelocitySlowdownSim", rotor_velocity_slowdown_sim_, 10);
+  getSdfParam<bool>(
+      _sdf, "useVehicleMotorModel", use_vehicle_motor_model_,
+      kDefaultUseVehicleMotorModel);
+  getSdfParam<bool>(_sdf, "shmTransport", shm_transport_, shm_transport_);
+  std::string aero_table_path;
+  getSdfParam<std::string>(_sdf, "aeroTablePath", aero_table_path,
+                           aero_table_path);
+  if (!aero_table_path.empty()) {
+    aero_table_ = RotorAeroTable::Get(aero_table_path);
+    if (!aero_table_) {
+      gzerr << "[gazebo_motor_model] Could not read the rotor table \""
+            << aero_table_path << "\", using the motor and moment constants "
+            << "for motor [" << motor_number_ << "].\n";
+    }
+  }
+
+  if (use_vehicle_motor_model_) {
+    if (motor_type_ != MotorType::kVelocity) {
+      gzerr << "[gazebo_motor_model] The vehicle motor model only supports the "
+               "velocity motorType, computing motor [" << motor_number_
+            << "] on its own.\n";
+    } else {
+      VehicleRotor rotor;
+      rotor.joint = joint_;
+      rotor.link = link_;
+      rotor.motor_number = motor_number_;
+      rotor.turning_direction = turning_direction_;
+      rotor.motor_constant = motor_constant_;
+      rotor.moment_constant = moment_constant_;
+      rotor.rotor_drag_coefficient = rotor_drag_coefficient_;
+      rotor.rolling_moment_coefficient = rolling_moment_coefficient_;
+      rotor.rotor_velocity_slowdown_sim = rotor_velocity_slowdown_sim_;
+      rotor.aero_table = aero_table_;
+      vehicle_motor_model_ = VehicleMotorModel::Get(model_);
+      if (!vehicle_motor_model_->AddRotor(rotor)) {
+        vehicle_motor_model_.reset();
+      }
+    }
+  }
 
-  // Listen to the update event. This event is broadcast every
-  // simulation iteration.
-  updateConnection_ = event::Events::ConnectWorldUpdateBegin(
+  // Listen to the update event, either directly or through the update
+  // dispatcher of the world. This event is broadcast every simulation
+  // iteration.
+  updateConnection_ = UpdateDispatcher::Connect(
+      _model, _sdf, "gazebo_motor_model", kUpdatePriorityActuator,
       boost::bind(&GazeboMotorModel::OnUpdate, this, _1));
 
   // Create the first order filter.
-  rotor_velocity_filter_.reset(
-      new FirstOrderFilter<double>(
-          time_constant_up_, time_constant_down_, ref_motor_input_));
+  rotor_velocity_filter_ = ArenaNew<FirstOrderFilter<double> >(
+      ModelArena::ForPlugin(model_, "gazebo_motor_model"), time_constant_up_,
+      time_constant_down_, ref_motor_input_);
+
+  checkpoint_connection_ = SimulationCheckpoint::Connect(
+      model_->GetWorld(),
+      model_->GetScopedName() + "/gazebo_motor_model/" + joint_name_,
+      boost::bind(&GazeboMotorModel::SaveCheckpoint, this, _1),
+      boost::bind(&GazeboMotorModel::RestoreCheckpoint, this, _1));
 }
 
 // This gets called by the world update start event.
 void GazeboMotorModel::OnUpdate(const common::UpdateInfo& _info) {
-  if (kPrintOnUpdates) {
-    gzdbg << __FUNCTION__ << "() called." << std::endl;
-  }
+  ROTORS_PROFILE_SCOPE("gazebo_motor_model");
 
   if (!pubs_and_subs_created_) {
     CreatePubsAndSubs();
     pubs_and_subs_created_ = true;
   }
 
+  if (command_mailbox_.Fetch(mailbox_command_.sequence, &mailbox_command_)) {
+    SetMotorInput(mailbox_command_.values[0]);
+  }
+  if (shm_transport_) {
+    ReadShmCommand();
+  }
+
   sampling_time_ = _info.simTime.Double() - prev_sim_time_;
   prev_sim_time_ = _info.simTime.Double();
   UpdateForcesAndMoments();
@@ -228,10 +306,6 @@ void GazeboMotorModel::OnUpdate(const common::UpdateInfo& _info) {
 void GazeboMotorModel::CreatePubsAndSubs() {
   gzdbg << __PRETTY_FUNCTION__ << " called." << std::endl;
 
-  // Create temporary "ConnectGazeboToRosTopic" publisher and message
-  gazebo::transport::PublisherPtr gz_connect_gazebo_to_ros_topic_pub =
-      node_handle_->Advertise<gz_std_msgs::ConnectGazeboToRosTopic>(
-          "~/" + kConnectGazeboToRosSubtopic, 1);
   gz_std_msgs::ConnectGazeboToRosTopic connect_gazebo_to_ros_topic_msg;
 
   // Create temporary "ConnectRosToGazeboTopic" publisher and message
@@ -253,8 +327,7 @@ void GazeboMotorModel::CreatePubsAndSubs() {
         namespace_ + "/" + motor_speed_pub_topic_);
     connect_gazebo_to_ros_topic_msg.set_msgtype(
         gz_std_msgs::ConnectGazeboToRosTopic::FLOAT_32);
-    gz_connect_gazebo_to_ros_topic_pub->Publish(
-        connect_gazebo_to_ros_topic_msg, true);
+    ros_bridge_connector_.Add(connect_gazebo_to_ros_topic_msg);
   }
 
   // =============================================== //
@@ -271,8 +344,7 @@ void GazeboMotorModel::CreatePubsAndSubs() {
         namespace_ + "/" + motor_position_pub_topic_);
     connect_gazebo_to_ros_topic_msg.set_msgtype(
         gz_std_msgs::ConnectGazeboToRosTopic::FLOAT_32);
-    gz_connect_gazebo_to_ros_topic_pub->Publish(
-        connect_gazebo_to_ros_topic_msg, true);
+    ros_bridge_connector_.Add(connect_gazebo_to_ros_topic_msg);
   }
 
   // ============================================ //
@@ -289,10 +361,11 @@ void GazeboMotorModel::CreatePubsAndSubs() {
         namespace_ + "/" + motor_force_pub_topic_);
     connect_gazebo_to_ros_topic_msg.set_msgtype(
         gz_std_msgs::ConnectGazeboToRosTopic::FLOAT_32);
-    gz_connect_gazebo_to_ros_topic_pub->Publish(
-        connect_gazebo_to_ros_topic_msg, true);
+    ros_bridge_connector_.Add(connect_gazebo_to_ros_topic_msg);
   }
 
+  ros_bridge_connector_.Publish(node_handle_);
+
   // ============================================ //
   // = CONTROL COMMAND MSG SETUP (ROS->GAZEBO) = //
   // ============================================ //
@@ -339,20 +412,45 @@ void GazeboMotorModel::ControlCommandCallback(
     gzerr << "You tried to access index " << motor_number_
           << " of the MotorSpeed message array which is of size "
           << command_motor_input_msg->motor_speed_size();
+    return;
   }
 
+  // Called on the transport thread, the command is applied by OnUpdate().
+  const double command = command_motor_input_msg->motor_speed(motor_number_);
+  command_mailbox_.Post(&command, 1, model_->GetWorld()->SimTime().Double());
+}
+
+void GazeboMotorModel::ReadShmCommand() {
+  if (!command_shm_.IsOpen()) {
+    if (shm_open_steps_++ % kShmOpenRetrySteps != 0 ||
+        !command_shm_.Open(
+            ShmRingName("~/" + namespace_ + "/" + command_sub_topic_))) {
+      return;
+    }
+    gzdbg << "[gazebo_motor_model] Reading the commands of motor ["
+          << motor_number_ << "] from shared memory.\n";
+  }
+
+  ShmRotorVelocitiesRecord command;
+  if (!command_shm_.ReadLatest(&command)) {
+    return;
+  }
+  if (motor_number_ >= command.num_rotors) {
+    gzerr << "You tried to access index " << motor_number_
+          << " of the shared memory motor command which is of size "
+          << command.num_rotors;
+    return;
+  }
+  SetMotorInput(command.angular_velocities[motor_number_]);
+}
+
+void GazeboMotorModel::SetMotorInput(double command) {
   if (motor_type_ == MotorType::kVelocity) {
-    ref_motor_input_ = std::min(
-        static_cast<double>(
-            command_motor_input_msg->motor_speed(motor_number_)),
-        static_cast<double>(max_rot_velocity_));
+    ref_motor_input_ = std::min(command, max_rot_velocity_);
   } else if (motor_type_ == MotorType::kPosition) {
-    ref_motor_input_ = command_motor_input_msg->motor_speed(motor_number_);
+    ref_motor_input_ = command;
   } else {  // if (motor_type_ == MotorType::kForce) {
-    ref_motor_input_ = std::min(
-        static_cast<double>(
-            command_motor_input_msg->motor_speed(motor_number_)),
-        static_cast<double>(max_force_));
+    ref_motor_input_ = std::min(command, max_force_);
   }
 }
 
@@ -366,6 +464,9 @@ void GazeboMotorModel::WindSpeedCallback(GzWindSpeedMsgPtr& wind_speed_msg) {
   wind_speed_W_.X() = wind_speed_msg->velocity().x();
   wind_speed_W_.Y() = wind_speed_msg->velocity().y();
   wind_speed_W_.Z() = wind_speed_msg->velocity().z();
+  if (vehicle_motor_model_) {
+    vehicle_motor_model_->SetWindSpeed(wind_speed_W_);
+  }
 }
 
 double GazeboMotorModel::NormalizeAngle(double input){
@@ -414,61 +515,83 @@ void GazeboMotorModel::UpdateForcesAndMoments() {
     }
     default:  // MotorType::kVelocity
     {
-      motor_rot_vel_ = joint_->GetVelocity(0);
-      if (motor_rot_vel_ / (2 * M_PI) > 1 / (2 * sampling_time_)) {
-        gzerr << "Aliasing on motor [" << motor_number_
-              << "] might occur. Consider making smaller simulation time "
-                 "steps or raising the rotor_velocity_slowdown_sim_ param.\n";
+      if (vehicle_motor_model_) {
+        // Computed and applied for all rotors of the vehicle at once.
+        vehicle_motor_model_->Update(sampling_time_);
+      } else {
+        motor_rot_vel_ = joint_->GetVelocity(0);
+        if (motor_rot_vel_ / (2 * M_PI) > 1 / (2 * sampling_time_)) {
+          gzerr << "Aliasing on motor [" << motor_number_
+                << "] might occur. Consider making smaller simulation time "
+                   "steps or raising the rotor_velocity_slowdown_sim_ param.\n";
+        }
+        double real_motor_velocity =
+            motor_rot_vel_ * rotor_velocity_slowdown_sim_;
+        // Get the direction of the rotor rotation.
+        int real_motor_velocity_sign =
+            (real_motor_velocity > 0) - (real_motor_velocity < 0);
+
+        // Forces from Philppe Martin's and Erwan Salaün's
+        // 2010 IEEE Conference on Robotics and Automation paper
+        // The True Role of Accelerometer Feedback in Quadrotor Control
+        // - \omega * \lambda_1 * V_A^{\perp}
+        ignition::math::Vector3d joint_axis = joint_->GlobalAxis(0);
+        ignition::math::Vector3d body_velocity_W = link_state_->State().world_linear_vel;
+        ignition::math::Vector3d relative_wind_velocity_W = body_velocity_W - wind_speed_W_;
+        ignition::math::Vector3d body_velocity_perpendicular =
+            relative_wind_velocity_W -
+            (relative_wind_velocity_W.Dot(joint_axis) * joint_axis);
+
+        double thrust_coefficient = motor_constant_;
+        double torque_coefficient = motor_constant_ * moment_constant_;
+        if (aero_table_) {
+          const ignition::math::Vector3d thrust_axis_W =
+              link_state_->State().world_pose.Rot().RotateVector(
+                  ignition::math::Vector3d(0, 0, 1));
+          aero_table_->Lookup(std::abs(real_motor_velocity),
+                              relative_wind_velocity_W.Dot(thrust_axis_W),
+                              body_velocity_perpendicular.Length(),
+                              &thrust_coefficient, &torque_coefficient);
+        }
+        // Assuming symmetric propellers (or rotors) for the thrust calculation.
+        const double signed_velocity_squared =
+            turning_direction_ * real_motor_velocity_sign *
+            real_motor_velocity * real_motor_velocity;
+        double thrust = signed_velocity_squared * thrust_coefficient;
+
+        // Apply a force to the link.
+        link_->AddRelativeForce(ignition::math::Vector3d (0, 0, thrust));
+
+        ignition::math::Vector3d air_drag = -std::abs(real_motor_velocity) *
+                                 rotor_drag_coefficient_ *
+                                 body_velocity_perpendicular;
+
+        // Apply air_drag to link.
+        link_->AddForce(air_drag);
+        // Moments are applied to the parent link, resolved in Load().
+        const double drag_torque =
+            -turning_direction_ * signed_velocity_squared * torque_coefficient;
+        // Transforming the drag torque into the parent frame to handle
+        // arbitrary rotor orientations.
+        ignition::math::Vector3d drag_torque_parent_frame;
+        if (fixed_mount_) {
+          drag_torque_parent_frame = drag_torque_axis_ * drag_torque;
+        } else {
+          // The tansformation from the parent_link to the link_.
+          ignition::math::Pose3d pose_difference =
+              link_->WorldCoGPose() - parent_link_->WorldCoGPose();
+          drag_torque_parent_frame = pose_difference.Rot().RotateVector(
+              ignition::math::Vector3d(0, 0, drag_torque));
+        }
+        parent_link_->AddRelativeTorque(drag_torque_parent_frame);
+
+        ignition::math::Vector3d rolling_moment;
+        // - \omega * \mu_1 * V_A^{\perp}
+        rolling_moment = -std::abs(real_motor_velocity) *
+                         rolling_moment_coefficient_ *
+                         body_velocity_perpendicular;
+        parent_link_->AddTorque(rolling_moment);
       }
-      double real_motor_velocity =
-          motor_rot_vel_ * rotor_velocity_slowdown_sim_;
-      // Get the direction of the rotor rotation.
-      int real_motor_velocity_sign =
-          (real_motor_velocity > 0) - (real_motor_velocity < 0);
-      // Assuming symmetric propellers (or rotors) for the thrust calculation.
-      double thrust = turning_direction_ * real_motor_velocity_sign *
-                      real_motor_velocity * real_motor_velocity *
-                      motor_constant_;
-
-      // Apply a force to the link.
-      link_->AddRelativeForce(ignition::math::Vector3d (0, 0, thrust));
-
-      // Forces from Philppe Martin's and Erwan Salaün's
-      // 2010 IEEE Conference on Robotics and Automation paper
-      // The True Role of Accelerometer Feedback in Quadrotor Control
-      // - \omega * \lambda_1 * V_A^{\perp}
-      ignition::math::Vector3d joint_axis = joint_->GlobalAxis(0);
-      ignition::math::Vector3d body_velocity_W = link_->WorldLinearVel();
-      ignition::math::Vector3d relative_wind_velocity_W = body_velocity_W - wind_speed_W_;
-      ignition::math::Vector3d body_velocity_perpendicular =
-          relative_wind_velocity_W -
-          (relative_wind_velocity_W.Dot(joint_axis) * joint_axis);
-      ignition::math::Vector3d air_drag = -std::abs(real_motor_velocity) *
-                               rotor_drag_coefficient_ *
-                               body_velocity_perpendicular;
-
-      // Apply air_drag to link.
-      link_->AddForce(air_drag);
-      // Moments get the parent link, such that the resulting torques can be
-      // applied.
-      physics::Link_V parent_links = link_->GetParentJointsLinks();
-      // The tansformation from the parent_link to the link_.
-      ignition::math::Pose3d pose_difference =
-          link_->WorldCoGPose() - parent_links.at(0)->WorldCoGPose();
-      ignition::math::Vector3d drag_torque(
-          0, 0, -turning_direction_ * thrust * moment_constant_);
-      // Transforming the drag torque into the parent frame to handle
-      // arbitrary rotor orientations.
-      ignition::math::Vector3d drag_torque_parent_frame =
-          pose_difference.Rot().RotateVector(drag_torque);
-      parent_links.at(0)->AddRelativeTorque(drag_torque_parent_frame);
-
-      ignition::math::Vector3d rolling_moment;
-      // - \omega * \mu_1 * V_A^{\perp}
-      rolling_moment = -std::abs(real_motor_velocity) *
-                       rolling_moment_coefficient_ *
-                       body_velocity_perpendicular;
-      parent_links.at(0)->AddTorque(rolling_moment);
       // Apply the filter on the motor's velocity.
       double ref_motor_rot_vel;
       ref_motor_rot_vel = rotor_velocity_filter_->updateFilter(
@@ -484,5 +607,27 @@ void GazeboMotorModel::UpdateForcesAndMoments() {
   }
 }
 
+void GazeboMotorModel::SaveCheckpoint(CheckpointWriter* writer) {
+  writer->Write(ref_motor_input_);
+  writer->Write(rotor_velocity_filter_->previousState());
+  writer->Write(motor_rot_vel_);
+  writer->Write(prev_sim_time_);
+  writer->Write(sampling_time_);
+  WriteCheckpoint(wind_speed_W_, writer);
+}
+
+bool GazeboMotorModel::RestoreCheckpoint(CheckpointReader* reader) {
+  double filter_state = 0.0;
+  reader->Read(&ref_motor_input_);
+  reader->Read(&filter_state);
+  reader->Read(&motor_rot_vel_);
+  reader->Read(&prev_sim_time_);
+  reader->Read(&sampling_time_);
+  ReadCheckpoint(reader, &wind_speed_W_);
+  rotor_velocity_filter_->setPreviousState(filter_state);
+  pids_.Reset();
+  return reader->ok();
+}
+
 GZ_REGISTER_MODEL_PLUGIN(GazeboMotorModel);
 }
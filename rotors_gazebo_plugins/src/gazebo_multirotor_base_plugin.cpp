@@ -23,6 +23,7 @@
 #include "rotors_gazebo_plugins/gazebo_multirotor_base_plugin.h"
 
 // STANDARD LIB INCLUDES
+#include <algorithm>
 #include <ctime>
 
 #include "ConnectGazeboToRosTopic.pb.h"
@@ -51,6 +52,7 @@ void GazeboMultirotorBasePlugin::Load(physics::ModelPtr _model,
   getSdfParam<double>(_sdf, "rotorVelocitySlowdownSim",
                       rotor_velocity_slowdown_sim_,
                       rotor_velocity_slowdown_sim_);
+  getSdfParam<bool>(_sdf, "shmTransport", shm_transport_, shm_transport_);
 
   node_handle_ = gazebo::transport::NodePtr(new transport::Node());
 
@@ -64,9 +66,11 @@ void GazeboMultirotorBasePlugin::Load(physics::ModelPtr _model,
     gzthrow("[gazebo_multirotor_base_plugin] Couldn't find specified link \""
             << link_name_ << "\".");
 
-  // Listen to the update event. This event is broadcast every
-  // simulation iteration.
-  update_connection_ = event::Events::ConnectWorldUpdateBegin(
+  // Listen to the update event, either directly or through the update
+  // dispatcher of the world. This event is broadcast every simulation
+  // iteration.
+  update_connection_ = UpdateDispatcher::Connect(
+      _model, _sdf, "gazebo_multirotor_base_plugin", kUpdatePrioritySensor,
       boost::bind(&GazeboMultirotorBasePlugin::OnUpdate, this, _1));
 
   child_links_ = link_->GetChildJointsLinks();
@@ -83,13 +87,34 @@ void GazeboMultirotorBasePlugin::Load(physics::ModelPtr _model,
       motor_joints_.insert(MotorNumberToJointPair(motor_number, joint));
     }
   }
+
+  // The motors, their names and the frame never change, so the messages are
+  // sized and filled with the static data once, and OnUpdate() only
+  // overwrites the stamps and values in place.
+  const int num_motors = motor_joints_.size();
+  actuators_msg_.mutable_header()->set_frame_id(frame_id_);
+  ResizeRepeatedField(num_motors, actuators_msg_.mutable_angular_velocities());
+
+  joint_state_msg_.mutable_header()->set_frame_id(frame_id_);
+  joint_state_msg_.clear_name();
+  for (MotorNumberToJointMap::const_iterator m = motor_joints_.begin();
+       m != motor_joints_.end(); ++m) {
+    joint_state_msg_.add_name(m->second->GetName());
+  }
+  ResizeRepeatedField(num_motors, joint_state_msg_.mutable_position());
+
+  if (num_motors > kShmMaxRotors && shm_transport_) {
+    gzerr << "[gazebo_multirotor_base_plugin] The shared memory ring holds at "
+          << "most " << kShmMaxRotors << " motors, publishing the "
+          << num_motors << " motors over Gazebo transport only.\n";
+    shm_transport_ = false;
+  }
+  motor_record_.num_rotors = num_motors;
 }
 
 // This gets called by the world update start event.
 void GazeboMultirotorBasePlugin::OnUpdate(const common::UpdateInfo& _info) {
-  if (kPrintOnUpdates) {
-    gzdbg << __FUNCTION__ << "() called." << std::endl;
-  }
+  ROTORS_PROFILE_SCOPE("gazebo_multirotor_base_plugin");
 
   if (!pubs_and_subs_created_) {
     CreatePubsAndSubs();
@@ -101,38 +126,37 @@ void GazeboMultirotorBasePlugin::OnUpdate(const common::UpdateInfo& _info) {
 
   actuators_msg_.mutable_header()->mutable_stamp()->set_sec(now.sec);
   actuators_msg_.mutable_header()->mutable_stamp()->set_nsec(now.nsec);
-  actuators_msg_.mutable_header()->set_frame_id(frame_id_);
 
   joint_state_msg_.mutable_header()->mutable_stamp()->set_sec(now.sec);
   joint_state_msg_.mutable_header()->mutable_stamp()->set_nsec(now.nsec);
-  joint_state_msg_.mutable_header()->set_frame_id(frame_id_);
-
-  actuators_msg_.clear_angular_velocities();
-
-  joint_state_msg_.clear_name();
-  joint_state_msg_.clear_position();
 
+  int i = 0;
   MotorNumberToJointMap::iterator m;
-  for (m = motor_joints_.begin(); m != motor_joints_.end(); ++m) {
+  for (m = motor_joints_.begin(); m != motor_joints_.end(); ++m, ++i) {
     double motor_rot_vel =
         m->second->GetVelocity(0) * rotor_velocity_slowdown_sim_;
 
-    actuators_msg_.add_angular_velocities(motor_rot_vel);
-
-    joint_state_msg_.add_name(m->second->GetName());
-    joint_state_msg_.add_position(m->second->Position(0));
+    actuators_msg_.set_angular_velocities(i, motor_rot_vel);
+    joint_state_msg_.set_position(i, m->second->Position(0));
   }
 
   joint_state_pub_->Publish(joint_state_msg_);
+
+  if (motor_shm_.IsOpen()) {
+    motor_record_.stamp.sec = now.sec;
+    motor_record_.stamp.nsec = now.nsec;
+    std::copy(actuators_msg_.angular_velocities().begin(),
+              actuators_msg_.angular_velocities().end(),
+              motor_record_.angular_velocities);
+    motor_shm_.Write(motor_record_);
+    if (!motor_pub_->HasConnections()) {
+      return;
+    }
+  }
   motor_pub_->Publish(actuators_msg_);
 }
 
 void GazeboMultirotorBasePlugin::CreatePubsAndSubs() {
-  // Create temporary "ConnectGazeboToRosTopic" publisher and message
-  gazebo::transport::PublisherPtr connect_gazebo_to_ros_topic_pub =
-      node_handle_->Advertise<gz_std_msgs::ConnectGazeboToRosTopic>(
-          "~/" + kConnectGazeboToRosSubtopic, 1);
-
   gz_std_msgs::ConnectGazeboToRosTopic connect_gazebo_to_ros_topic_msg;
 
   // ============================================ //
@@ -148,8 +172,20 @@ void GazeboMultirotorBasePlugin::CreatePubsAndSubs() {
                                                 actuators_pub_topic_);
   connect_gazebo_to_ros_topic_msg.set_msgtype(
       gz_std_msgs::ConnectGazeboToRosTopic::ACTUATORS);
-  connect_gazebo_to_ros_topic_pub->Publish(connect_gazebo_to_ros_topic_msg,
-                                           true);
+  if (shm_transport_) {
+    const std::string shm_name =
+        ShmRingName("~/" + namespace_ + "/" + actuators_pub_topic_);
+    if (motor_shm_.Create(shm_name, frame_id_)) {
+      connect_gazebo_to_ros_topic_msg.set_shm_name(shm_name);
+    } else {
+      gzerr << "[gazebo_multirotor_base_plugin] Can't create the shared memory "
+            << "ring \"" << shm_name
+            << "\", publishing over Gazebo transport only.\n";
+    }
+  }
+  ros_bridge_connector_.Add(connect_gazebo_to_ros_topic_msg);
+  // The message is reused for the joint state connection.
+  connect_gazebo_to_ros_topic_msg.clear_shm_name();
 
   // ============================================ //
   // ========== JOINT STATE MSG SETUP =========== //
@@ -164,8 +200,8 @@ void GazeboMultirotorBasePlugin::CreatePubsAndSubs() {
                                                 joint_state_pub_topic_);
   connect_gazebo_to_ros_topic_msg.set_msgtype(
       gz_std_msgs::ConnectGazeboToRosTopic::JOINT_STATE);
-  connect_gazebo_to_ros_topic_pub->Publish(connect_gazebo_to_ros_topic_msg,
-                                           true);
+  ros_bridge_connector_.Add(connect_gazebo_to_ros_topic_msg);
+  ros_bridge_connector_.Publish(node_handle_);
 }
 
 GZ_REGISTER_MODEL_PLUGIN(GazeboMultirotorBasePlugin);
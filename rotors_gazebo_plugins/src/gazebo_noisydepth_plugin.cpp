@@ -33,17 +33,32 @@
 #include <sdf/sdf.hh>
 #include <tf/tf.h>
 
+#include "rotors_gazebo_plugins/profiling.h"
+
 namespace gazebo {
 // Register this plugin with the simulator
 GZ_REGISTER_SENSOR_PLUGIN(GazeboNoisyDepth)
 
 GazeboNoisyDepth::GazeboNoisyDepth() {
   this->depth_info_connect_count_ = 0;
+  this->point_cloud_connect_count_ = 0;
+  this->point_cloud_cutoff_ = kDefaultPointCloudCutoff;
+  this->point_cloud_cutoff_max_ = kDefaultPointCloudCutoffMax;
+  this->point_cloud_decimation_ = 1;
   this->depth_image_connect_count_ = 0;
   this->last_depth_image_camera_info_update_time_ = common::Time(0);
+  this->depth_noise_on_gpu_ = false;
+  this->gpu_noise_setup_done_ = false;
+  this->frame_has_gpu_noise_ = false;
+  this->depth_noise_shader_path_ = ROTORS_GAZEBO_PLUGINS_MEDIA_PATH;
+  this->fidelity_listener_id_ = -1;
 }
 
-GazeboNoisyDepth::~GazeboNoisyDepth() {}
+GazeboNoisyDepth::~GazeboNoisyDepth() {
+  if (this->fidelity_ && this->fidelity_listener_id_ >= 0) {
+    this->fidelity_->RemoveListener(this->fidelity_listener_id_);
+  }
+}
 
 void GazeboNoisyDepth::Load(sensors::SensorPtr _parent, sdf::ElementPtr _sdf) {
   DepthCameraPlugin::Load(_parent, _sdf);
@@ -80,6 +95,29 @@ void GazeboNoisyDepth::Load(sensors::SensorPtr _parent, sdf::ElementPtr _sdf) {
         _sdf->GetElement("depthImageCameraInfoTopicName")->Get<std::string>();
   }
 
+  // point cloud of the noisy depth
+  if (!_sdf->HasElement("pointCloudTopicName")) {
+    this->point_cloud_topic_name_ = "depth/points";
+  } else {
+    this->point_cloud_topic_name_ =
+        _sdf->GetElement("pointCloudTopicName")->Get<std::string>();
+  }
+
+  if (_sdf->HasElement("pointCloudCutoff")) {
+    this->point_cloud_cutoff_ =
+        _sdf->GetElement("pointCloudCutoff")->Get<double>();
+  }
+
+  if (_sdf->HasElement("pointCloudCutoffMax")) {
+    this->point_cloud_cutoff_max_ =
+        _sdf->GetElement("pointCloudCutoffMax")->Get<double>();
+  }
+
+  if (_sdf->HasElement("pointCloudDecimation")) {
+    this->point_cloud_decimation_ = std::max(
+        1, _sdf->GetElement("pointCloudDecimation")->Get<int>());
+  }
+
   // noise model stuff
   std::string noise_model;
   if (!_sdf->HasElement("depthNoiseModelName")) {
@@ -143,9 +181,44 @@ void GazeboNoisyDepth::Load(sensors::SensorPtr _parent, sdf::ElementPtr _sdf) {
         _sdf->GetElement("depthNoiseMaxDist")->Get<float>();
   }
 
+  /* Noise on the GPU, the CPU model stays as fallback */
+  if (_sdf->HasElement("depthNoiseOnGpu")) {
+    this->depth_noise_on_gpu_ = _sdf->GetElement("depthNoiseOnGpu")->Get<bool>();
+  }
+
+  if (_sdf->HasElement("depthNoiseShaderPath")) {
+    this->depth_noise_shader_path_ =
+        _sdf->GetElement("depthNoiseShaderPath")->Get<std::string>();
+  }
+
+  /* 0 uses one thread per core */
+  if (_sdf->HasElement("depthNoiseNumThreads")) {
+    this->noise_model->SetNumThreads(
+        _sdf->GetElement("depthNoiseNumThreads")->Get<unsigned int>());
+  }
+
+  // The fidelity is shared with the plugins of the model the camera link
+  // belongs to.
+  physics::WorldPtr world = physics::get_world(this->parentSensor->WorldName());
+  physics::EntityPtr parent_entity =
+      world ? world->EntityByName(this->parentSensor->ParentName()) : nullptr;
+  if (parent_entity && parent_entity->GetParentModel()) {
+    this->fidelity_ =
+        ModelFidelity::Get(parent_entity->GetParentModel(), _sdf);
+  } else {
+    ROS_WARN_NAMED("NoisyDepth",
+                   "Could not find the model of the camera, it always runs at "
+                   "full fidelity");
+  }
+
   load_connection_ = GazeboRosCameraUtils::OnLoad(boost::bind(&GazeboNoisyDepth::Advertise, this));
 
   GazeboRosCameraUtils::Load(_parent, _sdf);
+
+  if (this->fidelity_) {
+    this->fidelity_listener_id_ = this->fidelity_->AddListener(
+        boost::bind(&GazeboNoisyDepth::OnFidelityChanged, this, _1));
+  }
 }
 
 void GazeboNoisyDepth::Advertise() {
@@ -166,17 +239,35 @@ void GazeboNoisyDepth::Advertise() {
           ros::VoidPtr(), &this->camera_queue_);
 
   this->depth_image_camera_info_pub_ = this->rosnode_->advertise(depth_image_camera_info_ao);
+
+  ros::AdvertiseOptions point_cloud_ao =
+      ros::AdvertiseOptions::create<sensor_msgs::PointCloud2>(
+          this->point_cloud_topic_name_, 1,
+          boost::bind(&GazeboNoisyDepth::PointCloudConnect, this),
+          boost::bind(&GazeboNoisyDepth::PointCloudDisconnect, this),
+          ros::VoidPtr(), &this->camera_queue_);
+
+  this->point_cloud_pub_ = this->rosnode_->advertise(point_cloud_ao);
 }
 
 void GazeboNoisyDepth::DepthImageConnect() {
   ++this->depth_image_connect_count_;
-  this->parentSensor->SetActive(true);
+  if (!LowFidelity()) this->parentSensor->SetActive(true);
 }
 
 void GazeboNoisyDepth::DepthImageDisconnect() {
   --this->depth_image_connect_count_;
 }
 
+void GazeboNoisyDepth::PointCloudConnect() {
+  ++this->point_cloud_connect_count_;
+  if (!LowFidelity()) this->parentSensor->SetActive(true);
+}
+
+void GazeboNoisyDepth::PointCloudDisconnect() {
+  --this->point_cloud_connect_count_;
+}
+
 void GazeboNoisyDepth::DepthInfoConnect() {
   ++this->depth_info_connect_count_;
 }
@@ -189,16 +280,34 @@ void GazeboNoisyDepth::OnNewDepthFrame(const float *_image, unsigned int _width,
                                        unsigned int _height,
                                        unsigned int _depth,
                                        const std::string &_format) {
+  ROTORS_PROFILE_SCOPE("gazebo_noisydepth_plugin");
   if (!this->initialized_ || this->height_ <= 0 || this->width_ <= 0) return;
 
+  if (LowFidelity()) {
+    this->parentSensor->SetActive(false);
+    return;
+  }
+
   this->depth_sensor_update_time_ = this->parentSensor->LastMeasurementTime();
 
+  // The frame was rendered before the shader is attached below, so the first
+  // frame after the setup still gets the noise on the CPU.
+  this->frame_has_gpu_noise_ = this->gpu_noise_.IsAttached();
+  if (this->depth_noise_on_gpu_ && !this->gpu_noise_setup_done_) {
+    SetupGpuNoise();
+  }
+
   // check if there are subscribers, if not disable parent, else process images..
   if (this->parentSensor->IsActive()) {
-    if (this->depth_image_connect_count_ <= 0 && (*this->image_connect_count_) <= 0) {
+    if (this->depth_image_connect_count_ <= 0 &&
+        this->point_cloud_connect_count_ <= 0 &&
+        (*this->image_connect_count_) <= 0) {
       this->parentSensor->SetActive(false);
     } else {
-      if (this->depth_image_connect_count_ > 0) this->FillDepthImage(_image);
+      if (this->depth_image_connect_count_ > 0 ||
+          this->point_cloud_connect_count_ > 0) {
+        this->FillDepthImage(_image);
+      }
     }
   }
   else {
@@ -217,11 +326,17 @@ void GazeboNoisyDepth::OnNewImageFrame(const unsigned char *_image,
                                        const std::string &_format) {
   if (!this->initialized_ || this->height_ <= 0 || this->width_ <= 0) return;
 
+  if (LowFidelity()) {
+    this->parentSensor->SetActive(false);
+    return;
+  }
+
   this->sensor_update_time_ = this->parentSensor_->LastMeasurementTime();
 
   // check if there are subscribers, if not disable parent, else process images..
   if (this->parentSensor->IsActive()) {
     if (this->depth_image_connect_count_ <= 0 &&
+        this->point_cloud_connect_count_ <= 0 &&
         (*this->image_connect_count_) <= 0) {
       this->parentSensor->SetActive(false);
     } else {
@@ -235,6 +350,16 @@ void GazeboNoisyDepth::OnNewImageFrame(const unsigned char *_image,
   }
 }
 
+void GazeboNoisyDepth::OnFidelityChanged(FidelityLevel level) {
+  if (level == kFidelityLow) {
+    this->parentSensor->SetActive(false);
+  } else if (this->depth_image_connect_count_ > 0 ||
+             this->point_cloud_connect_count_ > 0 ||
+             (*this->image_connect_count_) > 0) {
+    this->parentSensor->SetActive(true);
+  }
+}
+
 void GazeboNoisyDepth::FillDepthImage(const float *_src) {
   this->lock_.lock();
   // copy data into image
@@ -244,7 +369,13 @@ void GazeboNoisyDepth::FillDepthImage(const float *_src) {
 
   // copy from depth to depth image message
   if(FillDepthImageHelper(this->height, this->width,this->skip_, _src, &this->depth_image_msg_)){
-    this->depth_image_pub_.publish(this->depth_image_msg_);
+    if (this->depth_image_connect_count_ > 0) {
+      this->depth_image_pub_.publish(this->depth_image_msg_);
+    }
+    if (this->point_cloud_connect_count_ > 0) {
+      this->FillPointCloud(
+          reinterpret_cast<const float *>(&this->depth_image_msg_.data[0]));
+    }
   }
 
   this->lock_.unlock();
@@ -268,13 +399,90 @@ bool GazeboNoisyDepth::FillDepthImageHelper(const uint32_t rows_arg,
   image_msg->is_bigendian = 0;
 
   float *dest = (float *)(&(image_msg->data[0]));
-  memcpy(dest, data_arg, sizeof(float) * width * height);
-
-  noise_model->ApplyNoise(width, height, dest);
+  if (this->frame_has_gpu_noise_) {
+    // The frame was read back with the noise already applied.
+    memcpy(dest, data_arg, sizeof(float) * width * height);
+  } else {
+    // The noise model reads the rendered frame and writes the noisy one
+    // straight into the message, there is no separate copy.
+    noise_model->ApplyNoise(width, height, data_arg, dest);
+  }
 
   return true;
 }
 
+void GazeboNoisyDepth::FillPointCloud(const float *depth) {
+  // The table and the message layout only change with the camera.
+  if (this->point_cloud_rays_.Update(this->width, this->height,
+                                     this->depthCamera->HFOV().Radian(),
+                                     this->point_cloud_decimation_)) {
+    this->point_cloud_msg_.height = this->point_cloud_rays_.height();
+    this->point_cloud_msg_.width = this->point_cloud_rays_.width();
+    this->point_cloud_msg_.fields.resize(3);
+    const char *names[] = {"x", "y", "z"};
+    for (int i = 0; i < 3; ++i) {
+      this->point_cloud_msg_.fields[i].name = names[i];
+      this->point_cloud_msg_.fields[i].offset = i * sizeof(float);
+      this->point_cloud_msg_.fields[i].datatype =
+          sensor_msgs::PointField::FLOAT32;
+      this->point_cloud_msg_.fields[i].count = 1;
+    }
+    this->point_cloud_msg_.is_bigendian = false;
+    this->point_cloud_msg_.point_step = 3 * sizeof(float);
+    this->point_cloud_msg_.row_step =
+        this->point_cloud_msg_.point_step * this->point_cloud_msg_.width;
+    this->point_cloud_msg_.is_dense = false;
+    this->point_cloud_msg_.data.resize(this->point_cloud_msg_.row_step *
+                                       this->point_cloud_msg_.height);
+  }
+  if (this->point_cloud_msg_.data.empty()) return;
+
+  this->point_cloud_msg_.header.frame_id = this->frame_name_;
+  this->point_cloud_msg_.header.stamp = this->depth_image_msg_.header.stamp;
+  this->point_cloud_rays_.Unproject(
+      depth, this->point_cloud_cutoff_, this->point_cloud_cutoff_max_,
+      reinterpret_cast<float *>(&this->point_cloud_msg_.data[0]));
+  this->point_cloud_pub_.publish(this->point_cloud_msg_);
+}
+
+void GazeboNoisyDepth::SetupGpuNoise() {
+  this->gpu_noise_setup_done_ = true;
+
+  bool shaders_found =
+      DepthNoiseShader::AddResourcePath(this->depth_noise_shader_path_);
+  if (!shaders_found &&
+      this->depth_noise_shader_path_ == ROTORS_GAZEBO_PLUGINS_MEDIA_PATH) {
+    // Not installed yet, use the shaders of the source tree.
+    this->depth_noise_shader_path_ = ROTORS_GAZEBO_PLUGINS_SOURCE_MEDIA_PATH;
+    shaders_found =
+        DepthNoiseShader::AddResourcePath(this->depth_noise_shader_path_);
+  }
+  if (!shaders_found) {
+    ROS_WARN_NAMED("NoisyDepth",
+                   "Depth noise shaders not found in %s, applying the noise "
+                   "on the CPU", this->depth_noise_shader_path_.c_str());
+    return;
+  }
+
+  // The depth camera sensor names its depth texture after itself.
+  const std::string texture_names[] = {
+      this->parentSensor->ScopedName() + "_RttTex_Depth",
+      this->parentSensor->Name() + "_RttTex_Depth"};
+  for (const std::string &texture_name : texture_names) {
+    if (Ogre::TextureManager::getSingleton().resourceExists(texture_name)) {
+      if (this->gpu_noise_.Attach(texture_name, this->width,
+                                  *this->noise_model)) {
+        ROS_INFO_NAMED("NoisyDepth", "Applying the depth noise on the GPU");
+        return;
+      }
+      break;
+    }
+  }
+  ROS_WARN_NAMED("NoisyDepth",
+                 "Could not attach the depth noise shader, applying the "
+                 "noise on the CPU");
+}
+
 void GazeboNoisyDepth::PublishCameraInfo() {
 
   // first publish parent camera info (ir camera)
@@ -20,13 +20,43 @@
 
 #include "rotors_gazebo_plugins/gazebo_octomap_plugin.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include <boost/filesystem.hpp>
+
 #include <octomap_msgs/conversions.h>
 #include <gazebo/common/Time.hh>
+#include <gazebo/common/Timer.hh>
 #include <gazebo/common/CommonTypes.hh>
-#include <gazebo/math/Vector3.hh>
 
 namespace gazebo {
 
+namespace {
+
+/// \brief Creates an empty octomap with the occupancy parameters of the plugin.
+octomap::OcTree* NewOctomap(double leaf_size) {
+  octomap::OcTree* octomap = new octomap::OcTree(leaf_size);
+  octomap->clear();
+  octomap->setProbHit(0.7);
+  octomap->setProbMiss(0.4);
+  octomap->setClampingThresMin(0.12);
+  octomap->setClampingThresMax(0.97);
+  octomap->setOccupancyThres(0.7);
+  return octomap;
+}
+
+}  // namespace
+
 OctomapFromGazeboWorld::~OctomapFromGazeboWorld() {
   delete octomap_;
   octomap_ = NULL;
@@ -41,17 +71,51 @@ void OctomapFromGazeboWorld::Load(physics::WorldPtr _parent,
   world_ = _parent;
 
   std::string service_name = "world/get_octomap";
+  std::string esdf_service_name = "world/get_esdf";
   std::string octomap_pub_topic = "world/octomap";
+  std::string octomap_diff_pub_topic = "world/octomap_diff";
+  std::string octomap_chunk_pub_topic = "world/octomap_chunks";
   getSdfParam<std::string>(_sdf, "octomapPubTopic", octomap_pub_topic,
                            octomap_pub_topic);
+  getSdfParam<std::string>(_sdf, "octomapDiffPubTopic", octomap_diff_pub_topic,
+                           octomap_diff_pub_topic);
+  getSdfParam<std::string>(_sdf, "octomapChunkPubTopic", octomap_chunk_pub_topic,
+                           octomap_chunk_pub_topic);
   getSdfParam<std::string>(_sdf, "octomapServiceName", service_name,
                            service_name);
+  getSdfParam<std::string>(_sdf, "esdfServiceName", esdf_service_name,
+                           esdf_service_name);
+  getSdfParam<int>(_sdf, "numThreads", num_threads_, kDefaultOctomapNumThreads);
+  getSdfParam<bool>(_sdf, "hierarchical", hierarchical_,
+                    kDefaultOctomapHierarchical);
+  getSdfParam<std::string>(_sdf, "cacheDirectory", cache_directory_,
+                           kDefaultOctomapCacheDirectory);
+  getSdfParam<bool>(_sdf, "incremental", incremental_,
+                    kDefaultOctomapIncremental);
+  getSdfParam<bool>(_sdf, "esdf", esdf_, kDefaultOctomapEsdf);
+  getSdfParam<bool>(_sdf, "meshVoxelization", mesh_voxelization_,
+                    kDefaultOctomapMeshVoxelization);
+  if (num_threads_ <= 0) {
+    num_threads_ = std::max(1u, std::thread::hardware_concurrency());
+  }
 
   gzlog << "Advertising service: " << service_name << std::endl;
   srv_ = node_handle_.advertiseService(
       service_name, &OctomapFromGazeboWorld::ServiceCallback, this);
   octomap_publisher_ =
       node_handle_.advertise<octomap_msgs::Octomap>(octomap_pub_topic, 1, true);
+  // No chunk may be dropped, the unbounded queue holds at most one octomap.
+  octomap_chunk_publisher_ = node_handle_.advertise<rotors_comm::OctomapChunk>(
+      octomap_chunk_pub_topic, 0);
+  if (esdf_) {
+    gzlog << "Advertising service: " << esdf_service_name << std::endl;
+    esdf_srv_ = node_handle_.advertiseService(
+        esdf_service_name, &OctomapFromGazeboWorld::EsdfServiceCallback, this);
+  }
+  if (incremental_) {
+    octomap_diff_publisher_ =
+        node_handle_.advertise<octomap_msgs::Octomap>(octomap_diff_pub_topic, 1);
+  }
 }
 
 bool OctomapFromGazeboWorld::ServiceCallback(
@@ -75,14 +139,27 @@ bool OctomapFromGazeboWorld::ServiceCallback(
   common::Time now = world_->GetSimTime();
   res.map.header.frame_id = "world";
   res.map.header.stamp = ros::Time(now.sec, now.nsec);
+  res.num_chunks = 0;
 
-  if (!octomap_msgs::binaryMapToMsg(*octomap_, res.map)) {
-    ROS_ERROR("Error serializing OctoMap");
-  }
+  // A large octomap is only written to the file or delivered in tiles,
+  // instead of being serialized as a whole.
+  if (req.file_only) {
+    if (req.filename == "") {
+      ROS_ERROR("An octomap that is only stored needs a filename.");
+    }
+  } else if (req.chunk_size > 0.0) {
+    res.num_chunks = PublishOctomapChunks(req.chunk_size, res.map.header.stamp);
+    gzlog << "Published Octomap in " << res.num_chunks << " chunks."
+          << std::endl;
+  } else {
+    if (!octomap_msgs::binaryMapToMsg(*octomap_, res.map)) {
+      ROS_ERROR("Error serializing OctoMap");
+    }
 
-  if (req.publish_octomap) {
-    gzlog << "Publishing Octomap." << std::endl;
-    octomap_publisher_.publish(res.map);
+    if (req.publish_octomap) {
+      gzlog << "Publishing Octomap." << std::endl;
+      octomap_publisher_.publish(res.map);
+    }
   }
 
   common::SphericalCoordinatesPtr sphericalCoordinates = world_->GetSphericalCoordinates();
@@ -96,38 +173,211 @@ bool OctomapFromGazeboWorld::ServiceCallback(
   return true;
 }
 
-void OctomapFromGazeboWorld::FloodFill(
-    const ignition::math::Vector3d & seed_point, const ignition::math::Vector3d & bounding_box_origin,
-    const ignition::math::Vector3d & bounding_box_lengths, const double leaf_size) {
-  octomap::OcTreeNode* seed =
-      octomap_->search(seed_point.x, seed_point.y, seed_point.z);
-  // do nothing if point occupied
-  if (seed != NULL && seed->getOccupancy()) return;
-
-  std::stack<octoignition::math::Vector3d > to_check;
-  to_check.push(octoignition::math::Vector3d (seed_point.x, seed_point.y, seed_point.z));
-
-  while (to_check.size() > 0) {
-    octoignition::math::Vector3d p = to_check.top();
-
-    if ((p.x() > bounding_box_origin.x - bounding_box_lengths.x / 2) &&
-        (p.x() < bounding_box_origin.x + bounding_box_lengths.x / 2) &&
-        (p.y() > bounding_box_origin.y - bounding_box_lengths.y / 2) &&
-        (p.y() < bounding_box_origin.y + bounding_box_lengths.y / 2) &&
-        (p.z() > bounding_box_origin.z - bounding_box_lengths.z / 2) &&
-        (p.z() < bounding_box_origin.z + bounding_box_lengths.z / 2) &&
-        (!octomap_->search(p))) {
-      octomap_->setNodeValue(p, 0);
-      to_check.pop();
-      to_check.push(octoignition::math::Vector3d (p.x() + leaf_size, p.y(), p.z()));
-      to_check.push(octoignition::math::Vector3d (p.x() - leaf_size, p.y(), p.z()));
-      to_check.push(octoignition::math::Vector3d (p.x(), p.y() + leaf_size, p.z()));
-      to_check.push(octoignition::math::Vector3d (p.x(), p.y() - leaf_size, p.z()));
-      to_check.push(octoignition::math::Vector3d (p.x(), p.y(), p.z() + leaf_size));
-      to_check.push(octoignition::math::Vector3d (p.x(), p.y(), p.z() - leaf_size));
+bool OctomapFromGazeboWorld::EsdfServiceCallback(
+    rotors_comm::Esdf::Request& req, rotors_comm::Esdf::Response& res) {
+  res.success = false;
+  if (req.filename.empty()) {
+    gzerr << "No filename given for the ESDF.\n";
+    return true;
+  }
 
-    } else {
-      to_check.pop();
+  rotors_comm::Octomap::Request octomap_req;
+  octomap_req.bounding_box_origin = req.bounding_box_origin;
+  octomap_req.bounding_box_lengths = req.bounding_box_lengths;
+  octomap_req.leaf_size = req.leaf_size;
+  octomap_req.publish_octomap = false;
+  CreateOctomap(octomap_req);
+  if (!octomap_ || grid_.NumCells() == 0) {
+    gzerr << "Could not create the octomap for the ESDF.\n";
+    return true;
+  }
+
+  // An octomap read from the cache comes without the bitmaps.
+  std::vector<bool> octomap_free_cells;
+  const std::vector<bool>* free_cells = &free_cells_;
+  if (!has_incremental_state_) {
+    octomap_free_cells.resize(grid_.NumCells());
+    for (int64_t index = 0; index < grid_.NumCells(); ++index) {
+      const ignition::math::Vector3d point = grid_.CellCenter(index);
+      const octomap::OcTreeNode* node =
+          octomap_->search(point.X(), point.Y(), point.Z());
+      octomap_free_cells[index] = node && !octomap_->isNodeOccupied(node);
+    }
+    free_cells = &octomap_free_cells;
+  }
+
+  common::Timer timer;
+  timer.Start();
+  std::vector<float> distances;
+  ComputeEsdf(grid_.num_cells, grid_.leaf_size, *free_cells, req.max_distance,
+              num_threads_, &distances);
+  gzmsg << "Computing the ESDF of " << grid_.NumCells() << " cells took "
+        << timer.GetElapsed().Double() << " s with " << num_threads_
+        << " threads.\n";
+
+  EsdfFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kEsdfFileMagic, sizeof(header.magic));
+  header.version = kEsdfFileVersion;
+  for (int axis = 0; axis < 3; ++axis) {
+    header.num_cells[axis] = grid_.num_cells[axis];
+    header.min[axis] = grid_.min[axis];
+    res.num_cells[axis] = grid_.num_cells[axis];
+  }
+  header.voxel_size = grid_.leaf_size;
+  header.max_distance = std::max(0.0, static_cast<double>(req.max_distance));
+  if (!WriteEsdfFile(req.filename, header, distances)) {
+    gzerr << "Could not write the ESDF to " << req.filename << "\n";
+    return true;
+  }
+  gzmsg << "ESDF saved as " << req.filename << "\n";
+
+  res.origin.x = grid_.min.X();
+  res.origin.y = grid_.min.Y();
+  res.origin.z = grid_.min.Z();
+  res.voxel_size = grid_.leaf_size;
+  res.success = true;
+  return true;
+}
+
+uint32_t OctomapFromGazeboWorld::PublishOctomapChunks(double chunk_size,
+                                                     const ros::Time& stamp) {
+  const SamplingGrid& grid = grid_;
+  if (!octomap_ || grid.NumCells() == 0) return 0;
+
+  // The bitmaps are only kept in incremental or ESDF mode.
+  auto is_free = [&](int64_t index) {
+    if (has_incremental_state_) return static_cast<bool>(free_cells_[index]);
+    const ignition::math::Vector3d point = grid.CellCenter(index);
+    const octomap::OcTreeNode* node =
+        octomap_->search(point.X(), point.Y(), point.Z());
+    return node && !octomap_->isNodeOccupied(node);
+  };
+
+  const int tile_cells =
+      std::max(1, static_cast<int>(std::round(chunk_size / grid.leaf_size)));
+  int num_tiles[3];
+  for (int axis = 0; axis < 3; ++axis) {
+    num_tiles[axis] = (grid.num_cells[axis] + tile_cells - 1) / tile_cells;
+  }
+  const uint32_t count = num_tiles[0] * num_tiles[1] * num_tiles[2];
+  const double half_leaf = grid.leaf_size / 2;
+  const ignition::math::Vector3d half_cell(half_leaf, half_leaf, half_leaf);
+
+  uint32_t index = 0;
+  for (int tx = 0; tx < num_tiles[0]; ++tx) {
+    for (int ty = 0; ty < num_tiles[1]; ++ty) {
+      for (int tz = 0; tz < num_tiles[2]; ++tz, ++index) {
+        CellBox tile;
+        const int tile_index[3] = {tx, ty, tz};
+        for (int axis = 0; axis < 3; ++axis) {
+          tile.begin[axis] = tile_index[axis] * tile_cells;
+          tile.end[axis] =
+              std::min(grid.num_cells[axis], tile.begin[axis] + tile_cells);
+        }
+
+        octomap::OcTree* octomap_tile = NewOctomap(grid.leaf_size);
+        for (int ix = tile.begin[0]; ix < tile.end[0]; ++ix) {
+          for (int iy = tile.begin[1]; iy < tile.end[1]; ++iy) {
+            for (int iz = tile.begin[2]; iz < tile.end[2]; ++iz) {
+              const ignition::math::Vector3d point = grid.CellCenter(ix, iy, iz);
+              const octomap::OcTreeKey key =
+                  octomap_tile->coordToKey(point.X(), point.Y(), point.Z());
+              octomap_tile->setNodeValue(
+                  key, is_free(grid.CellIndex(ix, iy, iz)) ? 0 : 1, true);
+            }
+          }
+        }
+        octomap_tile->prune();
+        octomap_tile->updateInnerOccupancy();
+
+        rotors_comm::OctomapChunk chunk;
+        chunk.header.frame_id = "world";
+        chunk.header.stamp = stamp;
+        chunk.index = index;
+        chunk.count = count;
+        const ignition::math::Vector3d tile_min =
+            grid.CellCenter(tile.begin[0], tile.begin[1], tile.begin[2]) -
+            half_cell;
+        const ignition::math::Vector3d tile_max =
+            grid.CellCenter(tile.end[0] - 1, tile.end[1] - 1, tile.end[2] - 1) +
+            half_cell;
+        chunk.min.x = tile_min.X();
+        chunk.min.y = tile_min.Y();
+        chunk.min.z = tile_min.Z();
+        chunk.max.x = tile_max.X();
+        chunk.max.y = tile_max.Y();
+        chunk.max.z = tile_max.Z();
+        chunk.map.header = chunk.header;
+        if (!octomap_msgs::binaryMapToMsg(*octomap_tile, chunk.map)) {
+          ROS_ERROR("Error serializing OctoMap chunk");
+        }
+        delete octomap_tile;
+        octomap_chunk_publisher_.publish(chunk);
+      }
+    }
+  }
+  return count;
+}
+
+void OctomapFromGazeboWorld::FloodFill(const SamplingGrid& grid, int ix,
+                                       int iy, int iz,
+                                       const std::vector<bool>& occupied_cells,
+                                       std::vector<bool>* free_cells,
+                                       CellVector* filled_cells) {
+  const int* num_cells = grid.num_cells;
+  auto is_open = [&](int64_t index) {
+    return !occupied_cells[index] && !(*free_cells)[index];
+  };
+
+  // Every entry seeds a span of open cells along z.
+  std::vector<int64_t> to_check;
+  to_check.push_back(grid.CellIndex(ix, iy, iz));
+
+  while (!to_check.empty()) {
+    const int64_t index = to_check.back();
+    to_check.pop_back();
+    if (!is_open(index)) continue;
+
+    const int64_t column = index / num_cells[2];
+    const int seed_z = index % num_cells[2];
+    const int column_x = column / num_cells[1];
+    const int column_y = column % num_cells[1];
+    const int64_t column_begin = column * num_cells[2];
+
+    int z_begin = seed_z;
+    while (z_begin > 0 && is_open(column_begin + z_begin - 1)) --z_begin;
+    int z_end = seed_z + 1;
+    while (z_end < num_cells[2] && is_open(column_begin + z_end)) ++z_end;
+    for (int z = z_begin; z < z_end; ++z) {
+      (*free_cells)[column_begin + z] = true;
+    }
+    if (filled_cells) {
+      for (int z = z_begin; z < z_end; ++z) {
+        filled_cells->push_back(column_begin + z);
+      }
+    }
+
+    // Seed every run of open cells next to the span in the four neighbouring
+    // columns.
+    const int neighbours[4][2] = {{column_x + 1, column_y},
+                                  {column_x - 1, column_y},
+                                  {column_x, column_y + 1},
+                                  {column_x, column_y - 1}};
+    for (const auto& neighbour : neighbours) {
+      if (neighbour[0] < 0 || neighbour[0] >= num_cells[0] ||
+          neighbour[1] < 0 || neighbour[1] >= num_cells[1]) {
+        continue;
+      }
+      const int64_t neighbour_begin = grid.CellIndex(neighbour[0], neighbour[1], 0);
+      bool in_run = false;
+      for (int z = z_begin; z < z_end; ++z) {
+        const bool open = is_open(neighbour_begin + z);
+        if (open && !in_run) {
+          to_check.push_back(neighbour_begin + z);
+        }
+        in_run = open;
+      }
     }
   }
 }
@@ -135,44 +385,461 @@ void OctomapFromGazeboWorld::FloodFill(
 bool OctomapFromGazeboWorld::CheckIfInterest(const ignition::math::Vector3d & central_point,
                                              gazebo::physics::RayShapePtr ray,
                                              const double leaf_size) {
-  ignition::math::Vector3d start_point = central_point;
-  ignition::math::Vector3d end_point = central_point;
-
   double dist;
   std::string entity_name;
 
-  start_point.x += leaf_size / 2;
-  end_point.x -= leaf_size / 2;
-  ray->SetPoints(start_point, end_point);
-  ray->GetIntersection(dist, entity_name);
+  // Cast a ray along the central X, Y and Z axis of the cell.
+  for (int axis = 0; axis < 3; ++axis) {
+    const ignition::math::Vector3d offset(axis == 0 ? leaf_size / 2 : 0.0,
+                                          axis == 1 ? leaf_size / 2 : 0.0,
+                                          axis == 2 ? leaf_size / 2 : 0.0);
+    ray->SetPoints(central_point + offset, central_point - offset);
+    ray->GetIntersection(dist, entity_name);
 
-  if (dist <= leaf_size) return true;
+    if (dist <= leaf_size) return true;
+  }
 
-  start_point = central_point;
-  end_point = central_point;
-  start_point.y += leaf_size / 2;
-  end_point.y -= leaf_size / 2;
-  ray->SetPoints(start_point, end_point);
-  ray->GetIntersection(dist, entity_name);
+  return false;
+}
 
-  if (dist <= leaf_size) return true;
+void OctomapFromGazeboWorld::RasterizeNearGeometry(
+    int ix, int iy_begin, int iy_end, int iz_begin, int iz_end,
+    const SamplingGrid& grid, const std::vector<const GeometryBound*>& candidates,
+    gazebo::physics::RayShapePtr ray, CellVector* cells, int64_t* num_ray_tests) {
+  if (iy_end <= iy_begin || iz_end <= iz_begin) return;
 
-  start_point = central_point;
-  end_point = central_point;
-  start_point.z += leaf_size / 2;
-  end_point.z -= leaf_size / 2;
-  ray->SetPoints(start_point, end_point);
-  ray->GetIntersection(dist, entity_name);
+  // The rays of a cell do not leave it, so only bounds reaching into the
+  // region can make any of its cells occupied.
+  const double half_leaf = grid.leaf_size / 2;
+  const ignition::math::Vector3d half_cell(half_leaf, half_leaf, half_leaf);
+  const ignition::math::Vector3d region_min =
+      grid.CellCenter(ix, iy_begin, iz_begin) - half_cell;
+  const ignition::math::Vector3d region_max =
+      grid.CellCenter(ix, iy_end - 1, iz_end - 1) + half_cell;
 
-  if (dist <= leaf_size) return true;
+  std::vector<const GeometryBound*> reaching;
+  for (const GeometryBound* bound : candidates) {
+    if (bound->Intersects(region_min, region_max)) {
+      reaching.push_back(bound);
+    }
+  }
+  if (reaching.empty()) return;
 
-  return false;
+  const int ny = iy_end - iy_begin;
+  const int nz = iz_end - iz_begin;
+  if (ny == 1 && nz == 1) {
+    ++*num_ray_tests;
+    const ignition::math::Vector3d point = grid.CellCenter(ix, iy_begin, iz_begin);
+    if (CheckIfInterest(point, ray, grid.leaf_size)) {
+      cells->push_back(static_cast<int64_t>(iy_begin) * grid.num_cells[2] + iz_begin);
+    }
+    return;
+  }
+
+  // Split the longer side in half.
+  if (ny >= nz) {
+    const int iy_split = iy_begin + ny / 2;
+    RasterizeNearGeometry(ix, iy_begin, iy_split, iz_begin, iz_end, grid,
+                          reaching, ray, cells, num_ray_tests);
+    RasterizeNearGeometry(ix, iy_split, iy_end, iz_begin, iz_end, grid,
+                          reaching, ray, cells, num_ray_tests);
+  } else {
+    const int iz_split = iz_begin + nz / 2;
+    RasterizeNearGeometry(ix, iy_begin, iy_end, iz_begin, iz_split, grid,
+                          reaching, ray, cells, num_ray_tests);
+    RasterizeNearGeometry(ix, iy_begin, iy_end, iz_split, iz_end, grid,
+                          reaching, ray, cells, num_ray_tests);
+  }
+}
+
+void OctomapFromGazeboWorld::VoxelizeCollisions(
+    const SamplingGrid& grid, const CellVector* cells,
+    const std::vector<CellBox>* regions, std::vector<bool>* occupied_cells) {
+  common::Timer timer;
+  timer.Start();
+  MeshVoxelizer voxelizer(grid.min, grid.leaf_size, grid.num_cells);
+  if (regions) {
+    // Only the triangles reaching into the regions can touch their cells.
+    const double half_leaf = grid.leaf_size / 2;
+    const ignition::math::Vector3d half_cell(half_leaf, half_leaf, half_leaf);
+    std::vector<std::pair<ignition::math::Vector3d, ignition::math::Vector3d> >
+        boxes;
+    for (const CellBox& region : *regions) {
+      boxes.emplace_back(
+          grid.CellCenter(region.begin[0], region.begin[1], region.begin[2]) -
+              half_cell,
+          grid.CellCenter(region.end[0] - 1, region.end[1] - 1,
+                          region.end[2] - 1) +
+              half_cell);
+    }
+    voxelizer.SetRegions(boxes);
+  }
+  voxelizer.AddWorld(world_);
+  voxelizer.Voxelize(num_threads_);
+
+  if (cells) {
+    for (int64_t index : *cells) {
+      (*occupied_cells)[index] = voxelizer.IsOccupied(index);
+    }
+  } else {
+    for (int64_t index = 0; index < grid.NumCells(); ++index) {
+      (*occupied_cells)[index] = voxelizer.IsOccupied(index);
+    }
+  }
+  gzmsg << "Voxelizing " << voxelizer.NumTriangles()
+        << " collision triangles took " << timer.GetElapsed().Double()
+        << " s with " << num_threads_ << " threads.\n";
+}
+
+template <class Cell>
+void OctomapFromGazeboWorld::ProcessSlabs(
+    int num_slabs, const std::string& description,
+    const std::function<void()>& init_thread,
+    const std::function<void(int, int, std::vector<Cell>*)>& collect,
+    const std::function<void(int, const std::vector<Cell>&)>& merge,
+    bool merge_while_collecting) {
+  const int num_threads = std::max(1, std::min(num_threads_, num_slabs));
+
+  std::vector<std::vector<Cell> > slabs(num_slabs);
+  std::vector<bool> collected(num_slabs, false);
+  std::atomic<int> next_slab(0);
+  int num_collected = 0;
+  std::mutex mutex;
+  std::condition_variable slab_collected;
+
+  common::Timer timer;
+  timer.Start();
+
+  std::vector<std::thread> workers;
+  for (int thread = 0; thread < num_threads; ++thread) {
+    workers.emplace_back([&, thread]() {
+      init_thread();
+      for (int slab = next_slab++; slab < num_slabs; slab = next_slab++) {
+        std::vector<Cell> cells;
+        collect(thread, slab, &cells);
+        std::lock_guard<std::mutex> lock(mutex);
+        slabs[slab].swap(cells);
+        collected[slab] = true;
+        ++num_collected;
+        slab_collected.notify_one();
+      }
+    });
+  }
+
+  // Report progress in steps of 10 %. Slabs are merged in order, so that the
+  // result does not depend on the scheduling of the workers.
+  int num_merged = 0;
+  int num_seen = 0;
+  int reported_progress = 0;
+  std::unique_lock<std::mutex> lock(mutex);
+  while (num_seen < num_slabs) {
+    slab_collected.wait(lock, [&]() { return num_collected > num_seen; });
+    num_seen = num_collected;
+
+    const int progress = 100 * num_seen / num_slabs;
+    if (progress / 10 > reported_progress / 10) {
+      reported_progress = progress;
+      gzmsg << description << "... " << progress << "% ("
+            << timer.GetElapsed().Double() << " s)\n";
+    }
+
+    while (merge_while_collecting && num_merged < num_slabs &&
+           collected[num_merged]) {
+      std::vector<Cell> cells;
+      cells.swap(slabs[num_merged]);
+      lock.unlock();
+      merge(num_merged++, cells);
+      lock.lock();
+    }
+  }
+  lock.unlock();
+
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  for (; num_merged < num_slabs; ++num_merged) {
+    merge(num_merged, slabs[num_merged]);
+    std::vector<Cell>().swap(slabs[num_merged]);
+  }
+
+  gzmsg << description << " took " << timer.GetElapsed().Double() << " s with "
+        << num_threads << " threads.\n";
+}
+
+uint64_t OctomapFromGazeboWorld::OctomapHash(
+    const rotors_comm::Octomap::Request& msg) const {
+  std::ostringstream description;
+  description << std::setprecision(17) << msg.bounding_box_origin.x << " "
+              << msg.bounding_box_origin.y << " " << msg.bounding_box_origin.z
+              << " " << msg.bounding_box_lengths.x << " "
+              << msg.bounding_box_lengths.y << " " << msg.bounding_box_lengths.z
+              << " " << msg.leaf_size << "\n";
+  // The SDF of the models that were inserted after the world was loaded is
+  // not part of the SDF of the world, so all models are described.
+  for (const physics::ModelPtr& model : world_->Models()) {
+    description << model->GetSDF()->ToString("") << model->WorldPose() << "\n";
+  }
+  // Voxelized maps also mark cells that no central axis crosses.
+  if (mesh_voxelization_) {
+    description << "mesh voxelization\n";
+  }
+
+  // 64 bit FNV-1a, stable across runs and platforms.
+  const std::string content = description.str();
+  uint64_t hash = 14695981039346656037ull;
+  for (const char c : content) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+  }
+  return hash;
+}
+
+void OctomapFromGazeboWorld::ResetOctomap(double leaf_size) {
+  delete octomap_;
+  octomap_ = NewOctomap(leaf_size);
+  has_incremental_state_ = false;
+  std::vector<bool>().swap(occupied_cells_);
+  std::vector<bool>().swap(free_cells_);
+  model_bounds_.clear();
+}
+
+OctomapFromGazeboWorld::ModelBoundsMap OctomapFromGazeboWorld::ModelBounds()
+    const {
+  // The bounding box of a model does not include its nested models.
+  ModelBoundsMap bounds;
+  std::vector<physics::ModelPtr> models = world_->Models();
+  while (!models.empty()) {
+    const physics::ModelPtr model = models.back();
+    models.pop_back();
+    for (const physics::ModelPtr& nested_model : model->NestedModels()) {
+      models.push_back(nested_model);
+    }
+    bounds[model->GetScopedName()] = model->BoundingBox();
+  }
+  return bounds;
+}
+
+OctomapFromGazeboWorld::CellBox OctomapFromGazeboWorld::CellsInBox(
+    const SamplingGrid& grid, const ignition::math::Box& box) {
+  // Cell i spans min + (i - 1/2) * leaf_size to min + (i + 1/2) * leaf_size.
+  CellBox cells;
+  for (int axis = 0; axis < 3; ++axis) {
+    const int num_cells = grid.num_cells[axis];
+    const double lower =
+        (box.Min()[axis] - grid.min[axis]) / grid.leaf_size - 0.5;
+    const double upper =
+        (box.Max()[axis] - grid.min[axis]) / grid.leaf_size + 0.5;
+    cells.begin[axis] =
+        std::isfinite(lower)
+            ? static_cast<int>(std::max(
+                  0.0, std::min<double>(num_cells, std::ceil(lower) - 1)))
+            : 0;
+    cells.end[axis] =
+        std::isfinite(upper)
+            ? static_cast<int>(std::max(
+                  0.0, std::min<double>(num_cells, std::floor(upper) + 2)))
+            : num_cells;
+  }
+  return cells;
+}
+
+void OctomapFromGazeboWorld::UpdateOctomap(
+    const rotors_comm::Octomap::Request& msg) {
+  const SamplingGrid& grid = grid_;
+  const int* num_cells = grid.num_cells;
+  const int64_t slab_size = static_cast<int64_t>(num_cells[1]) * num_cells[2];
+
+  common::Timer timer;
+  timer.Start();
+
+  std::vector<bool> updated(grid.NumCells(), false);
+  CellVector updated_cells;
+  std::vector<bool> was_free;
+  std::vector<CellBox> regions;
+
+  {
+    gazebo::physics::PhysicsEnginePtr engine = world_->Physics();
+    // Keep the world from stepping while the rays are cast on the workers.
+    boost::recursive_mutex::scoped_lock physics_lock(
+        *engine->GetPhysicsUpdateMutex());
+
+    // Both the cells a model left and the ones it moved into change.
+    ModelBoundsMap model_bounds = ModelBounds();
+    for (const auto& model : model_bounds) {
+      const auto previous = model_bounds_.find(model.first);
+      if (previous == model_bounds_.end()) {
+        regions.push_back(CellsInBox(grid, model.second));
+      } else if (previous->second != model.second) {
+        regions.push_back(CellsInBox(grid, previous->second));
+        regions.push_back(CellsInBox(grid, model.second));
+      }
+    }
+    for (const auto& model : model_bounds_) {
+      if (model_bounds.count(model.first) == 0) {
+        regions.push_back(CellsInBox(grid, model.second));
+      }
+    }
+    model_bounds_.swap(model_bounds);
+    regions.erase(std::remove_if(regions.begin(), regions.end(),
+                                 [](const CellBox& region) {
+                                   return region.IsEmpty();
+                                 }),
+                  regions.end());
+    if (regions.empty()) {
+      gzmsg << "No model moved within the bounding box, the octomap is up to "
+            << "date.\n";
+      return;
+    }
+
+    // Forget what was known about the cells of the regions.
+    std::vector<std::pair<int, int> > region_slabs;
+    for (int region = 0; region < static_cast<int>(regions.size()); ++region) {
+      const CellBox& cells = regions[region];
+      for (int ix = cells.begin[0]; ix < cells.end[0]; ++ix) {
+        region_slabs.emplace_back(region, ix);
+        for (int iy = cells.begin[1]; iy < cells.end[1]; ++iy) {
+          for (int iz = cells.begin[2]; iz < cells.end[2]; ++iz) {
+            const int64_t index = grid.CellIndex(ix, iy, iz);
+            if (updated[index]) continue;
+            updated[index] = true;
+            updated_cells.push_back(index);
+            was_free.push_back(free_cells_[index]);
+            occupied_cells_[index] = false;
+            free_cells_[index] = false;
+          }
+        }
+      }
+    }
+
+    if (mesh_voxelization_) {
+      VoxelizeCollisions(grid, &updated_cells, &regions, &occupied_cells_);
+    } else {
+      // Every worker casts its own ray.
+      std::vector<gazebo::physics::RayShapePtr> rays;
+      for (int thread = 0; thread < num_threads_; ++thread) {
+        rays.push_back(boost::dynamic_pointer_cast<gazebo::physics::RayShape>(
+            engine->CreateShape("ray", gazebo::physics::CollisionPtr())));
+      }
+
+      std::vector<GeometryBound> bounds;
+      if (hierarchical_) {
+        bounds = CollectGeometryBounds(world_);
+      }
+
+      // Overlapping regions are ray tested once per region, which gives the
+      // same cells.
+      ProcessSlabs<int64_t>(
+          region_slabs.size(), "Updating model edges in octomap",
+          [&engine]() { engine->InitForThread(); },
+          [&](int thread, int slab, CellVector* cells) {
+            const CellBox& region = regions[region_slabs[slab].first];
+            const int ix = region_slabs[slab].second;
+            if (hierarchical_) {
+              std::vector<const GeometryBound*> candidates;
+              for (const GeometryBound& bound : bounds) {
+                candidates.push_back(&bound);
+              }
+              int64_t num_ray_tests = 0;
+              RasterizeNearGeometry(ix, region.begin[1], region.end[1],
+                                    region.begin[2], region.end[2], grid,
+                                    candidates, rays[thread], cells,
+                                    &num_ray_tests);
+              return;
+            }
+            for (int iy = region.begin[1]; iy < region.end[1]; ++iy) {
+              for (int iz = region.begin[2]; iz < region.end[2]; ++iz) {
+                const ignition::math::Vector3d point = grid.CellCenter(ix, iy, iz);
+                if (CheckIfInterest(point, rays[thread], grid.leaf_size)) {
+                  cells->push_back(static_cast<int64_t>(iy) * num_cells[2] + iz);
+                }
+              }
+            }
+          },
+          [&](int slab, const CellVector& cells) {
+            const int ix = region_slabs[slab].second;
+            for (int64_t cell : cells) {
+              occupied_cells_[ix * slab_size + cell] = true;
+            }
+          },
+          true);
+    }
+  }
+
+  // Flood fill the regions from the free space around them, and from the
+  // seeds of the full build in case those were part of a region.
+  CellVector filled_cells;
+  FloodFill(grid, num_cells[0] / 2, num_cells[1] / 2, num_cells[2] - 1,
+            occupied_cells_, &free_cells_, &filled_cells);
+  FloodFill(grid, num_cells[0] / 2, num_cells[1] / 2, 0, occupied_cells_,
+            &free_cells_, &filled_cells);
+  const int64_t strides[3] = {slab_size, num_cells[2], 1};
+  for (int64_t index : updated_cells) {
+    if (occupied_cells_[index] || free_cells_[index]) continue;
+    const int cell[3] = {static_cast<int>(index / slab_size),
+                         static_cast<int>((index / num_cells[2]) % num_cells[1]),
+                         static_cast<int>(index % num_cells[2])};
+    bool next_to_free_cell = false;
+    for (int axis = 0; axis < 3 && !next_to_free_cell; ++axis) {
+      next_to_free_cell =
+          (cell[axis] > 0 && free_cells_[index - strides[axis]]) ||
+          (cell[axis] + 1 < num_cells[axis] && free_cells_[index + strides[axis]]);
+    }
+    if (next_to_free_cell) {
+      FloodFill(grid, cell[0], cell[1], cell[2], occupied_cells_, &free_cells_,
+                &filled_cells);
+    }
+  }
+
+  // Cells of the regions can change either way, the ones filled outside of
+  // them were unknown and therefore occupied before.
+  octomap::OcTree* octomap_diff = NewOctomap(grid.leaf_size);
+  int64_t num_changed_cells = 0;
+  auto set_cell = [&](int64_t index, bool is_free) {
+    const ignition::math::Vector3d point = grid.CellCenter(index);
+    const octomap::OcTreeKey key =
+        octomap_->coordToKey(point.X(), point.Y(), point.Z());
+    octomap_->setNodeValue(key, is_free ? 0 : 1, true);
+    octomap_diff->setNodeValue(key, is_free ? 0 : 1, true);
+    ++num_changed_cells;
+  };
+  for (size_t i = 0; i < updated_cells.size(); ++i) {
+    const int64_t index = updated_cells[i];
+    if (free_cells_[index] != was_free[i]) {
+      set_cell(index, free_cells_[index]);
+    }
+  }
+  for (int64_t index : filled_cells) {
+    if (!updated[index]) {
+      set_cell(index, true);
+    }
+  }
+
+  octomap_->prune();
+  octomap_->updateInnerOccupancy();
+  octomap_diff->prune();
+  octomap_diff->updateInnerOccupancy();
+
+  gzmsg << "Octomap update of " << updated_cells.size() << " cells in "
+        << regions.size() << " regions changed " << num_changed_cells
+        << " cells in " << timer.GetElapsed().Double() << " s.\n";
+
+  if (msg.publish_octomap) {
+    octomap_msgs::Octomap diff_msg;
+    common::Time now = world_->GetSimTime();
+    diff_msg.header.frame_id = "world";
+    diff_msg.header.stamp = ros::Time(now.sec, now.nsec);
+    if (octomap_msgs::binaryMapToMsg(*octomap_diff, diff_msg)) {
+      gzlog << "Publishing Octomap diff." << std::endl;
+      octomap_diff_publisher_.publish(diff_msg);
+    } else {
+      ROS_ERROR("Error serializing OctoMap diff");
+    }
+  }
+  delete octomap_diff;
 }
 
 void OctomapFromGazeboWorld::CreateOctomap(
     const rotors_comm::Octomap::Request& msg) {
   const double epsilon = 0.00001;
-  const int far_away = 100000;
   ignition::math::Vector3d bounding_box_origin(msg.bounding_box_origin.x,
                                     msg.bounding_box_origin.y,
                                     msg.bounding_box_origin.z);
@@ -182,92 +849,206 @@ void OctomapFromGazeboWorld::CreateOctomap(
                                      msg.bounding_box_lengths.y + epsilon,
                                      msg.bounding_box_lengths.z + epsilon);
   double leaf_size = msg.leaf_size;
-  octomap_ = new octomap::OcTree(leaf_size);
-  octomap_->clear();
-  octomap_->setProbHit(0.7);
-  octomap_->setProbMiss(0.4);
-  octomap_->setClampingThresMin(0.12);
-  octomap_->setClampingThresMax(0.97);
-  octomap_->setOccupancyThres(0.7);
-
-  gazebo::physics::PhysicsEnginePtr engine = world_->PhysicsEngine();
-  engine->InitForThread();
-  gazebo::physics::RayShapePtr ray =
-      boost::dynamic_pointer_cast<gazebo::physics::RayShape>(
-          engine->CreateShape("ray", gazebo::physics::CollisionPtr()));
-
-  std::cout << "Rasterizing world and checking collisions" << std::endl;
-
-  for (double x =
-           leaf_size / 2 + bounding_box_origin.x - bounding_box_lengths.x / 2;
-       x < bounding_box_origin.x + bounding_box_lengths.x / 2; x += leaf_size) {
-    int progress =
-        round(100 * (x + bounding_box_lengths.x / 2 - bounding_box_origin.x) /
-              bounding_box_lengths.x);
-    std::cout << "\rPlacing model edges into octomap... " << progress
-              << "%                 ";
-
-    for (double y =
-             leaf_size / 2 + bounding_box_origin.y - bounding_box_lengths.y / 2;
-         y < bounding_box_origin.y + bounding_box_lengths.y / 2;
-         y += leaf_size) {
-      for (double z = leaf_size / 2 + bounding_box_origin.z -
-                      bounding_box_lengths.z / 2;
-           z < bounding_box_origin.z + bounding_box_lengths.z / 2;
-           z += leaf_size) {
-        ignition::math::Vector3d point(x, y, z);
-        if (CheckIfInterest(point, ray, leaf_size)) {
-          octomap_->setNodeValue(x, y, z, 1);
-        }
-      }
+
+  // Reuse the octomap if neither the world nor the request changed.
+  const uint64_t hash = OctomapHash(msg);
+  if (octomap_ && hash == octomap_hash_) {
+    gzmsg << "World did not change, reusing the octomap.\n";
+    return;
+  }
+
+  // Cell centers lie at min + leaf_size / 2 + i * leaf_size, inside the box.
+  SamplingGrid grid;
+  grid.min = bounding_box_origin - bounding_box_lengths / 2 +
+             ignition::math::Vector3d(leaf_size / 2, leaf_size / 2, leaf_size / 2);
+  grid.leaf_size = leaf_size;
+  for (int axis = 0; axis < 3; ++axis) {
+    int& num_cells = grid.num_cells[axis];
+    num_cells = std::max(
+        0, static_cast<int>(std::ceil((bounding_box_lengths[axis] - leaf_size / 2) /
+                                      leaf_size)));
+    while (num_cells > 0 &&
+           leaf_size / 2 + (num_cells - 1) * leaf_size >= bounding_box_lengths[axis]) {
+      --num_cells;
     }
   }
-  octomap_->prune();
-  octomap_->updateInnerOccupancy();
 
-  // flood fill from top and bottom
-  std::cout << "\rFlood filling freespace...                                  ";
-  FloodFill(ignition::math::Vector3d (bounding_box_origin.x + leaf_size / 2,
-                          bounding_box_origin.y + leaf_size / 2,
-                          bounding_box_origin.z + bounding_box_lengths.z / 2 -
-                              leaf_size / 2),
-            bounding_box_origin, bounding_box_lengths, leaf_size);
-  FloodFill(ignition::math::Vector3d (bounding_box_origin.x + leaf_size / 2,
-                          bounding_box_origin.y + leaf_size / 2,
-                          bounding_box_origin.z - bounding_box_lengths.z / 2 +
-                              leaf_size / 2),
-            bounding_box_origin, bounding_box_lengths, leaf_size);
+  // Incrementally updated octomaps are not cached, they can differ from the
+  // full build in enclosed space.
+  if (incremental_ && has_incremental_state_ && grid == grid_) {
+    UpdateOctomap(msg);
+    octomap_hash_ = hash;
+    return;
+  }
+  grid_ = grid;
+  std::ostringstream cache_name;
+  cache_name << std::hex << std::setw(16) << std::setfill('0') << hash << ".bt";
+  const boost::filesystem::path cache_path =
+      boost::filesystem::path(cache_directory_) / cache_name.str();
+  if (!cache_directory_.empty() && boost::filesystem::exists(cache_path)) {
+    ResetOctomap(leaf_size);
+    if (octomap_->readBinary(cache_path.string())) {
+      gzmsg << "Loaded cached octomap " << cache_path.string() << "\n";
+      octomap_hash_ = hash;
+      return;
+    }
+    gzerr << "Could not read cached octomap " << cache_path.string()
+          << ", creating it.\n";
+  }
+  ResetOctomap(leaf_size);
+  octomap_hash_ = 0;
 
-  octomap_->prune();
-  octomap_->updateInnerOccupancy();
+  const int* num_cells = grid.num_cells;
+  const int64_t slab_size = static_cast<int64_t>(num_cells[1]) * num_cells[2];
+  if (grid.NumCells() == 0) {
+    gzerr << "The bounding box does not contain any cell.\n";
+    return;
+  }
+
+  common::Timer timer;
+  timer.Start();
 
-  // set unknown to filled
-  for (double x =
-           leaf_size / 2 + bounding_box_origin.x - bounding_box_lengths.x / 2;
-       x < bounding_box_origin.x + bounding_box_lengths.x / 2; x += leaf_size) {
-    int progress =
-        round(100 * (x + bounding_box_lengths.x / 2 - bounding_box_origin.x) /
-              bounding_box_lengths.x);
-    std::cout << "\rFilling closed spaces... " << progress << "%              ";
-
-    for (double y =
-             leaf_size / 2 + bounding_box_origin.y - bounding_box_lengths.y / 2;
-         y < bounding_box_origin.y + bounding_box_lengths.y / 2;
-         y += leaf_size) {
-      for (double z = leaf_size / 2 + bounding_box_origin.z -
-                      bounding_box_lengths.z / 2;
-           z < bounding_box_origin.z + bounding_box_lengths.z / 2;
-           z += leaf_size) {
-        octomap::OcTreeNode* seed = octomap_->search(x, y, z);
-        if (!seed) octomap_->setNodeValue(x, y, z, 1);
+  // Dense bitmaps of the occupied and the free cells of the grid.
+  std::vector<bool> occupied_cells(grid.NumCells(), false);
+  std::vector<bool> free_cells(grid.NumCells(), false);
+  ModelBoundsMap model_bounds;
+
+  {
+    gazebo::physics::PhysicsEnginePtr engine = world_->Physics();
+    // Keep the world from stepping while the rays are cast on the workers.
+    boost::recursive_mutex::scoped_lock physics_lock(
+        *engine->GetPhysicsUpdateMutex());
+    if (incremental_ || esdf_) {
+      model_bounds = ModelBounds();
+    }
+
+    if (mesh_voxelization_) {
+      VoxelizeCollisions(grid, NULL, NULL, &occupied_cells);
+    } else {
+      // Every worker casts its own ray.
+      std::vector<gazebo::physics::RayShapePtr> rays;
+      for (int thread = 0; thread < num_threads_; ++thread) {
+        rays.push_back(boost::dynamic_pointer_cast<gazebo::physics::RayShape>(
+            engine->CreateShape("ray", gazebo::physics::CollisionPtr())));
+      }
+
+      std::vector<GeometryBound> bounds;
+      if (hierarchical_) {
+        bounds = CollectGeometryBounds(world_);
+      }
+      std::atomic<int64_t> num_ray_tests(0);
+
+      ProcessSlabs<int64_t>(
+          num_cells[0], "Placing model edges into octomap",
+          [&engine]() { engine->InitForThread(); },
+          [&](int thread, int ix, CellVector* cells) {
+            if (hierarchical_) {
+              std::vector<const GeometryBound*> candidates;
+              for (const GeometryBound& bound : bounds) {
+                candidates.push_back(&bound);
+              }
+              int64_t slab_ray_tests = 0;
+              RasterizeNearGeometry(ix, 0, num_cells[1], 0, num_cells[2], grid,
+                                    candidates, rays[thread], cells,
+                                    &slab_ray_tests);
+              num_ray_tests += slab_ray_tests;
+              return;
+            }
+            for (int iy = 0; iy < num_cells[1]; ++iy) {
+              for (int iz = 0; iz < num_cells[2]; ++iz) {
+                const ignition::math::Vector3d point = grid.CellCenter(ix, iy, iz);
+                if (CheckIfInterest(point, rays[thread], leaf_size)) {
+                  cells->push_back(static_cast<int64_t>(iy) * num_cells[2] + iz);
+                }
+              }
+            }
+          },
+          [&](int ix, const CellVector& cells) {
+            for (int64_t cell : cells) {
+              occupied_cells[ix * slab_size + cell] = true;
+            }
+          },
+          true);
+
+      if (hierarchical_) {
+        gzmsg << "Ray tested " << num_ray_tests.load() << " of "
+              << grid.NumCells() << " cells near " << bounds.size()
+              << " collision bounds.\n";
       }
     }
   }
 
+  // flood fill from top and bottom
+  gzmsg << "Flood filling freespace...\n";
+  common::Timer flood_fill_timer;
+  flood_fill_timer.Start();
+  FloodFill(grid, num_cells[0] / 2, num_cells[1] / 2, num_cells[2] - 1,
+            occupied_cells, &free_cells);
+  FloodFill(grid, num_cells[0] / 2, num_cells[1] / 2, 0, occupied_cells,
+            &free_cells);
+  gzmsg << "Flood filling freespace took "
+        << flood_fill_timer.GetElapsed().Double() << " s.\n";
+
+  // Free cells are set free, occupied ones and the remaining unknown ones
+  // occupied. The workers only compute the keys.
+  ProcessSlabs<octomap::OcTreeKey>(
+      num_cells[0], "Filling closed spaces", []() {},
+      [&](int, int ix, KeyVector* keys) {
+        keys->reserve(slab_size);
+        for (int iy = 0; iy < num_cells[1]; ++iy) {
+          for (int iz = 0; iz < num_cells[2]; ++iz) {
+            const ignition::math::Vector3d point = grid.CellCenter(ix, iy, iz);
+            keys->push_back(octomap_->coordToKey(point.X(), point.Y(), point.Z()));
+          }
+        }
+      },
+      [&](int ix, const KeyVector& keys) {
+        for (int64_t cell = 0; cell < slab_size; ++cell) {
+          const bool is_free = free_cells[ix * slab_size + cell];
+          octomap_->setNodeValue(keys[cell], is_free ? 0 : 1, true);
+        }
+      },
+      true);
+
   octomap_->prune();
   octomap_->updateInnerOccupancy();
 
-  std::cout << "\rOctomap generation completed                  " << std::endl;
+  gzmsg << "Octomap generation completed in " << timer.GetElapsed().Double()
+        << " s.\n";
+
+  octomap_hash_ = hash;
+  if (incremental_ || esdf_) {
+    occupied_cells_.swap(occupied_cells);
+    free_cells_.swap(free_cells);
+    model_bounds_.swap(model_bounds);
+    has_incremental_state_ = true;
+  }
+  if (!cache_directory_.empty()) {
+    // Write to a temporary file first, so that no partial octomap is cached.
+    const boost::filesystem::path temporary_path =
+        cache_path.string() + ".tmp";
+    boost::system::error_code error;
+    boost::filesystem::create_directories(cache_directory_, error);
+    if (!error) {
+      if (octomap_->writeBinary(temporary_path.string())) {
+        boost::filesystem::rename(temporary_path, cache_path, error);
+      } else {
+        error = boost::system::errc::make_error_code(
+            boost::system::errc::io_error);
+      }
+      if (error) {
+        // Do not leave a partial octomap behind.
+        boost::system::error_code remove_error;
+        boost::filesystem::remove(temporary_path, remove_error);
+      }
+    }
+    if (error) {
+      gzerr << "Could not cache the octomap as " << cache_path.string() << ": "
+            << error.message() << "\n";
+    } else {
+      gzmsg << "Cached the octomap as " << cache_path.string() << "\n";
+    }
+  }
 }
 
 // Register this plugin with the simulator
@@ -23,13 +23,10 @@
 #include "rotors_gazebo_plugins/gazebo_odometry_plugin.h"
 
 // SYSTEM
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 
-// 3RD PARTY
-#include <opencv2/core/core.hpp>
-#include <opencv2/highgui/highgui.hpp>
-
 // USER
 #include <rotors_gazebo_plugins/common.h>
 #include "ConnectGazeboToRosTopic.pb.h"
@@ -65,8 +62,6 @@ void GazeboOdometryPlugin::Load(physics::ModelPtr _model,
   SdfVector3 noise_uniform_angular_velocity;
   const SdfVector3 zeros3(0.0, 0.0, 0.0);
 
-  odometry_queue_.clear();
-
   if (_sdf->HasElement("robotNamespace"))
     namespace_ = _sdf->GetElement("robotNamespace")->Get<std::string>();
   else
@@ -85,18 +80,8 @@ void GazeboOdometryPlugin::Load(physics::ModelPtr _model,
   if (link_ == NULL)
     gzthrow("[gazebo_odometry_plugin] Couldn't find specified link \""
             << link_name_ << "\".");
-
-  if (_sdf->HasElement("covarianceImage")) {
-    std::string image_name =
-        _sdf->GetElement("covarianceImage")->Get<std::string>();
-    covariance_image_ = cv::imread(image_name, CV_LOAD_IMAGE_GRAYSCALE);
-    if (covariance_image_.data == NULL)
-      gzerr << "loading covariance image " << image_name << " failed"
-            << std::endl;
-    else
-      gzlog << "loading covariance image " << image_name << " successful"
-            << std::endl;
-  }
+  link_state_ = RigidBodyStateCache::Get(link_);
+  fidelity_ = ModelFidelity::Get(model_, _sdf);
 
   if (_sdf->HasElement("randomEngineSeed")) {
     random_generator_.seed(
@@ -142,6 +127,53 @@ void GazeboOdometryPlugin::Load(physics::ModelPtr _model,
   getSdfParam<double>(_sdf, "unknownDelay", unknown_delay_, unknown_delay_);
   getSdfParam<double>(_sdf, "covarianceImageScale", covariance_image_scale_,
                       covariance_image_scale_);
+  getSdfParam<double>(_sdf, "covarianceImageMaxNoiseScale",
+                      covariance_image_max_noise_scale_,
+                      covariance_image_max_noise_scale_);
+  getSdfParam<int>(_sdf, "poseDivisor", pose_divisor_, pose_divisor_);
+  getSdfParam<int>(_sdf, "poseWithCovarianceDivisor",
+                   pose_with_covariance_stamped_divisor_,
+                   pose_with_covariance_stamped_divisor_);
+  getSdfParam<int>(_sdf, "positionDivisor", position_stamped_divisor_,
+                   position_stamped_divisor_);
+  getSdfParam<int>(_sdf, "transformDivisor", transform_stamped_divisor_,
+                   transform_stamped_divisor_);
+  getSdfParam<int>(_sdf, "odometryDivisor", odometry_divisor_,
+                   odometry_divisor_);
+  getSdfParam<int>(_sdf, "broadcastTransformDivisor",
+                   broadcast_transform_divisor_, broadcast_transform_divisor_);
+  getSdfParam<bool>(_sdf, "shmTransport", shm_transport_, shm_transport_);
+
+  // Either a grayscale image centered around the origin, or a map in the
+  // tiled format of covariance_map_converter.
+  if (_sdf->HasElement("covarianceImage")) {
+    std::string image_name =
+        _sdf->GetElement("covarianceImage")->Get<std::string>();
+    covariance_map_ = CovarianceMap::Get(image_name, covariance_image_scale_);
+    if (!covariance_map_)
+      gzerr << "loading covariance image " << image_name << " failed"
+            << std::endl;
+    else
+      gzlog << "loading covariance image " << image_name << " successful"
+            << std::endl;
+  }
+
+  if (measurement_divisor_ < 1 || pose_divisor_ < 1 ||
+      pose_with_covariance_stamped_divisor_ < 1 ||
+      position_stamped_divisor_ < 1 || transform_stamped_divisor_ < 1 ||
+      odometry_divisor_ < 1 || broadcast_transform_divisor_ < 1) {
+    gzthrow("[gazebo_odometry_plugin] Divisors must be at least 1.");
+  }
+
+  // A measurement is taken every measurement_divisor_ steps and published
+  // measurement_delay_ steps later.
+  odometry_queue_.UseArena(
+      ModelArena::ForPlugin(model_, "gazebo_odometry_plugin"));
+  odometry_queue_.Reset(
+      OdometryQueue::CapacityFor(measurement_delay_, measurement_divisor_));
+  measurement_offset_ = UpdateDispatcher::Stagger(
+      world_, _sdf, "gazebo_odometry_plugin", "measurement",
+      measurement_divisor_);
 
   parent_link_ = world_->EntityByName(parent_frame_id_);
   if (parent_link_ == NULL && parent_frame_id_ != kDefaultParentFrameId) {
@@ -226,172 +258,181 @@ void GazeboOdometryPlugin::Load(physics::ModelPtr _model,
       noise_normal_angular_velocity.Z() * noise_normal_angular_velocity.Z();
   twist_covariance = twist_covd.asDiagonal();
 
-  // Listen to the update event. This event is broadcast every
-  // simulation iteration.
-  updateConnection_ = event::Events::ConnectWorldUpdateBegin(
+  // The frame IDs and covariances of the odometry message never change.
+  odometry_msg_.mutable_header()->set_frame_id(parent_frame_id_);
+  odometry_msg_.set_child_frame_id(child_frame_id_);
+  for (int i = 0; i < pose_covariance_matrix_.size(); i++) {
+    odometry_msg_.mutable_pose()->add_covariance(pose_covariance_matrix_[i]);
+  }
+  for (int i = 0; i < twist_covariance_matrix_.size(); i++) {
+    odometry_msg_.mutable_twist()->add_covariance(twist_covariance_matrix_[i]);
+  }
+  std::copy(pose_covariance_matrix_.begin(), pose_covariance_matrix_.end(),
+            odometry_record_.pose_covariance);
+  std::copy(twist_covariance_matrix_.begin(), twist_covariance_matrix_.end(),
+            odometry_record_.twist_covariance);
+  transform_stamped_with_frame_ids_msg_.set_parent_frame_id(parent_frame_id_);
+  transform_stamped_with_frame_ids_msg_.set_child_frame_id(child_frame_id_);
+
+  // Listen to the update event, either directly or through the update
+  // dispatcher of the world. This event is broadcast every simulation
+  // iteration.
+  updateConnection_ = UpdateDispatcher::Connect(
+      _model, _sdf, "gazebo_odometry_plugin", kUpdatePrioritySensor,
       boost::bind(&GazeboOdometryPlugin::OnUpdate, this, _1));
+  checkpoint_connection_ = SimulationCheckpoint::Connect(
+      world_,
+      model_->GetScopedName() + "/gazebo_odometry_plugin/" + link_name_,
+      boost::bind(&GazeboOdometryPlugin::SaveCheckpoint, this, _1),
+      boost::bind(&GazeboOdometryPlugin::RestoreCheckpoint, this, _1));
 }
 
 // This gets called by the world update start event.
 void GazeboOdometryPlugin::OnUpdate(const common::UpdateInfo& _info) {
-  if (kPrintOnUpdates) {
-    gzdbg << __FUNCTION__ << "() called." << std::endl;
-  }
+  ROTORS_PROFILE_SCOPE("gazebo_odometry_plugin");
 
   if (!pubs_and_subs_created_) {
     CreatePubsAndSubs();
     pubs_and_subs_created_ = true;
   }
 
-  // C denotes child frame, P parent frame, and W world frame.
-  // Further C_pose_W_P denotes pose of P wrt. W expressed in C.
-  ignition::math::Pose3d W_pose_W_C = link_->WorldCoGPose();
-  ignition::math::Vector3d C_linear_velocity_W_C = link_->RelativeLinearVel();
-  ignition::math::Vector3d C_angular_velocity_W_C = link_->RelativeAngularVel();
-
-  ignition::math::Vector3d gazebo_linear_velocity = C_linear_velocity_W_C;
-  ignition::math::Vector3d gazebo_angular_velocity = C_angular_velocity_W_C;
-  ignition::math::Pose3d gazebo_pose = W_pose_W_C;
-
-  if (parent_frame_id_ != kDefaultParentFrameId) {
-    ignition::math::Pose3d W_pose_W_P = parent_link_->WorldPose();
-    ignition::math::Vector3d P_linear_velocity_W_P = parent_link_->RelativeLinearVel();
-    ignition::math::Vector3d P_angular_velocity_W_P =
-        parent_link_->RelativeAngularVel();
-    ignition::math::Pose3d C_pose_P_C_ = W_pose_W_C - W_pose_W_P;
-    ignition::math::Vector3d C_linear_velocity_P_C;
-    // \prescript{}{C}{\dot{r}}_{PC} = -R_{CP}
-    //       \cdot \prescript{}{P}{\omega}_{WP} \cross \prescript{}{P}{r}_{PC}
-    //       + \prescript{}{C}{v}_{WC}
-    //                                 - R_{CP} \cdot \prescript{}{P}{v}_{WP}
-    C_linear_velocity_P_C =
-        -C_pose_P_C_.Rot().Inverse() *
-            P_angular_velocity_W_P.Cross(C_pose_P_C_.Pos()) +
-        C_linear_velocity_W_C -
-        C_pose_P_C_.Rot().Inverse() * P_linear_velocity_W_P;
-
-    // \prescript{}{C}{\omega}_{PC} = \prescript{}{C}{\omega}_{WC}
-    //       - R_{CP} \cdot \prescript{}{P}{\omega}_{WP}
-    gazebo_angular_velocity =
-        C_angular_velocity_W_C -
-        C_pose_P_C_.Rot().Inverse() * P_angular_velocity_W_P;
-    gazebo_linear_velocity = C_linear_velocity_P_C;
-    gazebo_pose = C_pose_P_C_;
+  // At low fidelity, the ground truth is published right away every
+  // rate_divisor() updates, without noise and delay.
+  const bool low_fidelity = fidelity_->low();
+  if (low_fidelity && !odometry_queue_.Empty()) {
+    odometry_queue_.Reset(odometry_queue_.Capacity());
   }
+  const bool measurement_due =
+      low_fidelity ? !fidelity_->Skip(world_->Iterations())
+                   : measurement_offset_->Due(world_->Iterations());
+  const int measurement_delay = low_fidelity ? 0 : measurement_delay_;
+
+  // Only every measurement_divisor_ steps a measurement is taken, skip the
+  // transforms in between.
+  if (measurement_due && !odometry_queue_.Full()) {
+    // C denotes child frame, P parent frame, and W world frame.
+    // Further C_pose_W_P denotes pose of P wrt. W expressed in C.
+    const RigidBodyState state = link_state_->State();
+    ignition::math::Pose3d W_pose_W_C = state.world_cog_pose;
+    ignition::math::Vector3d C_linear_velocity_W_C = state.relative_linear_vel;
+    ignition::math::Vector3d C_angular_velocity_W_C = state.relative_angular_vel;
+
+    ignition::math::Vector3d gazebo_linear_velocity = C_linear_velocity_W_C;
+    ignition::math::Vector3d gazebo_angular_velocity = C_angular_velocity_W_C;
+    ignition::math::Pose3d gazebo_pose = W_pose_W_C;
+
+    if (parent_frame_id_ != kDefaultParentFrameId) {
+      ignition::math::Pose3d W_pose_W_P = parent_link_->WorldPose();
+      ignition::math::Vector3d P_linear_velocity_W_P = parent_link_->RelativeLinearVel();
+      ignition::math::Vector3d P_angular_velocity_W_P =
+          parent_link_->RelativeAngularVel();
+      ignition::math::Pose3d C_pose_P_C_ = W_pose_W_C - W_pose_W_P;
+      ignition::math::Vector3d C_linear_velocity_P_C;
+      // \prescript{}{C}{\dot{r}}_{PC} = -R_{CP}
+      //       \cdot \prescript{}{P}{\omega}_{WP} \cross \prescript{}{P}{r}_{PC}
+      //       + \prescript{}{C}{v}_{WC}
+      //                                 - R_{CP} \cdot \prescript{}{P}{v}_{WP}
+      C_linear_velocity_P_C =
+          -C_pose_P_C_.Rot().Inverse() *
+              P_angular_velocity_W_P.Cross(C_pose_P_C_.Pos()) +
+          C_linear_velocity_W_C -
+          C_pose_P_C_.Rot().Inverse() * P_linear_velocity_W_P;
+
+      // \prescript{}{C}{\omega}_{PC} = \prescript{}{C}{\omega}_{WC}
+      //       - R_{CP} \cdot \prescript{}{P}{\omega}_{WP}
+      gazebo_angular_velocity =
+          C_angular_velocity_W_C -
+          C_pose_P_C_.Rot().Inverse() * P_angular_velocity_W_P;
+      gazebo_linear_velocity = C_linear_velocity_P_C;
+      gazebo_pose = C_pose_P_C_;
+    }
+
+    // This flag could be set to false in the following code...
+    bool publish_odometry = true;
+    double noise_scale = 1.0;
 
-  // This flag could be set to false in the following code...
-  bool publish_odometry = true;
-
-  // First, determine whether we should publish a odometry.
-  if (covariance_image_.data != NULL) {
-    // We have an image.
-
-    // Image is always centered around the origin:
-    int width = covariance_image_.cols;
-    int height = covariance_image_.rows;
-    int x = static_cast<int>(
-                std::floor(gazebo_pose.Pos().X() / covariance_image_scale_)) +
-            width / 2;
-    int y = static_cast<int>(
-                std::floor(gazebo_pose.Pos().Y() / covariance_image_scale_)) +
-            height / 2;
-
-    if (x >= 0 && x < width && y >= 0 && y < height) {
-      uint8_t pixel_value = covariance_image_.at<uint8_t>(y, x);
-      if (pixel_value == 0) {
+    // First, determine whether we should publish a odometry. Outside of the
+    // map, the odometry is published with the nominal noise.
+    if (covariance_map_) {
+      const int intensity = covariance_map_->Intensity(gazebo_pose.Pos().X(),
+                                                       gazebo_pose.Pos().Y());
+      if (intensity == 0) {
         publish_odometry = false;
-        // TODO: covariance scaling, according to the intensity values could be
-        // implemented here.
+      } else if (intensity > 0) {
+        noise_scale = 1.0 + (covariance_image_max_noise_scale_ - 1.0) *
+                                (255 - intensity) / 254.0;
       }
     }
-  }
 
-  if (gazebo_sequence_ % measurement_divisor_ == 0) {
-    gz_geometry_msgs::Odometry odometry;
-    odometry.mutable_header()->set_frame_id(parent_frame_id_);
-    odometry.mutable_header()->mutable_stamp()->set_sec(
-        (world_->SimTime()).sec + static_cast<int32_t>(unknown_delay_));
-    odometry.mutable_header()->mutable_stamp()->set_nsec(
-        (world_->SimTime()).nsec + static_cast<int32_t>(unknown_delay_));
-    odometry.set_child_frame_id(child_frame_id_);
-
-    odometry.mutable_pose()->mutable_pose()->mutable_position()->set_x(
-        gazebo_pose.Pos().X());
-    odometry.mutable_pose()->mutable_pose()->mutable_position()->set_y(
-        gazebo_pose.Pos().Y());
-    odometry.mutable_pose()->mutable_pose()->mutable_position()->set_z(
-        gazebo_pose.Pos().Z());
-
-    odometry.mutable_pose()->mutable_pose()->mutable_orientation()->set_x(
-        gazebo_pose.Rot().X());
-    odometry.mutable_pose()->mutable_pose()->mutable_orientation()->set_y(
-        gazebo_pose.Rot().Y());
-    odometry.mutable_pose()->mutable_pose()->mutable_orientation()->set_z(
-        gazebo_pose.Rot().Z());
-    odometry.mutable_pose()->mutable_pose()->mutable_orientation()->set_w(
-        gazebo_pose.Rot().W());
-
-    odometry.mutable_twist()->mutable_twist()->mutable_linear()->set_x(
-        gazebo_linear_velocity.X());
-    odometry.mutable_twist()->mutable_twist()->mutable_linear()->set_y(
-        gazebo_linear_velocity.Y());
-    odometry.mutable_twist()->mutable_twist()->mutable_linear()->set_z(
-        gazebo_linear_velocity.Z());
-
-    odometry.mutable_twist()->mutable_twist()->mutable_angular()->set_x(
-        gazebo_angular_velocity.X());
-    odometry.mutable_twist()->mutable_twist()->mutable_angular()->set_y(
-        gazebo_angular_velocity.Y());
-    odometry.mutable_twist()->mutable_twist()->mutable_angular()->set_z(
-        gazebo_angular_velocity.Z());
-
-    if (publish_odometry)
-      odometry_queue_.push_back(
-          std::make_pair(gazebo_sequence_ + measurement_delay_, odometry));
+    if (publish_odometry) {
+      OdometryMeasurement& measurement =
+          *odometry_queue_.Push(gazebo_sequence_ + measurement_delay);
+      measurement.stamp_sec =
+          (world_->SimTime()).sec + static_cast<int32_t>(unknown_delay_);
+      measurement.stamp_nsec =
+          (world_->SimTime()).nsec + static_cast<int32_t>(unknown_delay_);
+      measurement.pose = gazebo_pose;
+      measurement.linear_velocity = gazebo_linear_velocity;
+      measurement.angular_velocity = gazebo_angular_velocity;
+      measurement.noise_scale = noise_scale;
+    }
   }
 
   // Is it time to publish the front element?
-  if (gazebo_sequence_ == odometry_queue_.front().first) {
-    // Copy the odometry message that is on the queue
-    gz_geometry_msgs::Odometry odometry_msg(odometry_queue_.front().second);
+  if (odometry_queue_.Ready(gazebo_sequence_)) {
+    PublishMeasurement(odometry_queue_.Front(), !low_fidelity);
+    odometry_queue_.Pop();
+    ++odometry_sequence_;
+  }
 
-    // Now that we have copied the first element from the queue, remove it.
-    odometry_queue_.pop_front();
+  ++gazebo_sequence_;
+}
 
+void GazeboOdometryPlugin::PublishMeasurement(
+    const OdometryMeasurement& measurement, bool add_noise) {
+  const bool publish_pose = OutputDue(pose_pub_, pose_divisor_);
+  const bool publish_pose_with_covariance_stamped =
+      OutputDue(pose_with_covariance_stamped_pub_,
+                pose_with_covariance_stamped_divisor_);
+  const bool publish_position_stamped =
+      OutputDue(position_stamped_pub_, position_stamped_divisor_);
+  const bool publish_transform_stamped =
+      OutputDue(transform_stamped_pub_, transform_stamped_divisor_);
+  const bool publish_odometry = OutputDue(odometry_pub_, odometry_divisor_);
+  const bool publish_broadcast_transform =
+      OutputDue(broadcast_transform_pub_, broadcast_transform_divisor_);
+  const bool write_odometry_shm =
+      odometry_shm_.IsOpen() && odometry_sequence_ % odometry_divisor_ == 0;
+
+  if (!publish_pose && !publish_pose_with_covariance_stamped &&
+      !publish_position_stamped && !publish_transform_stamped &&
+      !publish_odometry && !publish_broadcast_transform &&
+      !write_odometry_shm) {
+    return;
+  }
+
+  Eigen::Vector3d pos_n = Eigen::Vector3d::Zero();
+  Eigen::Quaterniond q_n = Eigen::Quaterniond::Identity();
+  Eigen::Vector3d linear_velocity_n = Eigen::Vector3d::Zero();
+  Eigen::Vector3d angular_velocity_n = Eigen::Vector3d::Zero();
+  if (add_noise) {
     // Calculate position distortions.
-    Eigen::Vector3d pos_n;
     pos_n << position_n_[0](random_generator_) +
                  position_u_[0](random_generator_),
         position_n_[1](random_generator_) + position_u_[1](random_generator_),
         position_n_[2](random_generator_) + position_u_[2](random_generator_);
 
-    gazebo::msgs::Vector3d* p =
-        odometry_msg.mutable_pose()->mutable_pose()->mutable_position();
-    p->set_x(p->x() + pos_n[0]);
-    p->set_y(p->y() + pos_n[1]);
-    p->set_z(p->z() + pos_n[2]);
-
     // Calculate attitude distortions.
     Eigen::Vector3d theta;
     theta << attitude_n_[0](random_generator_) +
                  attitude_u_[0](random_generator_),
         attitude_n_[1](random_generator_) + attitude_u_[1](random_generator_),
         attitude_n_[2](random_generator_) + attitude_u_[2](random_generator_);
-    Eigen::Quaterniond q_n = QuaternionFromSmallAngle(theta);
+    theta *= measurement.noise_scale;
+    q_n = QuaternionFromSmallAngle(theta);
     q_n.normalize();
 
-    gazebo::msgs::Quaternion* q_W_L =
-        odometry_msg.mutable_pose()->mutable_pose()->mutable_orientation();
-
-    Eigen::Quaterniond _q_W_L(q_W_L->w(), q_W_L->x(), q_W_L->y(), q_W_L->z());
-    _q_W_L = _q_W_L * q_n;
-    q_W_L->set_w(_q_W_L.w());
-    q_W_L->set_x(_q_W_L.x());
-    q_W_L->set_y(_q_W_L.y());
-    q_W_L->set_z(_q_W_L.z());
-
     // Calculate linear velocity distortions.
-    Eigen::Vector3d linear_velocity_n;
     linear_velocity_n << linear_velocity_n_[0](random_generator_) +
                              linear_velocity_u_[0](random_generator_),
         linear_velocity_n_[1](random_generator_) +
@@ -399,15 +440,7 @@ void GazeboOdometryPlugin::OnUpdate(const common::UpdateInfo& _info) {
         linear_velocity_n_[2](random_generator_) +
             linear_velocity_u_[2](random_generator_);
 
-    gazebo::msgs::Vector3d* linear_velocity =
-        odometry_msg.mutable_twist()->mutable_twist()->mutable_linear();
-
-    linear_velocity->set_x(linear_velocity->x() + linear_velocity_n[0]);
-    linear_velocity->set_y(linear_velocity->y() + linear_velocity_n[1]);
-    linear_velocity->set_z(linear_velocity->z() + linear_velocity_n[2]);
-
     // Calculate angular velocity distortions.
-    Eigen::Vector3d angular_velocity_n;
     angular_velocity_n << angular_velocity_n_[0](random_generator_) +
                               angular_velocity_u_[0](random_generator_),
         angular_velocity_n_[1](random_generator_) +
@@ -415,109 +448,144 @@ void GazeboOdometryPlugin::OnUpdate(const common::UpdateInfo& _info) {
         angular_velocity_n_[2](random_generator_) +
             angular_velocity_u_[2](random_generator_);
 
-    gazebo::msgs::Vector3d* angular_velocity =
-        odometry_msg.mutable_twist()->mutable_twist()->mutable_angular();
-
-    angular_velocity->set_x(angular_velocity->x() + angular_velocity_n[0]);
-    angular_velocity->set_y(angular_velocity->y() + angular_velocity_n[1]);
-    angular_velocity->set_z(angular_velocity->z() + angular_velocity_n[2]);
+    pos_n *= measurement.noise_scale;
+    linear_velocity_n *= measurement.noise_scale;
+    angular_velocity_n *= measurement.noise_scale;
+  }
 
-    odometry_msg.mutable_pose()->mutable_covariance()->Clear();
+  // The covariances follow the noise scale, they are only rewritten when it
+  // changes.
+  const double noise_scale = add_noise ? measurement.noise_scale : 1.0;
+  if (noise_scale != published_noise_scale_) {
+    const double variance_scale = noise_scale * noise_scale;
     for (int i = 0; i < pose_covariance_matrix_.size(); i++) {
-      odometry_msg.mutable_pose()->mutable_covariance()->Add(
-          pose_covariance_matrix_[i]);
+      odometry_msg_.mutable_pose()->set_covariance(
+          i, pose_covariance_matrix_[i] * variance_scale);
+      odometry_record_.pose_covariance[i] =
+          pose_covariance_matrix_[i] * variance_scale;
     }
-
-    odometry_msg.mutable_twist()->mutable_covariance()->Clear();
     for (int i = 0; i < twist_covariance_matrix_.size(); i++) {
-      odometry_msg.mutable_twist()->mutable_covariance()->Add(
-          twist_covariance_matrix_[i]);
-    }
-
-    // Publish all the topics, for which the topic name is specified.
-    if (pose_pub_->HasConnections()) {
-      pose_pub_->Publish(odometry_msg.pose().pose());
+      odometry_msg_.mutable_twist()->set_covariance(
+          i, twist_covariance_matrix_[i] * variance_scale);
+      odometry_record_.twist_covariance[i] =
+          twist_covariance_matrix_[i] * variance_scale;
     }
+    published_noise_scale_ = noise_scale;
+  }
 
-    if (pose_with_covariance_stamped_pub_->HasConnections()) {
-      gz_geometry_msgs::PoseWithCovarianceStamped
-          pose_with_covariance_stamped_msg;
+  const ignition::math::Vector3d& position = measurement.pose.Pos();
+  const ignition::math::Quaterniond& rotation = measurement.pose.Rot();
+  Eigen::Quaterniond q_W_L(rotation.W(), rotation.X(), rotation.Y(),
+                           rotation.Z());
+  q_W_L = q_W_L * q_n;
+
+  // The frame IDs and covariances were set in Load().
+  odometry_msg_.mutable_header()->mutable_stamp()->set_sec(
+      measurement.stamp_sec);
+  odometry_msg_.mutable_header()->mutable_stamp()->set_nsec(
+      measurement.stamp_nsec);
+
+  gazebo::msgs::Vector3d* p =
+      odometry_msg_.mutable_pose()->mutable_pose()->mutable_position();
+  p->set_x(position.X() + pos_n[0]);
+  p->set_y(position.Y() + pos_n[1]);
+  p->set_z(position.Z() + pos_n[2]);
+
+  gazebo::msgs::Quaternion* q =
+      odometry_msg_.mutable_pose()->mutable_pose()->mutable_orientation();
+  q->set_w(q_W_L.w());
+  q->set_x(q_W_L.x());
+  q->set_y(q_W_L.y());
+  q->set_z(q_W_L.z());
+
+  gazebo::msgs::Vector3d* linear_velocity =
+      odometry_msg_.mutable_twist()->mutable_twist()->mutable_linear();
+  linear_velocity->set_x(measurement.linear_velocity.X() + linear_velocity_n[0]);
+  linear_velocity->set_y(measurement.linear_velocity.Y() + linear_velocity_n[1]);
+  linear_velocity->set_z(measurement.linear_velocity.Z() + linear_velocity_n[2]);
+
+  gazebo::msgs::Vector3d* angular_velocity =
+      odometry_msg_.mutable_twist()->mutable_twist()->mutable_angular();
+  angular_velocity->set_x(measurement.angular_velocity.X() +
+                          angular_velocity_n[0]);
+  angular_velocity->set_y(measurement.angular_velocity.Y() +
+                          angular_velocity_n[1]);
+  angular_velocity->set_z(measurement.angular_velocity.Z() +
+                          angular_velocity_n[2]);
+
+  if (write_odometry_shm) {
+    odometry_record_.stamp.sec = measurement.stamp_sec;
+    odometry_record_.stamp.nsec = measurement.stamp_nsec;
+    odometry_record_.position[0] = p->x();
+    odometry_record_.position[1] = p->y();
+    odometry_record_.position[2] = p->z();
+    odometry_record_.orientation[0] = q->w();
+    odometry_record_.orientation[1] = q->x();
+    odometry_record_.orientation[2] = q->y();
+    odometry_record_.orientation[3] = q->z();
+    odometry_record_.linear_velocity[0] = linear_velocity->x();
+    odometry_record_.linear_velocity[1] = linear_velocity->y();
+    odometry_record_.linear_velocity[2] = linear_velocity->z();
+    odometry_record_.angular_velocity[0] = angular_velocity->x();
+    odometry_record_.angular_velocity[1] = angular_velocity->y();
+    odometry_record_.angular_velocity[2] = angular_velocity->z();
+    odometry_shm_.Write(odometry_record_);
+  }
 
-      pose_with_covariance_stamped_msg.mutable_header()->CopyFrom(
-          odometry_msg.header());
-      pose_with_covariance_stamped_msg.mutable_pose_with_covariance()->CopyFrom(
-          odometry_msg.pose());
+  // Publish all the topics that are due and have subscribers.
+  if (publish_pose) {
+    pose_pub_->Publish(odometry_msg_.pose().pose());
+  }
 
-      pose_with_covariance_stamped_pub_->Publish(
-          pose_with_covariance_stamped_msg);
-    }
+  if (publish_pose_with_covariance_stamped) {
+    pose_with_covariance_stamped_msg_.mutable_header()->CopyFrom(
+        odometry_msg_.header());
+    pose_with_covariance_stamped_msg_.mutable_pose_with_covariance()->CopyFrom(
+        odometry_msg_.pose());
 
-    if (position_stamped_pub_->HasConnections()) {
-      gz_geometry_msgs::Vector3dStamped position_stamped_msg;
-      position_stamped_msg.mutable_header()->CopyFrom(odometry_msg.header());
-      position_stamped_msg.mutable_position()->CopyFrom(
-          odometry_msg.pose().pose().position());
+    pose_with_covariance_stamped_pub_->Publish(
+        pose_with_covariance_stamped_msg_);
+  }
 
-      position_stamped_pub_->Publish(position_stamped_msg);
-    }
+  if (publish_position_stamped) {
+    position_stamped_msg_.mutable_header()->CopyFrom(odometry_msg_.header());
+    position_stamped_msg_.mutable_position()->CopyFrom(*p);
 
-    if (transform_stamped_pub_->HasConnections()) {
-      gz_geometry_msgs::TransformStamped transform_stamped_msg;
+    position_stamped_pub_->Publish(position_stamped_msg_);
+  }
 
-      transform_stamped_msg.mutable_header()->CopyFrom(odometry_msg.header());
-      transform_stamped_msg.mutable_transform()->mutable_translation()->set_x(
-          p->x());
-      transform_stamped_msg.mutable_transform()->mutable_translation()->set_y(
-          p->y());
-      transform_stamped_msg.mutable_transform()->mutable_translation()->set_z(
-          p->z());
-      transform_stamped_msg.mutable_transform()->mutable_rotation()->CopyFrom(
-          *q_W_L);
+  if (publish_transform_stamped) {
+    transform_stamped_msg_.mutable_header()->CopyFrom(odometry_msg_.header());
+    transform_stamped_msg_.mutable_transform()->mutable_translation()->CopyFrom(
+        *p);
+    transform_stamped_msg_.mutable_transform()->mutable_rotation()->CopyFrom(*q);
 
-      transform_stamped_pub_->Publish(transform_stamped_msg);
-    }
+    transform_stamped_pub_->Publish(transform_stamped_msg_);
+  }
 
-    if (odometry_pub_->HasConnections()) {
-      // DEBUG
-      odometry_pub_->Publish(odometry_msg);
-    }
+  if (publish_odometry) {
+    odometry_pub_->Publish(odometry_msg_);
+  }
 
-    //==============================================//
-    //========= BROADCAST TRANSFORM MSG ============//
-    //==============================================//
+  //==============================================//
+  //========= BROADCAST TRANSFORM MSG ============//
+  //==============================================//
 
-    gz_geometry_msgs::TransformStampedWithFrameIds
-        transform_stamped_with_frame_ids_msg;
-    transform_stamped_with_frame_ids_msg.mutable_header()->CopyFrom(
-        odometry_msg.header());
-    transform_stamped_with_frame_ids_msg.mutable_transform()
-        ->mutable_translation()
-        ->set_x(p->x());
-    transform_stamped_with_frame_ids_msg.mutable_transform()
+  if (publish_broadcast_transform) {
+    transform_stamped_with_frame_ids_msg_.mutable_header()->CopyFrom(
+        odometry_msg_.header());
+    transform_stamped_with_frame_ids_msg_.mutable_transform()
         ->mutable_translation()
-        ->set_y(p->y());
-    transform_stamped_with_frame_ids_msg.mutable_transform()
-        ->mutable_translation()
-        ->set_z(p->z());
-    transform_stamped_with_frame_ids_msg.mutable_transform()
+        ->CopyFrom(*p);
+    transform_stamped_with_frame_ids_msg_.mutable_transform()
         ->mutable_rotation()
-        ->CopyFrom(*q_W_L);
-    transform_stamped_with_frame_ids_msg.set_parent_frame_id(parent_frame_id_);
-    transform_stamped_with_frame_ids_msg.set_child_frame_id(child_frame_id_);
-
-    broadcast_transform_pub_->Publish(transform_stamped_with_frame_ids_msg);
-
-  }  // if (gazebo_sequence_ == odometry_queue_.front().first) {
+        ->CopyFrom(*q);
 
-  ++gazebo_sequence_;
+    broadcast_transform_pub_->Publish(transform_stamped_with_frame_ids_msg_);
+  }
 }
 
 void GazeboOdometryPlugin::CreatePubsAndSubs() {
-  // Create temporary "ConnectGazeboToRosTopic" publisher and message
-  gazebo::transport::PublisherPtr connect_gazebo_to_ros_topic_pub =
-      node_handle_->Advertise<gz_std_msgs::ConnectGazeboToRosTopic>(
-          "~/" + kConnectGazeboToRosSubtopic, 1);
-
   gz_std_msgs::ConnectGazeboToRosTopic connect_gazebo_to_ros_topic_msg;
 
   // ============================================ //
@@ -533,8 +601,7 @@ void GazeboOdometryPlugin::CreatePubsAndSubs() {
                                                 pose_pub_topic_);
   connect_gazebo_to_ros_topic_msg.set_msgtype(
       gz_std_msgs::ConnectGazeboToRosTopic::POSE);
-  connect_gazebo_to_ros_topic_pub->Publish(connect_gazebo_to_ros_topic_msg,
-                                           true);
+  ros_bridge_connector_.Add(connect_gazebo_to_ros_topic_msg);
 
   // ============================================ //
   // == POSE WITH COVARIANCE STAMPED MSG SETUP == //
@@ -550,8 +617,7 @@ void GazeboOdometryPlugin::CreatePubsAndSubs() {
       namespace_ + "/" + pose_with_covariance_stamped_pub_topic_);
   connect_gazebo_to_ros_topic_msg.set_msgtype(
       gz_std_msgs::ConnectGazeboToRosTopic::POSE_WITH_COVARIANCE_STAMPED);
-  connect_gazebo_to_ros_topic_pub->Publish(connect_gazebo_to_ros_topic_msg,
-                                           true);
+  ros_bridge_connector_.Add(connect_gazebo_to_ros_topic_msg);
 
   // ============================================ //
   // ========= POSITION STAMPED MSG SETUP ======= //
@@ -567,8 +633,7 @@ void GazeboOdometryPlugin::CreatePubsAndSubs() {
                                                 position_stamped_pub_topic_);
   connect_gazebo_to_ros_topic_msg.set_msgtype(
       gz_std_msgs::ConnectGazeboToRosTopic::VECTOR_3D_STAMPED);
-  connect_gazebo_to_ros_topic_pub->Publish(connect_gazebo_to_ros_topic_msg,
-                                           true);
+  ros_bridge_connector_.Add(connect_gazebo_to_ros_topic_msg);
 
   // ============================================ //
   // ============= ODOMETRY MSG SETUP =========== //
@@ -583,8 +648,19 @@ void GazeboOdometryPlugin::CreatePubsAndSubs() {
                                                 odometry_pub_topic_);
   connect_gazebo_to_ros_topic_msg.set_msgtype(
       gz_std_msgs::ConnectGazeboToRosTopic::ODOMETRY);
-  connect_gazebo_to_ros_topic_pub->Publish(connect_gazebo_to_ros_topic_msg,
-                                           true);
+  if (shm_transport_) {
+    const std::string shm_name =
+        ShmRingName("~/" + namespace_ + "/" + odometry_pub_topic_);
+    if (odometry_shm_.Create(shm_name, parent_frame_id_, child_frame_id_)) {
+      connect_gazebo_to_ros_topic_msg.set_shm_name(shm_name);
+    } else {
+      gzerr << "[gazebo_odometry_plugin] Can't create the shared memory ring \""
+            << shm_name << "\", publishing over Gazebo transport only.\n";
+    }
+  }
+  ros_bridge_connector_.Add(connect_gazebo_to_ros_topic_msg);
+  // The message is reused for the following connections.
+  connect_gazebo_to_ros_topic_msg.clear_shm_name();
 
   // ============================================ //
   // ======== TRANSFORM STAMPED MSG SETUP ======= //
@@ -600,8 +676,8 @@ void GazeboOdometryPlugin::CreatePubsAndSubs() {
                                                 transform_stamped_pub_topic_);
   connect_gazebo_to_ros_topic_msg.set_msgtype(
       gz_std_msgs::ConnectGazeboToRosTopic::TRANSFORM_STAMPED);
-  connect_gazebo_to_ros_topic_pub->Publish(connect_gazebo_to_ros_topic_msg,
-                                           true);
+  ros_bridge_connector_.Add(connect_gazebo_to_ros_topic_msg);
+  ros_bridge_connector_.Publish(node_handle_);
 
   // ============================================ //
   // ===== "BROADCAST TRANSFORM" MSG SETUP =====  //
@@ -612,6 +688,67 @@ void GazeboOdometryPlugin::CreatePubsAndSubs() {
           "~/" + kBroadcastTransformSubtopic, 1);
 }
 
+void GazeboOdometryPlugin::SaveCheckpoint(CheckpointWriter* writer) {
+  writer->WriteText(random_generator_);
+  // The normal distributions cache every second sample.
+  for (int i = 0; i < 3; ++i) {
+    writer->WriteText(position_n_[i]);
+    writer->WriteText(attitude_n_[i]);
+    writer->WriteText(linear_velocity_n_[i]);
+    writer->WriteText(angular_velocity_n_[i]);
+  }
+
+  writer->Write<int32_t>(gazebo_sequence_);
+  writer->Write<int32_t>(odometry_sequence_);
+  writer->Write<uint64_t>(odometry_queue_.Size());
+  for (std::size_t i = 0u; i < odometry_queue_.Size(); ++i) {
+    const OdometryMeasurement& measurement = odometry_queue_.At(i);
+    writer->Write<int32_t>(odometry_queue_.ReleaseAt(i));
+    writer->Write(measurement.stamp_sec);
+    writer->Write(measurement.stamp_nsec);
+    WriteCheckpoint(measurement.pose, writer);
+    WriteCheckpoint(measurement.linear_velocity, writer);
+    WriteCheckpoint(measurement.angular_velocity, writer);
+    writer->Write(measurement.noise_scale);
+  }
+}
+
+bool GazeboOdometryPlugin::RestoreCheckpoint(CheckpointReader* reader) {
+  reader->ReadText(&random_generator_);
+  for (int i = 0; i < 3; ++i) {
+    reader->ReadText(&position_n_[i]);
+    reader->ReadText(&attitude_n_[i]);
+    reader->ReadText(&linear_velocity_n_[i]);
+    reader->ReadText(&angular_velocity_n_[i]);
+  }
+
+  int32_t gazebo_sequence = 0, odometry_sequence = 0;
+  uint64_t queue_size = 0;
+  reader->Read(&gazebo_sequence);
+  reader->Read(&odometry_sequence);
+  reader->Read(&queue_size);
+  gazebo_sequence_ = gazebo_sequence;
+  odometry_sequence_ = odometry_sequence;
+  odometry_queue_.Reset(odometry_queue_.Capacity());
+  for (uint64_t i = 0u; i < queue_size && reader->ok(); ++i) {
+    int32_t release = 0;
+    reader->Read(&release);
+    OdometryMeasurement* measurement = odometry_queue_.Push(release);
+    if (measurement == nullptr) {
+      gzerr << "[gazebo_odometry_plugin] The checkpoint holds more delayed "
+            << "measurements than measurementDelay allows.\n";
+      return false;
+    }
+    reader->Read(&measurement->stamp_sec);
+    reader->Read(&measurement->stamp_nsec);
+    ReadCheckpoint(reader, &measurement->pose);
+    ReadCheckpoint(reader, &measurement->linear_velocity);
+    ReadCheckpoint(reader, &measurement->angular_velocity);
+    reader->Read(&measurement->noise_scale);
+  }
+  return reader->ok();
+}
+
 GZ_REGISTER_MODEL_PLUGIN(GazeboOdometryPlugin);
 
 }  // namespace gazebo
@@ -25,7 +25,8 @@ namespace gazebo {
 GazeboPressurePlugin::GazeboPressurePlugin()
     : ModelPlugin(),
       node_handle_(0),
-      pubs_and_subs_created_(false) {
+      pubs_and_subs_created_(false),
+      measurement_divisor_(kDefaultPressureMeasurementDivisor) {
 }
 
 GazeboPressurePlugin::~GazeboPressurePlugin() {
@@ -67,6 +68,8 @@ void GazeboPressurePlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf)
   link_ = model_->GetLink(link_name);
   if (link_ == NULL)
     gzthrow("[gazebo_pressure_plugin] Couldn't find specified link \"" << link_name << "\".");
+  model_state_ = RigidBodyStateCache::Get(model_->GetLink());
+  fidelity_ = ModelFidelity::Get(model_, _sdf);
 
   frame_id_ = link_name;
 
@@ -75,14 +78,39 @@ void GazeboPressurePlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf)
   getSdfParam<double>(_sdf, "referenceAltitude", ref_alt_, kDefaultRefAlt);
   getSdfParam<double>(_sdf, "pressureVariance", pressure_var_, kDefaultPressureVar);
   CHECK(pressure_var_ >= 0.0);
+  getSdfParam<int>(_sdf, "measurementDivisor", measurement_divisor_,
+                   measurement_divisor_);
+  if (measurement_divisor_ < 1) {
+    gzerr << "[gazebo_pressure_plugin] measurementDivisor must be positive,"
+          << " publishing every physics step.\n";
+    measurement_divisor_ = 1;
+  }
+  publish_policy_.Load(_sdf, "gazebo_pressure_plugin");
+  measurement_offset_ = UpdateDispatcher::Stagger(
+      world_, _sdf, "gazebo_pressure_plugin", "measurement",
+      measurement_divisor_);
+
+  double table_min_height = kDefaultPressureTableMinHeight;
+  double table_max_height = kDefaultPressureTableMaxHeight;
+  double table_resolution = kDefaultPressureTableResolution;
+  getSdfParam<double>(_sdf, "pressureTableMinHeight", table_min_height,
+                      table_min_height);
+  getSdfParam<double>(_sdf, "pressureTableMaxHeight", table_max_height,
+                      table_max_height);
+  getSdfParam<double>(_sdf, "pressureTableResolution", table_resolution,
+                      table_resolution);
+  pressure_table_.Build(ref_alt_ + table_min_height,
+                        ref_alt_ + table_max_height, table_resolution);
 
   // Initialize the normal distribution for pressure.
   double mean = 0.0;
   pressure_n_[0] = NormalDistribution(mean, sqrt(pressure_var_));
 
-  // Listen to the update event. This event is broadcast every simulation
+  // Listen to the update event, either directly or through the update
+  // dispatcher of the world. This event is broadcast every simulation
   // iteration.
-  this->updateConnection_ = event::Events::ConnectWorldUpdateBegin(
+  this->updateConnection_ = UpdateDispatcher::Connect(
+      _model, _sdf, "gazebo_pressure_plugin", kUpdatePrioritySensor,
       boost::bind(&GazeboPressurePlugin::OnUpdate, this, _1));
 
   //==============================================//
@@ -94,37 +122,41 @@ void GazeboPressurePlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf)
 }
 
 void GazeboPressurePlugin::OnUpdate(const common::UpdateInfo& _info) {
-  if (kPrintOnUpdates) {
-    gzdbg << __FUNCTION__ << "() called." << std::endl;
-  }
+  ROTORS_PROFILE_SCOPE("gazebo_pressure_plugin");
 
   if (!pubs_and_subs_created_) {
     CreatePubsAndSubs();
     pubs_and_subs_created_ = true;
   }
 
+  // At low fidelity the rate divisor of the model replaces the
+  // measurement divisor. Both count the iterations of the world, which the
+  // offsets of all vehicles are staggered against.
+  const bool low_fidelity = fidelity_->low();
+  const bool skip = low_fidelity
+                        ? fidelity_->Skip(world_->Iterations())
+                        : !measurement_offset_->Due(world_->Iterations());
+  if (skip) {
+    return;
+  }
+
   common::Time current_time = world_->SimTime();
 
   // Get the current geometric height.
-  double height_geometric_m = ref_alt_ + model_->WorldPose().Pos().Z();
-
-  // Compute the geopotential height.
-  double height_geopotential_m = kEarthRadiusMeters * height_geometric_m /
-      (kEarthRadiusMeters + height_geometric_m);
-
-  // Compute the temperature at the current altitude.
-  double temperature_at_altitude_kelvin =
-      kSeaLevelTempKelvin - kTempLapseKelvinPerMeter * height_geopotential_m;
+  double height_geometric_m = ref_alt_ + model_state_->State().world_pose.Pos().Z();
 
   // Compute the current air pressure.
   double pressure_at_altitude_pascal =
-      kPressureOneAtmospherePascals * exp(kAirConstantDimensionless *
-          log(kSeaLevelTempKelvin / temperature_at_altitude_kelvin));
+      pressure_table_.Pressure(height_geometric_m);
 
   // Add noise to pressure measurement.
-  if(pressure_var_ > 0.0) {
+  if(pressure_var_ > 0.0 && !low_fidelity) {
     pressure_at_altitude_pascal += pressure_n_[0](random_generator_);
   }
+  if (!publish_policy_.ShouldPublish(current_time.Double(),
+                                     &pressure_at_altitude_pascal, 1)) {
+    return;
+  }
 
   // Fill the pressure message.
   pressure_message_.mutable_header()->mutable_stamp()->set_sec(
@@ -137,12 +169,40 @@ void GazeboPressurePlugin::OnUpdate(const common::UpdateInfo& _info) {
   pressure_pub_->Publish(pressure_message_);
 }
 
-void GazeboPressurePlugin::CreatePubsAndSubs() {
-  // Create temporary "ConnectGazeboToRosTopic" publisher and message.
-  gazebo::transport::PublisherPtr connect_gazebo_to_ros_topic_pub =
-      node_handle_->Advertise<gz_std_msgs::ConnectGazeboToRosTopic>(
-          "~/" + kConnectGazeboToRosSubtopic, 1);
+void IsaPressureTable::Build(double min_altitude, double max_altitude,
+                             double resolution) {
+  pressures_.clear();
+  last_sample_ = 0.0;
+  if (!(resolution > 0.0) || !(max_altitude > min_altitude)) {
+    return;
+  }
+  min_altitude_ = min_altitude;
+  inv_resolution_ = 1.0 / resolution;
+  const std::size_t num_samples =
+      static_cast<std::size_t>(std::ceil((max_altitude - min_altitude) *
+                                         inv_resolution_)) + 1;
+  pressures_.reserve(num_samples);
+  for (std::size_t i = 0; i < num_samples; ++i) {
+    pressures_.push_back(IsaPressure(min_altitude + i * resolution));
+  }
+  last_sample_ = static_cast<double>(num_samples - 1);
+}
 
+double IsaPressureTable::IsaPressure(double altitude) {
+  // Compute the geopotential height.
+  double height_geopotential_m = kEarthRadiusMeters * altitude /
+      (kEarthRadiusMeters + altitude);
+
+  // Compute the temperature at the current altitude.
+  double temperature_at_altitude_kelvin =
+      kSeaLevelTempKelvin - kTempLapseKelvinPerMeter * height_geopotential_m;
+
+  // Compute the current air pressure.
+  return kPressureOneAtmospherePascals * exp(kAirConstantDimensionless *
+      log(kSeaLevelTempKelvin / temperature_at_altitude_kelvin));
+}
+
+void GazeboPressurePlugin::CreatePubsAndSubs() {
   // ============================================ //
   // ========= FLUID PRESSURE MSG SETUP ========= //
   // ============================================ //
@@ -157,8 +217,8 @@ void GazeboPressurePlugin::CreatePubsAndSubs() {
                                                 pressure_topic_);
   connect_gazebo_to_ros_topic_msg.set_msgtype(
       gz_std_msgs::ConnectGazeboToRosTopic::FLUID_PRESSURE);
-  connect_gazebo_to_ros_topic_pub->Publish(connect_gazebo_to_ros_topic_msg,
-                                           true);
+  ros_bridge_connector_.Add(connect_gazebo_to_ros_topic_msg);
+  ros_bridge_connector_.Publish(node_handle_);
 }
 
 GZ_REGISTER_MODEL_PLUGIN(GazeboPressurePlugin);
@@ -19,20 +19,40 @@
 
 // SYSTEM
 #include <stdio.h>
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <iostream>
+#include <mutex>
 
 // 3RD PARTY
 #include <std_msgs/Header.h>
 #include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
 
 namespace gazebo {
 
 GazeboRosInterfacePlugin::GazeboRosInterfacePlugin()
-    : WorldPlugin(), gz_node_handle_(0), ros_node_handle_(0) {}
+    : WorldPlugin(),
+      shard_id_(kDefaultSwarmShardId),
+      shard_gateway_(false),
+      shard_timeout_(kDefaultSwarmShardTimeout),
+      gz_node_handle_(0),
+      ros_node_handle_(0),
+      conversion_stats_interval_(kDefaultConversionStatsInterval),
+      num_bridge_threads_(kDefaultNumBridgeThreads),
+      bridge_queue_size_(kDefaultBridgeQueueSize),
+      bridge_drop_oldest_(kDefaultBridgeDropOldest),
+      tf_max_rate_(kDefaultTfMaxRate),
+      tf_batch_(1) {}
 
 GazeboRosInterfacePlugin::~GazeboRosInterfacePlugin() {
+  bridge_workers_.Stop();
+  PrintConversionStats();
+  // Unsubscribe and stop polling before the connections are deleted.
+  updateEndConnection_.reset();
+  shm_connections_.clear();
+  connections_.clear();
 
   // Shutdown and delete ROS node handle
   if (ros_node_handle_) {
@@ -62,6 +82,27 @@ void GazeboRosInterfacePlugin::Load(physics::WorldPtr _world,
     gzerr << "Please specify a robotNamespace.\n";
   gzdbg << "namespace_ = \"" << namespace_ << "\"." << std::endl;*/
 
+  getSdfParam<double>(_sdf, "conversionStatsInterval",
+                      conversion_stats_interval_, conversion_stats_interval_);
+  getSdfParam<int>(_sdf, "numBridgeThreads", num_bridge_threads_,
+                   num_bridge_threads_);
+  getSdfParam<int>(_sdf, "bridgeQueueSize", bridge_queue_size_,
+                   bridge_queue_size_);
+  getSdfParam<bool>(_sdf, "bridgeDropOldest", bridge_drop_oldest_,
+                    bridge_drop_oldest_);
+  getSdfParam<double>(_sdf, "tfMaxRate", tf_max_rate_, tf_max_rate_);
+  getSdfParam<int>(_sdf, "shardId", shard_id_, shard_id_);
+  getSdfParam<bool>(_sdf, "shardGateway", shard_gateway_, shard_gateway_);
+  getSdfParam<double>(_sdf, "shardTimeout", shard_timeout_, shard_timeout_);
+  if (bridge_queue_size_ < 1) {
+    gzerr << "[gazebo_ros_interface_plugin] bridgeQueueSize must be at least "
+             "1, using 1.\n";
+    bridge_queue_size_ = 1;
+  }
+  if (num_bridge_threads_ > 0) {
+    bridge_workers_.Start(num_bridge_threads_);
+  }
+
   // Get Gazebo node handle
   gz_node_handle_ = transport::NodePtr(new transport::Node());
   // gz_node_handle_->Init(namespace_);
@@ -71,10 +112,24 @@ void GazeboRosInterfacePlugin::Load(physics::WorldPtr _world,
   // ros_node_handle_ = new ros::NodeHandle(namespace_);
   ros_node_handle_ = new ros::NodeHandle();
 
+  // All shards share the ROS master, the gateway forwards the requests to
+  // the others.
+  const std::string set_fidelity_service =
+      shard_id_ >= 0 && !shard_gateway_
+          ? "shard_" + std::to_string(shard_id_) + "/set_fidelity"
+          : "set_fidelity";
+  set_fidelity_service_ = ros_node_handle_->advertiseService(
+      set_fidelity_service, &GazeboRosInterfacePlugin::SetFidelityCallback,
+      this);
+
   // Listen to the update event. This event is broadcast every
   // simulation iteration.
   this->updateConnection_ = event::Events::ConnectWorldUpdateBegin(
       boost::bind(&GazeboRosInterfacePlugin::OnUpdate, this, _1));
+  // The shared memory rings are polled and the transforms broadcast once the
+  // plugins have written them.
+  this->updateEndConnection_ = event::Events::ConnectWorldUpdateEnd(
+      boost::bind(&GazeboRosInterfacePlugin::OnUpdateEnd, this));
 
   // ============================================ //
   // === CONNECT GAZEBO TO ROS MESSAGES SETUP === //
@@ -84,6 +139,12 @@ void GazeboRosInterfacePlugin::Load(physics::WorldPtr _world,
       "~/" + kConnectGazeboToRosSubtopic,
       &GazeboRosInterfacePlugin::GzConnectGazeboToRosTopicMsgCallback, this);
 
+  // Latching delivers the batches published before this subscription.
+  gz_connect_gazebo_to_ros_topics_sub_ = gz_node_handle_->Subscribe(
+      "~/" + kConnectGazeboToRosBatchSubtopic,
+      &GazeboRosInterfacePlugin::GzConnectGazeboToRosTopicsMsgCallback, this,
+      true);
+
   // ============================================ //
   // === CONNECT ROS TO GAZEBO MESSAGES SETUP === //
   // ============================================ //
@@ -101,9 +162,124 @@ void GazeboRosInterfacePlugin::Load(physics::WorldPtr _world,
       &GazeboRosInterfacePlugin::GzBroadcastTransformMsgCallback, this);
 }
 
+bool GazeboRosInterfacePlugin::SetFidelityCallback(
+    rotors_comm::SetFidelity::Request& request,
+    rotors_comm::SetFidelity::Response& response) {
+  FidelityLevel level;
+  if (!ParseFidelityLevel(request.level, &level)) {
+    response.success = false;
+    response.message = "Unknown level \"" + request.level +
+                       "\", expected \"full\" or \"low\".";
+    return true;
+  }
+  physics::ModelPtr model = world_->ModelByName(request.model_name);
+  if (!model && shard_id_ >= 0 && shard_gateway_) {
+    std::shared_ptr<SwarmShardLink> shard_link =
+        SwarmShardLink::ForWorld(world_->Name());
+    const int shard =
+        shard_link ? shard_link->ShardOf(request.model_name, shard_timeout_)
+                   : -1;
+    if (shard >= 0) {
+      rotors_comm::SetFidelity forwarded;
+      forwarded.request = request;
+      if (!ros::service::call(
+              "shard_" + std::to_string(shard) + "/set_fidelity", forwarded)) {
+        response.success = false;
+        response.message = "Shard " + std::to_string(shard) +
+                           " of model \"" + request.model_name +
+                           "\" did not answer.";
+        return true;
+      }
+      response = forwarded.response;
+      return true;
+    }
+  }
+  if (!model) {
+    response.success = false;
+    response.message = "No model \"" + request.model_name + "\".";
+    return true;
+  }
+  // Only models with a sensor plugin holding their fidelity can be switched.
+  std::shared_ptr<ModelFidelity> fidelity = ModelFidelity::Find(model);
+  if (!fidelity) {
+    response.success = false;
+    response.message = "No sensor plugin of model \"" + request.model_name +
+                       "\" supports fidelity levels.";
+    return true;
+  }
+  fidelity->Set(level, request.rate_divisor);
+  gzmsg << "[gazebo_ros_interface_plugin] Switched model \""
+        << request.model_name << "\" to " << request.level << " fidelity.\n";
+  response.success = true;
+  return true;
+}
+
 void GazeboRosInterfacePlugin::OnUpdate(const common::UpdateInfo& _info) {
-  // Do nothing
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin");
   // This plugins actions are all executed through message callbacks.
+  if (conversion_stats_interval_ > 0.0 &&
+      (_info.realTime - last_conversion_stats_time_).Double() >=
+          conversion_stats_interval_) {
+    PrintConversionStats();
+    last_conversion_stats_time_ = _info.realTime;
+  }
+}
+
+void GazeboRosInterfacePlugin::OnUpdateEnd() {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/OnUpdateEnd");
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    for (ShmBridgeConnection* connection : shm_connections_) {
+      connection->Poll();
+    }
+  }
+  BroadcastQueuedTransforms();
+}
+
+/// \brief      Preallocated ROS messages of a connection, reused once roscpp
+///             and all intra-process subscribers have released them.
+template <typename RosMsgT>
+struct RosMessagePool {
+  RosMessagePool() : next_message(0) {}
+
+  std::vector<boost::shared_ptr<RosMsgT> > messages;
+  std::size_t next_message;
+  std::mutex messages_mutex;
+
+  /// \brief    Returns a message that nobody else holds a reference to.
+  boost::shared_ptr<RosMsgT> AcquireMessage() {
+    std::lock_guard<std::mutex> lock(messages_mutex);
+    for (std::size_t i = 0; i < messages.size(); ++i) {
+      const std::size_t index = (next_message + i) % messages.size();
+      if (messages[index].unique()) {
+        next_message = (index + 1) % messages.size();
+        return messages[index];
+      }
+    }
+    // All messages are still in flight, grow the pool up to its limit.
+    boost::shared_ptr<RosMsgT> message = boost::make_shared<RosMsgT>();
+    if (messages.size() < kRosMessagePoolSize) {
+      messages.push_back(message);
+    }
+    return message;
+  }
+};
+
+/// \brief      Adds the time since start to the conversion statistics.
+static void AddConversionTime(
+    const std::chrono::steady_clock::time_point& start,
+    BridgeTopicStats* stats) {
+  const uint64_t conversion_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+  ++stats->num_messages;
+  stats->total_conversion_ns += conversion_ns;
+  uint64_t max_conversion_ns = stats->max_conversion_ns;
+  while (conversion_ns > max_conversion_ns &&
+         !stats->max_conversion_ns.compare_exchange_weak(max_conversion_ns,
+                                                          conversion_ns)) {
+  }
 }
 
 /// \brief      A helper class that provides storage for additional parameters
@@ -111,61 +287,302 @@ void GazeboRosInterfacePlugin::OnUpdate(const common::UpdateInfo& _info) {
 /// \details
 ///   GazeboMsgT  The type of the message that will be subscribed to the Gazebo
 ///   framework.
-template <typename GazeboMsgT>
-struct ConnectHelperStorage {
+///   RosMsgT     The type of the message published to the ROS framework.
+template <typename GazeboMsgT, typename RosMsgT>
+struct ConnectHelperStorage : public BridgeConnection {
+  ConnectHelperStorage(GazeboRosInterfacePlugin* ptr,
+                       void (GazeboRosInterfacePlugin::*fp)(
+                           const boost::shared_ptr<GazeboMsgT const>&,
+                           RosMsgT*),
+                       const std::string& gazebo_topic,
+                       const std::string& ros_topic,
+                       ros::Publisher ros_publisher, BridgeWorkerPool* workers,
+                       std::size_t queue_size, bool drop_oldest)
+      : BridgeConnection(gazebo_topic, ros_topic),
+        ptr(ptr),
+        fp(fp),
+        ros_publisher(ros_publisher),
+        workers(workers),
+        queue_size(queue_size),
+        drop_oldest(drop_oldest),
+        scheduled(false) {}
+
   /// \brief    Pointer to the ROS interface plugin class.
   GazeboRosInterfacePlugin* ptr;
 
-  /// \brief    Function pointer to the subscriber callback with additional
-  /// parameters.
+  /// \brief    Function pointer to the converter with additional parameters.
   void (GazeboRosInterfacePlugin::*fp)(
-      const boost::shared_ptr<GazeboMsgT const>&, ros::Publisher ros_publisher);
+      const boost::shared_ptr<GazeboMsgT const>&, RosMsgT*);
 
-  /// \brief    The ROS publisher that is passed into the modified callback.
+  /// \brief    The ROS publisher that the converted messages are published on.
   ros::Publisher ros_publisher;
 
+  RosMessagePool<RosMsgT> messages;
+
+  /// \brief    Bridge workers, nullptr to publish on the transport thread.
+  BridgeWorkerPool* workers;
+  /// \brief    Gazebo messages waiting for a bridge worker.
+  std::deque<boost::shared_ptr<GazeboMsgT const> > queue;
+  std::size_t queue_size;
+  bool drop_oldest;
+  /// \brief    True while the connection waits for or is handled by a worker.
+  bool scheduled;
+  std::mutex queue_mutex;
+
   /// \brief    This is what gets passed into the Gazebo Subscribe method as a
   ///           callback, and hence can only
   ///           have one parameter (note boost::bind() does not work with the
   ///           current Gazebo Subscribe() definitions).
   void callback(const boost::shared_ptr<GazeboMsgT const>& msg_ptr) {
-    (ptr->*fp)(msg_ptr, ros_publisher);
+    if (!workers) {
+      Publish(msg_ptr);
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex);
+      if (queue.size() >= queue_size) {
+        ++stats.num_dropped;
+        if (!drop_oldest) {
+          return;
+        }
+        queue.pop_front();
+      }
+      queue.push_back(msg_ptr);
+      stats.queue_depth = queue.size();
+      if (queue.size() > stats.max_queue_depth) {
+        stats.max_queue_depth = queue.size();
+      }
+      if (scheduled) {
+        return;
+      }
+      scheduled = true;
+    }
+    workers->Schedule(this);
+  }
+
+  bool ProcessQueued() override {
+    for (std::size_t i = 0; i < kBridgeBatchSize; ++i) {
+      boost::shared_ptr<GazeboMsgT const> msg_ptr;
+      {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (queue.empty()) {
+          scheduled = false;
+          return false;
+        }
+        msg_ptr = queue.front();
+        queue.pop_front();
+        stats.queue_depth = queue.size();
+      }
+      Publish(msg_ptr);
+    }
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    scheduled = !queue.empty();
+    return scheduled;
+  }
+
+  /// \brief    Converts a message and publishes it to ROS.
+  void Publish(const boost::shared_ptr<GazeboMsgT const>& msg_ptr) {
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+    boost::shared_ptr<RosMsgT> ros_msg = messages.AcquireMessage();
+    (ptr->*fp)(msg_ptr, ros_msg.get());
+    AddConversionTime(start, &stats);
+
+    // Publishing by shared pointer hands the message to intra-process
+    // subscribers without copying it, and only serializes it if there are
+    // subscribers in other processes.
+    ros_publisher.publish(ros_msg);
   }
 };
 
 template <typename GazeboMsgT, typename RosMsgT>
-void GazeboRosInterfacePlugin::ConnectHelper(
+BridgeConnectionHandle GazeboRosInterfacePlugin::ConnectHelper(
     void (GazeboRosInterfacePlugin::*fp)(
-        const boost::shared_ptr<GazeboMsgT const>&, ros::Publisher),
+        const boost::shared_ptr<GazeboMsgT const>&, RosMsgT*),
     GazeboRosInterfacePlugin* ptr, std::string gazeboNamespace,
     std::string gazeboTopicName, std::string rosTopicName,
     transport::NodePtr gz_node_handle) {
-  // One map will be created for each Gazebo message type
-  static std::map<std::string, ConnectHelperStorage<GazeboMsgT> > callback_map;
+  std::lock_guard<std::mutex> lock(connections_mutex_);
+
+  // Check if the topic is already connected
+  auto handle_entry =
+      connection_handles_.emplace(gazeboTopicName, connections_.size());
+  if (!handle_entry.second) {
+    const BridgeConnection& existing =
+        *connections_[handle_entry.first->second];
+    if (existing.ros_topic != rosTopicName) {
+      gzerr << "Gazebo topic \"" << gazeboTopicName
+            << "\" is already connected to ROS topic \"" << existing.ros_topic
+            << "\"." << std::endl;
+    }
+    return handle_entry.first->second;
+  }
 
   // Create ROS publisher
   ros::Publisher ros_publisher =
       ros_node_handle_->advertise<RosMsgT>(rosTopicName, 1);
 
-  auto callback_entry = callback_map.emplace(
-      gazeboTopicName,
-      ConnectHelperStorage<GazeboMsgT>{ptr, fp, ros_publisher});
-
-  // Check if element was already present
-  if (!callback_entry.second)
-    gzerr << "Tried to add element to map but the gazebo topic name was "
-             "already present in map."
-          << std::endl;
-
-  // Create subscriber
-  gazebo::transport::SubscriberPtr subscriberPtr;
-  subscriberPtr = gz_node_handle->Subscribe(
-      gazeboTopicName, &ConnectHelperStorage<GazeboMsgT>::callback,
-      &callback_entry.first->second);
-
-  // Save a reference to the subscriber pointer so subscriber
-  // won't be deleted.
-  subscriberPtrs_.push_back(subscriberPtr);
+  BridgeWorkerPool* workers =
+      num_bridge_threads_ > 0 ? &bridge_workers_ : nullptr;
+  ConnectHelperStorage<GazeboMsgT, RosMsgT>* connection =
+      new ConnectHelperStorage<GazeboMsgT, RosMsgT>(
+          ptr, fp, gazeboTopicName, rosTopicName, ros_publisher, workers,
+          bridge_queue_size_, bridge_drop_oldest_);
+  connections_.emplace_back(connection);
+
+  // Create subscriber, the connection keeps it so it won't be deleted.
+  connection->subscriber = gz_node_handle->Subscribe(
+      gazeboTopicName, &ConnectHelperStorage<GazeboMsgT, RosMsgT>::callback,
+      connection);
+
+  return handle_entry.first->second;
+}
+
+/// \brief      A connection that converts the records of a shared memory ring.
+/// \details
+///   RecordT     The type of the records in the ring.
+///   RosMsgT     The type of the message published to the ROS framework.
+template <typename RecordT, typename RosMsgT>
+struct ShmConnectHelperStorage : public ShmBridgeConnection {
+  ShmConnectHelperStorage(GazeboRosInterfacePlugin* ptr,
+                          void (GazeboRosInterfacePlugin::*fp)(
+                              const RecordT&, const ShmRingReader<RecordT>&,
+                              RosMsgT*),
+                          const std::string& gazebo_topic,
+                          const std::string& ros_topic)
+      : ShmBridgeConnection(gazebo_topic, ros_topic), ptr(ptr), fp(fp) {}
+
+  GazeboRosInterfacePlugin* ptr;
+  void (GazeboRosInterfacePlugin::*fp)(const RecordT&,
+                                       const ShmRingReader<RecordT>&,
+                                       RosMsgT*);
+  ros::Publisher ros_publisher;
+  ShmRingReader<RecordT> ring;
+  RosMessagePool<RosMsgT> messages;
+
+  void Poll() override {
+    RecordT record;
+    while (ring.Read(&record)) {
+      const std::chrono::steady_clock::time_point start =
+          std::chrono::steady_clock::now();
+
+      boost::shared_ptr<RosMsgT> ros_msg = messages.AcquireMessage();
+      (ptr->*fp)(record, ring, ros_msg.get());
+      AddConversionTime(start, &stats);
+
+      ros_publisher.publish(ros_msg);
+    }
+    // Records the producer overwrote before they were polled.
+    stats.num_dropped = ring.num_lost();
+  }
+};
+
+template <typename RecordT, typename RosMsgT>
+bool GazeboRosInterfacePlugin::ShmConnectHelper(
+    void (GazeboRosInterfacePlugin::*fp)(
+        const RecordT&, const ShmRingReader<RecordT>&, RosMsgT*),
+    const std::string& gazeboTopicName, const std::string& rosTopicName,
+    const std::string& shmName) {
+  std::lock_guard<std::mutex> lock(connections_mutex_);
+
+  auto handle_entry = connection_handles_.find(gazeboTopicName);
+  if (handle_entry != connection_handles_.end()) {
+    const BridgeConnection& existing = *connections_[handle_entry->second];
+    if (existing.ros_topic != rosTopicName) {
+      gzerr << "Gazebo topic \"" << gazeboTopicName
+            << "\" is already connected to ROS topic \"" << existing.ros_topic
+            << "\"." << std::endl;
+    }
+    return true;
+  }
+
+  std::unique_ptr<ShmConnectHelperStorage<RecordT, RosMsgT> > connection(
+      new ShmConnectHelperStorage<RecordT, RosMsgT>(this, fp, gazeboTopicName,
+                                                    rosTopicName));
+  if (!connection->ring.Open(shmName)) {
+    gzerr << "Can't open the shared memory ring \"" << shmName
+          << "\", subscribing to Gazebo topic \"" << gazeboTopicName
+          << "\" instead." << std::endl;
+    return false;
+  }
+  connection->ros_publisher =
+      ros_node_handle_->advertise<RosMsgT>(rosTopicName, 1);
+
+  connection_handles_.emplace(gazeboTopicName, connections_.size());
+  shm_connections_.push_back(connection.get());
+  connections_.emplace_back(std::move(connection));
+  return true;
+}
+
+void GazeboRosInterfacePlugin::PrintConversionStats() {
+  std::lock_guard<std::mutex> lock(connections_mutex_);
+  for (const std::unique_ptr<BridgeConnection>& connection : connections_) {
+    const BridgeTopicStats& stats = connection->stats;
+    const uint64_t num_messages = stats.num_messages;
+    if (num_messages == 0) {
+      continue;
+    }
+    gzmsg << "[gazebo_ros_interface_plugin] \"" << connection->ros_topic
+          << "\": " << num_messages << " messages, conversion mean "
+          << 1e-3 * stats.total_conversion_ns / num_messages
+          << " us, max " << 1e-3 * stats.max_conversion_ns << " us";
+    if (num_bridge_threads_ > 0) {
+      gzmsg << ", queue depth " << stats.queue_depth << " (max "
+            << stats.max_queue_depth << "), "
+            << stats.num_dropped << " dropped";
+    }
+    gzmsg << ".\n";
+  }
+}
+
+void BridgeWorkerPool::Start(int num_threads) {
+  Stop();
+  stopping_ = false;
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.emplace_back(&BridgeWorkerPool::WorkerThread, this);
+  }
+}
+
+void BridgeWorkerPool::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+  ready_.clear();
+}
+
+void BridgeWorkerPool::Schedule(BridgeConnection* connection) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ready_.push_back(connection);
+  }
+  condition_.notify_one();
+}
+
+void BridgeWorkerPool::WorkerThread() {
+  while (true) {
+    BridgeConnection* connection;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this] { return stopping_ || !ready_.empty(); });
+      if (stopping_) {
+        return;
+      }
+      connection = ready_.front();
+      ready_.pop_front();
+    }
+    // Requeue at the back, so that busy topics do not starve the others.
+    if (connection->ProcessQueued()) {
+      Schedule(connection);
+    }
+  }
 }
 
 void GazeboRosInterfacePlugin::GzConnectGazeboToRosTopicMsgCallback(
@@ -174,17 +591,42 @@ void GazeboRosInterfacePlugin::GzConnectGazeboToRosTopicMsgCallback(
     gzdbg << __FUNCTION__ << "() called." << std::endl;
   }
 
+  ConnectGazeboToRosTopic(*gz_connect_gazebo_to_ros_topic_msg);
+}
+
+void GazeboRosInterfacePlugin::GzConnectGazeboToRosTopicsMsgCallback(
+    GzConnectGazeboToRosTopicsMsgPtr& gz_connect_gazebo_to_ros_topics_msg) {
+  if (kPrintOnMsgCallback) {
+    gzdbg << __FUNCTION__ << "() called." << std::endl;
+  }
+
+  for (int i = 0; i < gz_connect_gazebo_to_ros_topics_msg->connections_size();
+       i++) {
+    ConnectGazeboToRosTopic(
+        gz_connect_gazebo_to_ros_topics_msg->connections(i));
+  }
+}
+
+void GazeboRosInterfacePlugin::ConnectGazeboToRosTopic(
+    const gz_std_msgs::ConnectGazeboToRosTopic&
+        gz_connect_gazebo_to_ros_topic_msg) {
   const std::string gazeboNamespace =
-      "";  // gz_connect_gazebo_to_ros_topic_msg->gazebo_namespace();
+      "";  // gz_connect_gazebo_to_ros_topic_msg.gazebo_namespace();
   const std::string gazeboTopicName =
-      gz_connect_gazebo_to_ros_topic_msg->gazebo_topic();
+      gz_connect_gazebo_to_ros_topic_msg.gazebo_topic();
   const std::string rosTopicName =
-      gz_connect_gazebo_to_ros_topic_msg->ros_topic();
+      gz_connect_gazebo_to_ros_topic_msg.ros_topic();
 
   gzdbg << "Connecting Gazebo topic \"" << gazeboTopicName
         << "\" to ROS topic \"" << rosTopicName << "\"." << std::endl;
 
-  switch (gz_connect_gazebo_to_ros_topic_msg->msgtype()) {
+  if (gz_connect_gazebo_to_ros_topic_msg.has_shm_name() &&
+      ConnectShmRingToRosTopic(gz_connect_gazebo_to_ros_topic_msg)) {
+    gzdbg << __FUNCTION__ << "() finished." << std::endl;
+    return;
+  }
+
+  switch (gz_connect_gazebo_to_ros_topic_msg.msgtype()) {
     case gz_std_msgs::ConnectGazeboToRosTopic::ACTUATORS:
       ConnectHelper<gz_sensor_msgs::Actuators, mav_msgs::Actuators>(
           &GazeboRosInterfacePlugin::GzActuatorsMsgCallback, this,
@@ -205,6 +647,11 @@ void GazeboRosInterfacePlugin::GzConnectGazeboToRosTopicMsgCallback(
           &GazeboRosInterfacePlugin::GzImuMsgCallback, this, gazeboNamespace,
           gazeboTopicName, rosTopicName, gz_node_handle_);
       break;
+    case gz_std_msgs::ConnectGazeboToRosTopic::IMU_DELTA:
+      ConnectHelper<gz_sensor_msgs::ImuDelta, rotors_comm::ImuDelta>(
+          &GazeboRosInterfacePlugin::GzImuDeltaMsgCallback, this,
+          gazeboNamespace, gazeboTopicName, rosTopicName, gz_node_handle_);
+      break;
     case gz_std_msgs::ConnectGazeboToRosTopic::JOINT_STATE:
       ConnectHelper<gz_sensor_msgs::JointState, sensor_msgs::JointState>(
           &GazeboRosInterfacePlugin::GzJointStateMsgCallback, this,
@@ -237,6 +684,11 @@ void GazeboRosInterfacePlugin::GzConnectGazeboToRosTopicMsgCallback(
           &GazeboRosInterfacePlugin::GzOdometryMsgCallback, this,
           gazeboNamespace, gazeboTopicName, rosTopicName, gz_node_handle_);
       break;
+    case gz_std_msgs::ConnectGazeboToRosTopic::SWARM_TELEMETRY:
+      ConnectHelper<gz_mav_msgs::SwarmTelemetry, rotors_comm::SwarmTelemetry>(
+          &GazeboRosInterfacePlugin::GzSwarmTelemetryMsgCallback, this,
+          gazeboNamespace, gazeboTopicName, rosTopicName, gz_node_handle_);
+      break;
     case gz_std_msgs::ConnectGazeboToRosTopic::TRANSFORM_STAMPED:
       ConnectHelper<gz_geometry_msgs::TransformStamped,
                     geometry_msgs::TransformStamped>(
@@ -269,21 +721,48 @@ void GazeboRosInterfacePlugin::GzConnectGazeboToRosTopicMsgCallback(
       break;
     default:
       gzthrow("ConnectGazeboToRosTopic message type with enum val = "
-              << gz_connect_gazebo_to_ros_topic_msg->msgtype()
+              << gz_connect_gazebo_to_ros_topic_msg.msgtype()
               << " is not supported by GazeboRosInterfacePlugin.");
   }
 
   gzdbg << __FUNCTION__ << "() finished." << std::endl;
 }
 
+bool GazeboRosInterfacePlugin::ConnectShmRingToRosTopic(
+    const gz_std_msgs::ConnectGazeboToRosTopic&
+        gz_connect_gazebo_to_ros_topic_msg) {
+  const std::string& gazeboTopicName =
+      gz_connect_gazebo_to_ros_topic_msg.gazebo_topic();
+  const std::string& rosTopicName =
+      gz_connect_gazebo_to_ros_topic_msg.ros_topic();
+  const std::string& shmName = gz_connect_gazebo_to_ros_topic_msg.shm_name();
+
+  switch (gz_connect_gazebo_to_ros_topic_msg.msgtype()) {
+    case gz_std_msgs::ConnectGazeboToRosTopic::ACTUATORS:
+      return ShmConnectHelper<ShmRotorVelocitiesRecord, mav_msgs::Actuators>(
+          &GazeboRosInterfacePlugin::ShmRotorVelocitiesRecordToRos,
+          gazeboTopicName, rosTopicName, shmName);
+    case gz_std_msgs::ConnectGazeboToRosTopic::IMU:
+      return ShmConnectHelper<ShmImuRecord, sensor_msgs::Imu>(
+          &GazeboRosInterfacePlugin::ShmImuRecordToRos, gazeboTopicName,
+          rosTopicName, shmName);
+    case gz_std_msgs::ConnectGazeboToRosTopic::ODOMETRY:
+      return ShmConnectHelper<ShmOdometryRecord, nav_msgs::Odometry>(
+          &GazeboRosInterfacePlugin::ShmOdometryRecordToRos, gazeboTopicName,
+          rosTopicName, shmName);
+    default:
+      gzerr << "Shared memory rings are not supported for Gazebo topic \""
+            << gazeboTopicName << "\"." << std::endl;
+      return false;
+  }
+}
+
 void GazeboRosInterfacePlugin::GzConnectRosToGazeboTopicMsgCallback(
     GzConnectRosToGazeboTopicMsgPtr& gz_connect_ros_to_gazebo_topic_msg) {
   if (kPrintOnMsgCallback) {
     gzdbg << __FUNCTION__ << "() called." << std::endl;
   }
 
-  static std::vector<ros::Subscriber> ros_subscribers;
-
   switch (gz_connect_ros_to_gazebo_topic_msg->msgtype()) {
     case gz_std_msgs::ConnectRosToGazeboTopic::ACTUATORS: {
       gazebo::transport::PublisherPtr gz_publisher_ptr =
@@ -299,7 +778,7 @@ void GazeboRosInterfacePlugin::GzConnectRosToGazeboTopicMsgCallback(
 
       // Save reference to the ROS subscriber so callback will continue to be
       // called.
-      ros_subscribers.push_back(ros_subscriber);
+      ros_subscribers_.push_back(ros_subscriber);
 
       break;
     }
@@ -318,7 +797,7 @@ void GazeboRosInterfacePlugin::GzConnectRosToGazeboTopicMsgCallback(
 
       // Save reference to the ROS subscriber so callback will continue to be
       // called.
-      ros_subscribers.push_back(ros_subscriber);
+      ros_subscribers_.push_back(ros_subscriber);
 
       break;
     }
@@ -338,7 +817,7 @@ void GazeboRosInterfacePlugin::GzConnectRosToGazeboTopicMsgCallback(
 
       // Save reference to the ROS subscriber so callback will continue to be
       // called.
-      ros_subscribers.push_back(ros_subscriber);
+      ros_subscribers_.push_back(ros_subscriber);
 
       break;
     }
@@ -356,7 +835,7 @@ void GazeboRosInterfacePlugin::GzConnectRosToGazeboTopicMsgCallback(
 
       // Save reference to the ROS subscriber so callback will continue to be
       // called.
-      ros_subscribers.push_back(ros_subscriber);
+      ros_subscribers_.push_back(ros_subscriber);
 
       break;
     }
@@ -393,61 +872,57 @@ void GazeboRosInterfacePlugin::ConvertHeaderRosToGz(
 //===========================================================================//
 
 void GazeboRosInterfacePlugin::GzActuatorsMsgCallback(
-    GzActuatorsMsgPtr& gz_actuators_msg, ros::Publisher ros_publisher) {
+    GzActuatorsMsgPtr& gz_actuators_msg,
+    mav_msgs::Actuators* ros_actuators_msg) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/GzActuatorsMsgCallback");
   // We need to convert the Acutuators message from a Gazebo message to a
   // ROS message and then publish it to the ROS framework
 
-  ConvertHeaderGzToRos(gz_actuators_msg->header(), &ros_actuators_msg_.header);
+  ConvertHeaderGzToRos(gz_actuators_msg->header(), &ros_actuators_msg->header);
 
-  ros_actuators_msg_.angular_velocities.resize(
+  ros_actuators_msg->angular_velocities.resize(
       gz_actuators_msg->angular_velocities_size());
   for (int i = 0; i < gz_actuators_msg->angular_velocities_size(); i++) {
-    ros_actuators_msg_.angular_velocities[i] =
+    ros_actuators_msg->angular_velocities[i] =
         gz_actuators_msg->angular_velocities(i);
   }
-
-  // Publish to ROS.
-  ros_publisher.publish(ros_actuators_msg_);
 }
 
 void GazeboRosInterfacePlugin::GzFloat32MsgCallback(
-    GzFloat32MsgPtr& gz_float_32_msg, ros::Publisher ros_publisher) {
+    GzFloat32MsgPtr& gz_float_32_msg, std_msgs::Float32* ros_float_32_msg) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/GzFloat32MsgCallback");
   // Convert Gazebo message to ROS message
-  ros_float_32_msg_.data = gz_float_32_msg->data();
-
-  // Publish to ROS
-  ros_publisher.publish(ros_float_32_msg_);
+  ros_float_32_msg->data = gz_float_32_msg->data();
 }
 
 void GazeboRosInterfacePlugin::GzFluidPressureMsgCallback(
     GzFluidPressureMsgPtr &gz_fluid_pressure_msg,
-    ros::Publisher ros_publisher) {
+    sensor_msgs::FluidPressure* ros_fluid_pressure_msg) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/GzFluidPressureMsgCallback");
   // We need to convert from a Gazebo message to a ROS message,
   // and then forward the FluidPressure message onto ROS.
 
   ConvertHeaderGzToRos(gz_fluid_pressure_msg->header(),
-                       &ros_fluid_pressure_msg_.header);
+                       &ros_fluid_pressure_msg->header);
 
-  ros_fluid_pressure_msg_.fluid_pressure =
+  ros_fluid_pressure_msg->fluid_pressure =
       gz_fluid_pressure_msg->fluid_pressure();
 
-  ros_fluid_pressure_msg_.variance = gz_fluid_pressure_msg->variance();
-
-  // Publish to ROS.
-  ros_publisher.publish(ros_fluid_pressure_msg_);
+  ros_fluid_pressure_msg->variance = gz_fluid_pressure_msg->variance();
 }
 
 void GazeboRosInterfacePlugin::GzImuMsgCallback(GzImuPtr& gz_imu_msg,
-                                                ros::Publisher ros_publisher) {
+                                                sensor_msgs::Imu* ros_imu_msg) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/GzImuMsgCallback");
   // We need to convert from a Gazebo message to a ROS message,
   // and then forward the IMU message onto ROS
 
-  ConvertHeaderGzToRos(gz_imu_msg->header(), &ros_imu_msg_.header);
+  ConvertHeaderGzToRos(gz_imu_msg->header(), &ros_imu_msg->header);
 
-  ros_imu_msg_.orientation.x = gz_imu_msg->orientation().x();
-  ros_imu_msg_.orientation.y = gz_imu_msg->orientation().y();
-  ros_imu_msg_.orientation.z = gz_imu_msg->orientation().z();
-  ros_imu_msg_.orientation.w = gz_imu_msg->orientation().w();
+  ros_imu_msg->orientation.x = gz_imu_msg->orientation().x();
+  ros_imu_msg->orientation.y = gz_imu_msg->orientation().y();
+  ros_imu_msg->orientation.z = gz_imu_msg->orientation().z();
+  ros_imu_msg->orientation.w = gz_imu_msg->orientation().w();
 
   // Orientation covariance should have 9 elements, and both the Gazebo and ROS
   // arrays should be the same size!
@@ -455,80 +930,95 @@ void GazeboRosInterfacePlugin::GzImuMsgCallback(GzImuPtr& gz_imu_msg,
             "The Gazebo IMU message does not have 9 orientation covariance "
             "elements.");
   GZ_ASSERT(
-      ros_imu_msg_.orientation_covariance.size() == 9,
+      ros_imu_msg->orientation_covariance.size() == 9,
       "The ROS IMU message does not have 9 orientation covariance elements.");
   for (int i = 0; i < gz_imu_msg->orientation_covariance_size(); i++) {
-    ros_imu_msg_.orientation_covariance[i] =
+    ros_imu_msg->orientation_covariance[i] =
         gz_imu_msg->orientation_covariance(i);
   }
 
-  ros_imu_msg_.angular_velocity.x = gz_imu_msg->angular_velocity().x();
-  ros_imu_msg_.angular_velocity.y = gz_imu_msg->angular_velocity().y();
-  ros_imu_msg_.angular_velocity.z = gz_imu_msg->angular_velocity().z();
+  ros_imu_msg->angular_velocity.x = gz_imu_msg->angular_velocity().x();
+  ros_imu_msg->angular_velocity.y = gz_imu_msg->angular_velocity().y();
+  ros_imu_msg->angular_velocity.z = gz_imu_msg->angular_velocity().z();
 
   GZ_ASSERT(gz_imu_msg->angular_velocity_covariance_size() == 9,
             "The Gazebo IMU message does not have 9 angular velocity "
             "covariance elements.");
-  GZ_ASSERT(ros_imu_msg_.angular_velocity_covariance.size() == 9,
+  GZ_ASSERT(ros_imu_msg->angular_velocity_covariance.size() == 9,
             "The ROS IMU message does not have 9 angular velocity covariance "
             "elements.");
   for (int i = 0; i < gz_imu_msg->angular_velocity_covariance_size(); i++) {
-    ros_imu_msg_.angular_velocity_covariance[i] =
+    ros_imu_msg->angular_velocity_covariance[i] =
         gz_imu_msg->angular_velocity_covariance(i);
   }
 
-  ros_imu_msg_.linear_acceleration.x = gz_imu_msg->linear_acceleration().x();
-  ros_imu_msg_.linear_acceleration.y = gz_imu_msg->linear_acceleration().y();
-  ros_imu_msg_.linear_acceleration.z = gz_imu_msg->linear_acceleration().z();
+  ros_imu_msg->linear_acceleration.x = gz_imu_msg->linear_acceleration().x();
+  ros_imu_msg->linear_acceleration.y = gz_imu_msg->linear_acceleration().y();
+  ros_imu_msg->linear_acceleration.z = gz_imu_msg->linear_acceleration().z();
 
   GZ_ASSERT(gz_imu_msg->linear_acceleration_covariance_size() == 9,
             "The Gazebo IMU message does not have 9 linear acceleration "
             "covariance elements.");
-  GZ_ASSERT(ros_imu_msg_.linear_acceleration_covariance.size() == 9,
+  GZ_ASSERT(ros_imu_msg->linear_acceleration_covariance.size() == 9,
             "The ROS IMU message does not have 9 linear acceleration "
             "covariance elements.");
   for (int i = 0; i < gz_imu_msg->linear_acceleration_covariance_size(); i++) {
-    ros_imu_msg_.linear_acceleration_covariance[i] =
+    ros_imu_msg->linear_acceleration_covariance[i] =
         gz_imu_msg->linear_acceleration_covariance(i);
   }
+}
+
+void GazeboRosInterfacePlugin::GzImuDeltaMsgCallback(
+    GzImuDeltaPtr& gz_imu_delta_msg, rotors_comm::ImuDelta* ros_imu_delta_msg) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/GzImuDeltaMsgCallback");
+  ConvertHeaderGzToRos(gz_imu_delta_msg->header(), &ros_imu_delta_msg->header);
+
+  ros_imu_delta_msg->dt = gz_imu_delta_msg->dt();
+
+  ros_imu_delta_msg->delta_angle.x = gz_imu_delta_msg->delta_angle().x();
+  ros_imu_delta_msg->delta_angle.y = gz_imu_delta_msg->delta_angle().y();
+  ros_imu_delta_msg->delta_angle.z = gz_imu_delta_msg->delta_angle().z();
 
-  // Publish to ROS.
-  ros_publisher.publish(ros_imu_msg_);
+  ros_imu_delta_msg->delta_velocity.x = gz_imu_delta_msg->delta_velocity().x();
+  ros_imu_delta_msg->delta_velocity.y = gz_imu_delta_msg->delta_velocity().y();
+  ros_imu_delta_msg->delta_velocity.z = gz_imu_delta_msg->delta_velocity().z();
+
+  ros_imu_delta_msg->num_samples = gz_imu_delta_msg->num_samples();
 }
 
 void GazeboRosInterfacePlugin::GzJointStateMsgCallback(
-    GzJointStateMsgPtr& gz_joint_state_msg, ros::Publisher ros_publisher) {
+    GzJointStateMsgPtr& gz_joint_state_msg,
+    sensor_msgs::JointState* ros_joint_state_msg) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/GzJointStateMsgCallback");
   ConvertHeaderGzToRos(gz_joint_state_msg->header(),
-                       &ros_joint_state_msg_.header);
+                       &ros_joint_state_msg->header);
 
-  ros_joint_state_msg_.name.resize(gz_joint_state_msg->name_size());
+  ros_joint_state_msg->name.resize(gz_joint_state_msg->name_size());
   for (int i = 0; i < gz_joint_state_msg->name_size(); i++) {
-    ros_joint_state_msg_.name[i] = gz_joint_state_msg->name(i);
+    ros_joint_state_msg->name[i] = gz_joint_state_msg->name(i);
   }
 
-  ros_joint_state_msg_.position.resize(gz_joint_state_msg->position_size());
+  ros_joint_state_msg->position.resize(gz_joint_state_msg->position_size());
   for (int i = 0; i < gz_joint_state_msg->position_size(); i++) {
-    ros_joint_state_msg_.position[i] = gz_joint_state_msg->position(i);
+    ros_joint_state_msg->position[i] = gz_joint_state_msg->position(i);
   }
-
-  // Publish to ROS.
-  ros_publisher.publish(ros_joint_state_msg_);
 }
 
 void GazeboRosInterfacePlugin::GzMagneticFieldMsgCallback(
     GzMagneticFieldMsgPtr& gz_magnetic_field_msg,
-    ros::Publisher ros_publisher) {
+    sensor_msgs::MagneticField* ros_magnetic_field_msg) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/GzMagneticFieldMsgCallback");
   // We need to convert from a Gazebo message to a ROS message,
   // and then forward the MagneticField message onto ROS
 
   ConvertHeaderGzToRos(gz_magnetic_field_msg->header(),
-                       &ros_magnetic_field_msg_.header);
+                       &ros_magnetic_field_msg->header);
 
-  ros_magnetic_field_msg_.magnetic_field.x =
+  ros_magnetic_field_msg->magnetic_field.x =
       gz_magnetic_field_msg->magnetic_field().x();
-  ros_magnetic_field_msg_.magnetic_field.y =
+  ros_magnetic_field_msg->magnetic_field.y =
       gz_magnetic_field_msg->magnetic_field().y();
-  ros_magnetic_field_msg_.magnetic_field.z =
+  ros_magnetic_field_msg->magnetic_field.z =
       gz_magnetic_field_msg->magnetic_field().z();
 
   // Position covariance should have 9 elements, and both the Gazebo and ROS
@@ -536,42 +1026,41 @@ void GazeboRosInterfacePlugin::GzMagneticFieldMsgCallback(
   GZ_ASSERT(gz_magnetic_field_msg->magnetic_field_covariance_size() == 9,
             "The Gazebo MagneticField message does not have 9 magnetic field "
             "covariance elements.");
-  GZ_ASSERT(ros_magnetic_field_msg_.magnetic_field_covariance.size() == 9,
+  GZ_ASSERT(ros_magnetic_field_msg->magnetic_field_covariance.size() == 9,
             "The ROS MagneticField message does not have 9 magnetic field "
             "covariance elements.");
   for (int i = 0; i < gz_magnetic_field_msg->magnetic_field_covariance_size();
        i++) {
-    ros_magnetic_field_msg_.magnetic_field_covariance[i] =
+    ros_magnetic_field_msg->magnetic_field_covariance[i] =
         gz_magnetic_field_msg->magnetic_field_covariance(i);
   }
-
-  // Publish to ROS.
-  ros_publisher.publish(ros_magnetic_field_msg_);
 }
 
 void GazeboRosInterfacePlugin::GzNavSatFixCallback(
-    GzNavSatFixPtr& gz_nav_sat_fix_msg, ros::Publisher ros_publisher) {
+    GzNavSatFixPtr& gz_nav_sat_fix_msg,
+    sensor_msgs::NavSatFix* ros_nav_sat_fix_msg) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/GzNavSatFixCallback");
   // We need to convert from a Gazebo message to a ROS message, and then forward
   // the NavSatFix message to ROS.
 
   ConvertHeaderGzToRos(gz_nav_sat_fix_msg->header(),
-                       &ros_nav_sat_fix_msg_.header);
+                       &ros_nav_sat_fix_msg->header);
 
   switch (gz_nav_sat_fix_msg->service()) {
     case gz_sensor_msgs::NavSatFix::SERVICE_GPS:
-      ros_nav_sat_fix_msg_.status.service =
+      ros_nav_sat_fix_msg->status.service =
           sensor_msgs::NavSatStatus::SERVICE_GPS;
       break;
     case gz_sensor_msgs::NavSatFix::SERVICE_GLONASS:
-      ros_nav_sat_fix_msg_.status.service =
+      ros_nav_sat_fix_msg->status.service =
           sensor_msgs::NavSatStatus::SERVICE_GLONASS;
       break;
     case gz_sensor_msgs::NavSatFix::SERVICE_COMPASS:
-      ros_nav_sat_fix_msg_.status.service =
+      ros_nav_sat_fix_msg->status.service =
           sensor_msgs::NavSatStatus::SERVICE_COMPASS;
       break;
     case gz_sensor_msgs::NavSatFix::SERVICE_GALILEO:
-      ros_nav_sat_fix_msg_.status.service =
+      ros_nav_sat_fix_msg->status.service =
           sensor_msgs::NavSatStatus::SERVICE_GALILEO;
       break;
     default:
@@ -582,19 +1071,19 @@ void GazeboRosInterfacePlugin::GzNavSatFixCallback(
 
   switch (gz_nav_sat_fix_msg->status()) {
     case gz_sensor_msgs::NavSatFix::STATUS_NO_FIX:
-      ros_nav_sat_fix_msg_.status.status =
+      ros_nav_sat_fix_msg->status.status =
           sensor_msgs::NavSatStatus::STATUS_NO_FIX;
       break;
     case gz_sensor_msgs::NavSatFix::STATUS_FIX:
-      ros_nav_sat_fix_msg_.status.status =
+      ros_nav_sat_fix_msg->status.status =
           sensor_msgs::NavSatStatus::STATUS_FIX;
       break;
     case gz_sensor_msgs::NavSatFix::STATUS_SBAS_FIX:
-      ros_nav_sat_fix_msg_.status.status =
+      ros_nav_sat_fix_msg->status.status =
           sensor_msgs::NavSatStatus::STATUS_SBAS_FIX;
       break;
     case gz_sensor_msgs::NavSatFix::STATUS_GBAS_FIX:
-      ros_nav_sat_fix_msg_.status.status =
+      ros_nav_sat_fix_msg->status.status =
           sensor_msgs::NavSatStatus::STATUS_GBAS_FIX;
       break;
     default:
@@ -603,25 +1092,25 @@ void GazeboRosInterfacePlugin::GzNavSatFixCallback(
           "not yet supported.");
   }
 
-  ros_nav_sat_fix_msg_.latitude = gz_nav_sat_fix_msg->latitude();
-  ros_nav_sat_fix_msg_.longitude = gz_nav_sat_fix_msg->longitude();
-  ros_nav_sat_fix_msg_.altitude = gz_nav_sat_fix_msg->altitude();
+  ros_nav_sat_fix_msg->latitude = gz_nav_sat_fix_msg->latitude();
+  ros_nav_sat_fix_msg->longitude = gz_nav_sat_fix_msg->longitude();
+  ros_nav_sat_fix_msg->altitude = gz_nav_sat_fix_msg->altitude();
 
   switch (gz_nav_sat_fix_msg->position_covariance_type()) {
     case gz_sensor_msgs::NavSatFix::COVARIANCE_TYPE_UNKNOWN:
-      ros_nav_sat_fix_msg_.position_covariance_type =
+      ros_nav_sat_fix_msg->position_covariance_type =
           sensor_msgs::NavSatFix::COVARIANCE_TYPE_UNKNOWN;
       break;
     case gz_sensor_msgs::NavSatFix::COVARIANCE_TYPE_APPROXIMATED:
-      ros_nav_sat_fix_msg_.position_covariance_type =
+      ros_nav_sat_fix_msg->position_covariance_type =
           sensor_msgs::NavSatFix::COVARIANCE_TYPE_APPROXIMATED;
       break;
     case gz_sensor_msgs::NavSatFix::COVARIANCE_TYPE_DIAGONAL_KNOWN:
-      ros_nav_sat_fix_msg_.position_covariance_type =
+      ros_nav_sat_fix_msg->position_covariance_type =
           sensor_msgs::NavSatFix::COVARIANCE_TYPE_DIAGONAL_KNOWN;
       break;
     case gz_sensor_msgs::NavSatFix::COVARIANCE_TYPE_KNOWN:
-      ros_nav_sat_fix_msg_.position_covariance_type =
+      ros_nav_sat_fix_msg->position_covariance_type =
           sensor_msgs::NavSatFix::COVARIANCE_TYPE_KNOWN;
       break;
     default:
@@ -636,138 +1125,134 @@ void GazeboRosInterfacePlugin::GzNavSatFixCallback(
   GZ_ASSERT(gz_nav_sat_fix_msg->position_covariance_size() == 9,
             "The Gazebo NavSatFix message does not have 9 position covariance "
             "elements.");
-  GZ_ASSERT(ros_nav_sat_fix_msg_.position_covariance.size() == 9,
+  GZ_ASSERT(ros_nav_sat_fix_msg->position_covariance.size() == 9,
             "The ROS NavSatFix message does not have 9 position covariance "
             "elements.");
   for (int i = 0; i < gz_nav_sat_fix_msg->position_covariance_size(); i++) {
-    ros_nav_sat_fix_msg_.position_covariance[i] =
+    ros_nav_sat_fix_msg->position_covariance[i] =
         gz_nav_sat_fix_msg->position_covariance(i);
   }
-
-  // Publish to ROS.
-  ros_publisher.publish(ros_nav_sat_fix_msg_);
 }
 
 void GazeboRosInterfacePlugin::GzOdometryMsgCallback(
-    GzOdometryMsgPtr& gz_odometry_msg, ros::Publisher ros_publisher) {
+    GzOdometryMsgPtr& gz_odometry_msg, nav_msgs::Odometry* ros_odometry_msg) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/GzOdometryMsgCallback");
   // We need to convert from a Gazebo message to a ROS message, and then forward
   // the Odometry message to ROS.
 
   // ============================================ //
   // =================== HEADER ================= //
   // ============================================ //
-  ConvertHeaderGzToRos(gz_odometry_msg->header(), &ros_odometry_msg_.header);
+  ConvertHeaderGzToRos(gz_odometry_msg->header(), &ros_odometry_msg->header);
 
-  ros_odometry_msg_.child_frame_id = gz_odometry_msg->child_frame_id();
+  ros_odometry_msg->child_frame_id = gz_odometry_msg->child_frame_id();
 
   // ============================================ //
   // ===================== POSE ================= //
   // ============================================ //
-  ros_odometry_msg_.pose.pose.position.x =
+  ros_odometry_msg->pose.pose.position.x =
       gz_odometry_msg->pose().pose().position().x();
-  ros_odometry_msg_.pose.pose.position.y =
+  ros_odometry_msg->pose.pose.position.y =
       gz_odometry_msg->pose().pose().position().y();
-  ros_odometry_msg_.pose.pose.position.z =
+  ros_odometry_msg->pose.pose.position.z =
       gz_odometry_msg->pose().pose().position().z();
 
-  ros_odometry_msg_.pose.pose.orientation.w =
+  ros_odometry_msg->pose.pose.orientation.w =
       gz_odometry_msg->pose().pose().orientation().w();
-  ros_odometry_msg_.pose.pose.orientation.x =
+  ros_odometry_msg->pose.pose.orientation.x =
       gz_odometry_msg->pose().pose().orientation().x();
-  ros_odometry_msg_.pose.pose.orientation.y =
+  ros_odometry_msg->pose.pose.orientation.y =
       gz_odometry_msg->pose().pose().orientation().y();
-  ros_odometry_msg_.pose.pose.orientation.z =
+  ros_odometry_msg->pose.pose.orientation.z =
       gz_odometry_msg->pose().pose().orientation().z();
 
   for (int i = 0; i < gz_odometry_msg->pose().covariance_size(); i++) {
-    ros_odometry_msg_.pose.covariance[i] =
+    ros_odometry_msg->pose.covariance[i] =
         gz_odometry_msg->pose().covariance(i);
   }
 
   // ============================================ //
   // ===================== TWIST ================ //
   // ============================================ //
-  ros_odometry_msg_.twist.twist.linear.x =
+  ros_odometry_msg->twist.twist.linear.x =
       gz_odometry_msg->twist().twist().linear().x();
-  ros_odometry_msg_.twist.twist.linear.y =
+  ros_odometry_msg->twist.twist.linear.y =
       gz_odometry_msg->twist().twist().linear().y();
-  ros_odometry_msg_.twist.twist.linear.z =
+  ros_odometry_msg->twist.twist.linear.z =
       gz_odometry_msg->twist().twist().linear().z();
 
-  ros_odometry_msg_.twist.twist.angular.x =
+  ros_odometry_msg->twist.twist.angular.x =
       gz_odometry_msg->twist().twist().angular().x();
-  ros_odometry_msg_.twist.twist.angular.y =
+  ros_odometry_msg->twist.twist.angular.y =
       gz_odometry_msg->twist().twist().angular().y();
-  ros_odometry_msg_.twist.twist.angular.z =
+  ros_odometry_msg->twist.twist.angular.z =
       gz_odometry_msg->twist().twist().angular().z();
 
   for (int i = 0; i < gz_odometry_msg->twist().covariance_size(); i++) {
-    ros_odometry_msg_.twist.covariance[i] =
+    ros_odometry_msg->twist.covariance[i] =
         gz_odometry_msg->twist().covariance(i);
   }
-
-  // Publish to ROS framework.
-  ros_publisher.publish(ros_odometry_msg_);
 }
 
-void GazeboRosInterfacePlugin::GzPoseMsgCallback(GzPoseMsgPtr& gz_pose_msg,
-                                                 ros::Publisher ros_publisher) {
-  ros_pose_msg_.position.x = gz_pose_msg->position().x();
-  ros_pose_msg_.position.y = gz_pose_msg->position().y();
-  ros_pose_msg_.position.z = gz_pose_msg->position().z();
-
-  ros_pose_msg_.orientation.w = gz_pose_msg->orientation().w();
-  ros_pose_msg_.orientation.x = gz_pose_msg->orientation().x();
-  ros_pose_msg_.orientation.y = gz_pose_msg->orientation().y();
-  ros_pose_msg_.orientation.z = gz_pose_msg->orientation().z();
-
-  ros_publisher.publish(ros_pose_msg_);
+void GazeboRosInterfacePlugin::GzPoseMsgCallback(
+    GzPoseMsgPtr& gz_pose_msg, geometry_msgs::Pose* ros_pose_msg) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/GzPoseMsgCallback");
+  ros_pose_msg->position.x = gz_pose_msg->position().x();
+  ros_pose_msg->position.y = gz_pose_msg->position().y();
+  ros_pose_msg->position.z = gz_pose_msg->position().z();
+
+  ros_pose_msg->orientation.w = gz_pose_msg->orientation().w();
+  ros_pose_msg->orientation.x = gz_pose_msg->orientation().x();
+  ros_pose_msg->orientation.y = gz_pose_msg->orientation().y();
+  ros_pose_msg->orientation.z = gz_pose_msg->orientation().z();
 }
 
 void GazeboRosInterfacePlugin::GzPoseWithCovarianceStampedMsgCallback(
     GzPoseWithCovarianceStampedMsgPtr& gz_pose_with_covariance_stamped_msg,
-    ros::Publisher ros_publisher) {
+    geometry_msgs::PoseWithCovarianceStamped*
+        ros_pose_with_covariance_stamped_msg) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/GzPoseWithCovarianceStampedMsgCallback");
   // ============================================ //
   // =================== HEADER ================= //
   // ============================================ //
   ConvertHeaderGzToRos(gz_pose_with_covariance_stamped_msg->header(),
-                       &ros_pose_with_covariance_stamped_msg_.header);
+                       &ros_pose_with_covariance_stamped_msg->header);
 
   // ============================================ //
   // === POSE (both position and orientation) === //
   // ============================================ //
-  ros_pose_with_covariance_stamped_msg_.pose.pose.position.x =
+  ros_pose_with_covariance_stamped_msg->pose.pose.position.x =
       gz_pose_with_covariance_stamped_msg->pose_with_covariance()
           .pose()
           .position()
           .x();
-  ros_pose_with_covariance_stamped_msg_.pose.pose.position.y =
+  ros_pose_with_covariance_stamped_msg->pose.pose.position.y =
       gz_pose_with_covariance_stamped_msg->pose_with_covariance()
           .pose()
           .position()
           .y();
-  ros_pose_with_covariance_stamped_msg_.pose.pose.position.z =
+  ros_pose_with_covariance_stamped_msg->pose.pose.position.z =
       gz_pose_with_covariance_stamped_msg->pose_with_covariance()
           .pose()
           .position()
           .z();
 
-  ros_pose_with_covariance_stamped_msg_.pose.pose.orientation.w =
+  ros_pose_with_covariance_stamped_msg->pose.pose.orientation.w =
       gz_pose_with_covariance_stamped_msg->pose_with_covariance()
           .pose()
           .orientation()
           .w();
-  ros_pose_with_covariance_stamped_msg_.pose.pose.orientation.x =
+  ros_pose_with_covariance_stamped_msg->pose.pose.orientation.x =
       gz_pose_with_covariance_stamped_msg->pose_with_covariance()
           .pose()
           .orientation()
           .x();
-  ros_pose_with_covariance_stamped_msg_.pose.pose.orientation.y =
+  ros_pose_with_covariance_stamped_msg->pose.pose.orientation.y =
       gz_pose_with_covariance_stamped_msg->pose_with_covariance()
           .pose()
           .orientation()
           .y();
-  ros_pose_with_covariance_stamped_msg_.pose.pose.orientation.z =
+  ros_pose_with_covariance_stamped_msg->pose.pose.orientation.z =
       gz_pose_with_covariance_stamped_msg->pose_with_covariance()
           .pose()
           .orientation()
@@ -779,155 +1264,283 @@ void GazeboRosInterfacePlugin::GzPoseWithCovarianceStampedMsgCallback(
                     .covariance_size() == 36,
             "The Gazebo PoseWithCovarianceStamped message does not have 9 "
             "position covariance elements.");
-  GZ_ASSERT(ros_pose_with_covariance_stamped_msg_.pose.covariance.size() == 36,
+  GZ_ASSERT(ros_pose_with_covariance_stamped_msg->pose.covariance.size() == 36,
             "The ROS PoseWithCovarianceStamped message does not have 9 "
             "position covariance elements.");
   for (int i = 0;
        i < gz_pose_with_covariance_stamped_msg->pose_with_covariance()
                .covariance_size();
        i++) {
-    ros_pose_with_covariance_stamped_msg_.pose.covariance[i] =
+    ros_pose_with_covariance_stamped_msg->pose.covariance[i] =
         gz_pose_with_covariance_stamped_msg->pose_with_covariance().covariance(
             i);
   }
+}
 
-  ros_publisher.publish(ros_pose_with_covariance_stamped_msg_);
+void GazeboRosInterfacePlugin::GzSwarmTelemetryMsgCallback(
+    GzSwarmTelemetryMsgPtr& gz_swarm_telemetry_msg,
+    rotors_comm::SwarmTelemetry* ros_swarm_telemetry_msg) {
+  ROTORS_PROFILE_SCOPE(
+      "gazebo_ros_interface_plugin/GzSwarmTelemetryMsgCallback");
+  ConvertHeaderGzToRos(gz_swarm_telemetry_msg->header(),
+                       &ros_swarm_telemetry_msg->header);
+
+  // The pooled message keeps its arrays, assign() only reallocates them when
+  // the swarm grows.
+  ros_swarm_telemetry_msg->name.assign(gz_swarm_telemetry_msg->name().begin(),
+                                       gz_swarm_telemetry_msg->name().end());
+  ros_swarm_telemetry_msg->num_motors.assign(
+      gz_swarm_telemetry_msg->num_motors().begin(),
+      gz_swarm_telemetry_msg->num_motors().end());
+  ros_swarm_telemetry_msg->vehicle_shard.assign(
+      gz_swarm_telemetry_msg->vehicle_shard().begin(),
+      gz_swarm_telemetry_msg->vehicle_shard().end());
+
+  const std::pair<const google::protobuf::RepeatedField<double>*,
+                  std::vector<double>*> arrays[] = {
+      {&gz_swarm_telemetry_msg->position_x(),
+       &ros_swarm_telemetry_msg->position_x},
+      {&gz_swarm_telemetry_msg->position_y(),
+       &ros_swarm_telemetry_msg->position_y},
+      {&gz_swarm_telemetry_msg->position_z(),
+       &ros_swarm_telemetry_msg->position_z},
+      {&gz_swarm_telemetry_msg->orientation_w(),
+       &ros_swarm_telemetry_msg->orientation_w},
+      {&gz_swarm_telemetry_msg->orientation_x(),
+       &ros_swarm_telemetry_msg->orientation_x},
+      {&gz_swarm_telemetry_msg->orientation_y(),
+       &ros_swarm_telemetry_msg->orientation_y},
+      {&gz_swarm_telemetry_msg->orientation_z(),
+       &ros_swarm_telemetry_msg->orientation_z},
+      {&gz_swarm_telemetry_msg->linear_velocity_x(),
+       &ros_swarm_telemetry_msg->linear_velocity_x},
+      {&gz_swarm_telemetry_msg->linear_velocity_y(),
+       &ros_swarm_telemetry_msg->linear_velocity_y},
+      {&gz_swarm_telemetry_msg->linear_velocity_z(),
+       &ros_swarm_telemetry_msg->linear_velocity_z},
+      {&gz_swarm_telemetry_msg->angular_velocity_x(),
+       &ros_swarm_telemetry_msg->angular_velocity_x},
+      {&gz_swarm_telemetry_msg->angular_velocity_y(),
+       &ros_swarm_telemetry_msg->angular_velocity_y},
+      {&gz_swarm_telemetry_msg->angular_velocity_z(),
+       &ros_swarm_telemetry_msg->angular_velocity_z},
+      {&gz_swarm_telemetry_msg->motor_speed(),
+       &ros_swarm_telemetry_msg->motor_speed}};
+  for (const auto& array : arrays) {
+    array.second->assign(array.first->begin(), array.first->end());
+  }
 }
 
 void GazeboRosInterfacePlugin::GzTransformStampedMsgCallback(
     GzTransformStampedMsgPtr& gz_transform_stamped_msg,
-    ros::Publisher ros_publisher) {
+    geometry_msgs::TransformStamped* ros_transform_stamped_msg) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/GzTransformStampedMsgCallback");
   // ============================================ //
   // =================== HEADER ================= //
   // ============================================ //
   ConvertHeaderGzToRos(gz_transform_stamped_msg->header(),
-                       &ros_transform_stamped_msg_.header);
+                       &ros_transform_stamped_msg->header);
 
   // ============================================ //
   // =========== TRANSFORM, TRANSLATION ========= //
   // ============================================ //
-  ros_transform_stamped_msg_.transform.translation.x =
+  ros_transform_stamped_msg->transform.translation.x =
       gz_transform_stamped_msg->transform().translation().x();
-  ros_transform_stamped_msg_.transform.translation.y =
+  ros_transform_stamped_msg->transform.translation.y =
       gz_transform_stamped_msg->transform().translation().y();
-  ros_transform_stamped_msg_.transform.translation.z =
+  ros_transform_stamped_msg->transform.translation.z =
       gz_transform_stamped_msg->transform().translation().z();
 
   // ============================================ //
   // ============ TRANSFORM, ROTATION =========== //
   // ============================================ //
-  ros_transform_stamped_msg_.transform.rotation.w =
+  ros_transform_stamped_msg->transform.rotation.w =
       gz_transform_stamped_msg->transform().rotation().w();
-  ros_transform_stamped_msg_.transform.rotation.x =
+  ros_transform_stamped_msg->transform.rotation.x =
       gz_transform_stamped_msg->transform().rotation().x();
-  ros_transform_stamped_msg_.transform.rotation.y =
+  ros_transform_stamped_msg->transform.rotation.y =
       gz_transform_stamped_msg->transform().rotation().y();
-  ros_transform_stamped_msg_.transform.rotation.z =
+  ros_transform_stamped_msg->transform.rotation.z =
       gz_transform_stamped_msg->transform().rotation().z();
-
-  ros_publisher.publish(ros_transform_stamped_msg_);
 }
 
 void GazeboRosInterfacePlugin::GzTwistStampedMsgCallback(
-    GzTwistStampedMsgPtr& gz_twist_stamped_msg, ros::Publisher ros_publisher) {
+    GzTwistStampedMsgPtr& gz_twist_stamped_msg,
+    geometry_msgs::TwistStamped* ros_twist_stamped_msg) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/GzTwistStampedMsgCallback");
   // ============================================ //
   // =================== HEADER ================= //
   // ============================================ //
   ConvertHeaderGzToRos(gz_twist_stamped_msg->header(),
-                       &ros_twist_stamped_msg_.header);
+                       &ros_twist_stamped_msg->header);
 
   // ============================================ //
   // =================== TWIST ================== //
   // ============================================ //
 
-  ros_twist_stamped_msg_.twist.linear.x =
+  ros_twist_stamped_msg->twist.linear.x =
       gz_twist_stamped_msg->twist().linear().x();
-  ros_twist_stamped_msg_.twist.linear.y =
+  ros_twist_stamped_msg->twist.linear.y =
       gz_twist_stamped_msg->twist().linear().y();
-  ros_twist_stamped_msg_.twist.linear.z =
+  ros_twist_stamped_msg->twist.linear.z =
       gz_twist_stamped_msg->twist().linear().z();
 
-  ros_twist_stamped_msg_.twist.angular.x =
+  ros_twist_stamped_msg->twist.angular.x =
       gz_twist_stamped_msg->twist().angular().x();
-  ros_twist_stamped_msg_.twist.angular.y =
+  ros_twist_stamped_msg->twist.angular.y =
       gz_twist_stamped_msg->twist().angular().y();
-  ros_twist_stamped_msg_.twist.angular.z =
+  ros_twist_stamped_msg->twist.angular.z =
       gz_twist_stamped_msg->twist().angular().z();
-
-  ros_publisher.publish(ros_twist_stamped_msg_);
 }
 
 void GazeboRosInterfacePlugin::GzVector3dStampedMsgCallback(
     GzVector3dStampedMsgPtr& gz_vector_3d_stamped_msg,
-    ros::Publisher ros_publisher) {
+    geometry_msgs::PointStamped* ros_position_stamped_msg) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/GzVector3dStampedMsgCallback");
   // ============================================ //
   // =================== HEADER ================= //
   // ============================================ //
   ConvertHeaderGzToRos(gz_vector_3d_stamped_msg->header(),
-                       &ros_position_stamped_msg_.header);
+                       &ros_position_stamped_msg->header);
 
   // ============================================ //
   // ================== POSITION ================ //
   // ============================================ //
 
-  ros_position_stamped_msg_.point.x = gz_vector_3d_stamped_msg->position().x();
-  ros_position_stamped_msg_.point.y = gz_vector_3d_stamped_msg->position().y();
-  ros_position_stamped_msg_.point.z = gz_vector_3d_stamped_msg->position().z();
-
-  ros_publisher.publish(ros_position_stamped_msg_);
+  ros_position_stamped_msg->point.x = gz_vector_3d_stamped_msg->position().x();
+  ros_position_stamped_msg->point.y = gz_vector_3d_stamped_msg->position().y();
+  ros_position_stamped_msg->point.z = gz_vector_3d_stamped_msg->position().z();
 }
 
 void GazeboRosInterfacePlugin::GzWindSpeedMsgCallback(
     GzWindSpeedMsgPtr& gz_wind_speed_msg,
-    ros::Publisher ros_publisher) {
+    rotors_comm::WindSpeed* ros_wind_speed_msg) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/GzWindSpeedMsgCallback");
   // ============================================ //
   // =================== HEADER ================= //
   // ============================================ //
   ConvertHeaderGzToRos(gz_wind_speed_msg->header(),
-                       &ros_wind_speed_msg_.header);
+                       &ros_wind_speed_msg->header);
 
   // ============================================ //
   // ================== VELOCITY ================ //
   // ============================================ //
-  ros_wind_speed_msg_.velocity.x =
+  ros_wind_speed_msg->velocity.x =
       gz_wind_speed_msg->velocity().x();
-  ros_wind_speed_msg_.velocity.y =
+  ros_wind_speed_msg->velocity.y =
       gz_wind_speed_msg->velocity().y();
-  ros_wind_speed_msg_.velocity.z =
+  ros_wind_speed_msg->velocity.z =
       gz_wind_speed_msg->velocity().z();
-  ros_publisher.publish(ros_wind_speed_msg_);
 }
 
 void GazeboRosInterfacePlugin::GzWrenchStampedMsgCallback(
     GzWrenchStampedMsgPtr& gz_wrench_stamped_msg,
-    ros::Publisher ros_publisher) {
+    geometry_msgs::WrenchStamped* ros_wrench_stamped_msg) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/GzWrenchStampedMsgCallback");
   // ============================================ //
   // =================== HEADER ================= //
   // ============================================ //
   ConvertHeaderGzToRos(gz_wrench_stamped_msg->header(),
-                       &ros_wrench_stamped_msg_.header);
+                       &ros_wrench_stamped_msg->header);
 
   // ============================================ //
   // =================== FORCE ================== //
   // ============================================ //
-  ros_wrench_stamped_msg_.wrench.force.x =
+  ros_wrench_stamped_msg->wrench.force.x =
       gz_wrench_stamped_msg->wrench().force().x();
-  ros_wrench_stamped_msg_.wrench.force.y =
+  ros_wrench_stamped_msg->wrench.force.y =
       gz_wrench_stamped_msg->wrench().force().y();
-  ros_wrench_stamped_msg_.wrench.force.z =
+  ros_wrench_stamped_msg->wrench.force.z =
       gz_wrench_stamped_msg->wrench().force().z();
 
   // ============================================ //
   // ==================== TORQUE ================ //
   // ============================================ //
-  ros_wrench_stamped_msg_.wrench.torque.x =
+  ros_wrench_stamped_msg->wrench.torque.x =
       gz_wrench_stamped_msg->wrench().torque().x();
-  ros_wrench_stamped_msg_.wrench.torque.y =
+  ros_wrench_stamped_msg->wrench.torque.y =
       gz_wrench_stamped_msg->wrench().torque().y();
-  ros_wrench_stamped_msg_.wrench.torque.z =
+  ros_wrench_stamped_msg->wrench.torque.z =
       gz_wrench_stamped_msg->wrench().torque().z();
+}
+
+//===========================================================================//
+//================= SHARED MEMORY -> ROS MSG CONVERTERS =====================//
+//===========================================================================//
+
+void GazeboRosInterfacePlugin::ShmImuRecordToRos(
+    const ShmImuRecord& record, const ShmRingReader<ShmImuRecord>& ring,
+    sensor_msgs::Imu* ros_imu_msg) {
+  ros_imu_msg->header.stamp.sec = record.stamp.sec;
+  ros_imu_msg->header.stamp.nsec = record.stamp.nsec;
+  ros_imu_msg->header.frame_id = ring.frame_id();
+
+  ros_imu_msg->orientation.w = record.orientation[0];
+  ros_imu_msg->orientation.x = record.orientation[1];
+  ros_imu_msg->orientation.y = record.orientation[2];
+  ros_imu_msg->orientation.z = record.orientation[3];
+
+  ros_imu_msg->angular_velocity.x = record.angular_velocity[0];
+  ros_imu_msg->angular_velocity.y = record.angular_velocity[1];
+  ros_imu_msg->angular_velocity.z = record.angular_velocity[2];
+
+  ros_imu_msg->linear_acceleration.x = record.linear_acceleration[0];
+  ros_imu_msg->linear_acceleration.y = record.linear_acceleration[1];
+  ros_imu_msg->linear_acceleration.z = record.linear_acceleration[2];
+
+  std::copy(record.orientation_covariance, record.orientation_covariance + 9,
+            ros_imu_msg->orientation_covariance.begin());
+  std::copy(record.angular_velocity_covariance,
+            record.angular_velocity_covariance + 9,
+            ros_imu_msg->angular_velocity_covariance.begin());
+  std::copy(record.linear_acceleration_covariance,
+            record.linear_acceleration_covariance + 9,
+            ros_imu_msg->linear_acceleration_covariance.begin());
+}
 
-  ros_publisher.publish(ros_wrench_stamped_msg_);
+void GazeboRosInterfacePlugin::ShmOdometryRecordToRos(
+    const ShmOdometryRecord& record,
+    const ShmRingReader<ShmOdometryRecord>& ring,
+    nav_msgs::Odometry* ros_odometry_msg) {
+  ros_odometry_msg->header.stamp.sec = record.stamp.sec;
+  ros_odometry_msg->header.stamp.nsec = record.stamp.nsec;
+  ros_odometry_msg->header.frame_id = ring.frame_id();
+  ros_odometry_msg->child_frame_id = ring.child_frame_id();
+
+  ros_odometry_msg->pose.pose.position.x = record.position[0];
+  ros_odometry_msg->pose.pose.position.y = record.position[1];
+  ros_odometry_msg->pose.pose.position.z = record.position[2];
+
+  ros_odometry_msg->pose.pose.orientation.w = record.orientation[0];
+  ros_odometry_msg->pose.pose.orientation.x = record.orientation[1];
+  ros_odometry_msg->pose.pose.orientation.y = record.orientation[2];
+  ros_odometry_msg->pose.pose.orientation.z = record.orientation[3];
+
+  ros_odometry_msg->twist.twist.linear.x = record.linear_velocity[0];
+  ros_odometry_msg->twist.twist.linear.y = record.linear_velocity[1];
+  ros_odometry_msg->twist.twist.linear.z = record.linear_velocity[2];
+
+  ros_odometry_msg->twist.twist.angular.x = record.angular_velocity[0];
+  ros_odometry_msg->twist.twist.angular.y = record.angular_velocity[1];
+  ros_odometry_msg->twist.twist.angular.z = record.angular_velocity[2];
+
+  std::copy(record.pose_covariance, record.pose_covariance + 36,
+            ros_odometry_msg->pose.covariance.begin());
+  std::copy(record.twist_covariance, record.twist_covariance + 36,
+            ros_odometry_msg->twist.covariance.begin());
+}
+
+void GazeboRosInterfacePlugin::ShmRotorVelocitiesRecordToRos(
+    const ShmRotorVelocitiesRecord& record,
+    const ShmRingReader<ShmRotorVelocitiesRecord>& ring,
+    mav_msgs::Actuators* ros_actuators_msg) {
+  ros_actuators_msg->header.stamp.sec = record.stamp.sec;
+  ros_actuators_msg->header.stamp.nsec = record.stamp.nsec;
+  ros_actuators_msg->header.frame_id = ring.frame_id();
+
+  ros_actuators_msg->angular_velocities.assign(
+      record.angular_velocities,
+      record.angular_velocities + record.num_rotors);
 }
 
 //===========================================================================//
@@ -937,6 +1550,7 @@ void GazeboRosInterfacePlugin::GzWrenchStampedMsgCallback(
 void GazeboRosInterfacePlugin::RosActuatorsMsgCallback(
     const mav_msgs::ActuatorsConstPtr& ros_actuators_msg_ptr,
     gazebo::transport::PublisherPtr gz_publisher_ptr) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/RosActuatorsMsgCallback");
   // Convert ROS message to Gazebo message
 
   gz_sensor_msgs::Actuators gz_actuators_msg;
@@ -966,6 +1580,7 @@ void GazeboRosInterfacePlugin::RosActuatorsMsgCallback(
 void GazeboRosInterfacePlugin::RosCommandMotorSpeedMsgCallback(
     const mav_msgs::ActuatorsConstPtr& ros_actuators_msg_ptr,
     gazebo::transport::PublisherPtr gz_publisher_ptr) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/RosCommandMotorSpeedMsgCallback");
   // Convert ROS message to Gazebo message
 
   gz_mav_msgs::CommandMotorSpeed gz_command_motor_speed_msg;
@@ -983,6 +1598,7 @@ void GazeboRosInterfacePlugin::RosRollPitchYawrateThrustMsgCallback(
     const mav_msgs::RollPitchYawrateThrustConstPtr&
         ros_roll_pitch_yawrate_thrust_msg_ptr,
     gazebo::transport::PublisherPtr gz_publisher_ptr) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/RosRollPitchYawrateThrustMsgCallback");
   // Convert ROS message to Gazebo message
 
   gz_mav_msgs::RollPitchYawrateThrust gz_roll_pitch_yawrate_thrust_msg;
@@ -1011,6 +1627,7 @@ void GazeboRosInterfacePlugin::RosRollPitchYawrateThrustMsgCallback(
 void GazeboRosInterfacePlugin::RosWindSpeedMsgCallback(
     const rotors_comm::WindSpeedConstPtr& ros_wind_speed_msg_ptr,
     gazebo::transport::PublisherPtr gz_publisher_ptr) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/RosWindSpeedMsgCallback");
   // Convert ROS message to Gazebo message
 
   gz_mav_msgs::WindSpeed gz_wind_speed_msg;
@@ -1031,23 +1648,68 @@ void GazeboRosInterfacePlugin::RosWindSpeedMsgCallback(
 
 void GazeboRosInterfacePlugin::GzBroadcastTransformMsgCallback(
     GzTransformStampedWithFrameIdsMsgPtr& broadcast_transform_msg) {
+  ROTORS_PROFILE_SCOPE("gazebo_ros_interface_plugin/GzBroadcastTransformMsgCallback");
   ros::Time stamp;
   stamp.sec = broadcast_transform_msg->header().stamp().sec();
   stamp.nsec = broadcast_transform_msg->header().stamp().nsec();
 
-  tf::Quaternion tf_q_W_L(broadcast_transform_msg->transform().rotation().x(),
-                          broadcast_transform_msg->transform().rotation().y(),
-                          broadcast_transform_msg->transform().rotation().z(),
-                          broadcast_transform_msg->transform().rotation().w());
+  std::lock_guard<std::mutex> lock(transforms_mutex_);
+  auto frame_entry =
+      tf_frames_.emplace(broadcast_transform_msg->child_frame_id(),
+                         TfFrameState());
+  TfFrameState& frame = frame_entry.first->second;
+  // After a world reset or any other jump back in time, the decimation
+  // starts over from the new stamp.
+  if (!frame_entry.second && tf_max_rate_ > 0.0 &&
+      !(stamp < frame.last_stamp) &&
+      (stamp - frame.last_stamp).toSec() < 1.0 / tf_max_rate_) {
+    return;
+  }
+  frame.last_stamp = stamp;
+
+  // A newer transform of the same frame replaces the queued one.
+  if (frame.batch != tf_batch_) {
+    frame.batch = tf_batch_;
+    frame.index = queued_transforms_.size();
+    queued_transforms_.emplace_back();
+  }
+  geometry_msgs::TransformStamped& transform =
+      queued_transforms_[frame.index];
+
+  transform.header.stamp = stamp;
+  transform.header.frame_id = broadcast_transform_msg->parent_frame_id();
+  transform.child_frame_id = broadcast_transform_msg->child_frame_id();
+
+  transform.transform.translation.x =
+      broadcast_transform_msg->transform().translation().x();
+  transform.transform.translation.y =
+      broadcast_transform_msg->transform().translation().y();
+  transform.transform.translation.z =
+      broadcast_transform_msg->transform().translation().z();
+
+  transform.transform.rotation.x =
+      broadcast_transform_msg->transform().rotation().x();
+  transform.transform.rotation.y =
+      broadcast_transform_msg->transform().rotation().y();
+  transform.transform.rotation.z =
+      broadcast_transform_msg->transform().rotation().z();
+  transform.transform.rotation.w =
+      broadcast_transform_msg->transform().rotation().w();
+}
 
-  tf::Vector3 tf_p(broadcast_transform_msg->transform().translation().x(),
-                   broadcast_transform_msg->transform().translation().y(),
-                   broadcast_transform_msg->transform().translation().z());
+void GazeboRosInterfacePlugin::BroadcastQueuedTransforms() {
+  {
+    std::lock_guard<std::mutex> lock(transforms_mutex_);
+    if (queued_transforms_.empty()) {
+      return;
+    }
+    broadcast_transforms_.swap(queued_transforms_);
+    queued_transforms_.clear();
+    ++tf_batch_;
+  }
 
-  tf_ = tf::Transform(tf_q_W_L, tf_p);
-  transform_broadcaster_.sendTransform(tf::StampedTransform(
-      tf_, stamp, broadcast_transform_msg->parent_frame_id(),
-      broadcast_transform_msg->child_frame_id()));
+  // All transforms go out in one tf2_msgs/TFMessage.
+  transform_broadcaster_.sendTransform(broadcast_transforms_);
 }
 
 GZ_REGISTER_WORLD_PLUGIN(GazeboRosInterfacePlugin);
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/gazebo_rtf_governor_plugin.h"
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+namespace gazebo {
+
+void GazeboRtfGovernorPlugin::Load(physics::WorldPtr _world,
+                                   sdf::ElementPtr _sdf) {
+  if (kPrintOnPluginLoad) {
+    gzdbg << __FUNCTION__ << "() called." << std::endl;
+  }
+
+  world_ = _world;
+  monitor_ = ControlLoopMonitor::Get(world_);
+  dispatcher_ = UpdateDispatcher::Get(world_);
+
+  std::string governor_topic = kDefaultRtfGovernorTopic;
+  getSdfParam<std::string>(_sdf, "governorTopic", governor_topic,
+                           governor_topic);
+  getSdfParam<double>(_sdf, "governorPeriod", period_, period_);
+  getSdfParam<double>(_sdf, "minRealTimeFactor", min_rtf_, min_rtf_);
+  getSdfParam<double>(_sdf, "maxRealTimeFactor", max_rtf_, max_rtf_);
+  getSdfParam<double>(_sdf, "initialRealTimeFactor", target_rtf_,
+                      target_rtf_);
+  getSdfParam<double>(_sdf, "increaseFactor", increase_factor_,
+                      increase_factor_);
+  getSdfParam<double>(_sdf, "decreaseFactor", decrease_factor_,
+                      decrease_factor_);
+  getSdfParam<double>(_sdf, "deadlineMargin", deadline_margin_,
+                      deadline_margin_);
+  if (!(min_rtf_ > 0.0) || max_rtf_ < min_rtf_ || !(period_ > 0.0) ||
+      !(increase_factor_ >= 1.0) || !(decrease_factor_ > 0.0) ||
+      !(decrease_factor_ <= 1.0) || !(deadline_margin_ > 0.0)) {
+    gzthrow("[gazebo_rtf_governor_plugin] Needs 0 < minRealTimeFactor <= "
+            "maxRealTimeFactor, governorPeriod > 0, increaseFactor >= 1, "
+            "0 < decreaseFactor <= 1 and deadlineMargin > 0.");
+  }
+  target_rtf_ = std::min(std::max(target_rtf_, min_rtf_), max_rtf_);
+
+  node_handle_ = transport::NodePtr(new transport::Node());
+  node_handle_->Init(world_->Name());
+  status_pub_ = node_handle_->Advertise<gz_diagnostic_msgs::RtfGovernorStatus>(
+      "~/" + governor_topic, 1);
+
+  ApplyTarget();
+  last_wall_time_ = std::chrono::steady_clock::now();
+  last_sim_time_ = world_->SimTime();
+  last_iterations_ = world_->Iterations();
+  update_end_connection_ = event::Events::ConnectWorldUpdateEnd(
+      boost::bind(&GazeboRtfGovernorPlugin::OnWorldUpdateEnd, this));
+}
+
+void GazeboRtfGovernorPlugin::OnWorldUpdateEnd() {
+  const auto now = std::chrono::steady_clock::now();
+  const double wall_seconds =
+      std::chrono::duration<double>(now - last_wall_time_).count();
+  if (wall_seconds < period_) {
+    return;
+  }
+  last_wall_time_ = now;
+  Govern(wall_seconds);
+}
+
+void GazeboRtfGovernorPlugin::Govern(double wall_seconds) {
+  const common::Time sim_time = world_->SimTime();
+  const uint64_t iterations = world_->Iterations();
+  const double sim_seconds = (sim_time - last_sim_time_).Double();
+  const uint64_t previous_iterations = last_iterations_;
+  last_sim_time_ = sim_time;
+  last_iterations_ = iterations;
+  const std::vector<ControlLoopStats> loops = monitor_->TakeStats();
+
+  // Wall time per step of the plugins on the update dispatcher, and the most
+  // expensive of them.
+  double plugin_seconds = 0.0;
+  double slowest_seconds = 0.0;
+  std::string slowest_plugin;
+  std::map<int, double> plugin_seconds_by_id;
+  for (const UpdateDispatcher::PluginTiming& plugin : dispatcher_->Timings()) {
+    auto last = last_plugin_seconds_.find(plugin.id);
+    const double seconds =
+        plugin.timing.total_seconds -
+        (last != last_plugin_seconds_.end() ? last->second : 0.0);
+    plugin_seconds_by_id[plugin.id] = plugin.timing.total_seconds;
+    plugin_seconds += seconds;
+    if (seconds > slowest_seconds) {
+      slowest_seconds = seconds;
+      slowest_plugin = plugin.name;
+    }
+  }
+  last_plugin_seconds_.swap(plugin_seconds_by_id);
+
+  // A paused period tells nothing about the load, and after a world reset
+  // the iterations start over.
+  if (iterations <= previous_iterations || sim_seconds <= 0.0) {
+    return;
+  }
+  const uint64_t steps = iterations - previous_iterations;
+  const double achieved_rtf = sim_seconds / wall_seconds;
+
+  // The loop closest to or furthest beyond its deadline decides.
+  uint64_t misses = 0;
+  double worst_ratio = 0.0;
+  const ControlLoopStats* worst_loop = nullptr;
+  for (const ControlLoopStats& loop : loops) {
+    misses += loop.misses;
+    const double ratio =
+        loop.deadline > 0.0 ? loop.max_latency / loop.deadline : 0.0;
+    if (!worst_loop || ratio > worst_ratio ||
+        (loop.misses > 0 && worst_loop->misses == 0)) {
+      worst_ratio = ratio;
+      worst_loop = &loop;
+    }
+  }
+
+  std::ostringstream reason;
+  std::string decision = "hold";
+  const double previous_target = target_rtf_;
+  if (misses > 0) {
+    decision = "decrease";
+    target_rtf_ *= decrease_factor_;
+    reason << misses << " missed deadlines, " << worst_loop->name << " took "
+           << worst_loop->max_latency * 1e3 << " ms of "
+           << worst_loop->deadline * 1e3 << " ms";
+  } else if (achieved_rtf < kRtfComputeBoundFraction * target_rtf_) {
+    // Raising the target would only make the controllers wait longer once
+    // the load drops, follow the achieved factor instead.
+    target_rtf_ = std::min(target_rtf_, achieved_rtf * increase_factor_);
+    decision = target_rtf_ < previous_target ? "decrease" : "hold";
+    reason << "compute bound at " << achieved_rtf << "x";
+    if (!slowest_plugin.empty()) {
+      reason << ", " << slowest_plugin << " takes "
+             << slowest_seconds / steps * 1e6 << " us per step";
+    }
+  } else if (worst_ratio < deadline_margin_) {
+    target_rtf_ *= increase_factor_;
+    decision = "increase";
+    if (worst_loop) {
+      reason << "slowest loop " << worst_loop->name << " at "
+             << worst_ratio * 100.0 << " % of its deadline";
+    } else {
+      reason << "no control loops";
+    }
+  } else {
+    reason << worst_loop->name << " at " << worst_ratio * 100.0
+           << " % of its deadline";
+  }
+  target_rtf_ = std::min(std::max(target_rtf_, min_rtf_), max_rtf_);
+  if (target_rtf_ == previous_target && decision != "hold") {
+    decision = "hold";
+    reason << ", at the " << (target_rtf_ == max_rtf_ ? "maximum" : "minimum")
+           << " real time factor";
+  }
+  if (target_rtf_ != previous_target) {
+    ApplyTarget();
+  }
+
+  status_msg_.Clear();
+  const common::Time wall_time = common::Time::GetWallTime();
+  status_msg_.mutable_header()->set_frame_id("");
+  status_msg_.mutable_header()->mutable_stamp()->set_sec(wall_time.sec);
+  status_msg_.mutable_header()->mutable_stamp()->set_nsec(wall_time.nsec);
+  status_msg_.set_decision(decision);
+  status_msg_.set_reason(reason.str());
+  status_msg_.set_target_real_time_factor(target_rtf_);
+  status_msg_.set_achieved_real_time_factor(achieved_rtf);
+  status_msg_.set_real_time_update_rate(
+      world_->Physics()->GetRealTimeUpdateRate());
+  status_msg_.set_plugin_us_per_step(plugin_seconds / steps * 1e6);
+  if (!slowest_plugin.empty()) {
+    status_msg_.set_slowest_plugin(slowest_plugin);
+    status_msg_.set_slowest_plugin_us_per_step(slowest_seconds / steps * 1e6);
+  }
+  for (const ControlLoopStats& loop : loops) {
+    gz_diagnostic_msgs::ControlLoopLatency* latency = status_msg_.add_loop();
+    latency->set_name(loop.name);
+    latency->set_samples(loop.samples);
+    latency->set_misses(loop.misses);
+    latency->set_deadline_ms(loop.deadline * 1e3);
+    latency->set_mean_latency_ms(
+        loop.samples > 0 ? loop.total_latency / loop.samples * 1e3 : 0.0);
+    latency->set_max_latency_ms(loop.max_latency * 1e3);
+    latency->set_max_wall_latency_ms(loop.max_wall_latency * 1e3);
+  }
+  status_pub_->Publish(status_msg_);
+}
+
+void GazeboRtfGovernorPlugin::ApplyTarget() {
+  physics::PhysicsEnginePtr physics = world_->Physics();
+  physics->SetRealTimeUpdateRate(target_rtf_ / physics->GetMaxStepSize());
+}
+
+GZ_REGISTER_WORLD_PLUGIN(GazeboRtfGovernorPlugin);
+
+}  // namespace gazebo
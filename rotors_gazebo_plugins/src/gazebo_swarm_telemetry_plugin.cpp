@@ -0,0 +1,298 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/gazebo_swarm_telemetry_plugin.h"
+
+#include <cstdlib>
+
+#include "ConnectGazeboToRosTopic.pb.h"
+
+namespace gazebo {
+
+void GazeboSwarmTelemetryPlugin::Load(physics::WorldPtr _world,
+                                      sdf::ElementPtr _sdf) {
+  if (kPrintOnPluginLoad) {
+    gzdbg << __FUNCTION__ << "() called." << std::endl;
+  }
+
+  world_ = _world;
+
+  std::string telemetry_topic = kDefaultSwarmTelemetryTopic;
+  double rate = kDefaultSwarmTelemetryRate;
+  getSdfParam<std::string>(_sdf, "telemetryTopic", telemetry_topic,
+                           telemetry_topic);
+  getSdfParam<double>(_sdf, "publishRate", rate, rate);
+  getSdfParam<std::string>(_sdf, "linkName", link_name_, link_name_);
+  getSdfParam<std::string>(_sdf, "modelPrefix", model_prefix_, model_prefix_);
+  getSdfParam<double>(_sdf, "rotorVelocitySlowdownSim",
+                      rotor_velocity_slowdown_sim_,
+                      rotor_velocity_slowdown_sim_);
+  int shard_id = kDefaultSwarmShardId;
+  int shard_port = kDefaultSwarmShardPort;
+  std::string shard_peers;
+  getSdfParam<int>(_sdf, "shardId", shard_id, shard_id);
+  getSdfParam<int>(_sdf, "shardPort", shard_port, shard_port);
+  getSdfParam<std::string>(_sdf, "shardPeers", shard_peers, shard_peers);
+  getSdfParam<bool>(_sdf, "shardGateway", shard_gateway_, shard_gateway_);
+  getSdfParam<double>(_sdf, "shardTimeout", shard_timeout_, shard_timeout_);
+  if (rate < 0.0) {
+    gzwarn << "[gazebo_swarm_telemetry_plugin] publishRate must not be "
+              "negative, publishing every step.\n";
+    rate = 0.0;
+  }
+  scheduler_.SetRate(rate);
+
+  if (shard_id >= 0) {
+    shard_link_ = std::make_shared<SwarmShardLink>();
+    if (shard_link_->Open(shard_id, shard_port,
+                          SwarmShardLink::ParsePeers(shard_peers))) {
+      SwarmShardLink::Register(world_->Name(), shard_link_);
+    } else {
+      gzerr << "[gazebo_swarm_telemetry_plugin] Can't open the link of shard "
+            << shard_id << ", only publishing the local vehicles.\n";
+      shard_link_.reset();
+    }
+  }
+
+  node_handle_ = transport::NodePtr(new transport::Node());
+  node_handle_->Init(world_->Name());
+  telemetry_pub_ = node_handle_->Advertise<gz_mav_msgs::SwarmTelemetry>(
+      "~/" + telemetry_topic, 1);
+  // The other shards share the ROS master with the gateway, which publishes
+  // the whole swarm.
+  if (!shard_link_ || shard_gateway_) {
+    ros_bridge_connector_.Add(
+        "~/" + telemetry_topic, telemetry_topic,
+        gz_std_msgs::ConnectGazeboToRosTopic::SWARM_TELEMETRY);
+    ros_bridge_connector_.Publish(node_handle_);
+  }
+
+  telemetry_msg_.mutable_header()->set_frame_id("world");
+  update_end_connection_ = event::Events::ConnectWorldUpdateEnd(
+      boost::bind(&GazeboSwarmTelemetryPlugin::OnWorldUpdateEnd, this));
+}
+
+void GazeboSwarmTelemetryPlugin::FindVehicles() {
+  vehicles_.clear();
+  telemetry_msg_.clear_name();
+  telemetry_msg_.clear_num_motors();
+  num_models_ = world_->ModelCount();
+
+  int num_motors = 0;
+  for (const physics::ModelPtr& model : world_->Models()) {
+    if (model->GetName().compare(0, model_prefix_.size(), model_prefix_) != 0) {
+      continue;
+    }
+    Vehicle vehicle;
+    vehicle.link = model->GetLink(link_name_);
+    if (!vehicle.link) {
+      continue;
+    }
+    for (const physics::LinkPtr& child : vehicle.link->GetChildJointsLinks()) {
+      const std::string child_name = child->GetScopedName();
+      const std::size_t pos = child_name.find("rotor_");
+      if (pos == std::string::npos) {
+        continue;
+      }
+      // Other links may contain "rotor_" too, e.g. a rotor_guard, only
+      // rotor_<number> is a motor.
+      const char* number_begin = child_name.c_str() + pos + 6;
+      char* number_end = nullptr;
+      const long parsed_number = std::strtol(number_begin, &number_end, 10);
+      if (number_end == number_begin || *number_end != '\0' ||
+          parsed_number < 0) {
+        continue;
+      }
+      const unsigned int motor_number = parsed_number;
+      physics::JointPtr joint = model->GetJoint(child->GetName() + "_joint");
+      if (!joint) {
+        continue;
+      }
+      if (vehicle.motors.size() <= motor_number) {
+        vehicle.motors.resize(motor_number + 1);
+      }
+      vehicle.motors[motor_number] = joint;
+    }
+    telemetry_msg_.add_name(model->GetName());
+    telemetry_msg_.add_num_motors(vehicle.motors.size());
+    num_motors += vehicle.motors.size();
+    vehicles_.push_back(vehicle);
+  }
+
+  // The arrays keep their size from here on, every step only overwrites them.
+  const int num_vehicles = vehicles_.size();
+  for (google::protobuf::RepeatedField<double>* field :
+       {telemetry_msg_.mutable_position_x(), telemetry_msg_.mutable_position_y(),
+        telemetry_msg_.mutable_position_z(),
+        telemetry_msg_.mutable_orientation_w(),
+        telemetry_msg_.mutable_orientation_x(),
+        telemetry_msg_.mutable_orientation_y(),
+        telemetry_msg_.mutable_orientation_z(),
+        telemetry_msg_.mutable_linear_velocity_x(),
+        telemetry_msg_.mutable_linear_velocity_y(),
+        telemetry_msg_.mutable_linear_velocity_z(),
+        telemetry_msg_.mutable_angular_velocity_x(),
+        telemetry_msg_.mutable_angular_velocity_y(),
+        telemetry_msg_.mutable_angular_velocity_z()}) {
+    field->Resize(num_vehicles, 0.0);
+  }
+  telemetry_msg_.mutable_motor_speed()->Resize(num_motors, 0.0);
+
+  gzmsg << "[gazebo_swarm_telemetry_plugin] Publishing the state of "
+        << num_vehicles << " vehicles with " << num_motors << " motors.\n";
+}
+
+void GazeboSwarmTelemetryPlugin::OnWorldUpdateEnd() {
+  ROTORS_PROFILE_SCOPE("gazebo_swarm_telemetry_plugin");
+
+  const common::Time now = world_->SimTime();
+  if (!scheduler_.Due(now.Double())) {
+    return;
+  }
+  if (world_->ModelCount() != num_models_) {
+    FindVehicles();
+  }
+  // The other shards need the state even when nobody listens locally.
+  if (!telemetry_pub_->HasConnections() && !shard_link_) {
+    return;
+  }
+
+  double* position_x = telemetry_msg_.mutable_position_x()->mutable_data();
+  double* position_y = telemetry_msg_.mutable_position_y()->mutable_data();
+  double* position_z = telemetry_msg_.mutable_position_z()->mutable_data();
+  double* orientation_w =
+      telemetry_msg_.mutable_orientation_w()->mutable_data();
+  double* orientation_x =
+      telemetry_msg_.mutable_orientation_x()->mutable_data();
+  double* orientation_y =
+      telemetry_msg_.mutable_orientation_y()->mutable_data();
+  double* orientation_z =
+      telemetry_msg_.mutable_orientation_z()->mutable_data();
+  double* linear_velocity_x =
+      telemetry_msg_.mutable_linear_velocity_x()->mutable_data();
+  double* linear_velocity_y =
+      telemetry_msg_.mutable_linear_velocity_y()->mutable_data();
+  double* linear_velocity_z =
+      telemetry_msg_.mutable_linear_velocity_z()->mutable_data();
+  double* angular_velocity_x =
+      telemetry_msg_.mutable_angular_velocity_x()->mutable_data();
+  double* angular_velocity_y =
+      telemetry_msg_.mutable_angular_velocity_y()->mutable_data();
+  double* angular_velocity_z =
+      telemetry_msg_.mutable_angular_velocity_z()->mutable_data();
+  double* motor_speed = telemetry_msg_.mutable_motor_speed()->mutable_data();
+
+  for (std::size_t i = 0; i < vehicles_.size(); ++i) {
+    const Vehicle& vehicle = vehicles_[i];
+    const ignition::math::Pose3d pose = vehicle.link->WorldPose();
+    const ignition::math::Vector3d linear_velocity =
+        vehicle.link->WorldLinearVel();
+    const ignition::math::Vector3d angular_velocity =
+        vehicle.link->WorldAngularVel();
+    position_x[i] = pose.Pos().X();
+    position_y[i] = pose.Pos().Y();
+    position_z[i] = pose.Pos().Z();
+    orientation_w[i] = pose.Rot().W();
+    orientation_x[i] = pose.Rot().X();
+    orientation_y[i] = pose.Rot().Y();
+    orientation_z[i] = pose.Rot().Z();
+    linear_velocity_x[i] = linear_velocity.X();
+    linear_velocity_y[i] = linear_velocity.Y();
+    linear_velocity_z[i] = linear_velocity.Z();
+    angular_velocity_x[i] = angular_velocity.X();
+    angular_velocity_y[i] = angular_velocity.Y();
+    angular_velocity_z[i] = angular_velocity.Z();
+    for (const physics::JointPtr& motor : vehicle.motors) {
+      *motor_speed++ =
+          motor ? motor->GetVelocity(0) * rotor_velocity_slowdown_sim_ : 0.0;
+    }
+  }
+
+  telemetry_msg_.mutable_header()->mutable_stamp()->set_sec(now.sec);
+  telemetry_msg_.mutable_header()->mutable_stamp()->set_nsec(now.nsec);
+  if (shard_link_) {
+    shard_link_->Send(telemetry_msg_);
+  }
+  if (!telemetry_pub_->HasConnections()) {
+    return;
+  }
+  if (shard_link_ && shard_gateway_) {
+    PublishGatewayTelemetry();
+  } else {
+    telemetry_pub_->Publish(telemetry_msg_);
+  }
+}
+
+void GazeboSwarmTelemetryPlugin::PublishGatewayTelemetry() {
+  const int num_local_vehicles = telemetry_msg_.name_size();
+  const int num_local_motors = telemetry_msg_.motor_speed_size();
+  shard_link_->RemoteVehicles(shard_timeout_, &remote_vehicles_);
+
+  telemetry_msg_.mutable_vehicle_shard()->Resize(num_local_vehicles,
+                                                 shard_link_->shard_id());
+  for (const SwarmShardVehicle& vehicle : remote_vehicles_) {
+    telemetry_msg_.add_name(vehicle.name);
+    telemetry_msg_.add_num_motors(vehicle.motor_speed.size());
+    telemetry_msg_.add_position_x(vehicle.position[0]);
+    telemetry_msg_.add_position_y(vehicle.position[1]);
+    telemetry_msg_.add_position_z(vehicle.position[2]);
+    telemetry_msg_.add_orientation_w(vehicle.orientation[0]);
+    telemetry_msg_.add_orientation_x(vehicle.orientation[1]);
+    telemetry_msg_.add_orientation_y(vehicle.orientation[2]);
+    telemetry_msg_.add_orientation_z(vehicle.orientation[3]);
+    telemetry_msg_.add_linear_velocity_x(vehicle.linear_velocity[0]);
+    telemetry_msg_.add_linear_velocity_y(vehicle.linear_velocity[1]);
+    telemetry_msg_.add_linear_velocity_z(vehicle.linear_velocity[2]);
+    telemetry_msg_.add_angular_velocity_x(vehicle.angular_velocity[0]);
+    telemetry_msg_.add_angular_velocity_y(vehicle.angular_velocity[1]);
+    telemetry_msg_.add_angular_velocity_z(vehicle.angular_velocity[2]);
+    for (double motor_speed : vehicle.motor_speed) {
+      telemetry_msg_.add_motor_speed(motor_speed);
+    }
+    telemetry_msg_.add_vehicle_shard(vehicle.shard);
+  }
+  telemetry_pub_->Publish(telemetry_msg_);
+
+  // Back to the local vehicles, which the next step overwrites in place.
+  telemetry_msg_.mutable_name()->DeleteSubrange(
+      num_local_vehicles, telemetry_msg_.name_size() - num_local_vehicles);
+  telemetry_msg_.mutable_num_motors()->Truncate(num_local_vehicles);
+  for (google::protobuf::RepeatedField<double>* field :
+       {telemetry_msg_.mutable_position_x(), telemetry_msg_.mutable_position_y(),
+        telemetry_msg_.mutable_position_z(),
+        telemetry_msg_.mutable_orientation_w(),
+        telemetry_msg_.mutable_orientation_x(),
+        telemetry_msg_.mutable_orientation_y(),
+        telemetry_msg_.mutable_orientation_z(),
+        telemetry_msg_.mutable_linear_velocity_x(),
+        telemetry_msg_.mutable_linear_velocity_y(),
+        telemetry_msg_.mutable_linear_velocity_z(),
+        telemetry_msg_.mutable_angular_velocity_x(),
+        telemetry_msg_.mutable_angular_velocity_y(),
+        telemetry_msg_.mutable_angular_velocity_z()}) {
+    field->Truncate(num_local_vehicles);
+  }
+  telemetry_msg_.mutable_motor_speed()->Truncate(num_local_motors);
+  telemetry_msg_.clear_vehicle_shard();
+}
+
+GZ_REGISTER_WORLD_PLUGIN(GazeboSwarmTelemetryPlugin);
+
+}  // namespace gazebo
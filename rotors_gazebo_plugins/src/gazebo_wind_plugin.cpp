@@ -22,6 +22,7 @@
 #include "rotors_gazebo_plugins/gazebo_wind_plugin.h"
 
 #include <fstream>
+#include <functional>
 #include <math.h>
 
 #include "ConnectGazeboToRosTopic.pb.h"
@@ -29,7 +30,10 @@
 namespace gazebo {
 
 GazeboWindPlugin::~GazeboWindPlugin() {
-  
+  if (wind_service_) {
+    wind_service_->UnregisterLink(wind_service_link_id_);
+  }
+  wind_field_sequence_.Close();
 }
 
 void GazeboWindPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
@@ -70,6 +74,14 @@ void GazeboWindPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
                            wind_speed_pub_topic_);
   getSdfParam<std::string>(_sdf, "frameId", frame_id_, frame_id_);
   getSdfParam<std::string>(_sdf, "linkName", link_name_, link_name_);
+  wind_speed_policy_.Load(_sdf, "gazebo_wind_plugin");
+  wind_force_policy_ = wind_speed_policy_;
+  // The force is in N and the speed in m/s, so the force has a threshold of
+  // its own, publishChangeThreshold unless it is set.
+  double force_change_threshold = wind_speed_policy_.change_threshold();
+  getSdfParam<double>(_sdf, "windForcePublishChangeThreshold",
+                      force_change_threshold, force_change_threshold);
+  wind_force_policy_.set_change_threshold(force_change_threshold);
   // Get the wind speed params from SDF.
   getSdfParam<double>(_sdf, "windSpeedMean", wind_speed_mean_,
                       wind_speed_mean_);
@@ -80,6 +92,9 @@ void GazeboWindPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
   // Check if a custom static wind field should be used.
   getSdfParam<bool>(_sdf, "useCustomStaticWindField", use_custom_static_wind_field_,
                       use_custom_static_wind_field_);
+  // Check if the custom wind field is owned by a GazeboWindWorldPlugin.
+  getSdfParam<bool>(_sdf, "useWorldWindService", use_world_wind_service_,
+                      use_world_wind_service_);
   if (!use_custom_static_wind_field_) {
     gzdbg << "[gazebo_wind_plugin] Using user-defined constant wind field and gusts.\n";
     // Get the wind params from SDF.
@@ -102,13 +117,32 @@ void GazeboWindPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
     wind_gust_direction_.Normalize();
     wind_gust_start_ = common::Time(wind_gust_start);
     wind_gust_end_ = common::Time(wind_gust_start + wind_gust_duration);
+  } else if (use_world_wind_service_) {
+    gzdbg << "[gazebo_wind_plugin] Using custom wind field of the world wind service.\n";
   } else {
     gzdbg << "[gazebo_wind_plugin] Using custom wind field from text file.\n";
     // Get the wind field text file path, read it and save data.
     std::string custom_wind_field_path;
     getSdfParam<std::string>(_sdf, "customWindFieldPath", custom_wind_field_path,
                         custom_wind_field_path);
-    ReadCustomWindField(custom_wind_field_path);
+    // A time-varying wind field is given as a sequence of frames, where
+    // customWindFieldPath is a printf-style pattern taking the frame index.
+    getSdfParam<int>(_sdf, "customWindFieldFrameCount", wind_field_frame_count_,
+                        wind_field_frame_count_);
+    getSdfParam<double>(_sdf, "customWindFieldFramePeriod", wind_field_frame_period_,
+                        wind_field_frame_period_);
+    if (wind_field_frame_count_ > 1) {
+      if (wind_field_sequence_.Open(custom_wind_field_path, wind_field_frame_count_,
+                                    wind_field_frame_period_)) {
+        gzdbg << "[gazebo_wind_plugin] Streaming " << wind_field_frame_count_
+              << " custom wind field frames.\n";
+      } else {
+        gzerr << "[gazebo_wind_plugin] Could not open custom wind field frame sequence.\n";
+      }
+    } else {
+      wind_field_.UseArena(ModelArena::ForPlugin(model_, "gazebo_wind_plugin"));
+      ReadCustomWindField(custom_wind_field_path);
+    }
   }
 
   link_ = model_->GetLink(link_name_);
@@ -116,17 +150,76 @@ void GazeboWindPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
     gzthrow("[gazebo_wind_plugin] Couldn't find specified link \"" << link_name_
                                                                    << "\".");
 
-  // Listen to the update event. This event is broadcast every
-  // simulation iteration.
-  update_connection_ = event::Events::ConnectWorldUpdateBegin(
+  // Turbulence on top of any of the wind modes above.
+  std::string turbulence_model;
+  getSdfParam<std::string>(_sdf, "turbulenceModel", turbulence_model,
+                           turbulence_model);
+  if (!turbulence_model.empty() && turbulence_model != "none") {
+    TurbulenceParams turbulence_params;
+    ignition::math::Vector3d std_dev(turbulence_params.std_dev[0],
+                                     turbulence_params.std_dev[1],
+                                     turbulence_params.std_dev[2]);
+    ignition::math::Vector3d length_scale(turbulence_params.length_scale[0],
+                                          turbulence_params.length_scale[1],
+                                          turbulence_params.length_scale[2]);
+    getSdfParam<ignition::math::Vector3d>(_sdf, "turbulenceStdDev", std_dev,
+                                          std_dev);
+    getSdfParam<ignition::math::Vector3d>(_sdf, "turbulenceLengthScale",
+                                          length_scale, length_scale);
+    getSdfParam<double>(_sdf, "turbulenceSampleSpacing",
+                        turbulence_params.sample_spacing,
+                        turbulence_params.sample_spacing);
+    getSdfParam<int>(_sdf, "turbulenceNumSamples", turbulence_params.num_samples,
+                     turbulence_params.num_samples);
+    getSdfParam<int>(_sdf, "turbulenceSeed", turbulence_params.seed,
+                     turbulence_params.seed);
+    getSdfParam<double>(_sdf, "turbulenceMinAirspeed", turbulence_min_airspeed_,
+                        turbulence_min_airspeed_);
+    for (int axis = 0; axis < 3; ++axis) {
+      turbulence_params.std_dev[axis] = std_dev[axis];
+      turbulence_params.length_scale[axis] = length_scale[axis];
+    }
+    if (ParseTurbulenceModel(turbulence_model, &turbulence_params.model)) {
+      turbulence_ = WindTurbulence::Get(turbulence_params);
+      // Every vehicle starts at its own place of the shared sequence.
+      turbulence_distance_ =
+          std::fmod(static_cast<double>(
+                        std::hash<std::string>()(link_->GetScopedName())),
+                    turbulence_->period());
+      gzdbg << "[gazebo_wind_plugin] Using " << turbulence_model
+            << " turbulence repeating every " << turbulence_->period()
+            << " m.\n";
+    } else {
+      gzerr << "[gazebo_wind_plugin] Unknown turbulenceModel \""
+            << turbulence_model << "\", use dryden or von_karman.\n";
+    }
+  }
+
+  if (use_custom_static_wind_field_ && use_world_wind_service_) {
+    wind_service_ = WindService::Find(world_);
+    if (wind_service_) {
+      wind_service_link_id_ = wind_service_->RegisterLink(link_);
+    } else {
+      gzerr << "[gazebo_wind_plugin] No GazeboWindWorldPlugin found in the world, "
+               "using the default constant wind speed.\n";
+    }
+  }
+
+  // Listen to the update event, either directly or through the update
+  // dispatcher of the world. This event is broadcast every simulation
+  // iteration.
+  update_connection_ = UpdateDispatcher::Connect(
+      _model, _sdf, "gazebo_wind_plugin", kUpdatePriorityEnvironment,
       boost::bind(&GazeboWindPlugin::OnUpdate, this, _1));
+  checkpoint_connection_ = SimulationCheckpoint::Connect(
+      world_, model_->GetScopedName() + "/gazebo_wind_plugin/" + link_name_,
+      boost::bind(&GazeboWindPlugin::SaveCheckpoint, this, _1),
+      boost::bind(&GazeboWindPlugin::RestoreCheckpoint, this, _1));
 }
 
 // This gets called by the world update start event.
 void GazeboWindPlugin::OnUpdate(const common::UpdateInfo& _info) {
-  if (kPrintOnUpdates) {
-    gzdbg << __FUNCTION__ << "() called." << std::endl;
-  }
+  ROTORS_PROFILE_SCOPE("gazebo_wind_plugin");
 
   if (!pubs_and_subs_created_) {
     CreatePubsAndSubs();
@@ -155,23 +248,28 @@ void GazeboWindPlugin::OnUpdate(const common::UpdateInfo& _info) {
       link_->AddForceAtRelativePosition(wind_gust, xyz_offset_);
     }
 
-    wrench_stamped_msg_.mutable_header()->set_frame_id(frame_id_);
-    wrench_stamped_msg_.mutable_header()->mutable_stamp()->set_sec(now.sec);
-    wrench_stamped_msg_.mutable_header()->mutable_stamp()->set_nsec(now.nsec);
-
-    wrench_stamped_msg_.mutable_wrench()->mutable_force()->set_x(wind.X() +
-                                                                 wind_gust.X());
-    wrench_stamped_msg_.mutable_wrench()->mutable_force()->set_y(wind.Y() +
-                                                                 wind_gust.Y());
-    wrench_stamped_msg_.mutable_wrench()->mutable_force()->set_z(wind.Z() +
-                                                                 wind_gust.Z());
-
-    // No torque due to wind, set x,y and z to 0.
-    wrench_stamped_msg_.mutable_wrench()->mutable_torque()->set_x(0);
-    wrench_stamped_msg_.mutable_wrench()->mutable_torque()->set_y(0);
-    wrench_stamped_msg_.mutable_wrench()->mutable_torque()->set_z(0);
-
-    wind_force_pub_->Publish(wrench_stamped_msg_);
+    const ignition::math::Vector3d wind_force = wind + wind_gust;
+    const double force_values[] = {wind_force.X(), wind_force.Y(),
+                                   wind_force.Z()};
+    if (wind_force_policy_.ShouldPublish(now.Double(), force_values, 3)) {
+      wrench_stamped_msg_.mutable_header()->set_frame_id(frame_id_);
+      wrench_stamped_msg_.mutable_header()->mutable_stamp()->set_sec(now.sec);
+      wrench_stamped_msg_.mutable_header()->mutable_stamp()->set_nsec(now.nsec);
+
+      wrench_stamped_msg_.mutable_wrench()->mutable_force()->set_x(
+          wind_force.X());
+      wrench_stamped_msg_.mutable_wrench()->mutable_force()->set_y(
+          wind_force.Y());
+      wrench_stamped_msg_.mutable_wrench()->mutable_force()->set_z(
+          wind_force.Z());
+
+      // No torque due to wind, set x,y and z to 0.
+      wrench_stamped_msg_.mutable_wrench()->mutable_torque()->set_x(0);
+      wrench_stamped_msg_.mutable_wrench()->mutable_torque()->set_y(0);
+      wrench_stamped_msg_.mutable_wrench()->mutable_torque()->set_z(0);
+
+      wind_force_pub_->Publish(wrench_stamped_msg_);
+    }
 
     // Calculate the wind speed.
     wind_velocity = wind_speed_mean_ * wind_direction_;
@@ -179,113 +277,45 @@ void GazeboWindPlugin::OnUpdate(const common::UpdateInfo& _info) {
     // Get the current position of the aircraft in world coordinates.
     ignition::math::Vector3d link_position = link_->WorldPose().Pos();
 
-    // Calculate the x, y index of the grid points with x, y-coordinate 
-    // just smaller than or equal to aircraft x, y position.
-    std::size_t x_inf = floor((link_position.X() - min_x_) / res_x_);
-    std::size_t y_inf = floor((link_position.Y() - min_y_) / res_y_);
-
-    // In case aircraft is on one of the boundary surfaces at max_x or max_y,
-    // decrease x_inf, y_inf by one to have x_sup, y_sup on max_x, max_y.
-    if (x_inf == n_x_ - 1u) {
-      x_inf = n_x_ - 2u;
-    }
-    if (y_inf == n_y_ - 1u) {
-      y_inf = n_y_ - 2u;
-    }
-
-    // Calculate the x, y index of the grid points with x, y-coordinate just
-    // greater than the aircraft x, y position. 
-    std::size_t x_sup = x_inf + 1u;
-    std::size_t y_sup = y_inf + 1u;
-
-    // Save in an array the x, y index of each of the eight grid points 
-    // enclosing the aircraft.
-    constexpr unsigned int n_vertices = 8;
-    std::size_t idx_x[n_vertices] = {x_inf, x_inf, x_sup, x_sup, x_inf, x_inf, x_sup, x_sup};
-    std::size_t idx_y[n_vertices] = {y_inf, y_inf, y_inf, y_inf, y_sup, y_sup, y_sup, y_sup};
-
-    // Find the vertical factor of the aircraft in each of the four surrounding 
-    // grid columns, and their minimal/maximal value.
-    constexpr unsigned int n_columns = 4;
-    float vertical_factors_columns[n_columns];
-    for (std::size_t i = 0u; i < n_columns; ++i) {
-      vertical_factors_columns[i] = (
-        link_position.Z() - bottom_z_[idx_x[2u * i] + idx_y[2u * i] * n_x_]) /
-        (top_z_[idx_x[2u * i] + idx_y[2u * i] * n_x_] - bottom_z_[idx_x[2u * i] + idx_y[2u * i] * n_x_]);
-    }
-    
-    // Find maximal and minimal value amongst vertical factors.
-    float vertical_factors_min = std::min(std::min(std::min(
-      vertical_factors_columns[0], vertical_factors_columns[1]),
-      vertical_factors_columns[2]), vertical_factors_columns[3]);
-    float vertical_factors_max = std::max(std::max(std::max(
-      vertical_factors_columns[0], vertical_factors_columns[1]),
-      vertical_factors_columns[2]), vertical_factors_columns[3]);
-
     // Check if aircraft is out of wind field or not, and act accordingly.
-    if (x_inf >= 0u && y_inf >= 0u && vertical_factors_max >= 0u && 
-        x_sup <= (n_x_ - 1u) && y_sup <= (n_y_ - 1u) && vertical_factors_min <= 1u) {
-      // Find indices in z-direction for each of the vertices. If link is not 
-      // within the range of one of the columns, set to lowest or highest two.
-      std::size_t idx_z[n_vertices] = {0u, static_cast<int>(vertical_spacing_factors_.size()) - 1u,
-                              0u, static_cast<int>(vertical_spacing_factors_.size()) - 1u,
-                              0u, static_cast<int>(vertical_spacing_factors_.size()) - 1u,
-                              0u, static_cast<int>(vertical_spacing_factors_.size()) - 1u};
-      for (std::size_t i = 0u; i < n_columns; ++i) {
-        if (vertical_factors_columns[i] < 0u) {
-          // Link z-position below lowest grid point of that column.
-          idx_z[2u * i + 1u] = 1u;
-        } else if (vertical_factors_columns[i] >= 1u) {
-          // Link z-position above highest grid point of that column.
-          idx_z[2u * i] = vertical_spacing_factors_.size() - 2u;
-        } else {
-          // Link z-position between two grid points in that column.
-          for (std::size_t j = 0u; j < vertical_spacing_factors_.size() - 1u; ++j) {
-            if (vertical_spacing_factors_[j] <= vertical_factors_columns[i] && 
-                vertical_spacing_factors_[j + 1u] > vertical_factors_columns[i]) {
-              idx_z[2u * i] = j;
-              idx_z[2u * i + 1u] = j + 1u;
-              break;
-            }
-          }
-        }
-      }
-
-      // Extract the wind velocities corresponding to each vertex.
-      ignition::math::Vector3d wind_at_vertices[n_vertices];
-      for (std::size_t i = 0u; i < n_vertices; ++i) {
-        wind_at_vertices[i].X() = u_[idx_x[i] + idx_y[i] * n_x_ + idx_z[i] * n_x_ * n_y_];
-        wind_at_vertices[i].Y() = v_[idx_x[i] + idx_y[i] * n_x_ + idx_z[i] * n_x_ * n_y_];
-        wind_at_vertices[i].Z() = w_[idx_x[i] + idx_y[i] * n_x_ + idx_z[i] * n_x_ * n_y_];
+    bool in_wind_field = false;
+    if (use_world_wind_service_) {
+      // The world wind service evaluates all vehicles in one pass, and falls
+      // back to its own default outside of the wind field.
+      if (wind_service_) {
+        wind_velocity = wind_service_->GetWindVelocity(wind_service_link_id_);
+        in_wind_field = true;
       }
-
-      // Extract the relevant coordinate of every point needed for trilinear 
-      // interpolation (first z-direction, then x-direction, then y-direction).
-      constexpr unsigned int n_points_interp_z = 8;
-      constexpr unsigned int n_points_interp_x = 4;
-      constexpr unsigned int n_points_interp_y = 2;
-      double interpolation_points[n_points_interp_x + n_points_interp_y + n_points_interp_z];
-      for (std::size_t i = 0u; i < n_points_interp_x + n_points_interp_y + n_points_interp_z; ++i) {
-        if (i < n_points_interp_z) {
-          interpolation_points[i] = (
-            top_z_[idx_x[i] + idx_y[i] * n_x_] - bottom_z_[idx_x[i] + idx_y[i] * n_x_])
-            * vertical_spacing_factors_[idx_z[i]] + bottom_z_[idx_x[i] + idx_y[i] * n_x_];
-        } else if (i >= n_points_interp_z && i < n_points_interp_x + n_points_interp_z) {
-          interpolation_points[i] = min_x_ + res_x_ * idx_x[2u * (i - n_points_interp_z)];
-        } else {
-          interpolation_points[i] = min_y_ + res_y_ * idx_y[4u * (i - n_points_interp_z - n_points_interp_x)];
-        }
-      }
-
-      // Interpolate wind velocity at aircraft position.
-      wind_velocity = TrilinearInterpolation(
-        link_position, wind_at_vertices, interpolation_points);
+    } else if (wind_field_frame_count_ > 1) {
+      // Interpolate in time between the two frames enclosing the current time.
+      const WindField* frame_a;
+      const WindField* frame_b;
+      double alpha;
+      wind_field_sequence_.GetFrames(now.Double(), &frame_a, &frame_b, &alpha);
+      ignition::math::Vector3d wind_velocity_a;
+      ignition::math::Vector3d wind_velocity_b;
+      in_wind_field =
+          CustomWindFieldVelocity(*frame_a, link_position, &wind_velocity_a) &&
+          CustomWindFieldVelocity(*frame_b, link_position, &wind_velocity_b);
+      wind_velocity = wind_velocity_a + (wind_velocity_b - wind_velocity_a) * alpha;
     } else {
+      in_wind_field = CustomWindFieldVelocity(wind_field_, link_position, &wind_velocity);
+    }
+    if (!in_wind_field) {
       // Set the wind velocity to the default constant value specified by user.
       wind_velocity = wind_speed_mean_ * wind_direction_;
     }
   }
-  
+
+  if (turbulence_) {
+    AddTurbulence(now, &wind_velocity);
+  }
+
+  const double speed_values[] = {wind_velocity.X(), wind_velocity.Y(),
+                                 wind_velocity.Z()};
+  if (!wind_speed_policy_.ShouldPublish(now.Double(), speed_values, 3)) {
+    return;
+  }
   wind_speed_msg_.mutable_header()->set_frame_id(frame_id_);
   wind_speed_msg_.mutable_header()->mutable_stamp()->set_sec(now.sec);
   wind_speed_msg_.mutable_header()->mutable_stamp()->set_nsec(now.nsec);
@@ -298,11 +328,6 @@ void GazeboWindPlugin::OnUpdate(const common::UpdateInfo& _info) {
 }
 
 void GazeboWindPlugin::CreatePubsAndSubs() {
-  // Create temporary "ConnectGazeboToRosTopic" publisher and message.
-  gazebo::transport::PublisherPtr connect_gazebo_to_ros_topic_pub =
-      node_handle_->Advertise<gz_std_msgs::ConnectGazeboToRosTopic>(
-          "~/" + kConnectGazeboToRosSubtopic, 1);
-
   gz_std_msgs::ConnectGazeboToRosTopic connect_gazebo_to_ros_topic_msg;
 
   // ============================================ //
@@ -318,8 +343,7 @@ void GazeboWindPlugin::CreatePubsAndSubs() {
                                                 wind_force_pub_topic_);
   connect_gazebo_to_ros_topic_msg.set_msgtype(
       gz_std_msgs::ConnectGazeboToRosTopic::WRENCH_STAMPED);
-  connect_gazebo_to_ros_topic_pub->Publish(connect_gazebo_to_ros_topic_msg,
-                                           true);
+  ros_bridge_connector_.Add(connect_gazebo_to_ros_topic_msg);
 
   // ============================================ //
   // ========== WIND SPEED MSG SETUP ============ //
@@ -333,111 +357,74 @@ void GazeboWindPlugin::CreatePubsAndSubs() {
                                                 wind_speed_pub_topic_);
   connect_gazebo_to_ros_topic_msg.set_msgtype(
       gz_std_msgs::ConnectGazeboToRosTopic::WIND_SPEED);
-  connect_gazebo_to_ros_topic_pub->Publish(connect_gazebo_to_ros_topic_msg,
-                                           true);
+  ros_bridge_connector_.Add(connect_gazebo_to_ros_topic_msg);
+  ros_bridge_connector_.Publish(node_handle_);
 }
 
 void GazeboWindPlugin::ReadCustomWindField(std::string& custom_wind_field_path) {
-  std::ifstream fin;
-  fin.open(custom_wind_field_path);
-  if (fin.is_open()) {
-    std::string data_name;
-    float data;
-    // Read the line with the variable name.
-    while (fin >> data_name) {
-      // Save data on following line into the correct variable.
-      if (data_name == "min_x:") {
-        fin >> min_x_;
-      } else if (data_name == "min_y:") {
-        fin >> min_y_;
-      } else if (data_name == "n_x:") {
-        fin >> n_x_;
-      } else if (data_name == "n_y:") {
-        fin >> n_y_;
-      } else if (data_name == "res_x:") {
-        fin >> res_x_;
-      } else if (data_name == "res_y:") {
-        fin >> res_y_;
-      } else if (data_name == "vertical_spacing_factors:") {
-        while (fin >> data) {
-          vertical_spacing_factors_.push_back(data);
-          if (fin.peek() == '\n') break;
-        }
-      } else if (data_name == "bottom_z:") {
-        while (fin >> data) {
-          bottom_z_.push_back(data);
-          if (fin.peek() == '\n') break;
-        }
-      } else if (data_name == "top_z:") {
-        while (fin >> data) {
-          top_z_.push_back(data);
-          if (fin.peek() == '\n') break;
-        }
-      } else if (data_name == "u:") {
-        while (fin >> data) {
-          u_.push_back(data);
-          if (fin.peek() == '\n') break;
-        }
-      } else if (data_name == "v:") {
-        while (fin >> data) {
-          v_.push_back(data);
-          if (fin.peek() == '\n') break;
-        }
-      } else if (data_name == "w:") {
-        while (fin >> data) {
-          w_.push_back(data);
-          if (fin.peek() == '\n') break;
-        }
-      } else {
-        // If invalid data name, read the rest of the invalid line, 
-        // publish a message and ignore data on next line. Then resume reading.
-        std::string restOfLine;
-        getline(fin, restOfLine);
-        gzerr << " [gazebo_wind_plugin] Invalid data name '" << data_name << restOfLine <<
-              "' in custom wind field text file. Ignoring data on next line.\n";
-        fin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-      }
+  if (WindField::IsBinaryFile(custom_wind_field_path)) {
+    if (wind_field_.LoadBinary(custom_wind_field_path)) {
+      gzdbg << "[gazebo_wind_plugin] Successfully mapped custom wind field from binary file.\n";
+    } else {
+      gzerr << "[gazebo_wind_plugin] Could not map custom wind field binary file.\n";
     }
-    fin.close();
+  } else if (wind_field_.LoadText(custom_wind_field_path)) {
     gzdbg << "[gazebo_wind_plugin] Successfully read custom wind field from text file.\n";
   } else {
-    gzerr << "[gazebo_wind_plugin] Could not open custom wind field text file.\n";
+    gzerr << "[gazebo_wind_plugin] Could not read custom wind field text file.\n";
   }
+}
 
+void GazeboWindPlugin::AddTurbulence(const common::Time& now,
+                                     ignition::math::Vector3d* wind_velocity) {
+  // Frozen turbulence, the air mass carries it past the link.
+  const double dt = turbulence_last_time_ == common::Time::Zero
+                        ? 0.0
+                        : (now - turbulence_last_time_).Double();
+  turbulence_last_time_ = now;
+  const double airspeed =
+      (link_->WorldLinearVel() - *wind_velocity).Length();
+  turbulence_distance_ = std::fmod(
+      turbulence_distance_ + std::max(airspeed, turbulence_min_airspeed_) * dt,
+      turbulence_->period());
+  const WindVelocity turbulence = turbulence_->Sample(turbulence_distance_);
+
+  // u along the horizontal mean wind, w up.
+  ignition::math::Vector3d along(wind_velocity->X(), wind_velocity->Y(), 0.0);
+  if (along.Length() < 1.0e-6) {
+    along.Set(wind_direction_.X(), wind_direction_.Y(), 0.0);
+  }
+  if (along.Length() < 1.0e-6) {
+    along.Set(1.0, 0.0, 0.0);
+  }
+  along.Normalize();
+  const ignition::math::Vector3d lateral(-along.Y(), along.X(), 0.0);
+  *wind_velocity += turbulence.u * along + turbulence.v * lateral +
+                    ignition::math::Vector3d(0.0, 0.0, turbulence.w);
 }
 
-ignition::math::Vector3d GazeboWindPlugin::LinearInterpolation(
-  double position, ignition::math::Vector3d * values, double* points) const {
-  ignition::math::Vector3d value = values[0] + (values[1] - values[0]) /
-                        (points[1] - points[0]) * (position - points[0]);
-  return value;
+bool GazeboWindPlugin::CustomWindFieldVelocity(
+    const WindField& wind_field,
+    const ignition::math::Vector3d& link_position,
+    ignition::math::Vector3d* wind_velocity) const {
+  WindVelocity velocity;
+  if (!wind_field.Interpolate(link_position.X(), link_position.Y(),
+                              link_position.Z(), &velocity)) {
+    return false;
+  }
+  wind_velocity->Set(velocity.u, velocity.v, velocity.w);
+  return true;
 }
 
-ignition::math::Vector3d GazeboWindPlugin::BilinearInterpolation(
-  double* position, ignition::math::Vector3d * values, double* points) const {
-  ignition::math::Vector3d intermediate_values[2] = { LinearInterpolation(
-                                             position[0], &(values[0]), &(points[0])),
-                                           LinearInterpolation(
-                                             position[0], &(values[2]), &(points[2])) };
-  ignition::math::Vector3d value = LinearInterpolation(
-                          position[1], intermediate_values, &(points[4]));
-  return value;
+void GazeboWindPlugin::SaveCheckpoint(CheckpointWriter* writer) {
+  writer->Write(turbulence_distance_);
+  WriteCheckpoint(turbulence_last_time_, writer);
 }
 
-ignition::math::Vector3d GazeboWindPlugin::TrilinearInterpolation(
-  ignition::math::Vector3d link_position, ignition::math::Vector3d * values, double* points) const {
-  double position[3] = {link_position.X(),link_position.Y(),link_position.Z()};
-  ignition::math::Vector3d intermediate_values[4] = { LinearInterpolation(
-                                             position[2], &(values[0]), &(points[0])),
-                                           LinearInterpolation(
-                                             position[2], &(values[2]), &(points[2])),
-                                           LinearInterpolation(
-                                             position[2], &(values[4]), &(points[4])),
-                                           LinearInterpolation(
-                                             position[2], &(values[6]), &(points[6])) };
-  ignition::math::Vector3d value = BilinearInterpolation(
-    &(position[0]), intermediate_values, &(points[8]));
-  return value;
+bool GazeboWindPlugin::RestoreCheckpoint(CheckpointReader* reader) {
+  reader->Read(&turbulence_distance_);
+  ReadCheckpoint(reader, &turbulence_last_time_);
+  return reader->ok();
 }
 
 GZ_REGISTER_MODEL_PLUGIN(GazeboWindPlugin);
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/gazebo_wind_world_plugin.h"
+
+#include "rotors_gazebo_plugins/gazebo_wind_plugin.h"
+
+namespace gazebo {
+
+GazeboWindWorldPlugin::~GazeboWindWorldPlugin() {
+  if (world_) {
+    WindService::Unadvertise(world_);
+  }
+}
+
+void GazeboWindWorldPlugin::Load(physics::WorldPtr _world, sdf::ElementPtr _sdf) {
+  if (kPrintOnPluginLoad) {
+    gzdbg << __FUNCTION__ << "() called." << std::endl;
+  }
+
+  world_ = _world;
+  wind_service_ = std::make_shared<WindService>(world_);
+
+  //==============================================//
+  //========== READ IN PARAMS FROM SDF ===========//
+  //==============================================//
+
+  double wind_speed_mean = kDefaultWindSpeedMean;
+  ignition::math::Vector3d wind_direction = kDefaultWindDirection;
+  getSdfParam<double>(_sdf, "windSpeedMean", wind_speed_mean, wind_speed_mean);
+  getSdfParam<ignition::math::Vector3d >(_sdf, "windDirection", wind_direction,
+                      wind_direction);
+  wind_direction.Normalize();
+  wind_service_->SetDefaultWindVelocity(wind_speed_mean * wind_direction);
+
+  std::string custom_wind_field_path;
+  int frame_count = kDefaultCustomWindFieldFrameCount;
+  double frame_period = kDefaultCustomWindFieldFramePeriod;
+  getSdfParam<std::string>(_sdf, "customWindFieldPath", custom_wind_field_path,
+                           custom_wind_field_path);
+  getSdfParam<int>(_sdf, "customWindFieldFrameCount", frame_count, frame_count);
+  getSdfParam<double>(_sdf, "customWindFieldFramePeriod", frame_period,
+                      frame_period);
+  if (!custom_wind_field_path.empty()) {
+    if (wind_service_->LoadWindField(custom_wind_field_path, frame_count,
+                                     frame_period)) {
+      gzdbg << "[gazebo_wind_world_plugin] Successfully loaded custom wind field.\n";
+    } else {
+      gzerr << "[gazebo_wind_world_plugin] Could not load custom wind field '"
+            << custom_wind_field_path << "'.\n";
+    }
+  }
+
+  WindService::Advertise(wind_service_);
+
+  // Listen to the update event. This event is broadcast every
+  // simulation iteration.
+  update_connection_ = event::Events::ConnectWorldUpdateBegin(
+      boost::bind(&GazeboWindWorldPlugin::OnUpdate, this, _1));
+}
+
+void GazeboWindWorldPlugin::OnUpdate(const common::UpdateInfo& _info) {
+  ROTORS_PROFILE_SCOPE("gazebo_wind_world_plugin");
+
+  // Evaluate the wind of all registered links in one pass. If a model plugin is
+  // updated before this plugin, the pass has already run during this step.
+  wind_service_->Update();
+}
+
+GZ_REGISTER_WORLD_PLUGIN(GazeboWindWorldPlugin);
+
+}  // namespace gazebo
@@ -0,0 +1,400 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/geo_magnetic_grid.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace gazebo {
+
+namespace {
+
+constexpr double kDegToRad = M_PI / 180.0;
+constexpr double kNanoTeslaToTesla = 1e-9;
+
+/// \brief  Sorted, unique values, within a tolerance of a fraction of the
+///         smallest spacing.
+std::vector<double> UniqueValues(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  std::vector<double> unique;
+  for (double value : values) {
+    if (unique.empty() || value - unique.back() > 1e-6) {
+      unique.push_back(value);
+    }
+  }
+  return unique;
+}
+
+/// \brief  Returns the spacing of uniformly spaced values, or 0.
+double UniformSpacing(const std::vector<double>& values) {
+  if (values.size() < 2) {
+    return 0.0;
+  }
+  const double spacing = (values.back() - values.front()) / (values.size() - 1);
+  for (std::size_t i = 1; i < values.size(); ++i) {
+    if (std::abs(values[i] - values[i - 1] - spacing) > 1e-3 * spacing) {
+      return 0.0;
+    }
+  }
+  return spacing;
+}
+
+/// \brief  Wraps an angle [deg] into [-180, 180).
+double WrapDegrees(double angle) {
+  angle = std::fmod(angle + 180.0, 360.0);
+  return (angle < 0.0 ? angle + 360.0 : angle) - 180.0;
+}
+
+GeoMagneticGridVertex Lerp(const GeoMagneticGridVertex& a,
+                           const GeoMagneticGridVertex& b, double t) {
+  GeoMagneticGridVertex result;
+  // The declination is an angle, interpolate along the shorter way around so
+  // that e.g. 179 and -179 deg do not average to 0 deg.
+  result.declination = WrapDegrees(
+      a.declination + t * WrapDegrees(b.declination - a.declination));
+  result.inclination = a.inclination + t * (b.inclination - a.inclination);
+  result.intensity = a.intensity + t * (b.intensity - a.intensity);
+  return result;
+}
+
+}  // namespace
+
+void GeoMagneticField::ToNED(double* north, double* east, double* down) const {
+  const double horizontal = intensity * cos(inclination);
+  *north = horizontal * cos(declination);
+  *east = horizontal * sin(declination);
+  *down = intensity * sin(inclination);
+}
+
+bool GeoMagneticGridData::ReadTextFile(const std::string& path) {
+  std::ifstream fin(path);
+  if (!fin.is_open()) {
+    return false;
+  }
+
+  std::vector<double> lats;
+  std::vector<double> lons;
+  std::vector<GeoMagneticGridVertex> values;
+  std::string line;
+  while (std::getline(fin, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::replace(line.begin(), line.end(), ',', ' ');
+    std::istringstream iss(line);
+    double lat, lon;
+    GeoMagneticGridVertex vertex;
+    // Other lines, e.g. a CSV header, do not parse and are skipped.
+    if (!(iss >> lat >> lon >> vertex.declination >> vertex.inclination >>
+          vertex.intensity)) {
+      continue;
+    }
+    lats.push_back(lat);
+    lons.push_back(lon);
+    values.push_back(vertex);
+  }
+
+  const std::vector<double> unique_lats = UniqueValues(lats);
+  const std::vector<double> unique_lons = UniqueValues(lons);
+  const double res_lat_deg = UniformSpacing(unique_lats);
+  const double res_lon_deg = UniformSpacing(unique_lons);
+  if (res_lat_deg <= 0.0 || res_lon_deg <= 0.0 ||
+      values.size() != unique_lats.size() * unique_lons.size()) {
+    return false;
+  }
+
+  min_lat = unique_lats.front();
+  min_lon = unique_lons.front();
+  res_lat = res_lat_deg;
+  res_lon = res_lon_deg;
+  n_lat = unique_lats.size();
+  n_lon = unique_lons.size();
+  vertices.assign(values.size(), GeoMagneticGridVertex());
+
+  std::vector<bool> filled(values.size(), false);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    const std::size_t lat_index = std::lround((lats[i] - min_lat) / res_lat);
+    const std::size_t lon_index = std::lround((lons[i] - min_lon) / res_lon);
+    const std::size_t index = lon_index + lat_index * n_lon;
+    if (filled[index]) {
+      return false;
+    }
+    filled[index] = true;
+    vertices[index] = values[i];
+  }
+  return true;
+}
+
+GeoMagneticGrid::GeoMagneticGrid()
+    : n_lat_(0),
+      n_lon_(0),
+      min_lat_(0.0),
+      min_lon_(0.0),
+      res_lat_(0.0),
+      res_lon_(0.0),
+      wraps_(false),
+      mapped_data_(nullptr),
+      mapped_size_(0),
+      vertices_(nullptr) {}
+
+GeoMagneticGrid::~GeoMagneticGrid() {
+  Clear();
+}
+
+void GeoMagneticGrid::Clear() {
+  if (mapped_data_ != nullptr) {
+    munmap(mapped_data_, mapped_size_);
+    mapped_data_ = nullptr;
+    mapped_size_ = 0;
+  }
+  data_ = GeoMagneticGridData();
+  vertices_ = nullptr;
+  n_lat_ = 0;
+  n_lon_ = 0;
+}
+
+bool GeoMagneticGrid::IsBinaryFile(const std::string& path) {
+  std::ifstream fin(path, std::ios::binary);
+  char magic[sizeof(kGeoMagneticGridFileMagic)];
+  if (!fin.read(magic, sizeof(magic))) {
+    return false;
+  }
+  return std::memcmp(magic, kGeoMagneticGridFileMagic, sizeof(magic)) == 0;
+}
+
+bool GeoMagneticGrid::Load(const std::string& path) {
+  if (IsBinaryFile(path)) {
+    return LoadBinary(path);
+  }
+
+  Clear();
+  if (!data_.ReadTextFile(path)) {
+    data_ = GeoMagneticGridData();
+    return false;
+  }
+  n_lat_ = data_.n_lat;
+  n_lon_ = data_.n_lon;
+  min_lat_ = data_.min_lat;
+  min_lon_ = data_.min_lon;
+  res_lat_ = data_.res_lat;
+  res_lon_ = data_.res_lon;
+  wraps_ = n_lon_ * res_lon_ >= 360.0 - 1e-3;
+  vertices_ = data_.vertices.data();
+  return true;
+}
+
+bool GeoMagneticGrid::LoadBinary(const std::string& path) {
+  Clear();
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 ||
+      static_cast<std::size_t>(file_stat.st_size) <
+          sizeof(GeoMagneticGridFileHeader)) {
+    close(fd);
+    return false;
+  }
+  mapped_size_ = file_stat.st_size;
+  mapped_data_ = mmap(nullptr, mapped_size_, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping stays valid after the file descriptor is closed.
+  close(fd);
+  if (mapped_data_ == MAP_FAILED) {
+    mapped_data_ = nullptr;
+    mapped_size_ = 0;
+    return false;
+  }
+  // Only the cells around the vehicles are read.
+  madvise(mapped_data_, mapped_size_, MADV_RANDOM);
+
+  const char* base = static_cast<const char*>(mapped_data_);
+  GeoMagneticGridFileHeader header;
+  std::memcpy(&header, base, sizeof(header));
+  const uint64_t n_vertices = static_cast<uint64_t>(header.n_lat) * header.n_lon;
+  if (std::memcmp(header.magic, kGeoMagneticGridFileMagic,
+                  sizeof(header.magic)) != 0 ||
+      header.version != kGeoMagneticGridFileVersion || header.n_lat < 2 ||
+      header.n_lon < 2 || header.res_lat <= 0.0f || header.res_lon <= 0.0f ||
+      header.vertices_offset + n_vertices * sizeof(GeoMagneticGridVertex) >
+          mapped_size_) {
+    Clear();
+    return false;
+  }
+
+  n_lat_ = header.n_lat;
+  n_lon_ = header.n_lon;
+  min_lat_ = header.min_lat;
+  min_lon_ = header.min_lon;
+  res_lat_ = header.res_lat;
+  res_lon_ = header.res_lon;
+  wraps_ = n_lon_ * res_lon_ >= 360.0 - 1e-3;
+  vertices_ = reinterpret_cast<const GeoMagneticGridVertex*>(
+      base + header.vertices_offset);
+  return true;
+}
+
+bool GeoMagneticGrid::WriteBinary(const GeoMagneticGridData& data,
+                                  const std::string& path) {
+  if (data.n_lat < 2 || data.n_lon < 2 ||
+      data.vertices.size() != static_cast<std::size_t>(data.n_lat) * data.n_lon) {
+    return false;
+  }
+
+  GeoMagneticGridFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kGeoMagneticGridFileMagic, sizeof(header.magic));
+  header.version = kGeoMagneticGridFileVersion;
+  header.n_lat = data.n_lat;
+  header.n_lon = data.n_lon;
+  header.min_lat = data.min_lat;
+  header.min_lon = data.min_lon;
+  header.res_lat = data.res_lat;
+  header.res_lon = data.res_lon;
+  header.vertices_offset = sizeof(header);
+
+  std::ofstream fout(path, std::ios::binary | std::ios::trunc);
+  if (!fout.is_open()) {
+    return false;
+  }
+  fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  fout.write(reinterpret_cast<const char*>(data.vertices.data()),
+             data.vertices.size() * sizeof(GeoMagneticGridVertex));
+  return static_cast<bool>(fout);
+}
+
+double GeoMagneticGrid::WrapLongitude(double lon) const {
+  if (!wraps_) {
+    return lon;
+  }
+  lon = std::fmod(lon - min_lon_, 360.0);
+  if (lon < 0.0) {
+    lon += 360.0;
+  }
+  return min_lon_ + lon;
+}
+
+bool GeoMagneticGrid::FindCell(double lat, double lon, Cell* cell) const {
+  cell->valid = false;
+  if (empty()) {
+    return false;
+  }
+
+  const double lat_offset = (lat - min_lat_) / res_lat_;
+  if (lat_offset < 0.0 || lat_offset > n_lat_ - 1) {
+    return false;
+  }
+  const std::size_t lat0 = std::min<std::size_t>(lat_offset, n_lat_ - 2);
+
+  const double lon_offset = (WrapLongitude(lon) - min_lon_) / res_lon_;
+  std::size_t lon0;
+  std::size_t lon1;
+  if (wraps_) {
+    lon0 = static_cast<std::size_t>(lon_offset) % n_lon_;
+    lon1 = (lon0 + 1) % n_lon_;
+  } else {
+    if (lon_offset < 0.0 || lon_offset > n_lon_ - 1) {
+      return false;
+    }
+    lon0 = std::min<std::size_t>(lon_offset, n_lon_ - 2);
+    lon1 = lon0 + 1;
+  }
+
+  cell->res_lat = res_lat_;
+  cell->res_lon = res_lon_;
+  cell->lat0 = min_lat_ + lat0 * res_lat_;
+  // In the unwrapped longitude of the query, so that Contains() holds.
+  cell->lon0 = lon + (min_lon_ + lon0 * res_lon_ - WrapLongitude(lon));
+  cell->sw = vertex(lat0, lon0);
+  cell->se = vertex(lat0, lon1);
+  cell->nw = vertex(lat0 + 1, lon0);
+  cell->ne = vertex(lat0 + 1, lon1);
+  const GeoMagneticGridVertex* corners[4] = {&cell->sw, &cell->se, &cell->nw,
+                                             &cell->ne};
+  for (int i = 0; i < 4; ++i) {
+    GeoMagneticField field;
+    field.declination = corners[i]->declination * kDegToRad;
+    field.inclination = corners[i]->inclination * kDegToRad;
+    field.intensity = corners[i]->intensity * kNanoTeslaToTesla;
+    field.ToNED(&cell->ned[i][0], &cell->ned[i][1], &cell->ned[i][2]);
+  }
+  cell->valid = true;
+  return true;
+}
+
+bool GeoMagneticGrid::Interpolate(double lat_rad, double lon_rad,
+                                  GeoMagneticField* field) const {
+  Cell cell;
+  return Interpolate(lat_rad, lon_rad, &cell, field);
+}
+
+bool GeoMagneticGrid::Interpolate(double lat_rad, double lon_rad, Cell* cell,
+                                  GeoMagneticField* field) const {
+  const double lat = lat_rad / kDegToRad;
+  const double lon = lon_rad / kDegToRad;
+  if (!cell->Contains(lat, lon) && !FindCell(lat, lon, cell)) {
+    return false;
+  }
+
+  // Bilinear interpolation of all three values with the same weights.
+  const double t_lon = (lon - cell->lon0) / cell->res_lon;
+  const double t_lat = (lat - cell->lat0) / cell->res_lat;
+  const GeoMagneticGridVertex value = Lerp(Lerp(cell->sw, cell->se, t_lon),
+                                           Lerp(cell->nw, cell->ne, t_lon),
+                                           t_lat);
+  field->declination = value.declination * kDegToRad;
+  field->inclination = value.inclination * kDegToRad;
+  field->intensity = value.intensity * kNanoTeslaToTesla;
+  return true;
+}
+
+bool GeoMagneticGrid::InterpolateNED(double lat_rad, double lon_rad,
+                                     Cell* cell, double* north, double* east,
+                                     double* down) const {
+  const double lat = lat_rad / kDegToRad;
+  const double lon = lon_rad / kDegToRad;
+  if (!cell->Contains(lat, lon) && !FindCell(lat, lon, cell)) {
+    return false;
+  }
+
+  const double t_lon = (lon - cell->lon0) / cell->res_lon;
+  const double t_lat = (lat - cell->lat0) / cell->res_lat;
+  const double w_sw = (1.0 - t_lon) * (1.0 - t_lat);
+  const double w_se = t_lon * (1.0 - t_lat);
+  const double w_nw = (1.0 - t_lon) * t_lat;
+  const double w_ne = t_lon * t_lat;
+  double* components[3] = {north, east, down};
+  for (int i = 0; i < 3; ++i) {
+    *components[i] = w_sw * cell->ned[0][i] + w_se * cell->ned[1][i] +
+                     w_nw * cell->ned[2][i] + w_ne * cell->ned[3][i];
+  }
+  return true;
+}
+
+}  // namespace gazebo
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Converts a geomagnetic grid text file, e.g. the grid output of the NOAA
+// World Magnetic Model calculator, into the binary format that
+// GeoMagneticGrid maps into memory.
+//
+// Usage: geo_magnetic_grid_converter <input.txt> <output.bin>
+
+#include <cstdlib>
+#include <iostream>
+
+#include "rotors_gazebo_plugins/geo_magnetic_grid.h"
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <input.txt> <output.bin>\n";
+    return EXIT_FAILURE;
+  }
+
+  gazebo::GeoMagneticGridData data;
+  if (!data.ReadTextFile(argv[1])) {
+    std::cerr << "Could not read a regular geomagnetic grid from '" << argv[1]
+              << "'.\n";
+    return EXIT_FAILURE;
+  }
+
+  if (!gazebo::GeoMagneticGrid::WriteBinary(data, argv[2])) {
+    std::cerr << "Could not write binary geomagnetic grid to '" << argv[2]
+              << "'.\n";
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Converted geomagnetic grid with " << data.n_lat << " x "
+            << data.n_lon << " vertices at " << data.res_lat << " x "
+            << data.res_lon << " deg.\n";
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/lee_motor_controller.h"
+
+LeeMotorController::LeeMotorController(
+    const rotors_control::VehicleParameters& vehicle_parameters,
+    const rotors_control::LeePositionControllerParameters& controller_parameters)
+    : MotorController(vehicle_parameters.rotor_configuration_.rotors.size()) {
+  // VehicleParameters is not assignable, its gravity is constant.
+  lee_position_controller_.vehicle_parameters_.mass_ = vehicle_parameters.mass_;
+  lee_position_controller_.vehicle_parameters_.inertia_ = vehicle_parameters.inertia_;
+  lee_position_controller_.vehicle_parameters_.rotor_configuration_ =
+      vehicle_parameters.rotor_configuration_;
+  lee_position_controller_.controller_parameters_ = controller_parameters;
+  initializeParams();
+}
+
+void LeeMotorController::initializeParams() {
+  lee_position_controller_.InitializeParameters();
+  ref_rotor_rot_vels_.setZero(
+      lee_position_controller_.vehicle_parameters_.rotor_configuration_.rotors.size());
+}
+
+void LeeMotorController::calculateRefMotorVelocities(double dt) {
+  odometry_.position = position_;
+  odometry_.orientation = attitude_;
+  // The controller expects the velocity in body frame, like the odometry
+  // message published by the odometry plugin.
+  odometry_.velocity = attitude_.inverse() * velocity_;
+  odometry_.angular_velocity = angular_rate_;
+  lee_position_controller_.SetOdometry(odometry_);
+  lee_position_controller_.CalculateRotorVelocities(&ref_rotor_rot_vels_);
+}
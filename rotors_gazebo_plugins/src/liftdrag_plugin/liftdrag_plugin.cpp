@@ -24,6 +24,7 @@
 #include "gazebo/transport/transport.hh"
 #include "gazebo/msgs/msgs.hh"
 #include "liftdrag_plugin/liftdrag_plugin.h"
+#include "rotors_gazebo_plugins/profiling.h"
 
 using namespace gazebo;
 
@@ -160,6 +161,7 @@ void LiftDragPlugin::Load(physics::ModelPtr _model,
 /////////////////////////////////////////////////
 void LiftDragPlugin::OnUpdate()
 {
+  ROTORS_PROFILE_SCOPE("liftdrag_plugin");
   GZ_ASSERT(this->link, "Link was NULL");
   // get linear velocity at cp in inertial frame
   ignition::math::Vector3d vel = this->link->WorldLinearVel(this->cp);
@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2014-2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <string>
+
+#include "gazebo/common/Assert.hh"
+#include "gazebo/physics/physics.hh"
+#include "liftdrag_plugin/multi_liftdrag_plugin.h"
+#include "rotors_gazebo_plugins/profiling.h"
+
+using namespace gazebo;
+
+GZ_REGISTER_MODEL_PLUGIN(MultiLiftDragPlugin)
+
+/////////////////////////////////////////////////
+MultiLiftDragPlugin::MultiLiftDragPlugin() : rho(1.2041)
+{
+}
+
+/////////////////////////////////////////////////
+MultiLiftDragPlugin::~MultiLiftDragPlugin()
+{
+}
+
+/////////////////////////////////////////////////
+void MultiLiftDragPlugin::Load(physics::ModelPtr _model,
+                     sdf::ElementPtr _sdf)
+{
+  GZ_ASSERT(_model, "MultiLiftDragPlugin _model pointer is NULL");
+  GZ_ASSERT(_sdf, "MultiLiftDragPlugin _sdf pointer is NULL");
+  this->model = _model;
+
+  if (_sdf->HasElement("air_density"))
+    this->rho = _sdf->Get<double>("air_density");
+
+  if (!_sdf->HasElement("surface"))
+  {
+    gzerr << "MultiLiftDragPlugin has no <surface> elements and will not "
+      << "generate forces\n";
+    return;
+  }
+
+  for (sdf::ElementPtr elem = _sdf->GetElement("surface"); elem;
+       elem = elem->GetNextElement("surface"))
+  {
+    Surface surface;
+    std::string linkName;
+    if (!this->LoadSurface(elem, surface, linkName))
+      continue;
+
+    physics::LinkPtr link = this->model->GetLink(linkName);
+    if (!link)
+    {
+      gzerr << "Link with name[" << linkName << "] not found. "
+        << "The surface will not generate forces\n";
+      continue;
+    }
+
+    auto group = std::find_if(this->links.begin(), this->links.end(),
+        [&link](const LinkSurfaces &_group) { return _group.link == link; });
+    if (group == this->links.end())
+    {
+      this->links.push_back(LinkSurfaces());
+      group = this->links.end() - 1;
+      group->link = link;
+      group->cog = link->GetInertial()->CoG();
+    }
+
+    surface.cpArm = surface.cp - group->cog;
+    group->surfaces.push_back(surface);
+  }
+
+  if (!this->links.empty())
+  {
+    this->updateConnection = event::Events::ConnectWorldUpdateBegin(
+        boost::bind(&MultiLiftDragPlugin::OnUpdate, this));
+  }
+}
+
+/////////////////////////////////////////////////
+bool MultiLiftDragPlugin::LoadSurface(sdf::ElementPtr _sdf,
+    Surface &_surface, std::string &_linkName)
+{
+  // Same defaults as LiftDragPlugin.
+  _surface.cla = 1.0;
+  _surface.cda = 0.01;
+  _surface.alphaStall = 0.5*M_PI;
+  _surface.claStall = 0.0;
+  _surface.cdaStall = 1.0;
+  _surface.alpha0 = 0.0;
+  _surface.area = 1.0;
+  _surface.radialSymmetry = false;
+  _surface.cp = ignition::math::Vector3d(0, 0, 0);
+  _surface.forward = ignition::math::Vector3d(1, 0, 0);
+  _surface.upward = ignition::math::Vector3d(0, 0, 1);
+  _surface.controlJointRadToCL = 4.0;
+
+  if (!_sdf->HasElement("link_name"))
+  {
+    gzerr << "MultiLiftDragPlugin surface without link_name.\n";
+    return false;
+  }
+  _linkName = _sdf->Get<std::string>("link_name");
+
+  if (_sdf->HasElement("radial_symmetry"))
+    _surface.radialSymmetry = _sdf->Get<bool>("radial_symmetry");
+
+  if (_sdf->HasElement("a0"))
+    _surface.alpha0 = _sdf->Get<double>("a0");
+
+  if (_sdf->HasElement("cla"))
+    _surface.cla = _sdf->Get<double>("cla");
+
+  if (_sdf->HasElement("cda"))
+    _surface.cda = _sdf->Get<double>("cda");
+
+  if (_sdf->HasElement("alpha_stall"))
+    _surface.alphaStall = _sdf->Get<double>("alpha_stall");
+
+  if (_sdf->HasElement("cla_stall"))
+    _surface.claStall = _sdf->Get<double>("cla_stall");
+
+  if (_sdf->HasElement("cda_stall"))
+    _surface.cdaStall = _sdf->Get<double>("cda_stall");
+
+  if (_sdf->HasElement("cp"))
+    _surface.cp = _sdf->Get<ignition::math::Vector3d>("cp");
+
+  if (_sdf->HasElement("forward"))
+    _surface.forward = _sdf->Get<ignition::math::Vector3d>("forward");
+  _surface.forward.Normalize();
+
+  if (_sdf->HasElement("upward"))
+    _surface.upward = _sdf->Get<ignition::math::Vector3d>("upward");
+  _surface.upward.Normalize();
+
+  // Constant in the link frame unless the upward direction follows the
+  // inflow.
+  _surface.spanwise = _surface.forward.Cross(_surface.upward).Normalize();
+
+  if (_sdf->HasElement("area"))
+    _surface.area = _sdf->Get<double>("area");
+
+  if (_sdf->HasElement("control_joint_name"))
+  {
+    std::string controlJointName = _sdf->Get<std::string>("control_joint_name");
+    _surface.controlJoint = this->model->GetJoint(controlJointName);
+    if (!_surface.controlJoint)
+    {
+      gzerr << "Joint with name[" << controlJointName << "] does not exist.\n";
+    }
+  }
+
+  if (_sdf->HasElement("control_joint_rad_to_cl"))
+    _surface.controlJointRadToCL = _sdf->Get<double>("control_joint_rad_to_cl");
+
+  return true;
+}
+
+/////////////////////////////////////////////////
+void MultiLiftDragPlugin::OnUpdate()
+{
+  ROTORS_PROFILE_SCOPE("multi_liftdrag_plugin");
+  for (const LinkSurfaces &group : this->links)
+  {
+    // The only per-link queries, everything else is in link coordinates.
+    const ignition::math::Quaterniond rot = group.link->WorldPose().Rot();
+    const ignition::math::Vector3d linVel =
+        rot.RotateVectorReverse(group.link->WorldCoGLinearVel());
+    const ignition::math::Vector3d angVel = group.link->RelativeAngularVel();
+
+    ignition::math::Vector3d force(0, 0, 0);
+    ignition::math::Vector3d torque(0, 0, 0);
+    bool hasForce = false;
+    for (const Surface &surface : group.surfaces)
+    {
+      // velocity at cp
+      const ignition::math::Vector3d vel =
+          linVel + angVel.Cross(surface.cpArm);
+      ignition::math::Vector3d surfaceForce;
+      if (!this->SurfaceForce(surface, vel, surfaceForce))
+        continue;
+
+      // Correct for nan or inf
+      surfaceForce.Correct();
+      force += surfaceForce;
+      torque += surface.cpArm.Cross(surfaceForce);
+      hasForce = true;
+    }
+
+    // apply the forces of all surfaces at cg
+    if (hasForce)
+    {
+      group.link->AddRelativeForce(force);
+      group.link->AddRelativeTorque(torque);
+    }
+  }
+}
+
+/////////////////////////////////////////////////
+bool MultiLiftDragPlugin::SurfaceForce(const Surface &_surface,
+    const ignition::math::Vector3d &_vel,
+    ignition::math::Vector3d &_force) const
+{
+  if (_vel.Length() <= 0.01)
+    return false;
+
+  ignition::math::Vector3d velI = _vel;
+  velI.Normalize();
+
+  ignition::math::Vector3d upward = _surface.upward;
+  ignition::math::Vector3d spanwise = _surface.spanwise;
+  if (_surface.radialSymmetry)
+  {
+    // use inflow velocity to determine upward direction
+    // which is the component of inflow perpendicular to forward direction.
+    ignition::math::Vector3d tmp = _surface.forward.Cross(velI);
+    upward = _surface.forward.Cross(tmp).Normalize();
+    spanwise = _surface.forward.Cross(upward).Normalize();
+  }
+
+  const double minRatio = -1.0;
+  const double maxRatio = 1.0;
+  // check sweep (angle between velI and lift-drag-plane)
+  double sinSweepAngle = ignition::math::clamp(
+      spanwise.Dot(velI), minRatio, maxRatio);
+
+  // get cos from trig identity
+  double cosSweepAngle = 1.0 - sinSweepAngle * sinSweepAngle;
+
+  // removing spanwise velocity from vel
+  ignition::math::Vector3d velInLDPlane = _vel - _vel.Dot(spanwise)*velI;
+
+  // get direction of drag
+  ignition::math::Vector3d dragDirection = -velInLDPlane;
+  dragDirection.Normalize();
+
+  // get direction of lift
+  ignition::math::Vector3d liftI = spanwise.Cross(velInLDPlane);
+  liftI.Normalize();
+
+  // compute angle between upward and liftI
+  double cosAlpha = ignition::math::clamp(liftI.Dot(upward), minRatio,
+      maxRatio);
+
+  // if forward is in the same direction as lift, alpha is positive.
+  double alpha;
+  if (liftI.Dot(_surface.forward) >= 0.0)
+    alpha = _surface.alpha0 + acos(cosAlpha);
+  else
+    alpha = _surface.alpha0 - acos(cosAlpha);
+
+  // normalize to within +/-90 deg
+  while (fabs(alpha) > 0.5 * M_PI)
+    alpha = alpha > 0 ? alpha - M_PI : alpha + M_PI;
+
+  // compute dynamic pressure
+  double speedInLDPlane = velInLDPlane.Length();
+  double q = 0.5 * this->rho * speedInLDPlane * speedInLDPlane;
+
+  // compute cl and cd at cp, check for stall, correct for sweep
+  double cl;
+  double cd;
+  if (alpha > _surface.alphaStall)
+  {
+    cl = (_surface.cla * _surface.alphaStall +
+          _surface.claStall * (alpha - _surface.alphaStall))
+         * cosSweepAngle;
+    // make sure cl is still great than 0
+    cl = std::max(0.0, cl);
+    cd = (_surface.cda * _surface.alphaStall +
+          _surface.cdaStall * (alpha - _surface.alphaStall))
+         * cosSweepAngle;
+  }
+  else if (alpha < -_surface.alphaStall)
+  {
+    cl = (-_surface.cla * _surface.alphaStall +
+          _surface.claStall * (alpha + _surface.alphaStall))
+         * cosSweepAngle;
+    // make sure cl is still less than 0
+    cl = std::min(0.0, cl);
+    cd = (-_surface.cda * _surface.alphaStall +
+          _surface.cdaStall * (alpha + _surface.alphaStall))
+         * cosSweepAngle;
+  }
+  else
+  {
+    cl = _surface.cla * alpha * cosSweepAngle;
+    cd = _surface.cda * alpha * cosSweepAngle;
+  }
+
+  // modify cl per control joint value
+  if (_surface.controlJoint)
+  {
+    cl = cl + _surface.controlJointRadToCL *
+        _surface.controlJoint->Position(0);
+  }
+
+  // make sure drag is positive
+  cd = fabs(cd);
+
+  // lift + drag at cp, the moment is zero as in LiftDragPlugin
+  _force = (cl * liftI + cd * dragDirection) * (q * _surface.area);
+  return true;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/local_tangent_plane.h"
+
+#include <cmath>
+
+namespace gazebo {
+
+namespace {
+
+// Step of the finite differences of the Jacobian [m].
+constexpr double kJacobianStep = 1.0;
+
+}  // namespace
+
+LocalTangentPlane::LocalTangentPlane(double ref_lat_rad, double ref_lon_rad,
+                                     double earth_radius,
+                                     double relinearization_distance)
+    : ref_lat_rad_(ref_lat_rad),
+      ref_lon_rad_(ref_lon_rad),
+      sin_ref_lat_(sin(ref_lat_rad)),
+      cos_ref_lat_(cos(ref_lat_rad)),
+      inv_earth_radius_(1.0 / earth_radius),
+      relinearization_distance_sq_(relinearization_distance *
+                                   relinearization_distance),
+      linearized_(false),
+      lin_north_(0.0),
+      lin_east_(0.0),
+      lin_lat_(ref_lat_rad),
+      lin_lon_(ref_lon_rad),
+      dlat_dnorth_(0.0),
+      dlat_deast_(0.0),
+      dlon_dnorth_(0.0),
+      dlon_deast_(0.0) {}
+
+void LocalTangentPlane::ToGeodeticExact(double north, double east,
+                                        double* lat_rad,
+                                        double* lon_rad) const {
+  const double x_rad = north * inv_earth_radius_;
+  const double y_rad = east * inv_earth_radius_;
+  const double c = sqrt(x_rad * x_rad + y_rad * y_rad);
+  if (c == 0.0) {
+    *lat_rad = ref_lat_rad_;
+    *lon_rad = ref_lon_rad_;
+    return;
+  }
+  const double sin_c = sin(c);
+  const double cos_c = cos(c);
+  *lat_rad = asin(cos_c * sin_ref_lat_ + (x_rad * sin_c * cos_ref_lat_) / c);
+  *lon_rad = ref_lon_rad_ + atan2(y_rad * sin_c,
+                                  c * cos_ref_lat_ * cos_c -
+                                      x_rad * sin_ref_lat_ * sin_c);
+}
+
+void LocalTangentPlane::Linearize(double north, double east) {
+  ToGeodeticExact(north, east, &lin_lat_, &lin_lon_);
+  double lat, lon;
+  ToGeodeticExact(north + kJacobianStep, east, &lat, &lon);
+  dlat_dnorth_ = (lat - lin_lat_) / kJacobianStep;
+  dlon_dnorth_ = (lon - lin_lon_) / kJacobianStep;
+  ToGeodeticExact(north, east + kJacobianStep, &lat, &lon);
+  dlat_deast_ = (lat - lin_lat_) / kJacobianStep;
+  dlon_deast_ = (lon - lin_lon_) / kJacobianStep;
+  lin_north_ = north;
+  lin_east_ = east;
+  linearized_ = true;
+}
+
+void LocalTangentPlane::ToGeodetic(double north, double east, double* lat_rad,
+                                   double* lon_rad) {
+  double d_north = north - lin_north_;
+  double d_east = east - lin_east_;
+  if (!linearized_ ||
+      d_north * d_north + d_east * d_east > relinearization_distance_sq_) {
+    Linearize(north, east);
+    d_north = 0.0;
+    d_east = 0.0;
+  }
+  *lat_rad = lin_lat_ + dlat_dnorth_ * d_north + dlat_deast_ * d_east;
+  *lon_rad = lin_lon_ + dlon_dnorth_ * d_north + dlon_deast_ * d_east;
+}
+
+}  // namespace gazebo
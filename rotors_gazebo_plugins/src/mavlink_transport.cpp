@@ -0,0 +1,343 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "rotors_gazebo_plugins/mavlink_transport.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+#include <gazebo/common/Console.hh>
+
+#include "rotors_gazebo_plugins/profiling.h"
+
+namespace gazebo {
+
+namespace {
+
+std::mutex& SharedTransportMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::weak_ptr<MavlinkTransport>& SharedTransport() {
+  static std::weak_ptr<MavlinkTransport> transport;
+  return transport;
+}
+
+/// \brief The MAVLink parser keeps its state per channel in static storage,
+///        all I/O threads share channel 0 under this mutex.
+std::mutex& ParserMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+}  // namespace
+
+MavlinkTransport::MavlinkTransport(bool batched)
+    : batched_(batched),
+      fd_(-1),
+      io_thread_running_(false),
+      receive_buffer_(65535),
+      dropped_unknown_system_(0),
+      reported_dropped_(0) {
+#ifndef ROTORS_MAVLINK_HAVE_MMSG
+  if (batched_) {
+    gzwarn << "[mavlink_transport] sendmmsg() and recvmmsg() are not available "
+              "on this platform, sending and receiving one datagram at a time.\n";
+    batched_ = false;
+  }
+#endif
+}
+
+MavlinkTransport::~MavlinkTransport() {
+  io_thread_running_ = false;
+  if (io_thread_.joinable()) {
+    io_thread_.join();
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+std::shared_ptr<MavlinkTransport> MavlinkTransport::GetShared(bool batched) {
+  std::lock_guard<std::mutex> lock(SharedTransportMutex());
+  std::shared_ptr<MavlinkTransport> transport = SharedTransport().lock();
+  if (!transport) {
+    transport = std::make_shared<MavlinkTransport>(batched);
+    SharedTransport() = transport;
+  } else if (transport->batched() != batched) {
+    gzwarn << "[mavlink_transport] The shared MAVLink socket is "
+           << (transport->batched() ? "" : "not ") << "batched, as requested by "
+           << "the first vehicle that uses it.\n";
+  }
+  return transport;
+}
+
+bool MavlinkTransport::Open() {
+  if (io_thread_running_) {
+    return true;
+  }
+
+  // try to setup udp socket for communcation with simulator
+  if ((fd_ = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+    gzerr << "[mavlink_transport] create socket failed\n";
+    return false;
+  }
+
+  struct sockaddr_in myaddr;
+  memset((char *)&myaddr, 0, sizeof(myaddr));
+  myaddr.sin_family = AF_INET;
+  myaddr.sin_addr.s_addr = htonl(INADDR_ANY);
+  // Let the OS pick the port
+  myaddr.sin_port = htons(0);
+
+  if (bind(fd_, (struct sockaddr *)&myaddr, sizeof(myaddr)) < 0) {
+    gzerr << "[mavlink_transport] bind failed\n";
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
+
+  fds_[0].fd = fd_;
+  fds_[0].events = POLLIN;
+
+#ifdef ROTORS_MAVLINK_HAVE_MMSG
+  if (batched_) {
+    receive_buffer_.resize(kMavlinkReceiveBatchSize * kMavlinkReceiveBufferSize);
+    receive_headers_.resize(kMavlinkReceiveBatchSize);
+    receive_iovecs_.resize(kMavlinkReceiveBatchSize);
+    receive_addresses_.resize(kMavlinkReceiveBatchSize);
+  }
+#endif
+
+  io_thread_running_ = true;
+  io_thread_ = std::thread(&MavlinkTransport::IoThread, this);
+  return true;
+}
+
+bool MavlinkTransport::AddEndpoint(const std::shared_ptr<MavlinkEndpoint>& endpoint) {
+  std::lock_guard<std::mutex> lock(endpoints_mutex_);
+  // The incoming messages of a shared socket are dispatched by system ID, so
+  // vehicles with the same ID would receive each other's messages.
+  const bool unique = std::none_of(
+      endpoints_.begin(), endpoints_.end(),
+      [&endpoint](const std::shared_ptr<MavlinkEndpoint>& other) {
+        return other->system_id == endpoint->system_id;
+      });
+  if (!unique) {
+    gzwarn << "[mavlink_transport] More than one vehicle with MAVLink system "
+           << "ID " << static_cast<int>(endpoint->system_id)
+           << " on the shared socket, only the first one receives messages.\n";
+  }
+  endpoints_.push_back(endpoint);
+  return unique;
+}
+
+void MavlinkTransport::RemoveEndpoint(
+    const std::shared_ptr<MavlinkEndpoint>& endpoint) {
+  std::lock_guard<std::mutex> lock(endpoints_mutex_);
+  endpoints_.erase(std::remove(endpoints_.begin(), endpoints_.end(), endpoint),
+                   endpoints_.end());
+}
+
+void MavlinkTransport::IoThread() {
+  while (io_thread_running_) {
+    {
+      std::lock_guard<std::mutex> lock(endpoints_mutex_);
+      io_endpoints_ = endpoints_;
+    }
+
+    SendQueued();
+
+    ::poll(&fds_[0], (sizeof(fds_[0])/sizeof(fds_[0])), kMavlinkIoPollTimeoutMs);
+    if (fds_[0].revents & POLLIN) {
+      ReceivePending();
+    }
+
+    ReportDropped();
+  }
+  io_endpoints_.clear();
+}
+
+void MavlinkTransport::SendQueued() {
+  ROTORS_PROFILE_SCOPE("mavlink_transport/SendQueued");
+  // Collect everything that is queued, of all endpoints.
+  const std::size_t max_packets = 2 * kMavlinkQueueCapacity * io_endpoints_.size();
+  if (send_packets_.size() < max_packets) {
+    send_packets_.resize(max_packets);
+    send_endpoints_.resize(max_packets);
+  }
+  // The queues are still filled while they are drained, so at most two full
+  // queues are taken per endpoint, the rest goes out on the next pass.
+  std::size_t num_packets = 0;
+  for (const std::shared_ptr<MavlinkEndpoint>& endpoint : io_endpoints_) {
+    const std::size_t end_packets = num_packets + 2 * kMavlinkQueueCapacity;
+    while (num_packets < end_packets &&
+           (endpoint->update_outbound.TryPop(&send_packets_[num_packets]) ||
+            endpoint->sensor_outbound.TryPop(&send_packets_[num_packets]))) {
+      send_endpoints_[num_packets++] = endpoint.get();
+    }
+  }
+
+#ifdef ROTORS_MAVLINK_HAVE_MMSG
+  if (batched_) {
+    if (send_headers_.size() < num_packets) {
+      send_headers_.resize(num_packets);
+      send_iovecs_.resize(num_packets);
+    }
+    for (std::size_t i = 0; i < num_packets; ++i) {
+      send_iovecs_[i].iov_base = send_packets_[i].data;
+      send_iovecs_[i].iov_len = send_packets_[i].length;
+      struct msghdr& header = send_headers_[i].msg_hdr;
+      memset(&header, 0, sizeof(header));
+      header.msg_name = &send_endpoints_[i]->remote_address;
+      header.msg_namelen = sizeof(send_endpoints_[i]->remote_address);
+      header.msg_iov = &send_iovecs_[i];
+      header.msg_iovlen = 1;
+    }
+    // sendmmsg() might send only part of the batch.
+    std::size_t num_sent = 0;
+    while (num_sent < num_packets) {
+      const int sent = sendmmsg(fd_, &send_headers_[num_sent], num_packets - num_sent, 0);
+      if (sent <= 0) {
+        gzerr << "[mavlink_transport] Failed sending " << num_packets - num_sent
+              << " mavlink messages\n";
+        break;
+      }
+      num_sent += sent;
+    }
+    return;
+  }
+#endif
+
+  for (std::size_t i = 0; i < num_packets; ++i) {
+    const struct sockaddr_in& address = send_endpoints_[i]->remote_address;
+    ssize_t len = sendto(fd_, send_packets_[i].data, send_packets_[i].length, 0,
+                         (const struct sockaddr *)&address, sizeof(address));
+    if (len <= 0) {
+      printf("Failed sending mavlink message\n");
+    }
+  }
+}
+
+void MavlinkTransport::ReceivePending() {
+  ROTORS_PROFILE_SCOPE("mavlink_transport/ReceivePending");
+#ifdef ROTORS_MAVLINK_HAVE_MMSG
+  if (batched_) {
+    int received;
+    do {
+      for (std::size_t i = 0; i < kMavlinkReceiveBatchSize; ++i) {
+        receive_iovecs_[i].iov_base = &receive_buffer_[i * kMavlinkReceiveBufferSize];
+        receive_iovecs_[i].iov_len = kMavlinkReceiveBufferSize;
+        struct msghdr& header = receive_headers_[i].msg_hdr;
+        memset(&header, 0, sizeof(header));
+        header.msg_name = &receive_addresses_[i];
+        header.msg_namelen = sizeof(receive_addresses_[i]);
+        header.msg_iov = &receive_iovecs_[i];
+        header.msg_iovlen = 1;
+      }
+      received = recvmmsg(fd_, receive_headers_.data(), kMavlinkReceiveBatchSize,
+                          MSG_DONTWAIT, nullptr);
+      for (int i = 0; i < received; ++i) {
+        Dispatch(&receive_buffer_[i * kMavlinkReceiveBufferSize],
+                 receive_headers_[i].msg_len, receive_addresses_[i]);
+      }
+    } while (received == static_cast<int>(kMavlinkReceiveBatchSize));
+    return;
+  }
+#endif
+
+  // Read all queued datagrams.
+  struct sockaddr_in source;
+  socklen_t source_length = sizeof(source);
+  ssize_t len;
+  while ((len = recvfrom(fd_, receive_buffer_.data(), receive_buffer_.size(),
+                         MSG_DONTWAIT, (struct sockaddr *)&source,
+                         &source_length)) > 0) {
+    Dispatch(receive_buffer_.data(), len, source);
+    source_length = sizeof(source);
+  }
+}
+
+void MavlinkTransport::Dispatch(const uint8_t* data, std::size_t length,
+                                const struct sockaddr_in& source) {
+  if (io_endpoints_.empty()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(ParserMutex());
+  // Every datagram holds complete messages, do not continue a message that
+  // was cut off in another one, possibly from another vehicle.
+  mavlink_get_channel_status(MAVLINK_COMM_0)->parse_state = MAVLINK_PARSE_STATE_IDLE;
+
+  mavlink_message_t msg;
+  mavlink_status_t status;
+  for (std::size_t i = 0; i < length; ++i) {
+    if (!mavlink_parse_char(MAVLINK_COMM_0, data[i], &msg, &status)) {
+      continue;
+    }
+
+    // A single vehicle gets all messages, like with its own socket.
+    MavlinkEndpoint* endpoint = nullptr;
+    if (io_endpoints_.size() == 1) {
+      endpoint = io_endpoints_.front().get();
+    } else {
+      for (const std::shared_ptr<MavlinkEndpoint>& candidate : io_endpoints_) {
+        if (candidate->system_id == msg.sysid) {
+          endpoint = candidate.get();
+          break;
+        }
+      }
+    }
+    if (!endpoint) {
+      ++dropped_unknown_system_;
+      continue;
+    }
+
+    // Reply to where the autopilot sends from.
+    endpoint->remote_address = source;
+    if (!endpoint->inbound.TryPush(msg)) {
+      ++endpoint->inbound_dropped;
+    }
+    endpoint->NotifyInbound();
+  }
+}
+
+void MavlinkTransport::ReportDropped() {
+  uint64_t dropped = dropped_unknown_system_;
+  for (const std::shared_ptr<MavlinkEndpoint>& endpoint : io_endpoints_) {
+    dropped += endpoint->outbound_dropped + endpoint->inbound_dropped;
+  }
+
+  // Report dropped messages at most once per second.
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (dropped != reported_dropped_ && now - last_report_ > std::chrono::seconds(1)) {
+    last_report_ = now;
+    reported_dropped_ = dropped;
+    gzwarn << "[mavlink_transport] Dropped " << dropped << " MAVLink messages so "
+           << "far, " << dropped_unknown_system_ << " of them from unknown "
+           << "system IDs, the others because a queue was full.\n";
+  }
+}
+
+}  // namespace gazebo
@@ -0,0 +1,471 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/mesh_voxelizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <gazebo/common/common.hh>
+
+namespace gazebo {
+
+namespace {
+
+/// \brief Largest number of segments of a triangulated circle.
+static constexpr int kMaxCircleSegments = 256;
+/// \brief Number of triangles a worker takes at a time.
+static constexpr size_t kTrianglesPerTask = 64;
+
+/// \brief Minimum and maximum of three values.
+std::pair<double, double> MinMax(double a, double b, double c) {
+  return std::make_pair(std::min(a, std::min(b, c)),
+                        std::max(a, std::max(b, c)));
+}
+
+}  // namespace
+
+bool TriangleBoxOverlap(const ignition::math::Vector3d& box_center,
+                        const ignition::math::Vector3d& box_half_size,
+                        const CollisionTriangle& triangle) {
+  // Everything relative to the box center.
+  const ignition::math::Vector3d v[3] = {triangle.vertices[0] - box_center,
+                                         triangle.vertices[1] - box_center,
+                                         triangle.vertices[2] - box_center};
+  const ignition::math::Vector3d edges[3] = {v[1] - v[0], v[2] - v[1],
+                                             v[0] - v[2]};
+  const ignition::math::Vector3d& h = box_half_size;
+
+  // The nine cross products of the box axes with the triangle edges.
+  for (const ignition::math::Vector3d& e : edges) {
+    const ignition::math::Vector3d axes[3] = {
+        ignition::math::Vector3d(0.0, -e.Z(), e.Y()),
+        ignition::math::Vector3d(e.Z(), 0.0, -e.X()),
+        ignition::math::Vector3d(-e.Y(), e.X(), 0.0)};
+    for (const ignition::math::Vector3d& axis : axes) {
+      const std::pair<double, double> p =
+          MinMax(v[0].Dot(axis), v[1].Dot(axis), v[2].Dot(axis));
+      const double r = h.X() * std::abs(axis.X()) + h.Y() * std::abs(axis.Y()) +
+                       h.Z() * std::abs(axis.Z());
+      if (p.first > r || p.second < -r) return false;
+    }
+  }
+
+  // The box axes, i.e. the bounding box of the triangle.
+  for (int axis = 0; axis < 3; ++axis) {
+    const std::pair<double, double> p = MinMax(v[0][axis], v[1][axis], v[2][axis]);
+    if (p.first > h[axis] || p.second < -h[axis]) return false;
+  }
+
+  // The triangle normal.
+  const ignition::math::Vector3d normal = edges[0].Cross(edges[1]);
+  const double r = h.X() * std::abs(normal.X()) + h.Y() * std::abs(normal.Y()) +
+                   h.Z() * std::abs(normal.Z());
+  return std::abs(normal.Dot(v[0])) <= r;
+}
+
+MeshVoxelizer::MeshVoxelizer(const ignition::math::Vector3d& min,
+                             double leaf_size, const int num_cells[3])
+    : min_(min), leaf_size_(leaf_size) {
+  int64_t num_total_cells = 1;
+  for (int axis = 0; axis < 3; ++axis) {
+    num_cells_[axis] = std::max(0, num_cells[axis]);
+    num_total_cells *= num_cells_[axis];
+  }
+  const double half_leaf = leaf_size_ / 2;
+  grid_min_ = min_ - ignition::math::Vector3d(half_leaf, half_leaf, half_leaf);
+  grid_max_ = min_ + ignition::math::Vector3d(
+                         (num_cells_[0] - 0.5) * leaf_size_,
+                         (num_cells_[1] - 0.5) * leaf_size_,
+                         (num_cells_[2] - 0.5) * leaf_size_);
+  // Value initialized, all cells start out free.
+  std::vector<std::atomic<uint64_t> >((num_total_cells + 63) / 64).swap(words_);
+}
+
+void MeshVoxelizer::AddWorld(const physics::WorldPtr& world) {
+  std::vector<physics::ModelPtr> models = world->Models();
+  while (!models.empty()) {
+    const physics::ModelPtr model = models.back();
+    models.pop_back();
+    for (const physics::ModelPtr& nested_model : model->NestedModels()) {
+      models.push_back(nested_model);
+    }
+    for (const physics::LinkPtr& link : model->GetLinks()) {
+      for (const physics::CollisionPtr& collision : link->GetCollisions()) {
+        AddCollision(collision);
+      }
+    }
+  }
+}
+
+void MeshVoxelizer::SetRegions(
+    const std::vector<std::pair<ignition::math::Vector3d,
+                                ignition::math::Vector3d> >& regions) {
+  regions_ = regions;
+}
+
+void MeshVoxelizer::AddTriangle(const CollisionTriangle& triangle) {
+  // Triangles outside of the grid do not touch any cell.
+  ignition::math::Vector3d triangle_min, triangle_max;
+  for (int axis = 0; axis < 3; ++axis) {
+    const std::pair<double, double> p =
+        MinMax(triangle.vertices[0][axis], triangle.vertices[1][axis],
+               triangle.vertices[2][axis]);
+    if (p.first > grid_max_[axis] || p.second < grid_min_[axis]) return;
+    triangle_min[axis] = p.first;
+    triangle_max[axis] = p.second;
+  }
+  if (!regions_.empty() &&
+      std::none_of(regions_.begin(), regions_.end(),
+                   [&](const std::pair<ignition::math::Vector3d,
+                                       ignition::math::Vector3d>& region) {
+                     for (int axis = 0; axis < 3; ++axis) {
+                       if (triangle_min[axis] > region.second[axis] ||
+                           triangle_max[axis] < region.first[axis]) {
+                         return false;
+                       }
+                     }
+                     return true;
+                   })) {
+    return;
+  }
+  triangles_.push_back(triangle);
+}
+
+void MeshVoxelizer::AddCollision(const physics::CollisionPtr& collision) {
+  const physics::ShapePtr shape = collision->GetShape();
+  if (!shape || shape->HasType(physics::Base::RAY_SHAPE) ||
+      shape->HasType(physics::Base::MULTIRAY_SHAPE)) {
+    return;
+  }
+  const ignition::math::Pose3d pose = collision->WorldPose();
+  if (shape->HasType(physics::Base::PLANE_SHAPE)) {
+    AddPlane(boost::dynamic_pointer_cast<physics::PlaneShape>(shape)->Normal(),
+             pose);
+    return;
+  }
+
+  const auto bounding_box = collision->BoundingBox();
+  for (int axis = 0; axis < 3; ++axis) {
+    if (bounding_box.Min()[axis] > grid_max_[axis] ||
+        bounding_box.Max()[axis] < grid_min_[axis]) {
+      return;
+    }
+  }
+
+  if (shape->HasType(physics::Base::BOX_SHAPE)) {
+    AddBox(boost::dynamic_pointer_cast<physics::BoxShape>(shape)->Size(), pose);
+    return;
+  }
+  if (shape->HasType(physics::Base::SPHERE_SHAPE)) {
+    AddSphere(boost::dynamic_pointer_cast<physics::SphereShape>(shape)->GetRadius(),
+              pose);
+    return;
+  }
+  if (shape->HasType(physics::Base::CYLINDER_SHAPE)) {
+    const physics::CylinderShapePtr cylinder =
+        boost::dynamic_pointer_cast<physics::CylinderShape>(shape);
+    AddCylinder(cylinder->GetRadius(), cylinder->GetLength(), pose);
+    return;
+  }
+  if (shape->HasType(physics::Base::MESH_SHAPE) &&
+      AddMesh(boost::dynamic_pointer_cast<physics::MeshShape>(shape), pose)) {
+    return;
+  }
+
+  gzwarn << "[mesh_voxelizer] Voxelizing collision " << collision->GetScopedName()
+         << " by its bounding box, its shape cannot be triangulated.\n";
+  AddBox(bounding_box.Max() - bounding_box.Min(),
+         ignition::math::Pose3d(bounding_box.Center(),
+                                ignition::math::Quaterniond::Identity));
+}
+
+void MeshVoxelizer::AddTriangles(
+    const std::vector<ignition::math::Vector3d>& vertices,
+    const ignition::math::Pose3d& pose) {
+  for (size_t i = 0; i + 2 < vertices.size(); i += 3) {
+    CollisionTriangle triangle;
+    for (int k = 0; k < 3; ++k) {
+      triangle.vertices[k] = pose.Pos() + pose.Rot().RotateVector(vertices[i + k]);
+    }
+    AddTriangle(triangle);
+  }
+}
+
+void MeshVoxelizer::AddBox(const ignition::math::Vector3d& size,
+                           const ignition::math::Pose3d& pose) {
+  // Corner i lies at +half_size along every axis whose bit is set in i.
+  const ignition::math::Vector3d half_size = size / 2;
+  ignition::math::Vector3d corners[8];
+  for (int i = 0; i < 8; ++i) {
+    corners[i] = ignition::math::Vector3d(
+        (i & 1) ? half_size.X() : -half_size.X(),
+        (i & 2) ? half_size.Y() : -half_size.Y(),
+        (i & 4) ? half_size.Z() : -half_size.Z());
+  }
+  static const int kFaces[6][4] = {{0, 2, 6, 4}, {1, 5, 7, 3}, {0, 4, 5, 1},
+                                   {2, 3, 7, 6}, {0, 1, 3, 2}, {4, 6, 7, 5}};
+  std::vector<ignition::math::Vector3d> vertices;
+  for (const auto& face : kFaces) {
+    vertices.push_back(corners[face[0]]);
+    vertices.push_back(corners[face[1]]);
+    vertices.push_back(corners[face[2]]);
+    vertices.push_back(corners[face[0]]);
+    vertices.push_back(corners[face[2]]);
+    vertices.push_back(corners[face[3]]);
+  }
+  AddTriangles(vertices, pose);
+}
+
+void MeshVoxelizer::AddPlane(const ignition::math::Vector3d& normal,
+                             const ignition::math::Pose3d& pose) {
+  ignition::math::Vector3d world_normal = pose.Rot().RotateVector(normal);
+  if (world_normal.Length() == 0.0) return;
+  world_normal.Normalize();
+
+  // A square around the projection of the grid center covers all of the
+  // plane within the grid.
+  const ignition::math::Vector3d grid_center = (grid_min_ + grid_max_) / 2;
+  const double radius = (grid_max_ - grid_min_).Length() / 2 + leaf_size_;
+  const double distance = world_normal.Dot(grid_center - pose.Pos());
+  if (std::abs(distance) > radius) return;
+  const ignition::math::Vector3d center = grid_center - world_normal * distance;
+  const ignition::math::Vector3d u =
+      world_normal.Perpendicular().Normalize() * radius;
+  const ignition::math::Vector3d v = world_normal.Cross(u);
+
+  CollisionTriangle triangle;
+  triangle.vertices[0] = center - u - v;
+  triangle.vertices[1] = center + u - v;
+  triangle.vertices[2] = center + u + v;
+  AddTriangle(triangle);
+  triangle.vertices[1] = center + u + v;
+  triangle.vertices[2] = center - u + v;
+  AddTriangle(triangle);
+}
+
+int MeshVoxelizer::NumSegments(double radius) const {
+  // A chord of a circle with n segments is r * (1 - cos(pi / n)) away from it.
+  const double half_leaf = leaf_size_ / 2;
+  if (radius <= half_leaf) return 8;
+  const double segments = M_PI / std::acos(1.0 - half_leaf / radius);
+  return std::max(
+      8, std::min(kMaxCircleSegments, static_cast<int>(std::ceil(segments))));
+}
+
+void MeshVoxelizer::AddSphere(double radius,
+                              const ignition::math::Pose3d& pose) {
+  const int num_segments = NumSegments(radius);
+  const int num_rings = num_segments / 2;
+  auto point = [&](int ring, int segment) {
+    const double polar = M_PI * ring / num_rings;
+    const double azimuth = 2.0 * M_PI * segment / num_segments;
+    return ignition::math::Vector3d(radius * std::sin(polar) * std::cos(azimuth),
+                                    radius * std::sin(polar) * std::sin(azimuth),
+                                    radius * std::cos(polar));
+  };
+
+  std::vector<ignition::math::Vector3d> vertices;
+  for (int ring = 0; ring < num_rings; ++ring) {
+    for (int segment = 0; segment < num_segments; ++segment) {
+      const ignition::math::Vector3d a = point(ring, segment);
+      const ignition::math::Vector3d b = point(ring, segment + 1);
+      const ignition::math::Vector3d c = point(ring + 1, segment);
+      const ignition::math::Vector3d d = point(ring + 1, segment + 1);
+      // The first and the last ring meet in a pole.
+      if (ring > 0) {
+        vertices.push_back(a);
+        vertices.push_back(c);
+        vertices.push_back(b);
+      }
+      if (ring + 1 < num_rings) {
+        vertices.push_back(b);
+        vertices.push_back(c);
+        vertices.push_back(d);
+      }
+    }
+  }
+  AddTriangles(vertices, pose);
+}
+
+void MeshVoxelizer::AddCylinder(double radius, double length,
+                                const ignition::math::Pose3d& pose) {
+  const int num_segments = NumSegments(radius);
+  const double half_length = length / 2;
+  const ignition::math::Vector3d top(0.0, 0.0, half_length);
+  const ignition::math::Vector3d bottom(0.0, 0.0, -half_length);
+
+  std::vector<ignition::math::Vector3d> vertices;
+  for (int segment = 0; segment < num_segments; ++segment) {
+    const double azimuth = 2.0 * M_PI * segment / num_segments;
+    const double next_azimuth = 2.0 * M_PI * (segment + 1) / num_segments;
+    const ignition::math::Vector3d a(radius * std::cos(azimuth),
+                                     radius * std::sin(azimuth), 0.0);
+    const ignition::math::Vector3d b(radius * std::cos(next_azimuth),
+                                     radius * std::sin(next_azimuth), 0.0);
+    vertices.push_back(a + bottom);
+    vertices.push_back(b + bottom);
+    vertices.push_back(b + top);
+    vertices.push_back(a + bottom);
+    vertices.push_back(b + top);
+    vertices.push_back(a + top);
+    vertices.push_back(top);
+    vertices.push_back(a + top);
+    vertices.push_back(b + top);
+    vertices.push_back(bottom);
+    vertices.push_back(b + bottom);
+    vertices.push_back(a + bottom);
+  }
+  AddTriangles(vertices, pose);
+}
+
+bool MeshVoxelizer::AddMesh(const physics::MeshShapePtr& mesh_shape,
+                            const ignition::math::Pose3d& pose) {
+  if (!mesh_shape) return false;
+  const std::string filename = common::find_file(mesh_shape->GetMeshURI());
+  // The mesh manager returns the mesh that the physics engine loaded already.
+  const common::Mesh* mesh =
+      filename.empty() ? NULL : common::MeshManager::Instance()->Load(filename);
+  if (!mesh) return false;
+
+  const ignition::math::Vector3d scale = mesh_shape->Size();
+  const std::string submesh_name = mesh_shape->GetSubmeshName();
+  std::vector<ignition::math::Vector3d> vertices;
+  for (unsigned int i = 0; i < mesh->GetSubMeshCount(); ++i) {
+    const common::SubMesh* submesh = mesh->GetSubMesh(i);
+    if (!submesh_name.empty() && submesh->GetName() != submesh_name) continue;
+    if (submesh->GetPrimitiveType() != common::SubMesh::TRIANGLES) continue;
+    ignition::math::Vector3d center = ignition::math::Vector3d::Zero;
+    if (!submesh_name.empty() && mesh_shape->GetCenterSubmesh()) {
+      center = (submesh->Min() + submesh->Max()) / 2;
+    }
+    const unsigned int num_indices = submesh->GetIndexCount();
+    for (unsigned int j = 0; j + 2 < num_indices; j += 3) {
+      for (unsigned int k = 0; k < 3; ++k) {
+        vertices.push_back((submesh->Vertex(submesh->GetIndex(j + k)) - center) *
+                           scale);
+      }
+    }
+  }
+  AddTriangles(vertices, pose);
+  return true;
+}
+
+void MeshVoxelizer::VoxelizeTriangle(const CollisionTriangle& triangle) {
+  const double half_leaf = leaf_size_ / 2;
+  const ignition::math::Vector3d half_cell(half_leaf, half_leaf, half_leaf);
+
+  // Cell i spans min + (i - 1/2) * leaf_size to min + (i + 1/2) * leaf_size.
+  auto cell_of = [&](int axis, double coordinate) {
+    return static_cast<int>(
+        std::floor((coordinate - min_[axis]) / leaf_size_ + 0.5));
+  };
+  int begin[3];
+  int end[3];
+  for (int axis = 0; axis < 3; ++axis) {
+    const std::pair<double, double> p =
+        MinMax(triangle.vertices[0][axis], triangle.vertices[1][axis],
+               triangle.vertices[2][axis]);
+    begin[axis] = std::max(0, cell_of(axis, p.first));
+    end[axis] = std::min(num_cells_[axis], cell_of(axis, p.second) + 1);
+    if (begin[axis] >= end[axis]) return;
+  }
+
+  // Walk the cells along the axis the triangle faces most, only those within
+  // reach of its plane in every column of the other two axes.
+  const ignition::math::Vector3d normal =
+      (triangle.vertices[1] - triangle.vertices[0])
+          .Cross(triangle.vertices[2] - triangle.vertices[0]);
+  int axis = 0;
+  for (int i = 1; i < 3; ++i) {
+    if (std::abs(normal[i]) > std::abs(normal[axis])) axis = i;
+  }
+  const int axis_b = (axis + 1) % 3;
+  const int axis_c = (axis + 2) % 3;
+  const double offset = normal.Dot(triangle.vertices[0]);
+  const int64_t strides[3] = {
+      static_cast<int64_t>(num_cells_[1]) * num_cells_[2], num_cells_[2], 1};
+
+  int cell[3];
+  for (cell[axis_b] = begin[axis_b]; cell[axis_b] < end[axis_b]; ++cell[axis_b]) {
+    for (cell[axis_c] = begin[axis_c]; cell[axis_c] < end[axis_c];
+         ++cell[axis_c]) {
+      int column_begin = begin[axis];
+      int column_end = end[axis];
+      if (normal[axis] != 0.0) {
+        // The plane over the corners of the column.
+        const double b = min_[axis_b] + cell[axis_b] * leaf_size_;
+        const double c = min_[axis_c] + cell[axis_c] * leaf_size_;
+        const double spread =
+            (std::abs(normal[axis_b]) + std::abs(normal[axis_c])) * half_leaf;
+        const double base = offset - normal[axis_b] * b - normal[axis_c] * c;
+        const double lower = (base - spread) / normal[axis];
+        const double upper = (base + spread) / normal[axis];
+        column_begin = std::max(column_begin, cell_of(axis, std::min(lower, upper)));
+        column_end = std::min(column_end, cell_of(axis, std::max(lower, upper)) + 1);
+      }
+      for (cell[axis] = column_begin; cell[axis] < column_end; ++cell[axis]) {
+        const int64_t index = cell[0] * strides[0] + cell[1] * strides[1] + cell[2];
+        const uint64_t bit = uint64_t(1) << (index & 63);
+        std::atomic<uint64_t>& word = words_[index >> 6];
+        if (word.load(std::memory_order_relaxed) & bit) continue;
+        const ignition::math::Vector3d center(min_.X() + cell[0] * leaf_size_,
+                                              min_.Y() + cell[1] * leaf_size_,
+                                              min_.Z() + cell[2] * leaf_size_);
+        if (TriangleBoxOverlap(center, half_cell, triangle)) {
+          word.fetch_or(bit, std::memory_order_relaxed);
+        }
+      }
+    }
+  }
+}
+
+void MeshVoxelizer::Voxelize(int num_threads) {
+  if (num_threads <= 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  const size_t num_tasks =
+      (triangles_.size() + kTrianglesPerTask - 1) / kTrianglesPerTask;
+  num_threads = static_cast<int>(
+      std::max<size_t>(1, std::min<size_t>(num_threads, num_tasks)));
+
+  // Cells are shared between triangles, the workers set their bits atomically.
+  std::atomic<size_t> next_task(0);
+  std::vector<std::thread> workers;
+  for (int thread = 0; thread < num_threads; ++thread) {
+    workers.emplace_back([&]() {
+      for (size_t task = next_task++; task < num_tasks; task = next_task++) {
+        const size_t end =
+            std::min(triangles_.size(), (task + 1) * kTrianglesPerTask);
+        for (size_t i = task * kTrianglesPerTask; i < end; ++i) {
+          VoxelizeTriangle(triangles_[i]);
+        }
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
+
+}  // namespace gazebo
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/model_arena.h"
+
+#include <chrono>
+#include <map>
+
+#include <gazebo/common/common.hh>
+#include <gazebo/physics/physics.hh>
+#include <gazebo/transport/transport.hh>
+
+#include "PluginMemoryStats.pb.h"
+
+namespace gazebo {
+
+namespace {
+
+static const std::string kPluginMemoryTopic = "~/rotors/plugin_memory";
+static constexpr double kReportPeriodSeconds = 1.0;
+
+/// \brief  Publishes the usage of all arenas once per report period, checked
+///         at the end of every world update like the profiling report.
+class ArenaReporter {
+ public:
+  ArenaReporter() : last_report_(std::chrono::steady_clock::now()) {
+    update_connection_ = event::Events::ConnectWorldUpdateEnd(
+        std::bind(&ArenaReporter::OnWorldUpdateEnd, this));
+  }
+
+ private:
+  void OnWorldUpdateEnd() {
+    const auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - last_report_).count() <
+        kReportPeriodSeconds) {
+      return;
+    }
+    last_report_ = now;
+
+    if (!node_) {
+      node_ = transport::NodePtr(new transport::Node());
+      node_->Init();
+      publisher_ = node_->Advertise<gz_diagnostic_msgs::PluginMemoryStats>(
+          kPluginMemoryTopic, 1);
+    }
+    if (!publisher_->HasConnections()) {
+      return;
+    }
+
+    gz_diagnostic_msgs::PluginMemoryStats stats_msg;
+    const common::Time wall_time = common::Time::GetWallTime();
+    stats_msg.mutable_header()->set_frame_id("");
+    stats_msg.mutable_header()->mutable_stamp()->set_sec(wall_time.sec);
+    stats_msg.mutable_header()->mutable_stamp()->set_nsec(wall_time.nsec);
+
+    for (const std::shared_ptr<ModelArena>& arena : ModelArena::Arenas()) {
+      gz_diagnostic_msgs::ModelMemory* model_memory = stats_msg.add_model();
+      model_memory->set_model(arena->model_name());
+      model_memory->set_reserved_bytes(arena->reserved_bytes());
+      for (const ModelArena::PluginUsage& usage : arena->Usage()) {
+        gz_diagnostic_msgs::PluginMemory* plugin_memory =
+            model_memory->add_plugin();
+        plugin_memory->set_plugin(usage.plugin);
+        plugin_memory->set_bytes(usage.bytes);
+        plugin_memory->set_peak_bytes(usage.peak_bytes);
+        plugin_memory->set_allocations(usage.allocations);
+      }
+    }
+    publisher_->Publish(stats_msg);
+  }
+
+  event::ConnectionPtr update_connection_;
+  transport::NodePtr node_;
+  transport::PublisherPtr publisher_;
+  std::chrono::steady_clock::time_point last_report_;
+};
+
+std::mutex& RegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::map<const physics::Model*, std::weak_ptr<ModelArena> >& Registry() {
+  static std::map<const physics::Model*, std::weak_ptr<ModelArena> > registry;
+  return registry;
+}
+
+}  // namespace
+
+std::shared_ptr<ModelArena> ModelArena::Get(const physics::ModelPtr& model) {
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  // The reporter lives until the process exits, so that no transport object
+  // is torn down after the transport itself.
+  static ArenaReporter* reporter = new ArenaReporter();
+  (void)reporter;
+
+  std::weak_ptr<ModelArena>& entry = Registry()[model.get()];
+  std::shared_ptr<ModelArena> arena = entry.lock();
+  if (!arena) {
+    arena = std::make_shared<ModelArena>(model->GetScopedName());
+    entry = arena;
+  }
+  return arena;
+}
+
+ArenaAllocator<char> ModelArena::ForPlugin(const physics::ModelPtr& model,
+                                           const std::string& plugin) {
+  std::shared_ptr<ModelArena> arena = Get(model);
+  const int tag = arena->Tag(plugin);
+  return ArenaAllocator<char>(arena, tag);
+}
+
+std::vector<std::shared_ptr<ModelArena> > ModelArena::Arenas() {
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  std::vector<std::shared_ptr<ModelArena> > arenas;
+  for (auto entry = Registry().begin(); entry != Registry().end();) {
+    std::shared_ptr<ModelArena> arena = entry->second.lock();
+    if (arena) {
+      arenas.push_back(arena);
+      ++entry;
+    } else {
+      // The models of released arenas may be gone already.
+      entry = Registry().erase(entry);
+    }
+  }
+  return arenas;
+}
+
+}  // namespace gazebo
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/model_fidelity.h"
+
+#include "rotors_gazebo_plugins/common.h"
+
+namespace gazebo {
+
+namespace {
+
+std::mutex& RegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::map<const physics::Model*, std::weak_ptr<ModelFidelity> >& Registry() {
+  static std::map<const physics::Model*, std::weak_ptr<ModelFidelity> > registry;
+  return registry;
+}
+
+}  // namespace
+
+std::shared_ptr<ModelFidelity> ModelFidelity::Get(
+    const physics::ModelPtr& model) {
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  std::weak_ptr<ModelFidelity>& entry = Registry()[model.get()];
+  std::shared_ptr<ModelFidelity> fidelity = entry.lock();
+  if (!fidelity) {
+    fidelity = std::make_shared<ModelFidelity>();
+    entry = fidelity;
+  }
+  return fidelity;
+}
+
+std::shared_ptr<ModelFidelity> ModelFidelity::Get(
+    const physics::ModelPtr& model, const sdf::ElementPtr& sdf) {
+  std::shared_ptr<ModelFidelity> fidelity = Get(model);
+  if (sdf->HasElement("fidelityLevel") ||
+      sdf->HasElement("lowFidelityRateDivisor")) {
+    std::string level_name = "full";
+    int rate_divisor = 0;
+    getSdfParam<std::string>(sdf, "fidelityLevel", level_name, level_name);
+    getSdfParam<int>(sdf, "lowFidelityRateDivisor", rate_divisor,
+                     rate_divisor);
+    FidelityLevel level = kDefaultFidelityLevel;
+    if (!ParseFidelityLevel(level_name, &level)) {
+      gzerr << "[model_fidelity] Unknown fidelityLevel \"" << level_name
+            << "\" of model \"" << model->GetName()
+            << "\", using \"full\".\n";
+    }
+    fidelity->Set(level, rate_divisor);
+  }
+  return fidelity;
+}
+
+std::shared_ptr<ModelFidelity> ModelFidelity::Find(
+    const physics::ModelPtr& model) {
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  auto entry = Registry().find(model.get());
+  if (entry == Registry().end()) {
+    return nullptr;
+  }
+  return entry->second.lock();
+}
+
+void ModelFidelity::Set(FidelityLevel level, int rate_divisor) {
+  if (rate_divisor > 0) {
+    rate_divisor_.store(rate_divisor, std::memory_order_relaxed);
+  }
+  if (level_.exchange(level) == level) {
+    return;
+  }
+  // Called under the lock, so that a plugin removing its listener waits for
+  // the call to finish.
+  std::lock_guard<std::mutex> lock(listener_mutex_);
+  for (const auto& listener : listeners_) {
+    listener.second(level);
+  }
+}
+
+int ModelFidelity::AddListener(const Listener& listener) {
+  std::lock_guard<std::mutex> lock(listener_mutex_);
+  listeners_[next_listener_id_] = listener;
+  return next_listener_id_++;
+}
+
+void ModelFidelity::RemoveListener(int id) {
+  std::lock_guard<std::mutex> lock(listener_mutex_);
+  listeners_.erase(id);
+}
+
+bool ParseFidelityLevel(const std::string& name, FidelityLevel* level) {
+  if (name == "full") {
+    *level = kFidelityFull;
+  } else if (name == "low") {
+    *level = kFidelityLow;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+}  // namespace gazebo
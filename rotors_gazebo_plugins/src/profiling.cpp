@@ -0,0 +1,209 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/profiling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+#include <gazebo/common/common.hh>
+#include <gazebo/transport/transport.hh>
+
+#include "PluginTimingStats.pb.h"
+
+namespace gazebo {
+
+namespace {
+
+static const std::string kPluginTimingTopic = "~/rotors/plugin_timing";
+static constexpr double kReportPeriodSeconds = 1.0;
+
+/// \brief  Publishes the statistics of all sites once per report period. The
+///         check runs at the end of every world update, so that no thread of
+///         its own is needed.
+class ProfilingReporter {
+ public:
+  ProfilingReporter() : last_report_(std::chrono::steady_clock::now()) {
+    update_connection_ = event::Events::ConnectWorldUpdateEnd(
+        std::bind(&ProfilingReporter::OnWorldUpdateEnd, this));
+  }
+
+ private:
+  void OnWorldUpdateEnd() {
+    const auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - last_report_).count() <
+        kReportPeriodSeconds) {
+      return;
+    }
+    last_report_ = now;
+
+    if (!node_) {
+      node_ = transport::NodePtr(new transport::Node());
+      node_->Init();
+      publisher_ = node_->Advertise<gz_diagnostic_msgs::PluginTimingStats>(
+          kPluginTimingTopic, 1);
+    }
+
+    gz_diagnostic_msgs::PluginTimingStats stats_msg;
+    const common::Time wall_time = common::Time::GetWallTime();
+    stats_msg.mutable_header()->set_frame_id("");
+    stats_msg.mutable_header()->mutable_stamp()->set_sec(wall_time.sec);
+    stats_msg.mutable_header()->mutable_stamp()->set_nsec(wall_time.nsec);
+
+    std::vector<uint64_t> counts;
+    for (ProfilingSite* site : ProfilingSite::Sites()) {
+      uint64_t max_ns;
+      site->Collect(&counts, &max_ns);
+
+      // Only the samples of the last period are reported.
+      std::vector<uint64_t>& previous = previous_counts_[site];
+      previous.resize(counts.size(), 0);
+      uint64_t samples = 0;
+      for (std::size_t i = 0u; i < counts.size(); ++i) {
+        const uint64_t total = counts[i];
+        counts[i] -= previous[i];
+        previous[i] = total;
+        samples += counts[i];
+      }
+      if (samples == 0) {
+        continue;
+      }
+
+      gz_diagnostic_msgs::PluginTiming* timing = stats_msg.add_timing();
+      timing->set_name(site->Name());
+      timing->set_samples(samples);
+      timing->set_p50_us(Percentile(counts, samples, 0.5) * 1e-3);
+      timing->set_p99_us(Percentile(counts, samples, 0.99) * 1e-3);
+      timing->set_max_us(max_ns * 1e-3);
+    }
+    publisher_->Publish(stats_msg);
+  }
+
+  /// \brief  Returns the lower bound of the bucket holding a percentile [ns].
+  static double Percentile(const std::vector<uint64_t>& counts,
+                           uint64_t samples, double fraction) {
+    const uint64_t rank = std::max<uint64_t>(1, fraction * samples + 0.5);
+    uint64_t sum = 0;
+    for (std::size_t i = 0u; i < counts.size(); ++i) {
+      sum += counts[i];
+      if (sum >= rank) {
+        return ProfilingSite::BucketLowerBound(i);
+      }
+    }
+    return ProfilingSite::BucketLowerBound(counts.size() - 1);
+  }
+
+  event::ConnectionPtr update_connection_;
+  transport::NodePtr node_;
+  transport::PublisherPtr publisher_;
+  std::chrono::steady_clock::time_point last_report_;
+  std::map<const ProfilingSite*, std::vector<uint64_t> > previous_counts_;
+};
+
+std::mutex& RegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::vector<ProfilingSite*>& Registry() {
+  static std::vector<ProfilingSite*> registry;
+  return registry;
+}
+
+}  // namespace
+
+ProfilingSite::Histogram::Histogram() : max_ns(0) {
+  for (std::atomic<uint64_t>& bucket : buckets) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+ProfilingSite::ProfilingSite(const std::string& name, int id)
+    : name_(name), id_(id) {}
+
+ProfilingSite* ProfilingSite::Get(const std::string& name) {
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  // The reporter and the sites live until the process exits, so that no
+  // plugin can be left with a dangling site, and no transport object is torn
+  // down after the transport itself.
+  static ProfilingReporter* reporter = new ProfilingReporter();
+  (void)reporter;
+
+  for (ProfilingSite* site : Registry()) {
+    if (site->name_ == name) {
+      return site;
+    }
+  }
+  Registry().push_back(new ProfilingSite(name, Registry().size()));
+  return Registry().back();
+}
+
+std::vector<ProfilingSite*> ProfilingSite::Sites() {
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  return Registry();
+}
+
+int ProfilingSite::Bucket(uint64_t ns) {
+  if (ns < 8) {
+    return ns;
+  }
+  const int octave = 63 - __builtin_clzll(ns);
+  const int bucket = octave * 4 + ((ns >> (octave - 2)) & 3);
+  return bucket < kBucketCount ? bucket : kBucketCount - 1;
+}
+
+double ProfilingSite::BucketLowerBound(int bucket) {
+  if (bucket < 8) {
+    return bucket;
+  }
+  const int octave = bucket / 4;
+  return std::ldexp(4 + bucket % 4, octave - 2);
+}
+
+void ProfilingSite::Collect(std::vector<uint64_t>* counts, uint64_t* max_ns) {
+  counts->assign(kBucketCount, 0);
+  *max_ns = 0;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (Histogram* histogram : histograms_) {
+    for (int i = 0; i < kBucketCount; ++i) {
+      (*counts)[i] += histogram->buckets[i].load(std::memory_order_relaxed);
+    }
+    *max_ns = std::max(*max_ns,
+                       histogram->max_ns.exchange(0, std::memory_order_relaxed));
+  }
+}
+
+ProfilingSite::Histogram* ProfilingSite::AddLocalHistogram(
+    std::vector<Histogram*>* histograms) {
+  if (histograms->size() <= static_cast<std::size_t>(id_)) {
+    histograms->resize(id_ + 1, nullptr);
+  }
+  // Histograms outlive their thread; the samples stay part of the totals.
+  Histogram* histogram = new Histogram();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    histograms_.push_back(histogram);
+  }
+  (*histograms)[id_] = histogram;
+  return histogram;
+}
+
+}  // namespace gazebo
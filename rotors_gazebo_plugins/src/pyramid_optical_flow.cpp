@@ -0,0 +1,147 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/pyramid_optical_flow.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+
+namespace gazebo {
+
+PyramidOpticalFlow::PyramidOpticalFlow(unsigned int width, unsigned int height,
+                                       unsigned int depth, float focal_length,
+                                       int output_rate, unsigned int roi_size)
+    : width_(width),
+      height_(height),
+      depth_(depth),
+      roi_size_(std::min(roi_size, std::min(width, height))),
+      output_interval_us_(output_rate > 0 ? 1e6 / output_rate : 0),
+      roi_(roi_size_, roi_size_, CV_8UC1),
+      has_previous_(false),
+      previous_time_us_(0),
+      flow_x_integral_(0.0f),
+      flow_y_integral_(0.0f),
+      integration_time_us_(0),
+      num_tracked_(0),
+      num_features_(0) {
+  const unsigned int side = std::min(width, height);
+  roi_rect_ = cv::Rect((width - side) / 2, (height - side) / 2, side, side);
+  focal_length_ = focal_length * roi_size_ / side;
+  features_.reserve(kMaxFeatures);
+  previous_features_.reserve(kMaxFeatures);
+}
+
+void PyramidOpticalFlow::PrepareRoi(const uint8_t* image) {
+  // Wraps the frame without copying it, and only touches the central square.
+  const cv::Mat frame(height_, width_, depth_ == 3 ? CV_8UC3 : CV_8UC1,
+                      const_cast<uint8_t*>(image));
+  const cv::Mat square = frame(roi_rect_);
+
+  cv::Mat gray;
+  if (depth_ == 3) {
+    // The SIMD conversion of OpenCV, into a buffer which is reused.
+    cv::cvtColor(square, gray_, cv::COLOR_RGB2GRAY);
+    gray = gray_;
+  } else {
+    gray = square;
+  }
+
+  if (gray.cols == static_cast<int>(roi_size_)) {
+    gray.copyTo(roi_);
+  } else {
+    cv::resize(gray, roi_, roi_.size(), 0, 0, cv::INTER_AREA);
+  }
+}
+
+void PyramidOpticalFlow::DetectFeatures(std::vector<cv::Point2f>* features) {
+  cv::goodFeaturesToTrack(roi_, *features, kMaxFeatures, 0.01, 4.0);
+}
+
+int PyramidOpticalFlow::calcFlow(const uint8_t* image, uint32_t image_time_us,
+                                 int& dt_us, float& flow_x, float& flow_y) {
+  PrepareRoi(image);
+  const cv::Size window(kWindowSize, kWindowSize);
+  cv::buildOpticalFlowPyramid(roi_, pyramid_, window, kPyramidLevels);
+
+  if (!has_previous_) {
+    DetectFeatures(&previous_features_);
+    std::swap(pyramid_, previous_pyramid_);
+    previous_time_us_ = image_time_us;
+    has_previous_ = true;
+    return -1;
+  }
+
+  int num_tracked = 0;
+  float pixel_flow_x = 0.0f;
+  float pixel_flow_y = 0.0f;
+  features_.clear();
+  if (!previous_features_.empty()) {
+    cv::calcOpticalFlowPyrLK(previous_pyramid_, pyramid_, previous_features_,
+                             features_, status_, error_, window,
+                             kPyramidLevels);
+    // Keep the successfully tracked features for the next frame.
+    for (size_t i = 0; i < features_.size(); ++i) {
+      if (!status_[i]) {
+        continue;
+      }
+      pixel_flow_x += features_[i].x - previous_features_[i].x;
+      pixel_flow_y += features_[i].y - previous_features_[i].y;
+      features_[num_tracked++] = features_[i];
+    }
+  }
+  num_features_ += previous_features_.size();
+  num_tracked_ += num_tracked;
+  features_.resize(num_tracked);
+
+  if (num_tracked > 0) {
+    flow_x_integral_ += atan2(pixel_flow_x / num_tracked, focal_length_);
+    flow_y_integral_ += atan2(pixel_flow_y / num_tracked, focal_length_);
+  }
+  integration_time_us_ += image_time_us - previous_time_us_;
+
+  if (num_tracked < kMinFeatures) {
+    DetectFeatures(&features_);
+  }
+  std::swap(pyramid_, previous_pyramid_);
+  std::swap(features_, previous_features_);
+  previous_time_us_ = image_time_us;
+
+  if (integration_time_us_ < output_interval_us_) {
+    return -1;
+  }
+
+  dt_us = integration_time_us_;
+  flow_x = flow_x_integral_;
+  flow_y = flow_y_integral_;
+  const int quality =
+      num_features_ > 0 ? 255 * num_tracked_ / num_features_ : 0;
+
+  flow_x_integral_ = 0.0f;
+  flow_y_integral_ = 0.0f;
+  integration_time_us_ = 0;
+  num_tracked_ = 0;
+  num_features_ = 0;
+  return quality;
+}
+
+}  // namespace gazebo
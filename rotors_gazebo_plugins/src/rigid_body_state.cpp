@@ -0,0 +1,84 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/rigid_body_state.h"
+
+#include <map>
+
+namespace gazebo {
+
+namespace {
+
+std::mutex& RegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::map<const physics::Link*, std::weak_ptr<RigidBodyStateCache> >& Registry() {
+  static std::map<const physics::Link*, std::weak_ptr<RigidBodyStateCache> > registry;
+  return registry;
+}
+
+}  // namespace
+
+RigidBodyStateCache::RigidBodyStateCache(physics::LinkPtr link)
+    : link_(link),
+      world_(link->GetWorld()),
+      last_update_iteration_(0),
+      updated_(false) {}
+
+std::shared_ptr<RigidBodyStateCache> RigidBodyStateCache::Get(
+    const physics::LinkPtr& link) {
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  std::weak_ptr<RigidBodyStateCache>& entry = Registry()[link.get()];
+  std::shared_ptr<RigidBodyStateCache> cache = entry.lock();
+  if (!cache) {
+    cache = std::make_shared<RigidBodyStateCache>(link);
+    entry = cache;
+  }
+  return cache;
+}
+
+RigidBodyState RigidBodyStateCache::State() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const uint64_t iteration = world_->Iterations();
+  if (updated_ && iteration == last_update_iteration_) {
+    return state_;
+  }
+  updated_ = true;
+  last_update_iteration_ = iteration;
+
+  state_.world_pose = link_->WorldPose();
+  state_.world_cog_pose = link_->WorldCoGPose();
+  state_.world_linear_vel = link_->WorldLinearVel();
+  state_.world_angular_vel = link_->WorldAngularVel();
+  state_.world_linear_accel = link_->WorldLinearAccel();
+  // The relative quantities are the world ones expressed in the link frame,
+  // which saves querying the physics engine a second time.
+  const ignition::math::Quaterniond& rotation = state_.world_pose.Rot();
+  state_.relative_linear_vel = rotation.RotateVectorReverse(state_.world_linear_vel);
+  state_.relative_angular_vel =
+      rotation.RotateVectorReverse(state_.world_angular_vel);
+  state_.relative_linear_accel =
+      rotation.RotateVectorReverse(state_.world_linear_accel);
+  return state_;
+}
+
+}  // namespace gazebo
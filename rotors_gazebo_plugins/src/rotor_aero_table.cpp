@@ -0,0 +1,199 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/rotor_aero_table.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+
+namespace gazebo {
+
+namespace {
+
+std::mutex& RegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::map<std::string, std::weak_ptr<const RotorAeroTable> >& Registry() {
+  static std::map<std::string, std::weak_ptr<const RotorAeroTable> > registry;
+  return registry;
+}
+
+void ReadLine(std::ifstream& fin, std::vector<double>* values) {
+  double data;
+  while (fin >> data) {
+    values->push_back(data);
+    if (fin.peek() == '\n') break;
+  }
+}
+
+}  // namespace
+
+RotorAeroTable::RotorAeroTable() {
+  for (Axis& axis : axes_) {
+    axis.min = 0.0;
+    axis.inv_res = 0.0;
+    axis.n = 0;
+  }
+}
+
+std::shared_ptr<const RotorAeroTable> RotorAeroTable::Get(
+    const std::string& path) {
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  std::weak_ptr<const RotorAeroTable>& entry = Registry()[path];
+  std::shared_ptr<const RotorAeroTable> table = entry.lock();
+  if (!table) {
+    std::shared_ptr<RotorAeroTable> loaded = std::make_shared<RotorAeroTable>();
+    if (!loaded->LoadText(path)) {
+      return nullptr;
+    }
+    table = loaded;
+    entry = table;
+  }
+  return table;
+}
+
+bool RotorAeroTable::LoadText(const std::string& path) {
+  std::ifstream fin;
+  fin.open(path);
+  if (!fin.is_open()) {
+    return false;
+  }
+
+  static const char* kAxisNames[3] = {"rotor_speed", "axial_speed",
+                                      "perpendicular_speed"};
+  double min[3] = {0.0, 0.0, 0.0};
+  double res[3] = {0.0, 0.0, 0.0};
+  int n[3] = {0, 0, 0};
+  std::vector<double> thrust_coefficients;
+  std::vector<double> torque_coefficients;
+
+  std::string data_name;
+  while (fin >> data_name) {
+    bool known = false;
+    for (int axis = 0; axis < 3; ++axis) {
+      const std::string name = kAxisNames[axis];
+      if (data_name == "min_" + name + ":") {
+        fin >> min[axis];
+      } else if (data_name == "res_" + name + ":") {
+        fin >> res[axis];
+      } else if (data_name == "n_" + name + ":") {
+        fin >> n[axis];
+      } else {
+        continue;
+      }
+      known = true;
+    }
+    if (known) continue;
+    if (data_name == "thrust_coefficients:") {
+      ReadLine(fin, &thrust_coefficients);
+    } else if (data_name == "torque_coefficients:") {
+      ReadLine(fin, &torque_coefficients);
+    } else {
+      std::string rest_of_line;
+      getline(fin, rest_of_line);
+      std::cerr << "[rotor_aero_table] Invalid data name '" << data_name
+                << rest_of_line << "' in rotor table " << path
+                << ". Ignoring it.\n";
+    }
+  }
+  fin.close();
+
+  size_t num_vertices = 1;
+  for (int axis = 0; axis < 3; ++axis) {
+    if (n[axis] < 1 || (n[axis] > 1 && !(res[axis] > 0.0))) {
+      std::cerr << "[rotor_aero_table] Invalid " << kAxisNames[axis]
+                << " axis in rotor table " << path << ".\n";
+      return false;
+    }
+    num_vertices *= n[axis];
+  }
+  if (thrust_coefficients.size() != num_vertices ||
+      torque_coefficients.size() != num_vertices) {
+    std::cerr << "[rotor_aero_table] Rotor table " << path << " has "
+              << thrust_coefficients.size() << " thrust and "
+              << torque_coefficients.size() << " torque coefficients, "
+              << num_vertices << " expected.\n";
+    return false;
+  }
+
+  for (int axis = 0; axis < 3; ++axis) {
+    axes_[axis].min = min[axis];
+    axes_[axis].inv_res = n[axis] > 1 ? 1.0 / res[axis] : 0.0;
+    axes_[axis].n = n[axis];
+  }
+  coefficients_.resize(2 * num_vertices);
+  for (size_t i = 0; i < num_vertices; ++i) {
+    coefficients_[2 * i] = thrust_coefficients[i];
+    coefficients_[2 * i + 1] = torque_coefficients[i];
+  }
+  return true;
+}
+
+void RotorAeroTable::Axis::Locate(double value, int* index,
+                                  double* weight) const {
+  // Clamped to the table, the last vertex is reached with weight 1.
+  const double position = std::min(
+      std::max((value - min) * inv_res, 0.0), static_cast<double>(n - 1));
+  *index = std::min(static_cast<int>(position), std::max(n - 2, 0));
+  *weight = n > 1 ? position - *index : 0.0;
+}
+
+void RotorAeroTable::Lookup(double rotor_speed, double axial_speed,
+                            double perpendicular_speed,
+                            double* thrust_coefficient,
+                            double* torque_coefficient) const {
+  const double values[3] = {rotor_speed, axial_speed, perpendicular_speed};
+  int index[3];
+  double weight[3];
+  int stride[3];
+  for (int axis = 0; axis < 3; ++axis) {
+    axes_[axis].Locate(values[axis], &index[axis], &weight[axis]);
+    stride[axis] = axes_[axis].n > 1 ? 1 : 0;
+  }
+  const int n_perpendicular = axes_[2].n;
+  const int n_axial = axes_[1].n;
+
+  double thrust = 0.0;
+  double torque = 0.0;
+  for (int corner = 0; corner < 8; ++corner) {
+    const int di = (corner >> 2) & 1;
+    const int dj = (corner >> 1) & 1;
+    const int dk = corner & 1;
+    const double w = (di ? weight[0] : 1.0 - weight[0]) *
+                     (dj ? weight[1] : 1.0 - weight[1]) *
+                     (dk ? weight[2] : 1.0 - weight[2]);
+    const size_t vertex =
+        (static_cast<size_t>(index[0] + di * stride[0]) * n_axial + index[1] +
+         dj * stride[1]) * n_perpendicular + index[2] + dk * stride[2];
+    thrust += w * coefficients_[2 * vertex];
+    torque += w * coefficients_[2 * vertex + 1];
+  }
+  *thrust_coefficient = thrust;
+  *torque_coefficient = torque;
+}
+
+}  // namespace gazebo
@@ -0,0 +1,280 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/shm_ring.h"
+
+#include <cctype>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace gazebo {
+
+namespace {
+
+constexpr uint64_t kShmRingMagic = 0x474e495253524f52ull;  // "RORSRING"
+constexpr uint32_t kShmRingVersion = 1;
+constexpr std::size_t kCacheLineSize = 64;
+
+std::size_t RoundUpToCacheLine(std::size_t size) {
+  return (size + kCacheLineSize - 1) & ~(kCacheLineSize - 1);
+}
+
+void CopyFrameId(const std::string& frame_id, char* destination) {
+  std::strncpy(destination, frame_id.c_str(), kShmFrameIdSize - 1);
+  destination[kShmFrameIdSize - 1] = '\0';
+}
+
+}  // namespace
+
+/// \brief  Start of the segment, followed by the slots. A slot is the
+///         sequence number of its record followed by the record.
+struct ShmRing::Header {
+  /// \brief  Set last by the producer, once the header is complete.
+  std::atomic<uint64_t> magic;
+  uint32_t version;
+  uint32_t record_type;
+  uint32_t record_size;
+  uint32_t capacity;
+  uint64_t slot_size;
+  char frame_id[kShmFrameIdSize];
+  char child_frame_id[kShmFrameIdSize];
+  /// \brief  Number of records written, on its own cache line.
+  alignas(kCacheLineSize) std::atomic<uint64_t> write_count;
+};
+
+std::string ShmRingName(const std::string& gazebo_topic) {
+  std::string name = "/rotors_" + std::to_string(getpid());
+  for (char c : gazebo_topic) {
+    if (std::isalnum(static_cast<unsigned char>(c))) {
+      name += c;
+    } else if (name.back() != '_') {
+      name += '_';
+    }
+  }
+  return name;
+}
+
+ShmRing::ShmRing()
+    : owner_(false),
+      memory_(nullptr),
+      memory_size_(0),
+      header_(nullptr),
+      slot_size_(0),
+      record_size_(0),
+      index_mask_(0),
+      read_count_(0),
+      num_lost_(0) {}
+
+ShmRing::~ShmRing() { Close(); }
+
+bool ShmRing::Create(const std::string& name, uint32_t record_type,
+                     uint32_t record_size, uint32_t capacity,
+                     const std::string& frame_id,
+                     const std::string& child_frame_id) {
+  Close();
+
+  uint32_t rounded_capacity = 1;
+  while (rounded_capacity < capacity) {
+    rounded_capacity <<= 1;
+  }
+  const std::size_t slot_size =
+      RoundUpToCacheLine(sizeof(std::atomic<uint64_t>) + record_size);
+  const std::size_t size =
+      RoundUpToCacheLine(sizeof(Header)) + rounded_capacity * slot_size;
+
+  shm_unlink(name.c_str());
+  const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    return false;
+  }
+  if (ftruncate(fd, size) != 0) {
+    close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+  void* memory =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  name_ = name;
+  owner_ = true;
+  memory_ = memory;
+  memory_size_ = size;
+  slot_size_ = slot_size;
+  record_size_ = record_size;
+  index_mask_ = rounded_capacity - 1;
+
+  // The segment is zero filled, so all slots start out empty.
+  header_ = new (memory_) Header;
+  header_->version = kShmRingVersion;
+  header_->record_type = record_type;
+  header_->record_size = record_size;
+  header_->capacity = rounded_capacity;
+  header_->slot_size = slot_size;
+  CopyFrameId(frame_id, header_->frame_id);
+  CopyFrameId(child_frame_id, header_->child_frame_id);
+  header_->write_count.store(0, std::memory_order_relaxed);
+  for (uint64_t i = 0; i < rounded_capacity; ++i) {
+    new (SlotSequence(i)) std::atomic<uint64_t>(0);
+  }
+  header_->magic.store(kShmRingMagic, std::memory_order_release);
+  return true;
+}
+
+bool ShmRing::Open(const std::string& name, uint32_t record_type,
+                   uint32_t record_size) {
+  Close();
+
+  const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 ||
+      static_cast<std::size_t>(status.st_size) < sizeof(Header)) {
+    close(fd);
+    return false;
+  }
+  const std::size_t size = status.st_size;
+  void* memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    return false;
+  }
+
+  Header* header = static_cast<Header*>(memory);
+  if (header->magic.load(std::memory_order_acquire) != kShmRingMagic ||
+      header->version != kShmRingVersion ||
+      header->record_type != record_type ||
+      header->record_size != record_size ||
+      RoundUpToCacheLine(sizeof(Header)) +
+              header->capacity * header->slot_size > size) {
+    munmap(memory, size);
+    return false;
+  }
+
+  name_ = name;
+  owner_ = false;
+  memory_ = memory;
+  memory_size_ = size;
+  header_ = header;
+  slot_size_ = header->slot_size;
+  record_size_ = record_size;
+  index_mask_ = header->capacity - 1;
+  read_count_ = header->write_count.load(std::memory_order_acquire);
+  num_lost_ = 0;
+  return true;
+}
+
+void ShmRing::Close() {
+  if (!memory_) {
+    return;
+  }
+  munmap(memory_, memory_size_);
+  if (owner_) {
+    shm_unlink(name_.c_str());
+  }
+  memory_ = nullptr;
+  header_ = nullptr;
+  owner_ = false;
+}
+
+std::atomic<uint64_t>* ShmRing::SlotSequence(uint64_t index) const {
+  char* slots = static_cast<char*>(memory_) + RoundUpToCacheLine(sizeof(Header));
+  return reinterpret_cast<std::atomic<uint64_t>*>(
+      slots + (index & index_mask_) * slot_size_);
+}
+
+const char* ShmRing::SlotData(uint64_t index) const {
+  return reinterpret_cast<const char*>(SlotSequence(index)) +
+         sizeof(std::atomic<uint64_t>);
+}
+
+void ShmRing::Write(const void* record) {
+  const uint64_t index = header_->write_count.load(std::memory_order_relaxed);
+  std::atomic<uint64_t>* sequence = SlotSequence(index);
+  sequence->store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(const_cast<char*>(SlotData(index)), record, record_size_);
+  sequence->store(2 * index + 2, std::memory_order_release);
+  header_->write_count.store(index + 1, std::memory_order_release);
+}
+
+bool ShmRing::Read(void* record) {
+  const uint64_t write_count =
+      header_->write_count.load(std::memory_order_acquire);
+  const uint64_t capacity = index_mask_ + 1;
+  while (read_count_ < write_count) {
+    if (write_count - read_count_ > capacity) {
+      num_lost_ += write_count - capacity - read_count_;
+      read_count_ = write_count - capacity;
+    }
+    const uint64_t index = read_count_++;
+    const uint64_t expected = 2 * index + 2;
+    const std::atomic<uint64_t>* sequence = SlotSequence(index);
+    if (sequence->load(std::memory_order_acquire) != expected) {
+      // Overwritten since write_count was read.
+      ++num_lost_;
+      continue;
+    }
+    std::memcpy(record, SlotData(index), record_size_);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence->load(std::memory_order_relaxed) != expected) {
+      // Overwritten while it was copied.
+      ++num_lost_;
+      continue;
+    }
+    return true;
+  }
+  return false;
+}
+
+bool ShmRing::ReadLatest(void* record) {
+  while (true) {
+    const uint64_t write_count =
+        header_->write_count.load(std::memory_order_acquire);
+    if (write_count == read_count_) {
+      return false;
+    }
+    read_count_ = write_count - 1;
+    if (Read(record)) {
+      return true;
+    }
+  }
+}
+
+const char* ShmRing::frame_id() const {
+  return header_ ? header_->frame_id : "";
+}
+
+const char* ShmRing::child_frame_id() const {
+  return header_ ? header_->child_frame_id : "";
+}
+
+}  // namespace gazebo
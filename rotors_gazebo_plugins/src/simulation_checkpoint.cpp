@@ -0,0 +1,390 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/simulation_checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace gazebo {
+
+namespace {
+
+static const char kCheckpointMagic[8] = {'R', 'O', 'T', 'O', 'R', 'S', 'C', 'K'};
+static constexpr uint32_t kCheckpointVersion = 1;
+
+std::mutex& RegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::map<const physics::World*, std::weak_ptr<SimulationCheckpoint> >& Registry() {
+  static std::map<const physics::World*, std::weak_ptr<SimulationCheckpoint> > registry;
+  return registry;
+}
+
+/// \brief  Appends a model and all models nested in it.
+void CollectModels(const physics::ModelPtr& model, physics::Model_V* models) {
+  models->push_back(model);
+  for (const physics::ModelPtr& nested : model->NestedModels()) {
+    CollectModels(nested, models);
+  }
+}
+
+}  // namespace
+
+CheckpointConnection::CheckpointConnection(
+    std::shared_ptr<SimulationCheckpoint> checkpoint, int id)
+    : checkpoint_(checkpoint), id_(id) {}
+
+CheckpointConnection::~CheckpointConnection() {
+  checkpoint_->Unregister(id_);
+}
+
+SimulationCheckpoint::SimulationCheckpoint(physics::WorldPtr world)
+    : world_(world), next_id_(0) {}
+
+std::shared_ptr<SimulationCheckpoint> SimulationCheckpoint::Get(
+    const physics::WorldPtr& world) {
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  std::weak_ptr<SimulationCheckpoint>& entry = Registry()[world.get()];
+  std::shared_ptr<SimulationCheckpoint> checkpoint = entry.lock();
+  if (!checkpoint) {
+    checkpoint = std::make_shared<SimulationCheckpoint>(world);
+    entry = checkpoint;
+  }
+  return checkpoint;
+}
+
+CheckpointConnectionPtr SimulationCheckpoint::Connect(
+    const physics::WorldPtr& world, const std::string& name,
+    const SaveCallback& save, const RestoreCallback& restore) {
+  std::shared_ptr<SimulationCheckpoint> checkpoint = Get(world);
+  const int id = checkpoint->Register(name, save, restore);
+  return std::make_shared<CheckpointConnection>(checkpoint, id);
+}
+
+int SimulationCheckpoint::Register(const std::string& name,
+                                   const SaveCallback& save,
+                                   const RestoreCallback& restore) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& entry : entries_) {
+    if (entry.second.name == name) {
+      gzerr << "[simulation_checkpoint] The state of \"" << name
+            << "\" is registered twice, only one of them is restored.\n";
+      break;
+    }
+  }
+  Entry entry;
+  entry.name = name;
+  entry.save = save;
+  entry.restore = restore;
+  entries_[next_id_] = entry;
+  return next_id_++;
+}
+
+void SimulationCheckpoint::Unregister(int id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.erase(id);
+}
+
+bool SimulationCheckpoint::Save(std::string* blob) {
+  CheckpointWriter writer;
+  writer.WriteArray(kCheckpointMagic, sizeof(kCheckpointMagic));
+  writer.Write(kCheckpointVersion);
+  SaveWorld(&writer);
+
+  // Every section is written to its own buffer first, so that a plugin
+  // reading less than it wrote cannot shift the sections behind it.
+  std::lock_guard<std::mutex> lock(mutex_);
+  writer.Write<uint32_t>(entries_.size());
+  CheckpointWriter section;
+  for (const auto& entry : entries_) {
+    section.Clear();
+    entry.second.save(&section);
+    writer.WriteString(entry.second.name);
+    writer.WriteString(section.data());
+  }
+  *blob = writer.data();
+  return true;
+}
+
+bool SimulationCheckpoint::Restore(const std::string& blob) {
+  CheckpointReader reader(blob);
+  char magic[sizeof(kCheckpointMagic)];
+  uint32_t version = 0;
+  if (!reader.ReadArray(magic, sizeof(magic)) ||
+      std::memcmp(magic, kCheckpointMagic, sizeof(magic)) != 0 ||
+      !reader.Read(&version) || version != kCheckpointVersion) {
+    gzerr << "[simulation_checkpoint] The blob is not a checkpoint of version "
+          << kCheckpointVersion << ".\n";
+    return false;
+  }
+  bool success = RestoreWorld(&reader);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::map<std::string, const Entry*> entries;
+  for (const auto& entry : entries_) {
+    entries[entry.second.name] = &entry.second;
+  }
+  uint32_t num_sections = 0;
+  reader.Read(&num_sections);
+  std::string name, data;
+  for (uint32_t i = 0; i < num_sections && reader.ok(); ++i) {
+    if (!reader.ReadString(&name) || !reader.ReadString(&data)) {
+      break;
+    }
+    auto entry = entries.find(name);
+    if (entry == entries.end()) {
+      gzwarn << "[simulation_checkpoint] No plugin to restore \"" << name
+             << "\" in.\n";
+      continue;
+    }
+    CheckpointReader section(data);
+    if (!entry->second->restore(&section) || !section.ok()) {
+      gzerr << "[simulation_checkpoint] Could not restore \"" << name
+            << "\".\n";
+      success = false;
+    }
+    entries.erase(entry);
+  }
+  if (!reader.ok() || !reader.AtEnd()) {
+    gzerr << "[simulation_checkpoint] The checkpoint is truncated.\n";
+    return false;
+  }
+  for (const auto& entry : entries) {
+    gzwarn << "[simulation_checkpoint] The checkpoint has no state for \""
+           << entry.first << "\", it keeps its current state.\n";
+  }
+  return success;
+}
+
+void SimulationCheckpoint::SaveWorld(CheckpointWriter* writer) {
+  WriteCheckpoint(world_->SimTime(), writer);
+  writer->Write<uint64_t>(world_->Iterations());
+
+  physics::Model_V models;
+  for (const physics::ModelPtr& model : world_->Models()) {
+    if (!model->IsStatic()) {
+      CollectModels(model, &models);
+    }
+  }
+  writer->Write<uint32_t>(models.size());
+  for (const physics::ModelPtr& model : models) {
+    writer->WriteString(model->GetScopedName());
+
+    const physics::Joint_V& joints = model->GetJoints();
+    writer->Write<uint32_t>(joints.size());
+    for (const physics::JointPtr& joint : joints) {
+      writer->WriteString(joint->GetScopedName());
+      writer->Write<uint32_t>(joint->DOF());
+      for (unsigned int i = 0; i < joint->DOF(); ++i) {
+        writer->Write(joint->Position(i));
+        writer->Write(joint->GetVelocity(i));
+      }
+    }
+
+    const physics::Link_V& links = model->GetLinks();
+    writer->Write<uint32_t>(links.size());
+    for (const physics::LinkPtr& link : links) {
+      writer->WriteString(link->GetScopedName());
+      WriteCheckpoint(link->WorldPose(), writer);
+      WriteCheckpoint(link->WorldLinearVel(), writer);
+      WriteCheckpoint(link->WorldAngularVel(), writer);
+    }
+  }
+}
+
+bool SimulationCheckpoint::RestoreWorld(CheckpointReader* reader) {
+  common::Time sim_time;
+  uint64_t iterations = 0;
+  uint32_t num_models = 0;
+  if (!ReadCheckpoint(reader, &sim_time) || !reader->Read(&iterations) ||
+      !reader->Read(&num_models)) {
+    return false;
+  }
+
+  boost::recursive_mutex::scoped_lock physics_lock(
+      *world_->Physics()->GetPhysicsUpdateMutex());
+  world_->SetSimTime(sim_time);
+  world_->SetIterations(iterations);
+
+  bool success = true;
+  std::string name;
+  for (uint32_t m = 0; m < num_models && reader->ok(); ++m) {
+    reader->ReadString(&name);
+    physics::ModelPtr model = world_->ModelByName(name);
+    if (!model) {
+      gzerr << "[simulation_checkpoint] The world has no model \"" << name
+            << "\".\n";
+      success = false;
+    }
+
+    // The joints are set first, which moves their child links, and the links
+    // are then put exactly where they were.
+    uint32_t num_joints = 0;
+    reader->Read(&num_joints);
+    for (uint32_t j = 0; j < num_joints && reader->ok(); ++j) {
+      uint32_t dof = 0;
+      reader->ReadString(&name);
+      reader->Read(&dof);
+      physics::JointPtr joint;
+      if (model) {
+        joint = model->GetJoint(name);
+      }
+      for (uint32_t i = 0; i < dof && reader->ok(); ++i) {
+        double position = 0.0, velocity = 0.0;
+        reader->Read(&position);
+        reader->Read(&velocity);
+        if (joint && i < joint->DOF()) {
+          joint->SetPosition(i, position);
+          joint->SetVelocity(i, velocity);
+        }
+      }
+    }
+
+    uint32_t num_links = 0;
+    reader->Read(&num_links);
+    for (uint32_t l = 0; l < num_links && reader->ok(); ++l) {
+      ignition::math::Pose3d pose;
+      ignition::math::Vector3d linear_velocity, angular_velocity;
+      reader->ReadString(&name);
+      ReadCheckpoint(reader, &pose);
+      ReadCheckpoint(reader, &linear_velocity);
+      ReadCheckpoint(reader, &angular_velocity);
+      physics::LinkPtr link;
+      if (model) {
+        link = model->GetLink(name);
+      }
+      if (link) {
+        link->SetWorldPose(pose);
+        link->SetLinearVel(linear_velocity);
+        link->SetAngularVel(angular_velocity);
+      } else if (model) {
+        gzerr << "[simulation_checkpoint] The model \"" << model->GetScopedName()
+              << "\" has no link \"" << name << "\".\n";
+        success = false;
+      }
+    }
+  }
+  return success && reader->ok();
+}
+
+bool SimulationCheckpoint::WriteFile(const std::string& path,
+                                     const std::string& blob) {
+  const std::string temporary_path = path + ".tmp";
+  {
+    std::ofstream file(temporary_path.c_str(),
+                       std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write(blob.data(), blob.size());
+    file.close();
+    if (!file) {
+      std::remove(temporary_path.c_str());
+      return false;
+    }
+  }
+  return std::rename(temporary_path.c_str(), path.c_str()) == 0;
+}
+
+bool SimulationCheckpoint::ReadFile(const std::string& path,
+                                    std::string* blob) {
+  std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  blob->assign(std::istreambuf_iterator<char>(file),
+               std::istreambuf_iterator<char>());
+  return !file.bad();
+}
+
+void WriteCheckpoint(const common::Time& time, CheckpointWriter* writer) {
+  writer->Write<int32_t>(time.sec);
+  writer->Write<int32_t>(time.nsec);
+}
+
+void WriteCheckpoint(const ignition::math::Vector3d& vector,
+                     CheckpointWriter* writer) {
+  const double values[3] = {vector.X(), vector.Y(), vector.Z()};
+  writer->WriteArray(values, 3);
+}
+
+void WriteCheckpoint(const ignition::math::Quaterniond& quaternion,
+                     CheckpointWriter* writer) {
+  const double values[4] = {quaternion.W(), quaternion.X(), quaternion.Y(),
+                            quaternion.Z()};
+  writer->WriteArray(values, 4);
+}
+
+void WriteCheckpoint(const ignition::math::Pose3d& pose,
+                     CheckpointWriter* writer) {
+  WriteCheckpoint(pose.Pos(), writer);
+  WriteCheckpoint(pose.Rot(), writer);
+}
+
+void WriteCheckpoint(const Eigen::Vector3d& vector, CheckpointWriter* writer) {
+  writer->WriteArray(vector.data(), 3);
+}
+
+bool ReadCheckpoint(CheckpointReader* reader, common::Time* time) {
+  int32_t sec = 0, nsec = 0;
+  if (!reader->Read(&sec) || !reader->Read(&nsec)) {
+    return false;
+  }
+  time->Set(sec, nsec);
+  return true;
+}
+
+bool ReadCheckpoint(CheckpointReader* reader, ignition::math::Vector3d* vector) {
+  double values[3];
+  if (!reader->ReadArray(values, 3)) {
+    return false;
+  }
+  vector->Set(values[0], values[1], values[2]);
+  return true;
+}
+
+bool ReadCheckpoint(CheckpointReader* reader,
+                    ignition::math::Quaterniond* quaternion) {
+  double values[4];
+  if (!reader->ReadArray(values, 4)) {
+    return false;
+  }
+  quaternion->Set(values[0], values[1], values[2], values[3]);
+  return true;
+}
+
+bool ReadCheckpoint(CheckpointReader* reader, ignition::math::Pose3d* pose) {
+  ignition::math::Vector3d position;
+  ignition::math::Quaterniond rotation;
+  if (!ReadCheckpoint(reader, &position) || !ReadCheckpoint(reader, &rotation)) {
+    return false;
+  }
+  pose->Set(position, rotation);
+  return true;
+}
+
+bool ReadCheckpoint(CheckpointReader* reader, Eigen::Vector3d* vector) {
+  return reader->ReadArray(vector->data(), 3);
+}
+
+}  // namespace gazebo
@@ -0,0 +1,234 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/sky_visibility_map.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <gazebo/common/Timer.hh>
+
+namespace gazebo {
+
+namespace {
+
+/// \brief Angle between the azimuths of two consecutive satellites [rad],
+///        spreads any number of them evenly around the sky.
+static constexpr double kGoldenAngle = 2.399963229728653;
+
+std::mutex& RegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::map<std::string, std::weak_ptr<const SkyVisibilityMap> >& Registry() {
+  static std::map<std::string, std::weak_ptr<const SkyVisibilityMap> > registry;
+  return registry;
+}
+
+}  // namespace
+
+SkyVisibilityMap::SkyVisibilityMap(const std::vector<GeometryBound>& bounds,
+                                   const SkyVisibilityParams& params,
+                                   int num_threads)
+    : params_(params),
+      min_x_(0.0),
+      min_y_(0.0),
+      num_cells_x_(0),
+      num_cells_y_(0),
+      max_height_(-std::numeric_limits<double>::infinity()) {
+  params_.num_satellites = std::min(std::max(params_.num_satellites, 1), 255);
+  params_.num_levels = std::max(params_.num_levels, 1);
+  if (params_.level_spacing <= 0.0) {
+    params_.num_levels = 1;
+    params_.level_spacing = 1.0;
+  }
+  params_.resolution = std::max(params_.resolution, 1.0e-3);
+
+  // Only boxes reaching above the lowest level can hide a satellite.
+  std::vector<const GeometryBound*> blocking;
+  double max_x = -std::numeric_limits<double>::infinity();
+  double max_y = -std::numeric_limits<double>::infinity();
+  min_x_ = std::numeric_limits<double>::infinity();
+  min_y_ = std::numeric_limits<double>::infinity();
+  for (const GeometryBound& bound : bounds) {
+    if (bound.is_plane || bound.max.Z() <= params_.min_height) continue;
+    blocking.push_back(&bound);
+    min_x_ = std::min(min_x_, bound.min.X());
+    min_y_ = std::min(min_y_, bound.min.Y());
+    max_x = std::max(max_x, bound.max.X());
+    max_y = std::max(max_y, bound.max.Y());
+    max_height_ = std::max(max_height_, bound.max.Z());
+  }
+  if (blocking.empty()) return;
+
+  min_x_ -= params_.margin;
+  min_y_ -= params_.margin;
+  max_x += params_.margin;
+  max_y += params_.margin;
+  while (true) {
+    num_cells_x_ = std::max(
+        1, static_cast<int>(std::ceil((max_x - min_x_) / params_.resolution)));
+    num_cells_y_ = std::max(
+        1, static_cast<int>(std::ceil((max_y - min_y_) / params_.resolution)));
+    if (static_cast<int64_t>(num_cells_x_) * num_cells_y_ <=
+        kMaxSkyMapCellsPerLevel) {
+      break;
+    }
+    params_.resolution *= 2.0;
+    gzwarn << "[sky_visibility_map] The world is too large for the sky map"
+           << " resolution, coarsening it to " << params_.resolution
+           << " m.\n";
+  }
+
+  std::vector<ignition::math::Vector3d> directions;
+  const double sin_min_elevation =
+      std::sin(params_.satellite_min_elevation * M_PI / 180.0);
+  for (int i = 0; i < params_.num_satellites; ++i) {
+    // Evenly spaced in sin(elevation), so that every satellite covers the
+    // same solid angle of the sky.
+    const double sin_elevation =
+        sin_min_elevation +
+        (1.0 - sin_min_elevation) * (i + 0.5) / params_.num_satellites;
+    const double cos_elevation =
+        std::sqrt(1.0 - sin_elevation * sin_elevation);
+    const double azimuth = i * kGoldenAngle;
+    directions.emplace_back(cos_elevation * std::cos(azimuth),
+                            cos_elevation * std::sin(azimuth), sin_elevation);
+  }
+
+  const int64_t level_size =
+      static_cast<int64_t>(num_cells_x_) * num_cells_y_;
+  visible_satellites_.assign(level_size * params_.num_levels, 0);
+
+  common::Timer timer;
+  timer.Start();
+  if (num_threads <= 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  num_threads = std::min(num_threads, num_cells_y_);
+
+  // The rows of the grid are handed out to the workers one at a time, every
+  // cell is written by exactly one of them.
+  std::atomic<int> next_row(0);
+  std::vector<std::thread> workers;
+  for (int thread = 0; thread < num_threads; ++thread) {
+    workers.emplace_back([&]() {
+      std::vector<const GeometryBound*> candidates;
+      for (int iy = next_row++; iy < num_cells_y_; iy = next_row++) {
+        const double y = min_y_ + (iy + 0.5) * params_.resolution;
+        for (int level = 0; level < params_.num_levels; ++level) {
+          const double z = params_.min_height + level * params_.level_spacing;
+          candidates.clear();
+          for (const GeometryBound* bound : blocking) {
+            if (bound->max.Z() > z) candidates.push_back(bound);
+          }
+
+          for (int ix = 0; ix < num_cells_x_; ++ix) {
+            const ignition::math::Vector3d origin(
+                min_x_ + (ix + 0.5) * params_.resolution, y, z);
+            int num_visible = 0;
+            for (const ignition::math::Vector3d& direction : directions) {
+              bool hidden = false;
+              for (const GeometryBound* bound : candidates) {
+                if (bound->IntersectsRay(origin, direction)) {
+                  hidden = true;
+                  break;
+                }
+              }
+              if (!hidden) ++num_visible;
+            }
+            visible_satellites_[level * level_size +
+                                static_cast<int64_t>(iy) * num_cells_x_ + ix] =
+                static_cast<uint8_t>(num_visible);
+          }
+        }
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+
+  gzmsg << "[sky_visibility_map] Cast the satellite rays of " << num_cells_x_
+        << " x " << num_cells_y_ << " x " << params_.num_levels
+        << " cells against " << blocking.size() << " collision bounds in "
+        << timer.GetElapsed().Double() << " s with " << num_threads
+        << " threads.\n";
+}
+
+std::shared_ptr<const SkyVisibilityMap> SkyVisibilityMap::Get(
+    const physics::WorldPtr& world, const SkyVisibilityParams& params,
+    int num_threads) {
+  std::ostringstream key;
+  key << std::setprecision(17) << world->Name() << " " << params.resolution
+      << " " << params.margin << " " << params.num_levels << " "
+      << params.level_spacing << " " << params.min_height << " "
+      << params.num_satellites << " " << params.satellite_min_elevation;
+
+  // Plugins asking for the same map wait for the first one to compute it.
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  std::weak_ptr<const SkyVisibilityMap>& entry = Registry()[key.str()];
+  std::shared_ptr<const SkyVisibilityMap> map = entry.lock();
+  if (!map) {
+    std::vector<GeometryBound> bounds;
+    {
+      // Keep the world from stepping while the bounds are read.
+      boost::recursive_mutex::scoped_lock physics_lock(
+          *world->Physics()->GetPhysicsUpdateMutex());
+      bounds = CollectGeometryBounds(world, true);
+    }
+    map = std::make_shared<SkyVisibilityMap>(bounds, params, num_threads);
+    entry = map;
+  }
+  return map;
+}
+
+int SkyVisibilityMap::VisibleSatellites(
+    const ignition::math::Vector3d& position) const {
+  if (visible_satellites_.empty() || position.Z() >= max_height_) {
+    return params_.num_satellites;
+  }
+  const int ix = static_cast<int>(
+      std::floor((position.X() - min_x_) / params_.resolution));
+  const int iy = static_cast<int>(
+      std::floor((position.Y() - min_y_) / params_.resolution));
+  if (ix < 0 || ix >= num_cells_x_ || iy < 0 || iy >= num_cells_y_) {
+    return params_.num_satellites;
+  }
+  const int level = std::min(
+      std::max(static_cast<int>(std::lround(
+                   (position.Z() - params_.min_height) / params_.level_spacing)),
+               0),
+      params_.num_levels - 1);
+  return visible_satellites_[(static_cast<int64_t>(level) * num_cells_y_ + iy) *
+                                 num_cells_x_ +
+                             ix];
+}
+
+}  // namespace gazebo
@@ -0,0 +1,350 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/swarm_shard_link.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstring>
+#include <sstream>
+
+#include <gazebo/common/Console.hh>
+
+namespace gazebo {
+
+namespace {
+
+/// \brief Number of arrays of a telemetry message with one entry per
+///        vehicle, besides the names and the motor counts.
+static constexpr int kNumStateFields = 13;
+
+typedef google::protobuf::RepeatedField<double> DoubleField;
+
+/// \brief The per vehicle arrays of a telemetry message, in the order of
+///        StateValue().
+std::array<const DoubleField*, kNumStateFields> StateFields(
+    const gz_mav_msgs::SwarmTelemetry& msg) {
+  return {{&msg.position_x(), &msg.position_y(), &msg.position_z(),
+           &msg.orientation_w(), &msg.orientation_x(), &msg.orientation_y(),
+           &msg.orientation_z(), &msg.linear_velocity_x(),
+           &msg.linear_velocity_y(), &msg.linear_velocity_z(),
+           &msg.angular_velocity_x(), &msg.angular_velocity_y(),
+           &msg.angular_velocity_z()}};
+}
+
+std::array<DoubleField*, kNumStateFields> MutableStateFields(
+    gz_mav_msgs::SwarmTelemetry* msg) {
+  return {{msg->mutable_position_x(), msg->mutable_position_y(),
+           msg->mutable_position_z(), msg->mutable_orientation_w(),
+           msg->mutable_orientation_x(), msg->mutable_orientation_y(),
+           msg->mutable_orientation_z(), msg->mutable_linear_velocity_x(),
+           msg->mutable_linear_velocity_y(), msg->mutable_linear_velocity_z(),
+           msg->mutable_angular_velocity_x(), msg->mutable_angular_velocity_y(),
+           msg->mutable_angular_velocity_z()}};
+}
+
+/// \brief Value k of the state of a vehicle, in the order of StateFields().
+double* StateValue(SwarmShardVehicle* vehicle, int k) {
+  if (k < 3) return &vehicle->position[k];
+  if (k < 7) return &vehicle->orientation[k - 3];
+  if (k < 10) return &vehicle->linear_velocity[k - 7];
+  return &vehicle->angular_velocity[k - 10];
+}
+
+std::mutex& RegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::map<std::string, std::weak_ptr<SwarmShardLink> >& Registry() {
+  static std::map<std::string, std::weak_ptr<SwarmShardLink> > registry;
+  return registry;
+}
+
+}  // namespace
+
+SwarmShardLink::SwarmShardLink()
+    : shard_id_(0),
+      fd_(-1),
+      receive_thread_running_(false),
+      num_invalid_datagrams_(0) {}
+
+SwarmShardLink::~SwarmShardLink() {
+  receive_thread_running_ = false;
+  if (receive_thread_.joinable()) {
+    receive_thread_.join();
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+std::vector<std::string> SwarmShardLink::ParsePeers(const std::string& peers) {
+  std::istringstream stream(peers);
+  std::vector<std::string> addresses;
+  std::string address;
+  while (stream >> address) {
+    addresses.push_back(address);
+  }
+  return addresses;
+}
+
+bool SwarmShardLink::Open(uint32_t shard_id, int port,
+                          const std::vector<std::string>& peers) {
+  if (fd_ >= 0) {
+    return true;
+  }
+  shard_id_ = shard_id;
+
+  for (const std::string& peer : peers) {
+    const std::size_t colon = peer.rfind(':');
+    if (colon == std::string::npos) {
+      gzerr << "[swarm_shard_link] Peer \"" << peer
+            << "\" is not of the form host:port.\n";
+      return false;
+    }
+    const std::string host = peer.substr(0, colon);
+    const std::string service = peer.substr(colon + 1);
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), service.c_str(), &hints, &result) != 0 ||
+        result == nullptr) {
+      gzerr << "[swarm_shard_link] Can't resolve peer \"" << peer << "\".\n";
+      return false;
+    }
+    struct sockaddr_in address;
+    std::memcpy(&address, result->ai_addr, sizeof(address));
+    freeaddrinfo(result);
+    peers_.push_back(address);
+  }
+
+  if ((fd_ = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+    gzerr << "[swarm_shard_link] create socket failed\n";
+    return false;
+  }
+  struct sockaddr_in myaddr;
+  std::memset(&myaddr, 0, sizeof(myaddr));
+  myaddr.sin_family = AF_INET;
+  myaddr.sin_addr.s_addr = htonl(INADDR_ANY);
+  myaddr.sin_port = htons(port);
+  if (bind(fd_, reinterpret_cast<struct sockaddr*>(&myaddr), sizeof(myaddr)) <
+      0) {
+    gzerr << "[swarm_shard_link] bind to port " << port << " failed\n";
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
+
+  receive_thread_running_ = true;
+  receive_thread_ = std::thread(&SwarmShardLink::ReceiveThread, this);
+  gzmsg << "[swarm_shard_link] Shard " << shard_id_ << " listening on port "
+        << port << ", sending to " << peers_.size() << " peers.\n";
+  return true;
+}
+
+void SwarmShardLink::Send(const gz_mav_msgs::SwarmTelemetry& telemetry) {
+  if (fd_ < 0 || peers_.empty()) {
+    return;
+  }
+  const int num_vehicles = telemetry.name_size();
+  if (telemetry.num_motors_size() != num_vehicles) {
+    return;
+  }
+  const std::array<const DoubleField*, kNumStateFields> fields =
+      StateFields(telemetry);
+
+  // Every datagram holds complete vehicles, so that the receiver can store
+  // them one datagram at a time.
+  int begin = 0;
+  int motor_begin = 0;
+  do {
+    datagram_.Clear();
+    datagram_.mutable_header()->CopyFrom(telemetry.header());
+    datagram_.set_shard(shard_id_);
+    // The header, shard and the tags and lengths of the packed arrays.
+    std::size_t size = telemetry.header().frame_id().size() + 32 +
+                       4 * (kNumStateFields + 3);
+    int end = begin;
+    int motor_end = motor_begin;
+    while (end < num_vehicles) {
+      const std::size_t vehicle_size =
+          (kNumStateFields + telemetry.num_motors(end)) * sizeof(double) +
+          telemetry.name(end).size() + 8;
+      if (end > begin && size + vehicle_size > kSwarmShardMaxDatagramSize) {
+        break;
+      }
+      size += vehicle_size;
+      motor_end += telemetry.num_motors(end);
+      ++end;
+    }
+
+    const std::array<DoubleField*, kNumStateFields> datagram_fields =
+        MutableStateFields(&datagram_);
+    for (int i = begin; i < end; ++i) {
+      datagram_.add_name(telemetry.name(i));
+      datagram_.add_num_motors(telemetry.num_motors(i));
+      for (int k = 0; k < kNumStateFields; ++k) {
+        datagram_fields[k]->Add(fields[k]->Get(i));
+      }
+    }
+    for (int m = motor_begin; m < motor_end && m < telemetry.motor_speed_size();
+         ++m) {
+      datagram_.add_motor_speed(telemetry.motor_speed(m));
+    }
+    SendDatagram(datagram_);
+    begin = end;
+    motor_begin = motor_end;
+  } while (begin < num_vehicles);
+}
+
+void SwarmShardLink::SendDatagram(const gz_mav_msgs::SwarmTelemetry& datagram) {
+  if (!datagram.SerializeToString(&send_buffer_)) {
+    return;
+  }
+  for (const struct sockaddr_in& peer : peers_) {
+    // A datagram lost to a full socket buffer is replaced by the next one.
+    sendto(fd_, send_buffer_.data(), send_buffer_.size(), MSG_DONTWAIT,
+           reinterpret_cast<const struct sockaddr*>(&peer), sizeof(peer));
+  }
+}
+
+void SwarmShardLink::ReceiveThread() {
+  std::vector<char> buffer(65536);
+  gz_mav_msgs::SwarmTelemetry telemetry;
+  struct pollfd fds[1];
+  fds[0].fd = fd_;
+  fds[0].events = POLLIN;
+
+  while (receive_thread_running_) {
+    if (poll(fds, 1, kSwarmShardPollTimeoutMs) <= 0 ||
+        !(fds[0].revents & POLLIN)) {
+      continue;
+    }
+    const ssize_t length = recv(fd_, buffer.data(), buffer.size(), 0);
+    if (length <= 0) {
+      continue;
+    }
+    if (!telemetry.ParseFromArray(buffer.data(), length) ||
+        !telemetry.has_shard()) {
+      if (num_invalid_datagrams_++ % 1000 == 0) {
+        gzwarn << "[swarm_shard_link] Dropped " << num_invalid_datagrams_
+               << " datagrams that are not swarm telemetry.\n";
+      }
+      continue;
+    }
+    if (telemetry.shard() != shard_id_) {
+      Receive(telemetry);
+    }
+  }
+}
+
+void SwarmShardLink::Receive(const gz_mav_msgs::SwarmTelemetry& telemetry) {
+  const int num_vehicles = telemetry.name_size();
+  const std::array<const DoubleField*, kNumStateFields> fields =
+      StateFields(telemetry);
+  int num_motors = 0;
+  bool valid = telemetry.num_motors_size() == num_vehicles;
+  for (int k = 0; k < kNumStateFields && valid; ++k) {
+    valid = fields[k]->size() == num_vehicles;
+  }
+  for (int i = 0; i < num_vehicles && valid; ++i) {
+    num_motors += telemetry.num_motors(i);
+  }
+  if (!valid || telemetry.motor_speed_size() != num_motors) {
+    if (num_invalid_datagrams_++ % 1000 == 0) {
+      gzwarn << "[swarm_shard_link] Dropped " << num_invalid_datagrams_
+             << " datagrams with inconsistent arrays.\n";
+    }
+    return;
+  }
+
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  const double stamp = telemetry.header().stamp().sec() +
+                       telemetry.header().stamp().nsec() * 1e-9;
+  std::lock_guard<std::mutex> lock(vehicles_mutex_);
+  int motor = 0;
+  for (int i = 0; i < num_vehicles; ++i) {
+    SwarmShardVehicle& vehicle = vehicles_[telemetry.name(i)];
+    vehicle.name = telemetry.name(i);
+    vehicle.shard = telemetry.shard();
+    vehicle.stamp = stamp;
+    for (int k = 0; k < kNumStateFields; ++k) {
+      *StateValue(&vehicle, k) = fields[k]->Get(i);
+    }
+    vehicle.motor_speed.assign(
+        telemetry.motor_speed().begin() + motor,
+        telemetry.motor_speed().begin() + motor + telemetry.num_motors(i));
+    motor += telemetry.num_motors(i);
+    vehicle.received = now;
+  }
+}
+
+void SwarmShardLink::RemoteVehicles(
+    double timeout, std::vector<SwarmShardVehicle>* vehicles) const {
+  const std::chrono::steady_clock::time_point oldest =
+      std::chrono::steady_clock::now() -
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(timeout));
+  vehicles->clear();
+  std::lock_guard<std::mutex> lock(vehicles_mutex_);
+  for (const auto& entry : vehicles_) {
+    if (entry.second.received >= oldest) {
+      vehicles->push_back(entry.second);
+    }
+  }
+}
+
+int SwarmShardLink::ShardOf(const std::string& vehicle_name,
+                            double timeout) const {
+  const std::chrono::steady_clock::time_point oldest =
+      std::chrono::steady_clock::now() -
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(timeout));
+  std::lock_guard<std::mutex> lock(vehicles_mutex_);
+  const auto entry = vehicles_.find(vehicle_name);
+  if (entry == vehicles_.end() || entry->second.received < oldest) {
+    return -1;
+  }
+  return entry->second.shard;
+}
+
+void SwarmShardLink::Register(const std::string& world_name,
+                              const std::shared_ptr<SwarmShardLink>& link) {
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  Registry()[world_name] = link;
+}
+
+std::shared_ptr<SwarmShardLink> SwarmShardLink::ForWorld(
+    const std::string& world_name) {
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  const auto entry = Registry().find(world_name);
+  return entry == Registry().end() ? nullptr : entry->second.lock();
+}
+
+}  // namespace gazebo
@@ -0,0 +1,433 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/update_dispatcher.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "rotors_gazebo_plugins/common.h"
+
+namespace gazebo {
+
+namespace {
+
+std::mutex& RegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::map<const physics::World*, std::weak_ptr<UpdateDispatcher> >& Registry() {
+  static std::map<const physics::World*, std::weak_ptr<UpdateDispatcher> > registry;
+  return registry;
+}
+
+int GreatestCommonDivisor(int a, int b) {
+  while (b != 0) {
+    const int r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+}  // namespace
+
+UpdateConnection::UpdateConnection(event::ConnectionPtr connection)
+    : connection_(connection), id_(-1) {}
+
+UpdateConnection::UpdateConnection(std::shared_ptr<UpdateDispatcher> dispatcher,
+                                   int id)
+    : dispatcher_(dispatcher), id_(id) {}
+
+UpdateConnection::~UpdateConnection() {
+  if (dispatcher_) {
+    dispatcher_->Unregister(id_);
+  }
+}
+
+UpdateOffset::UpdateOffset(std::shared_ptr<UpdateDispatcher> dispatcher,
+                           int divisor, int offset, double cost)
+    : dispatcher_(dispatcher), divisor_(divisor), offset_(offset), cost_(cost) {}
+
+UpdateOffset::~UpdateOffset() {
+  if (dispatcher_) {
+    dispatcher_->ReleaseOffset(divisor_, offset_, cost_);
+  }
+}
+
+UpdateDispatcher::UpdateDispatcher(physics::WorldPtr world)
+    : world_(world),
+      next_group_(0),
+      next_id_(0),
+      update_pending_(false),
+      step_(0) {
+  for (std::shared_ptr<const PhaseEntries>& phase : phases_) {
+    phase = std::make_shared<const PhaseEntries>();
+  }
+  update_begin_connection_ = event::Events::ConnectWorldUpdateBegin(
+      std::bind(&UpdateDispatcher::OnWorldUpdateBegin, this,
+                std::placeholders::_1));
+  update_end_connection_ = event::Events::ConnectWorldUpdateEnd(
+      std::bind(&UpdateDispatcher::OnWorldUpdateEnd, this));
+}
+
+std::shared_ptr<UpdateDispatcher> UpdateDispatcher::Get(
+    const physics::WorldPtr& world) {
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  std::weak_ptr<UpdateDispatcher>& entry = Registry()[world.get()];
+  std::shared_ptr<UpdateDispatcher> dispatcher = entry.lock();
+  if (!dispatcher) {
+    dispatcher = std::make_shared<UpdateDispatcher>(world);
+    entry = dispatcher;
+  }
+  return dispatcher;
+}
+
+UpdateConnectionPtr UpdateDispatcher::Connect(const physics::ModelPtr& model,
+                                              const sdf::ElementPtr& sdf,
+                                              const std::string& name,
+                                              int default_priority,
+                                              const Callback& callback) {
+  bool use_update_dispatcher;
+  getSdfParam<bool>(sdf, "useUpdateDispatcher", use_update_dispatcher,
+                    kDefaultUseUpdateDispatcher);
+  if (!use_update_dispatcher) {
+    return std::make_shared<UpdateConnection>(
+        event::Events::ConnectWorldUpdateBegin(callback));
+  }
+
+  int priority, rate_divisor, thread_count, offset;
+  double cost;
+  std::string phase_name;
+  getSdfParam<int>(sdf, "updatePriority", priority, default_priority);
+  getSdfParam<int>(sdf, "updateRateDivisor", rate_divisor,
+                   kDefaultUpdateRateDivisor);
+  getSdfParam<int>(sdf, "updateThreads", thread_count, kDefaultUpdateThreads);
+  getSdfParam<std::string>(sdf, "updatePhase", phase_name, kDefaultUpdatePhase);
+  getSdfParam<int>(sdf, "updateOffset", offset, kDefaultUpdateOffset);
+  getSdfParam<double>(sdf, "updateCost", cost, kDefaultUpdateCost);
+  cost = std::max(cost, 0.0);
+  if (rate_divisor < 1) {
+    gzerr << "[" << name << "] updateRateDivisor must be at least 1, using 1.\n";
+    rate_divisor = 1;
+  }
+  Phase phase = kPrePhysics;
+  if (phase_name == "post") {
+    phase = kPostPhysics;
+  } else if (phase_name != "pre") {
+    gzerr << "[" << name << "] Unknown updatePhase \"" << phase_name
+          << "\", using \"pre\".\n";
+  }
+
+  std::shared_ptr<UpdateDispatcher> dispatcher = Get(model->GetWorld());
+  dispatcher->RequestThreads(thread_count);
+  const int id = dispatcher->Register(model, name, phase, priority,
+                                     rate_divisor, callback, offset, cost);
+  return std::make_shared<UpdateConnection>(dispatcher, id);
+}
+
+UpdateOffsetPtr UpdateDispatcher::Stagger(const physics::WorldPtr& world,
+                                          const sdf::ElementPtr& sdf,
+                                          const std::string& name,
+                                          const std::string& param_prefix,
+                                          int divisor) {
+  int offset;
+  double cost;
+  getSdfParam<int>(sdf, param_prefix + "Offset", offset, kDefaultUpdateOffset);
+  getSdfParam<double>(sdf, param_prefix + "Cost", cost, kDefaultUpdateCost);
+  cost = std::max(cost, 0.0);
+  if (divisor < 1) {
+    gzerr << "[" << name << "] Cannot stagger an update every " << divisor
+          << " steps, updating every step.\n";
+    divisor = 1;
+  }
+  std::shared_ptr<UpdateDispatcher> dispatcher = Get(world);
+  offset = dispatcher->ReserveOffset(divisor, offset, cost);
+  return std::make_shared<UpdateOffset>(dispatcher, divisor, offset, cost);
+}
+
+int UpdateDispatcher::ReserveOffset(int divisor, int offset, double cost) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return ReserveOffsetLocked(divisor, offset, cost);
+}
+
+void UpdateDispatcher::ReleaseOffset(int divisor, int offset, double cost) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ReleaseOffsetLocked(divisor, offset, cost);
+}
+
+int UpdateDispatcher::ReserveOffsetLocked(int divisor, int offset,
+                                          double cost) {
+  if (divisor <= 1) {
+    return 0;
+  }
+  if (offset < 0) {
+    // Two updates every n and m steps run on the same steps if their offsets
+    // are equal modulo gcd(n, m), then on gcd(n, m) / m of the steps of the
+    // first one. The offset with the lowest expected cost of the updates
+    // sharing its steps wins, the first one on a tie.
+    std::vector<double> step_costs(divisor, 0.0);
+    for (const auto& reserved : offset_costs_) {
+      const int other_divisor = reserved.first.first;
+      const int gcd = GreatestCommonDivisor(divisor, other_divisor);
+      const double shared_cost =
+          reserved.second * gcd / static_cast<double>(other_divisor);
+      for (int candidate = reserved.first.second % gcd; candidate < divisor;
+           candidate += gcd) {
+        step_costs[candidate] += shared_cost;
+      }
+    }
+    offset = static_cast<int>(
+        std::min_element(step_costs.begin(), step_costs.end()) -
+        step_costs.begin());
+  } else {
+    offset %= divisor;
+  }
+  offset_costs_[std::make_pair(divisor, offset)] += cost;
+  return offset;
+}
+
+void UpdateDispatcher::ReleaseOffsetLocked(int divisor, int offset,
+                                           double cost) {
+  if (divisor <= 1) {
+    return;
+  }
+  auto reserved = offset_costs_.find(std::make_pair(divisor, offset));
+  if (reserved == offset_costs_.end()) {
+    return;
+  }
+  reserved->second -= cost;
+  if (reserved->second <= 1e-9) {
+    offset_costs_.erase(reserved);
+  }
+}
+
+int UpdateDispatcher::Register(const physics::ModelPtr& model,
+                               const std::string& name, Phase phase,
+                               int priority, int rate_divisor,
+                               const Callback& callback, int offset,
+                               double cost) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto inserted = groups_.insert(std::make_pair(model.get(), next_group_));
+  if (inserted.second) {
+    ++next_group_;
+  }
+
+  Entry entry;
+  entry.id = next_id_++;
+  entry.model = model.get();
+  entry.group = inserted.first->second;
+  entry.priority = priority;
+  entry.rate_divisor = rate_divisor;
+  entry.offset = ReserveOffsetLocked(rate_divisor, offset, cost);
+  entry.cost = cost;
+  entry.callback = callback;
+  entry.name = model->GetName() + "/" + name;
+
+  // Keep the array sorted by model, priority and registration order. The
+  // plugins are registered once, so copying the phase is cheap enough.
+  std::shared_ptr<PhaseEntries> entries =
+      std::make_shared<PhaseEntries>(*phases_[phase]);
+  auto position = std::upper_bound(
+      entries->entries.begin(), entries->entries.end(), entry,
+      [](const Entry& a, const Entry& b) {
+        return a.group != b.group ? a.group < b.group : a.priority < b.priority;
+      });
+  entries->entries.insert(position, std::move(entry));
+  UpdateGroups(entries.get());
+  phases_[phase] = entries;
+  timings_[next_id_ - 1] = Timing();
+  return next_id_ - 1;
+}
+
+void UpdateDispatcher::Unregister(int id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (std::shared_ptr<const PhaseEntries>& phase : phases_) {
+    auto it = std::find_if(phase->entries.begin(), phase->entries.end(),
+                           [id](const Entry& entry) { return entry.id == id; });
+    if (it == phase->entries.end()) {
+      continue;
+    }
+    const Timing& timing = timings_[id];
+    if (timing.calls > 0) {
+      gzmsg << "[update_dispatcher] " << it->name << ": " << timing.calls
+            << " updates, mean " << timing.total_seconds / timing.calls * 1e6
+            << " us, max " << timing.max_seconds * 1e6 << " us.\n";
+    }
+    timings_.erase(id);
+    ReleaseOffsetLocked(it->rate_divisor, it->offset, it->cost);
+    const physics::Model* model = it->model;
+
+    std::shared_ptr<PhaseEntries> entries =
+        std::make_shared<PhaseEntries>(*phase);
+    entries->entries.erase(entries->entries.begin() +
+                           (it - phase->entries.begin()));
+    UpdateGroups(entries.get());
+    phase = entries;
+
+    // Forget the model once the last of its plugins is gone, its address may
+    // be reused by a model spawned later.
+    bool model_registered = false;
+    for (const std::shared_ptr<const PhaseEntries>& other : phases_) {
+      model_registered =
+          model_registered ||
+          std::any_of(other->entries.begin(), other->entries.end(),
+                      [model](const Entry& entry) {
+                        return entry.model == model;
+                      });
+    }
+    if (!model_registered) {
+      groups_.erase(model);
+    }
+    return;
+  }
+}
+
+std::vector<UpdateDispatcher::PluginTiming> UpdateDispatcher::Timings() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<PluginTiming> timings;
+  for (const std::shared_ptr<const PhaseEntries>& phase : phases_) {
+    for (const Entry& entry : phase->entries) {
+      PluginTiming timing;
+      timing.id = entry.id;
+      timing.name = entry.name;
+      timing.timing = timings_[entry.id];
+      timings.push_back(timing);
+    }
+  }
+  return timings;
+}
+
+void UpdateDispatcher::RequestThreads(int thread_count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const int current = thread_pool_ ? thread_pool_->ThreadCount() : 1;
+  if (thread_count <= current) {
+    return;
+  }
+  thread_pool_.reset(new UpdateThreadPool(thread_count));
+  gzmsg << "[update_dispatcher] Updating the vehicles of world \""
+        << world_->Name() << "\" on " << thread_count << " threads.\n";
+}
+
+void UpdateDispatcher::UpdateGroups(PhaseEntries* phase) {
+  phase->group_begin.clear();
+  for (std::size_t i = 0u; i < phase->entries.size(); ++i) {
+    if (i == 0u || phase->entries[i].group != phase->entries[i - 1].group) {
+      phase->group_begin.push_back(i);
+    }
+  }
+  phase->group_begin.push_back(phase->entries.size());
+}
+
+void UpdateDispatcher::OnWorldUpdateBegin(const common::UpdateInfo& info) {
+  // The world update events are shared by all worlds of the server.
+  if (info.worldName != world_->Name()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    info_ = info;
+    update_pending_ = true;
+  }
+  Dispatch(kPrePhysics, info);
+}
+
+void UpdateDispatcher::OnWorldUpdateEnd() {
+  common::UpdateInfo info;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!update_pending_) {
+      return;
+    }
+    update_pending_ = false;
+    info = info_;
+  }
+  Dispatch(kPostPhysics, info);
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++step_;
+}
+
+void UpdateDispatcher::Dispatch(Phase phase_index,
+                                const common::UpdateInfo& info) {
+  // The plugins run on a snapshot of the entries, outside of the mutex.
+  std::shared_ptr<const PhaseEntries> phase;
+  std::shared_ptr<UpdateThreadPool> thread_pool;
+  uint64_t step;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    phase = phases_[phase_index];
+    thread_pool = thread_pool_;
+    step = step_;
+  }
+  if (phase->entries.empty()) {
+    return;
+  }
+
+  // Wall time of every entry, negative if it was not due.
+  std::vector<double> seconds(phase->entries.size(), -1.0);
+  const std::size_t group_count = phase->group_begin.size() - 1;
+  if (!thread_pool || group_count < 2) {
+    RunEntries(*phase, 0u, phase->entries.size(), step, info, &seconds);
+  } else {
+    // The vehicles are independent between physics steps, so every vehicle
+    // is a task of its own.
+    thread_pool->Run(group_count, [&phase, step, &info,
+                                   &seconds](std::size_t group) {
+      RunEntries(*phase, phase->group_begin[group],
+                 phase->group_begin[group + 1], step, info, &seconds);
+    });
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (std::size_t i = 0u; i < seconds.size(); ++i) {
+    if (seconds[i] < 0.0) {
+      continue;
+    }
+    // Plugins unregistered during the update have no timing any more.
+    auto timing = timings_.find(phase->entries[i].id);
+    if (timing == timings_.end()) {
+      continue;
+    }
+    timing->second.calls++;
+    timing->second.total_seconds += seconds[i];
+    timing->second.max_seconds =
+        std::max(timing->second.max_seconds, seconds[i]);
+  }
+}
+
+void UpdateDispatcher::RunEntries(const PhaseEntries& phase,
+                                  std::size_t begin, std::size_t end,
+                                  uint64_t step,
+                                  const common::UpdateInfo& info,
+                                  std::vector<double>* seconds) {
+  for (std::size_t i = begin; i < end; ++i) {
+    const Entry& entry = phase.entries[i];
+    if ((step + entry.offset) % entry.rate_divisor != 0) {
+      continue;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    entry.callback(info);
+    (*seconds)[i] = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+  }
+}
+
+}  // namespace gazebo
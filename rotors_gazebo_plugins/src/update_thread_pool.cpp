@@ -0,0 +1,111 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/update_thread_pool.h"
+
+namespace gazebo {
+
+UpdateThreadPool::UpdateThreadPool(int thread_count)
+    : generation_(0),
+      busy_workers_(0),
+      stop_(false),
+      task_(nullptr),
+      task_count_(0),
+      next_task_(0) {
+  for (int i = 1; i < thread_count; ++i) {
+    workers_.emplace_back(&UpdateThreadPool::WorkerLoop, this);
+  }
+}
+
+UpdateThreadPool::~UpdateThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_condition_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void UpdateThreadPool::Run(std::size_t task_count, const Task& task) {
+  if (workers_.empty() || task_count < 2) {
+    for (std::size_t i = 0; i < task_count; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    task_count_ = task_count;
+    next_task_.store(0, std::memory_order_relaxed);
+    busy_workers_ = workers_.size();
+    ++generation_;
+  }
+  start_condition_.notify_all();
+
+  RunTasks();
+
+  // Every worker checks in once per batch, so none of them can still be
+  // reading the task when the next batch is set up.
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_condition_.wait(lock, [this] { return busy_workers_ == 0; });
+  task_ = nullptr;
+}
+
+void UpdateThreadPool::WorkerLoop() {
+  uint64_t generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_condition_.wait(
+          lock, [this, generation] { return stop_ || generation_ != generation; });
+      if (stop_) {
+        return;
+      }
+      generation = generation_;
+    }
+
+    RunTasks();
+
+    bool last;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      last = --busy_workers_ == 0;
+    }
+    if (last) {
+      done_condition_.notify_one();
+    }
+  }
+}
+
+void UpdateThreadPool::RunTasks() {
+  while (true) {
+    const std::size_t i = next_task_.fetch_add(1, std::memory_order_relaxed);
+    if (i >= task_count_) {
+      return;
+    }
+    (*task_)(i);
+  }
+}
+
+}  // namespace gazebo
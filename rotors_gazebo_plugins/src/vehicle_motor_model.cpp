@@ -0,0 +1,236 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/vehicle_motor_model.h"
+
+#include <map>
+#include <mutex>
+
+#include <Eigen/Geometry>
+
+namespace gazebo {
+
+namespace {
+
+std::mutex& RegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::map<const physics::Model*, std::weak_ptr<VehicleMotorModel> >& Registry() {
+  static std::map<const physics::Model*, std::weak_ptr<VehicleMotorModel> > registry;
+  return registry;
+}
+
+Eigen::Vector3d ToEigen(const ignition::math::Vector3d& vector) {
+  return Eigen::Vector3d(vector.X(), vector.Y(), vector.Z());
+}
+
+/// \brief  Cross product of every column of a with the same column of b.
+template <class DerivedA, class DerivedB, class DerivedOut>
+void ColumnwiseCross(const Eigen::MatrixBase<DerivedA>& a,
+                     const Eigen::MatrixBase<DerivedB>& b,
+                     Eigen::MatrixBase<DerivedOut>& out) {
+  out.row(0) = a.row(1).cwiseProduct(b.row(2)) - a.row(2).cwiseProduct(b.row(1));
+  out.row(1) = a.row(2).cwiseProduct(b.row(0)) - a.row(0).cwiseProduct(b.row(2));
+  out.row(2) = a.row(0).cwiseProduct(b.row(1)) - a.row(1).cwiseProduct(b.row(0));
+}
+
+}  // namespace
+
+VehicleMotorModel::VehicleMotorModel(physics::ModelPtr model)
+    : model_(model),
+      world_(model->GetWorld()),
+      last_update_iteration_(0),
+      updated_(false),
+      has_aero_tables_(false),
+      wind_speed_W_(0.0, 0.0, 0.0) {}
+
+std::shared_ptr<VehicleMotorModel> VehicleMotorModel::Get(
+    const physics::ModelPtr& model) {
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  std::weak_ptr<VehicleMotorModel>& entry = Registry()[model.get()];
+  std::shared_ptr<VehicleMotorModel> vehicle_motor_model = entry.lock();
+  if (!vehicle_motor_model) {
+    vehicle_motor_model = std::make_shared<VehicleMotorModel>(model);
+    entry = vehicle_motor_model;
+  }
+  return vehicle_motor_model;
+}
+
+bool VehicleMotorModel::AddRotor(const VehicleRotor& rotor) {
+  physics::Link_V parent_links = rotor.link->GetParentJointsLinks();
+  if (parent_links.empty()) {
+    gzerr << "[vehicle_motor_model] Rotor link \"" << rotor.link->GetName()
+          << "\" has no parent link.\n";
+    return false;
+  }
+  if (!body_) {
+    body_ = parent_links.at(0);
+    body_state_ = RigidBodyStateCache::Get(body_);
+  } else if (parent_links.at(0) != body_) {
+    gzerr << "[vehicle_motor_model] Rotor link \"" << rotor.link->GetName()
+          << "\" is not mounted on \"" << body_->GetName() << "\".\n";
+    return false;
+  }
+
+  // The rotor is rigidly mounted, its geometry in the body frame is constant.
+  // The spin of the rotor about its own z-axis leaves the position of its
+  // origin and the direction of its z-axis unchanged.
+  const ignition::math::Pose3d body_pose = body_->WorldPose();
+  const ignition::math::Pose3d rotor_pose = rotor.link->WorldPose() - body_pose;
+  const ignition::math::Vector3d thrust_axis =
+      rotor_pose.Rot().RotateVector(ignition::math::Vector3d(0, 0, 1));
+  const ignition::math::Vector3d joint_axis =
+      body_pose.Rot().RotateVectorReverse(rotor.joint->GlobalAxis(0));
+  const ignition::math::Vector3d body_cog = body_->GetInertial()->CoG();
+
+  const int n = joints_.size() + 1;
+  positions_.conservativeResize(Eigen::NoChange, n);
+  moment_arms_.conservativeResize(Eigen::NoChange, n);
+  thrust_axes_.conservativeResize(Eigen::NoChange, n);
+  joint_axes_.conservativeResize(Eigen::NoChange, n);
+  turning_directions_.conservativeResize(n);
+  motor_constants_.conservativeResize(n);
+  moment_constants_.conservativeResize(n);
+  rotor_drag_coefficients_.conservativeResize(n);
+  rolling_moment_coefficients_.conservativeResize(n);
+  rotor_velocity_slowdowns_.conservativeResize(n);
+
+  positions_.col(n - 1) = ToEigen(rotor_pose.Pos());
+  moment_arms_.col(n - 1) = ToEigen(rotor_pose.Pos() - body_cog);
+  thrust_axes_.col(n - 1) = ToEigen(thrust_axis);
+  joint_axes_.col(n - 1) = ToEigen(joint_axis.Normalized());
+  turning_directions_(n - 1) = rotor.turning_direction;
+  motor_constants_(n - 1) = rotor.motor_constant;
+  moment_constants_(n - 1) = rotor.moment_constant;
+  rotor_drag_coefficients_(n - 1) = rotor.rotor_drag_coefficient;
+  rolling_moment_coefficients_(n - 1) = rotor.rolling_moment_coefficient;
+  rotor_velocity_slowdowns_(n - 1) = rotor.rotor_velocity_slowdown_sim;
+
+  aero_tables_.push_back(rotor.aero_table);
+  has_aero_tables_ = has_aero_tables_ || rotor.aero_table;
+
+  rotor_velocities_.resize(n);
+  thrusts_.resize(n);
+  axial_velocities_.resize(n);
+  // Constant unless a rotor uses a table, which overwrites its entries.
+  thrust_coefficients_ = motor_constants_;
+  torque_coefficients_ = motor_constants_ * moment_constants_;
+  scales_.resize(n);
+  relative_velocities_.resize(Eigen::NoChange, n);
+  forces_.resize(Eigen::NoChange, n);
+  moments_.resize(Eigen::NoChange, n);
+
+  joints_.push_back(rotor.joint);
+  motor_numbers_.push_back(rotor.motor_number);
+  return true;
+}
+
+void VehicleMotorModel::Update(double sampling_time) {
+  const uint64_t iteration = world_->Iterations();
+  if (updated_ && iteration == last_update_iteration_) {
+    return;
+  }
+  updated_ = true;
+  last_update_iteration_ = iteration;
+
+  if (!body_) {
+    return;
+  }
+
+  // Joint velocities are the only per-rotor queries.
+  for (std::size_t i = 0u; i < joints_.size(); ++i) {
+    const double motor_rot_vel = joints_[i]->GetVelocity(0);
+    if (motor_rot_vel / (2 * M_PI) > 1 / (2 * sampling_time)) {
+      gzerr << "Aliasing on motor [" << motor_numbers_[i]
+            << "] might occur. Consider making smaller simulation time "
+               "steps or raising the rotor_velocity_slowdown_sim_ param.\n";
+    }
+    rotor_velocities_(i) = motor_rot_vel;
+  }
+  rotor_velocities_ *= rotor_velocity_slowdowns_;
+
+  // State of the body, read once for all rotors.
+  const RigidBodyState body_state = body_state_->State();
+  const ignition::math::Quaterniond body_orientation = body_state.world_pose.Rot();
+  const Eigen::Vector3d body_velocity_B = ToEigen(body_state.relative_linear_vel);
+  const Eigen::Vector3d body_angular_velocity_B =
+      ToEigen(body_state.relative_angular_vel);
+  const Eigen::Vector3d wind_speed_B =
+      ToEigen(body_orientation.RotateVectorReverse(wind_speed_W_));
+
+  // Relative air velocity at every rotor: v + omega x r - v_wind.
+  ColumnwiseCross(-positions_, body_angular_velocity_B.replicate(1, joints_.size()),
+                  relative_velocities_);
+  relative_velocities_.colwise() += body_velocity_B - wind_speed_B;
+  if (has_aero_tables_) {
+    // Climb speed along the thrust, before the axial component is removed.
+    axial_velocities_ =
+        thrust_axes_.cwiseProduct(relative_velocities_).colwise().sum().transpose();
+  }
+
+  // Forces from Philppe Martin's and Erwan Salaün's
+  // 2010 IEEE Conference on Robotics and Automation paper
+  // The True Role of Accelerometer Feedback in Quadrotor Control
+  // Component perpendicular to the rotor axis, V_A^{\perp}.
+  scales_ = joint_axes_.cwiseProduct(relative_velocities_).colwise().sum().transpose();
+  relative_velocities_.array() -= joint_axes_.array().rowwise() * scales_.transpose();
+
+  if (has_aero_tables_) {
+    for (std::size_t i = 0u; i < joints_.size(); ++i) {
+      if (aero_tables_[i]) {
+        aero_tables_[i]->Lookup(std::abs(rotor_velocities_(i)),
+                                axial_velocities_(i),
+                                relative_velocities_.col(i).norm(),
+                                &thrust_coefficients_(i),
+                                &torque_coefficients_(i));
+      }
+    }
+  }
+
+  // Assuming symmetric propellers (or rotors) for the thrust calculation.
+  thrusts_ = turning_directions_ * rotor_velocities_ * rotor_velocities_.abs() *
+             thrust_coefficients_;
+
+  // Thrust and - \omega * \lambda_1 * V_A^{\perp}.
+  scales_ = rotor_velocities_.abs() * rotor_drag_coefficients_;
+  forces_.array() = thrust_axes_.array().rowwise() * thrusts_.transpose() -
+                    relative_velocities_.array().rowwise() * scales_.transpose();
+
+  // Moments of the rotor forces about the CoG of the body.
+  ColumnwiseCross(moment_arms_, forces_, moments_);
+
+  const Eigen::Vector3d force_B = forces_.rowwise().sum();
+  Eigen::Vector3d torque_B = moments_.rowwise().sum();
+  // Drag torque about the rotor axis.
+  scales_ = rotor_velocities_ * rotor_velocities_.abs() * torque_coefficients_;
+  torque_B.noalias() -= thrust_axes_ * scales_.matrix();
+  // - \omega * \mu_1 * V_A^{\perp}
+  scales_ = rotor_velocities_.abs() * rolling_moment_coefficients_;
+  torque_B.noalias() -= relative_velocities_ * scales_.matrix();
+
+  body_->AddRelativeForce(
+      ignition::math::Vector3d(force_B.x(), force_B.y(), force_B.z()));
+  body_->AddRelativeTorque(
+      ignition::math::Vector3d(torque_B.x(), torque_B.y(), torque_B.z()));
+}
+
+}  // namespace gazebo
@@ -0,0 +1,570 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/wind_field.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace gazebo {
+
+namespace {
+
+constexpr uint64_t kPageSize = 4096;
+
+uint64_t AlignToPage(uint64_t offset) {
+  return (offset + kPageSize - 1) / kPageSize * kPageSize;
+}
+
+void ReadLine(std::ifstream& fin, std::vector<float>* values) {
+  float data;
+  while (fin >> data) {
+    values->push_back(data);
+    if (fin.peek() == '\n') break;
+  }
+}
+
+/// \brief  Linear interpolation
+/// \param[in]  position Coordinate of the target point.
+///             values Pointer to an array of size 2 containing the wind values
+///                    of the two points to interpolate from.
+///             points Pointer to an array of size 2 containing the coordinate
+///                    of the two points to interpolate from.
+WindVelocity LinearInterpolation(double position, const WindVelocity* values,
+                                 const double* points) {
+  WindVelocity value;
+  value.u = values[0].u + (values[1].u - values[0].u) /
+                          (points[1] - points[0]) * (position - points[0]);
+  value.v = values[0].v + (values[1].v - values[0].v) /
+                          (points[1] - points[0]) * (position - points[0]);
+  value.w = values[0].w + (values[1].w - values[0].w) /
+                          (points[1] - points[0]) * (position - points[0]);
+  return value;
+}
+
+/// \brief  Bilinear interpolation
+/// \param[in]  position Pointer to an array of size 2 containing the x- and
+///                      y-coordinates of the target point.
+///             values Pointer to an array of size 4 containing the wind values
+///                    of the four points to interpolate from (8, 9, 10 and 11).
+///             points Pointer to an array of size 6 containing the x-coordinate
+///                    of the four intermediate points (8, 9, 10 and 11), and the
+///                    y-coordinate of the last two intermediate points (12 and 13).
+WindVelocity BilinearInterpolation(const double* position, const WindVelocity* values,
+                                   const double* points) {
+  WindVelocity intermediate_values[2] = { LinearInterpolation(
+                                            position[0], &(values[0]), &(points[0])),
+                                          LinearInterpolation(
+                                            position[0], &(values[2]), &(points[2])) };
+  return LinearInterpolation(position[1], intermediate_values, &(points[4]));
+}
+
+/// \brief  Trilinear interpolation
+/// \param[in]  position Pointer to an array of size 3 containing the x, y and
+///                      z-coordinates of the target point.
+///             values Pointer to an array of size 8 containing the wind values of the
+///                    eight points to interpolate from (0, 1, 2, 3, 4, 5, 6 and 7).
+///             points Pointer to an array of size 14 containing the z-coordinate
+///                    of the eight points to interpolate from, the x-coordinate
+///                    of the four intermediate points (8, 9, 10 and 11), and the
+///                    y-coordinate of the last two intermediate points (12 and 13).
+WindVelocity TrilinearInterpolation(const double* position, const WindVelocity* values,
+                                    const double* points) {
+  WindVelocity intermediate_values[4] = { LinearInterpolation(
+                                            position[2], &(values[0]), &(points[0])),
+                                          LinearInterpolation(
+                                            position[2], &(values[2]), &(points[2])),
+                                          LinearInterpolation(
+                                            position[2], &(values[4]), &(points[4])),
+                                          LinearInterpolation(
+                                            position[2], &(values[6]), &(points[6])) };
+  return BilinearInterpolation(&(position[0]), intermediate_values, &(points[8]));
+}
+
+}  // namespace
+
+bool WindFieldData::ReadTextFile(const std::string& path) {
+  std::ifstream fin;
+  fin.open(path);
+  if (!fin.is_open()) {
+    return false;
+  }
+
+  std::string data_name;
+  // Read the line with the variable name.
+  while (fin >> data_name) {
+    // Save data on following line into the correct variable.
+    if (data_name == "min_x:") {
+      fin >> min_x;
+    } else if (data_name == "min_y:") {
+      fin >> min_y;
+    } else if (data_name == "n_x:") {
+      fin >> n_x;
+    } else if (data_name == "n_y:") {
+      fin >> n_y;
+    } else if (data_name == "res_x:") {
+      fin >> res_x;
+    } else if (data_name == "res_y:") {
+      fin >> res_y;
+    } else if (data_name == "vertical_spacing_factors:") {
+      ReadLine(fin, &vertical_spacing_factors);
+    } else if (data_name == "bottom_z:") {
+      ReadLine(fin, &bottom_z);
+    } else if (data_name == "top_z:") {
+      ReadLine(fin, &top_z);
+    } else if (data_name == "u:") {
+      ReadLine(fin, &u);
+    } else if (data_name == "v:") {
+      ReadLine(fin, &v);
+    } else if (data_name == "w:") {
+      ReadLine(fin, &w);
+    } else {
+      // If invalid data name, read the rest of the invalid line,
+      // publish a message and ignore data on next line. Then resume reading.
+      std::string restOfLine;
+      getline(fin, restOfLine);
+      std::cerr << "[wind_field] Invalid data name '" << data_name << restOfLine <<
+                   "' in custom wind field text file. Ignoring data on next line.\n";
+      fin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+  }
+  fin.close();
+  return IsConsistent();
+}
+
+bool WindFieldData::IsConsistent() const {
+  if (n_x < 2 || n_y < 2 || vertical_spacing_factors.size() < 2) {
+    return false;
+  }
+  const std::size_t n_columns = static_cast<std::size_t>(n_x) * n_y;
+  const std::size_t n_vertices = n_columns * vertical_spacing_factors.size();
+  return bottom_z.size() == n_columns && top_z.size() == n_columns &&
+         u.size() == n_vertices && v.size() == n_vertices &&
+         w.size() == n_vertices;
+}
+
+WindField::WindField()
+    : n_x_(0),
+      n_y_(0),
+      n_z_(0),
+      tile_n_x_(1),
+      tile_n_y_(1),
+      n_tiles_x_(0),
+      tile_stride_(0),
+      min_x_(0.0f),
+      min_y_(0.0f),
+      res_x_(0.0f),
+      res_y_(0.0f),
+      vertical_spacing_factors_(nullptr),
+      bottom_z_(nullptr),
+      top_z_(nullptr),
+      vertices_(nullptr),
+      mapped_data_(nullptr),
+      mapped_size_(0) {}
+
+WindField::~WindField() {
+  Clear();
+}
+
+void WindField::Clear() {
+  if (mapped_data_ != nullptr) {
+    munmap(mapped_data_, mapped_size_);
+    mapped_data_ = nullptr;
+    mapped_size_ = 0;
+  }
+  data_ = WindFieldData();
+  ArenaVector<WindFieldVertex>(vertex_storage_.get_allocator())
+      .swap(vertex_storage_);
+  vertical_spacing_factors_ = nullptr;
+  bottom_z_ = nullptr;
+  top_z_ = nullptr;
+  vertices_ = nullptr;
+}
+
+void WindField::UseArena(const ArenaAllocator<char>& allocator) {
+  Clear();
+  vertex_storage_ = ArenaVector<WindFieldVertex>(
+      ArenaAllocator<WindFieldVertex>(allocator));
+}
+
+void WindField::PageIn() const {
+  if (mapped_data_ == nullptr) {
+    return;
+  }
+  madvise(mapped_data_, mapped_size_, MADV_WILLNEED);
+  const volatile char* base = static_cast<const volatile char*>(mapped_data_);
+  char sum = 0;
+  for (std::size_t offset = 0; offset < mapped_size_; offset += kPageSize) {
+    sum ^= base[offset];
+  }
+  (void)sum;
+}
+
+bool WindField::Load(const std::string& path) {
+  if (IsBinaryFile(path)) {
+    return LoadBinary(path);
+  }
+  return LoadText(path);
+}
+
+bool WindField::IsBinaryFile(const std::string& path) {
+  std::ifstream fin(path, std::ios::binary);
+  char magic[sizeof(kWindFieldFileMagic)];
+  if (!fin.read(magic, sizeof(magic))) {
+    return false;
+  }
+  return std::memcmp(magic, kWindFieldFileMagic, sizeof(magic)) == 0;
+}
+
+bool WindField::LoadText(const std::string& path) {
+  Clear();
+  if (!data_.ReadTextFile(path)) {
+    data_ = WindFieldData();
+    return false;
+  }
+
+  n_x_ = data_.n_x;
+  n_y_ = data_.n_y;
+  n_z_ = data_.vertical_spacing_factors.size();
+  // A single tile spanning the whole grid, i.e. columns are stored one after
+  // the other.
+  tile_n_x_ = n_x_;
+  tile_n_y_ = n_y_;
+  n_tiles_x_ = 1;
+  tile_stride_ = n_x_ * n_y_ * n_z_;
+  min_x_ = data_.min_x;
+  min_y_ = data_.min_y;
+  res_x_ = data_.res_x;
+  res_y_ = data_.res_y;
+
+  vertex_storage_.resize(tile_stride_);
+  BuildTiles(data_, tile_n_x_, tile_n_y_, tile_stride_, vertex_storage_.data());
+
+  // The raw velocities are not needed anymore.
+  std::vector<float>().swap(data_.u);
+  std::vector<float>().swap(data_.v);
+  std::vector<float>().swap(data_.w);
+
+  vertical_spacing_factors_ = data_.vertical_spacing_factors.data();
+  bottom_z_ = data_.bottom_z.data();
+  top_z_ = data_.top_z.data();
+  vertices_ = vertex_storage_.data();
+  return true;
+}
+
+bool WindField::LoadBinary(const std::string& path) {
+  Clear();
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 ||
+      static_cast<std::size_t>(file_stat.st_size) < sizeof(WindFieldFileHeader)) {
+    close(fd);
+    return false;
+  }
+  mapped_size_ = file_stat.st_size;
+  mapped_data_ = mmap(nullptr, mapped_size_, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping stays valid after the file descriptor is closed.
+  close(fd);
+  if (mapped_data_ == MAP_FAILED) {
+    mapped_data_ = nullptr;
+    mapped_size_ = 0;
+    return false;
+  }
+  // Vertices are accessed around the vehicle only, do not read ahead.
+  madvise(mapped_data_, mapped_size_, MADV_RANDOM);
+
+  const char* base = static_cast<const char*>(mapped_data_);
+  WindFieldFileHeader header;
+  std::memcpy(&header, base, sizeof(header));
+  if (std::memcmp(header.magic, kWindFieldFileMagic, sizeof(header.magic)) != 0 ||
+      header.version != kWindFieldFileVersion || header.n_x < 2 ||
+      header.n_y < 2 || header.n_z < 2 || header.tile_n_x == 0 ||
+      header.tile_n_y == 0 ||
+      // A tile holds all vertices of its columns, otherwise the tiles overlap.
+      header.tile_stride < static_cast<uint64_t>(header.tile_n_x) *
+                               header.tile_n_y * header.n_z) {
+    Clear();
+    return false;
+  }
+
+  const uint64_t n_columns = static_cast<uint64_t>(header.n_x) * header.n_y;
+  const uint64_t n_tiles =
+      static_cast<uint64_t>((header.n_x + header.tile_n_x - 1) / header.tile_n_x) *
+      ((header.n_y + header.tile_n_y - 1) / header.tile_n_y);
+  if (header.vertical_spacing_factors_offset + header.n_z * sizeof(float) > mapped_size_ ||
+      header.bottom_z_offset + n_columns * sizeof(float) > mapped_size_ ||
+      header.top_z_offset + n_columns * sizeof(float) > mapped_size_ ||
+      header.tiles_offset + n_tiles * header.tile_stride * sizeof(WindFieldVertex) >
+          mapped_size_) {
+    Clear();
+    return false;
+  }
+
+  n_x_ = header.n_x;
+  n_y_ = header.n_y;
+  n_z_ = header.n_z;
+  tile_n_x_ = header.tile_n_x;
+  tile_n_y_ = header.tile_n_y;
+  n_tiles_x_ = (n_x_ + tile_n_x_ - 1) / tile_n_x_;
+  tile_stride_ = header.tile_stride;
+  min_x_ = header.min_x;
+  min_y_ = header.min_y;
+  res_x_ = header.res_x;
+  res_y_ = header.res_y;
+
+  vertical_spacing_factors_ = reinterpret_cast<const float*>(
+      base + header.vertical_spacing_factors_offset);
+  bottom_z_ = reinterpret_cast<const float*>(base + header.bottom_z_offset);
+  top_z_ = reinterpret_cast<const float*>(base + header.top_z_offset);
+  vertices_ = reinterpret_cast<const WindFieldVertex*>(base + header.tiles_offset);
+  return true;
+}
+
+bool WindField::WriteBinary(const WindFieldData& data, const std::string& path,
+                            uint32_t tile_size) {
+  if (!data.IsConsistent() || tile_size == 0) {
+    return false;
+  }
+
+  WindFieldFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kWindFieldFileMagic, sizeof(header.magic));
+  header.version = kWindFieldFileVersion;
+  header.n_x = data.n_x;
+  header.n_y = data.n_y;
+  header.n_z = data.vertical_spacing_factors.size();
+  header.tile_n_x = std::min<uint32_t>(tile_size, header.n_x);
+  header.tile_n_y = std::min<uint32_t>(tile_size, header.n_y);
+  header.min_x = data.min_x;
+  header.min_y = data.min_y;
+  header.res_x = data.res_x;
+  header.res_y = data.res_y;
+
+  const uint64_t n_columns = static_cast<uint64_t>(header.n_x) * header.n_y;
+  header.vertical_spacing_factors_offset = sizeof(header);
+  header.bottom_z_offset =
+      header.vertical_spacing_factors_offset + header.n_z * sizeof(float);
+  header.top_z_offset = header.bottom_z_offset + n_columns * sizeof(float);
+  header.tiles_offset = AlignToPage(header.top_z_offset + n_columns * sizeof(float));
+
+  // Pad every tile to a whole number of pages.
+  const uint64_t tile_bytes = static_cast<uint64_t>(header.tile_n_x) *
+                              header.tile_n_y * header.n_z * sizeof(WindFieldVertex);
+  header.tile_stride = AlignToPage(tile_bytes) / sizeof(WindFieldVertex);
+
+  const std::size_t n_tiles_x = (header.n_x + header.tile_n_x - 1) / header.tile_n_x;
+  const std::size_t n_tiles_y = (header.n_y + header.tile_n_y - 1) / header.tile_n_y;
+  std::vector<WindFieldVertex> vertices(n_tiles_x * n_tiles_y * header.tile_stride);
+  std::memset(vertices.data(), 0, vertices.size() * sizeof(WindFieldVertex));
+  BuildTiles(data, header.tile_n_x, header.tile_n_y, header.tile_stride,
+             vertices.data());
+
+  std::ofstream fout(path, std::ios::binary | std::ios::trunc);
+  if (!fout.is_open()) {
+    return false;
+  }
+  fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  fout.write(reinterpret_cast<const char*>(data.vertical_spacing_factors.data()),
+             header.n_z * sizeof(float));
+  fout.write(reinterpret_cast<const char*>(data.bottom_z.data()),
+             n_columns * sizeof(float));
+  fout.write(reinterpret_cast<const char*>(data.top_z.data()),
+             n_columns * sizeof(float));
+  const std::vector<char> padding(
+      header.tiles_offset - (header.top_z_offset + n_columns * sizeof(float)), 0);
+  fout.write(padding.data(), padding.size());
+  fout.write(reinterpret_cast<const char*>(vertices.data()),
+             vertices.size() * sizeof(WindFieldVertex));
+  return static_cast<bool>(fout);
+}
+
+void WindField::BuildTiles(const WindFieldData& data, std::size_t tile_n_x,
+                           std::size_t tile_n_y, std::size_t tile_stride,
+                           WindFieldVertex* vertices) {
+  const std::size_t n_x = data.n_x;
+  const std::size_t n_y = data.n_y;
+  const std::size_t n_z = data.vertical_spacing_factors.size();
+  const std::size_t n_tiles_x = (n_x + tile_n_x - 1) / tile_n_x;
+  for (std::size_t y = 0u; y < n_y; ++y) {
+    for (std::size_t x = 0u; x < n_x; ++x) {
+      const std::size_t column = x + y * n_x;
+      const std::size_t tile_x = x / tile_n_x;
+      const std::size_t tile_y = y / tile_n_y;
+      const std::size_t column_in_tile =
+          (x - tile_x * tile_n_x) + (y - tile_y * tile_n_y) * tile_n_x;
+      WindFieldVertex* column_vertices =
+          vertices + (tile_x + tile_y * n_tiles_x) * tile_stride + column_in_tile * n_z;
+      const float column_height = data.top_z[column] - data.bottom_z[column];
+      for (std::size_t k = 0u; k < n_z; ++k) {
+        const std::size_t idx_in = column + k * n_x * n_y;
+        column_vertices[k].u = data.u[idx_in];
+        column_vertices[k].v = data.v[idx_in];
+        column_vertices[k].w = data.w[idx_in];
+        column_vertices[k].z = column_height * data.vertical_spacing_factors[k] +
+                               data.bottom_z[column];
+      }
+    }
+  }
+}
+
+void WindField::FindVerticalIndices(float vertical_factor,
+                                    std::size_t* idx_lower,
+                                    std::size_t* idx_upper) const {
+  // Find the first grid point strictly above the aircraft. The grid point
+  // just below (or at) the aircraft is the one preceding it.
+  const float* factors_begin = vertical_spacing_factors_;
+  const float* factors_end = factors_begin + n_z_;
+  const float* it = std::upper_bound(factors_begin, factors_end, vertical_factor);
+  if (it == factors_begin || it == factors_end) {
+    // No enclosing pair, keep the lowest and the highest grid points.
+    *idx_lower = 0u;
+    *idx_upper = n_z_ - 1u;
+    return;
+  }
+  *idx_upper = it - factors_begin;
+  *idx_lower = *idx_upper - 1u;
+}
+
+bool WindField::Interpolate(double x, double y, double z,
+                            WindVelocity* wind_velocity) const {
+  if (empty()) {
+    return false;
+  }
+
+  // Calculate the x, y index of the grid points with x, y-coordinate 
+  // just smaller than or equal to aircraft x, y position.
+  const std::size_t n_x = n_x_;
+  const std::size_t n_y = n_y_;
+  const double x_floor = std::floor((x - min_x_) / res_x_);
+  const double y_floor = std::floor((y - min_y_) / res_y_);
+  if (!(x_floor >= 0.0) || !(y_floor >= 0.0)) {
+    return false;
+  }
+  std::size_t x_inf = x_floor;
+  std::size_t y_inf = y_floor;
+
+  // In case aircraft is on one of the boundary surfaces at max_x or max_y,
+  // decrease x_inf, y_inf by one to have x_sup, y_sup on max_x, max_y.
+  if (x_inf == n_x - 1u) {
+    x_inf = n_x - 2u;
+  }
+  if (y_inf == n_y - 1u) {
+    y_inf = n_y - 2u;
+  }
+
+  // Calculate the x, y index of the grid points with x, y-coordinate just
+  // greater than the aircraft x, y position. 
+  std::size_t x_sup = x_inf + 1u;
+  std::size_t y_sup = y_inf + 1u;
+  if (x_sup > (n_x - 1u) || y_sup > (n_y - 1u)) {
+    return false;
+  }
+
+  // Save in an array the x, y index of each of the eight grid points 
+  // enclosing the aircraft.
+  constexpr unsigned int n_vertices = 8;
+  std::size_t idx_x[n_vertices] = {x_inf, x_inf, x_sup, x_sup, x_inf, x_inf, x_sup, x_sup};
+  std::size_t idx_y[n_vertices] = {y_inf, y_inf, y_inf, y_inf, y_sup, y_sup, y_sup, y_sup};
+
+  // Find the vertical factor of the aircraft in each of the four surrounding 
+  // grid columns, and their minimal/maximal value.
+  constexpr unsigned int n_columns = 4;
+  float vertical_factors_columns[n_columns];
+  for (std::size_t i = 0u; i < n_columns; ++i) {
+    const std::size_t column = idx_x[2u * i] + idx_y[2u * i] * n_x;
+    vertical_factors_columns[i] = (z - bottom_z_[column]) /
+                                  (top_z_[column] - bottom_z_[column]);
+  }
+
+  // Find maximal and minimal value amongst vertical factors.
+  float vertical_factors_min = std::min(std::min(std::min(
+    vertical_factors_columns[0], vertical_factors_columns[1]),
+    vertical_factors_columns[2]), vertical_factors_columns[3]);
+  float vertical_factors_max = std::max(std::max(std::max(
+    vertical_factors_columns[0], vertical_factors_columns[1]),
+    vertical_factors_columns[2]), vertical_factors_columns[3]);
+  if (!(vertical_factors_max >= 0u && vertical_factors_min <= 1u)) {
+    return false;
+  }
+
+  // Find indices in z-direction for each of the vertices. If link is not 
+  // within the range of one of the columns, set to lowest or highest two.
+  const std::size_t n_z = n_z_;
+  std::size_t idx_z[n_vertices];
+  for (std::size_t i = 0u; i < n_columns; ++i) {
+    if (vertical_factors_columns[i] < 0u) {
+      // Link z-position below lowest grid point of that column.
+      idx_z[2u * i] = 0u;
+      idx_z[2u * i + 1u] = 1u;
+    } else if (vertical_factors_columns[i] >= 1u) {
+      // Link z-position above highest grid point of that column.
+      idx_z[2u * i] = n_z - 2u;
+      idx_z[2u * i + 1u] = n_z - 1u;
+    } else {
+      // Link z-position between two grid points in that column.
+      FindVerticalIndices(vertical_factors_columns[i], &idx_z[2u * i],
+                          &idx_z[2u * i + 1u]);
+    }
+  }
+
+  // Extract the wind velocities corresponding to each vertex, and the relevant
+  // coordinate of every point needed for trilinear interpolation (first
+  // z-direction, then x-direction, then y-direction).
+  constexpr unsigned int n_points_interp_z = 8;
+  constexpr unsigned int n_points_interp_x = 4;
+  constexpr unsigned int n_points_interp_y = 2;
+  WindVelocity wind_at_vertices[n_vertices];
+  double interpolation_points[n_points_interp_x + n_points_interp_y + n_points_interp_z];
+  for (std::size_t i = 0u; i < n_vertices; ++i) {
+    const WindFieldVertex& vertex = this->vertex(idx_x[i], idx_y[i], idx_z[i]);
+    wind_at_vertices[i].u = vertex.u;
+    wind_at_vertices[i].v = vertex.v;
+    wind_at_vertices[i].w = vertex.w;
+    interpolation_points[i] = vertex.z;
+  }
+  for (std::size_t i = 0u; i < n_points_interp_x; ++i) {
+    interpolation_points[n_points_interp_z + i] =
+        min_x_ + res_x_ * idx_x[2u * i];
+  }
+  for (std::size_t i = 0u; i < n_points_interp_y; ++i) {
+    interpolation_points[n_points_interp_z + n_points_interp_x + i] =
+        min_y_ + res_y_ * idx_y[4u * i];
+  }
+
+  // Interpolate wind velocity at aircraft position.
+  const double position[3] = {x, y, z};
+  *wind_velocity = TrilinearInterpolation(
+    position, wind_at_vertices, interpolation_points);
+  return true;
+}
+
+}  // namespace gazebo
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Converts a custom wind field text file into the binary format that
+// GazeboWindPlugin maps into memory.
+//
+// Usage: wind_field_converter <input.txt> <output.bin> [tile_size]
+
+#include <cstdlib>
+#include <iostream>
+
+#include "rotors_gazebo_plugins/wind_field.h"
+
+int main(int argc, char** argv) {
+  if (argc < 3 || argc > 4) {
+    std::cerr << "Usage: " << argv[0] << " <input.txt> <output.bin> [tile_size]\n";
+    return EXIT_FAILURE;
+  }
+
+  uint32_t tile_size = gazebo::kDefaultWindFieldTileSize;
+  if (argc == 4) {
+    const int tile_size_arg = std::atoi(argv[3]);
+    if (tile_size_arg <= 0) {
+      std::cerr << "Tile size must be a positive integer.\n";
+      return EXIT_FAILURE;
+    }
+    tile_size = tile_size_arg;
+  }
+
+  gazebo::WindFieldData data;
+  if (!data.ReadTextFile(argv[1])) {
+    std::cerr << "Could not read a consistent wind field from '" << argv[1] << "'.\n";
+    return EXIT_FAILURE;
+  }
+
+  if (!gazebo::WindField::WriteBinary(data, argv[2], tile_size)) {
+    std::cerr << "Could not write binary wind field to '" << argv[2] << "'.\n";
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Converted wind field with " << data.n_x << " x " << data.n_y
+            << " x " << data.vertical_spacing_factors.size() << " vertices.\n";
+  return EXIT_SUCCESS;
+}
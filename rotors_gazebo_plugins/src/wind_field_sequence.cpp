@@ -0,0 +1,179 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/wind_field_sequence.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace gazebo {
+
+WindFieldSequence::WindFieldSequence()
+    : n_frames_(0),
+      frame_period_(1.0),
+      current_slot_(0),
+      prefetch_slot_(2),
+      prefetch_frame_(-1),
+      prefetch_ready_(false),
+      loading_(false),
+      stop_(false) {
+  std::fill(slot_frame_, slot_frame_ + kNumSlots, -1);
+}
+
+WindFieldSequence::~WindFieldSequence() {
+  Close();
+}
+
+bool WindFieldSequence::Open(const std::string& path_pattern, int n_frames,
+                             double frame_period) {
+  Close();
+  if (n_frames < 2 || frame_period <= 0.0) {
+    return false;
+  }
+  path_pattern_ = path_pattern;
+  n_frames_ = n_frames;
+  frame_period_ = frame_period;
+
+  // The first two frames are needed right away.
+  for (int i = 0; i < 2; ++i) {
+    if (!slots_[i].Load(FramePath(i))) {
+      Close();
+      return false;
+    }
+    slot_frame_[i] = i;
+  }
+  current_slot_ = 0;
+  prefetch_slot_ = 2;
+  prefetch_frame_ = n_frames_ > 2 ? 2 : -1;
+  prefetch_ready_ = false;
+  stop_ = false;
+  prefetch_thread_ = std::thread(&WindFieldSequence::PrefetchThread, this);
+  return true;
+}
+
+void WindFieldSequence::Close() {
+  if (prefetch_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    condition_.notify_one();
+    prefetch_thread_.join();
+  }
+  for (int i = 0; i < kNumSlots; ++i) {
+    slots_[i].Clear();
+    slot_frame_[i] = -1;
+  }
+  prefetch_frame_ = -1;
+  prefetch_ready_ = false;
+  n_frames_ = 0;
+}
+
+void WindFieldSequence::GetFrames(double time, const WindField** frame_a,
+                                  const WindField** frame_b, double* alpha) {
+  const int desired_frame = std::min(
+      std::max(static_cast<int>(std::floor(time / frame_period_)), 0),
+      n_frames_ - 2);
+
+  // The loaded frames are all later than the time after it went back.
+  if (desired_frame < slot_frame_[current_slot_]) {
+    Rewind(desired_frame);
+  }
+
+  // Move forward as long as the frame after the current pair is available.
+  while (slot_frame_[current_slot_] < desired_frame && prefetch_ready_.load()) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    slot_frame_[prefetch_slot_] = prefetch_frame_;
+    // The oldest frame is not needed anymore and is overwritten next.
+    const int free_slot = current_slot_;
+    current_slot_ = (current_slot_ + 1) % kNumSlots;
+    prefetch_slot_ = free_slot;
+    slot_frame_[free_slot] = -1;
+    const int next_frame = slot_frame_[current_slot_] + 2;
+    prefetch_frame_ = next_frame < n_frames_ ? next_frame : -1;
+    prefetch_ready_ = false;
+    condition_.notify_one();
+  }
+
+  const int frame = slot_frame_[current_slot_];
+  *frame_a = &slots_[current_slot_];
+  *frame_b = &slots_[(current_slot_ + 1) % kNumSlots];
+  *alpha = std::min(std::max((time - frame * frame_period_) / frame_period_, 0.0), 1.0);
+}
+
+void WindFieldSequence::Rewind(int frame) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Nothing new is prefetched, and the slot of a frame still being loaded is
+  // only reused once it is done.
+  prefetch_frame_ = -1;
+  loaded_condition_.wait(lock, [this] { return !loading_; });
+  lock.unlock();
+
+  for (int i = 0; i < 2; ++i) {
+    const int slot = (current_slot_ + i) % kNumSlots;
+    // A frame that fails to load leaves the slot empty, as in the prefetch.
+    slots_[slot].Load(FramePath(frame + i));
+    slot_frame_[slot] = frame + i;
+  }
+
+  lock.lock();
+  prefetch_slot_ = (current_slot_ + 2) % kNumSlots;
+  slot_frame_[prefetch_slot_] = -1;
+  prefetch_frame_ = frame + 2 < n_frames_ ? frame + 2 : -1;
+  prefetch_ready_ = false;
+  condition_.notify_one();
+}
+
+std::string WindFieldSequence::FramePath(int frame) const {
+  std::vector<char> path(path_pattern_.size() + 32);
+  snprintf(path.data(), path.size(), path_pattern_.c_str(), frame);
+  return std::string(path.data());
+}
+
+void WindFieldSequence::PrefetchThread() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    condition_.wait(lock, [this] {
+      return stop_ || (prefetch_frame_ >= 0 && !prefetch_ready_);
+    });
+    if (stop_) {
+      return;
+    }
+    const int slot = prefetch_slot_;
+    const std::string path = FramePath(prefetch_frame_);
+    loading_ = true;
+
+    // Load without holding the lock, the physics thread does not touch the
+    // prefetch slot until prefetch_ready_ is set. A frame that fails to load
+    // leaves the slot empty, which falls back to the default wind.
+    lock.unlock();
+    if (slots_[slot].Load(path)) {
+      slots_[slot].PageIn();
+    }
+    lock.lock();
+    loading_ = false;
+    prefetch_ready_ = true;
+    loaded_condition_.notify_all();
+  }
+}
+
+}  // namespace gazebo
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/wind_service.h"
+
+#include <map>
+#include <mutex>
+
+namespace gazebo {
+
+namespace {
+
+std::mutex& RegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::map<const physics::World*, std::shared_ptr<WindService> >& Registry() {
+  static std::map<const physics::World*, std::shared_ptr<WindService> > registry;
+  return registry;
+}
+
+}  // namespace
+
+WindService::WindService(physics::WorldPtr world)
+    : world_(world),
+      last_update_iteration_(0),
+      updated_(false),
+      default_wind_velocity_(0.0, 0.0, 0.0),
+      frame_count_(1) {}
+
+void WindService::Advertise(const std::shared_ptr<WindService>& service) {
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  Registry()[service->world_.get()] = service;
+}
+
+void WindService::Unadvertise(const physics::WorldPtr& world) {
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  Registry().erase(world.get());
+}
+
+std::shared_ptr<WindService> WindService::Find(const physics::WorldPtr& world) {
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  auto it = Registry().find(world.get());
+  if (it == Registry().end()) {
+    return nullptr;
+  }
+  return it->second;
+}
+
+bool WindService::LoadWindField(const std::string& path, int frame_count,
+                                double frame_period) {
+  frame_count_ = frame_count;
+  if (frame_count_ > 1) {
+    return wind_field_sequence_.Open(path, frame_count, frame_period);
+  }
+  return wind_field_.Load(path);
+}
+
+int WindService::RegisterLink(const physics::LinkPtr& link) {
+  std::lock_guard<std::mutex> lock(update_mutex_);
+  links_.push_back(link);
+  wind_velocities_.push_back(default_wind_velocity_);
+  // Make sure the new link is evaluated in the current physics step.
+  updated_ = false;
+  return links_.size() - 1;
+}
+
+void WindService::UnregisterLink(int id) {
+  std::lock_guard<std::mutex> lock(update_mutex_);
+  links_[id].reset();
+}
+
+ignition::math::Vector3d WindService::GetWindVelocity(int id) {
+  Update();
+  std::lock_guard<std::mutex> lock(update_mutex_);
+  return wind_velocities_[id];
+}
+
+void WindService::Update() {
+  std::lock_guard<std::mutex> lock(update_mutex_);
+  const uint64_t iteration = world_->Iterations();
+  if (updated_ && iteration == last_update_iteration_) {
+    return;
+  }
+  updated_ = true;
+  last_update_iteration_ = iteration;
+
+  // Select the frames once for all links.
+  const WindField* frame_a = &wind_field_;
+  const WindField* frame_b = nullptr;
+  double alpha = 0.0;
+  if (frame_count_ > 1) {
+    wind_field_sequence_.GetFrames(world_->SimTime().Double(), &frame_a, &frame_b,
+                                   &alpha);
+  }
+
+  for (std::size_t i = 0u; i < links_.size(); ++i) {
+    if (!links_[i]) {
+      continue;
+    }
+    const ignition::math::Vector3d position = links_[i]->WorldPose().Pos();
+    WindVelocity velocity_a;
+    if (!frame_a->Interpolate(position.X(), position.Y(), position.Z(), &velocity_a)) {
+      wind_velocities_[i] = default_wind_velocity_;
+      continue;
+    }
+    if (frame_b != nullptr) {
+      WindVelocity velocity_b;
+      if (!frame_b->Interpolate(position.X(), position.Y(), position.Z(), &velocity_b)) {
+        wind_velocities_[i] = default_wind_velocity_;
+        continue;
+      }
+      velocity_a.u += (velocity_b.u - velocity_a.u) * alpha;
+      velocity_a.v += (velocity_b.v - velocity_a.v) * alpha;
+      velocity_a.w += (velocity_b.w - velocity_a.w) * alpha;
+    }
+    wind_velocities_[i].Set(velocity_a.u, velocity_a.v, velocity_a.w);
+  }
+}
+
+}  // namespace gazebo
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/wind_turbulence.h"
+
+#include <algorithm>
+#include <complex>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+
+namespace gazebo {
+
+namespace {
+
+/// \brief Scale of the length in the von Karman spectrum, a / L with the
+///        constant a of the spectrum.
+static constexpr double kVonKarmanScale = 1.339;
+
+std::mutex& RegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::map<std::string, std::weak_ptr<const WindTurbulence> >& Registry() {
+  static std::map<std::string, std::weak_ptr<const WindTurbulence> > registry;
+  return registry;
+}
+
+/// \brief One sided spatial power spectral density [m^3/s^2] of an axis at
+///        the spatial frequency omega [rad/m], normalized to unit variance.
+double SpectralDensity(TurbulenceModel model, int axis, double length_scale,
+                       double omega) {
+  if (model == TurbulenceModel::kDryden) {
+    const double x = length_scale * omega;
+    if (axis == 0) {
+      return 2.0 * length_scale / M_PI / (1.0 + x * x);
+    }
+    return length_scale / M_PI * (1.0 + 3.0 * x * x) /
+           ((1.0 + x * x) * (1.0 + x * x));
+  }
+  const double x = kVonKarmanScale * length_scale * omega;
+  if (axis == 0) {
+    return 2.0 * length_scale / M_PI / std::pow(1.0 + x * x, 5.0 / 6.0);
+  }
+  return length_scale / M_PI * (1.0 + 8.0 / 3.0 * x * x) /
+         std::pow(1.0 + x * x, 11.0 / 6.0);
+}
+
+/// \brief In place radix 2 FFT of a power of two number of values, without
+///        normalization. The inverse transform uses the positive exponent.
+void Fft(std::vector<std::complex<double> >* values, bool inverse) {
+  std::vector<std::complex<double> >& x = *values;
+  const size_t n = x.size();
+  for (size_t i = 1, j = 0; i < n; ++i) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) std::swap(x[i], x[j]);
+  }
+  for (size_t length = 2; length <= n; length <<= 1) {
+    const double angle = (inverse ? 2.0 : -2.0) * M_PI / length;
+    const std::complex<double> step(std::cos(angle), std::sin(angle));
+    for (size_t start = 0; start < n; start += length) {
+      std::complex<double> twiddle(1.0, 0.0);
+      for (size_t k = 0; k < length / 2; ++k) {
+        const std::complex<double> even = x[start + k];
+        const std::complex<double> odd = x[start + k + length / 2] * twiddle;
+        x[start + k] = even + odd;
+        x[start + k + length / 2] = even - odd;
+        twiddle *= step;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+bool ParseTurbulenceModel(const std::string& name, TurbulenceModel* model) {
+  if (name == "dryden") {
+    *model = TurbulenceModel::kDryden;
+  } else if (name == "von_karman") {
+    *model = TurbulenceModel::kVonKarman;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+WindTurbulence::WindTurbulence(const TurbulenceParams& params)
+    : sample_spacing_(std::max(params.sample_spacing, 1.0e-3)),
+      inv_sample_spacing_(1.0 / sample_spacing_),
+      index_mask_(0) {
+  size_t num_samples = 2;
+  while (num_samples < static_cast<size_t>(params.num_samples)) {
+    num_samples <<= 1;
+  }
+  index_mask_ = num_samples - 1;
+  samples_.assign(3 * num_samples, 0.0f);
+
+  // Spatial frequencies k * d_omega for k in [1, n / 2), the mean and the
+  // Nyquist frequency are left out.
+  const double d_omega = 2.0 * M_PI / (num_samples * sample_spacing_);
+  std::mt19937 generator(params.seed);
+  std::normal_distribution<double> white_noise(0.0, 1.0);
+  std::vector<std::complex<double> > spectrum(num_samples);
+  for (int axis = 0; axis < 3; ++axis) {
+    std::fill(spectrum.begin(), spectrum.end(), std::complex<double>(0.0, 0.0));
+    const double length_scale = std::max(params.length_scale[axis], 1.0e-3);
+    double variance = 0.0;
+    for (size_t k = 1; k < num_samples / 2; ++k) {
+      const double power =
+          SpectralDensity(params.model, axis, length_scale, k * d_omega) *
+          d_omega;
+      const double real = white_noise(generator);
+      const double imag = white_noise(generator);
+      spectrum[k] = std::sqrt(power) * std::complex<double>(real, imag);
+      variance += power;
+    }
+    Fft(&spectrum, true);
+
+    // The discrete spectrum misses the tails below the lowest and above the
+    // highest frequency, it is scaled to the full variance.
+    const double scale =
+        variance > 0.0 ? params.std_dev[axis] / std::sqrt(variance) : 0.0;
+    for (size_t i = 0; i < num_samples; ++i) {
+      samples_[3 * i + axis] = static_cast<float>(scale * spectrum[i].real());
+    }
+  }
+}
+
+std::shared_ptr<const WindTurbulence> WindTurbulence::Get(
+    const TurbulenceParams& params) {
+  std::ostringstream key;
+  key << std::setprecision(17) << static_cast<int>(params.model) << " "
+      << params.sample_spacing << " " << params.num_samples << " "
+      << params.seed;
+  for (int axis = 0; axis < 3; ++axis) {
+    key << " " << params.std_dev[axis] << " " << params.length_scale[axis];
+  }
+
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  std::weak_ptr<const WindTurbulence>& entry = Registry()[key.str()];
+  std::shared_ptr<const WindTurbulence> turbulence = entry.lock();
+  if (!turbulence) {
+    turbulence = std::make_shared<WindTurbulence>(params);
+    entry = turbulence;
+  }
+  return turbulence;
+}
+
+}  // namespace gazebo
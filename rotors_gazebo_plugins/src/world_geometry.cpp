@@ -0,0 +1,121 @@
+/*
+ * Copyright 2015 Fadri Furrer, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Mina Kamel, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Janosch Nikolic, ASL, ETH Zurich, Switzerland
+ * Copyright 2015 Markus Achtelik, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_gazebo_plugins/world_geometry.h"
+
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace gazebo {
+
+namespace {
+
+/// \brief Margin added to the collision bounds [m], so that a ray grazing
+///        the surface of a bounding box is still cast.
+static constexpr double kBoundPadding = 1.0e-4;
+
+}  // namespace
+
+bool GeometryBound::Intersects(const ignition::math::Vector3d& box_min,
+                               const ignition::math::Vector3d& box_max) const {
+  if (is_plane) {
+    // Distance of the box center to the plane against the projected extent.
+    const ignition::math::Vector3d center = (box_min + box_max) / 2;
+    const ignition::math::Vector3d half_size = (box_max - box_min) / 2;
+    const double extent = half_size.X() * std::abs(normal.X()) +
+                          half_size.Y() * std::abs(normal.Y()) +
+                          half_size.Z() * std::abs(normal.Z());
+    return std::abs(normal.Dot(center) - offset) <= extent + kBoundPadding;
+  }
+  return box_min.X() <= max.X() + kBoundPadding &&
+         box_max.X() >= min.X() - kBoundPadding &&
+         box_min.Y() <= max.Y() + kBoundPadding &&
+         box_max.Y() >= min.Y() - kBoundPadding &&
+         box_min.Z() <= max.Z() + kBoundPadding &&
+         box_max.Z() >= min.Z() - kBoundPadding;
+}
+
+bool GeometryBound::IntersectsRay(
+    const ignition::math::Vector3d& origin,
+    const ignition::math::Vector3d& direction) const {
+  if (is_plane) return false;
+
+  // Slab test, the ray parameter is clipped to [0, inf) by every axis.
+  double t_enter = 0.0;
+  double t_exit = std::numeric_limits<double>::infinity();
+  for (int axis = 0; axis < 3; ++axis) {
+    if (direction[axis] == 0.0) {
+      if (origin[axis] < min[axis] || origin[axis] > max[axis]) return false;
+      continue;
+    }
+    double t_min = (min[axis] - origin[axis]) / direction[axis];
+    double t_max = (max[axis] - origin[axis]) / direction[axis];
+    if (t_min > t_max) std::swap(t_min, t_max);
+    t_enter = std::max(t_enter, t_min);
+    t_exit = std::min(t_exit, t_max);
+    if (t_enter > t_exit) return false;
+  }
+  return true;
+}
+
+std::vector<GeometryBound> CollectGeometryBounds(const physics::WorldPtr& world,
+                                                 bool static_only) {
+  std::vector<GeometryBound> bounds;
+  // Nested models of a static model are static as well.
+  std::vector<std::pair<physics::ModelPtr, bool> > models;
+  for (const physics::ModelPtr& model : world->Models()) {
+    models.emplace_back(model, model->IsStatic());
+  }
+  while (!models.empty()) {
+    const physics::ModelPtr model = models.back().first;
+    const bool is_static = models.back().second;
+    models.pop_back();
+    for (const physics::ModelPtr& nested_model : model->NestedModels()) {
+      models.emplace_back(nested_model, is_static || nested_model->IsStatic());
+    }
+    if (static_only && !is_static) continue;
+
+    for (const physics::LinkPtr& link : model->GetLinks()) {
+      for (const physics::CollisionPtr& collision : link->GetCollisions()) {
+        GeometryBound bound;
+        const physics::ShapePtr shape = collision->GetShape();
+        bound.is_plane = shape && shape->HasType(physics::Base::PLANE_SHAPE);
+        if (bound.is_plane) {
+          // The bounding box of an infinite plane would cover everything.
+          const physics::PlaneShapePtr plane =
+              boost::dynamic_pointer_cast<physics::PlaneShape>(shape);
+          const ignition::math::Pose3d pose = collision->WorldPose();
+          bound.normal = pose.Rot().RotateVector(plane->Normal());
+          bound.normal.Normalize();
+          bound.offset = bound.normal.Dot(pose.Pos());
+        } else {
+          const auto box = collision->BoundingBox();
+          bound.min = box.Min();
+          bound.max = box.Max();
+        }
+        bounds.push_back(bound);
+      }
+    }
+  }
+  return bounds;
+}
+
+}  // namespace gazebo
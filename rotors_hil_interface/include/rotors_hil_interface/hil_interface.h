@@ -17,6 +17,11 @@
 #ifndef ROTORS_HIL_INTERFACE_H_
 #define ROTORS_HIL_INTERFACE_H_
 
+#include <atomic>
+
+#include <boost/lockfree/queue.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 #include <mav_msgs/Actuators.h>
 #include <mav_msgs/default_topics.h>
 #include <mavros_msgs/HilControls.h>
@@ -35,6 +40,7 @@ static constexpr int kAllFieldsUpdated = 4095;
 
 // Default values
 static constexpr double kDefaultGpsFrequency = 5.0;
+static constexpr int kDefaultHilQueueCapacity = 64;
 static const std::string kDefaultPressureSubTopic = "air_pressure";
 
 /// \brief Convert ros::Time into single value in microseconds.
@@ -45,18 +51,153 @@ inline u_int64_t RosTimeToMicroseconds(const ros::Time& rostime) {
           static_cast<uint64_t>(rostime.sec * 1e6));
 }
 
+/// \brief Convert an encoded MAVLINK message into MAVROS format.
+/// \param[in] mmsg Encoded MAVLINK message.
+/// \param[in] stamp Time of the data in the message.
+/// \param[out] rmsg MAVROS message to be published.
+inline void MavlinkToMavros(const mavlink_message_t& mmsg, const ros::Time& stamp,
+                            mavros_msgs::Mavlink* rmsg) {
+  rmsg->header.stamp.sec = stamp.sec;
+  rmsg->header.stamp.nsec = stamp.nsec;
+  mavros_msgs::mavlink::convert(mmsg, *rmsg);
+}
+
+/// Encoded MAVLINK message waiting to be sent.
+struct HilMavlinkMessage {
+  mavlink_message_t message;
+  ros::Time stamp;
+};
+
+/// \brief Bounded queue of encoded MAVLINK messages between the sensor
+///        callbacks and the thread that sends them.
+/// \details Push() is lock-free; the mutex is only taken to wake up a
+///          sender that is blocked in Pop() on an empty queue.
+class HilMessageQueue {
+ public:
+  /// \brief Constructor
+  /// \param[in] capacity Maximum number of queued messages.
+  explicit HilMessageQueue(int capacity)
+      : queue_(capacity),
+        sender_waiting_(false) {}
+
+  /// \brief Queue a message, called from the sensor callbacks.
+  /// \return False if the queue is full and the message was dropped.
+  bool Push(const mavlink_message_t& message, const ros::Time& stamp) {
+    HilMavlinkMessage hil_message;
+    hil_message.message = message;
+    hil_message.stamp = stamp;
+    if (!queue_.bounded_push(hil_message))
+      return false;
+
+    // Pairs with the fence in Pop(), either the sender sees the message or
+    // we see that it is waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sender_waiting_.load(std::memory_order_relaxed)) {
+      boost::mutex::scoped_lock lock(mtx_);
+      cond_.notify_one();
+    }
+    return true;
+  }
+
+  /// \brief Take the oldest message if there is one, never blocks.
+  bool TryPop(HilMavlinkMessage* hil_message) {
+    return queue_.pop(*hil_message);
+  }
+
+  /// \brief Take the oldest message, blocking until one arrives.
+  /// \param[out] hil_message The oldest queued message.
+  /// \param[in] timeout Maximum time to wait for a message.
+  /// \return False if no message arrived within the timeout.
+  bool Pop(HilMavlinkMessage* hil_message,
+           const boost::posix_time::time_duration& timeout) {
+    if (queue_.pop(*hil_message))
+      return true;
+
+    boost::mutex::scoped_lock lock(mtx_);
+    sender_waiting_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool popped = queue_.pop(*hil_message);
+    if (!popped && cond_.timed_wait(lock, timeout))
+      popped = queue_.pop(*hil_message);
+    sender_waiting_.store(false, std::memory_order_relaxed);
+    return popped;
+  }
+
+ private:
+  boost::lockfree::queue<HilMavlinkMessage> queue_;
+  std::atomic<bool> sender_waiting_;
+  boost::mutex mtx_;
+  boost::condition_variable cond_;
+};
+
 class HilInterface {
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
+  /// \brief Constructor
+  HilInterface() : hil_queue_(NULL) {}
+
   /// \brief Destructor
   virtual ~HilInterface() {};
 
+  /// \brief Gather data collected from ROS messages into MAVLINK messages.
+  /// \details Reads the sensor data without locking, so the callbacks never
+  ///          wait for it. Must only be called from one thread.
+  /// \param[out] hil_msgs Encoded MAVLINK messages to be sent, the vector is
+  ///             cleared first so that it can be reused.
+  virtual void CollectMavlink(std::vector<HilMavlinkMessage>* hil_msgs) = 0;
+
   /// \brief Gather data collected from ROS messages into MAVLINK messages.
   /// \return Vector of MAVLINK messages (in MAVROS format) to be publised.
-  std::vector<mavros_msgs::Mavlink> virtual CollectData() = 0;
+  std::vector<mavros_msgs::Mavlink> CollectData() {
+    std::vector<HilMavlinkMessage> hil_msgs;
+    CollectMavlink(&hil_msgs);
+    std::vector<mavros_msgs::Mavlink> mavros_msgs(hil_msgs.size());
+    for (size_t i = 0; i < hil_msgs.size(); ++i)
+      MavlinkToMavros(hil_msgs[i].message, hil_msgs[i].stamp, &mavros_msgs[i]);
+    return mavros_msgs;
+  }
+
+  /// \brief Encode the HIL messages as soon as the sensor data they are
+  ///        triggered by arrives, instead of in CollectData().
+  /// \details The callbacks must be called from a single thread.
+  /// \param[in] hil_queue Queue receiving the encoded messages.
+  void EnableEventDriven(HilMessageQueue* hil_queue) { hil_queue_ = hil_queue; }
 
  protected:
+  /// \brief Callback for handling IMU messages, forwards them to the
+  ///        listeners and triggers OnImu() in event-driven mode.
+  void ImuCallback(const sensor_msgs::ImuConstPtr& imu_msg) {
+    hil_listeners_.ImuCallback(imu_msg);
+    if (hil_queue_)
+      OnImu(imu_msg->header.stamp);
+  }
+
+  /// \brief Callback for handling GPS messages, forwards them to the
+  ///        listeners and triggers OnGps() in event-driven mode.
+  void GpsCallback(const sensor_msgs::NavSatFixConstPtr& gps_msg) {
+    hil_listeners_.GpsCallback(gps_msg);
+    if (hil_queue_)
+      OnGps(gps_msg->header.stamp);
+  }
+
+  /// \brief Encode and queue the messages triggered by new IMU data.
+  /// \param[in] stamp Time of the IMU data.
+  virtual void OnImu(const ros::Time& stamp) {}
+
+  /// \brief Encode and queue the messages triggered by new GPS data.
+  /// \param[in] stamp Time of the GPS data.
+  virtual void OnGps(const ros::Time& stamp) {}
+
+  /// \brief Queue an encoded message, warn if it had to be dropped.
+  void QueueMessage(const mavlink_message_t& mmsg, const ros::Time& stamp) {
+    if (!hil_queue_->Push(mmsg, stamp))
+      ROS_WARN_THROTTLE(1.0, "HIL message queue full, dropping messages.");
+  }
+
+  /// Queue of the event-driven mode, NULL when polled by CollectData().
+  HilMessageQueue* hil_queue_;
+
   /// ROS node handle.
   ros::NodeHandle nh_;
 
@@ -84,14 +225,11 @@ class HilInterface {
   /// Rotation, in matrix form, from body into sensor (NED) frame.
   Eigen::Matrix3f R_S_B_;
 
-  /// Object for storing the latest data.
+  /// Snapshot of the latest data, refreshed before every encoding.
   HilData hil_data_;
 
   /// Object with callbacks for receiving data.
   HilListeners hil_listeners_;
-
-  /// Mutex lock for thread safety of reading hil data.
-  boost::mutex mtx_;
 };
 
 class HilSensorLevelInterface : public HilInterface {
@@ -103,9 +241,19 @@ class HilSensorLevelInterface : public HilInterface {
   /// \brief Destructor
   virtual ~HilSensorLevelInterface();
 
-  std::vector<mavros_msgs::Mavlink> CollectData();
+  void CollectMavlink(std::vector<HilMavlinkMessage>* hil_msgs);
+
+ protected:
+  void OnImu(const ros::Time& stamp);
+  void OnGps(const ros::Time& stamp);
 
  private:
+  /// \brief Fill in a MAVLINK HIL_SENSOR message from the latest data.
+  void EncodeHilSensor(const ros::Time& stamp, mavlink_message_t* mmsg);
+
+  /// \brief Fill in a MAVLINK HIL_GPS message from the latest data.
+  void EncodeHilGps(const ros::Time& stamp, mavlink_message_t* mmsg);
+
   /// MAVLINK HIL_GPS message.
   mavlink_hil_gps_t hil_gps_msg_;
 
@@ -128,9 +276,15 @@ class HilStateLevelInterface : public HilInterface {
   /// \brief Destructor
   virtual ~HilStateLevelInterface();
 
-  std::vector<mavros_msgs::Mavlink> CollectData();
+  void CollectMavlink(std::vector<HilMavlinkMessage>* hil_msgs);
+
+ protected:
+  void OnImu(const ros::Time& stamp);
 
  private:
+  /// \brief Fill in a MAVLINK HIL_STATE_QUATERNION message from the latest data.
+  void EncodeHilStateQuaternion(const ros::Time& stamp, mavlink_message_t* mmsg);
+
   /// MAVLINK HIL_STATE_QUATERNION message.
   mavlink_hil_state_quaternion_t hil_state_qtrn_msg_;
 };
@@ -20,16 +20,19 @@
 #include <memory>
 
 #include <rotors_hil_interface/hil_interface.h>
+#include <rotors_hil_interface/hil_mavlink_link.h>
 
 namespace rotors_hil {
 // Default values
 static constexpr bool kDefaultSensorLevelHil = true;
+static constexpr bool kDefaultEventDriven = false;
 static constexpr double kDefaultHilFrequency = 100.0;
 static constexpr double kDefaultBodyToSensorsRoll = M_PI;
 static constexpr double kDefaultBodyToSensorsPitch = 0.0;
 static constexpr double kDefaultBodyToSensorsYaw = 0.0;
 static const std::string kDefaultMavlinkPubTopic = "mavlink/to";
 static const std::string kDefaultHilControlsSubTopic = "mavros/hil_controls/hil_controls";
+static const std::string kDefaultMavlinkLinkUrl = "";
 
 class HilInterfaceNode {
  public:
@@ -39,11 +42,27 @@ class HilInterfaceNode {
   /// \brief Main execution loop.
   void MainTask();
 
+  /// \brief Main execution loop of the event-driven mode, sends every HIL
+  ///        message as soon as the sensor callbacks queued it.
+  void EventDrivenTask();
+
   /// \brief Callback for handling HilControls messages.
   /// \param[in] hil_controls_msg A HilControls message.
   void HilControlsCallback(const mavros_msgs::HilControlsConstPtr& hil_controls_msg);
 
+  /// \brief Callback for messages received on the direct MAVLINK link.
+  /// \param[in] message A decoded MAVLINK message.
+  void LinkMessageCallback(const mavlink_message_t& message);
+
  private:
+  /// \brief Send one batch of HIL messages, either over the direct link or
+  ///        to MAVROS.
+  void SendMessages(const std::vector<HilMavlinkMessage>& hil_msgs);
+
+  /// \brief Publish the actuator commands received from the autopilot.
+  void PublishActuators(float roll, float pitch, float yaw,
+                        float aux1, float aux2, float throttle);
+
   /// ROS node handle.
   ros::NodeHandle nh_;
 
@@ -61,6 +80,18 @@ class HilInterfaceNode {
 
   /// Pointer to the HIL interface object.
   std::unique_ptr<HilInterface> hil_interface_;
+
+  /// Queue of encoded messages in event-driven mode, NULL when polling.
+  std::unique_ptr<HilMessageQueue> hil_queue_;
+
+  /// Direct MAVLINK connection to the autopilot, NULL when going through MAVROS.
+  std::unique_ptr<HilMavlinkLink> mavlink_link_;
+
+  /// Batch of encoded messages, reused between cycles.
+  std::vector<HilMavlinkMessage> hil_msgs_;
+
+  /// Number of batches the direct MAVLINK link failed to send.
+  uint64_t num_dropped_batches_;
 };
 }
 
@@ -17,7 +17,6 @@
 #ifndef ROTORS_HIL_LISTENERS_H_
 #define ROTORS_HIL_LISTENERS_H_
 
-#include <boost/thread/mutex.hpp>
 #include <Eigen/Dense>
 #include <geometry_msgs/TwistStamped.h>
 #include <ros/ros.h>
@@ -26,6 +25,8 @@
 #include <sensor_msgs/MagneticField.h>
 #include <sensor_msgs/NavSatFix.h>
 
+#include <rotors_hil_interface/triple_buffer.h>
+
 namespace rotors_hil {
 // Constants
 static constexpr float kAirDensity_kg_per_m3 = 1.18;
@@ -81,20 +82,77 @@ struct HilData {
   uint8_t satellites_visible;         // Number of satellites visible. If unknown, set to 255
 };
 
+/// Latest air speed data.
+struct AirSpeedSample {
+  AirSpeedSample() : ind_airspeed_1e2m_per_s(0), true_airspeed_1e2m_per_s(0) {}
+
+  uint16_t ind_airspeed_1e2m_per_s;
+  uint16_t true_airspeed_1e2m_per_s;
+};
+
+/// Latest GPS fix.
+struct GpsSample {
+  GpsSample() : lat_1e7deg(0), lon_1e7deg(0), alt_mm(0), fix_type(kFixNone) {}
+
+  uint32_t lat_1e7deg;
+  uint32_t lon_1e7deg;
+  uint32_t alt_mm;
+  uint8_t fix_type;
+};
+
+/// Latest ground speed data.
+struct GroundSpeedSample {
+  GroundSpeedSample() : gps_vel_cm_per_s(Eigen::Vector3i::Zero()), vel_1e2m_per_s(0) {}
+
+  Eigen::Vector3i gps_vel_cm_per_s;
+  uint16_t vel_1e2m_per_s;
+};
+
+/// Latest IMU data.
+struct ImuSample {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  ImuSample() :
+      att(Eigen::Quaterniond::Identity()),
+      acc_m_per_s2(Eigen::Vector3f::Zero()),
+      gyro_rad_per_s(Eigen::Vector3f::Zero()) {}
+
+  Eigen::Quaterniond att;
+  Eigen::Vector3f acc_m_per_s2;
+  Eigen::Vector3f gyro_rad_per_s;
+};
+
+/// Latest magnetometer data.
+struct MagSample {
+  MagSample() : mag_G(Eigen::Vector3f::Zero()) {}
+
+  Eigen::Vector3f mag_G;
+};
+
+/// Latest air pressure data.
+struct PressureSample {
+  PressureSample() : pressure_abs_mBar(0), pressure_alt(0) {}
+
+  float pressure_abs_mBar;
+  float pressure_alt;
+};
+
+/// \brief Callbacks converting the sensor messages into HIL units.
+/// \details Every sensor has its own TripleBuffer slot, so a callback never
+///          waits for the reader or for another sensor, and GetSnapshot()
+///          reads all of them without locking. Each callback must only be
+///          called from one thread at a time, and GetSnapshot() from one
+///          thread only.
 class HilListeners {
  public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
   HilListeners() {}
   virtual ~HilListeners() {}
 
   /// \brief Callback for handling Air Speed messages.
   /// \param[in] air_speed_msg An Air Speed message.
-  /// \param[out] hil_data Pointer to latest data collected for HIL publishing.
-  void AirSpeedCallback(const geometry_msgs::TwistStampedConstPtr& air_speed_msg,
-                        HilData* hil_data) {
-    boost::mutex::scoped_lock lock(mtx_);
-
-    ROS_ASSERT(hil_data);
-
+  void AirSpeedCallback(const geometry_msgs::TwistStampedConstPtr& air_speed_msg) {
     Eigen::Vector3d air_velocity(air_speed_msg->twist.linear.x,
                                  air_speed_msg->twist.linear.y,
                                  air_speed_msg->twist.linear.z);
@@ -104,104 +162,121 @@ class HilListeners {
     // TODO(pvechersky): Simulate indicated air speed.
 
     // MAVLINK HIL_STATE_QUATERNION message measured airspeed in cm/s.
-    hil_data->ind_airspeed_1e2m_per_s = air_speed * kMetersToCm;
-    hil_data->true_airspeed_1e2m_per_s = air_speed * kMetersToCm;
+    AirSpeedSample sample;
+    sample.ind_airspeed_1e2m_per_s = air_speed * kMetersToCm;
+    sample.true_airspeed_1e2m_per_s = air_speed * kMetersToCm;
+    air_speed_.Write(sample);
   }
 
   /// \brief Callback for handling GPS messages.
   /// \param[in] gps_msg A GPS message.
-  /// \param[out] hil_data Pointer to latest data collected for HIL publishing.
-  void GpsCallback(const sensor_msgs::NavSatFixConstPtr& gps_msg,
-                   HilData* hil_data) {
-    boost::mutex::scoped_lock lock(mtx_);
-
-    ROS_ASSERT(hil_data);
-
+  void GpsCallback(const sensor_msgs::NavSatFixConstPtr& gps_msg) {
     // MAVLINK HIL_GPS message measures latitude and longitude in degrees * 1e7
     // while altitude is reported in mm.
-    hil_data->lat_1e7deg = gps_msg->latitude * kDegreesToHil;
-    hil_data->lon_1e7deg = gps_msg->longitude * kDegreesToHil;
-    hil_data->alt_mm = gps_msg->altitude * kMetersToMm;
+    GpsSample sample;
+    sample.lat_1e7deg = gps_msg->latitude * kDegreesToHil;
+    sample.lon_1e7deg = gps_msg->longitude * kDegreesToHil;
+    sample.alt_mm = gps_msg->altitude * kMetersToMm;
 
-    hil_data->fix_type =
+    sample.fix_type =
         (gps_msg->status.status > sensor_msgs::NavSatStatus::STATUS_NO_FIX) ?
             kFix3D : kFixNone;
+    gps_.Write(sample);
   }
 
   /// \brief Callback for handling Ground Speed messages.
   /// \param[in] ground_speed_msg A ground speed message.
-  /// \param[out] hil_data Pointer to latest data collected for HIL publishing.
-  void GroundSpeedCallback(const geometry_msgs::TwistStampedConstPtr &ground_speed_msg,
-                           HilData* hil_data) {
-    boost::mutex::scoped_lock lock(mtx_);
-
-    ROS_ASSERT(hil_data);
-
+  void GroundSpeedCallback(const geometry_msgs::TwistStampedConstPtr &ground_speed_msg) {
     // MAVLINK HIL_GPS message measures GPS velocity in cm/s
-    hil_data->gps_vel_cm_per_s =
+    GroundSpeedSample sample;
+    sample.gps_vel_cm_per_s =
         (Eigen::Vector3f(ground_speed_msg->twist.linear.x,
                          ground_speed_msg->twist.linear.y,
                          ground_speed_msg->twist.linear.z) *
          kMetersToCm)
             .cast<int>();
 
-    hil_data->vel_1e2m_per_s = hil_data->gps_vel_cm_per_s.norm();
+    sample.vel_1e2m_per_s = sample.gps_vel_cm_per_s.norm();
+    ground_speed_.Write(sample);
   }
 
   /// \brief Callback for handling IMU messages.
   /// \param[in] imu_msg An IMU message.
-  /// \param[out] hil_data Pointer to latest data collected for HIL publishing.
-  void ImuCallback(const sensor_msgs::ImuConstPtr& imu_msg,
-                   HilData* hil_data) {
-    boost::mutex::scoped_lock lock(mtx_);
-
-    ROS_ASSERT(hil_data);
-
-    hil_data->acc_m_per_s2 = Eigen::Vector3f(imu_msg->linear_acceleration.x,
-                                    imu_msg->linear_acceleration.y,
-                                    imu_msg->linear_acceleration.z);
-
-    hil_data->att = Eigen::Quaterniond(imu_msg->orientation.w,
-                                       imu_msg->orientation.x,
-                                       imu_msg->orientation.y,
-                                       imu_msg->orientation.z);
-
-    hil_data->gyro_rad_per_s = Eigen::Vector3f(imu_msg->angular_velocity.x,
-                                     imu_msg->angular_velocity.y,
-                                     imu_msg->angular_velocity.z);
+  void ImuCallback(const sensor_msgs::ImuConstPtr& imu_msg) {
+    ImuSample sample;
+    sample.acc_m_per_s2 = Eigen::Vector3f(imu_msg->linear_acceleration.x,
+                                          imu_msg->linear_acceleration.y,
+                                          imu_msg->linear_acceleration.z);
+
+    sample.att = Eigen::Quaterniond(imu_msg->orientation.w,
+                                    imu_msg->orientation.x,
+                                    imu_msg->orientation.y,
+                                    imu_msg->orientation.z);
+
+    sample.gyro_rad_per_s = Eigen::Vector3f(imu_msg->angular_velocity.x,
+                                            imu_msg->angular_velocity.y,
+                                            imu_msg->angular_velocity.z);
+    imu_.Write(sample);
   }
 
   /// \brief Callback for handling Magnetometer messages.
   /// \param[in] mag_msg A Magnetometer message.
-  /// \param[out] hil_data Pointer to latest data collected for HIL publishing.
-  void MagCallback(const sensor_msgs::MagneticFieldConstPtr &mag_msg,
-                   HilData* hil_data) {
-    boost::mutex::scoped_lock lock(mtx_);
-
-    ROS_ASSERT(hil_data);
-
+  void MagCallback(const sensor_msgs::MagneticFieldConstPtr &mag_msg) {
     // ROS magnetic field sensor message is in Tesla, while
     // MAVLINK HIL_SENSOR message measures magnetic field in Gauss.
     // 1 Tesla = 10000 Gauss
-    hil_data->mag_G = Eigen::Vector3f(mag_msg->magnetic_field.x,
-                                    mag_msg->magnetic_field.y,
-                                    mag_msg->magnetic_field.z) * kTeslaToGauss;
+    MagSample sample;
+    sample.mag_G = Eigen::Vector3f(mag_msg->magnetic_field.x,
+                                   mag_msg->magnetic_field.y,
+                                   mag_msg->magnetic_field.z) * kTeslaToGauss;
+    mag_.Write(sample);
   }
 
   /// \brief Callback for handling Air Pressure messages.
   /// \param[in] pressure_msg An Air Pressure message.
-  /// \param[out] hil_data Pointer to latest data collected for HIL publishing.
-  void PressureCallback(const sensor_msgs::FluidPressureConstPtr &pressure_msg,
-                        HilData* hil_data) {
-    boost::mutex::scoped_lock lock(mtx_);
-
-    ROS_ASSERT(hil_data);
-
+  void PressureCallback(const sensor_msgs::FluidPressureConstPtr &pressure_msg) {
     // ROS fluid pressure sensor message is in Pascals, while
     // MAVLINK HIL_SENSOR message measures fluid pressure in millibar.
     // 1 Pascal = 0.01 millibar
+    PressureSample sample;
     float pressure_mbar = pressure_msg->fluid_pressure * kPascalToMillibar;
-    hil_data->pressure_abs_mBar = pressure_mbar;
+    sample.pressure_abs_mBar = pressure_mbar;
+
+    sample.pressure_alt =
+        (1 - pow((pressure_mbar / kStandardPressure_MBar), kPressureToAltExp)) *
+            kPressureToAltMult * kFeetToMeters;
+    pressure_.Write(sample);
+  }
+
+  /// \brief Copy the latest data of every sensor.
+  /// \param[out] hil_data Latest data collected for HIL publishing.
+  void GetSnapshot(HilData* hil_data) {
+    ROS_ASSERT(hil_data);
+
+    const AirSpeedSample& air_speed = air_speed_.Read();
+    hil_data->ind_airspeed_1e2m_per_s = air_speed.ind_airspeed_1e2m_per_s;
+    hil_data->true_airspeed_1e2m_per_s = air_speed.true_airspeed_1e2m_per_s;
+
+    const GpsSample& gps = gps_.Read();
+    hil_data->lat_1e7deg = gps.lat_1e7deg;
+    hil_data->lon_1e7deg = gps.lon_1e7deg;
+    hil_data->alt_mm = gps.alt_mm;
+    hil_data->fix_type = gps.fix_type;
+
+    const GroundSpeedSample& ground_speed = ground_speed_.Read();
+    hil_data->gps_vel_cm_per_s = ground_speed.gps_vel_cm_per_s;
+    hil_data->vel_1e2m_per_s = ground_speed.vel_1e2m_per_s;
+
+    const ImuSample& imu = imu_.Read();
+    hil_data->att = imu.att;
+    hil_data->acc_m_per_s2 = imu.acc_m_per_s2;
+    hil_data->gyro_rad_per_s = imu.gyro_rad_per_s;
+
+    hil_data->mag_G = mag_.Read().mag_G;
+
+    const PressureSample& pressure = pressure_.Read();
+    hil_data->pressure_abs_mBar = pressure.pressure_abs_mBar;
+    hil_data->pressure_alt = pressure.pressure_alt;
 
     // From the following formula: p_stag - p_static = 0.5 * rho * v^2
     // HIL air speed is in cm/s and is converted to m/s for the purpose of
@@ -209,15 +284,15 @@ class HilListeners {
     hil_data->pressure_diff_mBar = 0.5 * kAirDensity_kg_per_m3 * hil_data->ind_airspeed_1e2m_per_s *
             hil_data->ind_airspeed_1e2m_per_s * kPascalToMillibar /
             (kMetersToCm * kMetersToCm);
-
-    hil_data->pressure_alt =
-        (1 - pow((pressure_mbar / kStandardPressure_MBar), kPressureToAltExp)) *
-            kPressureToAltMult * kFeetToMeters;
   }
 
  private:
-  /// Mutex lock for thread safety of writing hil data.
-  boost::mutex mtx_;
+  TripleBuffer<AirSpeedSample> air_speed_;
+  TripleBuffer<GpsSample> gps_;
+  TripleBuffer<GroundSpeedSample> ground_speed_;
+  TripleBuffer<ImuSample> imu_;
+  TripleBuffer<MagSample> mag_;
+  TripleBuffer<PressureSample> pressure_;
 };
 
 }
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2016 Pavel Vechersky, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_HIL_MAVLINK_LINK_H_
+#define ROTORS_HIL_MAVLINK_LINK_H_
+
+#include <netinet/in.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+#include <rotors_hil_interface/hil_interface.h>
+
+namespace rotors_hil {
+// Default values
+static constexpr int kDefaultSerialBaudRate = 921600;
+static constexpr int kHilLinkReadBufferSize = 2048;
+static constexpr int kHilLinkPollTimeoutMs = 100;
+
+/// \brief Direct MAVLINK connection to the autopilot, used instead of
+///        publishing the HIL messages to MAVROS.
+/// \details All messages handed to Send() are packed back to back into one
+///          buffer and written with a single system call, so one HIL cycle
+///          costs one write or one datagram no matter how many messages it
+///          contains. Messages coming back from the autopilot are parsed on a
+///          reader thread and handed to the receive callback.
+class HilMavlinkLink {
+ public:
+  typedef boost::function<void(const mavlink_message_t&)> ReceiveCallback;
+
+  /// \brief Destructor, stops the reader thread and closes the link.
+  virtual ~HilMavlinkLink();
+
+  /// \brief Create a link from a URL.
+  /// \param[in] url Either "serial://<device>[:<baud rate>]" or
+  ///            "udp://<host>:<port>".
+  /// \return The opened link, NULL if the URL is invalid or opening failed.
+  static HilMavlinkLink* Create(const std::string& url);
+
+  /// \brief Pack the messages into one buffer and write it in one go.
+  /// \param[in] hil_msgs Encoded MAVLINK messages to be sent.
+  /// \return False if the write failed.
+  bool Send(const std::vector<HilMavlinkMessage>& hil_msgs);
+
+  /// \brief Start the reader thread.
+  /// \param[in] callback Called from the reader thread for every message.
+  void StartReceiving(const ReceiveCallback& callback);
+
+ protected:
+  HilMavlinkLink();
+
+  /// \brief Write one packed buffer to the link.
+  virtual bool Write(const uint8_t* data, size_t length) = 0;
+
+  /// \brief Read whatever is available, called after poll() found data.
+  /// \return Number of bytes read, negative on error.
+  virtual ssize_t Read(uint8_t* data, size_t length) = 0;
+
+  /// \brief Stop the reader thread and close the file descriptor.
+  void Close();
+
+  /// File descriptor of the serial port or the socket, -1 when closed.
+  int fd_;
+
+ private:
+  void ReceiveTask(ReceiveCallback callback);
+
+  /// Packed frames of the current batch, reused between calls.
+  std::vector<uint8_t> tx_buffer_;
+
+  std::atomic<bool> receiving_;
+  boost::thread receive_thread_;
+};
+
+/// \brief MAVLINK over a serial port, e.g. a USB or telemetry connection to a
+///        flight controller on the bench.
+class HilSerialLink : public HilMavlinkLink {
+ public:
+  /// \brief Open and configure the serial port as a raw 8N1 line.
+  /// \param[in] device Path of the serial device.
+  /// \param[in] baud_rate Baud rate of the line.
+  HilSerialLink(const std::string& device, int baud_rate);
+  virtual ~HilSerialLink();
+
+ protected:
+  bool Write(const uint8_t* data, size_t length);
+  ssize_t Read(uint8_t* data, size_t length);
+};
+
+/// \brief MAVLINK over UDP, sends to a fixed remote address.
+class HilUdpLink : public HilMavlinkLink {
+ public:
+  /// \brief Open a socket bound to an ephemeral port.
+  /// \param[in] host Numeric IPv4 address of the autopilot.
+  /// \param[in] port UDP port of the autopilot.
+  HilUdpLink(const std::string& host, int port);
+  virtual ~HilUdpLink();
+
+ protected:
+  bool Write(const uint8_t* data, size_t length);
+  ssize_t Read(uint8_t* data, size_t length);
+
+ private:
+  struct sockaddr_in remote_addr_;
+};
+}
+
+#endif // ROTORS_HIL_MAVLINK_LINK_H_
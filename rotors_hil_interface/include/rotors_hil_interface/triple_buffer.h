@@ -0,0 +1,68 @@
+/*
+ * Copyright 2016 Pavel Vechersky, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROTORS_HIL_TRIPLE_BUFFER_H_
+#define ROTORS_HIL_TRIPLE_BUFFER_H_
+
+#include <atomic>
+
+namespace rotors_hil {
+
+/// \brief Latest-value slot between one writer thread and one reader thread.
+/// \details The writer fills a private back buffer and swaps it with the
+///          shared middle buffer in one atomic exchange; the reader swaps the
+///          middle buffer into its private front buffer only when the writer
+///          published something new. Neither side ever blocks or retries, and
+///          the reader always sees a complete value.
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer() : front_(0), back_(1), middle_(2) {}
+
+  /// \brief Publish a new value, called from the writer thread only.
+  void Write(const T& value) {
+    buffers_[back_] = value;
+    back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) & kIndexMask;
+  }
+
+  /// \brief Latest published value, called from the reader thread only.
+  /// \return Reference that stays valid until the next call to Read().
+  const T& Read() {
+    if (middle_.load(std::memory_order_relaxed) & kFresh)
+      front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+    return buffers_[front_];
+  }
+
+ private:
+  static constexpr int kIndexMask = 0x3;
+  static constexpr int kFresh = 0x4;
+
+  T buffers_[3];
+
+  /// Buffer owned by the reader.
+  int front_;
+
+  /// Buffer owned by the writer.
+  int back_;
+
+  /// Index of the shared buffer, with kFresh set if the reader has not
+  /// taken it yet.
+  std::atomic<int> middle_;
+};
+
+}
+
+#endif // ROTORS_HIL_TRIPLE_BUFFER_H_
@@ -19,10 +19,12 @@
 namespace rotors_hil {
 
 HilInterfaceNode::HilInterfaceNode() :
-    rate_(kDefaultHilFrequency) {
+    rate_(kDefaultHilFrequency),
+    num_dropped_batches_(0) {
   ros::NodeHandle pnh("~");
 
   bool sensor_level_hil;
+  bool event_driven;
   double hil_frequency;
   double S_B_roll;
   double S_B_pitch;
@@ -30,8 +32,10 @@ HilInterfaceNode::HilInterfaceNode() :
   std::string actuators_pub_topic;
   std::string mavlink_pub_topic;
   std::string hil_controls_sub_topic;
+  std::string mavlink_link_url;
 
   pnh.param("sensor_level_hil", sensor_level_hil, kDefaultSensorLevelHil);
+  pnh.param("event_driven", event_driven, kDefaultEventDriven);
   pnh.param("hil_frequency", hil_frequency, kDefaultHilFrequency);
   pnh.param("body_to_sensor_roll", S_B_roll, kDefaultBodyToSensorsRoll);
   pnh.param("body_to_sensor_pitch", S_B_pitch, kDefaultBodyToSensorsPitch);
@@ -39,6 +43,7 @@ HilInterfaceNode::HilInterfaceNode() :
   pnh.param("actuators_pub_topic", actuators_pub_topic, std::string(mav_msgs::default_topics::COMMAND_ACTUATORS));
   pnh.param("mavlink_pub_topic", mavlink_pub_topic, kDefaultMavlinkPubTopic);
   pnh.param("hil_controls_sub_topic", hil_controls_sub_topic, kDefaultHilControlsSubTopic);
+  pnh.param("mavlink_link_url", mavlink_link_url, kDefaultMavlinkLinkUrl);
 
   // Create the quaternion and rotation matrix to rotate data into NED frame.
   Eigen::AngleAxisd roll_angle(S_B_roll, Eigen::Vector3d::UnitX());
@@ -54,47 +59,128 @@ HilInterfaceNode::HilInterfaceNode() :
 
   rate_ = ros::Rate(hil_frequency);
 
+  if (event_driven) {
+    hil_queue_.reset(new HilMessageQueue(kDefaultHilQueueCapacity));
+    hil_interface_->EnableEventDriven(hil_queue_.get());
+  }
+
   actuators_pub_ = nh_.advertise<mav_msgs::Actuators>(actuators_pub_topic, 1);
-  mavlink_pub_ = nh_.advertise<mavros_msgs::Mavlink>(mavlink_pub_topic, 5);
-  hil_controls_sub_ = nh_.subscribe(hil_controls_sub_topic, 1,
-                                        &HilInterfaceNode::HilControlsCallback, this);
+
+  if (!mavlink_link_url.empty()) {
+    // Talk to the autopilot directly, MAVROS must not hold the same port.
+    mavlink_link_.reset(HilMavlinkLink::Create(mavlink_link_url));
+    if (mavlink_link_) {
+      mavlink_link_->StartReceiving(
+          boost::bind(&HilInterfaceNode::LinkMessageCallback, this, _1));
+    } else {
+      ROS_ERROR("Could not open the MAVLINK link %s, sending the HIL messages "
+                "to MAVROS instead.", mavlink_link_url.c_str());
+    }
+  }
+  if (!mavlink_link_) {
+    mavlink_pub_ = nh_.advertise<mavros_msgs::Mavlink>(mavlink_pub_topic, 5);
+    hil_controls_sub_ = nh_.subscribe(hil_controls_sub_topic, 1,
+                                          &HilInterfaceNode::HilControlsCallback, this);
+  }
 }
 
 HilInterfaceNode::~HilInterfaceNode() {
 }
 
 void HilInterfaceNode::MainTask() {
-  while (ros::ok()) {
-    std::vector<mavros_msgs::Mavlink> hil_msgs = hil_interface_->CollectData();
+  if (hil_queue_) {
+    EventDrivenTask();
+    return;
+  }
 
-    while (!hil_msgs.empty()) {
-      mavlink_pub_.publish(hil_msgs.back());
-      hil_msgs.pop_back();
-    }
+  while (ros::ok()) {
+    hil_interface_->CollectMavlink(&hil_msgs_);
+    SendMessages(hil_msgs_);
 
     ros::spinOnce();
     rate_.sleep();
   }
 }
 
+void HilInterfaceNode::EventDrivenTask() {
+  // A single spinner thread runs the sensor callbacks as the messages arrive,
+  // which keeps them serialized, while this thread only sends.
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  HilMavlinkMessage hil_msg;
+  while (ros::ok()) {
+    // The timeout only bounds the reaction to a shutdown.
+    if (!hil_queue_->Pop(&hil_msg, boost::posix_time::milliseconds(100)))
+      continue;
+
+    // Whatever else was queued in the meantime goes out in the same batch.
+    hil_msgs_.clear();
+    do {
+      hil_msgs_.push_back(hil_msg);
+    } while (hil_queue_->TryPop(&hil_msg));
+
+    SendMessages(hil_msgs_);
+  }
+
+  spinner.stop();
+}
+
+void HilInterfaceNode::SendMessages(const std::vector<HilMavlinkMessage>& hil_msgs) {
+  if (mavlink_link_) {
+    if (!mavlink_link_->Send(hil_msgs)) {
+      num_dropped_batches_ += 1;
+      ROS_WARN_THROTTLE(1.0, "Could not send a batch of %zu HIL messages over "
+                        "the MAVLINK link, %lu batches dropped so far.",
+                        hil_msgs.size(),
+                        static_cast<unsigned long>(num_dropped_batches_));
+    }
+    return;
+  }
+
+  // MAVROS takes one message per ROS message, published newest first.
+  mavros_msgs::Mavlink mavros_msg;
+  for (size_t i = hil_msgs.size(); i > 0; --i) {
+    MavlinkToMavros(hil_msgs[i - 1].message, hil_msgs[i - 1].stamp, &mavros_msg);
+    mavlink_pub_.publish(mavros_msg);
+  }
+}
+
 void HilInterfaceNode::HilControlsCallback(const mavros_msgs::HilControlsConstPtr& hil_controls_msg) {
+  PublishActuators(hil_controls_msg->roll_ailerons, hil_controls_msg->pitch_elevator,
+                   hil_controls_msg->yaw_rudder, hil_controls_msg->aux1,
+                   hil_controls_msg->aux2, hil_controls_msg->throttle);
+}
+
+void HilInterfaceNode::LinkMessageCallback(const mavlink_message_t& message) {
+  if (message.msgid != MAVLINK_MSG_ID_HIL_CONTROLS)
+    return;
+
+  mavlink_hil_controls_t hil_controls;
+  mavlink_msg_hil_controls_decode(&message, &hil_controls);
+  PublishActuators(hil_controls.roll_ailerons, hil_controls.pitch_elevator,
+                   hil_controls.yaw_rudder, hil_controls.aux1,
+                   hil_controls.aux2, hil_controls.throttle);
+}
+
+void HilInterfaceNode::PublishActuators(float roll, float pitch, float yaw,
+                                        float aux1, float aux2, float throttle) {
   mav_msgs::Actuators act_msg;
 
   ros::Time current_time = ros::Time::now();
 
-  act_msg.normalized.push_back(hil_controls_msg->roll_ailerons);
-  act_msg.normalized.push_back(hil_controls_msg->pitch_elevator);
-  act_msg.normalized.push_back(hil_controls_msg->yaw_rudder);
-  act_msg.normalized.push_back(hil_controls_msg->aux1);
-  act_msg.normalized.push_back(hil_controls_msg->aux2);
-  act_msg.normalized.push_back(hil_controls_msg->throttle);
+  act_msg.normalized.push_back(roll);
+  act_msg.normalized.push_back(pitch);
+  act_msg.normalized.push_back(yaw);
+  act_msg.normalized.push_back(aux1);
+  act_msg.normalized.push_back(aux2);
+  act_msg.normalized.push_back(throttle);
 
   act_msg.header.stamp.sec = current_time.sec;
   act_msg.header.stamp.nsec = current_time.nsec;
 
   actuators_pub_.publish(act_msg);
 }
-
 }
 
 int main(int argc, char** argv) {
@@ -0,0 +1,267 @@
+/*
+ * Copyright 2016 Pavel Vechersky, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rotors_hil_interface/hil_mavlink_link.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cstdlib>
+
+namespace rotors_hil {
+
+namespace {
+
+/// \brief Map a numeric baud rate to its termios constant.
+/// \return The termios speed, B0 if the rate is not supported.
+speed_t BaudRateToSpeed(int baud_rate) {
+  switch (baud_rate) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 500000: return B500000;
+    case 921600: return B921600;
+    case 1000000: return B1000000;
+    case 1500000: return B1500000;
+    case 3000000: return B3000000;
+    default: return B0;
+  }
+}
+
+}  // namespace
+
+HilMavlinkLink::HilMavlinkLink()
+    : fd_(-1),
+      receiving_(false) {
+  tx_buffer_.reserve(MAVLINK_MAX_PACKET_LEN * 4);
+}
+
+HilMavlinkLink::~HilMavlinkLink() {
+  Close();
+}
+
+HilMavlinkLink* HilMavlinkLink::Create(const std::string& url) {
+  static const std::string kSerialScheme = "serial://";
+  static const std::string kUdpScheme = "udp://";
+
+  HilMavlinkLink* link = NULL;
+  if (url.compare(0, kSerialScheme.size(), kSerialScheme) == 0) {
+    std::string device = url.substr(kSerialScheme.size());
+    int baud_rate = kDefaultSerialBaudRate;
+    size_t colon = device.rfind(':');
+    if (colon != std::string::npos) {
+      baud_rate = std::atoi(device.c_str() + colon + 1);
+      device.erase(colon);
+    }
+    link = new HilSerialLink(device, baud_rate);
+  }
+  else if (url.compare(0, kUdpScheme.size(), kUdpScheme) == 0) {
+    std::string host = url.substr(kUdpScheme.size());
+    size_t colon = host.rfind(':');
+    if (colon == std::string::npos) {
+      ROS_ERROR("MAVLINK link URL %s has no port.", url.c_str());
+      return NULL;
+    }
+    int port = std::atoi(host.c_str() + colon + 1);
+    host.erase(colon);
+    link = new HilUdpLink(host, port);
+  }
+  else {
+    ROS_ERROR("Unknown MAVLINK link URL %s, expected serial:// or udp://.", url.c_str());
+    return NULL;
+  }
+
+  if (link->fd_ < 0) {
+    delete link;
+    return NULL;
+  }
+  return link;
+}
+
+bool HilMavlinkLink::Send(const std::vector<HilMavlinkMessage>& hil_msgs) {
+  if (hil_msgs.empty())
+    return true;
+
+  tx_buffer_.resize(hil_msgs.size() * MAVLINK_MAX_PACKET_LEN);
+  size_t length = 0;
+  for (size_t i = 0; i < hil_msgs.size(); ++i)
+    length += mavlink_msg_to_send_buffer(&tx_buffer_[length], &hil_msgs[i].message);
+
+  return Write(&tx_buffer_[0], length);
+}
+
+void HilMavlinkLink::StartReceiving(const ReceiveCallback& callback) {
+  if (receiving_.exchange(true))
+    return;
+  receive_thread_ = boost::thread(&HilMavlinkLink::ReceiveTask, this, callback);
+}
+
+void HilMavlinkLink::Close() {
+  receiving_.store(false);
+  if (receive_thread_.joinable())
+    receive_thread_.join();
+
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+void HilMavlinkLink::ReceiveTask(ReceiveCallback callback) {
+  uint8_t buffer[kHilLinkReadBufferSize];
+  mavlink_message_t message;
+  mavlink_status_t status;
+  memset(&status, 0, sizeof(status));
+
+  struct pollfd pfd;
+  pfd.fd = fd_;
+  pfd.events = POLLIN;
+
+  while (receiving_.load()) {
+    // The timeout only bounds the reaction to Close().
+    int ready = poll(&pfd, 1, kHilLinkPollTimeoutMs);
+    if (ready <= 0)
+      continue;
+
+    ssize_t length = Read(buffer, sizeof(buffer));
+    for (ssize_t i = 0; i < length; ++i) {
+      if (mavlink_parse_char(MAVLINK_COMM_0, buffer[i], &message, &status))
+        callback(message);
+    }
+  }
+}
+
+HilSerialLink::HilSerialLink(const std::string& device, int baud_rate) {
+  speed_t speed = BaudRateToSpeed(baud_rate);
+  if (speed == B0) {
+    ROS_ERROR("Unsupported baud rate %d for %s.", baud_rate, device.c_str());
+    return;
+  }
+
+  fd_ = open(device.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+  if (fd_ < 0) {
+    ROS_ERROR("Could not open %s: %s", device.c_str(), strerror(errno));
+    return;
+  }
+
+  struct termios tio;
+  if (tcgetattr(fd_, &tio) != 0) {
+    ROS_ERROR("Could not read the settings of %s: %s", device.c_str(), strerror(errno));
+    Close();
+    return;
+  }
+
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cflag &= ~CRTSCTS;
+  tio.c_cc[VMIN] = 0;
+  tio.c_cc[VTIME] = 0;
+  cfsetispeed(&tio, speed);
+  cfsetospeed(&tio, speed);
+
+  if (tcsetattr(fd_, TCSANOW, &tio) != 0) {
+    ROS_ERROR("Could not configure %s: %s", device.c_str(), strerror(errno));
+    Close();
+    return;
+  }
+  tcflush(fd_, TCIOFLUSH);
+}
+
+HilSerialLink::~HilSerialLink() {
+  Close();
+}
+
+bool HilSerialLink::Write(const uint8_t* data, size_t length) {
+  // A tty may accept less than the whole batch when its output queue is
+  // nearly full, keep writing the rest.
+  while (length > 0) {
+    ssize_t written = write(fd_, data, length);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      ROS_ERROR_THROTTLE(1.0, "Writing to the serial port failed: %s", strerror(errno));
+      return false;
+    }
+    data += written;
+    length -= written;
+  }
+  return true;
+}
+
+ssize_t HilSerialLink::Read(uint8_t* data, size_t length) {
+  return read(fd_, data, length);
+}
+
+HilUdpLink::HilUdpLink(const std::string& host, int port) {
+  memset(&remote_addr_, 0, sizeof(remote_addr_));
+  remote_addr_.sin_family = AF_INET;
+  remote_addr_.sin_port = htons(port);
+  if (port <= 0 || port > 65535 ||
+      inet_pton(AF_INET, host.c_str(), &remote_addr_.sin_addr) != 1) {
+    ROS_ERROR("Invalid UDP address %s:%d.", host.c_str(), port);
+    return;
+  }
+
+  fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd_ < 0) {
+    ROS_ERROR("Could not create a UDP socket: %s", strerror(errno));
+    return;
+  }
+
+  // Bind to an ephemeral port so the autopilot has an address to reply to.
+  struct sockaddr_in local_addr;
+  memset(&local_addr, 0, sizeof(local_addr));
+  local_addr.sin_family = AF_INET;
+  local_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  local_addr.sin_port = 0;
+  if (bind(fd_, reinterpret_cast<struct sockaddr*>(&local_addr), sizeof(local_addr)) != 0) {
+    ROS_ERROR("Could not bind the UDP socket: %s", strerror(errno));
+    Close();
+  }
+}
+
+HilUdpLink::~HilUdpLink() {
+  Close();
+}
+
+bool HilUdpLink::Write(const uint8_t* data, size_t length) {
+  // The whole batch goes out as one datagram, the autopilot parses the
+  // frames from it as a byte stream.
+  ssize_t sent = sendto(fd_, data, length, 0,
+                        reinterpret_cast<const struct sockaddr*>(&remote_addr_),
+                        sizeof(remote_addr_));
+  if (sent < 0) {
+    ROS_ERROR_THROTTLE(1.0, "Sending to the UDP socket failed: %s", strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+ssize_t HilUdpLink::Read(uint8_t* data, size_t length) {
+  return recv(fd_, data, length, 0);
+}
+
+}
@@ -49,86 +49,109 @@ HilSensorLevelInterface::HilSensorLevelInterface(const Eigen::Quaterniond& q_S_B
   air_speed_sub_ =
       nh_.subscribe<geometry_msgs::TwistStamped>(
           air_speed_sub_topic, 1, boost::bind(
-              &HilListeners::AirSpeedCallback, &hil_listeners_, _1, &hil_data_));
+              &HilListeners::AirSpeedCallback, &hil_listeners_, _1));
 
   gps_sub_ =
       nh_.subscribe<sensor_msgs::NavSatFix>(
           gps_sub_topic, 1, boost::bind(
-              &HilListeners::GpsCallback, &hil_listeners_, _1, &hil_data_));
+              &HilSensorLevelInterface::GpsCallback, this, _1));
 
   ground_speed_sub_ =
       nh_.subscribe<geometry_msgs::TwistStamped>(
           ground_speed_sub_topic, 1, boost::bind(
-              &HilListeners::GroundSpeedCallback, &hil_listeners_, _1, &hil_data_));
+              &HilListeners::GroundSpeedCallback, &hil_listeners_, _1));
 
   imu_sub_ =
       nh_.subscribe<sensor_msgs::Imu>(
           imu_sub_topic, 1, boost::bind(
-              &HilListeners::ImuCallback, &hil_listeners_, _1, &hil_data_));
+              &HilSensorLevelInterface::ImuCallback, this, _1));
 
   mag_sub_ =
       nh_.subscribe<sensor_msgs::MagneticField>(
           mag_sub_topic, 1, boost::bind(
-              &HilListeners::MagCallback, &hil_listeners_, _1, &hil_data_));
+              &HilListeners::MagCallback, &hil_listeners_, _1));
 
   pressure_sub_ =
       nh_.subscribe<sensor_msgs::FluidPressure>(
           pressure_sub_topic, 1, boost::bind(
-              &HilListeners::PressureCallback, &hil_listeners_, _1, &hil_data_));
+              &HilListeners::PressureCallback, &hil_listeners_, _1));
 }
 
 HilSensorLevelInterface::~HilSensorLevelInterface() {
 }
 
-std::vector<mavros_msgs::Mavlink> HilSensorLevelInterface::CollectData() {
-  boost::mutex::scoped_lock lock(mtx_);
+void HilSensorLevelInterface::CollectMavlink(std::vector<HilMavlinkMessage>* hil_msgs) {
+  hil_listeners_.GetSnapshot(&hil_data_);
 
   ros::Time current_time = ros::Time::now();
-  uint64_t time_usec = RosTimeToMicroseconds(current_time);
 
-  mavlink_message_t mmsg;
-  std::vector<mavros_msgs::Mavlink> hil_msgs;
-
-  // Rotate gyroscope, accelerometer, and magnetometer data into NED frame
-  Eigen::Vector3f gyro = R_S_B_ * hil_data_.gyro_rad_per_s;
-  Eigen::Vector3f acc = R_S_B_ * hil_data_.acc_m_per_s2;
-  Eigen::Vector3f mag = R_S_B_ * hil_data_.mag_G;
+  hil_msgs->clear();
+  HilMavlinkMessage hil_msg;
+  hil_msg.stamp = current_time;
 
   // Check if we need to publish a HIL_GPS message.
   if ((current_time.nsec - last_gps_pub_time_nsec_) >= gps_interval_nsec_) {
     last_gps_pub_time_nsec_ = current_time.nsec;
 
-    // Rotate ground speed data into NED frame
-    Eigen::Vector3i gps_vel = (R_S_B_ * hil_data_.gps_vel_cm_per_s.cast<float>()).cast<int>();
-
-    // Fill in a MAVLINK HIL_GPS message and convert it to MAVROS format.
-    hil_gps_msg_.time_usec = time_usec;
-    hil_gps_msg_.fix_type = hil_data_.fix_type;
-    hil_gps_msg_.lat = hil_data_.lat_1e7deg;
-    hil_gps_msg_.lon = hil_data_.lon_1e7deg;
-    hil_gps_msg_.alt = hil_data_.alt_mm;
-    hil_gps_msg_.eph = hil_data_.eph_cm;
-    hil_gps_msg_.epv = hil_data_.epv_cm;
-    hil_gps_msg_.vel = hil_data_.vel_1e2m_per_s;
-    hil_gps_msg_.vn = gps_vel.x();
-    hil_gps_msg_.ve = gps_vel.y();
-    hil_gps_msg_.vd = gps_vel.z();
-    hil_gps_msg_.cog = hil_data_.cog_1e2deg;
-    hil_gps_msg_.satellites_visible = hil_data_.satellites_visible;
-
-    mavlink_hil_gps_t* hil_gps_msg_ptr = &hil_gps_msg_;
-    mavlink_msg_hil_gps_encode(1, 0, &mmsg, hil_gps_msg_ptr);
-
-    mavros_msgs::MavlinkPtr rmsg_hil_gps = boost::make_shared<mavros_msgs::Mavlink>();
-    rmsg_hil_gps->header.stamp.sec = current_time.sec;
-    rmsg_hil_gps->header.stamp.nsec = current_time.nsec;
-    mavros_msgs::mavlink::convert(mmsg, *rmsg_hil_gps);
-
-    hil_msgs.push_back(*rmsg_hil_gps);
+    EncodeHilGps(current_time, &hil_msg.message);
+    hil_msgs->push_back(hil_msg);
   }
 
-  // Fill in a MAVLINK HIL_SENSOR message and convert it to MAVROS format.
-  hil_sensor_msg_.time_usec = time_usec;
+  EncodeHilSensor(current_time, &hil_msg.message);
+  hil_msgs->push_back(hil_msg);
+}
+
+void HilSensorLevelInterface::OnImu(const ros::Time& stamp) {
+  // Magnetometer and pressure data go out with the next IMU sample.
+  hil_listeners_.GetSnapshot(&hil_data_);
+
+  mavlink_message_t mmsg;
+  EncodeHilSensor(stamp, &mmsg);
+  QueueMessage(mmsg, stamp);
+}
+
+void HilSensorLevelInterface::OnGps(const ros::Time& stamp) {
+  // Ground speed data goes out with the next GPS fix.
+  hil_listeners_.GetSnapshot(&hil_data_);
+
+  mavlink_message_t mmsg;
+  EncodeHilGps(stamp, &mmsg);
+  QueueMessage(mmsg, stamp);
+}
+
+void HilSensorLevelInterface::EncodeHilGps(const ros::Time& stamp,
+                                           mavlink_message_t* mmsg) {
+  // Rotate ground speed data into NED frame
+  Eigen::Vector3i gps_vel = (R_S_B_ * hil_data_.gps_vel_cm_per_s.cast<float>()).cast<int>();
+
+  // Fill in a MAVLINK HIL_GPS message.
+  hil_gps_msg_.time_usec = RosTimeToMicroseconds(stamp);
+  hil_gps_msg_.fix_type = hil_data_.fix_type;
+  hil_gps_msg_.lat = hil_data_.lat_1e7deg;
+  hil_gps_msg_.lon = hil_data_.lon_1e7deg;
+  hil_gps_msg_.alt = hil_data_.alt_mm;
+  hil_gps_msg_.eph = hil_data_.eph_cm;
+  hil_gps_msg_.epv = hil_data_.epv_cm;
+  hil_gps_msg_.vel = hil_data_.vel_1e2m_per_s;
+  hil_gps_msg_.vn = gps_vel.x();
+  hil_gps_msg_.ve = gps_vel.y();
+  hil_gps_msg_.vd = gps_vel.z();
+  hil_gps_msg_.cog = hil_data_.cog_1e2deg;
+  hil_gps_msg_.satellites_visible = hil_data_.satellites_visible;
+
+  mavlink_hil_gps_t* hil_gps_msg_ptr = &hil_gps_msg_;
+  mavlink_msg_hil_gps_encode(1, 0, mmsg, hil_gps_msg_ptr);
+}
+
+void HilSensorLevelInterface::EncodeHilSensor(const ros::Time& stamp,
+                                              mavlink_message_t* mmsg) {
+  // Rotate gyroscope, accelerometer, and magnetometer data into NED frame
+  Eigen::Vector3f gyro = R_S_B_ * hil_data_.gyro_rad_per_s;
+  Eigen::Vector3f acc = R_S_B_ * hil_data_.acc_m_per_s2;
+  Eigen::Vector3f mag = R_S_B_ * hil_data_.mag_G;
+
+  // Fill in a MAVLINK HIL_SENSOR message.
+  hil_sensor_msg_.time_usec = RosTimeToMicroseconds(stamp);
   hil_sensor_msg_.xacc = acc.x();
   hil_sensor_msg_.yacc = acc.y();
   hil_sensor_msg_.zacc = acc.z();
@@ -145,16 +168,7 @@ std::vector<mavros_msgs::Mavlink> HilSensorLevelInterface::CollectData() {
   hil_sensor_msg_.fields_updated = kAllFieldsUpdated;
 
   mavlink_hil_sensor_t* hil_sensor_msg_ptr = &hil_sensor_msg_;
-  mavlink_msg_hil_sensor_encode(1, 0, &mmsg, hil_sensor_msg_ptr);
-
-  mavros_msgs::MavlinkPtr rmsg_hil_sensor = boost::make_shared<mavros_msgs::Mavlink>();
-  rmsg_hil_sensor->header.stamp.sec = current_time.sec;
-  rmsg_hil_sensor->header.stamp.nsec = current_time.nsec;
-  mavros_msgs::mavlink::convert(mmsg, *rmsg_hil_sensor);
-
-  hil_msgs.push_back(*rmsg_hil_sensor);
-
-  return hil_msgs;
+  mavlink_msg_hil_sensor_encode(1, 0, mmsg, hil_sensor_msg_ptr);
 }
 
 }
@@ -40,36 +40,48 @@ HilStateLevelInterface::HilStateLevelInterface(const Eigen::Quaterniond& q_S_B)
   air_speed_sub_ =
       nh_.subscribe<geometry_msgs::TwistStamped>(
           air_speed_sub_topic, 1, boost::bind(
-              &HilListeners::AirSpeedCallback, &hil_listeners_, _1, &hil_data_));
+              &HilListeners::AirSpeedCallback, &hil_listeners_, _1));
 
   gps_sub_ =
       nh_.subscribe<sensor_msgs::NavSatFix>(
           gps_sub_topic, 1, boost::bind(
-              &HilListeners::GpsCallback, &hil_listeners_, _1, &hil_data_));
+              &HilListeners::GpsCallback, &hil_listeners_, _1));
 
   ground_speed_sub_ =
       nh_.subscribe<geometry_msgs::TwistStamped>(
           ground_speed_sub_topic, 1, boost::bind(
-              &HilListeners::GroundSpeedCallback, &hil_listeners_, _1, &hil_data_));
+              &HilListeners::GroundSpeedCallback, &hil_listeners_, _1));
 
   imu_sub_ =
       nh_.subscribe<sensor_msgs::Imu>(
           imu_sub_topic, 1, boost::bind(
-              &HilListeners::ImuCallback, &hil_listeners_, _1, &hil_data_));
+              &HilStateLevelInterface::ImuCallback, this, _1));
 }
 
 HilStateLevelInterface::~HilStateLevelInterface() {
 }
 
-std::vector<mavros_msgs::Mavlink> HilStateLevelInterface::CollectData() {
-  boost::mutex::scoped_lock lock(mtx_);
+void HilStateLevelInterface::CollectMavlink(std::vector<HilMavlinkMessage>* hil_msgs) {
+  hil_listeners_.GetSnapshot(&hil_data_);
 
   ros::Time current_time = ros::Time::now();
-  uint64_t time_usec = RosTimeToMicroseconds(current_time);
+
+  hil_msgs->resize(1);
+  (*hil_msgs)[0].stamp = current_time;
+  EncodeHilStateQuaternion(current_time, &(*hil_msgs)[0].message);
+}
+
+void HilStateLevelInterface::OnImu(const ros::Time& stamp) {
+  // GPS and air speed data go out with the next IMU sample.
+  hil_listeners_.GetSnapshot(&hil_data_);
 
   mavlink_message_t mmsg;
-  std::vector<mavros_msgs::Mavlink> hil_msgs;
+  EncodeHilStateQuaternion(stamp, &mmsg);
+  QueueMessage(mmsg, stamp);
+}
 
+void HilStateLevelInterface::EncodeHilStateQuaternion(const ros::Time& stamp,
+                                                      mavlink_message_t* mmsg) {
   // Rotate the attitude into NED frame
   Eigen::Quaterniond att = q_S_B_ * hil_data_.att;
 
@@ -78,8 +90,8 @@ std::vector<mavros_msgs::Mavlink> HilStateLevelInterface::CollectData() {
   Eigen::Vector3f acc = R_S_B_ * hil_data_.acc_m_per_s2;
   Eigen::Vector3i gps_vel = (R_S_B_ * hil_data_.gps_vel_cm_per_s.cast<float>()).cast<int>();
 
-  // Fill in a MAVLINK HIL_STATE_QUATERNION message and convert it to MAVROS format.
-  hil_state_qtrn_msg_.time_usec = time_usec;
+  // Fill in a MAVLINK HIL_STATE_QUATERNION message.
+  hil_state_qtrn_msg_.time_usec = RosTimeToMicroseconds(stamp);
   hil_state_qtrn_msg_.attitude_quaternion[0] = att.w();
   hil_state_qtrn_msg_.attitude_quaternion[1] = att.x();
   hil_state_qtrn_msg_.attitude_quaternion[2] = att.y();
@@ -100,16 +112,7 @@ std::vector<mavros_msgs::Mavlink> HilStateLevelInterface::CollectData() {
   hil_state_qtrn_msg_.zacc = acc.z() * kMetersToMm / kGravityMagnitude_m_per_s2;
 
   mavlink_hil_state_quaternion_t* hil_state_qtrn_msg_ptr = &hil_state_qtrn_msg_;
-  mavlink_msg_hil_state_quaternion_encode(1, 0, &mmsg, hil_state_qtrn_msg_ptr);
-
-  mavros_msgs::MavlinkPtr rmsg_hil_state_qtrn = boost::make_shared<mavros_msgs::Mavlink>();
-  rmsg_hil_state_qtrn->header.stamp.sec = current_time.sec;
-  rmsg_hil_state_qtrn->header.stamp.nsec = current_time.nsec;
-  mavros_msgs::mavlink::convert(mmsg, *rmsg_hil_state_qtrn);
-
-  hil_msgs.push_back(*rmsg_hil_state_qtrn);
-
-  return hil_msgs;
+  mavlink_msg_hil_state_quaternion_encode(1, 0, mmsg, hil_state_qtrn_msg_ptr);
 }
 
 }